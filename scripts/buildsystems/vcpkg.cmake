@@ -110,6 +110,9 @@ list(APPEND CMAKE_LIBRARY_PATH
     ${_VCPKG_INSTALLED_DIR}/${VCPKG_TARGET_TRIPLET}/lib/manual-link
 )
 
+# Written by vcpkg install and remove: the directory of every installed config file, used by find_package below
+include("${_VCPKG_INSTALLED_DIR}/vcpkg/cmake/${VCPKG_TARGET_TRIPLET}.cmake" OPTIONAL)
+
 file(TO_CMAKE_PATH "$ENV{PROGRAMFILES}" _programfiles)
 set(CMAKE_SYSTEM_IGNORE_PATH
     "${_programfiles}/OpenSSL"
@@ -137,18 +140,33 @@ foreach(_VCPKG_TOOLS_DIR ${_VCPKG_TOOLS_DIRS})
 endforeach()
 
 option(VCPKG_APPLOCAL_DEPS "Automatically copy dependencies into the output directory for executables." ON)
+
+# vcpkg x-applocal reads the imports itself, without starting PowerShell and dumpbin for every link
+function(_vcpkg_add_applocal_command name)
+    set(_installed_bin "${_VCPKG_INSTALLED_DIR}/${VCPKG_TARGET_TRIPLET}$<$<CONFIG:Debug>:/debug>/bin")
+    if(EXISTS "${_VCPKG_ROOT_DIR}/vcpkg.exe")
+        add_custom_command(TARGET ${name} POST_BUILD
+            COMMAND "${_VCPKG_ROOT_DIR}/vcpkg.exe" x-applocal
+                "--target-binary=$<TARGET_FILE:${name}>"
+                "--installed-dir=${_installed_bin}"
+        )
+    else()
+        add_custom_command(TARGET ${name} POST_BUILD
+            COMMAND powershell -noprofile -executionpolicy Bypass -file ${_VCPKG_TOOLCHAIN_DIR}/msbuild/applocal.ps1
+                -targetBinary $<TARGET_FILE:${name}>
+                -installedDir "${_installed_bin}"
+                -OutVariable out
+        )
+    endif()
+endfunction()
+
 function(add_executable name)
     _add_executable(${ARGV})
     list(FIND ARGV "IMPORTED" IMPORTED_IDX)
     list(FIND ARGV "ALIAS" ALIAS_IDX)
     if(IMPORTED_IDX EQUAL -1 AND ALIAS_IDX EQUAL -1)
         if(VCPKG_APPLOCAL_DEPS AND _VCPKG_TARGET_TRIPLET_PLAT MATCHES "windows|uwp")
-            add_custom_command(TARGET ${name} POST_BUILD
-                COMMAND powershell -noprofile -executionpolicy Bypass -file ${_VCPKG_TOOLCHAIN_DIR}/msbuild/applocal.ps1
-                    -targetBinary $<TARGET_FILE:${name}>
-                    -installedDir "${_VCPKG_INSTALLED_DIR}/${VCPKG_TARGET_TRIPLET}$<$<CONFIG:Debug>:/debug>/bin"
-                    -OutVariable out
-            )
+            _vcpkg_add_applocal_command(${name})
         endif()
         set_target_properties(${name} PROPERTIES VS_USER_PROPS do_not_import_user.props)
         set_target_properties(${name} PROPERTIES VS_GLOBAL_VcpkgEnabled false)
@@ -163,12 +181,7 @@ function(add_library name)
     if(IMPORTED_IDX EQUAL -1 AND INTERFACE_IDX EQUAL -1 AND ALIAS_IDX EQUAL -1)
         get_target_property(IS_LIBRARY_SHARED ${name} TYPE)
         if(VCPKG_APPLOCAL_DEPS AND _VCPKG_TARGET_TRIPLET_PLAT MATCHES "windows|uwp" AND (IS_LIBRARY_SHARED STREQUAL "SHARED_LIBRARY" OR IS_LIBRARY_SHARED STREQUAL "MODULE_LIBRARY"))
-            add_custom_command(TARGET ${name} POST_BUILD
-                COMMAND powershell -noprofile -executionpolicy Bypass -file ${_VCPKG_TOOLCHAIN_DIR}/msbuild/applocal.ps1
-                    -targetBinary $<TARGET_FILE:${name}>
-                    -installedDir "${_VCPKG_INSTALLED_DIR}/${VCPKG_TARGET_TRIPLET}$<$<CONFIG:Debug>:/debug>/bin"
-                    -OutVariable out
-            )
+            _vcpkg_add_applocal_command(${name})
         endif()
         set_target_properties(${name} PROPERTIES VS_USER_PROPS do_not_import_user.props)
         set_target_properties(${name} PROPERTIES VS_GLOBAL_VcpkgEnabled false)
@@ -244,6 +257,14 @@ macro(find_package name)
     elseif("${_vcpkg_lowercase_name}" STREQUAL "grpc" AND EXISTS "${_VCPKG_INSTALLED_DIR}/${VCPKG_TARGET_TRIPLET}/share/grpc")
         _find_package(gRPC ${ARGN})
     else()
+        # Pointing CMake at the config file's directory spares it the search through every prefix
+        if(NOT DEFINED ${name}_DIR)
+            if(DEFINED _VCPKG_CONFIG_DIR_${name})
+                set(${name}_DIR "${_VCPKG_INSTALLED_DIR}/${VCPKG_TARGET_TRIPLET}/${_VCPKG_CONFIG_DIR_${name}}")
+            elseif(DEFINED _VCPKG_LOWERCASE_CONFIG_DIR_${_vcpkg_lowercase_name})
+                set(${name}_DIR "${_VCPKG_INSTALLED_DIR}/${VCPKG_TARGET_TRIPLET}/${_VCPKG_LOWERCASE_CONFIG_DIR_${_vcpkg_lowercase_name}}")
+            endif()
+        endif()
         _find_package(${ARGV})
     endif()
 endmacro()
@@ -21,7 +21,11 @@
 ## ## Notes:
 ## This command should be preceeded by a call to [`vcpkg_configure_cmake()`](vcpkg_configure_cmake.md).
 ## You can use the alias [`vcpkg_install_cmake()`](vcpkg_configure_cmake.md) function if your CMake script supports the
-## "install" target
+## "install" target.
+## When vcpkg builds several ports concurrently it passes the number of processors this build may use in
+## `VCPKG_CONCURRENCY`, which limits the parallelism of the underlying buildsystem.
+## When [`VCPKG_PARALLEL_CONFIGURATIONS`](../users/config-environment.md#vcpkg_parallel_configurations) is set, the
+## Debug and Release configurations are built at the same time, each with half of the processors.
 ##
 ## ## Examples:
 ##
@@ -60,12 +64,84 @@ function(vcpkg_build_cmake)
         set(TARGET_PARAM)
     endif()
 
+    if(DEFINED VCPKG_CONCURRENCY)
+        if(_VCPKG_CMAKE_GENERATOR MATCHES "Ninja")
+            set(PARALLEL_ARG "-j${VCPKG_CONCURRENCY}")
+        elseif(_VCPKG_CMAKE_GENERATOR MATCHES "Visual Studio")
+            set(PARALLEL_ARG "/m:${VCPKG_CONCURRENCY}")
+        endif()
+    endif()
+
     if(_bc_DISABLE_PARALLEL)
         set(PARALLEL_ARG ${NO_PARALLEL_ARG})
     endif()
 
+    # Both configurations are built at once when vcpkg asks for it, splitting the processors between them. One that
+    # fails is built again on its own below, which retries and reports the failure as usual.
+    set(_bc_BUILT_debug OFF)
+    set(_bc_BUILT_release OFF)
+    if(_VCPKG_PARALLEL_CONFIGURATIONS AND NOT DEFINED VCPKG_BUILD_TYPE AND NOT _bc_DISABLE_PARALLEL AND NOT _bc_ADD_BIN_TO_PATH)
+        if(DEFINED VCPKG_CONCURRENCY)
+            set(_bc_PROCESSORS ${VCPKG_CONCURRENCY})
+        else()
+            cmake_host_system_information(RESULT _bc_PROCESSORS QUERY NUMBER_OF_LOGICAL_CORES)
+        endif()
+        math(EXPR _bc_SHARE "(${_bc_PROCESSORS} + 1) / 2")
+        set(_bc_SHARED_PARALLEL_ARG)
+        if(_VCPKG_CMAKE_GENERATOR MATCHES "Ninja")
+            set(_bc_SHARED_PARALLEL_ARG "-j${_bc_SHARE}")
+        elseif(_VCPKG_CMAKE_GENERATOR MATCHES "Visual Studio")
+            set(_bc_SHARED_PARALLEL_ARG "/m:${_bc_SHARE}")
+        endif()
+
+        # Ninja runs commands through cmd on Windows and through sh everywhere else
+        if(CMAKE_HOST_WIN32)
+            set(_bc_SHELL_BEGIN "cmd /c \"")
+            set(_bc_CD "cd /d")
+            set(_bc_SHELL_END "\"")
+        else()
+            set(_bc_SHELL_BEGIN "")
+            set(_bc_CD "cd")
+            set(_bc_SHELL_END "")
+        endif()
+
+        vcpkg_find_acquire_program(NINJA)
+        set(_bc_PARALLEL_DIR "${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel/vcpkg-parallel-build")
+        file(REMOVE_RECURSE "${_bc_PARALLEL_DIR}")
+        set(_contents "rule CreateProcess\n  command = $process\n\n")
+        foreach(SHORT_BUILDTYPE "dbg" "rel")
+            if(SHORT_BUILDTYPE STREQUAL "dbg")
+                set(CONFIG "Debug")
+            else()
+                set(CONFIG "Release")
+            endif()
+            set(LOGPREFIX "${CURRENT_BUILDTREES_DIR}/${_bc_LOGFILE_ROOT}-${TARGET_TRIPLET}-${SHORT_BUILDTYPE}")
+            set(_bc_LINE "${_bc_CD} \"${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-${SHORT_BUILDTYPE}\" &&")
+            foreach(arg ${CMAKE_COMMAND} --build . --config ${CONFIG} ${TARGET_PARAM} -- ${BUILD_ARGS} ${_bc_SHARED_PARALLEL_ARG})
+                set(_bc_LINE "${_bc_LINE} \"${arg}\"")
+            endforeach()
+            set(_bc_LINE "${_bc_LINE} > \"${LOGPREFIX}-out.log\" 2> \"${LOGPREFIX}-err.log\"")
+            set(_bc_LINE "${_bc_LINE} && \"${CMAKE_COMMAND}\" -E touch \"${_bc_PARALLEL_DIR}/${SHORT_BUILDTYPE}.stamp\"")
+            set(_contents "${_contents}build ${SHORT_BUILDTYPE}.stamp: CreateProcess\n  process = ${_bc_SHELL_BEGIN}${_bc_LINE}${_bc_SHELL_END}\n\n")
+        endforeach()
+        file(WRITE "${_bc_PARALLEL_DIR}/build.ninja" "${_contents}")
+
+        message(STATUS "Building ${TARGET_TRIPLET}-dbg and ${TARGET_TRIPLET}-rel")
+        execute_process(
+            COMMAND "${NINJA}" -k 0 -j 2
+            OUTPUT_FILE "${CURRENT_BUILDTREES_DIR}/${_bc_LOGFILE_ROOT}-${TARGET_TRIPLET}-parallel.log"
+            ERROR_FILE "${CURRENT_BUILDTREES_DIR}/${_bc_LOGFILE_ROOT}-${TARGET_TRIPLET}-parallel.log"
+            WORKING_DIRECTORY "${_bc_PARALLEL_DIR}")
+        if(EXISTS "${_bc_PARALLEL_DIR}/dbg.stamp")
+            set(_bc_BUILT_debug ON)
+        endif()
+        if(EXISTS "${_bc_PARALLEL_DIR}/rel.stamp")
+            set(_bc_BUILT_release ON)
+        endif()
+    endif()
+
     foreach(BUILDTYPE "debug" "release")
-        if(NOT DEFINED VCPKG_BUILD_TYPE OR VCPKG_BUILD_TYPE STREQUAL BUILDTYPE)
+        if((NOT DEFINED VCPKG_BUILD_TYPE OR VCPKG_BUILD_TYPE STREQUAL BUILDTYPE) AND NOT _bc_BUILT_${BUILDTYPE})
             if(BUILDTYPE STREQUAL "debug")
                 set(SHORT_BUILDTYPE "dbg")
                 set(CONFIG "Debug")
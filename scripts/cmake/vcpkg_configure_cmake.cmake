@@ -7,6 +7,7 @@
 ## vcpkg_configure_cmake(
 ##     SOURCE_PATH <${SOURCE_PATH}>
 ##     [PREFER_NINJA]
+##     [UNITY_BUILD | DISABLE_UNITY_BUILD]
 ##     [GENERATOR <"NMake Makefiles">]
 ##     [OPTIONS <-DUSE_THIS_IN_ALL_BUILDS=1>...]
 ##     [OPTIONS_RELEASE <-DOPTIMIZE=1>...]
@@ -26,6 +27,14 @@
 ##
 ## This is needed for libraries which write back into their source directory during configure.
 ##
+## ### UNITY_BUILD
+## Builds the project as a unity build, as if the triplet set [`VCPKG_UNITY_BUILD`](../users/triplets.md#vcpkg_unity_build).
+##
+## ### DISABLE_UNITY_BUILD
+## Never builds the project as a unity build, even when the triplet sets `VCPKG_UNITY_BUILD`.
+##
+## This is needed for libraries whose source files cannot be compiled together, for example because they define the same static functions or rely on different macros.
+##
 ## ### GENERATOR
 ## Specifies the precise generator to use.
 ##
@@ -43,6 +52,10 @@
 ## ## Notes
 ## This command supplies many common arguments to CMake. To see the full list, examine the source.
 ##
+## With `--x-incremental`, the Release and Debug build directories of the previous build of the port are kept when they would be configured the same way again, so that the build and install steps only redo what changed. The sources, patches, options and toolchain files decide that; the installed dependencies do not, so rebuild without `--x-incremental` after changing them.
+##
+## When [`VCPKG_COMPILER_CACHE`](../users/config-environment.md#vcpkg_compiler_cache) is set, C and C++ compilations go through the compiler cache it names.
+##
 ## ## Examples
 ##
 ## * [zlib](https://github.com/Microsoft/vcpkg/blob/master/ports/zlib/portfile.cmake)
@@ -50,7 +63,7 @@
 ## * [poco](https://github.com/Microsoft/vcpkg/blob/master/ports/poco/portfile.cmake)
 ## * [opencv](https://github.com/Microsoft/vcpkg/blob/master/ports/opencv/portfile.cmake)
 function(vcpkg_configure_cmake)
-    cmake_parse_arguments(_csc "PREFER_NINJA;DISABLE_PARALLEL_CONFIGURE" "SOURCE_PATH;GENERATOR" "OPTIONS;OPTIONS_DEBUG;OPTIONS_RELEASE" ${ARGN})
+    cmake_parse_arguments(_csc "PREFER_NINJA;DISABLE_PARALLEL_CONFIGURE;UNITY_BUILD;DISABLE_UNITY_BUILD" "SOURCE_PATH;GENERATOR" "OPTIONS;OPTIONS_DEBUG;OPTIONS_RELEASE" ${ARGN})
 
     if(NOT VCPKG_PLATFORM_TOOLSET)
         message(FATAL_ERROR "Vcpkg has been updated with VS2017 support, however you need to rebuild vcpkg.exe by re-running bootstrap-vcpkg.bat\n")
@@ -84,7 +97,7 @@ function(vcpkg_configure_cmake)
 
     if(_csc_GENERATOR)
         set(GENERATOR ${_csc_GENERATOR})
-    elseif(_csc_PREFER_NINJA AND NINJA_CAN_BE_USED)
+    elseif((_csc_PREFER_NINJA OR _VCPKG_PARALLEL_CONFIGURATIONS) AND NINJA_CAN_BE_USED)
         set(GENERATOR "Ninja")
     elseif(VCPKG_CHAINLOAD_TOOLCHAIN_FILE OR (VCPKG_CMAKE_SYSTEM_NAME AND NOT VCPKG_CMAKE_SYSTEM_NAME STREQUAL "WindowsStore"))
         set(GENERATOR "Ninja")
@@ -124,8 +137,6 @@ function(vcpkg_configure_cmake)
         list(APPEND _csc_OPTIONS "-DCMAKE_MAKE_PROGRAM=${NINJA}")
     endif()
 
-    file(REMOVE_RECURSE ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-dbg)
-
     if(DEFINED VCPKG_CMAKE_SYSTEM_NAME)
         list(APPEND _csc_OPTIONS "-DCMAKE_SYSTEM_NAME=${VCPKG_CMAKE_SYSTEM_NAME}")
         if(VCPKG_CMAKE_SYSTEM_NAME STREQUAL "WindowsStore" AND NOT DEFINED VCPKG_CMAKE_SYSTEM_VERSION)
@@ -214,6 +225,26 @@ function(vcpkg_configure_cmake)
         list(APPEND _csc_OPTIONS "-DCMAKE_OSX_SYSROOT=${VCPKG_OSX_SYSROOT}")
     endif()
 
+    # Unity builds compile the sources of each target in batches, so the headers they share are parsed once per batch
+    if((VCPKG_UNITY_BUILD OR _csc_UNITY_BUILD) AND NOT _csc_DISABLE_UNITY_BUILD)
+        if(CMAKE_VERSION VERSION_LESS 3.16)
+            message(STATUS "Unity builds need CMake 3.16 or newer; building ${PORT} without one")
+        else()
+            list(APPEND _csc_OPTIONS "-DCMAKE_UNITY_BUILD=ON")
+            if(DEFINED VCPKG_UNITY_BUILD_BATCH_SIZE)
+                list(APPEND _csc_OPTIONS "-DCMAKE_UNITY_BUILD_BATCH_SIZE=${VCPKG_UNITY_BUILD_BATCH_SIZE}")
+            endif()
+        endif()
+    endif()
+
+    # The compiler cache named by VCPKG_COMPILER_CACHE; only the Ninja and Makefile generators use launchers
+    if(DEFINED _VCPKG_COMPILER_LAUNCHER)
+        list(APPEND _csc_OPTIONS
+            "-DCMAKE_C_COMPILER_LAUNCHER=${_VCPKG_COMPILER_LAUNCHER}"
+            "-DCMAKE_CXX_COMPILER_LAUNCHER=${_VCPKG_COMPILER_LAUNCHER}"
+        )
+    endif()
+
     set(rel_command
         ${CMAKE_COMMAND} ${_csc_SOURCE_PATH} "${_csc_OPTIONS}" "${_csc_OPTIONS_RELEASE}"
         -G ${GENERATOR}
@@ -225,7 +256,30 @@ function(vcpkg_configure_cmake)
         -DCMAKE_BUILD_TYPE=Debug
         -DCMAKE_INSTALL_PREFIX=${CURRENT_PACKAGES_DIR}/debug)
 
-    if(NINJA_HOST AND CMAKE_HOST_SYSTEM_NAME STREQUAL "Windows" AND NOT _csc_DISABLE_PARALLEL_CONFIGURE)
+    # With --x-incremental, the build directories stay when the previous build configured them with the same commands
+    # and toolchain; the source path names the archive and patch hashes. Only what changed since is then rebuilt.
+    set(_csc_STAMP_FILE ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-configure.stamp)
+    set(_csc_STAMP "${rel_command}\n${dbg_command}\n${VCPKG_BUILD_TYPE}\n")
+    foreach(_csc_TOOLCHAIN_FILE "${VCPKG_ROOT_DIR}/scripts/buildsystems/vcpkg.cmake" ${VCPKG_CHAINLOAD_TOOLCHAIN_FILE})
+        if(EXISTS "${_csc_TOOLCHAIN_FILE}")
+            file(SHA1 "${_csc_TOOLCHAIN_FILE}" _csc_TOOLCHAIN_HASH)
+            string(APPEND _csc_STAMP "${_csc_TOOLCHAIN_HASH}\n")
+        endif()
+    endforeach()
+    string(SHA1 _csc_STAMP "${_csc_STAMP}")
+    if(_VCPKG_INCREMENTAL AND EXISTS ${_csc_STAMP_FILE})
+        file(READ ${_csc_STAMP_FILE} _csc_PREVIOUS_STAMP)
+        if(_csc_PREVIOUS_STAMP STREQUAL _csc_STAMP)
+            message(STATUS "Keeping the build directories of the previous build of ${TARGET_TRIPLET}")
+            set(_VCPKG_CMAKE_GENERATOR "${GENERATOR}" PARENT_SCOPE)
+            return()
+        endif()
+    endif()
+
+    file(REMOVE ${_csc_STAMP_FILE})
+    file(REMOVE_RECURSE ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-dbg)
+
+    if(NINJA_HOST AND (CMAKE_HOST_SYSTEM_NAME STREQUAL "Windows" OR _VCPKG_PARALLEL_CONFIGURATIONS) AND NOT _csc_DISABLE_PARALLEL_CONFIGURE)
 
         vcpkg_find_acquire_program(NINJA)
         get_filename_component(NINJA_PATH ${NINJA} DIRECTORY)
@@ -236,20 +290,29 @@ function(vcpkg_configure_cmake)
             "rule CreateProcess\n  command = $process\n\n"
         )
 
+        # Ninja runs commands through cmd on Windows and through sh everywhere else
+        if(CMAKE_HOST_WIN32)
+            set(_csc_SHELL_BEGIN "cmd /c \"")
+            set(_csc_SHELL_END "\"")
+        else()
+            set(_csc_SHELL_BEGIN "")
+            set(_csc_SHELL_END "")
+        endif()
+
         if(NOT DEFINED VCPKG_BUILD_TYPE OR VCPKG_BUILD_TYPE STREQUAL "release")
-            set(rel_line "build ../CMakeCache.txt: CreateProcess\n  process = cmd /c \"cd .. &&")
+            set(rel_line "build ../CMakeCache.txt: CreateProcess\n  process = ${_csc_SHELL_BEGIN}cd .. &&")
             foreach(arg ${rel_command})
                 set(rel_line "${rel_line} \"${arg}\"")
             endforeach()
-            set(_contents "${_contents}${rel_line}\"\n\n")
+            set(_contents "${_contents}${rel_line}${_csc_SHELL_END}\n\n")
         endif()
 
         if(NOT DEFINED VCPKG_BUILD_TYPE OR VCPKG_BUILD_TYPE STREQUAL "debug")
-            set(dbg_line "build ../../${TARGET_TRIPLET}-dbg/CMakeCache.txt: CreateProcess\n  process = cmd /c \"cd ../../${TARGET_TRIPLET}-dbg &&")
+            set(dbg_line "build ../../${TARGET_TRIPLET}-dbg/CMakeCache.txt: CreateProcess\n  process = ${_csc_SHELL_BEGIN}cd ../../${TARGET_TRIPLET}-dbg &&")
             foreach(arg ${dbg_command})
                 set(dbg_line "${dbg_line} \"${arg}\"")
             endforeach()
-            set(_contents "${_contents}${dbg_line}\"\n\n")
+            set(_contents "${_contents}${dbg_line}${_csc_SHELL_END}\n\n")
         endif()
 
         file(MAKE_DIRECTORY ${CURRENT_BUILDTREES_DIR}/${TARGET_TRIPLET}-rel/vcpkg-parallel-configure)
@@ -283,5 +346,6 @@ function(vcpkg_configure_cmake)
         endif()
     endif()
 
+    file(WRITE ${_csc_STAMP_FILE} "${_csc_STAMP}")
     set(_VCPKG_CMAKE_GENERATOR "${GENERATOR}" PARENT_SCOPE)
 endfunction()
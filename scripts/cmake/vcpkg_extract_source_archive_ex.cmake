@@ -42,6 +42,10 @@
 ## ### NO_REMOVE_ONE_LEVEL
 ## Specifies that the default removal of the top level folder should not occur.
 ##
+## ## Notes
+## When [`VCPKG_SOURCE_CACHE`](../users/config-environment.md#vcpkg_source_cache) is set, the archive is extracted and
+## patched only once into that directory, and every build copies the result from there.
+##
 ## ## Examples
 ##
 ## * [bzip2](https://github.com/Microsoft/vcpkg/blob/master/ports/bzip2/portfile.cmake)
@@ -50,6 +54,64 @@
 include(vcpkg_apply_patches)
 include(vcpkg_extract_source_archive)
 
+# Extracts _vesae_ARCHIVE into TEMP_DIR, applies _vesae_PATCHES and moves the result to DESTINATION, unless another
+# build created DESTINATION first
+function(_vesae_extract_and_patch TEMP_DIR DESTINATION)
+    file(REMOVE_RECURSE ${TEMP_DIR})
+    vcpkg_extract_source_archive("${_vesae_ARCHIVE}" "${TEMP_DIR}")
+
+    if(_vesae_NO_REMOVE_ONE_LEVEL)
+        set(TEMP_SOURCE_PATH ${TEMP_DIR})
+    else()
+        file(GLOB _ARCHIVE_FILES "${TEMP_DIR}/*")
+        list(LENGTH _ARCHIVE_FILES _NUM_ARCHIVE_FILES)
+        set(TEMP_SOURCE_PATH)
+        foreach(dir IN LISTS _ARCHIVE_FILES)
+            if (IS_DIRECTORY ${dir})
+                set(TEMP_SOURCE_PATH "${dir}")
+                break()
+            endif()
+        endforeach()
+
+        if(NOT _NUM_ARCHIVE_FILES EQUAL 2 OR NOT TEMP_SOURCE_PATH)
+            message(FATAL_ERROR "Could not unwrap top level directory from archive. Pass NO_REMOVE_ONE_LEVEL to disable this.")
+        endif()
+    endif()
+
+    vcpkg_apply_patches(
+        SOURCE_PATH ${TEMP_SOURCE_PATH}
+        PATCHES ${_vesae_PATCHES}
+    )
+
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E rename ${TEMP_SOURCE_PATH} ${DESTINATION}
+        RESULT_VARIABLE error_code
+        OUTPUT_QUIET ERROR_QUIET)
+    if(error_code AND NOT EXISTS ${DESTINATION})
+        message(FATAL_ERROR "Could not move ${TEMP_SOURCE_PATH} to ${DESTINATION}")
+    endif()
+    file(REMOVE_RECURSE ${TEMP_DIR})
+endfunction()
+
+# Copies the cached tree SOURCE to DESTINATION, as copy-on-write clones where the file system supports them. Hard links
+# are never used, since portfiles edit their sources in place.
+function(_vesae_copy_source_tree SOURCE DESTINATION)
+    set(error_code 1)
+    if(CMAKE_HOST_APPLE)
+        execute_process(COMMAND cp -Rc ${SOURCE} ${DESTINATION} RESULT_VARIABLE error_code OUTPUT_QUIET ERROR_QUIET)
+    elseif(CMAKE_HOST_UNIX)
+        execute_process(COMMAND cp -a --reflink=auto ${SOURCE} ${DESTINATION}
+            RESULT_VARIABLE error_code OUTPUT_QUIET ERROR_QUIET)
+    endif()
+    if(error_code)
+        file(REMOVE_RECURSE ${DESTINATION})
+        execute_process(COMMAND ${CMAKE_COMMAND} -E copy_directory ${SOURCE} ${DESTINATION} RESULT_VARIABLE error_code)
+        if(error_code)
+            message(FATAL_ERROR "Could not copy ${SOURCE} to ${DESTINATION}")
+        endif()
+    endif()
+endfunction()
+
 function(vcpkg_extract_source_archive_ex)
     cmake_parse_arguments(_vesae "NO_REMOVE_ONE_LEVEL" "OUT_SOURCE_PATH;ARCHIVE;REF;WORKING_DIRECTORY" "PATCHES" ${ARGN})
 
@@ -88,40 +150,39 @@ function(vcpkg_extract_source_archive_ex)
         string(APPEND PATCHSET_HASH ${CURRENT_HASH})
     endforeach()
 
-    string(SHA512 PATCHSET_HASH ${PATCHSET_HASH})
-    string(SUBSTRING ${PATCHSET_HASH} 0 10 PATCHSET_HASH)
+    string(SHA512 FULL_PATCHSET_HASH ${PATCHSET_HASH})
+    string(SUBSTRING ${FULL_PATCHSET_HASH} 0 10 PATCHSET_HASH)
     set(SOURCE_PATH "${_vesae_WORKING_DIRECTORY}/${SHORTENED_SANITIZED_REF}-${PATCHSET_HASH}")
 
     if(NOT EXISTS ${SOURCE_PATH})
-        set(TEMP_DIR "${_vesae_WORKING_DIRECTORY}/TEMP")
-        file(REMOVE_RECURSE ${TEMP_DIR})
-        vcpkg_extract_source_archive("${_vesae_ARCHIVE}" "${TEMP_DIR}")
+        if(_VCPKG_SOURCE_CACHE)
+            # Unwrapping the top level folder or not changes the tree as much as the patches do
+            string(SHA512 CACHE_KEY "${FULL_PATCHSET_HASH}${_vesae_NO_REMOVE_ONE_LEVEL}")
+            string(SUBSTRING ${CACHE_KEY} 0 32 CACHE_KEY)
+            file(TO_CMAKE_PATH "${_VCPKG_SOURCE_CACHE}" SOURCE_CACHE_DIR)
+            set(CACHED_SOURCE_PATH "${SOURCE_CACHE_DIR}/${CACHE_KEY}")
 
-        if(_vesae_NO_REMOVE_ONE_LEVEL)
-            set(TEMP_SOURCE_PATH ${TEMP_DIR})
-        else()
-            file(GLOB _ARCHIVE_FILES "${TEMP_DIR}/*")
-            list(LENGTH _ARCHIVE_FILES _NUM_ARCHIVE_FILES)
-            set(TEMP_SOURCE_PATH)
-            foreach(dir IN LISTS _ARCHIVE_FILES)
-                if (IS_DIRECTORY ${dir})
-                    set(TEMP_SOURCE_PATH "${dir}")
-                    break()
-                endif()
-            endforeach()
-
-            if(NOT _NUM_ARCHIVE_FILES EQUAL 2 OR NOT TEMP_SOURCE_PATH)
-                message(FATAL_ERROR "Could not unwrap top level directory from archive. Pass NO_REMOVE_ONE_LEVEL to disable this.")
+            # Builds of the same sources for other triplets wait here for the first one to fill the entry. Entries
+            # are still published with a rename, for older vcpkg versions that fill them without the lock.
+            file(MAKE_DIRECTORY "${SOURCE_CACHE_DIR}")
+            file(LOCK "${SOURCE_CACHE_DIR}/${CACHE_KEY}.lock" GUARD FUNCTION TIMEOUT 3600)
+            if(EXISTS ${CACHED_SOURCE_PATH})
+                message(STATUS "Using cached source ${CACHED_SOURCE_PATH}")
+            else()
+                string(RANDOM LENGTH 8 TEMP_SUFFIX)
+                _vesae_extract_and_patch("${SOURCE_CACHE_DIR}/TEMP-${CACHE_KEY}-${TEMP_SUFFIX}" "${CACHED_SOURCE_PATH}")
             endif()
-        endif()
-
-        vcpkg_apply_patches(
-            SOURCE_PATH ${TEMP_SOURCE_PATH}
-            PATCHES ${_vesae_PATCHES}
-        )
+            file(LOCK "${SOURCE_CACHE_DIR}/${CACHE_KEY}.lock" RELEASE)
 
-        file(RENAME ${TEMP_SOURCE_PATH} ${SOURCE_PATH})
-        file(REMOVE_RECURSE ${TEMP_DIR})
+            set(TEMP_DIR "${_vesae_WORKING_DIRECTORY}/TEMP")
+            file(REMOVE_RECURSE ${TEMP_DIR})
+            file(MAKE_DIRECTORY ${TEMP_DIR})
+            _vesae_copy_source_tree("${CACHED_SOURCE_PATH}" "${TEMP_DIR}/src")
+            file(RENAME "${TEMP_DIR}/src" ${SOURCE_PATH})
+            file(REMOVE_RECURSE ${TEMP_DIR})
+        else()
+            _vesae_extract_and_patch("${_vesae_WORKING_DIRECTORY}/TEMP" "${SOURCE_PATH}")
+        endif()
     endif()
 
     set(${_vesae_OUT_SOURCE_PATH} "${SOURCE_PATH}" PARENT_SCOPE)
@@ -9,6 +9,7 @@
 ##     URL <https://android.googlesource.com/platform/external/fdlibm>
 ##     REF <59f7335e4d...>
 ##     SHA512 <abcdef123...>
+##     [HEAD_REF <master>]
 ##     [PATCHES <patch1.patch> <patch2.patch>...]
 ## )
 ## ```
@@ -32,6 +33,12 @@
 ##
 ## For repositories without official releases, this can be set to the full commit id of the current latest master.
 ##
+## ### HEAD_REF
+## The unstable git commit-ish (ideally a branch) to pull for `--head` builds.
+##
+## For most projects, this should be `master`. The chosen branch should be one that is expected to be always buildable
+## on all supported platforms.
+##
 ## ### PATCHES
 ## A list of patches to be applied to the extracted sources.
 ##
@@ -40,12 +47,69 @@
 ## ## Notes:
 ## `OUT_SOURCE_PATH`, `REF`, `SHA512`, and `URL` must be specified.
 ##
+## Every repository is fetched into a bare repository shared by all ports under `downloads/git/`. Only the requested
+## commit is fetched, without its history or tags, so later fetches of the same repository download just the objects
+## that changed.
+##
 ## ## Examples:
 ##
 ## * [fdlibm](https://github.com/Microsoft/vcpkg/blob/master/ports/fdlibm/portfile.cmake)
 
+# Fetches REF from URL into the bare repository shared by every port that uses URL, and sets OUT_COMMIT to the commit
+# it names. The fetched commit is also stored as refs/vcpkg/<REF> so that --no-downloads builds can find it again.
+function(_vcpkg_from_git_fetch OUT_COMMIT URL REF)
+  find_program(GIT NAMES git git.cmd)
+  string(SHA512 URL_HASH "${URL}")
+  string(SUBSTRING "${URL_HASH}" 0 16 URL_HASH)
+  get_filename_component(REPO_NAME "${URL}" NAME_WE)
+  set(GIT_DIR "${DOWNLOADS}/git/${REPO_NAME}-${URL_HASH}")
+  string(REPLACE "/" "-" SANITIZED_REF "${REF}")
+
+  file(MAKE_DIRECTORY "${GIT_DIR}")
+  # Other builds may fetch into the same repository at the same time, and FETCH_HEAD is shared
+  file(LOCK "${GIT_DIR}/vcpkg.lock" GUARD FUNCTION)
+
+  if(NOT EXISTS "${GIT_DIR}/HEAD")
+    vcpkg_execute_required_process(
+      COMMAND ${GIT} init --bare "${GIT_DIR}"
+      WORKING_DIRECTORY "${DOWNLOADS}"
+      LOGNAME git-init
+    )
+  endif()
+
+  if(_VCPKG_NO_DOWNLOADS)
+    set(FETCHED_REF "refs/vcpkg/${SANITIZED_REF}")
+  else()
+    message(STATUS "Fetching ${URL} ${REF}...")
+    vcpkg_execute_required_process(
+      COMMAND ${GIT} --git-dir "${GIT_DIR}" fetch --depth 1 --no-tags "${URL}" "${REF}"
+      WORKING_DIRECTORY "${DOWNLOADS}"
+      LOGNAME git-fetch
+    )
+    vcpkg_execute_required_process(
+      COMMAND ${GIT} --git-dir "${GIT_DIR}" update-ref "refs/vcpkg/${SANITIZED_REF}" FETCH_HEAD
+      WORKING_DIRECTORY "${DOWNLOADS}"
+      LOGNAME git-update-ref
+    )
+    set(FETCHED_REF FETCH_HEAD)
+  endif()
+
+  execute_process(
+    COMMAND ${GIT} --git-dir "${GIT_DIR}" rev-parse --verify --quiet "${FETCHED_REF}^{commit}"
+    OUTPUT_VARIABLE COMMIT
+    OUTPUT_STRIP_TRAILING_WHITESPACE
+    RESULT_VARIABLE error_code
+  )
+  if(error_code)
+    message(FATAL_ERROR "Downloads are disabled, but ${REF} of ${URL} has never been fetched.")
+  endif()
+
+  set(${OUT_COMMIT} "${COMMIT}" PARENT_SCOPE)
+  set(_vcpkg_from_git_dir "${GIT_DIR}" PARENT_SCOPE)
+endfunction()
+
 function(vcpkg_from_git)
-  set(oneValueArgs OUT_SOURCE_PATH URL REF SHA512)
+  set(oneValueArgs OUT_SOURCE_PATH URL REF SHA512 HEAD_REF)
   set(multipleValuesArgs PATCHES)
   cmake_parse_arguments(_vdud "" "${oneValueArgs}" "${multipleValuesArgs}" ${ARGN})
 
@@ -57,6 +121,46 @@ function(vcpkg_from_git)
     message(FATAL_ERROR "The git url must be specified")
   endif()
 
+  if(VCPKG_USE_HEAD_VERSION AND NOT DEFINED _vdud_HEAD_REF)
+    message(STATUS "Package does not specify HEAD_REF. Falling back to non-HEAD version.")
+    set(VCPKG_USE_HEAD_VERSION OFF)
+  endif()
+
+  # The following is for --head scenarios
+  if(VCPKG_USE_HEAD_VERSION)
+    _vcpkg_from_git_fetch(HEAD_COMMIT "${_vdud_URL}" "${_vdud_HEAD_REF}")
+
+    # exports VCPKG_HEAD_VERSION to the caller. This will get picked up by ports.cmake after the build.
+    if(NOT DEFINED VCPKG_HEAD_VERSION)
+      set(VCPKG_HEAD_VERSION ${HEAD_COMMIT} PARENT_SCOPE)
+    endif()
+
+    set(HEAD_ARCHIVE "${DOWNLOADS}/temp/${PORT}-${HEAD_COMMIT}.tar.gz")
+    file(MAKE_DIRECTORY "${DOWNLOADS}/temp")
+    vcpkg_execute_required_process(
+      COMMAND ${GIT} --git-dir "${_vcpkg_from_git_dir}" archive ${HEAD_COMMIT} -o "${HEAD_ARCHIVE}"
+      WORKING_DIRECTORY "${DOWNLOADS}"
+      LOGNAME git-archive
+    )
+
+    if(EXISTS ${CURRENT_BUILDTREES_DIR}/src/head)
+      file(REMOVE_RECURSE ${CURRENT_BUILDTREES_DIR}/src/head)
+    endif()
+    string(REPLACE "/" "-" SANITIZED_HEAD_REF "${_vdud_HEAD_REF}")
+    vcpkg_extract_source_archive_ex(
+      OUT_SOURCE_PATH SOURCE_PATH
+      ARCHIVE "${HEAD_ARCHIVE}"
+      REF "${SANITIZED_HEAD_REF}"
+      WORKING_DIRECTORY ${CURRENT_BUILDTREES_DIR}/src/head
+      PATCHES ${_vdud_PATCHES}
+      NO_REMOVE_ONE_LEVEL
+    )
+    file(REMOVE "${HEAD_ARCHIVE}")
+
+    set(${_vdud_OUT_SOURCE_PATH} "${SOURCE_PATH}" PARENT_SCOPE)
+    return()
+  endif()
+
   if(NOT DEFINED _vdud_REF)
     message(FATAL_ERROR "The git ref must be specified.")
   endif()
@@ -87,23 +191,11 @@ function(vcpkg_from_git)
     if(_VCPKG_NO_DOWNLOADS)
         message(FATAL_ERROR "Downloads are disabled, but '${ARCHIVE}' does not exist.")
     endif()
-    message(STATUS "Fetching ${_vdud_URL}...")
-    find_program(GIT NAMES git git.cmd)
-    # Note: git init is safe to run multiple times
-    vcpkg_execute_required_process(
-      COMMAND ${GIT} init git-tmp
-      WORKING_DIRECTORY ${DOWNLOADS}
-      LOGNAME git-init
-    )
-    vcpkg_execute_required_process(
-      COMMAND ${GIT} fetch ${_vdud_URL} ${_vdud_REF} --depth 1 -n
-      WORKING_DIRECTORY ${DOWNLOADS}/git-tmp
-      LOGNAME git-fetch
-    )
+    _vcpkg_from_git_fetch(COMMIT "${_vdud_URL}" "${_vdud_REF}")
     file(MAKE_DIRECTORY "${DOWNLOADS}/temp")
     vcpkg_execute_required_process(
-      COMMAND ${GIT} archive FETCH_HEAD -o "${TEMP_ARCHIVE}"
-      WORKING_DIRECTORY ${DOWNLOADS}/git-tmp
+      COMMAND ${GIT} --git-dir "${_vcpkg_from_git_dir}" archive ${COMMIT} -o "${TEMP_ARCHIVE}"
+      WORKING_DIRECTORY "${DOWNLOADS}"
       LOGNAME git-archive
     )
     test_hash("${TEMP_ARCHIVE}" "downloaded repo" "")
@@ -134,9 +134,14 @@ function(vcpkg_install_msbuild)
         /p:VCPkgLocalAppDataDisabled=true
         /p:UseIntelMKL=No
         /p:WindowsTargetPlatformVersion=${_csc_TARGET_PLATFORM_VERSION}
-        /m
     )
 
+    if(DEFINED VCPKG_CONCURRENCY)
+        list(APPEND _csc_OPTIONS /m:${VCPKG_CONCURRENCY})
+    else()
+        list(APPEND _csc_OPTIONS /m)
+    endif()
+
     if(VCPKG_LIBRARY_LINKAGE STREQUAL "static")
         # Disable LTCG for static libraries because this setting introduces ABI incompatibility between minor compiler versions
         # TODO: Add a way for the user to override this if they want to opt-in to incompatibility
@@ -9,3 +9,4 @@ message("VCPKG_PLATFORM_TOOLSET=${VCPKG_PLATFORM_TOOLSET}")
 message("VCPKG_VISUAL_STUDIO_PATH=${VCPKG_VISUAL_STUDIO_PATH}")
 message("VCPKG_CHAINLOAD_TOOLCHAIN_FILE=${VCPKG_CHAINLOAD_TOOLCHAIN_FILE}")
 message("VCPKG_BUILD_TYPE=${VCPKG_BUILD_TYPE}")
+message("VCPKG_UNITY_BUILD=${VCPKG_UNITY_BUILD}")
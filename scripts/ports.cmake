@@ -25,8 +25,11 @@ set(DOWNLOADS ${VCPKG_ROOT_DIR}/downloads CACHE PATH "Location to download sourc
 set(PACKAGES_DIR ${VCPKG_ROOT_DIR}/packages CACHE PATH "Location to store package images")
 set(BUILDTREES_DIR ${VCPKG_ROOT_DIR}/buildtrees CACHE PATH "Location to perform actual extract+config+build")
 
-if(PORT)
+# vcpkg passes both to a build that runs next to another build of the same port
+if(PORT AND NOT DEFINED CURRENT_BUILDTREES_DIR)
     set(CURRENT_BUILDTREES_DIR ${BUILDTREES_DIR}/${PORT})
+endif()
+if(PORT AND NOT DEFINED CURRENT_PACKAGES_DIR)
     set(CURRENT_PACKAGES_DIR ${PACKAGES_DIR}/${PORT}_${TARGET_TRIPLET})
 endif()
 
@@ -66,7 +69,29 @@ if(CMD MATCHES "^BUILD$")
     endif()
     file(MAKE_DIRECTORY ${CURRENT_BUILDTREES_DIR} ${CURRENT_PACKAGES_DIR})
 
+    if(DEFINED VCPKG_CONCURRENCY)
+        # Also visible to buildsystems launched through vcpkg_execute_build_process()
+        set(ENV{VCPKG_CONCURRENCY} ${VCPKG_CONCURRENCY})
+        set(ENV{CMAKE_BUILD_PARALLEL_LEVEL} ${VCPKG_CONCURRENCY})
+    endif()
+
+    if(DEFINED _VCPKG_COMPILER_LAUNCHER)
+        # Each launcher reads its cache directory from a variable of its own
+        if(DEFINED _VCPKG_COMPILER_CACHE_DIR)
+            set(ENV{CCACHE_DIR} "${_VCPKG_COMPILER_CACHE_DIR}")
+            set(ENV{SCCACHE_DIR} "${_VCPKG_COMPILER_CACHE_DIR}")
+            set(ENV{CLCACHE_DIR} "${_VCPKG_COMPILER_CACHE_DIR}")
+        endif()
+        # ccache hashes paths below the buildtree relative to it, so builds in another buildtree still hit
+        set(ENV{CCACHE_BASEDIR} "${CURRENT_BUILDTREES_DIR}")
+        set(ENV{CCACHE_STATSLOG} "${_VCPKG_COMPILER_CACHE_LOG}")
+    endif()
+
     include(${CMAKE_TRIPLET_FILE})
+    if(_VCPKG_RELEASE_ONLY)
+        # Set by the releaseonly feature flag, whatever the triplet asks for
+        set(VCPKG_BUILD_TYPE release)
+    endif()
     set(TRIPLET_SYSTEM_ARCH ${VCPKG_TARGET_ARCHITECTURE})
     include(${CURRENT_PORT_DIR}/portfile.cmake)
 
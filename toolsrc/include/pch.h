@@ -24,6 +24,7 @@
 #include <cctype>
 #include <chrono>
 #include <codecvt>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstddef>
 #include <cstdint>
@@ -33,14 +34,17 @@
 #include <experimental/filesystem>
 #endif
 #include <cstring>
+#include <deque>
 #include <fstream>
 #include <functional>
+#include <future>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <queue>
 #include <random>
 #include <regex>
 #include <set>
@@ -2,9 +2,14 @@
 
 #include <CppUnitTest.h>
 
+#include <vcpkg/base/cache.h>
 #include <vcpkg/base/chrono.h>
+#include <vcpkg/base/deflate.h>
+#include <vcpkg/base/hash.h>
+#include <vcpkg/base/lazy.h>
 #include <vcpkg/base/sortedvector.h>
 #include <vcpkg/base/strings.h>
+#include <vcpkg/base/threadpool.h>
 #include <vcpkg/base/util.h>
 #include <vcpkg/binaryparagraph.h>
 #include <vcpkg/dependencies.h>
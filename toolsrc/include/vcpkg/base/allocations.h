@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+/// <summary>
+/// Counts of the memory vcpkg allocates through operator new, by the trace category of the code that allocates it,
+/// kept when vcpkg is given --x-alloc-stats. When it is not, each allocation pays for one relaxed atomic load.
+/// </summary>
+namespace vcpkg::Allocations
+{
+    /// <summary>Starts or stops counting. May be called while other threads allocate.</summary>
+    void set_enabled(bool enabled);
+
+    bool is_enabled();
+
+    struct Totals
+    {
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+    };
+
+    /// <summary>The allocations counted so far in all categories.</summary>
+    Totals get_totals();
+
+    /// <summary>
+    /// Prints the peak resident memory and what was counted, and adds them to the trace. Called as vcpkg exits.
+    /// </summary>
+    void report();
+}
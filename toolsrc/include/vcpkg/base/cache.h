@@ -1,21 +1,61 @@
 #pragma once
 
-#include <map>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 namespace vcpkg
 {
-    template<class Key, class Value>
+    /// <summary>
+    /// Values computed on first use of each key, safe to use from several threads. Keys are hashed over a fixed number
+    /// of shards with a lock each, and the lock is only held to find the slot of a key, so computing one value never
+    /// blocks the lookup of another. Each value is computed once; others asking for the same key wait for it.
+    /// </summary>
+    template<class Key, class Value, class Hash = std::hash<Key>>
     struct Cache
     {
         template<class F>
         Value const& get_lazy(const Key& k, const F& f) const
         {
-            auto it = m_cache.find(k);
-            if (it != m_cache.end()) return it->second;
-            return m_cache.emplace(k, f()).first->second;
+            Shard& shard = m_shards[Hash()(k) % SHARD_COUNT];
+            Slot* slot;
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                // Nodes of an unordered_map never move, so the slot stays valid after the lock is released
+                slot = &shard.slots[k];
+            }
+
+            if (!slot->ready.load(std::memory_order_acquire))
+            {
+                std::lock_guard<std::mutex> lock(slot->mutex);
+                if (!slot->ready.load(std::memory_order_relaxed))
+                {
+                    slot->value = std::make_unique<Value>(f());
+                    slot->ready.store(true, std::memory_order_release);
+                }
+            }
+            return *slot->value;
         }
 
     private:
-        mutable std::map<Key, Value> m_cache;
+        static constexpr size_t SHARD_COUNT = 16;
+
+        struct Slot
+        {
+            std::mutex mutex;
+            std::atomic<bool> ready{false};
+            std::unique_ptr<Value> value;
+        };
+
+        struct Shard
+        {
+            std::mutex mutex;
+            std::unordered_map<Key, Slot, Hash> slots;
+        };
+
+        mutable std::array<Shard, SHARD_COUNT> m_shards;
     };
 }
@@ -4,10 +4,18 @@
 #include <vcpkg/base/lineinfo.h>
 #include <vcpkg/base/strings.h>
 
+#include <functional>
+
 namespace vcpkg::Checks
 {
     void register_console_ctrl_handler();
 
+    /// <summary>
+    /// Runs `hook` on every exit through this namespace, failures included, before the background removals are waited
+    /// for. Hooks finish work that must not be lost, and run in the order they were registered.
+    /// </summary>
+    void register_exit_hook(std::function<void()> hook);
+
     // Indicate that an internal error has occurred and exit the tool. This should be used when invariants have been
     // broken.
     [[noreturn]] void unreachable(const LineInfo& line_info);
@@ -3,6 +3,7 @@
 #include <vcpkg/base/files.h>
 #include <vcpkg/base/machinetype.h>
 
+#include <string>
 #include <vector>
 
 namespace vcpkg::CoffFileReader
@@ -10,16 +11,33 @@ namespace vcpkg::CoffFileReader
     struct DllInfo
     {
         MachineType machine_type;
+        /// <summary>Characteristics of the COFF file header, such as IMAGE_FILE_DLL (0x2000)</summary>
+        uint16_t characteristics;
+        /// <summary>DllCharacteristics of the optional header, such as IMAGE_DLLCHARACTERISTICS_APPCONTAINER</summary>
+        uint16_t dll_characteristics;
+        bool is_app_container;
+        /// <summary>Number of entries in the export address table, including those exported by ordinal only</summary>
+        uint32_t export_count;
+        std::vector<std::string> export_names;
+        /// <summary>Names of the imported and delay loaded DLLs, as they appear in the file</summary>
+        std::vector<std::string> dependencies;
+        /// <summary>PDB path of the CodeView entry in the debug directory, or empty if there is none</summary>
+        std::string pdb_path;
     };
 
     struct LibInfo
     {
         std::vector<MachineType> machine_types;
+        /// <summary>Options from the .drectve sections of the member objects, such as /DEFAULTLIB:LIBCMT</summary>
+        std::vector<std::string> linker_directives;
     };
 
-#if defined(_WIN32)
-    DllInfo read_dll(const fs::path& path);
+    /// <summary>Reads the headers of a PE image from a mapping of it. Works on every host.</summary>
+    DllInfo read_dll(const Files::Filesystem& fs, const fs::path& path);
 
-    LibInfo read_lib(const fs::path& path);
-#endif
+    /// <summary>
+    /// Reads the machine types and linker directives of every member of an archive from a mapping of it, in one pass.
+    /// Works on every host.
+    /// </summary>
+    LibInfo read_lib(const Files::Filesystem& fs, const fs::path& path);
 }
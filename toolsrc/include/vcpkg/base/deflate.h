@@ -0,0 +1,42 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace vcpkg::Deflate
+{
+    /// <summary>Fills at most `capacity` bytes of `buffer` and returns the count; 0 means end of input.</summary>
+    using ReadFn = std::function<size_t(char* buffer, size_t capacity)>;
+    using WriteFn = std::function<void(const char* data, size_t size)>;
+
+    /// <summary>
+    /// Streaming raw deflate (RFC 1951) compressor. Input is buffered into blocks, and each block is emitted as stored,
+    /// fixed or dynamic Huffman coded, whichever is smallest.
+    /// </summary>
+    struct Compressor
+    {
+        explicit Compressor(WriteFn write);
+        ~Compressor();
+
+        Compressor(const Compressor&) = delete;
+        Compressor& operator=(const Compressor&) = delete;
+
+        void write(const char* data, size_t size);
+
+        /// <summary>Compresses the remaining input and terminates the stream. No writes may follow.</summary>
+        void finish();
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> m_impl;
+    };
+
+    /// <summary>
+    /// Decompresses one raw deflate stream. Returns false if the input is corrupt or ends before the final block.
+    /// </summary>
+    bool decompress(const ReadFn& read, const WriteFn& write);
+
+    std::string compress(const std::string& data);
+    bool decompress(const std::string& compressed, std::string& out);
+}
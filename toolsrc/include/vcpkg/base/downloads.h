@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vcpkg/base/files.h>
+#include <vcpkg/base/hash.h>
 
 namespace vcpkg::Downloads
 {
@@ -9,8 +10,87 @@ namespace vcpkg::Downloads
                                      const fs::path& path,
                                      const std::string& sha512);
 
+    /// <summary>
+    /// Downloads `url` into `download_path`, checking its SHA512 as the data arrives. The asset sources are tried
+    /// before `url`, and a file fetched from `url` is stored in the writable ones. A `.part` file left by an
+    /// interrupted download is resumed with an HTTP range request. Large files are fetched over several connections
+    /// when the server supports ranges.
+    /// </summary>
     void download_file(Files::Filesystem& fs,
                        const std::string& url,
                        const fs::path& download_path,
                        const std::string& sha512);
+
+    /// <summary>HTTP GET of `url` into `download_path`. Returns false, leaving no file behind, on any failure.</summary>
+    bool try_download_file(Files::Filesystem& fs, const std::string& url, const fs::path& download_path);
+
+    /// <summary>
+    /// Like try_download_file, but hashes the data as it arrives and also fails when the hash is not `expected_hash`,
+    /// so the file is never read a second time to verify it.
+    /// </summary>
+    bool try_download_file(Files::Filesystem& fs,
+                           const std::string& url,
+                           const fs::path& download_path,
+                           Hash::Algorithm algorithm,
+                           const std::string& expected_hash);
+
+    /// <summary>HTTP HEAD of `url`. Returns true if the server answered with a success status.</summary>
+    bool url_exists(const std::string& url);
+
+    /// <summary>HTTP PUT of the file at `file_path` to `url`.</summary>
+    bool upload_file(const std::string& url, const fs::path& file_path);
+
+    /// <summary>
+    /// A mirror or shared cache of downloaded files, holding each one at `<location>/<sha512>` so that any file with a
+    /// known hash can be looked up regardless of where it originally came from.
+    /// </summary>
+    struct AssetSource
+    {
+        /// <summary>An http(s):// URL prefix or a directory.</summary>
+        std::string location;
+        bool is_url = false;
+        /// <summary>Whether files fetched from elsewhere are stored here for the next client.</summary>
+        bool writable = false;
+    };
+
+    /// <summary>
+    /// Parses a semicolon separated list of asset sources. Entries are http(s):// URLs or directories, optionally
+    /// followed by `,readwrite`.
+    /// </summary>
+    std::vector<AssetSource> parse_asset_sources(const std::string& text);
+
+    /// <summary>The sources in the VCPKG_ASSET_SOURCES environment variable, in the order they are tried.</summary>
+    const std::vector<AssetSource>& asset_sources();
+
+    /// <summary>
+    /// Keeps an index of downloaded files by SHA512 in `index_dir`. Every file fetched with a known hash is also hard
+    /// linked there as `<sha512>`, so that a later request for the same contents under any other name is satisfied by
+    /// another link instead of a second copy. The index is laid out like a directory asset source and is tried before
+    /// the asset sources.
+    /// </summary>
+    void enable_download_index(const fs::path& index_dir);
+
+    /// <summary>The directory given to enable_download_index, or an empty path.</summary>
+    const fs::path& download_index();
+
+    /// <summary>
+    /// Hard links `file`, whose hash is `sha512`, into the download index unless it is already there. Where links are
+    /// not supported nothing is stored, rather than a second copy.
+    /// </summary>
+    void add_to_download_index(Files::Filesystem& fs, const std::string& sha512, const fs::path& file);
+
+    /// <summary>
+    /// Fetches the file with hash `sha512` from the download index or else the first asset source that has it, and
+    /// adds it to the index. Files in directories are hard linked when possible. Returns false, leaving no file
+    /// behind, if none has it.
+    /// </summary>
+    bool try_download_from_asset_sources(Files::Filesystem& fs,
+                                         const std::string& sha512,
+                                         const fs::path& download_path);
+
+    /// <summary>
+    /// Stores `file`, whose hash is `sha512`, in the download index and every writable asset source. Failures are only
+    /// warned about.
+    /// </summary>
+    void store_in_asset_sources(Files::Filesystem& fs, const std::string& sha512, const fs::path& file);
 }
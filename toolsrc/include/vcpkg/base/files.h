@@ -8,6 +8,10 @@
 #include <experimental/filesystem>
 #endif
 
+#include <chrono>
+#include <memory>
+#include <string_view>
+
 namespace fs
 {
     namespace stdfs = std::experimental::filesystem;
@@ -25,16 +29,80 @@ namespace fs
 
 namespace vcpkg::Files
 {
+    /// <summary>
+    /// Read-only contents of a file, valid for the lifetime of the object. Large files are memory mapped.
+    /// </summary>
+    struct MappedFile
+    {
+        virtual ~MappedFile() = default;
+        virtual std::string_view contents() const = 0;
+    };
+
+    /// <summary>
+    /// A MappedFile over text that is already in memory.
+    /// </summary>
+    std::unique_ptr<MappedFile> make_mapped_string(std::string&& text);
+
+    /// <summary>
+    /// A file being written in pieces, for output too large to build in memory first. Writes are buffered, and the
+    /// first error is kept and reported by close().
+    /// </summary>
+    struct OutputFile
+    {
+        virtual ~OutputFile() = default;
+        virtual void write(std::string_view data) = 0;
+        /// <summary>Hands the buffered writes to the operating system, so other processes can read them</summary>
+        virtual void flush() = 0;
+        virtual void close(std::error_code& ec) = 0;
+    };
+
+    /// <summary>
+    /// An exclusive lock on a file, held against every other process and thread that locks the same file, until the
+    /// object is destroyed. The operating system releases it when the process exits, however it exits.
+    /// </summary>
+    struct FileLock
+    {
+        virtual ~FileLock() = default;
+    };
+
+    /// <summary>
+    /// An entry of a directory listing, with what the listing itself reports about it, so that callers do not stat
+    /// each entry again.
+    /// </summary>
+    struct DirectoryEntry
+    {
+        fs::path path;
+        /// <summary>The type of the entry itself, so symlinks are not followed</summary>
+        fs::file_type type;
+        /// <summary>The size of regular files, zero for everything else</summary>
+        uintmax_t size;
+        fs::stdfs::file_time_type last_write_time;
+    };
+
     struct Filesystem
     {
         virtual Expected<std::string> read_contents(const fs::path& file_path) const = 0;
+        virtual Expected<std::unique_ptr<MappedFile>> map_contents(const fs::path& file_path) const = 0;
         virtual Expected<std::vector<std::string>> read_lines(const fs::path& file_path) const = 0;
         virtual fs::path find_file_recursively_up(const fs::path& starting_dir, const std::string& filename) const = 0;
         virtual std::vector<fs::path> get_files_recursive(const fs::path& dir) const = 0;
         virtual std::vector<fs::path> get_files_non_recursive(const fs::path& dir) const = 0;
+        /// <summary>
+        /// Everything below dir, each directory before its contents. Symlinks to directories are not entered.
+        /// </summary>
+        virtual std::vector<DirectoryEntry> get_entries_recursive(const fs::path& dir) const = 0;
+        virtual std::vector<DirectoryEntry> get_entries_non_recursive(const fs::path& dir) const = 0;
 
         virtual void write_lines(const fs::path& file_path, const std::vector<std::string>& lines) = 0;
         virtual void write_contents(const fs::path& file_path, const std::string& data, std::error_code& ec) = 0;
+        /// <summary>Adds `data` to the end of the file with a single write, creating the file if needed.</summary>
+        virtual void append_contents(const fs::path& file_path, const std::string& data, std::error_code& ec) = 0;
+        virtual std::unique_ptr<OutputFile> open_for_write(const fs::path& file_path, std::error_code& ec) = 0;
+        /// <summary>
+        /// Locks lock_path, which is created if needed and left in place. Returns null with `ec` clear when the file is
+        /// locked already and `wait` is false, and null with `ec` set on failure.
+        /// </summary>
+        virtual std::unique_ptr<FileLock> lock_file(const fs::path& lock_path, bool wait, std::error_code& ec) = 0;
         virtual void rename(const fs::path& oldpath, const fs::path& newpath) = 0;
         virtual void rename(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) = 0;
         virtual void rename_or_copy(const fs::path& oldpath,
@@ -56,6 +124,12 @@ namespace vcpkg::Files
                                fs::copy_options opts,
                                std::error_code& ec) = 0;
         virtual void copy_symlink(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) = 0;
+        virtual void create_hard_link(const fs::path& target, const fs::path& link, std::error_code& ec) = 0;
+        /// <summary>
+        /// Creates newpath as a copy-on-write clone of oldpath, sharing its data blocks. Fails with
+        /// operation_not_supported where the platform or the file system cannot do that; newpath must not exist.
+        /// </summary>
+        virtual void clone_file(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) = 0;
         virtual fs::file_status status(const fs::path& path, std::error_code& ec) const = 0;
         virtual fs::file_status symlink_status(const fs::path& path, std::error_code& ec) const = 0;
 
@@ -66,6 +140,46 @@ namespace vcpkg::Files
 
     Filesystem& get_real_filesystem();
 
+    /// <summary>
+    /// Makes get_real_filesystem count the calls of each method, the bytes they read or write and the time they take,
+    /// by method and by the trace scope they were made in. Set by --x-fs-stats, before any other thread starts.
+    /// </summary>
+    void enable_statistics();
+
+    /// <summary>Prints what enable_statistics counted and adds it to the trace. Called as vcpkg exits.</summary>
+    void report_statistics();
+
+    /// <summary>
+    /// A Filesystem over `inner` that remembers the status of every path it is asked about, until something is written
+    /// through it. Only for commands that read: files that other processes change would keep their old status.
+    /// </summary>
+    std::unique_ptr<Filesystem> make_stat_caching_filesystem(Filesystem& inner);
+
+    /// <summary>
+    /// A Filesystem that keeps its tree in memory, for benchmarks that simulate a network share. Every call is counted,
+    /// so tests can pin down how many an operation makes, and first waits the latency of a round trip to the server.
+    /// Walking a tree costs a round trip per directory. Nothing is ever found on the PATH.
+    /// </summary>
+    struct MemoryFilesystem : Filesystem
+    {
+        /// <summary>How long each call waits; none at first</summary>
+        virtual void set_latency(std::chrono::microseconds latency) = 0;
+        virtual uint64_t call_count() const = 0;
+        virtual void reset_call_count() = 0;
+    };
+
+    std::unique_ptr<MemoryFilesystem> make_memory_filesystem();
+
+    /// <summary>
+    /// Moves `dir` into `scratch_root`/.trash and removes it from there on a background thread of low priority, so that
+    /// removing a large tree does not hold up the caller. `scratch_root` should be on the volume of `dir`; where the
+    /// move fails, `dir` is removed at once.
+    /// </summary>
+    void remove_all_in_background(Filesystem& fs, const fs::path& dir, const fs::path& scratch_root);
+
+    /// <summary>Blocks until every directory given to remove_all_in_background is gone; called as vcpkg exits</summary>
+    void wait_for_background_removals();
+
     static constexpr const char* FILESYSTEM_INVALID_CHARACTERS = R"(\/:*?"<>|)";
 
     bool has_invalid_chars_for_filesystem(const std::string& s);
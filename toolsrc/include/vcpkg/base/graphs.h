@@ -1,7 +1,9 @@
 #pragma once
 
+#include <algorithm>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <vcpkg/base/checks.h>
 #include <vcpkg/base/span.h>
@@ -31,60 +33,125 @@ namespace vcpkg::Graphs
 
     namespace details
     {
-        template<class V, class U>
-        void topological_sort_internal(const V& vertex,
-                                       const AdjacencyProvider<V, U>& f,
-                                       std::unordered_map<V, ExplorationStatus>& exploration_status,
-                                       std::vector<U>& sorted)
+        template<class V, class U, class Neighbours>
+        struct TopologicalSortFrame
         {
-            ExplorationStatus& status = exploration_status[vertex];
-            switch (status)
-            {
-                case ExplorationStatus::FULLY_EXPLORED: return;
-                case ExplorationStatus::PARTIALLY_EXPLORED:
+            V vertex;
+            ExplorationStatus* status;
+            U data;
+            Neighbours neighbours;
+            size_t next_neighbour;
+        };
+
+        /// <summary>
+        /// Depth-first search from `starting_vertices` that calls `on_finish(vertex, data, neighbours)` once all
+        /// neighbours of a vertex have finished. Keeps its own stack, so long chains of dependencies cannot overflow
+        /// the call stack. A cycle is reported as the path that closes it, and ends the program.
+        /// </summary>
+        template<class VertexRange, class Provider, class OnFinish>
+        void depth_first_search(const VertexRange& starting_vertices, const Provider& f, OnFinish on_finish)
+        {
+            using V = std::decay_t<decltype(*std::begin(starting_vertices))>;
+            using U = std::decay_t<decltype(f.load_vertex_data(std::declval<const V&>()))>;
+            using Neighbours = std::decay_t<decltype(f.adjacency_list(std::declval<const U&>()))>;
+            using Frame = TopologicalSortFrame<V, U, Neighbours>;
+
+            std::unordered_map<V, ExplorationStatus> exploration_status;
+            std::vector<Frame> path;
+
+            const auto visit = [&](const V& vertex) {
+                ExplorationStatus& status = exploration_status[vertex];
+                switch (status)
                 {
-                    System::println("Cycle detected within graph:");
-                    for (auto&& node : exploration_status)
+                    case ExplorationStatus::FULLY_EXPLORED: return;
+                    case ExplorationStatus::PARTIALLY_EXPLORED:
+                    {
+                        System::println("Cycle detected within graph:");
+                        auto it = std::find_if(
+                            path.begin(), path.end(), [&](const Frame& frame) { return frame.vertex == vertex; });
+                        for (; it != path.end(); ++it)
+                            System::println("    %s", f.to_string(it->vertex));
+                        System::println("    %s", f.to_string(vertex));
+                        Checks::exit_fail(VCPKG_LINE_INFO);
+                    }
+                    case ExplorationStatus::NOT_EXPLORED:
                     {
-                        if (node.second == ExplorationStatus::PARTIALLY_EXPLORED)
-                        {
-                            System::println("    %s", f.to_string(node.first));
-                        }
+                        status = ExplorationStatus::PARTIALLY_EXPLORED;
+                        U vertex_data = f.load_vertex_data(vertex);
+                        Neighbours neighbours = f.adjacency_list(vertex_data);
+                        path.push_back(Frame{vertex, &status, std::move(vertex_data), std::move(neighbours), 0});
+                        return;
                     }
-                    Checks::exit_fail(VCPKG_LINE_INFO);
+                    default: Checks::unreachable(VCPKG_LINE_INFO);
                 }
-                case ExplorationStatus::NOT_EXPLORED:
+            };
+
+            for (auto&& vertex : starting_vertices)
+            {
+                visit(vertex);
+                while (!path.empty())
                 {
-                    status = ExplorationStatus::PARTIALLY_EXPLORED;
-                    U vertex_data = f.load_vertex_data(vertex);
-                    for (const V& neighbour : f.adjacency_list(vertex_data))
-                        topological_sort_internal(neighbour, f, exploration_status, sorted);
-
-                    sorted.push_back(std::move(vertex_data));
-                    status = ExplorationStatus::FULLY_EXPLORED;
-                    return;
+                    Frame& frame = path.back();
+                    if (frame.next_neighbour < frame.neighbours.size())
+                    {
+                        // Copied, since visiting it may reallocate the path that holds the frame
+                        const V neighbour = frame.neighbours[frame.next_neighbour++];
+                        visit(neighbour);
+                        continue;
+                    }
+
+                    *frame.status = ExplorationStatus::FULLY_EXPLORED;
+                    on_finish(frame.vertex, std::move(frame.data), frame.neighbours);
+                    path.pop_back();
                 }
-                default: Checks::unreachable(VCPKG_LINE_INFO);
             }
         }
     }
 
-    template<class VertexRange, class V, class U>
-    std::vector<U> topological_sort(const VertexRange& starting_vertices, const AdjacencyProvider<V, U>& f)
+    /// <summary>
+    /// Orders the vertices reachable from `starting_vertices` so that each comes after all of its neighbours.
+    /// </summary>
+    /// <param name="f">An AdjacencyProvider, or anything else with the same members such as a Graph.</param>
+    template<class VertexRange, class Provider>
+    auto topological_sort(const VertexRange& starting_vertices, const Provider& f)
     {
-        std::vector<U> sorted;
-        std::unordered_map<V, ExplorationStatus> exploration_status;
-
-        for (auto&& vertex : starting_vertices)
-        {
-            details::topological_sort_internal(vertex, f, exploration_status, sorted);
-        }
+        using V = std::decay_t<decltype(*std::begin(starting_vertices))>;
+        using U = std::decay_t<decltype(f.load_vertex_data(std::declval<const V&>()))>;
 
+        std::vector<U> sorted;
+        details::depth_first_search(
+            starting_vertices, f, [&](const V&, U&& data, const auto&) { sorted.push_back(std::move(data)); });
         return sorted;
     }
 
+    /// <summary>
+    /// Groups the vertices reachable from `starting_vertices` into levels. Level 0 holds the vertices without
+    /// neighbours and every other vertex is one level above its highest neighbour, so the vertices of a level do not
+    /// depend on each other and can be processed concurrently once the levels below are done.
+    /// </summary>
+    /// <param name="f">An AdjacencyProvider, or anything else with the same members such as a Graph.</param>
+    template<class VertexRange, class Provider>
+    auto topological_levels(const VertexRange& starting_vertices, const Provider& f)
+    {
+        using V = std::decay_t<decltype(*std::begin(starting_vertices))>;
+        using U = std::decay_t<decltype(f.load_vertex_data(std::declval<const V&>()))>;
+
+        std::vector<std::vector<U>> levels;
+        std::unordered_map<V, size_t> level_of;
+        details::depth_first_search(starting_vertices, f, [&](const V& vertex, U&& data, const auto& neighbours) {
+            size_t level = 0;
+            for (auto&& neighbour : neighbours)
+                level = std::max(level, level_of.at(neighbour) + 1);
+            level_of.emplace(vertex, level);
+
+            if (levels.size() <= level) levels.resize(level + 1);
+            levels[level].push_back(std::move(data));
+        });
+        return levels;
+    }
+
     template<class V>
-    struct Graph final : AdjacencyProvider<V, V>
+    struct Graph final
     {
     public:
         void add_vertex(const V& v) { this->m_edges[v]; }
@@ -92,7 +159,8 @@ namespace vcpkg::Graphs
         void add_edge(const V& u, const V& v)
         {
             this->m_edges[v];
-            this->m_edges[u].insert(v);
+            auto& adjacency = this->m_edges[u];
+            if (std::find(adjacency.begin(), adjacency.end(), v) == adjacency.end()) adjacency.push_back(v);
         }
 
         std::vector<V> vertex_list() const
@@ -103,19 +171,16 @@ namespace vcpkg::Graphs
             return vertex_list;
         }
 
-        std::vector<V> adjacency_list(const V& vertex) const override
-        {
-            const std::unordered_set<V>& as_set = this->m_edges.at(vertex);
-            return std::vector<V>(as_set.cbegin(), as_set.cend()); // TODO: Avoid redundant copy
-        }
+        Span<const V> adjacency_list(const V& vertex) const { return this->m_edges.at(vertex); }
 
-        V load_vertex_data(const V& vertex) const override { return vertex; }
+        V load_vertex_data(const V& vertex) const { return vertex; }
 
         // Note: this function indicates how tied this template is to the exact type it will be templated upon.
         // Possible fix: This type shouldn't implement to_string() and should instead be derived from?
-        std::string to_string(const V& spec) const override { return spec->spec.to_string(); }
+        std::string to_string(const V& spec) const { return spec->spec.to_string(); }
 
     private:
-        std::unordered_map<V, std::unordered_set<V>> m_edges;
+        // Neighbours in the order their edges were added, so plans do not depend on hash values
+        std::unordered_map<V, std::vector<V>> m_edges;
     };
 }
@@ -1,11 +1,62 @@
 #pragma once
 
 #include <vcpkg/base/files.h>
+#include <vcpkg/base/optional.h>
 
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace vcpkg::Hash
 {
+    enum class Algorithm
+    {
+        SHA1,
+        SHA256,
+        SHA512,
+    };
+
+    /// <summary>Parses `SHA1`, `SHA256` or `SHA512`, in any case.</summary>
+    Optional<Algorithm> algorithm_from_string(const std::string& hash_type);
+
+    /// <summary>
+    /// An incremental hasher. SHA-1 and SHA-256 use the x86 SHA extensions when the CPU has them.
+    /// </summary>
+    struct Hasher
+    {
+        virtual ~Hasher() {}
+
+        virtual void add_bytes(const void* data, size_t size) = 0;
+
+        /// <summary>Returns the lowercase hex digest of the bytes added so far, and starts over.</summary>
+        virtual std::string get_hash() = 0;
+
+        virtual void clear() = 0;
+    };
+
+    std::unique_ptr<Hasher> get_hasher_for(Algorithm algorithm);
+
+    /// <summary>
+    /// `hash_type` for get_file_hash: the SHA1 of the file as a git blob, which is the object id that `git hash-object`
+    /// prints for it.
+    /// </summary>
+    constexpr const char* GIT_BLOB = "GITBLOB";
+
+    /// <summary>Hashes the bytes of `s` in process; any content is allowed.</summary>
     std::string get_string_hash(const std::string& s, const std::string& hash_type);
     std::string get_file_hash(const Files::Filesystem& fs, const fs::path& path, const std::string& hash_type);
+
+    /// <summary>
+    /// Makes get_file_hash remember the hashes it computes in `cache_file`, keyed by path, size, write time and hash
+    /// type, so that files left unchanged since an earlier run are not hashed again.
+    /// </summary>
+    void enable_file_hash_cache(const fs::path& cache_file);
+
+    /// <summary>
+    /// Makes get_file_hash answer GIT_BLOB for the files under `pathspecs` of the git checkout `worktree` from its
+    /// index, without reading them. The ids are listed with one git command the first time they are needed; files
+    /// that git sees as modified, or whose line endings git converts, are hashed as before. Does nothing if
+    /// `worktree` is not a checkout or git cannot be run.
+    /// </summary>
+    void enable_git_blob_ids(const fs::path& worktree, std::vector<std::string> pathspecs);
 }
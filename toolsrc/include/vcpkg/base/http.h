@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vcpkg/base/expected.h>
+#include <vcpkg/base/files.h>
+#include <vcpkg/base/optional.h>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// <summary>
+/// A built-in HTTP/1.1 client for the platforms without WinHTTP. Connections are kept alive and pooled per host, so a
+/// series of requests to one server pays for the TCP and TLS handshakes once. https:// needs vcpkg to be built with
+/// OpenSSL (VCPKG_BUILTIN_HTTPS).
+/// </summary>
+namespace vcpkg::Http
+{
+    struct Request
+    {
+        std::string method = "GET";
+        std::string url;
+        /// <summary>Extra headers, each `Name: value`.</summary>
+        std::vector<std::string> headers;
+        /// <summary>A file sent as the request body, if not empty.</summary>
+        fs::path upload;
+        /// <summary>Where the part of `upload` that is sent starts, and its length unless it is the rest.</summary>
+        uint64_t upload_offset = 0;
+        Optional<uint64_t> upload_length;
+        /// <summary>The request body when there is no `upload`.</summary>
+        std::string body;
+    };
+
+    struct Response
+    {
+        int status = 0;
+        /// <summary>Header names are lowercase; a repeated header keeps its last value.</summary>
+        std::map<std::string, std::string> headers;
+
+        bool is_success() const { return status >= 200 && status < 300; }
+    };
+
+    using BodyCallback = std::function<void(std::string_view)>;
+
+    /// <summary>
+    /// Whether `url` can be fetched by this client: http:// always and https:// when built with TLS, but neither when
+    /// a proxy is configured in the environment, since proxies are left to curl.
+    /// </summary>
+    bool is_supported(const std::string& url);
+
+    /// <summary>
+    /// Sends `request`, following redirects for GET and HEAD. `wants_body` sees the final response before its body
+    /// arrives and decides whether the body goes to `on_body` or is discarded. Returns an error message if no
+    /// response could be received.
+    /// </summary>
+    ExpectedT<Response, std::string> send(const Request& request,
+                                          const std::function<bool(const Response&)>& wants_body,
+                                          const BodyCallback& on_body);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vcpkg::Json
+{
+    /// <summary>Appends `s` to `out` as a JSON string, quotes included.</summary>
+    void append_string(std::string& out, std::string_view s);
+
+    /// <summary>
+    /// Writes one JSON document a value at a time, adding the commas and escapes. The text is collected in a buffer
+    /// that is handed to the sink whenever it passes 64 KiB and when the document is complete, so a large document
+    /// never has to be held whole.
+    /// </summary>
+    struct Writer
+    {
+        /// <summary>Writes to standard output.</summary>
+        Writer();
+        explicit Writer(std::function<void(std::string_view)> sink);
+        ~Writer();
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        Writer& start_object();
+        Writer& end_object();
+        Writer& start_array();
+        Writer& end_array();
+
+        /// <summary>Names the member of the enclosing object that the next value is written to.</summary>
+        Writer& key(std::string_view name);
+
+        Writer& string(std::string_view s);
+        Writer& number(int64_t n);
+        Writer& boolean(bool b);
+        Writer& null();
+
+        /// <summary>Hands what has been written so far to the sink.</summary>
+        void flush();
+
+    private:
+        void start_value();
+        void end_value();
+
+        std::function<void(std::string_view)> m_sink;
+        std::string m_buffer;
+        /// <summary>For each object and array that is still open, whether it has a member yet.</summary>
+        std::vector<bool> m_has_members;
+        bool m_after_key = false;
+    };
+}
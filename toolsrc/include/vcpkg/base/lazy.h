@@ -1,26 +1,41 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
+
 namespace vcpkg
 {
+    /// <summary>
+    /// A value computed on first use. When several threads ask at once, one of them computes it and the others wait.
+    /// </summary>
     template<typename T>
     class Lazy
     {
     public:
         Lazy() : value(T()), initialized(false) {}
 
+        /// <summary>Moves the value if it was computed; otherwise the new Lazy computes it on first use.</summary>
+        Lazy(Lazy&& other) : value(std::move(other.value)), initialized(other.initialized.load()) {}
+
         template<class F>
         T const& get_lazy(const F& f) const
         {
-            if (!initialized)
+            if (!initialized.load(std::memory_order_acquire))
             {
-                value = f();
-                initialized = true;
+                // Not std::call_once: libstdc++ cannot run it again after the function throws (GCC PR 66146)
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!initialized.load(std::memory_order_relaxed))
+                {
+                    value = f();
+                    initialized.store(true, std::memory_order_release);
+                }
             }
             return value;
         }
 
     private:
         mutable T value;
-        mutable bool initialized;
+        mutable std::atomic<bool> initialized;
+        mutable std::mutex mutex;
     };
 }
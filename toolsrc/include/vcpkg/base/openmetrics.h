@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vcpkg/base/files.h>
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Counters and histograms of the run, written when vcpkg is given --x-openmetrics-file. The file is in the Prometheus
+/// text format read by the node_exporter textfile collector, and is replaced atomically so that the collector never
+/// reads half of it. Unlike Metrics, nothing is sent anywhere.
+/// </summary>
+namespace vcpkg::OpenMetrics
+{
+    using Labels = std::vector<std::pair<std::string, std::string>>;
+
+    /// <summary>Starts collecting. The metrics are written to `path` when vcpkg exits.</summary>
+    void enable(const fs::path& path);
+
+    bool is_enabled();
+
+    /// <summary>
+    /// Adds `value` to the counter `name`, which ends in _total, for `labels`. `help` describes the metric in the
+    /// file; the first one given for a name is kept. Does nothing unless collecting is enabled.
+    /// </summary>
+    void add_counter(const char* name, const char* help, Labels labels, double value = 1.0);
+
+    /// <summary>
+    /// Records one observation of the histogram `name`, which ends in _seconds, for `labels`. The buckets go from a
+    /// tenth of a second to an hour. Does nothing unless collecting is enabled.
+    /// </summary>
+    void observe_seconds(const char* name, const char* help, Labels labels, std::chrono::microseconds duration);
+
+    /// <summary>Writes the metrics collected so far, if collecting is enabled.</summary>
+    void write();
+}
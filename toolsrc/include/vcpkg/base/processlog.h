@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vcpkg/base/chrono.h>
+#include <vcpkg/base/files.h>
+
+#include <string>
+
+/// <summary>
+/// Every process vcpkg starts, recorded when vcpkg is given --x-process-log. The file has one JSON object per line
+/// and per process, in the order they were started, with the command line, working directory, trace category, start
+/// time and duration in microseconds since vcpkg started, exit code and bytes of output read from the process.
+/// </summary>
+namespace vcpkg::ProcessLog
+{
+    /// <summary>Starts recording. The processes are written to `path` when vcpkg exits.</summary>
+    void enable(const fs::path& path);
+
+    bool is_enabled();
+
+    /// <summary>
+    /// One process, from just before it is started until finish is called. Does nothing unless recording is enabled.
+    /// </summary>
+    struct Spawn
+    {
+        explicit Spawn(std::string command_line);
+
+        Spawn(const Spawn&) = delete;
+        Spawn& operator=(const Spawn&) = delete;
+
+        void add_output(size_t bytes) { m_output_bytes += bytes; }
+
+        /// <summary>Records the process as exited with `exit_code`.</summary>
+        void finish(int exit_code);
+
+    private:
+        std::string m_command_line;
+        std::string m_cwd;
+        const char* m_category;
+        double m_start_us;
+        uint64_t m_output_bytes = 0;
+    };
+
+    /// <summary>Writes the processes recorded so far, if recording is enabled.</summary>
+    void write();
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vcpkg/base/files.h>
+#include <vcpkg/base/optional.h>
+
+#include <string>
+#include <vector>
+
+/// <summary>
+/// A client for S3 and the object stores compatible with it, signing its requests with AWS Signature Version 4.
+/// Objects are addressed path-style, `<endpoint>/<bucket>/<key>`, which every compatible store accepts. Large objects
+/// are uploaded in parts and downloaded in ranges over several connections at once when vcpkg's built-in HTTP client
+/// can reach the endpoint; otherwise each transfer is a single request through curl.
+/// </summary>
+namespace vcpkg::S3
+{
+    struct Credentials
+    {
+        std::string access_key_id;
+        std::string secret_access_key;
+        /// <summary>Set for temporary credentials only.</summary>
+        std::string session_token;
+    };
+
+    struct Bucket
+    {
+        /// <summary>
+        /// The bucket `name` at AWS_ENDPOINT_URL, or at AWS itself in the region AWS_REGION or AWS_DEFAULT_REGION
+        /// (default us-east-1). Requests are signed with AWS_ACCESS_KEY_ID, AWS_SECRET_ACCESS_KEY and
+        /// AWS_SESSION_TOKEN, and sent anonymously when these are not set.
+        /// </summary>
+        static Bucket from_environment(const std::string& name);
+
+        /// <summary>`endpoint` is an http(s):// URL without a path.</summary>
+        Bucket(const std::string& endpoint, std::string region, std::string name, Optional<Credentials> credentials);
+
+        /// <summary>`s3://<bucket>/<key>`, for messages.</summary>
+        std::string location(const std::string& key) const;
+
+        /// <summary>
+        /// HEAD of the object. Callers on several threads keep several requests in flight, each on a connection of
+        /// its own that is kept open for the next one.
+        /// </summary>
+        bool exists(const std::string& key) const;
+
+        /// <summary>
+        /// Downloads the object to `destination`, in ranges at once if it is large. Returns false, leaving no file
+        /// behind, if there is no such object or the download fails.
+        /// </summary>
+        bool download(const std::string& key, const fs::path& destination) const;
+
+        /// <summary>
+        /// Uploads `file` as the object, as a multipart upload whose parts are sent at once if it is large. Failures
+        /// are printed.
+        /// </summary>
+        bool upload(const std::string& key, const fs::path& file) const;
+
+    private:
+        struct Target
+        {
+            std::string url;
+            std::string canonical_uri;
+            std::string canonical_query;
+        };
+
+        Target target(const std::string& key, const std::string& canonical_query = {}) const;
+
+        /// <summary>The headers that authenticate a request to `target`, each `Name: value`.</summary>
+        std::vector<std::string> sign(const std::string& method,
+                                      const Target& target,
+                                      const std::string& payload_hash) const;
+
+        bool uses_builtin_client() const;
+
+        Optional<uint64_t> native_size(const Target& target) const;
+        bool native_download(const Target& target, uint64_t size, const fs::path& destination) const;
+        bool native_multipart_upload(const std::string& key, const fs::path& file, uint64_t size) const;
+
+        std::string m_endpoint;
+        std::string m_host;
+        std::string m_region;
+        std::string m_name;
+        Optional<Credentials> m_credentials;
+    };
+}
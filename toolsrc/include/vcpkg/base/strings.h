@@ -3,6 +3,9 @@
 #include <vcpkg/base/cstringview.h>
 #include <vcpkg/base/stringliteral.h>
 
+#include <cstring>
+#include <iterator>
+#include <string_view>
 #include <vector>
 
 namespace vcpkg::Strings::details
@@ -23,16 +26,34 @@ namespace vcpkg::Strings::details
         return s;
     }
 
-    std::string format_internal(const char* fmtstr, ...);
+    void append_internal(std::string& output, const char* fmtstr, ...);
+
+    inline size_t length_of(const std::string& s) { return s.size(); }
+
+    inline size_t length_of(const StringLiteral& s) { return s.size(); }
+
+    inline size_t length_of(const char* s) { return std::strlen(s); }
 }
 
 namespace vcpkg::Strings
 {
+    /// <summary>
+    /// Appends the formatted text to `output`. Building a large string with this in a loop allocates far less than
+    /// concatenating the results of format().
+    /// </summary>
     template<class... Args>
-    std::string format(const char* fmtstr, const Args&... args)
+    void append_to(std::string& output, const char* fmtstr, const Args&... args)
     {
         using vcpkg::Strings::details::to_printf_arg;
-        return details::format_internal(fmtstr, to_printf_arg(to_printf_arg(args))...);
+        details::append_internal(output, fmtstr, to_printf_arg(to_printf_arg(args))...);
+    }
+
+    template<class... Args>
+    std::string format(const char* fmtstr, const Args&... args)
+    {
+        std::string output;
+        append_to(output, fmtstr, args...);
+        return output;
     }
 
 #if defined(_WIN32)
@@ -43,6 +64,27 @@ namespace vcpkg::Strings
 
     std::string escape_string(const CStringView& s, char char_to_escape, char escape_char);
 
+    /// <summary>
+    /// A set of characters as a lookup table, for checks that would otherwise be a regex character class. Testing a
+    /// string against it is a single pass that allocates nothing.
+    /// </summary>
+    struct AsciiSet
+    {
+        constexpr AsciiSet(const char* chars) : m_table()
+        {
+            for (; *chars != '\0'; ++chars)
+                m_table[static_cast<unsigned char>(*chars)] = true;
+        }
+
+        constexpr bool contains(const char c) const { return m_table[static_cast<unsigned char>(c)]; }
+
+        bool contains_any_of(const std::string& s) const;
+        bool contains_only(const std::string& s) const;
+
+    private:
+        bool m_table[256];
+    };
+
     std::string::const_iterator case_insensitive_ascii_find(const std::string& s, const std::string& pattern);
 
     bool case_insensitive_ascii_contains(const std::string& s, const std::string& pattern);
@@ -56,32 +98,47 @@ namespace vcpkg::Strings
     bool case_insensitive_ascii_starts_with(const std::string& s, const std::string& pattern);
     bool ends_with(const std::string& s, StringLiteral pattern);
 
-    template<class Container, class Transformer>
-    std::string join(const char* delimiter, const Container& v, Transformer transformer)
+    /// <summary>
+    /// Appends the elements of `v` to `output`, separated by `delimiter`. `appender(output, element)` writes each
+    /// element in place, so no temporary string is built per element.
+    /// </summary>
+    template<class Container, class Appender>
+    void join_to(std::string& output, const char* delimiter, const Container& v, Appender appender)
     {
         const auto begin = v.begin();
         const auto end = v.end();
 
-        if (begin == end)
+        for (auto it = begin; it != end; ++it)
         {
-            return std::string();
+            if (it != begin) output.append(delimiter);
+            appender(output, *it);
         }
+    }
 
+    template<class Container, class Transformer>
+    std::string join(const char* delimiter, const Container& v, Transformer transformer)
+    {
         std::string output;
-        output.append(transformer(*begin));
-        for (auto it = std::next(begin); it != end; ++it)
-        {
-            output.append(delimiter);
-            output.append(transformer(*it));
-        }
-
+        join_to(output, delimiter, v, [&](std::string& out, const auto& x) { out.append(transformer(x)); });
         return output;
     }
+
     template<class Container>
     std::string join(const char* delimiter, const Container& v)
     {
-        using Element = decltype(*v.begin());
-        return join(delimiter, v, [](const Element& x) -> const Element& { return x; });
+        size_t count = 0;
+        size_t length = 0;
+        for (auto&& x : v)
+        {
+            ++count;
+            length += details::length_of(x);
+        }
+        if (count > 1) length += (count - 1) * std::strlen(delimiter);
+
+        std::string output;
+        output.reserve(length);
+        join_to(output, delimiter, v, [](std::string& out, const auto& x) { out.append(x); });
+        return output;
     }
 
     std::string replace_all(std::string&& s, const std::string& search, const std::string& rep);
@@ -92,6 +149,62 @@ namespace vcpkg::Strings
 
     std::vector<std::string> split(const std::string& s, const std::string& delimiter);
 
+    /// <summary>
+    /// The pieces of a string between occurrences of a delimiter, as views into it, found one at a time while the
+    /// range is iterated. The same pieces as split(), which copies each of them.
+    /// </summary>
+    struct SplitRange
+    {
+        struct iterator
+        {
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::string_view;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const std::string_view*;
+            using reference = const std::string_view&;
+
+            iterator() = default;
+            iterator(std::string_view rest, std::string_view delimiter);
+
+            reference operator*() const { return m_piece; }
+            pointer operator->() const { return &m_piece; }
+            iterator& operator++();
+            iterator operator++(int)
+            {
+                iterator ret = *this;
+                ++*this;
+                return ret;
+            }
+
+            bool operator==(const iterator& other) const
+            {
+                return m_piece.data() == other.m_piece.data() && m_at_end == other.m_at_end;
+            }
+            bool operator!=(const iterator& other) const { return !(*this == other); }
+
+        private:
+            /// <summary>The current piece and everything after it</summary>
+            std::string_view m_rest;
+            std::string_view m_delimiter;
+            std::string_view m_piece;
+            bool m_at_end = true;
+        };
+
+        SplitRange(std::string_view s, std::string_view delimiter) : m_s(s), m_delimiter(delimiter) {}
+
+        iterator begin() const { return iterator(m_s, m_delimiter); }
+        iterator end() const { return iterator(); }
+
+        std::vector<std::string_view> to_vector() const { return {begin(), end()}; }
+
+    private:
+        std::string_view m_s;
+        std::string_view m_delimiter;
+    };
+
+    /// <summary>The views must outlive the range, which keeps no copy of either.</summary>
+    inline SplitRange split_view(std::string_view s, std::string_view delimiter) { return SplitRange(s, delimiter); }
+
     template<class T>
     std::string serialize(const T& t)
     {
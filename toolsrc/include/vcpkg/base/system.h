@@ -1,5 +1,8 @@
 #pragma once
 
+#include <chrono>
+#include <functional>
+#include <string_view>
 #include <unordered_map>
 
 #include <vcpkg/base/files.h>
@@ -40,6 +43,72 @@ namespace vcpkg::System
 
     ExitCodeAndOutput cmd_execute_and_capture_output(const CStringView cmd_line) noexcept;
 
+    using OutputCallback = std::function<void(std::string_view)>;
+
+    /// <summary>
+    /// Runs cmd_line like cmd_execute_clean, but passes its stdout and stderr together to on_output as they arrive
+    /// instead of letting them reach the console.
+    /// </summary>
+    int cmd_execute_clean(const CStringView cmd_line,
+                          const std::unordered_map<std::string, std::string>& extra_env,
+                          const OutputCallback& on_output) noexcept;
+
+    struct ProcessExit
+    {
+        int exit_code;
+        bool timed_out;
+        /// <summary>
+        /// Peak memory in KiB, or 0 if unknown. On Windows, the committed memory of the process and its descendants
+        /// together; elsewhere, the resident memory of the largest of them.
+        /// </summary>
+        uint64_t peak_memory_kib = 0;
+    };
+
+    /// <summary>
+    /// Launches program directly instead of through a shell, so each argument reaches it exactly as given.
+    /// Output is passed to the callbacks as it arrives, one call at a time; a null callback discards its stream.
+    /// A process still running when the timeout elapses is killed, together with every process it started, and
+    /// reported as timed out. To that end it runs in a job object on Windows and in a process group of its own
+    /// elsewhere; vcpkg passes the signals that stop it from the terminal on to such groups.
+    /// </summary>
+    ProcessExit process_execute(const fs::path& program,
+                                const std::vector<std::string>& arguments,
+                                const OutputCallback& on_stdout,
+                                const OutputCallback& on_stderr,
+                                const Optional<std::chrono::milliseconds>& timeout) noexcept;
+
+    /// <summary>
+    /// Runs program like process_execute, with stdout and stderr collected together in the order they arrive.
+    /// </summary>
+    ExitCodeAndOutput process_execute_and_capture_output(const fs::path& program,
+                                                         const std::vector<std::string>& arguments) noexcept;
+
+    using ExitCallback = std::function<void(const ProcessExit&)>;
+
+    /// <summary>
+    /// Launches program like process_execute, but returns at once instead of waiting for it to exit.
+    /// One thread watches the output and the exit of every child started this way, so any number of them can run
+    /// without a thread each. The callbacks run on that thread: on_stdout and on_stderr as output arrives, then
+    /// on_exit once the process has exited and its output is closed. They must return quickly and must not wait for
+    /// other children. If the program cannot be started, on_exit is called before this returns.
+    /// </summary>
+    void process_execute_async(const fs::path& program,
+                               const std::vector<std::string>& arguments,
+                               OutputCallback on_stdout,
+                               OutputCallback on_stderr,
+                               ExitCallback on_exit,
+                               const Optional<std::chrono::milliseconds>& timeout) noexcept;
+
+    /// <summary>
+    /// Launches cmd_line like cmd_execute_clean, watched like process_execute_async. stdout and stderr share one
+    /// pipe, so on_output sees them in the order they were written.
+    /// </summary>
+    void cmd_execute_clean_async(const CStringView cmd_line,
+                                 const std::unordered_map<std::string, std::string>& extra_env,
+                                 OutputCallback on_output,
+                                 ExitCallback on_exit,
+                                 const Optional<std::chrono::milliseconds>& timeout) noexcept;
+
     enum class Color
     {
         success = 10,
@@ -79,6 +148,12 @@ namespace vcpkg::System
 
     Optional<std::string> get_environment_variable(const CStringView varname) noexcept;
 
+    /// <summary>The physical memory of the machine in KiB, or 0 if unknown.</summary>
+    uint64_t get_physical_memory_kib() noexcept;
+
+    /// <summary>The peak resident memory of vcpkg itself so far in KiB, or 0 if unknown.</summary>
+    uint64_t get_peak_memory_kib() noexcept;
+
     Optional<std::string> get_registry_string(void* base_hkey, const CStringView subkey, const CStringView valuename);
 
     enum class CPUArchitecture
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vcpkg/base/expected.h>
+#include <vcpkg/base/files.h>
+
+#include <string>
+
+namespace vcpkg::Tar
+{
+    /// <summary>
+    /// Writes every file and directory below `source_dir` into a new uncompressed POSIX (pax) tar archive. Entry
+    /// names are relative to `source_dir`. Returns the number of entries written.
+    /// </summary>
+    ExpectedT<size_t, std::string> create_from_directory(const fs::path& source_dir, const fs::path& archive_path);
+
+    /// <summary>
+    /// Extracts every entry of the uncompressed tar archive below `destination`, which is created if needed. Only
+    /// regular files and directories are supported. Returns the number of entries extracted.
+    /// </summary>
+    ExpectedT<size_t, std::string> extract(const fs::path& archive_path, const fs::path& destination);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vcpkg/base/util.h>
+
+#include <functional>
+#include <optional>
+#include <vector>
+
+/// <summary>
+/// One set of worker threads for the whole process, shared by everything that works in parallel. Each worker keeps
+/// its own queue of tasks; work queued from a worker stays with it, and idle workers steal from the others.
+/// </summary>
+namespace vcpkg::ThreadPool
+{
+    /// <summary>
+    /// Sets how many threads may work at once, counting the thread that waits for the work. Takes effect only before
+    /// the first parallel call. Set by --x-max-threads.
+    /// </summary>
+    void set_max_threads(size_t max_threads);
+
+    /// <summary>
+    /// The number set by set_max_threads, or else the number of hardware threads but at least 16: most of the work
+    /// waits on the disk, a network share or a download rather than on the processor.
+    /// </summary>
+    size_t get_max_threads();
+
+    /// <summary>
+    /// Calls `f(i)` for every i in [0, count) on the calling thread and on up to `max_parallelism - 1` workers of the
+    /// pool, and returns once every call has finished. The calling thread keeps taking indices itself, so calls may
+    /// nest without waiting on each other. The first exception thrown by `f` stops the remaining indices and is
+    /// rethrown here.
+    /// </summary>
+    void parallel_for(size_t count, size_t max_parallelism, const std::function<void(size_t)>& f);
+
+    inline void parallel_for(size_t count, const std::function<void(size_t)>& f)
+    {
+        parallel_for(count, get_max_threads(), f);
+    }
+
+    /// <summary>
+    /// Like Util::fmap, with the calls to `f` spread over the pool. The results keep the order of `xs`.
+    /// </summary>
+    template<class Cont, class Func, class Out = Util::FmapOut<Cont, Func>>
+    std::vector<Out> parallel_transform(Cont&& xs, Func&& f)
+    {
+        auto inputs = Util::fmap(xs, [](auto&& x) { return &x; });
+
+        std::vector<std::optional<Out>> outputs(inputs.size());
+        parallel_for(inputs.size(), [&](size_t i) { outputs[i].emplace(f(*inputs[i])); });
+
+        return Util::fmap(outputs, [](std::optional<Out>& output) { return std::move(*output); });
+    }
+}
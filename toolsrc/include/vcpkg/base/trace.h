@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vcpkg/base/chrono.h>
+#include <vcpkg/base/files.h>
+
+#include <string>
+
+/// <summary>
+/// A timeline of the run in the Chrome trace event format, recorded when vcpkg is given --x-trace-file. The file opens
+/// in chrome://tracing and in the Perfetto UI.
+/// </summary>
+namespace vcpkg::Trace
+{
+    /// <summary>Starts recording. The spans are written to `path` when vcpkg exits.</summary>
+    void enable(const fs::path& path);
+
+    bool is_enabled();
+
+    /// <summary>
+    /// Records the time from construction to destruction as one span on the calling thread. Does nothing unless
+    /// tracing is enabled.
+    /// </summary>
+    struct Scope
+    {
+        Scope(const char* category, std::string name);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* m_category;
+        const char* m_outer_category;
+        std::string m_name;
+        double m_start_us;
+    };
+
+    /// <summary>
+    /// The category of the innermost Scope on the calling thread, or "other" outside of any. Kept whether or not
+    /// tracing is enabled.
+    /// </summary>
+    const char* current_category();
+
+    /// <summary>Records `args`, a JSON object, as an event at the end of the timeline, if tracing is enabled.</summary>
+    void add_summary(const char* category, std::string name, std::string args);
+
+    /// <summary>Writes the spans recorded so far, if tracing is enabled.</summary>
+    void write();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+/// <summary>
+/// One scheduler for the transfers vcpkg makes itself: downloads, binary cache restores and uploads, and tool fetches.
+/// It caps how many run at once and how fast they go together, overall and per host, and lets the most urgent waiting
+/// transfer go first, so that uploads in the background do not hold up the restores a build is waiting for.
+/// </summary>
+namespace vcpkg::Transfers
+{
+    struct Limits
+    {
+        /// <summary>Transfers at once, 0 for no limit</summary>
+        size_t max_transfers = 16;
+        size_t max_transfers_per_host = 8;
+        /// <summary>Bytes per second, sent and received together, 0 for no limit</summary>
+        uint64_t max_rate = 0;
+        uint64_t max_rate_per_host = 0;
+    };
+
+    /// <summary>
+    /// Applies to the transfers that start afterwards. Set from VCPKG_MAX_TRANSFERS, VCPKG_MAX_TRANSFERS_PER_HOST,
+    /// VCPKG_MAX_TRANSFER_RATE and VCPKG_MAX_TRANSFER_RATE_PER_HOST.
+    /// </summary>
+    void set_limits(const Limits& limits);
+
+    /// <summary>The priority of transfers no one waits for, such as binary cache uploads.</summary>
+    constexpr int64_t BACKGROUND = -1;
+    /// <summary>The priority of transfers on threads that set none, which something is waiting for right now.</summary>
+    constexpr int64_t FOREGROUND = std::numeric_limits<int64_t>::max();
+
+    /// <summary>
+    /// Sets the priority of the transfers the calling thread starts until it is destroyed; higher goes first. The
+    /// actions of an install plan use the length of the critical path that starts with them, in microseconds.
+    /// </summary>
+    struct PriorityScope
+    {
+        explicit PriorityScope(int64_t priority);
+        ~PriorityScope();
+
+        PriorityScope(const PriorityScope&) = delete;
+        PriorityScope& operator=(const PriorityScope&) = delete;
+
+    private:
+        int64_t m_outer_priority;
+    };
+
+    int64_t current_priority();
+
+    /// <summary>
+    /// One transfer to or from the host of `url`, holding its place in the limits until destroyed. The constructor
+    /// waits until the transfer may start.
+    /// </summary>
+    struct Slot
+    {
+        explicit Slot(const std::string& url);
+        ~Slot();
+
+        Slot(const Slot&) = delete;
+        Slot& operator=(const Slot&) = delete;
+
+        /// <summary>Counts `bytes` sent or received, first waiting as long as the rate limits require.</summary>
+        void throttle(size_t bytes);
+
+    private:
+        std::string m_host;
+        int64_t m_priority;
+    };
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vcpkg/base/expected.h>
+#include <vcpkg/base/files.h>
+
+#include <string>
+#include <vector>
+
+namespace vcpkg::Zip
+{
+    /// <summary>
+    /// One entry of an archive written by compress_entries: a directory, a file read from `source`, or `contents`
+    /// when `source` is empty.
+    /// </summary>
+    struct SourceEntry
+    {
+        /// <summary>With forward slashes, and a trailing one for directories.</summary>
+        std::string name;
+        bool is_directory;
+        fs::path source;
+        std::string contents;
+    };
+
+    /// <summary>
+    /// Writes `entries` in order into a new deflate compressed zip archive, deflating several files at once. Files are
+    /// read straight from their sources. Returns the number of entries written.
+    /// </summary>
+    ExpectedT<size_t, std::string> compress_entries(const std::vector<SourceEntry>& entries,
+                                                    const fs::path& archive_path);
+
+    /// <summary>
+    /// One of the archives written by compress_entries from the same entries. `names[i]` is the name of entries[i]
+    /// in it, which is left out when its name is empty or missing.
+    /// </summary>
+    struct ArchiveLayout
+    {
+        fs::path path;
+        std::vector<std::string> names;
+    };
+
+    /// <summary>
+    /// Writes several archives of the same entries in one pass: each file is read and deflated once, and the result is
+    /// written to every archive that contains it. The names of `entries` are not used. Returns the number of entries
+    /// written to at least one archive.
+    /// </summary>
+    ExpectedT<size_t, std::string> compress_entries(const std::vector<SourceEntry>& entries,
+                                                    const std::vector<ArchiveLayout>& archives);
+
+    /// <summary>
+    /// Writes every file and directory below `source_dir` into a new deflate compressed zip archive. Entry names are
+    /// `prefix` followed by the path relative to `source_dir`. Returns the number of entries written.
+    /// </summary>
+    ExpectedT<size_t, std::string> compress_directory(const fs::path& source_dir,
+                                                      const fs::path& archive_path,
+                                                      const std::string& prefix = "");
+
+    /// <summary>
+    /// Extracts every entry of the zip archive below `destination`, which is created if needed. Only stored and
+    /// deflate compressed entries are supported. A file at the same place below one of `reuse_dirs`, tried in order,
+    /// with the size and CRC-32 of an entry is hard linked into place instead of being extracted again. Returns the
+    /// number of entries extracted.
+    /// </summary>
+    ExpectedT<size_t, std::string> extract(const fs::path& archive_path,
+                                           const fs::path& destination,
+                                           const std::vector<fs::path>& reuse_dirs = {});
+}
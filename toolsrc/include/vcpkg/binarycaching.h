@@ -0,0 +1,253 @@
+#pragma once
+
+#include <vcpkg/base/expected.h>
+#include <vcpkg/base/files.h>
+#include <vcpkg/base/optional.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vcpkg
+{
+    /// <summary>
+    /// Container and compression of a binary package archive. The format is recorded in the archive's extension, so
+    /// archives of every format can share a cache.
+    /// </summary>
+    enum class ArchiveFormat
+    {
+        ZIP,
+        TAR_ZSTD,
+        /// <summary>
+        /// A list of file hashes; the contents live once per hash in the provider's blob store (content addressed).
+        /// </summary>
+        MANIFEST,
+    };
+
+    static constexpr ArchiveFormat ALL_ARCHIVE_FORMATS[] = {
+        ArchiveFormat::ZIP, ArchiveFormat::TAR_ZSTD, ArchiveFormat::MANIFEST};
+
+    /// <summary>`.zip`, `.tar.zst` or `.manifest`.</summary>
+    const std::string& archive_extension(ArchiveFormat format);
+
+    /// <summary>How new archives are written. A level of 0 selects the format's default.</summary>
+    struct ArchiveEncoding
+    {
+        ArchiveFormat format = ArchiveFormat::ZIP;
+        int level = 0;
+
+        /// <summary>Parses `zip`, `cas`, `zstd` or `zstd:<level>`, where the level is 1 through 22.</summary>
+        static ExpectedT<ArchiveEncoding, std::string> parse(const std::string& text);
+
+        std::string to_string() const;
+    };
+
+    bool operator==(const ArchiveEncoding& lhs, const ArchiveEncoding& rhs);
+    bool operator!=(const ArchiveEncoding& lhs, const ArchiveEncoding& rhs);
+
+    /// <summary>
+    /// A store of binary package archives (`<abi>.zip`, `<abi>.tar.zst`, `<abi>.manifest`) and failure tombstones, both
+    /// keyed by ABI tag, and of the file blobs manifests refer to, keyed by SHA1.
+    /// </summary>
+    struct ArchiveProvider
+    {
+        virtual ~ArchiveProvider() {}
+
+        /// <summary>Human readable location of the provider, used in messages.</summary>
+        virtual std::string location() const = 0;
+
+        /// <summary>`files`, `http` or `s3`, the label of the provider's metrics.</summary>
+        virtual const char* kind() const = 0;
+
+        /// <summary>The encoding this provider stores new archives in.</summary>
+        virtual const ArchiveEncoding& encoding() const = 0;
+
+        virtual bool has_archive(const std::string& abi_tag, ArchiveFormat format) const = 0;
+        /// <summary>Copies the archive to `destination`. Returns false if the provider does not have it.</summary>
+        virtual bool fetch_archive(const std::string& abi_tag, ArchiveFormat format, const fs::path& destination) const = 0;
+        virtual bool store_archive(const std::string& abi_tag, ArchiveFormat format, const fs::path& archive) const = 0;
+
+        virtual bool has_blob(const std::string& sha1) const = 0;
+        virtual bool fetch_blob(const std::string& sha1, const fs::path& destination) const = 0;
+        virtual bool store_blob(const std::string& sha1, const fs::path& file) const = 0;
+
+        virtual bool has_tombstone(const std::string& abi_tag) const = 0;
+        virtual bool store_tombstone(const std::string& abi_tag) const = 0;
+        virtual void purge_tombstone(const std::string& abi_tag) const = 0;
+    };
+
+    /// <summary>
+    /// Archives in `<root>/<abi[0..2]>/<abi><extension>`, tombstones in `<root>/fail/<abi[0..2]>/<abi>.zip` and blobs
+    /// in `<root>/blobs/<sha1[0..2]>/<sha1>`.
+    /// </summary>
+    std::unique_ptr<ArchiveProvider> make_directory_archive_provider(Files::Filesystem& fs,
+                                                                     const fs::path& root,
+                                                                     const ArchiveEncoding& encoding = {});
+
+    /// <summary>
+    /// Same layout as a directory provider below `url_prefix`, read with GET/HEAD and written with PUT.
+    /// </summary>
+    std::unique_ptr<ArchiveProvider> make_http_archive_provider(Files::Filesystem& fs,
+                                                                const std::string& url_prefix,
+                                                                const ArchiveEncoding& encoding = {});
+
+    /// <summary>
+    /// Same layout as a directory provider below `s3://<bucket>/<prefix>` in an S3-compatible object store, configured
+    /// as S3::Bucket::from_environment describes. Large archives are uploaded in parts and downloaded in ranges, over
+    /// several connections at once.
+    /// </summary>
+    std::unique_ptr<ArchiveProvider> make_s3_archive_provider(Files::Filesystem& fs,
+                                                              const std::string& url,
+                                                              const ArchiveEncoding& encoding = {});
+
+    /// <summary>Parses a size such as `200G`: a byte count with an optional binary K, M, G or T suffix.</summary>
+    ExpectedT<uint64_t, std::string> parse_cache_size(const std::string& text);
+
+    struct CacheGcResult
+    {
+        size_t removed_files = 0;
+        uint64_t removed_bytes = 0;
+        uint64_t remaining_bytes = 0;
+    };
+
+    struct CachedArchive
+    {
+        fs::path path;
+        ArchiveFormat format;
+    };
+
+    /// <summary>
+    /// What `<abi>.meta`, next to the local archives of a package, records about it, so that the cache can be listed
+    /// and sized without opening any archive. Stored as `Key: value` lines.
+    /// </summary>
+    struct ArchiveMetadata
+    {
+        std::string abi_tag;
+        std::string name;
+        std::string version;
+        std::string triplet;
+        std::vector<std::string> features;
+        /// <summary>Bytes of the package's archives in the local tier.</summary>
+        uint64_t size = 0;
+        /// <summary>Seconds since the Unix epoch.</summary>
+        long long created = 0;
+
+        std::string to_string() const;
+        static ExpectedT<ArchiveMetadata, std::string> parse(const std::string& abi_tag, const std::string& text);
+    };
+
+    /// <summary>
+    /// The local archives directory, used as a read-through tier in front of the configured remote providers.
+    /// </summary>
+    struct BinaryCache
+    {
+        BinaryCache(Files::Filesystem& fs,
+                    const fs::path& local_root,
+                    const ArchiveEncoding& local_encoding,
+                    std::vector<std::unique_ptr<ArchiveProvider>>&& remotes);
+
+        /// <summary>
+        /// Creates the cache rooted at `local_root` with the remotes listed in the semicolon separated
+        /// VCPKG_BINARY_CACHE environment variable. Entries are http(s):// URLs, s3:// URLs or directories, optionally
+        /// followed by `,<encoding>`. The local tier, and remotes without an encoding, use VCPKG_BINARY_CACHE_FORMAT
+        /// (default zip).
+        /// </summary>
+        static BinaryCache from_environment(Files::Filesystem& fs, const fs::path& local_root);
+
+        /// <summary>Where an archive in the local tier's own encoding is stored.</summary>
+        fs::path local_archive_path(const std::string& abi_tag) const;
+
+        /// <summary>True if any tier stores new archives in `format`.</summary>
+        bool uses_format(ArchiveFormat format) const;
+
+        /// <summary>True if the local tier or any remote has the archive. Does not download anything.</summary>
+        bool has_archive(const std::string& abi_tag) const;
+
+        /// <summary>
+        /// Probes every tag with up to `max_concurrency` queries in flight, so remote round trips overlap.
+        /// </summary>
+        std::vector<bool> has_archives(const std::vector<std::string>& abi_tags, size_t max_concurrency = 8) const;
+
+        /// <summary>
+        /// Returns the local path of the archive, downloading it into the local tier on a local miss. Each tier is
+        /// asked for its own encoding's format first.
+        /// </summary>
+        Optional<CachedArchive> fetch_archive(const std::string& abi_tag) const;
+
+        /// <summary>
+        /// The distinct encodings of all tiers, the local tier's first. A new package is archived once per encoding.
+        /// </summary>
+        std::vector<ArchiveEncoding> store_encodings() const;
+
+        /// <summary>
+        /// Moves `archive` into the local tier if it uses `encoding`, and copies it to every remote that does.
+        /// </summary>
+        void store_archive(const std::string& abi_tag, const ArchiveEncoding& encoding, const fs::path& archive) const;
+
+        /// <summary>
+        /// Writes the metadata of `metadata.abi_tag` next to its local archives, filling in their size and the current
+        /// time. The file is replaced atomically, so that concurrent readers see either the old or the new one.
+        /// </summary>
+        void store_metadata(ArchiveMetadata metadata) const;
+
+        bool has_metadata(const std::string& abi_tag) const;
+
+        /// <summary>
+        /// Reads the metadata of every package in the local tier, in parallel. Files that another process removes
+        /// meanwhile are skipped.
+        /// </summary>
+        std::vector<ArchiveMetadata> load_all_metadata() const;
+
+        /// <summary>
+        /// Hashes every file below `package_dir` into the local blob store and writes the manifest listing them.
+        /// </summary>
+        ExpectedT<size_t, std::string> write_manifest(const fs::path& package_dir, const fs::path& manifest_path) const;
+
+        /// <summary>
+        /// Recreates the files of a manifest below `package_dir`. Blobs missing locally are downloaded into the local
+        /// blob store first; files are hard linked from there when possible and copied otherwise. A file at the same
+        /// place below one of `reuse_dirs`, tried in order, with the size, SHA1 and mode of an entry is hard linked
+        /// instead, without needing its blob.
+        /// </summary>
+        ExpectedT<size_t, std::string> restore_manifest(const fs::path& manifest_path,
+                                                        const fs::path& package_dir,
+                                                        const std::vector<fs::path>& reuse_dirs = {}) const;
+
+        /// <summary>
+        /// Removes archives and tombstones of the local tier, least recently restored first, until it holds at most
+        /// `max_size` bytes, along with every blob that no remaining manifest refers to and the metadata of packages
+        /// with no archive left. Anything used within the last hour is kept, so that other vcpkg processes reading the
+        /// cache are not disturbed.
+        /// </summary>
+        CacheGcResult collect_garbage(uint64_t max_size) const;
+
+        /// <summary>
+        /// Runs collect_garbage with the size in VCPKG_BINARY_CACHE_MAX_SIZE, if set, at most once an hour.
+        /// </summary>
+        void collect_garbage_from_environment() const;
+
+        /// <summary>Returns the location of the first tier holding a failure tombstone for `abi_tag`.</summary>
+        Optional<std::string> find_tombstone(const std::string& abi_tag) const;
+        void store_tombstone(const std::string& abi_tag) const;
+        void purge_tombstone(const std::string& abi_tag) const;
+
+        /// <summary>
+        /// Claims the build of `abi_tag` for this process by locking `<abi[0..2]>/<abi>.lease` in the local tier, so
+        /// that vcpkg processes sharing the tier build each package once. Returns null while another process holds
+        /// it; that process stores the archive before letting go.
+        /// </summary>
+        std::unique_ptr<Files::FileLock> try_lease_build(const std::string& abi_tag) const;
+
+        /// <summary>Blocks until no other process holds the lease on `abi_tag`.</summary>
+        void wait_for_lease(const std::string& abi_tag) const;
+
+    private:
+        fs::path local_blob_path(const std::string& sha1) const;
+
+        Files::Filesystem* m_fs;
+        fs::path m_local_root;
+        ArchiveEncoding m_local_encoding;
+        std::unique_ptr<ArchiveProvider> m_local;
+        std::vector<std::unique_ptr<ArchiveProvider>> m_remotes;
+    };
+}
@@ -14,6 +14,7 @@ namespace vcpkg
     {
         BinaryParagraph();
         explicit BinaryParagraph(std::unordered_map<std::string, std::string> fields);
+        explicit BinaryParagraph(const Parse::RawParagraphView& fields);
         BinaryParagraph(const SourceParagraph& spgh, const Triplet& triplet, const std::string& abi_tag);
         BinaryParagraph(const SourceParagraph& spgh, const FeatureParagraph& fpgh, const Triplet& triplet);
 
@@ -31,6 +32,8 @@ namespace vcpkg
         std::vector<std::string> default_features;
         std::vector<std::string> depends;
         std::string abi;
+        /// <summary>The hash of the files the build produced; only recorded with the outputabi feature flag.</summary>
+        std::string output_abi;
     };
 
     struct BinaryControlFile
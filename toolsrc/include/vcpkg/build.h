@@ -6,6 +6,7 @@
 #include <vcpkg/vcpkgcmdarguments.h>
 #include <vcpkg/vcpkgpaths.h>
 
+#include <vcpkg/base/chrono.h>
 #include <vcpkg/base/cstringview.h>
 #include <vcpkg/base/files.h>
 #include <vcpkg/base/optional.h>
@@ -76,6 +77,16 @@ namespace vcpkg::Build
         YES
     };
 
+    /// <summary>
+    /// Whether vcpkg_configure_cmake keeps the configured build directories of the previous build of the port when it
+    /// would configure them the same way again, so that only what changed is rebuilt. Set by --x-incremental.
+    /// </summary>
+    enum class Incremental
+    {
+        NO = 0,
+        YES
+    };
+
     struct BuildPackageOptions
     {
         UseHeadVersion use_head_version;
@@ -85,6 +96,7 @@ namespace vcpkg::Build
         DownloadTool download_tool;
         BinaryCaching binary_caching;
         FailOnTombstone fail_on_tombstone;
+        Incremental incremental;
     };
 
     enum class BuildResult
@@ -96,15 +108,18 @@ namespace vcpkg::Build
         FILE_CONFLICTS,
         CASCADED_DUE_TO_MISSING_DEPENDENCIES,
         EXCLUDED,
+        /// <summary>The build ran past its VCPKG_BUILD_TIMEOUT and was stopped.</summary>
+        TIMED_OUT,
     };
 
-    static constexpr std::array<BuildResult, 6> BUILD_RESULT_VALUES = {
+    static constexpr std::array<BuildResult, 7> BUILD_RESULT_VALUES = {
         BuildResult::SUCCEEDED,
         BuildResult::BUILD_FAILED,
         BuildResult::POST_BUILD_CHECKS_FAILED,
         BuildResult::FILE_CONFLICTS,
         BuildResult::CASCADED_DUE_TO_MISSING_DEPENDENCIES,
-        BuildResult::EXCLUDED};
+        BuildResult::EXCLUDED,
+        BuildResult::TIMED_OUT};
 
     const std::string& to_string(const BuildResult build_result);
     std::string create_error_message(const BuildResult build_result, const PackageSpec& spec);
@@ -128,10 +143,74 @@ namespace vcpkg::Build
         Optional<fs::path> visual_studio_path;
         Optional<std::string> external_toolchain_file;
         Optional<ConfigurationType> build_type;
+        /// <summary>VCPKG_UNITY_BUILD, as the triplet sets it for every port</summary>
+        bool unity_build = false;
     };
 
     std::string make_build_env_cmd(const PreBuildInfo& pre_build_info, const Toolset& toolset);
 
+    /// <summary>
+    /// The variables that make_build_env_cmd sets up, to pass to cmd_execute_clean instead of running it. They are
+    /// captured from vcvarsall once per toolset, architecture and target, and kept in installed/vcpkg/vcvars/ until
+    /// Visual Studio or the Windows SDKs change. Empty when no vcvarsall is needed, and nullopt when it failed.
+    /// </summary>
+    Optional<std::unordered_map<std::string, std::string>> get_build_env(const VcpkgPaths& paths,
+                                                                         const PreBuildInfo& pre_build_info,
+                                                                         const Toolset& toolset);
+
+    /// <summary>The files whose changes make get_build_env capture the variables of vcvarsall again.</summary>
+    std::vector<fs::path> get_build_env_stamp_paths(const Toolset& toolset);
+
+    /// <summary>Describes a file or directory by its size and write time, or as missing.</summary>
+    std::string describe_install_stamp(const fs::path& path);
+
+    enum class BuildPhase
+    {
+        CACHE_LOOKUP,
+        RESTORE,
+        DOWNLOAD,
+        BUILD,
+        POST_BUILD_CHECKS,
+        INSTALL,
+        ARCHIVE,
+    };
+
+    static constexpr std::array<BuildPhase, 7> BUILD_PHASE_VALUES = {BuildPhase::CACHE_LOOKUP,
+                                                                     BuildPhase::RESTORE,
+                                                                     BuildPhase::DOWNLOAD,
+                                                                     BuildPhase::BUILD,
+                                                                     BuildPhase::POST_BUILD_CHECKS,
+                                                                     BuildPhase::INSTALL,
+                                                                     BuildPhase::ARCHIVE};
+
+    const std::string& to_string(const BuildPhase phase);
+
+    /// <summary>
+    /// Where the time of one package went. BUILD is the whole portfile script, including its own downloads; DOWNLOAD
+    /// is only the wait for the sources fetched ahead of the build.
+    /// </summary>
+    struct PhaseTimings
+    {
+        void add(const BuildPhase phase, const Chrono::ElapsedTime& time);
+        void add(const PhaseTimings& other);
+        std::chrono::microseconds get(const BuildPhase phase) const;
+
+        /// <summary>The phases that took any time, as "phase: time" joined by ", ".</summary>
+        std::string to_string() const;
+
+    private:
+        std::array<std::chrono::microseconds, BUILD_PHASE_VALUES.size()> m_durations{};
+    };
+
+    /// <summary>
+    /// How many of the compilations in one build the compiler cache answered. Only ccache reports this per build.
+    /// </summary>
+    struct CompilerCacheStats
+    {
+        size_t hits = 0;
+        size_t misses = 0;
+    };
+
     struct ExtendedBuildResult
     {
         ExtendedBuildResult(BuildResult code);
@@ -141,6 +220,24 @@ namespace vcpkg::Build
         BuildResult code;
         std::vector<FeatureSpec> unmet_dependencies;
         std::unique_ptr<BinaryControlFile> binary_control_file;
+        PhaseTimings timings;
+        /// <summary>
+        /// Held on packages/`spec` once it has been built or restored, so that it can be installed before another
+        /// vcpkg process replaces it.
+        /// </summary>
+        std::shared_ptr<Files::FileLock> package_dir_lock;
+        Optional<CompilerCacheStats> compiler_cache;
+        /// <summary>Peak memory of the build in KiB, as System::ProcessExit reports it; 0 if not built.</summary>
+        uint64_t peak_memory_kib = 0;
+        /// <summary>The package directory was extracted from the binary cache rather than built.</summary>
+        bool restored = false;
+    };
+
+    struct AbiTagAndFile
+    {
+        std::string tag;
+        /// <summary>The entries the tag hashes; written to share/<port>/vcpkg_abi_info.txt of a built package</summary>
+        std::string abi_info;
     };
 
     struct BuildPackageConfig
@@ -149,7 +246,7 @@ namespace vcpkg::Build
                            const Triplet& triplet,
                            fs::path&& port_dir,
                            const BuildPackageOptions& build_package_options,
-                           const std::set<std::string>& feature_list)
+                           const FeatureList& feature_list)
             : scf(src)
             , triplet(triplet)
             , port_dir(std::move(port_dir))
@@ -162,13 +259,74 @@ namespace vcpkg::Build
         const Triplet& triplet;
         fs::path port_dir;
         const BuildPackageOptions& build_package_options;
-        const std::set<std::string>& feature_list;
+        const FeatureList& feature_list;
+
+        /// <summary>Processors the port build may use. Empty leaves the build system defaults.</summary>
+        Optional<unsigned int> concurrency;
+
+        /// <summary>Starts each line that the port build prints with the spec, to tell concurrent builds apart.</summary>
+        bool prefix_output = false;
+
+        /// <summary>ABI tag of a cached archive that has already been extracted into the package directory.</summary>
+        Optional<std::string> prefetched_abi_tag;
+
+        /// <summary>
+        /// The tag computed for the whole plan before it started. Used instead of computing it again from the installed
+        /// dependencies.
+        /// </summary>
+        Optional<AbiTagAndFile> planned_abi;
     };
 
+    /// <summary>
+    /// Starts fetching the tools that building a port needs, so that a fresh machine downloads them all at once while
+    /// the ports are loaded and the plan is made, rather than one after another when the first build starts.
+    /// </summary>
+    void prefetch_build_tools(const VcpkgPaths& paths);
+
+    /// <summary>
+    /// Fetches the cached archive for `abi_tag` and extracts it into the package directory of `spec`. Returns false if
+    /// no binary cache tier has the archive or it cannot be extracted.
+    /// </summary>
+    bool restore_from_binary_cache(const VcpkgPaths& paths, const PackageSpec& spec, const std::string& abi_tag);
+
+    /// <summary>Locks packages/`spec` against other vcpkg processes.</summary>
+    std::unique_ptr<Files::FileLock> lock_package_dir(const VcpkgPaths& paths, const PackageSpec& spec);
+
     ExtendedBuildResult build_package(const VcpkgPaths& paths,
                                       const BuildPackageConfig& config,
                                       const StatusParagraphs& status_db);
 
+    /// <summary>
+    /// If the archives of packages/`spec` are still being stored in the background, leaves removing the directory to
+    /// that and returns true.
+    /// </summary>
+    bool remove_package_dir_after_archive(const PackageSpec& spec);
+
+    /// <summary>
+    /// Blocks until the archives build_package stores in the background are all in the binary cache. Called before
+    /// vcpkg exits and before anything reads the cache back.
+    /// </summary>
+    void wait_for_archives();
+
+    /// <summary>
+    /// While it lives, builds of its ports extract and patch each source archive once into a source cache of this
+    /// vcpkg process below buildtrees, and copy their sources from there as with VCPKG_SOURCE_CACHE, which takes
+    /// precedence. Meant for plans that build a port for several triplets. The cache is removed afterwards, or by the
+    /// next vcpkg if this one exits first.
+    /// </summary>
+    struct SharedSources
+    {
+        SharedSources(const VcpkgPaths& paths, std::set<std::string> ports);
+        SharedSources(const SharedSources&) = delete;
+        SharedSources& operator=(const SharedSources&) = delete;
+        ~SharedSources();
+
+    private:
+        const VcpkgPaths& m_paths;
+        fs::path m_dir;
+        std::unique_ptr<Files::FileLock> m_lock;
+    };
+
     enum class BuildPolicy
     {
         EMPTY_PACKAGE,
@@ -238,11 +396,19 @@ namespace vcpkg::Build
         }
     };
 
-    struct AbiTagAndFile
-    {
-        std::string tag;
-        fs::path tag_file;
-    };
+    /// <summary>
+    /// The hash of every file in port_dir, recorded as the "port_files" entry of the abi info of the packages built
+    /// from it; CONTROL counts only with the fields that affect the build. Comparing it with the abi info of an
+    /// installed package tells whether the port changed since then.
+    /// </summary>
+    std::string hash_port_files(const Files::Filesystem& fs, const fs::path& port_dir);
+
+    /// <summary>
+    /// The value a dependent's abi info records for an installed dependency. With the outputabi feature flag it is the
+    /// hash of the dependency's files, so that rebuilding a dependency into identical files keeps its dependents'
+    /// tags (early cutoff); otherwise, and for packages built without the flag, it is the dependency's tag.
+    /// </summary>
+    const std::string& dependency_abi(const BinaryParagraph& package);
 
     Optional<AbiTagAndFile> compute_abi_tag(const VcpkgPaths& paths,
                                             const BuildPackageConfig& config,
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vcpkg/build.h>
+#include <vcpkg/packagespec.h>
+#include <vcpkg/vcpkgpaths.h>
+
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+namespace vcpkg::BuildHistory
+{
+    using Durations = std::unordered_map<PackageSpec, std::chrono::microseconds>;
+
+    /// <summary>
+    /// One successful install of a package: built from source, or restored from the binary cache.
+    /// </summary>
+    struct Record
+    {
+        PackageSpec spec;
+        /// <summary>Empty when binary caching was off.</summary>
+        std::string abi_tag;
+        bool cache_hit;
+        std::chrono::microseconds total;
+        Build::PhaseTimings phases;
+        /// <summary>Peak memory of the build in KiB; 0 for restores and records that predate it.</summary>
+        uint64_t peak_memory_kib = 0;
+    };
+
+    /// <summary>
+    /// Reads the records of a history file in order, oldest first. Lines of the older "port triplet microseconds"
+    /// format are read as builds without a phase breakdown.
+    /// </summary>
+    std::vector<Record> load_records(const Files::Filesystem& fs, const fs::path& path);
+
+    /// <summary>
+    /// Duration of the most recent recorded build of each package, read from installed/vcpkg/buildhistory.
+    /// </summary>
+    Durations load_durations(const VcpkgPaths& paths);
+
+    /// <summary>
+    /// Reads durations recorded in the same format from any file, such as a copy shared between machines.
+    /// </summary>
+    Durations load_durations(const Files::Filesystem& fs, const fs::path& path);
+
+    /// <summary>
+    /// What the recorded installs of a package say about it. Compaction keeps only the newest build and the newest
+    /// restore of each package, so the counts cover the records since the file was last compacted.
+    /// </summary>
+    struct Summary
+    {
+        /// <summary>Duration of the most recent build from source.</summary>
+        Optional<std::chrono::microseconds> build_time;
+        size_t installs = 0;
+        size_t cache_hits = 0;
+    };
+
+    using Summaries = std::unordered_map<PackageSpec, Summary>;
+
+    /// <summary>Summarizes each package recorded in installed/vcpkg/buildhistory.</summary>
+    Summaries load_summaries(const VcpkgPaths& paths);
+
+    /// <summary>Summarizes the records of any history file, such as the one named by VCPKG_BUILD_HISTORY.</summary>
+    Summaries load_summaries(const Files::Filesystem& fs, const fs::path& path);
+
+    using PeakMemory = std::unordered_map<PackageSpec, uint64_t>;
+
+    /// <summary>
+    /// Peak memory in KiB of the most recent recorded build of each package that measured it, read from
+    /// installed/vcpkg/buildhistory.
+    /// </summary>
+    PeakMemory load_peak_memory(const VcpkgPaths& paths);
+
+    /// <summary>
+    /// Appends `records` to installed/vcpkg/buildhistory, and to the file named by VCPKG_BUILD_HISTORY when it is set
+    /// so that several machines can share one history.
+    /// </summary>
+    void store_records(const VcpkgPaths& paths, const std::vector<Record>& records);
+}
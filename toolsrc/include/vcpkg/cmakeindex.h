@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vcpkg/base/files.h>
+#include <vcpkg/base/optional.h>
+#include <vcpkg/packagespec.h>
+#include <vcpkg/vcpkgpaths.h>
+
+#include <string>
+#include <vector>
+
+namespace vcpkg::CMakeIndex
+{
+    /// <summary>
+    /// The CMake package in one directory below share/: the config file find_package() loads from it, if there is
+    /// one, and the targets its .cmake files add.
+    /// </summary>
+    struct Package
+    {
+        /// <summary>The name of the directory, to pass to find_package() when there is no config file.</summary>
+        std::string name;
+        /// <summary>Relative to the triplet's directory, such as share/zlib/ZLIBConfig.cmake; empty if none.</summary>
+        std::string config_file;
+        /// <summary>In the order they were found.</summary>
+        std::vector<std::string> targets;
+
+        /// <summary>The name find_package() looks for the config file under, such as ZLIB; empty if none.</summary>
+        std::string config_name() const;
+    };
+
+    /// <summary>
+    /// The target name of every add_library(name ...) call, found with a plain text search because cmake files can be
+    /// large and a regex over each of them is slow
+    /// </summary>
+    std::vector<std::string> find_library_targets(const std::string& contents);
+
+    /// <summary>
+    /// Reads the .cmake files below share/ among `files`, which are relative to `triplet_dir` with forward slashes.
+    /// </summary>
+    std::vector<Package> scan(const Files::Filesystem& fs,
+                              const fs::path& triplet_dir,
+                              const std::vector<std::string>& files);
+
+    /// <summary>
+    /// Records the packages of an installed port in installed/vcpkg/cmake/&lt;triplet&gt;/, and rewrites
+    /// installed/vcpkg/cmake/&lt;triplet&gt;.cmake, which vcpkg.cmake loads to find config files without a search.
+    /// </summary>
+    void store(const VcpkgPaths& paths, const PackageSpec& spec, const std::vector<Package>& packages);
+
+    /// <summary>The packages recorded by store(); nullopt for ports installed before the index existed.</summary>
+    Optional<std::vector<Package>> load(const VcpkgPaths& paths, const PackageSpec& spec);
+
+    /// <summary>Drops the packages of a removed port and rewrites the triplet's .cmake file.</summary>
+    void forget(const VcpkgPaths& paths, const PackageSpec& spec);
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vcpkg/base/cofffilereader.h>
+#include <vcpkg/vcpkgpaths.h>
+
+/// <summary>
+/// What CoffFileReader found in each DLL and LIB that post-build validation read, kept in installed/vcpkg/coffinfo
+/// and keyed by the SHA1 of the file. Rebuilding a port into identical binaries, or checking a package again, then
+/// reads none of them; only new or changed binaries are parsed.
+/// </summary>
+namespace vcpkg::CoffInfoCache
+{
+    /// <summary>CoffFileReader::read_dll, without the export names, which no check uses.</summary>
+    CoffFileReader::DllInfo read_dll(const VcpkgPaths& paths, const fs::path& path);
+
+    CoffFileReader::LibInfo read_lib(const VcpkgPaths& paths, const fs::path& path);
+}
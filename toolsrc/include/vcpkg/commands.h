@@ -55,7 +55,7 @@ namespace vcpkg::Commands
 
     namespace DependInfo
     {
-        void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths);
+        void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet);
     }
 
     namespace Search
@@ -125,11 +125,69 @@ namespace vcpkg::Commands
         void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths);
     }
 
-    namespace Hash
+    namespace X_CacheGc
+    {
+        extern const CommandStructure COMMAND_STRUCTURE;
+        void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths);
+    }
+
+    namespace X_DownloadsGc
     {
+        extern const CommandStructure COMMAND_STRUCTURE;
+        void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths);
+    }
+
+    namespace X_Compact
+    {
+        extern const CommandStructure COMMAND_STRUCTURE;
         void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths);
     }
 
+    /// <summary>
+    /// A resident vcpkg that keeps the paths, tools, status database and ports of one tree loaded, and runs every
+    /// request in a fork of itself so that it starts warm. Clients reach it through VCPKG_SERVER.
+    /// </summary>
+    namespace X_Server
+    {
+        extern const CommandStructure COMMAND_STRUCTURE;
+
+        /// <summary>
+        /// Serves requests until the server is stopped. Returns only in the process forked for one request, with the
+        /// arguments of the request; its standard streams and working directory are the client's by then.
+        /// </summary>
+        VcpkgCmdArguments serve(const VcpkgCmdArguments& args, const VcpkgPaths& paths);
+
+        /// <summary>The paths the server loaded for `root`, in a forked request; nullptr otherwise.</summary>
+        const VcpkgPaths* find_warm_paths(const fs::path& root);
+
+        /// <summary>Whether the server runs `command` with the arguments `args`; the rest run in the client.</summary>
+        bool is_served(const std::string& command, const std::vector<std::string>& args);
+
+        /// <summary>
+        /// Runs the command on the server at `socket_path` with this process's standard streams, working directory and
+        /// environment, and returns its exit code. Returns nullopt if the server does not run `command` or no server
+        /// is listening there.
+        /// </summary>
+        Optional<int> forward(const std::string& socket_path,
+                              const std::string& command,
+                              const std::vector<std::string>& args);
+    }
+
+    namespace Hash
+    {
+        void perform_and_exit(const VcpkgCmdArguments& args);
+    }
+
+    /// <summary>
+    /// Copies the installed DLLs that a freshly linked binary depends on next to it, in place of applocal.ps1. Runs
+    /// without a vcpkg root, since the build systems run it after every link.
+    /// </summary>
+    namespace X_AppLocal
+    {
+        extern const CommandStructure COMMAND_STRUCTURE;
+        void perform_and_exit(const VcpkgCmdArguments& args);
+    }
+
     namespace Fetch
     {
         void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <vcpkg/base/cache.h>
 #include <vcpkg/base/optional.h>
 #include <vcpkg/base/util.h>
 #include <vcpkg/build.h>
@@ -37,13 +38,11 @@ namespace vcpkg::Dependencies
 
         InstallPlanAction() noexcept;
 
-        InstallPlanAction(InstalledPackageView&& spghs,
-                          const std::set<std::string>& features,
-                          const RequestType& request_type);
+        InstallPlanAction(InstalledPackageView&& spghs, FeatureList&& features, const RequestType& request_type);
 
         InstallPlanAction(const PackageSpec& spec,
                           const SourceControlFile& scf,
-                          const std::set<std::string>& features,
+                          FeatureList&& features,
                           const RequestType& request_type,
                           std::vector<PackageSpec>&& dependencies);
 
@@ -57,9 +56,12 @@ namespace vcpkg::Dependencies
         InstallPlanType plan_type;
         RequestType request_type;
         Build::BuildPackageOptions build_options;
-        std::set<std::string> feature_list;
+        FeatureList feature_list;
 
         std::vector<PackageSpec> computed_dependencies;
+
+        /// <summary>Set by Install::plan_abi_tags, before the plan executes.</summary>
+        Optional<Build::AbiTagAndFile> planned_abi;
     };
 
     enum class RemovePlanType
@@ -135,6 +137,10 @@ namespace vcpkg::Dependencies
         const std::unordered_map<std::string, SourceControlFile>& ports;
     };
 
+    /// <summary>
+    /// Loads each port the first time it is asked for, so a plan only parses the ports it reaches. The cache is
+    /// locked per port, so a single instance can be shared by several threads.
+    /// </summary>
     struct PathsPortFileProvider : Util::ResourceBase, PortFileProvider
     {
         explicit PathsPortFileProvider(const VcpkgPaths& paths);
@@ -142,7 +148,24 @@ namespace vcpkg::Dependencies
 
     private:
         const VcpkgPaths& ports;
-        mutable std::unordered_map<std::string, SourceControlFile> cache;
+        Cache<std::string, std::unique_ptr<SourceControlFile>> cache;
+    };
+
+    /// <summary>
+    /// Loads every port of the port tree when it is constructed and never changes afterwards, so a single instance
+    /// can be shared by several planners and threads.
+    /// </summary>
+    struct PreloadedPortFileProvider : Util::ResourceBase, PortFileProvider
+    {
+        explicit PreloadedPortFileProvider(const VcpkgPaths& paths);
+        Optional<const SourceControlFile&> get_control_file(const std::string& src_name) const override;
+
+        /// <summary>The names of all loaded ports, in the order of the port tree</summary>
+        const std::vector<std::string>& port_names() const { return names; }
+
+    private:
+        std::unordered_map<std::string, SourceControlFile> ports;
+        std::vector<std::string> names;
     };
 
     struct ClusterGraph;
@@ -157,6 +180,12 @@ namespace vcpkg::Dependencies
                      const std::unordered_set<std::string>& prevent_default_features = {}) const;
         void upgrade(const PackageSpec& spec) const;
 
+        /// <summary>
+        /// Installs `features` of `spec` as well whenever `spec` becomes part of the plan, whether it is requested or
+        /// only needed as a dependency. Takes effect for the install() calls that follow.
+        /// </summary>
+        void require_features(const PackageSpec& spec, const std::vector<std::string>& features) const;
+
         std::vector<AnyAction> serialize() const;
 
     private:
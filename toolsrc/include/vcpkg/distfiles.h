@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vcpkg/vcpkgpaths.h>
+
+#include <string>
+#include <vector>
+
+namespace vcpkg::Distfiles
+{
+    /// <summary>A source file a portfile downloads into downloads/ before building.</summary>
+    struct Distfile
+    {
+        std::vector<std::string> urls;
+        std::string filename;
+        std::string sha512;
+    };
+
+    /// <summary>
+    /// The downloads a portfile always makes: its top level vcpkg_download_distfile and vcpkg_from_github calls whose
+    /// arguments are literals or variables set to literals before them. Anything conditional or computed is left out;
+    /// the build still downloads whatever is missing.
+    /// </summary>
+    std::vector<Distfile> find_in_portfile(const std::string& contents, const std::string& port_name);
+
+    /// <summary>
+    /// Downloads `distfile` into downloads/ unless it is already there, checking its hash before moving it into place.
+    /// Returns false, leaving nothing behind, on any failure.
+    /// </summary>
+    bool prefetch(const VcpkgPaths& paths, const Distfile& distfile);
+}
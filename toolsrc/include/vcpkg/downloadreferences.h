@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vcpkg/packagespec.h>
+#include <vcpkg/vcpkgpaths.h>
+
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Which ports used each file in the downloads directory, kept in downloads/references so that x-downloads-gc can
+/// tell the files the current port tree still needs from the ones that older versions of ports left behind.
+/// </summary>
+namespace vcpkg::DownloadReferences
+{
+    /// <summary>
+    /// The file the port build of `spec` lists the downloads it asks for in, one name per line, as the
+    /// _VCPKG_DOWNLOADS_USED variable tells vcpkg_download_distfile.
+    /// </summary>
+    fs::path get_used_downloads_log(const fs::path& buildtree, const PackageSpec& spec);
+
+    /// <summary>
+    /// Records the downloads listed in `used_downloads_log` as used now by `spec`, built from the files of
+    /// `port_dir` as they are, and removes the log.
+    /// </summary>
+    void record(const VcpkgPaths& paths,
+                const PackageSpec& spec,
+                const fs::path& port_dir,
+                const std::string& abi_tag,
+                const fs::path& used_downloads_log);
+
+    struct GcResult
+    {
+        size_t removed_files = 0;
+        uint64_t removed_bytes = 0;
+        /// <summary>Bytes of the files that ports of the current tree use.</summary>
+        uint64_t referenced_bytes = 0;
+        /// <summary>Bytes of the recently used files that no current port uses, kept up to the limit.</summary>
+        uint64_t unreferenced_bytes = 0;
+    };
+
+    /// <summary>
+    /// Removes the files in the downloads directory that no port of the current tree used, except the most recently
+    /// used of them up to `max_unreferenced_size` bytes in total and anything used within the last hour. Entries of
+    /// the SHA512 download index that are left without another link go too. With `dry_run`, only lists the files.
+    /// </summary>
+    GcResult collect_garbage(const VcpkgPaths& paths, uint64_t max_unreferenced_size, bool dry_run);
+}
@@ -8,5 +8,8 @@ namespace vcpkg::Export
 
     void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet);
 
+    /// <summary>The files of the vcpkg root that an export includes for integrating with build systems.</summary>
+    std::vector<fs::path> get_integration_files_relative_to_root();
+
     void export_integration_files(const fs::path& raw_exported_dir_path, const VcpkgPaths& paths);
 }
@@ -15,6 +15,10 @@ namespace vcpkg
         static std::atomic<bool> debugging;
         static std::atomic<bool> feature_packages;
         static std::atomic<bool> g_binary_caching;
+        static std::atomic<bool> g_link_installed_files;
+        static std::atomic<bool> g_release_only;
+        /// <summary>Dependents hash the output of their dependencies instead of their ABI tags.</summary>
+        static std::atomic<bool> g_output_abi;
 
         static std::atomic<int> g_init_console_cp;
         static std::atomic<int> g_init_console_output_cp;
@@ -37,6 +41,10 @@ namespace vcpkg
             };
 
             std::atomic<CtrlCState> m_state;
+
+            /// <summary>Several children may run at once; the state returns to normal when the last one exits</summary>
+            std::mutex m_children_mutex;
+            size_t m_children;
         };
 
         static CtrlCStateMachine g_ctrl_c_state;
@@ -11,5 +11,19 @@ namespace vcpkg::Input
                                                     const Triplet& default_triplet,
                                                     CStringView example_text);
 
+    /// <summary>
+    /// Parses every spec given on the command line and checks its triplet. Each distinct triplet is only checked
+    /// once, so long lists of specs for the same few triplets stay cheap.
+    /// </summary>
+    std::vector<PackageSpec> check_and_get_package_specs(const std::vector<std::string>& package_specs_as_strings,
+                                                         const Triplet& default_triplet,
+                                                         CStringView example_text,
+                                                         const VcpkgPaths& paths);
+    std::vector<FullPackageSpec> check_and_get_full_package_specs(
+        const std::vector<std::string>& full_package_specs_as_strings,
+        const Triplet& default_triplet,
+        CStringView example_text,
+        const VcpkgPaths& paths);
+
     void check_triplet(const Triplet& t, const VcpkgPaths& paths);
 }
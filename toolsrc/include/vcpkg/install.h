@@ -3,9 +3,14 @@
 #include <vcpkg/base/chrono.h>
 #include <vcpkg/build.h>
 #include <vcpkg/dependencies.h>
+#include <vcpkg/packagetreesnapshot.h>
 #include <vcpkg/vcpkgcmdarguments.h>
 #include <vcpkg/vcpkgpaths.h>
 
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace vcpkg::Install
@@ -18,6 +23,14 @@ namespace vcpkg::Install
 
     inline KeepGoing to_keep_going(const bool value) { return value ? KeepGoing::YES : KeepGoing::NO; }
 
+    enum class Resume
+    {
+        NO = 0,
+        YES
+    };
+
+    inline Resume to_resume(const bool value) { return value ? Resume::YES : Resume::NO; }
+
     struct SpecSummary
     {
         SpecSummary(const PackageSpec& spec, const Dependencies::AnyAction* action);
@@ -27,18 +40,60 @@ namespace vcpkg::Install
         PackageSpec spec;
         Build::ExtendedBuildResult build_result;
         vcpkg::Chrono::ElapsedTime timing;
+        /// <summary>How long the action waited to start after its dependencies were done.</summary>
+        vcpkg::Chrono::ElapsedTime queue_wait;
 
         const Dependencies::AnyAction* action;
     };
 
+    /// <summary>
+    /// Makespans of the executed plan as predicted from the recorded build times.
+    /// </summary>
+    struct ScheduleEstimate
+    {
+        size_t jobs;
+        Chrono::ElapsedTime plan_order;
+        Chrono::ElapsedTime critical_path_first;
+
+        void print() const;
+    };
+
     struct InstallSummary
     {
         std::vector<SpecSummary> results;
         std::string total_elapsed_time;
+        Optional<ScheduleEstimate> schedule_estimate;
 
         void print() const;
-        static std::string xunit_result(const PackageSpec& spec, Chrono::ElapsedTime time, Build::BuildResult code);
-        std::string xunit_results() const;
+        /// <summary>Appends the xunit &lt;test&gt; element of one result to `out`.</summary>
+        static void xunit_result(std::string& out,
+                                 const PackageSpec& spec,
+                                 Chrono::ElapsedTime time,
+                                 Build::BuildResult code,
+                                 const Build::PhaseTimings& timings);
+    };
+
+    /// <summary>
+    /// Writes an xunit document one test at a time. Each test is flushed to the file as it is added, so the document
+    /// is never held in memory whole and can be read while the run is still going.
+    /// </summary>
+    struct XunitWriter
+    {
+        XunitWriter(Files::Filesystem& fs, const fs::path& path);
+
+        void add(const PackageSpec& spec,
+                 Chrono::ElapsedTime time,
+                 Build::BuildResult code,
+                 const Build::PhaseTimings& timings);
+        void add(const SpecSummary& result);
+
+        /// <summary>Writes the closing tags</summary>
+        void close();
+
+    private:
+        fs::path m_path;
+        std::unique_ptr<Files::OutputFile> m_file;
+        std::string m_test;
     };
 
     struct InstallDir
@@ -70,15 +125,78 @@ namespace vcpkg::Install
 
     std::vector<std::string> get_all_port_names(const VcpkgPaths& paths);
 
+    /// <summary>
+    /// Whether `entry` is a CONTROL or BUILD_INFO file, which describe the package and are not installed with it.
+    /// </summary>
+    bool is_package_metadata(const PackageTreeSnapshot::Entry& entry);
+
     void install_files_and_write_listfile(Files::Filesystem& fs, const fs::path& source_dir, const InstallDir& dirs);
+
+    /// <summary>
+    /// Installs the files of an already walked source tree, so callers that also inspect the tree walk it only once.
+    /// With CleanPackages::YES the source directory is removed afterwards anyway, so its files are moved into place
+    /// instead of being copied wherever both directories are on the same volume.
+    /// replaced_dir, unless empty, holds the files of the previous install of the package; those whose contents did
+    /// not change are moved back instead, so they keep their timestamps.
+    /// </summary>
+    void install_files_and_write_listfile(Files::Filesystem& fs,
+                                          const PackageTreeSnapshot& source,
+                                          const InstallDir& dirs,
+                                          Build::CleanPackages clean_packages,
+                                          const fs::path& replaced_dir);
+
     InstallResult install_package(const VcpkgPaths& paths,
                                   const BinaryControlFile& binary_paragraph,
-                                  StatusParagraphs* status_db);
-
+                                  StatusParagraphs* status_db,
+                                  Build::CleanPackages clean_packages);
+
+    /// <summary>
+    /// Takes into this installed tree the packages of the shared one named by VCPKG_INSTALLED_BASE that it has no
+    /// record of, linking their files instead of building them, and adds them to `status_db`. A package is taken only
+    /// if each of its dependencies is installed here with the same ABI tag as there, or is taken too; the others are
+    /// left for this tree to build. Packages removed here stay removed. The shared tree is never written to.
+    /// </summary>
+    void import_installed_base(const VcpkgPaths& paths, StatusParagraphs& status_db);
+
+    /// <summary>
+    /// Adds to `status_db` the packages of the shared tree named by VCPKG_INSTALLED_BASE that this tree has no record
+    /// of, as they are recorded there, without taking their files into this tree or writing anything.
+    /// </summary>
+    void merge_installed_base(const VcpkgPaths& paths, StatusParagraphs& status_db);
+
+    /// <summary>
+    /// Parses a `--x-jobs` style setting. Absent means serial execution; 0 means one job per hardware thread.
+    /// </summary>
+    size_t get_job_count(const ParsedArguments& options, const std::string& option_name);
+
+    /// <summary>
+    /// Computes the ABI tag of every install action from its sources in one pass over the plan, before anything is
+    /// executed, and stores it in the action's planned_abi.
+    /// </summary>
+    void plan_abi_tags(const VcpkgPaths& paths, std::vector<Dependencies::AnyAction>& action_plan);
+
+    /// <summary>
+    /// The tags set by plan_abi_tags. Already installed packages contribute their recorded tag; actions whose tag
+    /// could not be determined are left out.
+    /// </summary>
+    std::unordered_map<PackageSpec, std::string> get_abi_tags(const std::vector<Dependencies::AnyAction>& action_plan);
+
+    /// <summary>
+    /// Executes the plan. With jobs > 1, install actions run as soon as the actions they depend on have finished.
+    /// Packages in `built_elsewhere` are being built by another machine sharing the binary cache; each is only built
+    /// here if neither its archive nor a failure tombstone shows up in the cache within a few hours.
+    /// Every finished build is recorded in a checkpoint until the whole plan has succeeded; with Resume::YES the
+    /// packages the previous run built but did not install are installed without building them again.
+    /// `on_installed` is called with the result of each install action as soon as it has finished.
+    /// </summary>
     InstallSummary perform(const std::vector<Dependencies::AnyAction>& action_plan,
                            const KeepGoing keep_going,
                            const VcpkgPaths& paths,
-                           StatusParagraphs& status_db);
+                           StatusParagraphs& status_db,
+                           const size_t jobs,
+                           const std::unordered_set<PackageSpec>& built_elsewhere = {},
+                           const Resume resume = Resume::NO,
+                           const std::function<void(const SpecSummary&)>& on_installed = nullptr);
 
     extern const CommandStructure COMMAND_STRUCTURE;
 
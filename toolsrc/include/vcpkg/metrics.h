@@ -2,6 +2,7 @@
 
 #include <vcpkg/base/util.h>
 
+#include <functional>
 #include <string>
 
 namespace vcpkg::Metrics
@@ -12,6 +13,11 @@ namespace vcpkg::Metrics
         void set_print_metrics(bool should_print_metrics);
         void set_user_information(const std::string& user_id, const std::string& first_use_time);
         static void init_user_information(std::string& user_id, std::string& first_use_time);
+        /// <summary>
+        /// Looks up the hash of the user's MAC address on a background thread. flush() sends it if the lookup finishes
+        /// in time, and passes it to on_ready so that later runs need not look it up again.
+        /// </summary>
+        void start_user_mac_lookup(std::function<void(const std::string&)> on_ready);
 
         void track_metric(const std::string& name, double value);
         void track_buildtime(const std::string& name, double value);
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <vcpkg/triplet.h>
+#include <vcpkg/vcpkgpaths.h>
+
+namespace vcpkg::MSBuildProps
+{
+    /// <summary>
+    /// Rewrites installed/vcpkg/msbuild/&lt;triplet&gt;.props with the libraries installed for `triplet`, which
+    /// vcpkg.targets imports instead of evaluating the lib\*.lib wildcards for every project. Install and remove call
+    /// it whenever the packages of a triplet change.
+    /// </summary>
+    void write_triplet_props(const VcpkgPaths& paths, const Triplet& triplet);
+}
@@ -4,6 +4,8 @@
 #include <vcpkg/packagespecparseresult.h>
 #include <vcpkg/triplet.h>
 
+#include <string_view>
+
 namespace vcpkg
 {
     struct ParsedSpecifier
@@ -12,9 +14,15 @@ namespace vcpkg
         std::vector<std::string> features;
         std::string triplet;
 
-        static ExpectedT<ParsedSpecifier, PackageSpecParseResult> from_string(const std::string& input);
+        static ExpectedT<ParsedSpecifier, PackageSpecParseResult> from_string(std::string_view input);
     };
 
+    /// <summary>
+    /// A port or feature name stored once for the whole process, so that names compare by address and hash in
+    /// constant time.
+    /// </summary>
+    struct InternedName;
+
     ///
     /// <summary>
     /// Full specification of a package. Contains all information to reference
@@ -23,6 +31,8 @@ namespace vcpkg
     ///
     struct PackageSpec
     {
+        PackageSpec();
+
         static ExpectedT<PackageSpec, PackageSpecParseResult> from_name_and_triplet(const std::string& name,
                                                                                     const Triplet& triplet);
 
@@ -36,6 +46,8 @@ namespace vcpkg
 
         std::string to_string() const;
 
+        size_t hash_code() const;
+
         bool operator<(const PackageSpec& other) const
         {
             if (name() < other.name()) return true;
@@ -43,8 +55,13 @@ namespace vcpkg
             return triplet() < other.triplet();
         }
 
+        bool operator==(const PackageSpec& other) const
+        {
+            return m_name == other.m_name && m_triplet == other.m_triplet;
+        }
+
     private:
-        std::string m_name;
+        const InternedName* m_name;
         Triplet m_triplet;
     };
 
@@ -56,10 +73,10 @@ namespace vcpkg
     ///
     struct FeatureSpec
     {
-        FeatureSpec(const PackageSpec& spec, const std::string& feature) : m_spec(spec), m_feature(feature) {}
+        FeatureSpec(const PackageSpec& spec, const std::string& feature);
 
         const std::string& name() const { return m_spec.name(); }
-        const std::string& feature() const { return m_feature; }
+        const std::string& feature() const;
         const Triplet& triplet() const { return m_spec.triplet(); }
 
         const PackageSpec& spec() const { return m_spec; }
@@ -80,14 +97,71 @@ namespace vcpkg
 
         bool operator==(const FeatureSpec& other) const
         {
-            return triplet() == other.triplet() && name() == other.name() && feature() == other.feature();
+            return m_spec == other.m_spec && m_feature == other.m_feature;
         }
 
         bool operator!=(const FeatureSpec& other) const { return !(*this == other); }
 
     private:
         PackageSpec m_spec;
-        std::string m_feature;
+        const InternedName* m_feature;
+    };
+
+    /// <summary>
+    /// The features of one package, sorted by name and without duplicates. The names are interned like those of
+    /// FeatureSpec, so a list is a single array of pointers, and copying or comparing one touches no strings.
+    /// </summary>
+    struct FeatureList
+    {
+        struct iterator
+        {
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::string;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const std::string*;
+            using reference = const std::string&;
+
+            const std::string& operator*() const { return **m_it; }
+            const std::string* operator->() const { return *m_it; }
+            iterator& operator++()
+            {
+                ++m_it;
+                return *this;
+            }
+            iterator operator++(int)
+            {
+                iterator old = *this;
+                ++m_it;
+                return old;
+            }
+            bool operator==(const iterator& other) const { return m_it == other.m_it; }
+            bool operator!=(const iterator& other) const { return m_it != other.m_it; }
+
+            std::vector<const std::string*>::const_iterator m_it;
+        };
+        using const_iterator = iterator;
+
+        FeatureList() = default;
+        FeatureList(std::initializer_list<std::string> names);
+
+        /// <summary>Adds `name` unless the list has it already.</summary>
+        void insert(const std::string& name);
+        bool contains(const std::string& name) const;
+
+        iterator begin() const { return {m_names.begin()}; }
+        iterator end() const { return {m_names.end()}; }
+        friend iterator begin(const FeatureList& list) { return list.begin(); }
+        friend iterator end(const FeatureList& list) { return list.end(); }
+        size_t size() const { return m_names.size(); }
+        bool empty() const { return m_names.empty(); }
+
+        bool operator==(const FeatureList& other) const { return m_names == other.m_names; }
+        bool operator!=(const FeatureList& other) const { return m_names != other.m_names; }
+
+    private:
+        std::vector<const std::string*>::const_iterator lower_bound(const std::string& name) const;
+
+        std::vector<const std::string*> m_names;
     };
 
     ///
@@ -103,7 +177,7 @@ namespace vcpkg
 
         static std::vector<FeatureSpec> to_feature_specs(const std::vector<FullPackageSpec>& specs);
 
-        static ExpectedT<FullPackageSpec, PackageSpecParseResult> from_string(const std::string& spec_as_string,
+        static ExpectedT<FullPackageSpec, PackageSpecParseResult> from_string(std::string_view spec_as_string,
                                                                               const Triplet& default_triplet);
     };
 
@@ -120,7 +194,6 @@ namespace vcpkg
         static ExpectedT<Features, PackageSpecParseResult> from_string(const std::string& input);
     };
 
-    bool operator==(const PackageSpec& left, const PackageSpec& right);
     bool operator!=(const PackageSpec& left, const PackageSpec& right);
 }
 
@@ -129,13 +202,7 @@ namespace std
     template<>
     struct hash<vcpkg::PackageSpec>
     {
-        size_t operator()(const vcpkg::PackageSpec& value) const
-        {
-            size_t hash = 17;
-            hash = hash * 31 + std::hash<std::string>()(value.name());
-            hash = hash * 31 + std::hash<vcpkg::Triplet>()(value.triplet());
-            return hash;
-        }
+        size_t operator()(const vcpkg::PackageSpec& value) const { return value.hash_code(); }
     };
 
     template<>
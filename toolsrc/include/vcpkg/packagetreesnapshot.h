@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vcpkg/base/files.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace vcpkg
+{
+    /// <summary>
+    /// Every entry below a package directory, with its type and size, found by a single walk of the tree. Lint and
+    /// install filter this list instead of each listing and stat'ing their own parts of the package.
+    /// </summary>
+    struct PackageTreeSnapshot
+    {
+        struct Entry
+        {
+            fs::path path;
+            /// <summary>Relative to the root, with forward slashes</summary>
+            std::string relative;
+            /// <summary>The type of the entry itself, so symlinks are not followed</summary>
+            fs::file_type type;
+            /// <summary>The size of regular files, zero for everything else</summary>
+            uintmax_t size;
+
+            bool is_directory() const { return type == fs::file_type::directory; }
+        };
+
+        static PackageTreeSnapshot create(const Files::Filesystem& fs, const fs::path& root);
+
+        bool contains(const std::string& relative) const;
+
+        /// <summary>Whether relative_dir has anything in it, including empty directories</summary>
+        bool has_entries_below(const std::string& relative_dir) const;
+
+        /// <summary>Everything but directories, at any depth below relative_dir</summary>
+        std::vector<fs::path> files_below(const std::string& relative_dir) const;
+
+        std::vector<fs::path> files_below(const std::string& relative_dir, const std::string& extension) const;
+
+        /// <summary>Everything but directories directly in relative_dir, which is empty for the root itself</summary>
+        std::vector<fs::path> files_in(const std::string& relative_dir) const;
+
+        std::vector<fs::path> empty_directories() const;
+
+        fs::path root;
+        /// <summary>In the order of a recursive walk, so each directory comes before its contents</summary>
+        std::vector<Entry> entries;
+        /// <summary>Indices into entries of the non-directories with each extension, such as ".dll"</summary>
+        std::map<std::string, std::vector<size_t>> files_by_extension;
+    };
+}
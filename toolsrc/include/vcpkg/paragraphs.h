@@ -6,9 +6,26 @@
 
 #include <vcpkg/base/expected.h>
 
+#include <list>
+
 namespace vcpkg::Paragraphs
 {
     using RawParagraph = Parse::RawParagraph;
+    using RawParagraphView = Parse::RawParagraphView;
+
+    /// <summary>
+    /// Paragraphs whose field names and values are views into `text`. Only values that span several lines are
+    /// assembled, into `continuations`. Both are held behind stable addresses so the views survive moves.
+    /// </summary>
+    struct ParagraphViews
+    {
+        std::unique_ptr<const Files::MappedFile> text;
+        std::list<std::string> continuations;
+        std::vector<RawParagraphView> paragraphs;
+    };
+
+    ParagraphViews parse_paragraph_views(std::string&& str);
+    Expected<ParagraphViews> get_paragraph_views(const Files::Filesystem& fs, const fs::path& control_path);
 
     Expected<RawParagraph> get_single_paragraph(const Files::Filesystem& fs, const fs::path& control_path);
     Expected<std::vector<RawParagraph>> get_paragraphs(const Files::Filesystem& fs, const fs::path& control_path);
@@ -17,6 +34,11 @@ namespace vcpkg::Paragraphs
 
     Parse::ParseExpected<SourceControlFile> try_load_port(const Files::Filesystem& fs, const fs::path& control_path);
 
+    /// <summary>
+    /// Parses the text of a CONTROL file that does not come from a ports directory, such as one read out of git.
+    /// </summary>
+    Parse::ParseExpected<SourceControlFile> parse_port(std::string_view control_text);
+
     Expected<BinaryControlFile> try_load_cached_package(const VcpkgPaths& paths, const PackageSpec& spec);
 
     struct LoadResults
@@ -25,8 +47,33 @@ namespace vcpkg::Paragraphs
         std::vector<std::unique_ptr<Parse::ParseControlErrorInfo>> errors;
     };
 
-    LoadResults try_load_all_ports(const Files::Filesystem& fs, const fs::path& ports_dir);
+    /// <summary>
+    /// Keeps the CONTROL files of the ports in ports_dir in index_file, so that try_load_all_ports only reads the
+    /// ports whose CONTROL file changed since the previous run.
+    /// </summary>
+    void enable_port_index(const fs::path& ports_dir, const fs::path& index_file);
+
+    LoadResults try_load_all_ports(Files::Filesystem& fs, const fs::path& ports_dir);
+
+    /// <summary>
+    /// The names of the ports in ports_dir, sorted, without parsing them: the name of a port directory is the name of
+    /// its port. Meant for completions, which must be quick.
+    /// </summary>
+    std::vector<std::string> get_all_port_names(const Files::Filesystem& fs, const fs::path& ports_dir);
+
+    /// <summary>
+    /// The version of each of the named ports in ports_dir, by name, without parsing the ports: the Version field is
+    /// read out of the port index for the ports whose CONTROL file did not change. Missing ports are left out.
+    /// </summary>
+    std::unordered_map<std::string, std::string> get_port_versions(const Files::Filesystem& fs,
+                                                                   const fs::path& ports_dir,
+                                                                   const std::vector<std::string>& names);
+
+    /// <summary>
+    /// Loads the ports in ports_dir now and keeps them for the next try_load_all_ports of ports_dir, which takes them
+    /// instead of reading the tree again. x-server preloads the ports for the processes it forks for its requests.
+    /// </summary>
+    void preload_all_ports(Files::Filesystem& fs, const fs::path& ports_dir);
 
-    std::vector<std::unique_ptr<SourceControlFile>> load_all_ports(const Files::Filesystem& fs,
-                                                                   const fs::path& ports_dir);
+    std::vector<std::unique_ptr<SourceControlFile>> load_all_ports(Files::Filesystem& fs, const fs::path& ports_dir);
 }
@@ -3,7 +3,10 @@
 #include <vcpkg/base/expected.h>
 #include <vcpkg/base/optional.h>
 
+#include <array>
 #include <memory>
+#include <stdexcept>
+#include <string_view>
 #include <unordered_map>
 
 namespace vcpkg::Parse
@@ -21,18 +24,124 @@ namespace vcpkg::Parse
 
     using RawParagraph = std::unordered_map<std::string, std::string>;
 
+    /// <summary>
+    /// The fields of one paragraph in file order, as views into text owned elsewhere.
+    /// </summary>
+    struct RawParagraphView
+    {
+        static RawParagraphView from_raw_paragraph(const RawParagraph& paragraph);
+
+        const std::string_view* find(std::string_view fieldname) const;
+        RawParagraph to_raw_paragraph() const;
+
+        std::vector<std::pair<std::string_view, std::string_view>> fields;
+    };
+
+    /// <summary>
+    /// The names of the fields one kind of paragraph may have, fixed at compile time. Construction searches for a hash
+    /// seed under which every name lands in a slot of its own, so looking up a field costs a hash of four characters
+    /// and one comparison, and a name outside the table is rejected by that same comparison.
+    /// </summary>
+    struct FieldTable
+    {
+        static constexpr size_t MAX_FIELDS = 16;
+        static constexpr size_t npos = static_cast<size_t>(-1);
+
+        template<size_t N>
+        constexpr FieldTable(const std::string_view (&names)[N]) : m_names(), m_size(N), m_seed(0), m_slots()
+        {
+            static_assert(N <= MAX_FIELDS, "FieldTable holds at most MAX_FIELDS names");
+            for (size_t i = 0; i < N; ++i)
+                m_names[i] = names[i];
+            m_seed = find_seed();
+            for (size_t i = 0; i < N; ++i)
+                m_slots[slot(m_seed, m_names[i])] = static_cast<uint8_t>(i + 1);
+        }
+
+        constexpr size_t size() const { return m_size; }
+        constexpr std::string_view name(size_t field) const { return m_names[field]; }
+
+        /// <summary>The position of `fieldname` in the table, or npos.</summary>
+        constexpr size_t index_of(std::string_view fieldname) const
+        {
+            if (fieldname.empty()) return npos;
+            const size_t candidate = m_slots[slot(m_seed, fieldname)];
+            if (candidate == 0 || m_names[candidate - 1] != fieldname) return npos;
+            return candidate - 1;
+        }
+
+        /// <summary>The position of a name known to be in the table; in a constant expression, a typo fails to
+        /// compile.</summary>
+        constexpr size_t id(std::string_view fieldname) const
+        {
+            const size_t field = index_of(fieldname);
+            return field != npos ? field : throw std::invalid_argument("the field is not in the table");
+        }
+
+    private:
+        static constexpr size_t SLOT_BITS = 6;
+
+        static constexpr size_t slot(uint32_t seed, std::string_view fieldname)
+        {
+            const unsigned char keys[] = {
+                static_cast<unsigned char>(fieldname.size()),
+                static_cast<unsigned char>(fieldname[0]),
+                static_cast<unsigned char>(fieldname[fieldname.size() / 2]),
+                static_cast<unsigned char>(fieldname[fieldname.size() - 1]),
+            };
+            uint32_t hash = seed;
+            for (const unsigned char key : keys)
+                hash = (hash ^ key) * 16777619u;
+            return hash >> (32 - SLOT_BITS);
+        }
+
+        constexpr uint32_t find_seed() const
+        {
+            for (uint32_t seed = 2166136261u;; ++seed)
+            {
+                uint64_t taken = 0;
+                size_t i = 0;
+                for (; i < m_size; ++i)
+                {
+                    const uint64_t bit = uint64_t(1) << slot(seed, m_names[i]);
+                    if (taken & bit) break;
+                    taken |= bit;
+                }
+                if (i == m_size) return seed;
+            }
+        }
+
+        std::array<std::string_view, MAX_FIELDS> m_names;
+        size_t m_size;
+        uint32_t m_seed;
+        std::array<uint8_t, size_t(1) << SLOT_BITS> m_slots;
+    };
+
+    /// <summary>
+    /// Sorts the fields of a paragraph into the slots of a FieldTable in one pass, noting the fields the table does not
+    /// know on the way. Fields are then taken by their position in the table.
+    /// </summary>
     struct ParagraphParser
     {
-        ParagraphParser(RawParagraph&& fields) : fields(std::move(fields)) {}
+        ParagraphParser(const RawParagraphView& paragraph, const FieldTable& table);
 
-        void required_field(const std::string& fieldname, std::string& out);
-        std::string optional_field(const std::string& fieldname) const;
+        void required_field(size_t field, std::string& out);
+        std::string optional_field(size_t field) const;
+        /// <summary>The value of an optional field without copying it, valid as long as the paragraph's text.</summary>
+        std::string_view optional_field_view(size_t field) const;
         std::unique_ptr<ParseControlErrorInfo> error_info(const std::string& name) const;
 
     private:
-        RawParagraph&& fields;
+        const FieldTable& table;
+        std::array<std::string_view, FieldTable::MAX_FIELDS> values;
+        uint32_t present = 0;
+        mutable uint32_t taken = 0;
+        std::vector<std::string> extra_fields;
         std::vector<std::string> missing_fields;
     };
 
-    std::vector<std::string> parse_comma_list(const std::string& str);
+    std::vector<std::string> parse_comma_list(std::string_view str);
+
+    /// <summary>The elements of a ", " separated list as views into `str`.</summary>
+    std::vector<std::string_view> split_comma_list(std::string_view str);
 }
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vcpkg/base/files.h>
+#include <vcpkg/dependencies.h>
+#include <vcpkg/statusparagraphs.h>
+#include <vcpkg/vcpkgpaths.h>
+
+#include <vector>
+
+/// <summary>
+/// Install plans saved to a file by `install --x-write-plan` and run by `install --x-from-plan`, so that machines
+/// running the same plan neither load the whole port tree nor plan and compute ABI tags again. A plan file is a header
+/// paragraph followed by one paragraph per action, in the order they run.
+/// </summary>
+namespace vcpkg::PlanFile
+{
+    /// <summary>
+    /// Writes `action_plan` to `path` with the ABI tags plan_abi_tags gave it, keyed by the hashes of the ports it
+    /// builds and of the status database it was made against.
+    /// </summary>
+    void write(const VcpkgPaths& paths,
+               const StatusParagraphs& status_db,
+               const std::vector<Dependencies::AnyAction>& action_plan,
+               const fs::path& path);
+
+    /// <summary>
+    /// Reads the plan written to `path`. Only the ports it builds are loaded from `provider`, which the actions point
+    /// into. Exits with an error if the ports or the installed packages changed since the plan was made.
+    /// </summary>
+    std::vector<Dependencies::AnyAction> read(const VcpkgPaths& paths,
+                                              const StatusParagraphs& status_db,
+                                              const Dependencies::PortFileProvider& provider,
+                                              const fs::path& path);
+}
@@ -4,7 +4,7 @@
 #include <vcpkg/build.h>
 
 #include <array>
-#include <regex>
+#include <string>
 
 namespace vcpkg::PostBuildLint
 {
@@ -33,7 +33,8 @@ namespace vcpkg::PostBuildLint
 
         const Build::ConfigurationType& config() const;
         const Build::LinkageType& linkage() const;
-        const std::regex& crt_regex() const;
+        /// <summary>Whether a linker directive pulls in the CRT of this build type, such as /DEFAULTLIB:LIBCMTD</summary>
+        bool is_crt_directive(const std::string& directive) const;
         const std::string& to_string() const;
 
     private:
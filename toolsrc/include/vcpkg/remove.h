@@ -14,13 +14,30 @@ namespace vcpkg::Remove
 
     inline Purge to_purge(const bool value) { return value ? Purge::YES : Purge::NO; }
 
+    /// <summary>
+    /// With KeepFiles::YES the package is about to be installed again, so its files are moved below
+    /// replaced_files_dir instead of being deleted. Installing then puts back every file that did not change, which
+    /// keeps its timestamp.
+    /// </summary>
+    enum class KeepFiles
+    {
+        NO = 0,
+        YES
+    };
+
+    fs::path replaced_files_dir(const VcpkgPaths& paths, const PackageSpec& spec);
+
     void perform_remove_plan_action(const VcpkgPaths& paths,
                                     const Dependencies::RemovePlanAction& action,
                                     const Purge purge,
-                                    StatusParagraphs* status_db);
+                                    StatusParagraphs* status_db,
+                                    const KeepFiles keep_files);
 
     extern const CommandStructure COMMAND_STRUCTURE;
 
     void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet);
-    void remove_package(const VcpkgPaths& paths, const PackageSpec& spec, StatusParagraphs* status_db);
+    void remove_package(const VcpkgPaths& paths,
+                        const PackageSpec& spec,
+                        StatusParagraphs* status_db,
+                        const KeepFiles keep_files);
 }
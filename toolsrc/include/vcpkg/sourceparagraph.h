@@ -12,16 +12,42 @@
 
 namespace vcpkg
 {
+    /// <summary>
+    /// A qualifier such as `windows&!uwp`, split into its terms once when the CONTROL file is parsed. Every term has to
+    /// hold: the triplet name contains its text, or does not if the term is negated.
+    /// </summary>
+    struct DependencyQualifier
+    {
+        struct Term
+        {
+            std::string text;
+            bool negated;
+        };
+
+        static DependencyQualifier parse(std::string_view qualifier);
+
+        bool matches(const Triplet& t) const;
+
+        std::vector<Term> terms;
+    };
+
     struct Dependency
     {
         Features depend;
         std::string qualifier;
+        DependencyQualifier parsed_qualifier;
 
         std::string name() const;
+        /// <summary>Whether the qualifier, such as `windows&!uwp`, selects this dependency for triplet `t`.</summary>
+        bool applies_to(const Triplet& t) const { return parsed_qualifier.matches(t); }
         static Dependency parse_dependency(std::string name, std::string qualifier);
     };
 
     std::vector<std::string> filter_dependencies(const std::vector<Dependency>& deps, const Triplet& t);
+    /// <summary>
+    /// The dependencies that apply to `t` as specs, one per feature, built from the parsed dependencies rather than
+    /// from their names.
+    /// </summary>
     std::vector<FeatureSpec> filter_dependencies_to_specs(const std::vector<Dependency>& deps, const Triplet& t);
 
     // zlib[uwp] becomes Dependency{"zlib", "uwp"}
@@ -39,6 +65,77 @@ namespace vcpkg
         std::vector<Dependency> depends;
     };
 
+    /// <summary>
+    /// The `Supports:` clauses of a port, lowered into one bit mask per property when the port is loaded. A property
+    /// the port does not restrict has every bit set.
+    /// </summary>
+    struct Supports
+    {
+        static ExpectedT<Supports, std::vector<std::string>> parse(const std::vector<std::string>& strs);
+
+        using Architecture = System::CPUArchitecture;
+
+        enum class Platform
+        {
+            WINDOWS,
+            UWP,
+        };
+        enum class Linkage
+        {
+            DYNAMIC,
+            STATIC,
+        };
+        enum class ToolsetVersion
+        {
+            V140,
+            V141,
+        };
+
+        static constexpr uint8_t ANY = 0xFF;
+        /// <summary>A value no clause names, such as a platform other than Windows</summary>
+        static constexpr uint8_t OTHER = 0x80;
+
+        /// <summary>
+        /// The properties of one triplet, one bit for each that is known. Unknown ones have every bit set and match
+        /// any clause.
+        /// </summary>
+        struct Target
+        {
+            uint8_t architectures = ANY;
+            uint8_t platforms = ANY;
+            uint8_t crt_linkages = ANY;
+            uint8_t toolsets = ANY;
+        };
+
+        template<class E>
+        static constexpr uint8_t bit(E value)
+        {
+            return static_cast<uint8_t>(1u << static_cast<unsigned>(value));
+        }
+
+        bool is_supported(Architecture arch, Platform plat, Linkage crt, ToolsetVersion tools) const
+        {
+            return is_supported(Target{bit(arch), bit(plat), bit(crt), bit(tools)});
+        }
+
+        bool is_supported(const Target& target) const
+        {
+            return (architectures & target.architectures) != 0 && (platforms & target.platforms) != 0 &&
+                   (crt_linkages & target.crt_linkages) != 0 && (toolsets & target.toolsets) != 0;
+        }
+
+        bool is_unrestricted() const
+        {
+            return architectures == ANY && platforms == ANY && crt_linkages == ANY && toolsets == ANY;
+        }
+
+    private:
+        uint8_t architectures = ANY;
+        uint8_t platforms = ANY;
+        uint8_t crt_linkages = ANY;
+        uint8_t toolsets = ANY;
+    };
+
     /// <summary>
     /// Port metadata of the core feature of a package (part of CONTROL file)
     /// </summary>
@@ -49,6 +146,8 @@ namespace vcpkg
         std::string description;
         std::string maintainer;
         std::vector<std::string> supports;
+        /// <summary>`supports` as parsed when the port was loaded; unrestricted if it has unknown values</summary>
+        Supports parsed_supports;
         std::vector<Dependency> depends;
         std::vector<std::string> default_features;
     };
@@ -60,6 +159,8 @@ namespace vcpkg
     {
         static Parse::ParseExpected<SourceControlFile> parse_control_file(
             std::vector<Parse::RawParagraph>&& control_paragraphs);
+        static Parse::ParseExpected<SourceControlFile> parse_control_file(
+            const std::vector<Parse::RawParagraphView>& control_paragraphs);
 
         std::unique_ptr<SourceParagraph> core_paragraph;
         std::vector<std::unique_ptr<FeatureParagraph>> feature_paragraphs;
@@ -72,35 +173,4 @@ namespace vcpkg
     {
         return print_error_message({&error_info_list, 1});
     }
-
-    struct Supports
-    {
-        static ExpectedT<Supports, std::vector<std::string>> parse(const std::vector<std::string>& strs);
-
-        using Architecture = System::CPUArchitecture;
-
-        enum class Platform
-        {
-            WINDOWS,
-            UWP,
-        };
-        enum class Linkage
-        {
-            DYNAMIC,
-            STATIC,
-        };
-        enum class ToolsetVersion
-        {
-            V140,
-            V141,
-        };
-
-        bool is_supported(Architecture arch, Platform plat, Linkage crt, ToolsetVersion tools);
-
-    private:
-        std::vector<Architecture> architectures;
-        std::vector<Platform> platforms;
-        std::vector<Linkage> crt_linkages;
-        std::vector<ToolsetVersion> toolsets;
-    };
 }
@@ -31,6 +31,7 @@ namespace vcpkg
     {
         StatusParagraph() noexcept;
         explicit StatusParagraph(std::unordered_map<std::string, std::string>&& fields);
+        explicit StatusParagraph(const Parse::RawParagraphView& fields);
 
         bool is_installed() const { return want == Want::INSTALL && state == InstallState::INSTALLED; }
 
@@ -1,8 +1,10 @@
 #pragma once
+#include <vcpkg/base/files.h>
 #include <vcpkg/statusparagraph.h>
 
 #include <iterator>
 #include <memory>
+#include <unordered_map>
 
 namespace vcpkg
 {
@@ -65,6 +67,7 @@ namespace vcpkg
         iterator insert(std::unique_ptr<StatusParagraph>);
 
         friend void serialize(const StatusParagraphs& pgh, std::string& out_str);
+        friend void serialize(const StatusParagraphs& pgh, Files::OutputFile& out);
 
         iterator end() { return paragraphs.rend(); }
 
@@ -75,8 +78,20 @@ namespace vcpkg
         const_iterator begin() const { return paragraphs.rbegin(); }
 
     private:
+        template<class This, class F>
+        static void for_each_named(This& self, const std::string& name, F f);
+
         std::vector<std::unique_ptr<StatusParagraph>> paragraphs;
+
+        /// <summary>Positions in paragraphs of every paragraph of a package name, in ascending order</summary>
+        std::unordered_map<std::string, std::vector<size_t>> by_name;
     };
 
     void serialize(const StatusParagraphs& pgh, std::string& out_str);
+
+    /// <summary>
+    /// Writes the same text as serialize() into `out` one paragraph at a time, so the whole status file is never held
+    /// in memory.
+    /// </summary>
+    void serialize(const StatusParagraphs& pgh, Files::OutputFile& out);
 }
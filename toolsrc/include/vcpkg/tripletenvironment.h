@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vcpkg/base/files.h>
+#include <vcpkg/base/optional.h>
+
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Evaluates get_triplet_environment.cmake and the triplet file it includes without running CMake, for the simple
+/// files nearly every triplet is: literal set() calls, if() on PORT or on variables set before, and message(). Each
+/// triplet that needs more of the language is left to CMake.
+/// </summary>
+namespace vcpkg::TripletEnvironment
+{
+    /// <summary>
+    /// The lines that `cmake -DCMAKE_TRIPLET_FILE=<triplet_file> -P <script_file>` prints, given the contents of both
+    /// files; nullopt when either uses something that is not evaluated here.
+    /// </summary>
+    Optional<std::vector<std::string>> try_evaluate(const fs::path& script_file,
+                                                    const std::string& script,
+                                                    const fs::path& triplet_file,
+                                                    const std::string& triplet);
+}
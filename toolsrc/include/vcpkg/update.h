@@ -20,5 +20,18 @@ namespace vcpkg::Update
     std::vector<OutdatedPackage> find_outdated_packages(const Dependencies::PortFileProvider& provider,
                                                         const StatusParagraphs& status_db);
 
+    /// <summary>
+    /// Like the overload taking a provider, but only reads the Version field of each installed port, through the port
+    /// index, instead of loading the ports.
+    /// </summary>
+    std::vector<OutdatedPackage> find_outdated_packages(const VcpkgPaths& paths, const StatusParagraphs& status_db);
+
+    /// <summary>
+    /// The installed packages whose port files hash differently from the "port_files" entry of the abi info they were
+    /// built with, whatever their version. Packages built without binary caching have no abi info and are left out.
+    /// </summary>
+    std::vector<OutdatedPackage> find_packages_with_changed_port_files(const VcpkgPaths& paths,
+                                                                       const StatusParagraphs& status_db);
+
     void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths);
 }
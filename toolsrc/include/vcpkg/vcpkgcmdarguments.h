@@ -74,6 +74,12 @@ namespace vcpkg
 
         std::unique_ptr<std::string> vcpkg_root_dir;
         std::unique_ptr<std::string> triplet;
+        std::unique_ptr<std::string> trace_file;
+        std::unique_ptr<std::string> openmetrics_file;
+        std::unique_ptr<std::string> process_log_file;
+        Optional<size_t> max_threads = nullopt;
+        Optional<bool> fs_stats = nullopt;
+        Optional<bool> alloc_stats = nullopt;
         Optional<bool> debug = nullopt;
         Optional<bool> sendmetrics = nullopt;
         Optional<bool> printmetrics = nullopt;
@@ -1,14 +1,65 @@
 #pragma once
 
 #include <vcpkg/base/sortedvector.h>
+#include <vcpkg/base/span.h>
 #include <vcpkg/statusparagraphs.h>
 #include <vcpkg/vcpkgpaths.h>
 
 namespace vcpkg
 {
-    StatusParagraphs database_load_check(const VcpkgPaths& paths);
+    /// <summary>What database_load_check does with the packages of the shared tree in VCPKG_INSTALLED_BASE</summary>
+    enum class InstalledBase
+    {
+        /// <summary>Lists them as installed, for commands that only read this tree</summary>
+        MERGE,
+        /// <summary>Takes them into this tree, for commands that change it or build against it</summary>
+        IMPORT,
+    };
+
+    StatusParagraphs database_load_check(const VcpkgPaths& paths, InstalledBase installed_base = InstalledBase::MERGE);
+
+    /// <summary>
+    /// Loads the status database now and keeps it for the next database_load_check of the same tree, which takes it
+    /// instead of reading the files again. x-server preloads it for the processes it forks for its requests, which
+    /// only read the tree.
+    /// </summary>
+    void database_preload(const VcpkgPaths& paths);
+
+    /// <summary>
+    /// The status database of the installed tree `installed` of another vcpkg root, read without writing anything or
+    /// taking its locks, since that tree may be read-only.
+    /// </summary>
+    StatusParagraphs database_load_read_only(const Files::Filesystem& fs, const fs::path& installed);
+
+    /// <summary>Folds all pending update files into the status file</summary>
+    void database_compact(const VcpkgPaths& paths);
+
+    /// <summary>Journals several status changes at once, in a single update file</summary>
+    void write_update(const VcpkgPaths& paths, Span<const StatusParagraph> pghs);
 
-    void write_update(const VcpkgPaths& paths, const StatusParagraph& p);
+    struct InstalledSummaryEntry
+    {
+        std::string displayname;
+        std::string version;
+        std::string description;
+    };
+
+    /// <summary>
+    /// The installed packages and features, sorted by display name, as recorded in installed/vcpkg/summary. Every load
+    /// of the database and every update keeps that file current, so `list` can print it without parsing the status
+    /// paragraphs. Nullopt when the file is missing or does not match the status database, e.g. after an older vcpkg
+    /// changed it.
+    /// </summary>
+    Optional<std::vector<InstalledSummaryEntry>> try_load_installed_summary(const VcpkgPaths& paths);
+
+    /// <summary>
+    /// Takes the lock installed/vcpkg/locks/`name`.lock, waiting for other vcpkg processes that hold it. The status
+    /// database is guarded by the lock named "status"; the build directories by locks named after them.
+    /// </summary>
+    std::unique_ptr<Files::FileLock> lock_vcpkg_dir(const VcpkgPaths& paths, const std::string& name);
+
+    /// <summary>Like lock_vcpkg_dir, but returns null instead of waiting when another process holds the lock.</summary>
+    std::unique_ptr<Files::FileLock> try_lock_vcpkg_dir(const VcpkgPaths& paths, const std::string& name);
 
     struct StatusParagraphAndAssociatedFiles
     {
@@ -17,6 +68,17 @@ namespace vcpkg
     };
 
     std::vector<InstalledPackageView> get_installed_ports(const StatusParagraphs& status_db);
+
+    /// <summary>
+    /// The reverse of the dependencies of installed_ports: for each installed package, the installed packages of the
+    /// same triplet that depend on it, in the order of installed_ports. Built in one pass, so planners can look up the
+    /// dependents of a package instead of scanning every installed package.
+    /// </summary>
+    std::unordered_map<PackageSpec, std::vector<PackageSpec>> get_installed_dependents(
+        const std::vector<InstalledPackageView>& installed_ports);
+
+    /// <summary>The files, without the directories, that the listfile of pgh records</summary>
+    SortedVector<std::string> get_installed_files(const VcpkgPaths& paths, const StatusParagraph& pgh);
     std::vector<StatusParagraphAndAssociatedFiles> get_installed_files(const VcpkgPaths& paths,
                                                                        const StatusParagraphs& status_db);
 
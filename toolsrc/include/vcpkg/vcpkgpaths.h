@@ -1,5 +1,6 @@
 #pragma once
 
+#include <vcpkg/binarycaching.h>
 #include <vcpkg/binaryparagraph.h>
 #include <vcpkg/packagespec.h>
 #include <vcpkg/tools.h>
@@ -18,6 +19,7 @@ namespace vcpkg
         static const std::string GIT = "git";
         static const std::string NINJA = "ninja";
         static const std::string NUGET = "nuget";
+        static const std::string ZSTD = "zstd";
         static const std::string IFW_INSTALLER_BASE = "ifw_installerbase";
         static const std::string IFW_BINARYCREATOR = "ifw_binarycreator";
         static const std::string IFW_REPOGEN = "ifw_repogen";
@@ -71,6 +73,9 @@ namespace vcpkg
         fs::path buildsystems;
         fs::path buildsystems_msbuild_targets;
 
+        /// <summary>The shared, read-only installed tree named by VCPKG_INSTALLED_BASE, or empty</summary>
+        fs::path installed_base;
+
         fs::path vcpkg_dir;
         fs::path vcpkg_dir_status_file;
         fs::path vcpkg_dir_info;
@@ -81,6 +86,12 @@ namespace vcpkg
         const fs::path& get_tool_exe(const std::string& tool) const;
         const std::string& get_tool_version(const std::string& tool) const;
 
+        /// <summary>
+        /// Starts looking for each of `tools` on the thread pool, downloading and extracting those that are missing,
+        /// and returns at once. get_tool_exe then waits only for the tool it asks for.
+        /// </summary>
+        void prefetch_tools(std::vector<std::string> tools) const;
+
         /// <summary>Retrieve a toolset matching a VS version</summary>
         /// <remarks>
         ///   Valid version strings are "v120", "v140", "v141", and "". Empty string gets the latest.
@@ -89,6 +100,15 @@ namespace vcpkg
 
         Files::Filesystem& get_filesystem() const;
 
+        /// <summary>
+        /// Makes get_filesystem remember the status of each path it is asked about for the rest of the command. For
+        /// commands that only read and start no builds or downloads; called before any other thread uses the paths.
+        /// </summary>
+        void cache_file_statuses() const;
+
+        /// <summary>Binary package archives under `root/archives`, backed by the VCPKG_BINARY_CACHE remotes.</summary>
+        const BinaryCache& get_binary_cache() const;
+
     private:
         Lazy<std::vector<std::string>> available_triplets;
         Lazy<std::vector<Toolset>> toolsets;
@@ -96,6 +116,8 @@ namespace vcpkg
 
         fs::path default_vs_path;
 
-        mutable std::unique_ptr<ToolCache> m_tool_cache;
+        Lazy<std::unique_ptr<ToolCache>> m_tool_cache;
+        Lazy<std::unique_ptr<BinaryCache>> m_binary_cache;
+        mutable std::unique_ptr<Files::Filesystem> m_stat_caching_filesystem;
     };
 }
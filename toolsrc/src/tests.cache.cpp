@@ -0,0 +1,125 @@
+#include "tests.pch.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+using vcpkg::Cache;
+using vcpkg::Lazy;
+
+namespace UnitTest1
+{
+    class CacheTests : public TestClass<CacheTests>
+    {
+        static constexpr int THREADS = 16;
+
+        /// <summary>Runs f on THREADS threads, released together so that they all contend at once</summary>
+        template<class F>
+        static void run_concurrently(const F& f)
+        {
+            std::atomic<int> waiting(THREADS);
+            std::vector<std::thread> threads;
+            for (int i = 0; i < THREADS; ++i)
+            {
+                threads.emplace_back([&, i]() {
+                    --waiting;
+                    while (waiting.load() != 0)
+                        std::this_thread::yield();
+                    f(i);
+                });
+            }
+            for (auto&& thread : threads)
+            {
+                thread.join();
+            }
+        }
+
+        TEST_METHOD(lazy_computes_once_under_contention)
+        {
+            Lazy<std::vector<int>> lazy;
+            std::atomic<int> calls(0);
+            std::vector<const std::vector<int>*> seen(THREADS);
+
+            run_concurrently([&](int i) {
+                seen[i] = &lazy.get_lazy([&]() {
+                    ++calls;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    return std::vector<int>{1, 2, 3};
+                });
+            });
+
+            Assert::AreEqual(1, calls.load());
+            for (auto&& value : seen)
+            {
+                Assert::IsTrue(value == seen[0]);
+                Assert::AreEqual(size_t(3), value->size());
+            }
+        }
+
+        TEST_METHOD(lazy_keeps_value_when_moved)
+        {
+            Lazy<std::string> lazy;
+            lazy.get_lazy([]() { return std::string("first"); });
+
+            Lazy<std::string> moved(std::move(lazy));
+            Assert::AreEqual("first", moved.get_lazy([]() { return std::string("second"); }).c_str());
+        }
+
+        TEST_METHOD(lazy_retries_after_exception)
+        {
+            Lazy<int> lazy;
+            try
+            {
+                lazy.get_lazy([]() -> int { throw std::runtime_error("failed"); });
+            }
+            catch (const std::runtime_error&)
+            {
+            }
+
+            Assert::AreEqual(5, lazy.get_lazy([]() { return 5; }));
+        }
+
+        TEST_METHOD(cache_computes_each_key_once_under_contention)
+        {
+            static constexpr int KEYS = 100;
+            Cache<int, std::string> cache;
+            std::vector<std::atomic<int>> calls(KEYS);
+            std::vector<std::vector<const std::string*>> seen(THREADS, std::vector<const std::string*>(KEYS));
+
+            run_concurrently([&](int i) {
+                for (int k = 0; k < KEYS; ++k)
+                {
+                    // Each thread starts at a different key, so threads both share and race on keys
+                    const int key = (k + i * 7) % KEYS;
+                    seen[i][key] = &cache.get_lazy(key, [&]() {
+                        ++calls[key];
+                        return std::to_string(key);
+                    });
+                }
+            });
+
+            for (int key = 0; key < KEYS; ++key)
+            {
+                Assert::AreEqual(1, calls[key].load());
+                Assert::AreEqual(std::to_string(key), *seen[0][key]);
+                for (auto&& thread_seen : seen)
+                {
+                    Assert::IsTrue(thread_seen[key] == seen[0][key]);
+                }
+            }
+        }
+
+        TEST_METHOD(cache_computes_other_keys_while_one_is_computed)
+        {
+            Cache<std::string, int> cache;
+
+            // A value that needs another value of the same cache must not wait on itself
+            const int outer =
+                cache.get_lazy("outer", [&]() { return cache.get_lazy("inner", []() { return 1; }) + 1; });
+
+            Assert::AreEqual(2, outer);
+            Assert::AreEqual(1, cache.get_lazy("inner", []() { return 0; }));
+        }
+    };
+}
@@ -0,0 +1,56 @@
+#include "tests.pch.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Deflate = vcpkg::Deflate;
+
+namespace UnitTest1
+{
+    class DeflateTests : public TestClass<DeflateTests>
+    {
+        static void check_round_trip(const std::string& data)
+        {
+            std::string out;
+            Assert::IsTrue(Deflate::decompress(Deflate::compress(data), out));
+            Assert::IsTrue(data == out);
+        }
+
+        TEST_METHOD(round_trip_empty) { check_round_trip(""); }
+
+        TEST_METHOD(round_trip_repetitive)
+        {
+            std::string data;
+            for (int i = 0; i < 100000; ++i)
+                data += "vcpkg " + std::to_string(i % 97);
+            check_round_trip(data);
+        }
+
+        TEST_METHOD(round_trip_incompressible)
+        {
+            std::string data(300000, '\0');
+            uint32_t state = 1;
+            for (auto&& ch : data)
+            {
+                state = state * 1103515245 + 12345;
+                ch = static_cast<char>(state >> 24);
+            }
+            check_round_trip(data);
+        }
+
+        TEST_METHOD(decompress_fixed_block_with_matches)
+        {
+            // "abcabcabc" as emitted by zlib with the fixed Huffman strategy
+            const std::string compressed("\x4b\x4c\x4a\x4e\x04\x23\x00", 7);
+            std::string out;
+            Assert::IsTrue(Deflate::decompress(compressed, out));
+            Assert::AreEqual(std::string("abcabcabc"), out);
+        }
+
+        TEST_METHOD(decompress_rejects_truncated_input)
+        {
+            const auto compressed = Deflate::compress(std::string(1000, 'x'));
+            std::string out;
+            Assert::IsFalse(Deflate::decompress(compressed.substr(0, compressed.size() / 2), out));
+        }
+    };
+}
@@ -33,6 +33,20 @@ namespace UnitTest1
             Assert::AreEqual("libB", v2[0].c_str());
             Assert::AreEqual("libC", v2[1].c_str());
         }
+
+        TEST_METHOD(filter_depends_to_specs)
+        {
+            auto deps = expand_qualified_dependencies(parse_comma_list("liba (windows&!uwp), libb[f1], libc (uwp)"));
+            auto v = filter_dependencies_to_specs(deps, Triplet::X64_WINDOWS);
+            Assert::AreEqual(size_t(2), v.size());
+            Assert::AreEqual("liba:x64-windows", v[0].to_string().c_str());
+            Assert::AreEqual("libb[f1]:x64-windows", v[1].to_string().c_str());
+
+            auto v2 = filter_dependencies_to_specs(deps, Triplet::ARM_UWP);
+            Assert::AreEqual(size_t(2), v2.size());
+            Assert::AreEqual("libb[f1]:arm-uwp", v2[0].to_string().c_str());
+            Assert::AreEqual("libc:arm-uwp", v2[1].to_string().c_str());
+        }
     };
 
     class SupportsTests : public TestClass<SupportsTests>
@@ -104,5 +118,22 @@ namespace UnitTest1
                                                  Supports::Linkage::STATIC,
                                                  Supports::ToolsetVersion::V141));
         }
+
+        TEST_METHOD(supports_unknown_target_properties)
+        {
+            auto v = Supports::parse({"x64", "uwp"});
+            Assert::AreNotEqual(uintptr_t(0), uintptr_t(v.get()));
+
+            Supports::Target target;
+            Assert::IsTrue(v.get()->is_supported(target));
+
+            target.architectures = Supports::bit(System::CPUArchitecture::X64);
+            target.platforms = Supports::bit(Supports::Platform::UWP);
+            Assert::IsTrue(v.get()->is_supported(target));
+
+            target.platforms = Supports::OTHER;
+            Assert::IsFalse(v.get()->is_supported(target));
+            Assert::IsTrue(Supports().is_supported(target));
+        }
     };
 }
@@ -0,0 +1,73 @@
+#include "tests.pch.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Hash = vcpkg::Hash;
+
+namespace UnitTest1
+{
+    class HashTests : public TestClass<HashTests>
+    {
+        static std::string hash_of(Hash::Algorithm algorithm, const std::string& data)
+        {
+            auto hasher = Hash::get_hasher_for(algorithm);
+            hasher->add_bytes(data.data(), data.size());
+            return hasher->get_hash();
+        }
+
+        TEST_METHOD(sha1_known_answers)
+        {
+            Assert::AreEqual("da39a3ee5e6b4b0d3255bfef95601890afd80709", hash_of(Hash::Algorithm::SHA1, "").c_str());
+            Assert::AreEqual("a9993e364706816aba3e25717850c26c9cd0d89d", hash_of(Hash::Algorithm::SHA1, "abc").c_str());
+            Assert::AreEqual(
+                "84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+                hash_of(Hash::Algorithm::SHA1, "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq").c_str());
+        }
+
+        TEST_METHOD(sha256_known_answers)
+        {
+            Assert::AreEqual("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+                             hash_of(Hash::Algorithm::SHA256, "").c_str());
+            Assert::AreEqual("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+                             hash_of(Hash::Algorithm::SHA256, "abc").c_str());
+            Assert::AreEqual("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+                             hash_of(Hash::Algorithm::SHA256, std::string(1000000, 'a')).c_str());
+        }
+
+        TEST_METHOD(sha512_known_answers)
+        {
+            Assert::AreEqual("ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a2192992a274fc1a836ba3c23a3fe"
+                             "ebbd454d4423643ce80e2a9ac94fa54ca49f",
+                             hash_of(Hash::Algorithm::SHA512, "abc").c_str());
+            Assert::AreEqual(
+                "204a8fc6dda82f0a0ced7beb8e08a41657c16ef468b228a8279be331a703c33596fd15c13b1b07f9aa1d3bea57789ca031ad85c7a71d"
+                "d70354ec631238ca3445",
+                hash_of(Hash::Algorithm::SHA512, "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq").c_str());
+        }
+
+        TEST_METHOD(string_hash_accepts_any_content)
+        {
+            const std::string abi_info = "cmake 3.14.0\nfeatures core;ssl\nport_files 0123\n";
+            Assert::AreEqual(hash_of(Hash::Algorithm::SHA1, abi_info).c_str(),
+                             Hash::get_string_hash(abi_info, "SHA1").c_str());
+            Assert::AreEqual("a9993e364706816aba3e25717850c26c9cd0d89d", Hash::get_string_hash("abc", "sha1").c_str());
+        }
+
+        TEST_METHOD(incremental_matches_one_shot)
+        {
+            std::string data;
+            for (int i = 0; i < 5000; ++i)
+                data += std::to_string(i * 7919);
+
+            for (auto algorithm : {Hash::Algorithm::SHA1, Hash::Algorithm::SHA256, Hash::Algorithm::SHA512})
+            {
+                auto hasher = Hash::get_hasher_for(algorithm);
+                for (size_t offset = 0, chunk = 1; offset < data.size(); offset += chunk, chunk = chunk * 3 % 251 + 1)
+                {
+                    hasher->add_bytes(data.data() + offset, std::min(chunk, data.size() - offset));
+                }
+                Assert::AreEqual(hash_of(algorithm, data).c_str(), hasher->get_hash().c_str());
+            }
+        }
+    };
+}
@@ -364,6 +364,22 @@ namespace UnitTest1
             Assert::AreEqual("v1", pghs[0]["f1"].c_str());
         }
 
+        TEST_METHOD(parse_paragraph_views_multiline_fields)
+        {
+            auto views = vcpkg::Paragraphs::parse_paragraph_views("f1: simple\n"
+                                                                  "f2: first\r\n"
+                                                                  " second\r\n"
+                                                                  "\n"
+                                                                  "f3: v3\n");
+            const auto moved = std::move(views);
+            Assert::AreEqual(size_t(2), moved.paragraphs.size());
+            Assert::AreEqual(size_t(2), moved.paragraphs[0].fields.size());
+            Assert::AreEqual("simple", std::string(*moved.paragraphs[0].find("f1")).c_str());
+            Assert::AreEqual("first\n second", std::string(*moved.paragraphs[0].find("f2")).c_str());
+            Assert::AreEqual("v3", std::string(*moved.paragraphs[1].find("f3")).c_str());
+            Assert::AreEqual(size_t(1), moved.continuations.size());
+        }
+
         TEST_METHOD(BinaryParagraph_serialize_min)
         {
             vcpkg::BinaryParagraph pgh({
@@ -435,5 +451,24 @@ namespace UnitTest1
             Assert::AreEqual(size_t(1), pghs.size());
             Assert::AreEqual("123abc", pghs[0]["Abi"].c_str());
         }
+
+        TEST_METHOD(BinaryParagraph_serialize_output_abi)
+        {
+            vcpkg::BinaryParagraph pgh({
+                {"Package", "zlib"},
+                {"Version", "1.2.8"},
+                {"Architecture", "x86-windows"},
+                {"Multi-Arch", "same"},
+                {"Abi", "123abc"},
+                {"Output-Abi", "456def"},
+            });
+            Assert::IsTrue(pgh.output_abi == "456def");
+
+            std::string ss = Strings::serialize(pgh);
+            auto pghs = vcpkg::Paragraphs::parse_paragraphs(ss).value_or_exit(VCPKG_LINE_INFO);
+            Assert::AreEqual(size_t(1), pghs.size());
+            Assert::AreEqual("123abc", pghs[0]["Abi"].c_str());
+            Assert::AreEqual("456def", pghs[0]["Output-Abi"].c_str());
+        }
     };
 }
@@ -1158,7 +1158,7 @@ namespace UnitTest1
 
             Assert::AreEqual("a", plan[1].spec().name().c_str());
             Assert::IsTrue(plan[1].install_action.has_value());
-            Assert::IsTrue(plan[1].install_action.get()->feature_list == std::set<std::string>{"core", "a1", "a2"});
+            Assert::IsTrue(plan[1].install_action.get()->feature_list == FeatureList{"core", "a1", "a2"});
         }
     };
 
@@ -0,0 +1,116 @@
+#include "tests.pch.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Strings = vcpkg::Strings;
+
+namespace UnitTest1
+{
+    class StringsTests : public TestClass<StringsTests>
+    {
+        TEST_METHOD(ascii_set_contains)
+        {
+            static constexpr Strings::AsciiSet SET = "ab-";
+
+            Assert::IsTrue(SET.contains('a'));
+            Assert::IsTrue(SET.contains('-'));
+            Assert::IsFalse(SET.contains('A'));
+            Assert::IsFalse(SET.contains('\0'));
+            Assert::IsFalse(SET.contains('\xE9'));
+        }
+
+        TEST_METHOD(ascii_set_contains_any_of)
+        {
+            static constexpr Strings::AsciiSet SET = R"(\/:*?"<>|)";
+
+            Assert::IsTrue(SET.contains_any_of("a:b"));
+            Assert::IsTrue(SET.contains_any_of("|"));
+            Assert::IsFalse(SET.contains_any_of("abc.def"));
+            Assert::IsFalse(SET.contains_any_of(""));
+        }
+
+        TEST_METHOD(ascii_set_contains_only)
+        {
+            static constexpr Strings::AsciiSet SET = "0123456789abcdef";
+
+            Assert::IsTrue(SET.contains_only("deadbeef01"));
+            Assert::IsTrue(SET.contains_only(""));
+            Assert::IsFalse(SET.contains_only("DEADBEEF"));
+            Assert::IsFalse(SET.contains_only("12 34"));
+        }
+
+        TEST_METHOD(case_insensitive_ascii_equals)
+        {
+            Assert::IsTrue(Strings::case_insensitive_ascii_equals("", ""));
+            Assert::IsTrue(Strings::case_insensitive_ascii_equals("Zlib", "zLIB"));
+            Assert::IsTrue(Strings::case_insensitive_ascii_equals("A-Longer-Name-Than-16", "a-longer-name-than-16"));
+            Assert::IsFalse(Strings::case_insensitive_ascii_equals("zlib", "zlib2"));
+            // Only letters fold: '@' and '`', '[' and '{' differ by the same bit as 'A' and 'a'
+            Assert::IsFalse(Strings::case_insensitive_ascii_equals("@[", "`{"));
+            Assert::IsFalse(Strings::case_insensitive_ascii_equals("\xC9", "\xE9"));
+        }
+
+        TEST_METHOD(case_insensitive_ascii_find)
+        {
+            // Every position, so that the match falls on either side of each 16 byte block
+            for (size_t pos = 0; pos < 40; ++pos)
+            {
+                std::string s(48, '.');
+                s.replace(pos, 5, "BoOsT");
+                const auto found = Strings::case_insensitive_ascii_find(s, "boost");
+                Assert::AreEqual(pos, static_cast<size_t>(found - s.begin()));
+                Assert::IsTrue(Strings::case_insensitive_ascii_contains(s, "BOOST"));
+                Assert::IsFalse(Strings::case_insensitive_ascii_contains(s, "boosts"));
+            }
+
+            const std::string s = "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbba";
+            Assert::IsTrue(Strings::case_insensitive_ascii_find(s, "BA") == s.end() - 2);
+            Assert::IsTrue(Strings::case_insensitive_ascii_find(s, "") == s.begin());
+            Assert::IsFalse(Strings::case_insensitive_ascii_contains("ab", "abc"));
+            Assert::IsFalse(Strings::case_insensitive_ascii_contains(std::string(100, '@'), "`"));
+        }
+
+        TEST_METHOD(split_view_matches_split)
+        {
+            for (const std::string s : {"", "a", "a,b", "a,,b", ",a", "a,", ",", "ab,,"})
+            {
+                const auto copies = Strings::split(s, ",");
+                const auto views = Strings::split_view(s, ",").to_vector();
+                Assert::AreEqual(copies.size(), views.size());
+                for (size_t i = 0; i < copies.size(); ++i)
+                {
+                    Assert::AreEqual(copies[i], std::string(views[i]));
+                }
+            }
+
+            const auto pieces = Strings::split_view("1 <> 22 <> 333", " <> ").to_vector();
+            Assert::AreEqual(size_t(3), pieces.size());
+            Assert::AreEqual(std::string("22"), std::string(pieces[1]));
+        }
+
+        TEST_METHOD(append_to_many_times)
+        {
+            // Each append must cost as much as the text it adds: filling the whole spare capacity every time made
+            // this loop take seconds instead of milliseconds
+            const auto start = std::chrono::steady_clock::now();
+            std::string output;
+            for (int i = 0; i < 400000; ++i)
+            {
+                Strings::append_to(output, "%d;", i % 10);
+            }
+            Assert::IsTrue(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+            Assert::AreEqual(size_t(800000), output.size());
+            Assert::AreEqual(std::string("0;1;2;"), output.substr(0, 6));
+            Assert::AreEqual(std::string("8;9;"), output.substr(output.size() - 4));
+
+            // Text longer than what is formatted on the stack
+            const std::string long_text(1000, 'x');
+            for (int i = 0; i < 3; ++i)
+            {
+                Strings::append_to(output, "%s%d", long_text, i);
+            }
+            Assert::AreEqual(size_t(800000 + 3 * 1001), output.size());
+            Assert::AreEqual(long_text + "2", output.substr(output.size() - 1001));
+        }
+    };
+}
@@ -0,0 +1,90 @@
+#include "tests.pch.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace ThreadPool = vcpkg::ThreadPool;
+
+namespace UnitTest1
+{
+    class ThreadPoolTests : public TestClass<ThreadPoolTests>
+    {
+        TEST_METHOD(parallel_for_calls_every_index_once)
+        {
+            std::vector<std::atomic<int>> calls(1000);
+            ThreadPool::parallel_for(calls.size(), [&](size_t i) { ++calls[i]; });
+
+            for (auto&& count : calls)
+            {
+                Assert::AreEqual(1, count.load());
+            }
+        }
+
+        TEST_METHOD(parallel_for_nests_without_waiting_on_itself)
+        {
+            // More outer indices than threads, each blocking on inner work that also needs the pool
+            std::atomic<int> total(0);
+            ThreadPool::parallel_for(64, [&](size_t) {
+                ThreadPool::parallel_for(64, [&](size_t) { ++total; });
+            });
+
+            Assert::AreEqual(64 * 64, total.load());
+        }
+
+        TEST_METHOD(parallel_for_rethrows_the_first_exception)
+        {
+            std::atomic<int> calls(0);
+            bool thrown = false;
+            try
+            {
+                ThreadPool::parallel_for(1000, [&](size_t i) {
+                    ++calls;
+                    if (i == 10) throw std::runtime_error("failed");
+                });
+            }
+            catch (const std::runtime_error&)
+            {
+                thrown = true;
+            }
+
+            Assert::IsTrue(thrown);
+            Assert::IsTrue(calls.load() <= 1000);
+        }
+
+        TEST_METHOD(parallel_for_respects_max_parallelism)
+        {
+            std::atomic<int> running(0);
+            std::atomic<int> most(0);
+            ThreadPool::parallel_for(100, 2, [&](size_t) {
+                const int now = ++running;
+                int seen = most.load();
+                while (now > seen && !most.compare_exchange_weak(seen, now))
+                {
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                --running;
+            });
+
+            Assert::IsTrue(most.load() <= 2);
+        }
+
+        TEST_METHOD(parallel_transform_keeps_order)
+        {
+            std::vector<int> inputs;
+            for (int i = 0; i < 500; ++i)
+            {
+                inputs.push_back(i);
+            }
+
+            const auto outputs = ThreadPool::parallel_transform(inputs, [](int i) { return std::to_string(i * 2); });
+
+            Assert::AreEqual(inputs.size(), outputs.size());
+            for (int i = 0; i < 500; ++i)
+            {
+                Assert::AreEqual(std::to_string(i * 2), outputs[i]);
+            }
+        }
+    };
+}
@@ -0,0 +1,297 @@
+#include "tests.pch.h"
+
+#include <vcpkg/base/files.h>
+#include <vcpkg/tripletenvironment.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace vcpkg;
+
+namespace UnitTest1
+{
+    class TripletEnvironmentTests : public TestClass<TripletEnvironmentTests>
+    {
+        /// <summary>Evaluates `triplet` with a script that includes it and then runs `messages`</summary>
+        static Optional<std::vector<std::string>> evaluate(const std::string& triplet, const std::string& messages)
+        {
+            return TripletEnvironment::try_evaluate(fs::u8path("/vcpkg/scripts/get_triplet_environment.cmake"),
+                                                    "include(${CMAKE_TRIPLET_FILE})\n" + messages,
+                                                    fs::u8path("/vcpkg/triplets/test.cmake"),
+                                                    triplet);
+        }
+
+        /// <summary>The printed lines joined by newlines, or "<cmake>" when the evaluation is left to CMake</summary>
+        static std::string output_of(const std::string& triplet, const std::string& messages)
+        {
+            const auto maybe_lines = evaluate(triplet, messages);
+            if (const auto p_lines = maybe_lines.get()) return Strings::join("\n", *p_lines);
+            return "<cmake>";
+        }
+
+        TEST_METHOD(if_elseif_else_nest)
+        {
+            const std::string triplet = R"(
+set(VCPKG_A x)
+if(PORT STREQUAL "zlib")
+    set(VCPKG_R port)
+elseif(VCPKG_A STREQUAL x)
+    if(NOT VCPKG_UNSET)
+        set(VCPKG_R nested)
+    else()
+        set(VCPKG_R inner-else)
+    endif()
+else()
+    set(VCPKG_R else)
+endif()
+if(VCPKG_UNSET)
+    set(VCPKG_S if)
+elseif(PORT)
+    set(VCPKG_S elseif)
+else()
+    set(VCPKG_S else)
+endif()
+)";
+            Assert::AreEqual(std::string("nested else"), output_of(triplet, R"(message("${VCPKG_R} ${VCPKG_S}"))"));
+        }
+
+        TEST_METHOD(if_skips_the_branches_not_taken)
+        {
+            // Commands in a branch not taken are not evaluated, so they may use what is not supported here
+            const std::string triplet = R"(
+if(1)
+    set(VCPKG_R on)
+elseif(WIN32)
+    list(APPEND VCPKG_R win32)
+else()
+    set(VCPKG_R $ENV{PATH})
+endif()
+)";
+            Assert::AreEqual(std::string("on"), output_of(triplet, R"(message("${VCPKG_R}"))"));
+        }
+
+        TEST_METHOD(if_not_negates)
+        {
+            Assert::AreEqual(std::string("yes"),
+                             output_of("if(NOT 0)\nset(VCPKG_R yes)\nendif()", "message(${VCPKG_R})"));
+            Assert::AreEqual(std::string(""),
+                             output_of("if(NOT 1)\nset(VCPKG_R yes)\nendif()", "message(\"${VCPKG_R}\")"));
+            Assert::AreEqual(std::string("yes"),
+                             output_of("if(NOT PORT STREQUAL zlib)\nset(VCPKG_R yes)\nendif()", "message(${VCPKG_R})"));
+        }
+
+        TEST_METHOD(if_takes_words_as_variable_names)
+        {
+            // Without policy CMP0012, only 0 and 1 are constants; the values of variables are false only when CMake
+            // takes them as off
+            const std::string triplet = R"(
+set(VCPKG_A 0.0)
+set(VCPKG_B off)
+set(VCPKG_C 2)
+set(VCPKG_D x-NOTFOUND)
+if(VCPKG_A)
+    set(VCPKG_R a)
+endif()
+if(VCPKG_B)
+    set(VCPKG_S b)
+endif()
+if(VCPKG_C)
+    set(VCPKG_T c)
+endif()
+if(VCPKG_D)
+    set(VCPKG_U d)
+endif()
+if(VCPKG_TRUE)
+    set(VCPKG_V true)
+endif()
+)";
+            const std::string messages = R"(message("${VCPKG_R} ${VCPKG_S} ${VCPKG_T} ${VCPKG_U} ${VCPKG_V}"))";
+            Assert::AreEqual(std::string("a  c  "), output_of(triplet, messages));
+        }
+
+        TEST_METHOD(if_streq)
+        {
+            const std::string triplet = R"(
+set(VCPKG_TARGET_ARCHITECTURE arm64)
+if(VCPKG_TARGET_ARCHITECTURE STREQUAL arm64)
+    set(VCPKG_R variable)
+endif()
+if("arm64" STREQUAL VCPKG_TARGET_ARCHITECTURE)
+    set(VCPKG_S quoted)
+endif()
+if(VCPKG_TARGET_ARCHITECTURE STREQUAL "x64")
+    set(VCPKG_T wrong)
+endif()
+)";
+            Assert::AreEqual(std::string("variable quoted "),
+                             output_of(triplet, R"(message("${VCPKG_R} ${VCPKG_S} ${VCPKG_T}"))"));
+        }
+
+        TEST_METHOD(if_matches)
+        {
+            const std::string triplet = R"(
+set(VCPKG_TARGET_ARCHITECTURE arm64)
+if(VCPKG_TARGET_ARCHITECTURE MATCHES "^arm[0-9]*$")
+    set(VCPKG_R arm)
+endif()
+if(VCPKG_TARGET_ARCHITECTURE MATCHES "^x")
+    set(VCPKG_S x)
+endif()
+)";
+            Assert::AreEqual(std::string("arm "), output_of(triplet, R"(message("${VCPKG_R} ${VCPKG_S}"))"));
+        }
+
+        TEST_METHOD(quoted_and_unquoted_expansion)
+        {
+            const std::string triplet = R"(
+set(VCPKG_A "a b")
+set(VCPKG_B ${VCPKG_A})
+set(VCPKG_C "say \"${VCPKG_B}\"\tnow")
+)";
+            Assert::AreEqual(std::string("say \"a b\"\tnow"), output_of(triplet, R"(message("${VCPKG_C}"))"));
+        }
+
+        TEST_METHOD(empty_unquoted_arguments_are_dropped)
+        {
+            const std::string triplet = R"(
+set(VCPKG_UNQUOTED x ${VCPKG_EMPTY} y)
+set(VCPKG_QUOTED x "${VCPKG_EMPTY}" y)
+)";
+            Assert::AreEqual(std::string("x;y x;;y"),
+                             output_of(triplet, R"(message("${VCPKG_UNQUOTED} ${VCPKG_QUOTED}"))"));
+            // Nothing but dropped arguments prints nothing
+            Assert::AreEqual(std::string(""), output_of("", "message(${VCPKG_EMPTY})"));
+        }
+
+        TEST_METHOD(set_several_values)
+        {
+            Assert::AreEqual(std::string("a;b;c"), output_of("set(VCPKG_L a b \"c\")", R"(message("${VCPKG_L}"))"));
+        }
+
+        TEST_METHOD(set_without_value_unsets)
+        {
+            const std::string triplet = R"(
+set(VCPKG_X 1)
+set(VCPKG_X)
+if(VCPKG_X)
+    set(VCPKG_R set)
+else()
+    set(VCPKG_R unset)
+endif()
+)";
+            Assert::AreEqual(std::string("x= unset"), output_of(triplet, R"(message("x=${VCPKG_X} ${VCPKG_R}"))"));
+        }
+
+        TEST_METHOD(message_lines)
+        {
+            Assert::AreEqual(std::string("a\nb\nc"), output_of("", R"(message("a\nb" "\nc"))"));
+        }
+
+        TEST_METHOD(unsupported_constructs_fall_back_to_cmake)
+        {
+            const char* const TRIPLETS[] = {
+                // Other commands
+                "list(APPEND VCPKG_L a)",
+                "include(other.cmake)",
+                // Environment variables
+                "set(VCPKG_A $ENV{PATH})",
+                // Bracket arguments and comments
+                "set(VCPKG_A [[x]])",
+                "#[[ comment ]]",
+                // AND and OR
+                "if(VCPKG_A AND VCPKG_B)\nendif()",
+                "if(VCPKG_A OR VCPKG_B)\nendif()",
+                // List splitting of unquoted arguments
+                "set(VCPKG_L a b)\nset(VCPKG_M ${VCPKG_L})",
+                "set(VCPKG_A a\\;b)",
+                // Variables CMake itself may define
+                "if(WIN32)\nendif()",
+                "set(VCPKG_A ${CMAKE_SYSTEM_NAME})",
+                "if(CMAKE_SYSTEM_NAME STREQUAL Linux)\nendif()",
+                // Named constants, which CMake takes as the names of variables it may define here
+                "if(ON)\nendif()",
+                "if(NOT TRUE)\nendif()",
+                // Quoted variable names, which depend on policy CMP0054
+                "set(VCPKG_A x)\nif(\"VCPKG_A\" STREQUAL x)\nendif()",
+                "if(\"VCPKG_A\")\nendif()",
+                // Other conditions
+                "if(DEFINED VCPKG_A)\nendif()",
+                "if((VCPKG_A))\nendif()",
+                "if(VCPKG_A MATCHES \"(\")\nendif()",
+                // Other forms of set() and message()
+                "set(VCPKG_A x CACHE STRING \"\")",
+                "set(VCPKG_A x PARENT_SCOPE)",
+                "message(STATUS x)",
+                // Unbalanced conditions and legacy syntax
+                "if(ON)",
+                "endif()",
+                "else()",
+                "set(VCPKG_A x\"y\")",
+                "set(VCPKG_A \"x)",
+            };
+            for (const char* triplet : TRIPLETS)
+            {
+                Assert::IsFalse(evaluate(triplet, "").has_value(), Strings::to_utf16(triplet).c_str());
+            }
+        }
+
+        /// <summary>The lines get_triplet_environment.cmake prints for a triplet setting these variables</summary>
+        static std::string environment_of(const std::string& architecture,
+                                          const std::string& system_name,
+                                          const std::string& system_version)
+        {
+            return Strings::join("\n",
+                                 std::vector<std::string>{
+                                     "c35112b6-d1ba-415b-aa5d-81de856ef8eb",
+                                     "VCPKG_TARGET_ARCHITECTURE=" + architecture,
+                                     "VCPKG_CMAKE_SYSTEM_NAME=" + system_name,
+                                     "VCPKG_CMAKE_SYSTEM_VERSION=" + system_version,
+                                     "VCPKG_PLATFORM_TOOLSET=",
+                                     "VCPKG_VISUAL_STUDIO_PATH=",
+                                     "VCPKG_CHAINLOAD_TOOLCHAIN_FILE=",
+                                     "VCPKG_BUILD_TYPE=",
+                                     "VCPKG_UNITY_BUILD=",
+                                 });
+        }
+
+        TEST_METHOD(shipped_triplets)
+        {
+            const std::map<std::string, std::string> expected = {
+                {"arm-uwp", environment_of("arm", "WindowsStore", "10.0")},
+                {"arm-windows", environment_of("arm", "", "")},
+                {"arm64-uwp", environment_of("arm64", "WindowsStore", "10.0")},
+                {"arm64-windows", environment_of("arm64", "", "")},
+                {"x64-linux", environment_of("x64", "Linux", "")},
+                {"x64-osx", environment_of("x64", "Darwin", "")},
+                {"x64-uwp", environment_of("x64", "WindowsStore", "10.0")},
+                {"x64-windows-static", environment_of("x64", "", "")},
+                {"x64-windows", environment_of("x64", "", "")},
+                {"x86-uwp", environment_of("x86", "WindowsStore", "10.0")},
+                {"x86-windows-static", environment_of("x86", "", "")},
+                {"x86-windows", environment_of("x86", "", "")},
+            };
+
+            // This file is toolsrc/src/tests.tripletenvironment.cpp
+            auto& fs = Files::get_real_filesystem();
+            const fs::path root = fs::u8path(__FILE__).parent_path().parent_path().parent_path();
+            const fs::path script_file = root / "scripts" / "get_triplet_environment.cmake";
+            const std::string script = fs.read_contents(script_file).value_or_exit(VCPKG_LINE_INFO);
+
+            size_t triplet_count = 0;
+            for (auto&& triplet_file : fs.get_files_non_recursive(root / "triplets"))
+            {
+                if (triplet_file.extension() != ".cmake") continue;
+                ++triplet_count;
+
+                const std::string name = triplet_file.stem().u8string();
+                const auto it = expected.find(name);
+                Assert::IsTrue(it != expected.end(), Strings::to_utf16(name).c_str());
+
+                const auto maybe_lines = TripletEnvironment::try_evaluate(
+                    script_file, script, triplet_file, fs.read_contents(triplet_file).value_or_exit(VCPKG_LINE_INFO));
+                const auto p_lines = maybe_lines.get();
+                Assert::IsTrue(p_lines != nullptr, Strings::to_utf16(name).c_str());
+                Assert::AreEqual(it->second, Strings::join("\n", *p_lines));
+            }
+            Assert::AreEqual(expected.size(), triplet_count);
+        }
+    };
+}
@@ -10,10 +10,17 @@
 #include <unistd.h>
 #endif
 
+#include <vcpkg/base/allocations.h>
 #include <vcpkg/base/chrono.h>
 #include <vcpkg/base/files.h>
+#include <vcpkg/base/openmetrics.h>
+#include <vcpkg/base/processlog.h>
 #include <vcpkg/base/strings.h>
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/threadpool.h>
+#include <vcpkg/base/trace.h>
+#include <vcpkg/base/transfers.h>
+#include <vcpkg/binarycaching.h>
 #include <vcpkg/commands.h>
 #include <vcpkg/globalstate.h>
 #include <vcpkg/help.h>
@@ -46,6 +53,81 @@ void invalid_command(const std::string& cmd)
     Checks::exit_fail(VCPKG_LINE_INFO);
 }
 
+static void apply_feature_flags()
+{
+    const auto vcpkg_feature_flags_env = System::get_environment_variable("VCPKG_FEATURE_FLAGS");
+    if (const auto v = vcpkg_feature_flags_env.get())
+    {
+        auto flags = Strings::split(*v, ",");
+        if (std::find(flags.begin(), flags.end(), "binarycaching") != flags.end()) GlobalState::g_binary_caching = true;
+        if (std::find(flags.begin(), flags.end(), "linkinstall") != flags.end())
+            GlobalState::g_link_installed_files = true;
+        if (std::find(flags.begin(), flags.end(), "releaseonly") != flags.end()) GlobalState::g_release_only = true;
+        if (std::find(flags.begin(), flags.end(), "outputabi") != flags.end()) GlobalState::g_output_abi = true;
+    }
+}
+
+/// <summary>
+/// Undoes what the server's own --debug and environment set, so that a request forked by x-server starts from the
+/// defaults; x-server refuses the other global options.
+/// </summary>
+static void reset_global_options()
+{
+    GlobalState::debugging = false;
+    GlobalState::feature_packages = true;
+    GlobalState::g_binary_caching = false;
+    GlobalState::g_link_installed_files = false;
+    GlobalState::g_release_only = false;
+    GlobalState::g_output_abi = false;
+}
+
+static void apply_global_options(const VcpkgCmdArguments& args)
+{
+    if (const auto p = args.featurepackages.get()) GlobalState::feature_packages = *p;
+    if (const auto p = args.binarycaching.get()) GlobalState::g_binary_caching = *p;
+
+    if (const auto p = args.printmetrics.get()) Metrics::g_metrics.lock()->set_print_metrics(*p);
+    if (const auto p = args.sendmetrics.get()) Metrics::g_metrics.lock()->set_send_metrics(*p);
+    if (const auto p = args.debug.get()) GlobalState::debugging = *p;
+    if (args.trace_file != nullptr) Trace::enable(fs::stdfs::absolute(fs::u8path(*args.trace_file)));
+    if (args.openmetrics_file != nullptr)
+        OpenMetrics::enable(fs::stdfs::absolute(fs::u8path(*args.openmetrics_file)));
+    if (args.process_log_file != nullptr)
+        ProcessLog::enable(fs::stdfs::absolute(fs::u8path(*args.process_log_file)));
+    if (const auto p = args.max_threads.get()) ThreadPool::set_max_threads(*p);
+    if (args.fs_stats.value_or(false)) Files::enable_statistics();
+    if (args.alloc_stats.value_or(false)) Allocations::set_enabled(true);
+}
+
+static void load_transfer_limits()
+{
+    Transfers::Limits limits;
+    const auto read_count = [](const char* name, size_t& count) {
+        const auto value = System::get_environment_variable(name);
+        const auto p_value = value.get();
+        if (!p_value) return;
+        const auto is_digit = [](char ch) { return ch >= '0' && ch <= '9'; };
+        const bool is_number = !p_value->empty() && p_value->size() <= 9 &&
+                               std::all_of(p_value->begin(), p_value->end(), is_digit);
+        Checks::check_exit(VCPKG_LINE_INFO, is_number, "Error: %s must be a number, not '%s'", name, *p_value);
+        count = std::stoul(*p_value);
+    };
+    const auto read_rate = [](const char* name, uint64_t& rate) {
+        const auto value = System::get_environment_variable(name);
+        const auto p_value = value.get();
+        if (!p_value) return;
+        const auto maybe_rate = parse_cache_size(*p_value);
+        const auto p_rate = maybe_rate.get();
+        Checks::check_exit(VCPKG_LINE_INFO, p_rate != nullptr, "Error: %s: %s", name, maybe_rate.error());
+        rate = *p_rate;
+    };
+    read_count("VCPKG_MAX_TRANSFERS", limits.max_transfers);
+    read_count("VCPKG_MAX_TRANSFERS_PER_HOST", limits.max_transfers_per_host);
+    read_rate("VCPKG_MAX_TRANSFER_RATE", limits.max_rate);
+    read_rate("VCPKG_MAX_TRANSFER_RATE_PER_HOST", limits.max_rate_per_host);
+    Transfers::set_limits(limits);
+}
+
 static void inner(const VcpkgCmdArguments& args)
 {
     Metrics::g_metrics.lock()->track_property("command", args.command);
@@ -55,7 +137,7 @@ static void inner(const VcpkgCmdArguments& args)
         Checks::exit_fail(VCPKG_LINE_INFO);
     }
 
-    static const auto find_command = [&](auto&& commands) {
+    const auto find_command = [&](auto&& commands) {
         auto it = Util::find_if(commands, [&](auto&& commandc) {
             return Strings::case_insensitive_ascii_equals(commandc.name, args.command);
         });
@@ -102,15 +184,23 @@ static void inner(const VcpkgCmdArguments& args)
 
     Debug::println("Using vcpkg-root: %s", vcpkg_root_dir.u8string());
 
-    auto default_vs_path = System::get_environment_variable("VCPKG_DEFAULT_VS_PATH").value_or("");
-
-    const Expected<VcpkgPaths> expected_paths = VcpkgPaths::create(vcpkg_root_dir, default_vs_path);
-    Checks::check_exit(VCPKG_LINE_INFO,
-                       !expected_paths.error(),
-                       "Error: Invalid vcpkg root directory %s: %s",
-                       vcpkg_root_dir.string(),
-                       expected_paths.error().message());
-    const VcpkgPaths& paths = expected_paths.value_or_exit(VCPKG_LINE_INFO);
+    // In a request forked by x-server, the server's paths have the triplets and tools resolved already
+    std::unique_ptr<VcpkgPaths> created_paths;
+    const VcpkgPaths* p_paths = Commands::X_Server::find_warm_paths(vcpkg_root_dir);
+    if (!p_paths)
+    {
+        auto default_vs_path = System::get_environment_variable("VCPKG_DEFAULT_VS_PATH").value_or("");
+
+        Expected<VcpkgPaths> expected_paths = VcpkgPaths::create(vcpkg_root_dir, default_vs_path);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           !expected_paths.error(),
+                           "Error: Invalid vcpkg root directory %s: %s",
+                           vcpkg_root_dir.string(),
+                           expected_paths.error().message());
+        created_paths = std::make_unique<VcpkgPaths>(std::move(expected_paths).value_or_exit(VCPKG_LINE_INFO));
+        p_paths = created_paths.get();
+    }
+    const VcpkgPaths& paths = *p_paths;
 
 #if defined(_WIN32)
     const int exit_code = _wchdir(paths.root.c_str());
@@ -119,6 +209,18 @@ static void inner(const VcpkgCmdArguments& args)
 #endif
     Checks::check_exit(VCPKG_LINE_INFO, exit_code == 0, "Changing the working dir failed");
 
+    if (args.command == "x-server")
+    {
+        // Returns only in the process forked for a request, which then runs like any other invocation
+        const VcpkgCmdArguments request_args = Commands::X_Server::serve(args, paths);
+        *GlobalState::timer.lock() = Chrono::ElapsedTimer::create_started();
+        reset_global_options();
+        apply_feature_flags();
+        apply_global_options(request_args);
+        load_transfer_limits();
+        return inner(request_args);
+    }
+
     if (args.command == "install" || args.command == "remove" || args.command == "export" || args.command == "update")
     {
         Commands::Version::warn_if_vcpkg_version_mismatch(paths);
@@ -204,19 +306,24 @@ static void load_config()
         write_config = true;
     }
 
-#if defined(_WIN32)
-    if (config.user_mac.empty())
-    {
-        config.user_mac = Metrics::get_MAC_user();
-        write_config = true;
-    }
-#endif
-
     {
         auto locked_metrics = Metrics::g_metrics.lock();
         locked_metrics->set_user_information(config.user_id, config.user_time);
 #if defined(_WIN32)
-        locked_metrics->track_property("user_mac", config.user_mac);
+        // getmac takes long enough to be noticed, so it runs alongside the command
+        if (config.user_mac.empty())
+        {
+            locked_metrics->start_user_mac_lookup([](const std::string& user_mac) {
+                auto& fs = Files::get_real_filesystem();
+                auto stored_config = UserConfig::try_read_data(fs);
+                stored_config.user_mac = user_mac;
+                stored_config.try_write_data(fs);
+            });
+        }
+        else
+        {
+            locked_metrics->track_property("user_mac", config.user_mac);
+        }
 #endif
     }
 
@@ -289,23 +396,28 @@ int main(const int argc, const char* const* const argv)
 
     Checks::register_console_ctrl_handler();
 
-    load_config();
+    const VcpkgCmdArguments args = VcpkgCmdArguments::create_from_command_line(argc, argv);
 
-    const auto vcpkg_feature_flags_env = System::get_environment_variable("VCPKG_FEATURE_FLAGS");
-    if (const auto v = vcpkg_feature_flags_env.get())
+#if !defined(_WIN32)
+    if (args.command != "x-server")
     {
-        auto flags = Strings::split(*v, ",");
-        if (std::find(flags.begin(), flags.end(), "binarycaching") != flags.end()) GlobalState::g_binary_caching = true;
+        const auto server_socket = System::get_environment_variable("VCPKG_SERVER");
+        if (const auto p_socket = server_socket.get())
+        {
+            const auto maybe_exit_code =
+                Commands::X_Server::forward(*p_socket, args.command, std::vector<std::string>(argv + 1, argv + argc));
+            if (const auto p_exit_code = maybe_exit_code.get()) return *p_exit_code;
+        }
     }
+#endif
 
-    const VcpkgCmdArguments args = VcpkgCmdArguments::create_from_command_line(argc, argv);
-
-    if (const auto p = args.featurepackages.get()) GlobalState::feature_packages = *p;
-    if (const auto p = args.binarycaching.get()) GlobalState::g_binary_caching = *p;
+    // The user config only serves metrics and the survey prompt, which completions and applocal deployment never send
+    // or show, and they run on every keypress and every link
+    if (args.command != "autocomplete" && args.command != "x-applocal") load_config();
 
-    if (const auto p = args.printmetrics.get()) Metrics::g_metrics.lock()->set_print_metrics(*p);
-    if (const auto p = args.sendmetrics.get()) Metrics::g_metrics.lock()->set_send_metrics(*p);
-    if (const auto p = args.debug.get()) GlobalState::debugging = *p;
+    apply_feature_flags();
+    apply_global_options(args);
+    load_transfer_limits();
 
     if (GlobalState::debugging)
     {
@@ -1,25 +1,19 @@
 #include "pch.h"
 
+#include <vcpkg/base/system.h>
+#include <vcpkg/base/zip.h>
+
 #include <vcpkg/archives.h>
 #include <vcpkg/commands.h>
 
 namespace vcpkg::Archives
 {
-    void extract_archive(const VcpkgPaths& paths, const fs::path& archive, const fs::path& to_path)
-    {
-        Files::Filesystem& fs = paths.get_filesystem();
-        const fs::path to_path_partial = to_path.u8string() + ".partial"
 #if defined(_WIN32)
-                                         + "." + std::to_string(GetCurrentProcessId())
-#endif
-            ;
-
-        std::error_code ec;
-        fs.remove_all(to_path, ec);
-        fs.remove_all(to_path_partial, ec);
-        fs.create_directories(to_path_partial, ec);
+    static void extract_archive_with_tool(const VcpkgPaths& paths,
+                                          const fs::path& archive,
+                                          const fs::path& to_path_partial)
+    {
         const auto ext = archive.extension();
-#if defined(_WIN32)
         if (ext == ".nupkg")
         {
             static bool recursion_limiter_sevenzip_old = false;
@@ -70,7 +64,11 @@ namespace vcpkg::Archives
                                code_and_output.output);
             recursion_limiter_sevenzip = false;
         }
+    }
 #else
+    static void extract_archive_with_tool(const fs::path& archive, const fs::path& to_path_partial)
+    {
+        const auto ext = archive.extension();
         if (ext == ".gz" && ext.extension() != ".tar")
         {
             const auto code = System::cmd_execute(
@@ -87,6 +85,41 @@ namespace vcpkg::Archives
         {
             Checks::exit_with_message(VCPKG_LINE_INFO, "Unexpected archive extension: %s", ext.u8string());
         }
+    }
+#endif
+
+    void extract_archive(const VcpkgPaths& paths, const fs::path& archive, const fs::path& to_path)
+    {
+        Files::Filesystem& fs = paths.get_filesystem();
+        const fs::path to_path_partial = to_path.u8string() + ".partial"
+#if defined(_WIN32)
+                                         + "." + std::to_string(GetCurrentProcessId())
+#endif
+            ;
+
+        std::error_code ec;
+        fs.remove_all(to_path, ec);
+        fs.remove_all(to_path_partial, ec);
+        fs.create_directories(to_path_partial, ec);
+        const auto ext = archive.extension();
+
+        // Most tool downloads are plain deflate zips, which are extracted without spawning a process
+        bool extracted = false;
+        if (ext == ".zip")
+        {
+            const auto maybe_extracted = Zip::extract(archive, to_path_partial);
+            extracted = maybe_extracted.has_value();
+            if (!extracted)
+            {
+                Debug::println("%s; extracting with an external tool", maybe_extracted.error());
+                fs.remove_all(to_path_partial, ec);
+                fs.create_directories(to_path_partial, ec);
+            }
+        }
+#if defined(_WIN32)
+        if (!extracted) extract_archive_with_tool(paths, archive, to_path_partial);
+#else
+        if (!extracted) extract_archive_with_tool(archive, to_path_partial);
 #endif
 
         fs.rename(to_path_partial, to_path, ec);
@@ -0,0 +1,141 @@
+#include "pch.h"
+
+#include <vcpkg/base/allocations.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/base/trace.h>
+
+#include <cstdlib>
+#include <new>
+
+namespace vcpkg::Allocations
+{
+    namespace
+    {
+        /// <summary>
+        /// The counts of one category. operator new cannot allocate, so the categories live in a fixed table that
+        /// is filled without a lock; each is a string literal, told apart by its address.
+        /// </summary>
+        struct Site
+        {
+            std::atomic<const char*> category{nullptr};
+            std::atomic<uint64_t> count{0};
+            std::atomic<uint64_t> bytes{0};
+        };
+    }
+
+    static std::atomic<bool> g_enabled{false};
+    static Site g_sites[64];
+    /// <summary>Counts allocations made in a category that no longer fits in g_sites</summary>
+    static Site g_overflow;
+
+    void set_enabled(bool enabled) { g_enabled.store(enabled, std::memory_order_relaxed); }
+
+    bool is_enabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+    static void count(const size_t size) noexcept
+    {
+        const char* const category = Trace::current_category();
+        Site* found = &g_overflow;
+        for (Site& site : g_sites)
+        {
+            const char* current = site.category.load(std::memory_order_acquire);
+            if (current == nullptr && site.category.compare_exchange_strong(current, category)) current = category;
+            if (current == category)
+            {
+                found = &site;
+                break;
+            }
+        }
+        found->count.fetch_add(1, std::memory_order_relaxed);
+        found->bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    /// <summary>The counts of each category, merged by name, since literals in different files may differ</summary>
+    static std::map<std::string, Totals> get_totals_by_category()
+    {
+        std::map<std::string, Totals> ret;
+        for (const Site& site : g_sites)
+        {
+            const char* const category = site.category.load(std::memory_order_acquire);
+            if (category == nullptr) break;
+            Totals& totals = ret[category];
+            totals.count += site.count.load(std::memory_order_relaxed);
+            totals.bytes += site.bytes.load(std::memory_order_relaxed);
+        }
+        if (const uint64_t count = g_overflow.count.load(std::memory_order_relaxed))
+        {
+            Totals& totals = ret["(other categories)"];
+            totals.count += count;
+            totals.bytes += g_overflow.bytes.load(std::memory_order_relaxed);
+        }
+        return ret;
+    }
+
+    Totals get_totals()
+    {
+        Totals ret;
+        for (auto&& entry : get_totals_by_category())
+        {
+            ret.count += entry.second.count;
+            ret.bytes += entry.second.bytes;
+        }
+        return ret;
+    }
+
+    void report()
+    {
+        if (!is_enabled()) return;
+        // The report allocates too
+        set_enabled(false);
+
+        const auto by_category = get_totals_by_category();
+        const Totals totals = get_totals();
+        const uint64_t peak_memory_kib = System::get_peak_memory_kib();
+        System::println("Memory: %s KiB peak resident, %s allocations of %.1f MiB in total",
+                        std::to_string(peak_memory_kib),
+                        std::to_string(totals.count),
+                        totals.bytes / 1048576.0);
+        Trace::add_summary("alloc",
+                           "memory",
+                           Strings::format(R"({"peak_rss_kib":%llu,"allocations":%llu,"bytes":%llu})",
+                                           static_cast<unsigned long long>(peak_memory_kib),
+                                           static_cast<unsigned long long>(totals.count),
+                                           static_cast<unsigned long long>(totals.bytes)));
+
+        System::println("Allocations by trace scope:\n    %-48s %12s %12s", "category", "allocations", "MiB");
+        for (auto&& entry : by_category)
+        {
+            System::println("    %-48s %12s %12.1f",
+                            entry.first,
+                            std::to_string(entry.second.count),
+                            entry.second.bytes / 1048576.0);
+            Trace::add_summary("alloc",
+                               "alloc " + entry.first,
+                               Strings::format(R"({"allocations":%llu,"bytes":%llu})",
+                                               static_cast<unsigned long long>(entry.second.count),
+                                               static_cast<unsigned long long>(entry.second.bytes)));
+        }
+    }
+}
+
+// The array and nothrow forms forward to these; the sized deletes are replaced as well, so that no implementation
+// frees memory from this malloc through its own deallocation
+void* operator new(std::size_t size)
+{
+    if (vcpkg::Allocations::is_enabled()) vcpkg::Allocations::count(size);
+    if (size == 0) size = 1;
+    while (true)
+    {
+        if (void* const p = std::malloc(size)) return p;
+        const std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+
+void operator delete[](void* p, std::size_t) noexcept { operator delete(p); }
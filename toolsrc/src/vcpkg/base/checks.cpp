@@ -3,21 +3,54 @@
 #include <vcpkg/globalstate.h>
 #include <vcpkg/metrics.h>
 
+#include <vcpkg/base/allocations.h>
 #include <vcpkg/base/checks.h>
+#include <vcpkg/base/files.h>
+#include <vcpkg/base/openmetrics.h>
+#include <vcpkg/base/processlog.h>
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/trace.h>
 
 namespace vcpkg::Checks
 {
+    static std::mutex g_exit_hooks_mutex;
+    static std::vector<std::function<void()>> g_exit_hooks;
+
+    void register_exit_hook(std::function<void()> hook)
+    {
+        std::lock_guard<std::mutex> lock(g_exit_hooks_mutex);
+        g_exit_hooks.push_back(std::move(hook));
+    }
+
     [[noreturn]] static void cleanup_and_exit(const int exit_code)
     {
         static std::atomic<bool> have_entered{false};
         if (have_entered) std::terminate();
         have_entered = true;
 
+        std::vector<std::function<void()>> exit_hooks;
+        {
+            std::lock_guard<std::mutex> lock(g_exit_hooks_mutex);
+            exit_hooks = g_exit_hooks;
+        }
+        for (auto&& hook : exit_hooks)
+        {
+            hook();
+        }
+
+        // Deleted buildtrees and packages must not outlive the process, or CI machines fill up
+        Files::wait_for_background_removals();
+
         const auto elapsed_us_inner = GlobalState::timer.lock()->microseconds();
 
         bool debugging = GlobalState::debugging;
 
+        Files::report_statistics();
+        Allocations::report();
+        Trace::write();
+        OpenMetrics::write();
+        ProcessLog::write();
+
         auto metrics = Metrics::g_metrics.lock();
         metrics->track_metric("elapsed_us", elapsed_us_inner);
         GlobalState::debugging = false;
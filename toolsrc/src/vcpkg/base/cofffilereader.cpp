@@ -4,309 +4,394 @@
 #include <vcpkg/base/cofffilereader.h>
 #include <vcpkg/base/stringliteral.h>
 
-using namespace std;
-
 namespace vcpkg::CoffFileReader
 {
-#if defined(_WIN32)
     template<class T>
     static T reinterpret_bytes(const char* data)
     {
         return (*reinterpret_cast<const T*>(&data[0]));
     }
 
-    template<class T>
-    static T read_value_from_stream(fstream& fs)
-    {
-        T data;
-        fs.read(reinterpret_cast<char*>(&data), sizeof data);
-        return data;
-    }
-
-    template<class T>
-    static T peek_value_from_stream(fstream& fs)
-    {
-        const std::streampos original_pos = fs.tellg();
-        T data;
-        fs.read(reinterpret_cast<char*>(&data), sizeof data);
-        fs.seekg(original_pos);
-        return data;
-    }
-
-    static void verify_equal_strings(
-        const LineInfo& line_info, const char* expected, const char* actual, int size, const char* label)
-    {
-        Checks::check_exit(line_info,
-                           memcmp(expected, actual, size) == 0,
-                           "Incorrect string (%s) found. Expected: (%s) but found (%s)",
-                           label,
-                           expected,
-                           actual);
-    }
-
-    static void read_and_verify_pe_signature(fstream& fs)
-    {
-        static constexpr size_t OFFSET_TO_PE_SIGNATURE_OFFSET = 0x3c;
-
-        static constexpr StringLiteral PE_SIGNATURE = "PE\0\0";
-        static constexpr size_t PE_SIGNATURE_SIZE = 4;
-
-        fs.seekg(OFFSET_TO_PE_SIGNATURE_OFFSET, ios_base::beg);
-        const auto offset_to_pe_signature = read_value_from_stream<int32_t>(fs);
-
-        fs.seekg(offset_to_pe_signature);
-        char signature[PE_SIGNATURE_SIZE];
-        fs.read(signature, PE_SIGNATURE_SIZE);
-        verify_equal_strings(VCPKG_LINE_INFO, PE_SIGNATURE.c_str(), signature, PE_SIGNATURE_SIZE, "PE_SIGNATURE");
-        fs.seekg(offset_to_pe_signature + PE_SIGNATURE_SIZE, ios_base::beg);
-    }
-
-    static fpos_t align_to_size(const uint64_t unaligned, const uint64_t alignment_size)
-    {
-        fpos_t aligned = unaligned - 1;
-        aligned /= alignment_size;
-        aligned += 1;
-        aligned *= alignment_size;
-        return aligned;
-    }
-
-    struct CoffFileHeader
+    struct SectionHeader
     {
-        static constexpr size_t HEADER_SIZE = 20;
+        static constexpr size_t HEADER_SIZE = 40;
 
-        static CoffFileHeader read(fstream& fs)
+        static SectionHeader parse(const char* data)
         {
-            CoffFileHeader ret;
-            ret.data.resize(HEADER_SIZE);
-            fs.read(&ret.data[0], HEADER_SIZE);
+            static constexpr size_t NAME_SIZE = 8;
+            static constexpr size_t VIRTUAL_SIZE_OFFSET = 8;
+            static constexpr size_t VIRTUAL_ADDRESS_OFFSET = 12;
+            static constexpr size_t SIZE_OF_RAW_DATA_OFFSET = 16;
+            static constexpr size_t POINTER_TO_RAW_DATA_OFFSET = 20;
+
+            SectionHeader ret;
+            ret.name.assign(data, strnlen(data, NAME_SIZE));
+            ret.virtual_size = reinterpret_bytes<uint32_t>(data + VIRTUAL_SIZE_OFFSET);
+            ret.virtual_address = reinterpret_bytes<uint32_t>(data + VIRTUAL_ADDRESS_OFFSET);
+            ret.size_of_raw_data = reinterpret_bytes<uint32_t>(data + SIZE_OF_RAW_DATA_OFFSET);
+            ret.pointer_to_raw_data = reinterpret_bytes<uint32_t>(data + POINTER_TO_RAW_DATA_OFFSET);
             return ret;
         }
 
-        MachineType machine_type() const
-        {
-            static constexpr size_t MACHINE_TYPE_OFFSET = 0;
-            static constexpr size_t MACHINE_TYPE_SIZE = 2;
-
-            std::string machine_field_as_string = data.substr(MACHINE_TYPE_OFFSET, MACHINE_TYPE_SIZE);
-            const auto machine = reinterpret_bytes<uint16_t>(machine_field_as_string.c_str());
-            return to_machine_type(machine);
-        }
-
-    private:
-        std::string data;
+        std::string name;
+        uint32_t virtual_size;
+        uint32_t virtual_address;
+        uint32_t size_of_raw_data;
+        uint32_t pointer_to_raw_data;
     };
 
-    struct ArchiveMemberHeader
+    /// <summary>
+    /// Maps a relative virtual address of an image to its offset in the file. Returns 0, which is inside the DOS
+    /// header and never the offset of a table, when no section contains the address.
+    /// </summary>
+    static uint64_t rva_to_offset(const std::vector<SectionHeader>& sections, const uint32_t rva)
     {
-        static constexpr size_t HEADER_SIZE = 60;
-
-        static ArchiveMemberHeader read(fstream& fs)
+        if (rva == 0) return 0;
+        for (auto&& section : sections)
         {
-            static constexpr size_t HEADER_END_OFFSET = 58;
-            static constexpr StringLiteral HEADER_END = "`\n";
-            static constexpr size_t HEADER_END_SIZE = 2;
-
-            ArchiveMemberHeader ret;
-            ret.data.resize(HEADER_SIZE);
-            fs.read(&ret.data[0], HEADER_SIZE);
-
-            if (ret.data[0] != '\0') // Due to freeglut. github issue #223
+            const uint32_t size = std::max(section.virtual_size, section.size_of_raw_data);
+            if (rva >= section.virtual_address && rva - section.virtual_address < size)
             {
-                const std::string header_end = ret.data.substr(HEADER_END_OFFSET, HEADER_END_SIZE);
-                verify_equal_strings(
-                    VCPKG_LINE_INFO, HEADER_END.c_str(), header_end.c_str(), HEADER_END_SIZE, "LIB HEADER_END");
+                return static_cast<uint64_t>(rva - section.virtual_address) + section.pointer_to_raw_data;
             }
-
-            return ret;
         }
+        return 0;
+    }
 
-        std::string name() const
+    // Offsets in the COFF file header, which starts images after their PE signature and starts objects
+    static constexpr size_t COFF_HEADER_SIZE = 20;
+    static constexpr size_t MACHINE_TYPE_OFFSET = 0;
+    static constexpr size_t NUMBER_OF_SECTIONS_OFFSET = 2;
+    static constexpr size_t SIZE_OF_OPTIONAL_HEADER_OFFSET = 16;
+    static constexpr size_t CHARACTERISTICS_OFFSET = 18;
+
+    /// <summary>
+    /// A mapped image. Reads past its end give zeroes and empty strings, so that a truncated or malformed table ends
+    /// the walk over it instead of reading out of bounds.
+    /// </summary>
+    struct ImageView
+    {
+        template<class T>
+        T value_at(const uint64_t offset) const
         {
-            static constexpr size_t HEADER_NAME_OFFSET = 0;
-            static constexpr size_t HEADER_NAME_SIZE = 16;
-            return data.substr(HEADER_NAME_OFFSET, HEADER_NAME_SIZE);
+            T value{};
+            if (offset <= data.size() && data.size() - offset >= sizeof(T))
+            {
+                memcpy(&value, data.data() + offset, sizeof(T));
+            }
+            return value;
         }
 
-        uint64_t member_size() const
+        std::string string_at(const uint64_t offset) const
         {
-            static constexpr size_t ALIGNMENT_SIZE = 2;
-
-            static constexpr size_t HEADER_SIZE_OFFSET = 48;
-            static constexpr size_t HEADER_SIZE_FIELD_SIZE = 10;
-            const std::string as_string = data.substr(HEADER_SIZE_OFFSET, HEADER_SIZE_FIELD_SIZE);
-            // This is in ASCII decimal representation
-            const uint64_t value = std::strtoull(as_string.c_str(), nullptr, 10);
-
-            const uint64_t aligned = align_to_size(value, ALIGNMENT_SIZE);
-            return aligned;
+            if (offset >= data.size()) return std::string();
+            const std::string_view rest = data.substr(static_cast<size_t>(offset));
+            return std::string(rest.substr(0, rest.find('\0')));
         }
 
-        std::string data;
+        std::string_view data;
     };
 
-    struct OffsetsArray
+    /// <summary>Reads up to count section headers at offset, as many as the image holds.</summary>
+    static std::vector<SectionHeader> read_section_headers(const ImageView& image,
+                                                           uint64_t offset,
+                                                           const uint32_t count)
     {
-        static OffsetsArray read(fstream& fs, const uint32_t offset_count)
+        std::vector<SectionHeader> ret;
+        for (uint32_t i = 0; i < count && offset + SectionHeader::HEADER_SIZE <= image.data.size(); ++i)
         {
-            static constexpr uint32_t OFFSET_WIDTH = 4;
-
-            std::string raw_offsets;
-            const uint32_t raw_offset_size = offset_count * OFFSET_WIDTH;
-            raw_offsets.resize(raw_offset_size);
-            fs.read(&raw_offsets[0], raw_offset_size);
-
-            OffsetsArray ret;
-            for (uint32_t i = 0; i < offset_count; ++i)
-            {
-                const std::string value_as_string = raw_offsets.substr(OFFSET_WIDTH * static_cast<size_t>(i),
-                                                                       OFFSET_WIDTH * (static_cast<size_t>(i) + 1));
-                const auto value = reinterpret_bytes<uint32_t>(value_as_string.c_str());
-
-                // Ignore offsets that point to offset 0. See vcpkg github #223 #288 #292
-                if (value != 0)
-                {
-                    ret.data.push_back(value);
-                }
-            }
-
-            // Sort the offsets, because it is possible for them to be unsorted. See vcpkg github #292
-            std::sort(ret.data.begin(), ret.data.end());
-            return ret;
+            ret.push_back(SectionHeader::parse(image.data.data() + offset));
+            offset += SectionHeader::HEADER_SIZE;
         }
+        return ret;
+    }
 
-        std::vector<uint32_t> data;
-    };
-
-    struct ImportHeader
+    DllInfo read_dll(const Files::Filesystem& fs, const fs::path& path)
     {
-        static constexpr size_t HEADER_SIZE = 20;
-
-        static ImportHeader read(fstream& fs)
-        {
-            static constexpr size_t SIG1_OFFSET = 0;
-            static constexpr auto SIG1 = static_cast<uint16_t>(MachineType::UNKNOWN);
-            static constexpr size_t SIG1_SIZE = 2;
-
-            static constexpr size_t SIG2_OFFSET = 2;
-            static constexpr uint16_t SIG2 = 0xFFFF;
-            static constexpr size_t SIG2_SIZE = 2;
+        auto maybe_file = fs.map_contents(path);
+        const auto p_file = maybe_file.get();
+        Checks::check_exit(
+            VCPKG_LINE_INFO, p_file != nullptr, "Could not open file %s for reading", path.generic_string());
+        const ImageView image{(*p_file)->contents()};
 
-            ImportHeader ret;
-            ret.data.resize(HEADER_SIZE);
-            fs.read(&ret.data[0], HEADER_SIZE);
-
-            const std::string sig1_as_string = ret.data.substr(SIG1_OFFSET, SIG1_SIZE);
-            const auto sig1 = reinterpret_bytes<uint16_t>(sig1_as_string.c_str());
-            Checks::check_exit(VCPKG_LINE_INFO, sig1 == SIG1, "Sig1 was incorrect. Expected %s but got %s", SIG1, sig1);
-
-            const std::string sig2_as_string = ret.data.substr(SIG2_OFFSET, SIG2_SIZE);
-            const auto sig2 = reinterpret_bytes<uint16_t>(sig2_as_string.c_str());
-            Checks::check_exit(VCPKG_LINE_INFO, sig2 == SIG2, "Sig2 was incorrect. Expected %s but got %s", SIG2, sig2);
+        static constexpr size_t OFFSET_TO_PE_SIGNATURE_OFFSET = 0x3c;
+        static constexpr StringLiteral PE_SIGNATURE = "PE\0\0";
+        static constexpr size_t PE_SIGNATURE_SIZE = 4;
 
-            return ret;
+        static constexpr uint16_t PE32_PLUS_MAGIC = 0x20b;
+        // The offsets below are the same in PE32 and PE32+ optional headers, except for the last two
+        static constexpr size_t DLL_CHARACTERISTICS_OFFSET = 70;
+        static constexpr uint16_t APP_CONTAINER_FLAG = 0x1000;
+        static constexpr size_t DIRECTORY_COUNT_OFFSET_PE32 = 92;
+        static constexpr size_t DIRECTORY_COUNT_OFFSET_PE32_PLUS = 108;
+        static constexpr size_t DIRECTORY_SIZE = 8;
+
+        static constexpr uint32_t EXPORT_DIRECTORY = 0;
+        static constexpr size_t EXPORT_FUNCTION_COUNT_OFFSET = 20;
+        static constexpr size_t EXPORT_NAME_COUNT_OFFSET = 24;
+        static constexpr size_t EXPORT_NAMES_OFFSET = 32;
+
+        static constexpr uint32_t IMPORT_DIRECTORY = 1;
+        static constexpr size_t IMPORT_DESCRIPTOR_SIZE = 20;
+        static constexpr size_t IMPORT_NAME_OFFSET = 12;
+
+        static constexpr uint32_t DEBUG_DIRECTORY = 6;
+        static constexpr size_t DEBUG_ENTRY_SIZE = 28;
+        static constexpr size_t DEBUG_TYPE_OFFSET = 12;
+        static constexpr uint32_t DEBUG_TYPE_CODEVIEW = 2;
+        static constexpr size_t DEBUG_POINTER_TO_RAW_DATA_OFFSET = 24;
+        static constexpr StringLiteral CODEVIEW_PDB70_SIGNATURE = "RSDS";
+        // After the signature, a GUID and an age
+        static constexpr size_t CODEVIEW_PDB70_PATH_OFFSET = 24;
+
+        static constexpr uint32_t DELAY_IMPORT_DIRECTORY = 13;
+        static constexpr size_t DELAY_IMPORT_DESCRIPTOR_SIZE = 32;
+        static constexpr size_t DELAY_IMPORT_NAME_OFFSET = 4;
+
+        const uint64_t signature_offset = image.value_at<uint32_t>(OFFSET_TO_PE_SIGNATURE_OFFSET);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           signature_offset < image.data.size() &&
+                               image.data.substr(static_cast<size_t>(signature_offset), PE_SIGNATURE_SIZE) ==
+                                   std::string_view(PE_SIGNATURE.c_str(), PE_SIGNATURE_SIZE),
+                           "Incorrect string (PE_SIGNATURE) found in %s",
+                           path.generic_string());
+        const uint64_t header_offset = signature_offset + PE_SIGNATURE_SIZE;
+
+        DllInfo ret{};
+        ret.machine_type = to_machine_type(image.value_at<uint16_t>(header_offset + MACHINE_TYPE_OFFSET));
+        ret.characteristics = image.value_at<uint16_t>(header_offset + CHARACTERISTICS_OFFSET);
+
+        const uint64_t optional_header_offset = header_offset + COFF_HEADER_SIZE;
+        const bool is_pe32_plus = image.value_at<uint16_t>(optional_header_offset) == PE32_PLUS_MAGIC;
+        const uint64_t directory_count_offset =
+            optional_header_offset + (is_pe32_plus ? DIRECTORY_COUNT_OFFSET_PE32_PLUS : DIRECTORY_COUNT_OFFSET_PE32);
+        const auto directory_count = image.value_at<uint32_t>(directory_count_offset);
+        ret.dll_characteristics = image.value_at<uint16_t>(optional_header_offset + DLL_CHARACTERISTICS_OFFSET);
+        ret.is_app_container = (ret.dll_characteristics & APP_CONTAINER_FLAG) != 0;
+
+        const std::vector<SectionHeader> sections = read_section_headers(
+            image,
+            optional_header_offset + image.value_at<uint16_t>(header_offset + SIZE_OF_OPTIONAL_HEADER_OFFSET),
+            image.value_at<uint16_t>(header_offset + NUMBER_OF_SECTIONS_OFFSET));
+
+        const auto directory_entry = [&](const uint32_t directory) -> uint64_t {
+            if (directory >= directory_count) return 0;
+            return directory_count_offset + sizeof(uint32_t) + directory * DIRECTORY_SIZE;
+        };
+        const auto directory_offset = [&](const uint32_t directory) -> uint64_t {
+            const uint64_t entry = directory_entry(directory);
+            return entry == 0 ? 0 : rva_to_offset(sections, image.value_at<uint32_t>(entry));
+        };
+
+        if (const uint64_t exports = directory_offset(EXPORT_DIRECTORY))
+        {
+            ret.export_count = image.value_at<uint32_t>(exports + EXPORT_FUNCTION_COUNT_OFFSET);
+            const auto name_count = image.value_at<uint32_t>(exports + EXPORT_NAME_COUNT_OFFSET);
+            const uint64_t names =
+                rva_to_offset(sections, image.value_at<uint32_t>(exports + EXPORT_NAMES_OFFSET));
+            for (uint32_t i = 0; names != 0 && i < name_count; ++i)
+            {
+                const uint64_t name = rva_to_offset(sections, image.value_at<uint32_t>(names + i * 4ull));
+                if (name == 0) break;
+                ret.export_names.push_back(image.string_at(name));
+            }
         }
 
-        MachineType machine_type() const
-        {
-            static constexpr size_t MACHINE_TYPE_OFFSET = 6;
-            static constexpr size_t MACHINE_TYPE_SIZE = 2;
+        const auto read_dependencies = [&](const uint64_t descriptors, const size_t size, const size_t name_offset) {
+            for (uint64_t descriptor = descriptors; descriptors != 0; descriptor += size)
+            {
+                // The table ends with an all zero descriptor
+                const uint64_t name = rva_to_offset(sections, image.value_at<uint32_t>(descriptor + name_offset));
+                if (name == 0) break;
+                ret.dependencies.push_back(image.string_at(name));
+            }
+        };
+        read_dependencies(directory_offset(IMPORT_DIRECTORY), IMPORT_DESCRIPTOR_SIZE, IMPORT_NAME_OFFSET);
+        read_dependencies(
+            directory_offset(DELAY_IMPORT_DIRECTORY), DELAY_IMPORT_DESCRIPTOR_SIZE, DELAY_IMPORT_NAME_OFFSET);
 
-            std::string machine_field_as_string = data.substr(MACHINE_TYPE_OFFSET, MACHINE_TYPE_SIZE);
-            const auto machine = reinterpret_bytes<uint16_t>(machine_field_as_string.c_str());
-            return to_machine_type(machine);
+        if (const uint64_t debug_entries = directory_offset(DEBUG_DIRECTORY))
+        {
+            // Unlike the other directories, the entries locate their data by file offset
+            const uint32_t debug_size = image.value_at<uint32_t>(directory_entry(DEBUG_DIRECTORY) + sizeof(uint32_t));
+            for (uint64_t entry = debug_entries; entry + DEBUG_ENTRY_SIZE <= debug_entries + debug_size;
+                 entry += DEBUG_ENTRY_SIZE)
+            {
+                if (image.value_at<uint32_t>(entry + DEBUG_TYPE_OFFSET) != DEBUG_TYPE_CODEVIEW) continue;
+                const uint64_t codeview = image.value_at<uint32_t>(entry + DEBUG_POINTER_TO_RAW_DATA_OFFSET);
+                if (image.value_at<uint32_t>(codeview) !=
+                    reinterpret_bytes<uint32_t>(CODEVIEW_PDB70_SIGNATURE.c_str()))
+                    continue;
+                ret.pdb_path = image.string_at(codeview + CODEVIEW_PDB70_PATH_OFFSET);
+                break;
+            }
         }
 
-    private:
-        std::string data;
-    };
+        return ret;
+    }
 
-    static void read_and_verify_archive_file_signature(fstream& fs)
+    /// <summary>
+    /// Adds the options of the .drectve sections of the object at object_offset. They are separated by spaces and
+    /// may be quoted like command line arguments; the quotes are dropped, as dumpbin /directives does.
+    /// </summary>
+    static void read_linker_directives(const ImageView& image,
+                                       const uint64_t object_offset,
+                                       const std::vector<SectionHeader>& sections,
+                                       std::set<std::string>& out)
     {
-        static constexpr StringLiteral FILE_START = "!<arch>\n";
-        static constexpr size_t FILE_START_SIZE = 8;
+        static constexpr StringLiteral DIRECTIVE_SECTION_NAME = ".drectve";
+        static constexpr StringLiteral UTF8_BOM = "\xEF\xBB\xBF";
 
-        fs.seekg(std::fstream::beg);
+        for (auto&& section : sections)
+        {
+            if (section.name != DIRECTIVE_SECTION_NAME.c_str() || section.size_of_raw_data == 0) continue;
 
-        char file_start[FILE_START_SIZE];
-        fs.read(file_start, FILE_START_SIZE);
-        verify_equal_strings(VCPKG_LINE_INFO, FILE_START.c_str(), file_start, FILE_START_SIZE, "LIB FILE_START");
-    }
+            const uint64_t offset = object_offset + section.pointer_to_raw_data;
+            if (offset >= image.data.size()) continue;
+            std::string_view contents = image.data.substr(static_cast<size_t>(offset), section.size_of_raw_data);
+            if (contents.substr(0, UTF8_BOM.size()) == UTF8_BOM.c_str()) contents.remove_prefix(UTF8_BOM.size());
 
-    DllInfo read_dll(const fs::path& path)
-    {
-        std::fstream fs(path, std::ios::in | std::ios::binary | std::ios::ate);
-        Checks::check_exit(VCPKG_LINE_INFO, fs.is_open(), "Could not open file %s for reading", path.generic_string());
-
-        read_and_verify_pe_signature(fs);
-        CoffFileHeader header = CoffFileHeader::read(fs);
-        const MachineType machine = header.machine_type();
-        return {machine};
+            std::string directive;
+            bool in_quotes = false;
+            for (const char ch : contents)
+            {
+                if (ch == '"')
+                {
+                    in_quotes = !in_quotes;
+                }
+                else if ((ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == '\0') && !in_quotes)
+                {
+                    if (!directive.empty()) out.insert(std::move(directive));
+                    directive.clear();
+                }
+                else
+                {
+                    directive.push_back(ch);
+                }
+            }
+            if (!directive.empty()) out.insert(std::move(directive));
+        }
     }
 
-    struct Marker
+    LibInfo read_lib(const Files::Filesystem& fs, const fs::path& path)
     {
-        void set_to_offset(const fpos_t position) { this->m_absolute_position = position; }
-
-        void set_to_current_pos(fstream& fs) { this->m_absolute_position = fs.tellg(); }
-
-        void seek_to_marker(fstream& fs) const { fs.seekg(this->m_absolute_position, ios_base::beg); }
-
-        void advance_by(const uint64_t offset) { this->m_absolute_position += offset; }
+        auto maybe_file = fs.map_contents(path);
+        const auto p_file = maybe_file.get();
+        Checks::check_exit(
+            VCPKG_LINE_INFO, p_file != nullptr, "Could not open file %s for reading", path.generic_string());
+        const ImageView image{(*p_file)->contents()};
 
-    private:
-        fpos_t m_absolute_position = 0;
-    };
-
-    LibInfo read_lib(const fs::path& path)
-    {
-        std::fstream fs(path, std::ios::in | std::ios::binary | std::ios::ate);
-        Checks::check_exit(VCPKG_LINE_INFO, fs.is_open(), "Could not open file %s for reading", path.generic_string());
+        static constexpr StringLiteral FILE_START = "!<arch>\n";
 
-        read_and_verify_archive_file_signature(fs);
+        static constexpr size_t MEMBER_HEADER_SIZE = 60;
+        static constexpr size_t MEMBER_SIZE_OFFSET = 48;
+        static constexpr size_t MEMBER_SIZE_FIELD_SIZE = 10;
+        static constexpr size_t MEMBER_HEADER_END_OFFSET = 58;
+        static constexpr StringLiteral MEMBER_HEADER_END = "`\n";
+        static constexpr StringLiteral LINKER_MEMBER_NAME = "/ ";
 
-        Marker marker;
-        marker.set_to_current_pos(fs);
+        static constexpr size_t IMPORT_SIG2_OFFSET = 2;
+        static constexpr uint16_t IMPORT_SIG2 = 0xFFFF;
+        static constexpr size_t IMPORT_VERSION_OFFSET = 4;
+        static constexpr size_t IMPORT_MACHINE_TYPE_OFFSET = 6;
 
-        // First Linker Member
-        const ArchiveMemberHeader first_linker_member_header = ArchiveMemberHeader::read(fs);
-        Checks::check_exit(VCPKG_LINE_INFO,
-                           first_linker_member_header.name().substr(0, 2) == "/ ",
-                           "Could not find proper first linker member");
-        marker.advance_by(ArchiveMemberHeader::HEADER_SIZE + first_linker_member_header.member_size());
-        marker.seek_to_marker(fs);
+        // Objects compiled with /bigobj start like import headers, but with a version of 2 or more where an import
+        // header has 0. Their section table follows a 56 byte header.
+        static constexpr size_t BIGOBJ_NUMBER_OF_SECTIONS_OFFSET = 44;
+        static constexpr size_t BIGOBJ_HEADER_SIZE = 56;
 
-        const ArchiveMemberHeader second_linker_member_header = ArchiveMemberHeader::read(fs);
         Checks::check_exit(VCPKG_LINE_INFO,
-                           second_linker_member_header.name().substr(0, 2) == "/ ",
-                           "Could not find proper second linker member");
-        // The first 4 bytes contains the number of archive members
-        const auto archive_member_count = read_value_from_stream<uint32_t>(fs);
-        const OffsetsArray offsets = OffsetsArray::read(fs, archive_member_count);
-        marker.advance_by(ArchiveMemberHeader::HEADER_SIZE + second_linker_member_header.member_size());
-        marker.seek_to_marker(fs);
-
-        const bool has_longname_member_header = peek_value_from_stream<uint16_t>(fs) == 0x2F2F;
-        if (has_longname_member_header)
+                           image.data.substr(0, FILE_START.size()) == FILE_START.c_str(),
+                           "Incorrect string (LIB FILE_START) found in %s",
+                           path.generic_string());
+
+        // Returns the offset of the member after the one whose header is at offset; members are 2 byte aligned
+        const auto read_member_header = [&](const uint64_t offset, const char* label) -> uint64_t {
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               offset + MEMBER_HEADER_SIZE <= image.data.size(),
+                               "Could not find proper %s in %s",
+                               label,
+                               path.generic_string());
+            const std::string_view header = image.data.substr(static_cast<size_t>(offset), MEMBER_HEADER_SIZE);
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               header.substr(0, LINKER_MEMBER_NAME.size()) == LINKER_MEMBER_NAME.c_str(),
+                               "Could not find proper %s in %s",
+                               label,
+                               path.generic_string());
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               header.substr(MEMBER_HEADER_END_OFFSET) == MEMBER_HEADER_END.c_str(),
+                               "Incorrect string (LIB HEADER_END) found in %s",
+                               path.generic_string());
+            // This is in ASCII decimal representation
+            const uint64_t size = std::strtoull(
+                std::string(header.substr(MEMBER_SIZE_OFFSET, MEMBER_SIZE_FIELD_SIZE)).c_str(), nullptr, 10);
+            return offset + MEMBER_HEADER_SIZE + size + (size & 1);
+        };
+
+        const uint64_t second_linker_member = read_member_header(FILE_START.size(), "first linker member");
+        read_member_header(second_linker_member, "second linker member");
+
+        // The second linker member starts with the number of archive members and their offsets
+        const uint64_t member_offsets = second_linker_member + MEMBER_HEADER_SIZE;
+        const auto member_count = image.value_at<uint32_t>(member_offsets);
+        std::vector<uint32_t> offsets;
+        for (uint32_t i = 0; i < member_count && member_offsets + 4ull * (i + 2) <= image.data.size(); ++i)
         {
-            const ArchiveMemberHeader longnames_member_header = ArchiveMemberHeader::read(fs);
-            marker.advance_by(ArchiveMemberHeader::HEADER_SIZE + longnames_member_header.member_size());
-            marker.seek_to_marker(fs);
+            const auto offset = image.value_at<uint32_t>(member_offsets + 4ull * (i + 1));
+            // Ignore offsets that point to offset 0. See vcpkg github #223 #288 #292
+            if (offset != 0) offsets.push_back(offset);
         }
+        // Sort the offsets, because it is possible for them to be unsorted. See vcpkg github #292
+        std::sort(offsets.begin(), offsets.end());
 
+        // The objects and pseudo-objects are read where the offsets point, so every member is visited once and only
+        // its headers and .drectve sections are touched
         std::set<MachineType> machine_types;
-        // Next we have the obj and pseudo-object files
-        for (const uint32_t offset : offsets.data)
+        std::set<std::string> linker_directives;
+        for (const uint32_t offset : offsets)
         {
-            marker.set_to_offset(offset + ArchiveMemberHeader::HEADER_SIZE); // Skip the header, no need to read it.
-            marker.seek_to_marker(fs);
-            const auto first_two_bytes = peek_value_from_stream<uint16_t>(fs);
+            const uint64_t object_offset = offset + MEMBER_HEADER_SIZE;
+            const auto first_two_bytes = image.value_at<uint16_t>(object_offset);
             const bool is_import_header = to_machine_type(first_two_bytes) == MachineType::UNKNOWN;
-            const MachineType machine =
-                is_import_header ? ImportHeader::read(fs).machine_type() : CoffFileHeader::read(fs).machine_type();
-            machine_types.insert(machine);
+            if (is_import_header)
+            {
+                const auto sig2 = image.value_at<uint16_t>(object_offset + IMPORT_SIG2_OFFSET);
+                Checks::check_exit(VCPKG_LINE_INFO,
+                                   sig2 == IMPORT_SIG2,
+                                   "Sig2 was incorrect. Expected %s but got %s",
+                                   IMPORT_SIG2,
+                                   sig2);
+
+                machine_types.insert(
+                    to_machine_type(image.value_at<uint16_t>(object_offset + IMPORT_MACHINE_TYPE_OFFSET)));
+                if (image.value_at<uint16_t>(object_offset + IMPORT_VERSION_OFFSET) >= 2)
+                {
+                    const auto section_count =
+                        image.value_at<uint32_t>(object_offset + BIGOBJ_NUMBER_OF_SECTIONS_OFFSET);
+                    read_linker_directives(
+                        image,
+                        object_offset,
+                        read_section_headers(image, object_offset + BIGOBJ_HEADER_SIZE, section_count),
+                        linker_directives);
+                }
+            }
+            else
+            {
+                machine_types.insert(to_machine_type(first_two_bytes));
+                const uint64_t section_table_offset =
+                    object_offset + COFF_HEADER_SIZE +
+                    image.value_at<uint16_t>(object_offset + SIZE_OF_OPTIONAL_HEADER_OFFSET);
+                read_linker_directives(
+                    image,
+                    object_offset,
+                    read_section_headers(image,
+                                         section_table_offset,
+                                         image.value_at<uint16_t>(object_offset + NUMBER_OF_SECTIONS_OFFSET)),
+                    linker_directives);
+            }
         }
 
-        return {std::vector<MachineType>(machine_types.cbegin(), machine_types.cend())};
+        return {std::vector<MachineType>(machine_types.cbegin(), machine_types.cend()),
+                std::vector<std::string>(linker_directives.cbegin(), linker_directives.cend())};
     }
-#endif
 }
@@ -0,0 +1,938 @@
+#include "pch.h"
+
+#include <vcpkg/base/checks.h>
+#include <vcpkg/base/deflate.h>
+
+namespace vcpkg::Deflate
+{
+    static constexpr size_t WINDOW_SIZE = 32768;
+    static constexpr size_t MIN_MATCH = 3;
+    static constexpr size_t MAX_MATCH = 258;
+    static constexpr size_t MAX_BITS = 15;
+    static constexpr size_t MAX_CODELEN_BITS = 7;
+    static constexpr size_t END_OF_BLOCK = 256;
+    static constexpr size_t LITLEN_CODES = 286;
+    static constexpr size_t DIST_CODES = 30;
+    static constexpr size_t CODELEN_CODES = 19;
+    static constexpr size_t MAX_STORED_BLOCK = 65535;
+
+    static constexpr uint16_t LENGTH_BASE[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                                 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static constexpr uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                                 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static constexpr uint16_t DIST_BASE[30] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,
+                                               33,  49,  65,  97,  129, 193,  257,  385,  513,  769,
+                                               1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    static constexpr uint8_t DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                               6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+    static constexpr uint8_t CODELEN_ORDER[CODELEN_CODES] = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+    struct CodeTables
+    {
+        CodeTables()
+        {
+            for (uint8_t code = 0; code < 29; ++code)
+            {
+                const size_t last = std::min<size_t>(LENGTH_BASE[code] + (size_t(1) << LENGTH_EXTRA[code]) - 1, MAX_MATCH);
+                for (size_t length = LENGTH_BASE[code]; length <= last; ++length)
+                    length_code[length] = code;
+            }
+            for (uint8_t code = 0; code < DIST_CODES; ++code)
+            {
+                const size_t last = DIST_BASE[code] + (size_t(1) << DIST_EXTRA[code]) - 1;
+                for (size_t dist = DIST_BASE[code]; dist <= last; ++dist)
+                    dist_code[dist] = code;
+            }
+        }
+
+        uint8_t length_code[MAX_MATCH + 1] = {};
+        uint8_t dist_code[WINDOW_SIZE + 1] = {};
+    };
+
+    static const CodeTables& code_tables()
+    {
+        static const CodeTables tables;
+        return tables;
+    }
+
+    static uint16_t reverse_bits(uint16_t code, size_t length)
+    {
+        uint16_t reversed = 0;
+        for (size_t i = 0; i < length; ++i)
+        {
+            reversed = static_cast<uint16_t>((reversed << 1) | (code & 1));
+            code >>= 1;
+        }
+        return reversed;
+    }
+
+    static std::vector<uint8_t> fixed_litlen_lengths()
+    {
+        std::vector<uint8_t> lengths(288);
+        std::fill(lengths.begin(), lengths.begin() + 144, uint8_t(8));
+        std::fill(lengths.begin() + 144, lengths.begin() + 256, uint8_t(9));
+        std::fill(lengths.begin() + 256, lengths.begin() + 280, uint8_t(7));
+        std::fill(lengths.begin() + 280, lengths.end(), uint8_t(8));
+        return lengths;
+    }
+
+    // The fixed distance tree has 32 codes so that it is complete, even though codes 30 and 31 never occur
+    static std::vector<uint8_t> fixed_dist_lengths() { return std::vector<uint8_t>(32, 5); }
+
+    /// <summary>
+    /// Huffman code lengths for `freqs`, limited to `max_bits`. Deep trees are flattened by halving the frequencies.
+    /// </summary>
+    static std::vector<uint8_t> huffman_lengths(std::vector<uint32_t> freqs, const size_t max_bits)
+    {
+        std::vector<uint8_t> lengths(freqs.size(), 0);
+        while (true)
+        {
+            using Item = std::pair<uint64_t, size_t>;
+            std::priority_queue<Item, std::vector<Item>, std::greater<Item>> heap;
+            std::vector<size_t> parent;
+            std::vector<size_t> leaf_symbols;
+            for (size_t symbol = 0; symbol < freqs.size(); ++symbol)
+            {
+                if (freqs[symbol] == 0) continue;
+                heap.emplace(freqs[symbol], parent.size());
+                parent.push_back(0);
+                leaf_symbols.push_back(symbol);
+            }
+
+            if (leaf_symbols.empty()) return lengths;
+            if (leaf_symbols.size() == 1)
+            {
+                lengths[leaf_symbols.front()] = 1;
+                return lengths;
+            }
+
+            while (heap.size() > 1)
+            {
+                const Item a = heap.top();
+                heap.pop();
+                const Item b = heap.top();
+                heap.pop();
+                const size_t node = parent.size();
+                parent.push_back(0);
+                parent[a.second] = node;
+                parent[b.second] = node;
+                heap.emplace(a.first + b.first, node);
+            }
+
+            // Parents are always created after their children, so one reverse pass assigns every depth
+            std::vector<size_t> depth(parent.size(), 0);
+            for (size_t node = parent.size() - 1; node-- > 0;)
+            {
+                depth[node] = depth[parent[node]] + 1;
+            }
+
+            size_t deepest = 0;
+            for (size_t leaf = 0; leaf < leaf_symbols.size(); ++leaf)
+            {
+                deepest = std::max(deepest, depth[leaf]);
+            }
+
+            if (deepest <= max_bits)
+            {
+                for (size_t leaf = 0; leaf < leaf_symbols.size(); ++leaf)
+                {
+                    lengths[leaf_symbols[leaf]] = static_cast<uint8_t>(depth[leaf]);
+                }
+                return lengths;
+            }
+
+            for (auto&& freq : freqs)
+            {
+                freq = (freq + 1) / 2;
+            }
+        }
+    }
+
+    /// <summary>Canonical codes for `lengths`, bit reversed for LSB-first output.</summary>
+    static std::vector<uint16_t> canonical_codes(const std::vector<uint8_t>& lengths)
+    {
+        uint16_t length_counts[MAX_BITS + 1] = {};
+        for (auto&& length : lengths)
+        {
+            if (length != 0) ++length_counts[length];
+        }
+
+        uint16_t next_code[MAX_BITS + 1] = {};
+        uint16_t code = 0;
+        for (size_t bits = 1; bits <= MAX_BITS; ++bits)
+        {
+            code = static_cast<uint16_t>((code + length_counts[bits - 1]) << 1);
+            next_code[bits] = code;
+        }
+
+        std::vector<uint16_t> codes(lengths.size(), 0);
+        for (size_t symbol = 0; symbol < lengths.size(); ++symbol)
+        {
+            if (lengths[symbol] != 0) codes[symbol] = reverse_bits(next_code[lengths[symbol]]++, lengths[symbol]);
+        }
+        return codes;
+    }
+
+    /// <summary>Gives unused symbols a frequency of 1 until at least two are used, so the code is complete.</summary>
+    static void ensure_two_codes(std::vector<uint32_t>& freqs)
+    {
+        size_t used = std::count_if(freqs.begin(), freqs.end(), [](uint32_t freq) { return freq != 0; });
+        for (size_t symbol = 0; used < 2 && symbol < freqs.size(); ++symbol)
+        {
+            if (freqs[symbol] == 0)
+            {
+                freqs[symbol] = 1;
+                ++used;
+            }
+        }
+    }
+
+    struct BitWriter
+    {
+        void put(uint32_t value, size_t count)
+        {
+            bit_buffer |= uint64_t(value) << bit_count;
+            bit_count += count;
+            while (bit_count >= 8)
+            {
+                bytes.push_back(static_cast<char>(bit_buffer & 0xFF));
+                bit_buffer >>= 8;
+                bit_count -= 8;
+            }
+        }
+
+        void align()
+        {
+            if (bit_count != 0) put(0, 8 - bit_count);
+        }
+
+        std::string bytes;
+        uint64_t bit_buffer = 0;
+        size_t bit_count = 0;
+    };
+
+    struct Token
+    {
+        /// <summary>The literal byte, or the match length when `dist` is not zero.</summary>
+        uint16_t value;
+        uint16_t dist;
+    };
+
+    struct Compressor::Impl
+    {
+        static constexpr size_t BLOCK_SIZE = size_t(1) << 17;
+        static constexpr size_t HASH_BITS = 15;
+        // Search effort roughly matches zlib level 6
+        static constexpr size_t MAX_CHAIN = 128;
+        static constexpr size_t NICE_MATCH = 128;
+        static constexpr size_t GOOD_MATCH = 8;
+        static constexpr size_t MAX_LAZY = 16;
+        static constexpr uint64_t NO_POSITION = UINT64_MAX;
+
+        explicit Impl(WriteFn&& write)
+            : write(std::move(write))
+            , head(size_t(1) << HASH_BITS, NO_POSITION)
+            , prev(WINDOW_SIZE, NO_POSITION)
+        {
+        }
+
+        uint64_t end() const { return base + buffer.size(); }
+        const uint8_t* at(uint64_t position) const { return buffer.data() + (position - base); }
+
+        size_t hash_at(uint64_t position) const
+        {
+            const uint8_t* p = at(position);
+            return ((size_t(p[0]) << 10) ^ (size_t(p[1]) << 5) ^ p[2]) & ((size_t(1) << HASH_BITS) - 1);
+        }
+
+        void insert(uint64_t position)
+        {
+            if (position + MIN_MATCH > end()) return;
+            const size_t hash = hash_at(position);
+            prev[position & (WINDOW_SIZE - 1)] = head[hash];
+            head[hash] = position;
+        }
+
+        /// <summary>Longest match for `position` that beats `prev_length`, searching less after a good match.</summary>
+        std::pair<size_t, size_t> find_match(uint64_t position, size_t prev_length) const
+        {
+            const size_t max_length = static_cast<size_t>(std::min<uint64_t>(MAX_MATCH, end() - position));
+            if (max_length < MIN_MATCH) return {0, 0};
+
+            const uint8_t* current = at(position);
+            size_t best_length = std::min(prev_length, max_length - 1);
+            size_t best_dist = 0;
+            const size_t max_chain = prev_length >= GOOD_MATCH ? MAX_CHAIN / 4 : MAX_CHAIN;
+            uint64_t candidate = head[hash_at(position)];
+            for (size_t chain = 0; chain < max_chain && candidate != NO_POSITION && candidate >= base &&
+                                   position - candidate <= WINDOW_SIZE;
+                 ++chain)
+            {
+                const uint8_t* match = at(candidate);
+                if (match[best_length] == current[best_length])
+                {
+                    size_t length = 0;
+                    while (length < max_length && match[length] == current[length])
+                        ++length;
+                    if (length > best_length)
+                    {
+                        best_length = length;
+                        best_dist = static_cast<size_t>(position - candidate);
+                        if (length >= NICE_MATCH || length == max_length) break;
+                    }
+                }
+
+                // A slot that holds a newer position has been reused since `candidate` was inserted
+                const uint64_t next = prev[candidate & (WINDOW_SIZE - 1)];
+                if (next == NO_POSITION || next >= candidate) break;
+                candidate = next;
+            }
+
+            if (best_dist == 0 || best_length < MIN_MATCH) return {0, 0};
+            return {best_length, best_dist};
+        }
+
+        /// <summary>
+        /// Tokenizes input from `cursor` up to `limit` with one step of lazy matching. A match found just before
+        /// `limit` may extend beyond it. Returns the position after the last token.
+        /// </summary>
+        uint64_t tokenize(const uint64_t limit, std::vector<Token>& tokens)
+        {
+            uint64_t position = cursor;
+            size_t prev_length = 0;
+            size_t prev_dist = 0;
+            bool have_prev = false;
+
+            auto emit_prev_match = [&](uint64_t first_unhashed) {
+                tokens.push_back({static_cast<uint16_t>(prev_length), static_cast<uint16_t>(prev_dist)});
+                const uint64_t match_end = position - 1 + prev_length;
+                for (uint64_t p = first_unhashed; p < match_end; ++p)
+                    insert(p);
+                position = match_end;
+            };
+
+            while (position < limit)
+            {
+                std::pair<size_t, size_t> match{0, 0};
+                if (!have_prev || prev_length < MAX_LAZY) match = find_match(position, have_prev ? prev_length : 0);
+                insert(position);
+
+                if (have_prev && prev_length >= MIN_MATCH && match.first <= prev_length)
+                {
+                    emit_prev_match(position + 1);
+                    have_prev = false;
+                    continue;
+                }
+
+                if (have_prev) tokens.push_back({*at(position - 1), 0});
+                prev_length = match.first;
+                prev_dist = match.second;
+                have_prev = true;
+                ++position;
+            }
+
+            if (have_prev)
+            {
+                if (prev_length >= MIN_MATCH)
+                    emit_prev_match(position);
+                else
+                    tokens.push_back({*at(position - 1), 0});
+            }
+
+            return position;
+        }
+
+        void write_tokens(BitWriter& out,
+                          const std::vector<Token>& tokens,
+                          const std::vector<uint8_t>& litlen_lengths,
+                          const std::vector<uint8_t>& dist_lengths) const
+        {
+            const auto& tables = code_tables();
+            const auto litlen_codes = canonical_codes(litlen_lengths);
+            const auto dist_codes = canonical_codes(dist_lengths);
+            for (auto&& token : tokens)
+            {
+                if (token.dist == 0)
+                {
+                    out.put(litlen_codes[token.value], litlen_lengths[token.value]);
+                    continue;
+                }
+
+                const size_t length_code = tables.length_code[token.value];
+                out.put(litlen_codes[257 + length_code], litlen_lengths[257 + length_code]);
+                out.put(token.value - LENGTH_BASE[length_code], LENGTH_EXTRA[length_code]);
+
+                const size_t dist_code = tables.dist_code[token.dist];
+                out.put(dist_codes[dist_code], dist_lengths[dist_code]);
+                out.put(token.dist - DIST_BASE[dist_code], DIST_EXTRA[dist_code]);
+            }
+            out.put(litlen_codes[END_OF_BLOCK], litlen_lengths[END_OF_BLOCK]);
+        }
+
+        static uint64_t token_bits(const std::vector<uint32_t>& litlen_freqs,
+                                   const std::vector<uint32_t>& dist_freqs,
+                                   const std::vector<uint8_t>& litlen_lengths,
+                                   const std::vector<uint8_t>& dist_lengths)
+        {
+            uint64_t bits = 0;
+            for (size_t symbol = 0; symbol < litlen_freqs.size(); ++symbol)
+            {
+                const size_t extra = symbol > END_OF_BLOCK ? LENGTH_EXTRA[symbol - 257] : 0;
+                bits += uint64_t(litlen_freqs[symbol]) * (litlen_lengths[symbol] + extra);
+            }
+            for (size_t symbol = 0; symbol < dist_freqs.size(); ++symbol)
+            {
+                bits += uint64_t(dist_freqs[symbol]) * (dist_lengths[symbol] + DIST_EXTRA[symbol]);
+            }
+            return bits;
+        }
+
+        void emit_stored(BitWriter& out, const uint64_t start, const uint64_t stop, const bool final) const
+        {
+            uint64_t position = start;
+            do
+            {
+                const size_t length = static_cast<size_t>(std::min<uint64_t>(stop - position, MAX_STORED_BLOCK));
+                const bool last = position + length == stop;
+                out.put(final && last ? 1 : 0, 1);
+                out.put(0, 2);
+                out.align();
+                out.put(static_cast<uint32_t>(length), 16);
+                out.put(static_cast<uint32_t>(~length & 0xFFFF), 16);
+                out.bytes.append(reinterpret_cast<const char*>(at(position)), length);
+                position += length;
+            } while (position < stop);
+        }
+
+        void emit_block(const std::vector<Token>& tokens, const uint64_t start, const uint64_t stop, const bool final)
+        {
+            const auto& tables = code_tables();
+            std::vector<uint32_t> litlen_freqs(LITLEN_CODES, 0);
+            std::vector<uint32_t> dist_freqs(DIST_CODES, 0);
+            for (auto&& token : tokens)
+            {
+                if (token.dist == 0)
+                {
+                    ++litlen_freqs[token.value];
+                }
+                else
+                {
+                    ++litlen_freqs[257 + tables.length_code[token.value]];
+                    ++dist_freqs[tables.dist_code[token.dist]];
+                }
+            }
+            litlen_freqs[END_OF_BLOCK] = 1;
+            ensure_two_codes(litlen_freqs);
+            ensure_two_codes(dist_freqs);
+
+            const auto litlen_lengths = huffman_lengths(litlen_freqs, MAX_BITS);
+            const auto dist_lengths = huffman_lengths(dist_freqs, MAX_BITS);
+
+            size_t litlen_count = LITLEN_CODES;
+            while (litlen_count > 257 && litlen_lengths[litlen_count - 1] == 0)
+                --litlen_count;
+            size_t dist_count = DIST_CODES;
+            while (dist_count > 1 && dist_lengths[dist_count - 1] == 0)
+                --dist_count;
+
+            // Run length encode the code lengths of both trees as one sequence (symbols 16, 17 and 18)
+            std::vector<uint8_t> sequence(litlen_lengths.begin(), litlen_lengths.begin() + litlen_count);
+            sequence.insert(sequence.end(), dist_lengths.begin(), dist_lengths.begin() + dist_count);
+            std::vector<std::pair<uint8_t, uint8_t>> runs;
+            for (size_t i = 0; i < sequence.size();)
+            {
+                const uint8_t value = sequence[i];
+                size_t run = 1;
+                while (i + run < sequence.size() && sequence[i + run] == value)
+                    ++run;
+                i += run;
+
+                if (value == 0)
+                {
+                    for (; run >= 11; run -= std::min<size_t>(run, 138))
+                        runs.emplace_back(uint8_t(18), static_cast<uint8_t>(std::min<size_t>(run, 138) - 11));
+                    if (run >= 3)
+                    {
+                        runs.emplace_back(uint8_t(17), static_cast<uint8_t>(run - 3));
+                        run = 0;
+                    }
+                }
+                else
+                {
+                    runs.emplace_back(value, uint8_t(0));
+                    --run;
+                    for (; run >= 3; run -= std::min<size_t>(run, 6))
+                        runs.emplace_back(uint8_t(16), static_cast<uint8_t>(std::min<size_t>(run, 6) - 3));
+                }
+                for (; run > 0; --run)
+                    runs.emplace_back(value, uint8_t(0));
+            }
+
+            std::vector<uint32_t> codelen_freqs(CODELEN_CODES, 0);
+            for (auto&& run : runs)
+                ++codelen_freqs[run.first];
+            ensure_two_codes(codelen_freqs);
+            const auto codelen_lengths = huffman_lengths(codelen_freqs, MAX_CODELEN_BITS);
+            size_t codelen_count = CODELEN_CODES;
+            while (codelen_count > 4 && codelen_lengths[CODELEN_ORDER[codelen_count - 1]] == 0)
+                --codelen_count;
+
+            static constexpr uint8_t RUN_EXTRA_BITS[3] = {2, 3, 7};
+            uint64_t dynamic_bits = 3 + 5 + 5 + 4 + 3 * codelen_count;
+            for (auto&& run : runs)
+                dynamic_bits += codelen_lengths[run.first] + (run.first >= 16 ? RUN_EXTRA_BITS[run.first - 16] : 0);
+            dynamic_bits += token_bits(litlen_freqs, dist_freqs, litlen_lengths, dist_lengths);
+
+            static const std::vector<uint8_t> FIXED_LITLEN = fixed_litlen_lengths();
+            static const std::vector<uint8_t> FIXED_DIST = fixed_dist_lengths();
+            const uint64_t fixed_bits = 3 + token_bits(litlen_freqs, dist_freqs, FIXED_LITLEN, FIXED_DIST);
+
+            const uint64_t stored_blocks = std::max<uint64_t>(1, (stop - start + MAX_STORED_BLOCK - 1) / MAX_STORED_BLOCK);
+            const uint64_t stored_bits = stored_blocks * (3 + 7 + 32) + 8 * (stop - start);
+
+            if (stored_bits <= fixed_bits && stored_bits <= dynamic_bits)
+            {
+                emit_stored(out, start, stop, final);
+            }
+            else if (fixed_bits <= dynamic_bits)
+            {
+                out.put(final ? 1 : 0, 1);
+                out.put(1, 2);
+                write_tokens(out, tokens, FIXED_LITLEN, FIXED_DIST);
+            }
+            else
+            {
+                out.put(final ? 1 : 0, 1);
+                out.put(2, 2);
+                out.put(static_cast<uint32_t>(litlen_count - 257), 5);
+                out.put(static_cast<uint32_t>(dist_count - 1), 5);
+                out.put(static_cast<uint32_t>(codelen_count - 4), 4);
+                for (size_t i = 0; i < codelen_count; ++i)
+                    out.put(codelen_lengths[CODELEN_ORDER[i]], 3);
+
+                const auto codelen_codes = canonical_codes(codelen_lengths);
+                for (auto&& run : runs)
+                {
+                    out.put(codelen_codes[run.first], codelen_lengths[run.first]);
+                    if (run.first >= 16) out.put(run.second, RUN_EXTRA_BITS[run.first - 16]);
+                }
+                write_tokens(out, tokens, litlen_lengths, dist_lengths);
+            }
+        }
+
+        void compress_block(const uint64_t limit, const bool final)
+        {
+            const uint64_t start = cursor;
+            std::vector<Token> tokens;
+            cursor = tokenize(limit, tokens);
+            emit_block(tokens, start, cursor, final);
+            if (final) out.align();
+
+            write(out.bytes.data(), out.bytes.size());
+            out.bytes.clear();
+
+            // Keep one window of history for the matches of the next block
+            const uint64_t keep_from = cursor > WINDOW_SIZE ? cursor - WINDOW_SIZE : 0;
+            if (keep_from > base)
+            {
+                buffer.erase(buffer.begin(), buffer.begin() + static_cast<ptrdiff_t>(keep_from - base));
+                base = keep_from;
+            }
+        }
+
+        WriteFn write;
+        std::vector<uint8_t> buffer;
+        /// <summary>Stream position of `buffer[0]`.</summary>
+        uint64_t base = 0;
+        /// <summary>Stream position of the first byte that has not been compressed yet.</summary>
+        uint64_t cursor = 0;
+        std::vector<uint64_t> head;
+        std::vector<uint64_t> prev;
+        BitWriter out;
+        bool finished = false;
+    };
+
+    Compressor::Compressor(WriteFn write) : m_impl(std::make_unique<Impl>(std::move(write))) {}
+
+    Compressor::~Compressor() = default;
+
+    void Compressor::write(const char* data, size_t size)
+    {
+        Checks::check_exit(VCPKG_LINE_INFO, !m_impl->finished, "Write to a finished deflate stream");
+
+        // Appending in slices keeps the history trimming in compress_block proportional to the block size
+        while (size > 0)
+        {
+            const size_t slice = std::min(size, Impl::BLOCK_SIZE);
+            m_impl->buffer.insert(m_impl->buffer.end(), data, data + slice);
+            data += slice;
+            size -= slice;
+
+            // Leave a full match of lookahead so no match is cut short at a block boundary
+            while (m_impl->end() - m_impl->cursor >= Impl::BLOCK_SIZE + MAX_MATCH)
+                m_impl->compress_block(m_impl->cursor + Impl::BLOCK_SIZE, false);
+        }
+    }
+
+    void Compressor::finish()
+    {
+        if (m_impl->finished) return;
+        m_impl->compress_block(m_impl->end(), true);
+        m_impl->finished = true;
+    }
+
+    struct BitReader
+    {
+        explicit BitReader(const ReadFn& read) : read(read), buffer(size_t(1) << 16) {}
+
+        /// <summary>Buffers up to `count` bits and returns how many are available.</summary>
+        size_t fill(size_t count)
+        {
+            while (bit_count < count)
+            {
+                if (position == end)
+                {
+                    if (exhausted) break;
+                    end = read(buffer.data(), buffer.size());
+                    position = 0;
+                    if (end == 0)
+                    {
+                        exhausted = true;
+                        break;
+                    }
+                }
+                bit_buffer |= uint64_t(static_cast<uint8_t>(buffer[position++])) << bit_count;
+                bit_count += 8;
+            }
+            return bit_count;
+        }
+
+        uint32_t peek(size_t count) const { return static_cast<uint32_t>(bit_buffer & ((uint64_t(1) << count) - 1)); }
+
+        void drop(size_t count)
+        {
+            bit_buffer >>= count;
+            bit_count -= count;
+        }
+
+        bool get(size_t count, uint32_t& value)
+        {
+            if (fill(count) < count) return false;
+            value = peek(count);
+            drop(count);
+            return true;
+        }
+
+        void align() { drop(bit_count % 8); }
+
+        /// <summary>Appends `size` bytes to `out`. Must be byte aligned.</summary>
+        bool copy_bytes(size_t size, std::string& out)
+        {
+            for (; size > 0 && bit_count >= 8; --size)
+            {
+                out.push_back(static_cast<char>(peek(8)));
+                drop(8);
+            }
+            while (size > 0)
+            {
+                if (position == end)
+                {
+                    if (exhausted) return false;
+                    end = read(buffer.data(), buffer.size());
+                    position = 0;
+                    if (end == 0)
+                    {
+                        exhausted = true;
+                        return false;
+                    }
+                }
+                const size_t chunk = std::min(size, end - position);
+                out.append(buffer.data() + position, chunk);
+                position += chunk;
+                size -= chunk;
+            }
+            return true;
+        }
+
+        const ReadFn& read;
+        std::vector<char> buffer;
+        size_t position = 0;
+        size_t end = 0;
+        bool exhausted = false;
+        uint64_t bit_buffer = 0;
+        size_t bit_count = 0;
+    };
+
+    struct HuffmanDecoder
+    {
+        static constexpr size_t FAST_BITS = 10;
+
+        /// <summary>
+        /// Builds the decoder. Over-subscribed code sets are rejected, and incomplete ones are only accepted with a
+        /// single code, which RFC 1951 allows for the distance tree.
+        /// </summary>
+        bool init(const uint8_t* lengths, size_t count)
+        {
+            std::fill(std::begin(length_counts), std::end(length_counts), uint16_t(0));
+            for (size_t symbol = 0; symbol < count; ++symbol)
+                ++length_counts[lengths[symbol]];
+            length_counts[0] = 0;
+
+            int left = 1;
+            size_t used = 0;
+            for (size_t bits = 1; bits <= MAX_BITS; ++bits)
+            {
+                left <<= 1;
+                left -= length_counts[bits];
+                if (left < 0) return false;
+                used += length_counts[bits];
+            }
+            if (left > 0 && used > 1) return false;
+
+            uint16_t offsets[MAX_BITS + 2] = {};
+            for (size_t bits = 1; bits <= MAX_BITS; ++bits)
+                offsets[bits + 1] = static_cast<uint16_t>(offsets[bits] + length_counts[bits]);
+            symbols.assign(used, 0);
+            for (size_t symbol = 0; symbol < count; ++symbol)
+            {
+                if (lengths[symbol] != 0) symbols[offsets[lengths[symbol]]++] = static_cast<uint16_t>(symbol);
+            }
+
+            fast.assign(size_t(1) << FAST_BITS, 0);
+            uint16_t next_code[MAX_BITS + 1] = {};
+            uint16_t code = 0;
+            for (size_t bits = 1; bits <= MAX_BITS; ++bits)
+            {
+                code = static_cast<uint16_t>((code + length_counts[bits - 1]) << 1);
+                next_code[bits] = code;
+            }
+            for (size_t symbol = 0; symbol < count; ++symbol)
+            {
+                const size_t length = lengths[symbol];
+                if (length == 0) continue;
+                const uint16_t reversed = reverse_bits(next_code[length]++, length);
+                if (length > FAST_BITS) continue;
+                for (size_t index = reversed; index < fast.size(); index += size_t(1) << length)
+                    fast[index] = static_cast<uint16_t>((symbol << 4) | length);
+            }
+            return true;
+        }
+
+        bool decode(BitReader& in, uint32_t& symbol) const
+        {
+            const size_t available = in.fill(MAX_BITS);
+            const uint16_t entry = fast[in.peek(FAST_BITS)];
+            const size_t entry_length = entry & 15;
+            if (entry != 0 && entry_length <= available)
+            {
+                symbol = entry >> 4;
+                in.drop(entry_length);
+                return true;
+            }
+
+            // Canonical decoding one bit at a time for the codes that are too long for the table
+            int code = 0;
+            int first = 0;
+            int index = 0;
+            for (size_t length = 1; length <= MAX_BITS && length <= available; ++length)
+            {
+                code |= (in.peek(length) >> (length - 1)) & 1;
+                const int count = length_counts[length];
+                if (code - first < count)
+                {
+                    symbol = symbols[index + code - first];
+                    in.drop(length);
+                    return true;
+                }
+                index += count;
+                first = (first + count) << 1;
+                code <<= 1;
+            }
+            return false;
+        }
+
+        uint16_t length_counts[MAX_BITS + 1];
+        std::vector<uint16_t> symbols;
+        /// <summary>`(symbol << 4) | length` for every code of at most FAST_BITS, indexed by the next input bits.</summary>
+        std::vector<uint16_t> fast;
+    };
+
+    static bool read_dynamic_trees(BitReader& in, HuffmanDecoder& litlen, HuffmanDecoder& dist)
+    {
+        uint32_t litlen_count, dist_count, codelen_count;
+        if (!in.get(5, litlen_count) || !in.get(5, dist_count) || !in.get(4, codelen_count)) return false;
+        litlen_count += 257;
+        dist_count += 1;
+        codelen_count += 4;
+        if (litlen_count > LITLEN_CODES || dist_count > DIST_CODES) return false;
+
+        uint8_t codelen_lengths[CODELEN_CODES] = {};
+        for (size_t i = 0; i < codelen_count; ++i)
+        {
+            uint32_t length;
+            if (!in.get(3, length)) return false;
+            codelen_lengths[CODELEN_ORDER[i]] = static_cast<uint8_t>(length);
+        }
+        HuffmanDecoder codelen;
+        if (!codelen.init(codelen_lengths, CODELEN_CODES)) return false;
+
+        uint8_t lengths[LITLEN_CODES + DIST_CODES] = {};
+        const size_t total = litlen_count + dist_count;
+        for (size_t i = 0; i < total;)
+        {
+            uint32_t symbol;
+            if (!codelen.decode(in, symbol)) return false;
+            if (symbol < 16)
+            {
+                lengths[i++] = static_cast<uint8_t>(symbol);
+                continue;
+            }
+
+            uint8_t value = 0;
+            uint32_t repeat;
+            if (symbol == 16)
+            {
+                if (i == 0 || !in.get(2, repeat)) return false;
+                value = lengths[i - 1];
+                repeat += 3;
+            }
+            else if (symbol == 17)
+            {
+                if (!in.get(3, repeat)) return false;
+                repeat += 3;
+            }
+            else
+            {
+                if (!in.get(7, repeat)) return false;
+                repeat += 11;
+            }
+            if (i + repeat > total) return false;
+            std::fill(lengths + i, lengths + i + repeat, value);
+            i += repeat;
+        }
+
+        if (lengths[END_OF_BLOCK] == 0) return false;
+        return litlen.init(lengths, litlen_count) && dist.init(lengths + litlen_count, dist_count);
+    }
+
+    bool decompress(const ReadFn& read, const WriteFn& write)
+    {
+        static constexpr size_t FLUSH_SIZE = size_t(1) << 18;
+
+        static const std::pair<HuffmanDecoder, HuffmanDecoder> FIXED = []() {
+            std::pair<HuffmanDecoder, HuffmanDecoder> decoders;
+            const auto litlen_lengths = fixed_litlen_lengths();
+            const auto dist_lengths = fixed_dist_lengths();
+            decoders.first.init(litlen_lengths.data(), litlen_lengths.size());
+            decoders.second.init(dist_lengths.data(), dist_lengths.size());
+            return decoders;
+        }();
+
+        BitReader in(read);
+
+        // Output is written out in large chunks; the last window is kept for back references
+        std::string out;
+        size_t written = 0;
+        auto flush = [&]() {
+            write(out.data() + written, out.size() - written);
+            out.erase(0, out.size() - WINDOW_SIZE);
+            written = out.size();
+        };
+
+        HuffmanDecoder dynamic_litlen;
+        HuffmanDecoder dynamic_dist;
+        bool final = false;
+        while (!final)
+        {
+            uint32_t header;
+            if (!in.get(3, header)) return false;
+            final = (header & 1) != 0;
+            const uint32_t type = header >> 1;
+
+            if (type == 0)
+            {
+                in.align();
+                uint32_t length, inverted_length;
+                if (!in.get(16, length) || !in.get(16, inverted_length)) return false;
+                if ((length ^ 0xFFFF) != inverted_length) return false;
+                if (!in.copy_bytes(length, out)) return false;
+                if (out.size() >= FLUSH_SIZE) flush();
+                continue;
+            }
+
+            const HuffmanDecoder* litlen = &FIXED.first;
+            const HuffmanDecoder* dist = &FIXED.second;
+            if (type == 2)
+            {
+                if (!read_dynamic_trees(in, dynamic_litlen, dynamic_dist)) return false;
+                litlen = &dynamic_litlen;
+                dist = &dynamic_dist;
+            }
+            else if (type != 1)
+            {
+                return false;
+            }
+
+            while (true)
+            {
+                uint32_t symbol;
+                if (!litlen->decode(in, symbol)) return false;
+                if (symbol < END_OF_BLOCK)
+                {
+                    out.push_back(static_cast<char>(symbol));
+                }
+                else if (symbol == END_OF_BLOCK)
+                {
+                    break;
+                }
+                else
+                {
+                    const size_t length_code = symbol - 257;
+                    if (length_code >= 29) return false;
+                    uint32_t extra;
+                    if (!in.get(LENGTH_EXTRA[length_code], extra)) return false;
+                    const size_t length = LENGTH_BASE[length_code] + extra;
+
+                    uint32_t dist_code;
+                    if (!dist->decode(in, dist_code) || dist_code >= DIST_CODES) return false;
+                    if (!in.get(DIST_EXTRA[dist_code], extra)) return false;
+                    const size_t distance = DIST_BASE[dist_code] + extra;
+                    if (distance > out.size()) return false;
+
+                    // Byte by byte, because the source may overlap the bytes being produced
+                    const size_t from = out.size() - distance;
+                    for (size_t i = 0; i < length; ++i)
+                        out.push_back(out[from + i]);
+                }
+
+                if (out.size() >= FLUSH_SIZE) flush();
+            }
+        }
+
+        write(out.data() + written, out.size() - written);
+        return true;
+    }
+
+    std::string compress(const std::string& data)
+    {
+        std::string compressed;
+        Compressor compressor([&](const char* bytes, size_t size) { compressed.append(bytes, size); });
+        compressor.write(data.data(), data.size());
+        compressor.finish();
+        return compressed;
+    }
+
+    bool decompress(const std::string& compressed, std::string& out)
+    {
+        size_t position = 0;
+        return decompress(
+            [&](char* buffer, size_t capacity) {
+                const size_t count = std::min(capacity, compressed.size() - position);
+                std::copy_n(compressed.data() + position, count, buffer);
+                position += count;
+                return count;
+            },
+            [&](const char* bytes, size_t size) { out.append(bytes, size); });
+    }
+}
@@ -2,45 +2,109 @@
 
 #include <vcpkg/base/downloads.h>
 #include <vcpkg/base/hash.h>
+#include <vcpkg/base/http.h>
+#include <vcpkg/base/threadpool.h>
+#include <vcpkg/base/transfers.h>
 #include <vcpkg/base/util.h>
 
+#include <vcpkg/base/system.h>
+#include <vcpkg/base/trace.h>
+
 #if defined(_WIN32)
 #include <VersionHelpers.h>
-#else
-#include <vcpkg/base/system.h>
 #endif
 
 namespace vcpkg::Downloads
 {
+    /// <summary>Receives the body of a response as it arrives.</summary>
+    using DataCallback = std::function<void(std::string_view)>;
+
+    struct UrlInfo
+    {
+        Optional<uint64_t> content_length;
+        bool accepts_ranges = false;
+    };
+
+    /// <summary>
+    /// GET of `url` from byte `offset` on, through `length` bytes if given. The response must start at `offset`;
+    /// returns false when the server ignores the range. Transfers through curl work the same on every platform.
+    /// </summary>
+    static bool curl_get(const std::string& url,
+                         const uint64_t offset,
+                         const Optional<uint64_t>& length,
+                         const DataCallback& on_data,
+                         const bool show_errors)
+    {
+        std::vector<std::string> arguments = {"--location", "--silent", "--show-error", "--fail"};
+        if (const auto p_length = length.get())
+        {
+            // Only a full response passes the size check below, since a server ignoring the range sends everything
+            arguments.push_back("--range");
+            arguments.push_back(Strings::format("%llu-%llu",
+                                                static_cast<unsigned long long>(offset),
+                                                static_cast<unsigned long long>(offset + *p_length - 1)));
+        }
+        else if (offset != 0)
+        {
+            // curl itself fails if the server does not resume at the offset
+            arguments.push_back("--continue-at");
+            arguments.push_back(std::to_string(offset));
+        }
+        arguments.push_back(url);
+
+        // curl only sends on as fast as it is read, so the rate limits reach it as well
+        Transfers::Slot slot(url);
+        uint64_t received = 0;
+        bool overflowed = false;
+        const auto exit = System::process_execute(
+            "curl",
+            arguments,
+            [&](std::string_view data) {
+                slot.throttle(data.size());
+                if (const auto p_length = length.get())
+                {
+                    if (received + data.size() > *p_length)
+                    {
+                        overflowed = true;
+                        return;
+                    }
+                }
+                received += data.size();
+                on_data(data);
+            },
+            [&](std::string_view message) {
+                if (show_errors) System::print("%s", std::string(message));
+            },
+            nullopt);
+        if (exit.exit_code != 0 || overflowed) return false;
+        if (const auto p_length = length.get()) return received == *p_length;
+        return true;
+    }
+
 #if defined(_WIN32)
-    static void winhttp_download_file(Files::Filesystem& fs,
-                                      CStringView target_file_path,
-                                      CStringView hostname,
-                                      CStringView url_path)
+    struct WinHttpHandle
     {
-        // Make sure the directories are present, otherwise fopen_s fails
-        const auto dir = fs::path(target_file_path.c_str()).parent_path();
-        std::error_code ec;
-        fs.create_directories(dir, ec);
-        Checks::check_exit(VCPKG_LINE_INFO, !ec, "Could not create directories %s", dir.u8string());
+        HINTERNET h = nullptr;
 
-        FILE* f = nullptr;
-        const errno_t err = fopen_s(&f, target_file_path.c_str(), "wb");
-        Checks::check_exit(VCPKG_LINE_INFO,
-                           !err,
-                           "Could not download https://%s%s. Failed to open file %s. Error code was %s",
-                           hostname,
-                           url_path,
-                           target_file_path,
-                           std::to_string(err));
-
-        auto hSession = WinHttpOpen(L"vcpkg/1.0",
-                                    IsWindows8Point1OrGreater() ? WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY
-                                                                : WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
-                                    WINHTTP_NO_PROXY_NAME,
-                                    WINHTTP_NO_PROXY_BYPASS,
-                                    0);
-        Checks::check_exit(VCPKG_LINE_INFO, hSession, "WinHttpOpen() failed: %d", GetLastError());
+        WinHttpHandle() = default;
+        WinHttpHandle(const WinHttpHandle&) = delete;
+        WinHttpHandle& operator=(const WinHttpHandle&) = delete;
+        ~WinHttpHandle()
+        {
+            if (h) WinHttpCloseHandle(h);
+        }
+    };
+
+    static void winhttp_open_session(WinHttpHandle& session)
+    {
+        session.h = WinHttpOpen(L"vcpkg/1.0",
+                                IsWindows8Point1OrGreater() ? WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY
+                                                            : WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+                                WINHTTP_NO_PROXY_NAME,
+                                WINHTTP_NO_PROXY_BYPASS,
+                                0);
+        Checks::check_exit(VCPKG_LINE_INFO, session.h, "WinHttpOpen() failed: %d", GetLastError());
+        auto hSession = session.h;
 
         // Win7 IE Proxy fallback
         if (IsWindows7OrGreater() && !IsWindows8Point1OrGreater()) {
@@ -68,64 +132,264 @@ namespace vcpkg::Downloads
         DWORD secure_protocols(WINHTTP_FLAG_SECURE_PROTOCOL_SSL3 | WINHTTP_FLAG_SECURE_PROTOCOL_TLS1 |
                                WINHTTP_FLAG_SECURE_PROTOCOL_TLS1_1 | WINHTTP_FLAG_SECURE_PROTOCOL_TLS1_2);
         WinHttpSetOption(hSession, WINHTTP_OPTION_SECURE_PROTOCOLS, &secure_protocols, sizeof(secure_protocols));
+    }
+
+    /// <summary>Sends `verb` for https://hostname/url_path and returns the status of the response, 0 if none.</summary>
+    static DWORD winhttp_send(WinHttpHandle& session,
+                              WinHttpHandle& connect,
+                              WinHttpHandle& request,
+                              const wchar_t* verb,
+                              const std::string& url,
+                              const std::wstring& headers)
+    {
+        auto url_no_proto = url.substr(8); // drop https://
+        auto path_begin = Util::find(url_no_proto, '/');
+        std::string hostname(url_no_proto.begin(), path_begin);
+        std::string path(path_begin, url_no_proto.end());
+
+        winhttp_open_session(session);
 
         // Specify an HTTP server.
-        auto hConnect = WinHttpConnect(hSession, Strings::to_utf16(hostname).c_str(), INTERNET_DEFAULT_HTTPS_PORT, 0);
-        Checks::check_exit(VCPKG_LINE_INFO, hConnect, "WinHttpConnect() failed: %d", GetLastError());
+        connect.h = WinHttpConnect(session.h, Strings::to_utf16(hostname).c_str(), INTERNET_DEFAULT_HTTPS_PORT, 0);
+        Checks::check_exit(VCPKG_LINE_INFO, connect.h, "WinHttpConnect() failed: %d", GetLastError());
 
         // Create an HTTP request handle.
-        auto hRequest = WinHttpOpenRequest(hConnect,
-                                           L"GET",
-                                           Strings::to_utf16(url_path).c_str(),
-                                           nullptr,
-                                           WINHTTP_NO_REFERER,
-                                           WINHTTP_DEFAULT_ACCEPT_TYPES,
-                                           WINHTTP_FLAG_SECURE);
-        Checks::check_exit(VCPKG_LINE_INFO, hRequest, "WinHttpOpenRequest() failed: %d", GetLastError());
-
-        // Send a request.
-        auto bResults =
-            WinHttpSendRequest(hRequest, WINHTTP_NO_ADDITIONAL_HEADERS, 0, WINHTTP_NO_REQUEST_DATA, 0, 0, 0);
-        Checks::check_exit(VCPKG_LINE_INFO, bResults, "WinHttpSendRequest() failed: %d", GetLastError());
-
-        // End the request.
-        bResults = WinHttpReceiveResponse(hRequest, NULL);
-        Checks::check_exit(VCPKG_LINE_INFO, bResults, "WinHttpReceiveResponse() failed: %d", GetLastError());
+        request.h = WinHttpOpenRequest(connect.h,
+                                       verb,
+                                       Strings::to_utf16(path).c_str(),
+                                       nullptr,
+                                       WINHTTP_NO_REFERER,
+                                       WINHTTP_DEFAULT_ACCEPT_TYPES,
+                                       WINHTTP_FLAG_SECURE);
+        Checks::check_exit(VCPKG_LINE_INFO, request.h, "WinHttpOpenRequest() failed: %d", GetLastError());
 
-        std::vector<char> buf;
+        if (!WinHttpSendRequest(request.h,
+                                headers.empty() ? WINHTTP_NO_ADDITIONAL_HEADERS : headers.c_str(),
+                                headers.empty() ? 0 : static_cast<DWORD>(-1L),
+                                WINHTTP_NO_REQUEST_DATA,
+                                0,
+                                0,
+                                0))
+            return 0;
+        if (!WinHttpReceiveResponse(request.h, NULL)) return 0;
+
+        DWORD status = 0;
+        DWORD status_size = sizeof(status);
+        if (!WinHttpQueryHeaders(request.h,
+                                 WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                                 WINHTTP_HEADER_NAME_BY_INDEX,
+                                 &status,
+                                 &status_size,
+                                 WINHTTP_NO_HEADER_INDEX))
+            return 0;
+        return status;
+    }
+
+    static UrlInfo http_head(const std::string& url)
+    {
+        Transfers::Slot slot(url);
+        WinHttpHandle session, connect, request;
+        UrlInfo info;
+        if (winhttp_send(session, connect, request, L"HEAD", url, std::wstring()) != 200) return info;
+
+        wchar_t buffer[64];
+        DWORD size = sizeof(buffer);
+        if (WinHttpQueryHeaders(request.h,
+                                WINHTTP_QUERY_CONTENT_LENGTH,
+                                WINHTTP_HEADER_NAME_BY_INDEX,
+                                buffer,
+                                &size,
+                                WINHTTP_NO_HEADER_INDEX))
+            info.content_length = std::wcstoull(buffer, nullptr, 10);
+
+        size = sizeof(buffer);
+        if (WinHttpQueryHeaders(request.h,
+                                WINHTTP_QUERY_ACCEPT_RANGES,
+                                WINHTTP_HEADER_NAME_BY_INDEX,
+                                buffer,
+                                &size,
+                                WINHTTP_NO_HEADER_INDEX))
+            info.accepts_ranges = _wcsicmp(buffer, L"bytes") == 0;
+        return info;
+    }
 
-        size_t total_downloaded_size = 0;
+    /// <summary>
+    /// GET of `url` from byte `offset` on, through `length` bytes if given. The response must start at `offset`;
+    /// returns false without passing on any data when the server ignores the range.
+    /// </summary>
+    static bool http_get(const std::string& url,
+                         const uint64_t offset,
+                         const Optional<uint64_t>& length,
+                         const DataCallback& on_data)
+    {
+        std::wstring headers;
+        if (const auto p_length = length.get())
+            headers = Strings::to_utf16(Strings::format("Range: bytes=%llu-%llu",
+                                                        static_cast<unsigned long long>(offset),
+                                                        static_cast<unsigned long long>(offset + *p_length - 1)));
+        else if (offset != 0)
+            headers = Strings::to_utf16(Strings::format("Range: bytes=%llu-", static_cast<unsigned long long>(offset)));
+
+        Transfers::Slot slot(url);
+        WinHttpHandle session, connect, request;
+        const DWORD expected_status = headers.empty() ? 200 : 206;
+        if (winhttp_send(session, connect, request, L"GET", url, headers) != expected_status) return false;
+
+        std::vector<char> buf;
         DWORD dwSize = 0;
         do
         {
             DWORD downloaded_size = 0;
-            bResults = WinHttpQueryDataAvailable(hRequest, &dwSize);
-            Checks::check_exit(VCPKG_LINE_INFO, bResults, "WinHttpQueryDataAvailable() failed: %d", GetLastError());
+            if (!WinHttpQueryDataAvailable(request.h, &dwSize)) return false;
 
             if (buf.size() < dwSize) buf.resize(dwSize * 2);
 
-            bResults = WinHttpReadData(hRequest, (LPVOID)buf.data(), dwSize, &downloaded_size);
-            Checks::check_exit(VCPKG_LINE_INFO, bResults, "WinHttpReadData() failed: %d", GetLastError());
-            fwrite(buf.data(), 1, downloaded_size, f);
-
-            total_downloaded_size += downloaded_size;
+            if (!WinHttpReadData(request.h, (LPVOID)buf.data(), dwSize, &downloaded_size)) return false;
+            slot.throttle(downloaded_size);
+            on_data(std::string_view(buf.data(), downloaded_size));
         } while (dwSize > 0);
 
-        WinHttpCloseHandle(hSession);
-        WinHttpCloseHandle(hConnect);
-        WinHttpCloseHandle(hRequest);
-        fflush(f);
-        fclose(f);
+        return true;
+    }
+#else
+    static UrlInfo info_from_headers(const Http::Response& response)
+    {
+        UrlInfo info;
+        const auto it_length = response.headers.find("content-length");
+        if (it_length != response.headers.end())
+            info.content_length = std::strtoull(it_length->second.c_str(), nullptr, 10);
+        const auto it_ranges = response.headers.find("accept-ranges");
+        info.accepts_ranges =
+            it_ranges != response.headers.end() && Strings::case_insensitive_ascii_contains(it_ranges->second, "bytes");
+        return info;
+    }
+
+    /// <summary>curl_get through the built-in client, which keeps the connection open for the next request.</summary>
+    static bool native_get(const std::string& url,
+                           const uint64_t offset,
+                           const Optional<uint64_t>& length,
+                           const DataCallback& on_data,
+                           const bool show_errors)
+    {
+        Http::Request request;
+        request.url = url;
+        const bool is_range = offset != 0 || length.has_value();
+        if (const auto p_length = length.get())
+        {
+            request.headers.push_back(Strings::format("Range: bytes=%llu-%llu",
+                                                      static_cast<unsigned long long>(offset),
+                                                      static_cast<unsigned long long>(offset + *p_length - 1)));
+        }
+        else if (offset != 0)
+        {
+            request.headers.push_back(Strings::format("Range: bytes=%llu-", static_cast<unsigned long long>(offset)));
+        }
+
+        bool accepted = false;
+        uint64_t received = 0;
+        bool overflowed = false;
+        const auto maybe_response = Http::send(
+            request,
+            [&](const Http::Response& response) {
+                if (is_range)
+                {
+                    // A server ignoring the range sends the file from the start
+                    const auto it_range = response.headers.find("content-range");
+                    const std::string expected_start =
+                        Strings::format("bytes %llu-", static_cast<unsigned long long>(offset));
+                    accepted = response.status == 206 && it_range != response.headers.end() &&
+                               Strings::case_insensitive_ascii_starts_with(it_range->second, expected_start);
+                }
+                else
+                    accepted = response.is_success();
+                return accepted;
+            },
+            [&](std::string_view data) {
+                if (const auto p_length = length.get())
+                {
+                    if (received + data.size() > *p_length)
+                    {
+                        overflowed = true;
+                        return;
+                    }
+                }
+                received += data.size();
+                on_data(data);
+            });
+
+        const auto p_response = maybe_response.get();
+        if (show_errors && !p_response) System::println(System::Color::error, "Error: %s", maybe_response.error());
+        if (show_errors && p_response && !p_response->is_success())
+            System::println(System::Color::error, "Error: %s returned HTTP status %d", url, p_response->status);
+        if (!p_response || !accepted || overflowed) return false;
+        if (const auto p_length = length.get()) return received == *p_length;
+        return true;
+    }
+
+    /// <summary>A request through the built-in client whose response body, if any, is not needed.</summary>
+    static ExpectedT<Http::Response, std::string> native_send(const std::string& method,
+                                                             const std::string& url,
+                                                             const fs::path& upload = {})
+    {
+        Http::Request request;
+        request.method = method;
+        request.url = url;
+        request.upload = upload;
+        return Http::send(request, [](const Http::Response&) { return false; }, [](std::string_view) {});
+    }
+
+    static UrlInfo http_head(const std::string& url)
+    {
+        if (Http::is_supported(url))
+        {
+            const auto maybe_response = native_send("HEAD", url);
+            const auto p_response = maybe_response.get();
+            return p_response && p_response->is_success() ? info_from_headers(*p_response) : UrlInfo();
+        }
+
+        UrlInfo info;
+        Transfers::Slot slot(url);
+        const auto output = System::process_execute_and_capture_output(
+            "curl", {"--head", "--location", "--silent", "--show-error", "--fail", url});
+        if (output.exit_code != 0) return info;
+
+        // After redirects the headers of every response are there; the last ones describe the file
+        for (auto&& line : Strings::split(output.output, "\n"))
+        {
+            if (Strings::case_insensitive_ascii_starts_with(line, "HTTP/"))
+                info = UrlInfo();
+            else if (Strings::case_insensitive_ascii_starts_with(line, "content-length:"))
+                info.content_length = std::strtoull(line.c_str() + 15, nullptr, 10);
+            else if (Strings::case_insensitive_ascii_starts_with(line, "accept-ranges:"))
+                info.accepts_ranges = Strings::case_insensitive_ascii_contains(line, "bytes");
+        }
+        return info;
+    }
+
+    static bool http_get(const std::string& url,
+                         const uint64_t offset,
+                         const Optional<uint64_t>& length,
+                         const DataCallback& on_data)
+    {
+        if (Http::is_supported(url)) return native_get(url, offset, length, on_data, true);
+        return curl_get(url, offset, length, on_data, true);
     }
 #endif
 
-    void verify_downloaded_file_hash(const Files::Filesystem& fs,
-                                     const std::string& url,
-                                     const fs::path& path,
-                                     const std::string& sha512)
+    /// <summary>
+    /// GET of `url` without the error output of a failed transfer, for callers that try several locations. Goes
+    /// through the built-in client where there is one.
+    /// </summary>
+    static bool quiet_get(const std::string& url, const DataCallback& on_data)
     {
-        std::string actual_hash = vcpkg::Hash::get_file_hash(fs, path, "SHA512");
+#if !defined(_WIN32)
+        if (Http::is_supported(url)) return native_get(url, 0, nullopt, on_data, false);
+#endif
+        return curl_get(url, 0, nullopt, on_data, false);
+    }
 
+    static std::string with_known_hash_changes(std::string actual_hash)
+    {
         // <HACK to handle NuGet.org changing nupkg hashes.>
         // This is the NEW hash for 7zip
         if (actual_hash == "a9dfaaafd15d98a2ac83682867ec5766720acf6e99d40d1a00d480692752603bf3f3742623f0ea85647a92374df"
@@ -134,7 +398,14 @@ namespace vcpkg::Downloads
             actual_hash = "8c75314102e68d2b2347d592f8e3eb05812e1ebb525decbac472231633753f1d4ca31c8e6881a36144a8da26b257"
                           "1305b3ae3f4e2b85fc4a290aeda63d1a13b8";
         // </HACK>
+        return actual_hash;
+    }
 
+    static void check_hash(const std::string& url,
+                           const fs::path& path,
+                           const std::string& sha512,
+                           const std::string& actual_hash)
+    {
         Checks::check_exit(VCPKG_LINE_INFO,
                            sha512 == actual_hash,
                            "File does not have the expected hash:\n"
@@ -148,29 +419,153 @@ namespace vcpkg::Downloads
                            actual_hash);
     }
 
+    void verify_downloaded_file_hash(const Files::Filesystem& fs,
+                                     const std::string& url,
+                                     const fs::path& path,
+                                     const std::string& sha512)
+    {
+        check_hash(url, path, sha512, with_known_hash_changes(vcpkg::Hash::get_file_hash(fs, path, "SHA512")));
+    }
+
+    /// <summary>Adds `size` bytes of `path`, starting at `offset`, to hasher.</summary>
+    static bool hash_file_range(Hash::Hasher& hasher, const fs::path& path, const uint64_t offset, uint64_t size)
+    {
+        std::ifstream in(path.native().c_str(), std::ios::binary);
+        if (!in.seekg(static_cast<std::streamoff>(offset))) return false;
+
+        std::vector<char> buffer(1024 * 1024);
+        while (size > 0)
+        {
+            const auto chunk = static_cast<std::streamsize>(std::min<uint64_t>(size, buffer.size()));
+            if (!in.read(buffer.data(), chunk)) return false;
+            hasher.add_bytes(buffer.data(), static_cast<size_t>(chunk));
+            size -= static_cast<uint64_t>(chunk);
+        }
+        return true;
+    }
+
+    /// <summary>Files at least this large are downloaded over several connections when the server allows it.</summary>
+    static constexpr uint64_t SEGMENTED_DOWNLOAD_MIN_SIZE = 32 * 1024 * 1024;
+    static constexpr size_t SEGMENTED_DOWNLOAD_CONNECTIONS = 4;
+
+    /// <summary>
+    /// Downloads the `size` bytes of `url` into `part_path` as several ranges at once. The first range is hashed as
+    /// it arrives; the others are read back afterwards, since the hash has to see the bytes in order.
+    /// </summary>
+    static bool segmented_download(const std::string& url,
+                                   const fs::path& part_path,
+                                   const uint64_t size,
+                                   Hash::Hasher& hasher)
+    {
+        {
+            std::ofstream create(part_path.native().c_str(), std::ios::binary | std::ios::trunc);
+            if (!create) return false;
+        }
+        std::error_code ec;
+        fs::stdfs::resize_file(part_path, size, ec);
+        if (ec) return false;
+
+        const uint64_t segment_size = (size + SEGMENTED_DOWNLOAD_CONNECTIONS - 1) / SEGMENTED_DOWNLOAD_CONNECTIONS;
+        std::vector<uint64_t> offsets;
+        for (uint64_t offset = 0; offset < size; offset += segment_size)
+            offsets.push_back(offset);
+
+        std::vector<char> succeeded(offsets.size(), 0);
+        const int64_t priority = Transfers::current_priority();
+        ThreadPool::parallel_for(offsets.size(), [&](size_t i) {
+            Transfers::PriorityScope transfer_priority(priority);
+            const uint64_t length = std::min(segment_size, size - offsets[i]);
+            std::fstream out(part_path.native().c_str(), std::ios::in | std::ios::out | std::ios::binary);
+            if (!out.seekp(static_cast<std::streamoff>(offsets[i]))) return;
+
+            succeeded[i] = http_get(url, offsets[i], length, [&](std::string_view data) {
+                out.write(data.data(), static_cast<std::streamsize>(data.size()));
+                if (i == 0) hasher.add_bytes(data.data(), data.size());
+            });
+            out.flush();
+            if (!out) succeeded[i] = 0;
+        });
+
+        if (std::find(succeeded.begin(), succeeded.end(), 0) != succeeded.end()) return false;
+        return hash_file_range(hasher, part_path, segment_size, size - std::min(segment_size, size));
+    }
+
     void download_file(vcpkg::Files::Filesystem& fs,
                        const std::string& url,
                        const fs::path& download_path,
                        const std::string& sha512)
     {
-        const std::string download_path_part = download_path.u8string() + ".part";
+        Trace::Scope trace("download", download_path.filename().u8string());
+
+        // A .part file left by an interrupted download is resumed where it stopped instead of being started over
+        const fs::path download_path_part = download_path.u8string() + ".part";
         std::error_code ec;
         fs.remove(download_path, ec);
-        fs.remove(download_path_part, ec);
-#if defined(_WIN32)
-        auto url_no_proto = url.substr(8); // drop https://
-        auto path_begin = Util::find(url_no_proto, '/');
-        std::string hostname(url_no_proto.begin(), path_begin);
-        std::string path(path_begin, url_no_proto.end());
+        fs.create_directories(download_path.parent_path(), ec);
+        Checks::check_exit(
+            VCPKG_LINE_INFO, !ec, "Could not create directories %s", download_path.parent_path().u8string());
 
-        winhttp_download_file(fs, download_path_part.c_str(), hostname, path);
-#else
-        const auto code = System::cmd_execute(
-            Strings::format(R"(curl -L '%s' --create-dirs --output '%s')", url, download_path_part));
-        Checks::check_exit(VCPKG_LINE_INFO, code == 0, "Could not download %s", url);
-#endif
+        if (try_download_from_asset_sources(fs, sha512, download_path)) return;
+
+        const auto hasher = Hash::get_hasher_for(Hash::Algorithm::SHA512);
+        bool downloaded = false;
+
+        const uint64_t existing_size = fs.exists(download_path_part) ? fs::stdfs::file_size(download_path_part, ec) : 0;
+        if (!ec && existing_size > 0 && hash_file_range(*hasher, download_path_part, 0, existing_size))
+        {
+            System::println(
+                "Resuming download of %s at %llu bytes", url, static_cast<unsigned long long>(existing_size));
+            std::ofstream out(download_path_part.native().c_str(), std::ios::binary | std::ios::app);
+            bool received_data = false;
+            downloaded = http_get(url, existing_size, nullopt, [&](std::string_view data) {
+                out.write(data.data(), static_cast<std::streamsize>(data.size()));
+                hasher->add_bytes(data.data(), data.size());
+                received_data = true;
+            });
+            out.flush();
+            downloaded = downloaded && static_cast<bool>(out);
+
+            // Interrupted again: keep what arrived for the next attempt. Only a server refusing to resume means
+            // starting over.
+            Checks::check_exit(VCPKG_LINE_INFO, downloaded || !received_data, "Could not download %s", url);
+        }
+
+        if (!downloaded)
+        {
+            hasher->clear();
+            const UrlInfo info = http_head(url);
+            const auto p_length = info.content_length.get();
+            if (info.accepts_ranges && p_length && *p_length >= SEGMENTED_DOWNLOAD_MIN_SIZE)
+            {
+                downloaded = segmented_download(url, download_path_part, *p_length, *hasher);
+                if (!downloaded) hasher->clear();
+            }
+        }
+
+        if (!downloaded)
+        {
+            std::ofstream out(download_path_part.native().c_str(), std::ios::binary | std::ios::trunc);
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               static_cast<bool>(out),
+                               "Could not download %s. Failed to open file %s",
+                               url,
+                               download_path_part.u8string());
+            downloaded = http_get(url, 0, nullopt, [&](std::string_view data) {
+                out.write(data.data(), static_cast<std::streamsize>(data.size()));
+                hasher->add_bytes(data.data(), data.size());
+            });
+            out.flush();
+            Checks::check_exit(VCPKG_LINE_INFO, downloaded && static_cast<bool>(out), "Could not download %s", url);
+        }
+
+        const std::string actual_hash = with_known_hash_changes(hasher->get_hash());
+        if (actual_hash != sha512)
+        {
+            // Resuming from corrupt data would fail the same way again
+            fs.remove(download_path_part, ec);
+        }
+        check_hash(url, download_path_part, sha512, actual_hash);
 
-        verify_downloaded_file_hash(fs, url, download_path_part, sha512);
         fs.rename(download_path_part, download_path, ec);
         Checks::check_exit(VCPKG_LINE_INFO,
                            !ec,
@@ -179,5 +574,290 @@ namespace vcpkg::Downloads
                            download_path_part,
                            download_path.u8string(),
                            ec.message());
+
+        store_in_asset_sources(fs, sha512, download_path);
+    }
+
+    /// <summary>GET of `url` into `path`, hashing the data as it arrives if there is a `hasher`.</summary>
+    static bool get_to_file(const std::string& url, const fs::path& path, Hash::Hasher* hasher)
+    {
+        std::ofstream out(path.native().c_str(), std::ios::binary | std::ios::trunc);
+        const auto on_data = [&](std::string_view data) {
+            out.write(data.data(), static_cast<std::streamsize>(data.size()));
+            if (hasher) hasher->add_bytes(data.data(), data.size());
+        };
+        const bool downloaded = static_cast<bool>(out) && quiet_get(url, on_data);
+        out.flush();
+        return downloaded && static_cast<bool>(out);
+    }
+
+    // Transfers the built-in client does not handle go through curl; it ships with Windows 10 1803+
+    static std::string make_curl_cmd(const std::string& arguments, const std::string& url)
+    {
+#if defined(_WIN32)
+        return Strings::format(R"(curl --fail --silent --show-error --location %s "%s")", arguments, url);
+#else
+        return Strings::format(R"(curl --fail --silent --show-error --location %s '%s')", arguments, url);
+#endif
+    }
+
+    static std::string quote_path(const fs::path& path)
+    {
+#if defined(_WIN32)
+        return Strings::format(R"("%s")", path.u8string());
+#else
+        return Strings::format(R"('%s')", path.u8string());
+#endif
+    }
+
+    bool try_download_file(Files::Filesystem& fs, const std::string& url, const fs::path& download_path)
+    {
+        const fs::path download_path_part = download_path.u8string() + ".part";
+        std::error_code ec;
+        fs.remove(download_path_part, ec);
+        fs.create_directories(download_path.parent_path(), ec);
+
+#if !defined(_WIN32)
+        if (Http::is_supported(url))
+        {
+            if (!get_to_file(url, download_path_part, nullptr))
+            {
+                fs.remove(download_path_part, ec);
+                return false;
+            }
+            fs.rename(download_path_part, download_path, ec);
+            return !ec;
+        }
+#endif
+
+        // A missing file is an expected outcome, so curl's error output is not shown
+        Transfers::Slot slot(url);
+        const auto output = System::cmd_execute_and_capture_output(
+            make_curl_cmd("--output " + quote_path(download_path_part), url) + " 2>&1");
+        if (output.exit_code != 0)
+        {
+            fs.remove(download_path_part, ec);
+            return false;
+        }
+
+        fs.rename(download_path_part, download_path, ec);
+        return !ec;
+    }
+
+    bool try_download_file(Files::Filesystem& fs,
+                           const std::string& url,
+                           const fs::path& download_path,
+                           const Hash::Algorithm algorithm,
+                           const std::string& expected_hash)
+    {
+        const fs::path download_path_part = download_path.u8string() + ".part";
+        std::error_code ec;
+        fs.create_directories(download_path.parent_path(), ec);
+
+        const auto hasher = Hash::get_hasher_for(algorithm);
+        if (!get_to_file(url, download_path_part, hasher.get()) || hasher->get_hash() != expected_hash)
+        {
+            fs.remove(download_path_part, ec);
+            return false;
+        }
+
+        fs.rename(download_path_part, download_path, ec);
+        return !ec;
+    }
+
+    bool url_exists(const std::string& url)
+    {
+#if !defined(_WIN32)
+        if (Http::is_supported(url))
+        {
+            const auto maybe_response = native_send("HEAD", url);
+            const auto p_response = maybe_response.get();
+            return p_response && p_response->is_success();
+        }
+#endif
+
+        Transfers::Slot slot(url);
+#if defined(_WIN32)
+        const auto output = System::cmd_execute_and_capture_output(make_curl_cmd("--head --output NUL", url) + " 2>&1");
+#else
+        const auto output =
+            System::cmd_execute_and_capture_output(make_curl_cmd("--head --output /dev/null", url) + " 2>&1");
+#endif
+        return output.exit_code == 0;
+    }
+
+    bool upload_file(const std::string& url, const fs::path& file_path)
+    {
+#if !defined(_WIN32)
+        if (Http::is_supported(url))
+        {
+            const auto maybe_response = native_send("PUT", url, file_path);
+            const auto p_response = maybe_response.get();
+            if (!p_response)
+                System::println(System::Color::error, "Error: %s", maybe_response.error());
+            else if (!p_response->is_success())
+                System::println(System::Color::error, "Error: %s returned HTTP status %d", url, p_response->status);
+            return p_response && p_response->is_success();
+        }
+#endif
+
+        // curl reads the file itself, so only the number of transfers is limited here
+        Transfers::Slot slot(url);
+        return System::cmd_execute(make_curl_cmd("--upload-file " + quote_path(file_path), url)) == 0;
+    }
+
+    std::vector<AssetSource> parse_asset_sources(const std::string& text)
+    {
+        std::vector<AssetSource> ret;
+        for (auto&& entry : Strings::split(text, ";"))
+        {
+            if (entry.empty()) continue;
+
+            AssetSource source;
+            source.location = entry;
+            const auto comma = entry.rfind(',');
+            if (comma != std::string::npos && Strings::ascii_to_lowercase(entry.substr(comma + 1)) == "readwrite")
+            {
+                source.location = entry.substr(0, comma);
+                source.writable = true;
+            }
+
+            source.is_url = Strings::case_insensitive_ascii_starts_with(source.location, "http://") ||
+                            Strings::case_insensitive_ascii_starts_with(source.location, "https://");
+            if (source.is_url)
+            {
+                while (Strings::ends_with(source.location, "/"))
+                    source.location.pop_back();
+            }
+            ret.push_back(std::move(source));
+        }
+        return ret;
+    }
+
+    const std::vector<AssetSource>& asset_sources()
+    {
+        static const std::vector<AssetSource> SOURCES = []() {
+            const auto maybe_text = System::get_environment_variable("VCPKG_ASSET_SOURCES");
+            if (const auto p_text = maybe_text.get()) return parse_asset_sources(*p_text);
+            return std::vector<AssetSource>{};
+        }();
+        return SOURCES;
+    }
+
+    static fs::path g_download_index;
+
+    void enable_download_index(const fs::path& index_dir) { g_download_index = index_dir; }
+
+    const fs::path& download_index() { return g_download_index; }
+
+    /// <summary>A name next to `destination` that no other writer uses, for publishing it with a rename.</summary>
+    static fs::path temp_path_for(const fs::path& destination)
+    {
+        static std::atomic<uint64_t> counter{0};
+        static const uint64_t process_nonce = std::random_device{}();
+        return destination.u8string() + Strings::format(".%llx-%llx.tmp",
+                                                        static_cast<unsigned long long>(process_nonce),
+                                                        static_cast<unsigned long long>(counter++));
+    }
+
+    void add_to_download_index(Files::Filesystem& fs, const std::string& sha512, const fs::path& file)
+    {
+        if (g_download_index.empty()) return;
+
+        const fs::path destination = g_download_index / fs::u8path(Strings::ascii_to_lowercase(std::string(sha512)));
+        if (fs.exists(destination)) return;
+
+        const fs::path tmp_destination = temp_path_for(destination);
+        std::error_code ec;
+        fs.create_directories(g_download_index, ec);
+        fs.create_hard_link(file, tmp_destination, ec);
+        if (!ec) fs.rename(tmp_destination, destination, ec);
+        if (ec) fs.remove(tmp_destination, ec);
+    }
+
+    bool try_download_from_asset_sources(Files::Filesystem& fs,
+                                         const std::string& sha512,
+                                         const fs::path& download_path)
+    {
+        const std::string key = Strings::ascii_to_lowercase(std::string(sha512));
+        // Not the .part of the download itself, which is kept to resume it from the upstream URLs
+        const fs::path download_path_asset = download_path.u8string() + ".asset.part";
+
+        std::vector<AssetSource> sources;
+        if (!g_download_index.empty()) sources.push_back({g_download_index.u8string(), false, false});
+        sources.insert(sources.end(), asset_sources().begin(), asset_sources().end());
+
+        const auto hasher = Hash::get_hasher_for(Hash::Algorithm::SHA512);
+        std::error_code ec;
+        for (auto&& source : sources)
+        {
+            fs.create_directories(download_path.parent_path(), ec);
+
+            // A source holding something else under this name is skipped, not trusted
+            bool fetched;
+            if (source.is_url)
+            {
+                hasher->clear();
+                fetched = get_to_file(source.location + "/" + key, download_path_asset, hasher.get()) &&
+                          with_known_hash_changes(hasher->get_hash()) == key;
+            }
+            else
+            {
+                // Checked in place, where the hash cache spares reading a file it has seen before
+                const fs::path source_path = fs::u8path(source.location) / fs::u8path(key);
+                if (!fs.exists(source_path) ||
+                    with_known_hash_changes(Hash::get_file_hash(fs, source_path, "SHA512")) != key)
+                    continue;
+                fs.remove(download_path_asset, ec);
+                fs.create_hard_link(source_path, download_path_asset, ec);
+                if (ec) fs.copy_file(source_path, download_path_asset, fs::copy_options::overwrite_existing, ec);
+                fetched = !ec;
+            }
+
+            if (fetched)
+            {
+                fs.rename(download_path_asset, download_path, ec);
+                if (!ec)
+                {
+                    add_to_download_index(fs, key, download_path);
+                    return true;
+                }
+            }
+            fs.remove(download_path_asset, ec);
+        }
+        return false;
+    }
+
+    void store_in_asset_sources(Files::Filesystem& fs, const std::string& sha512, const fs::path& file)
+    {
+        add_to_download_index(fs, sha512, file);
+
+        const std::string key = Strings::ascii_to_lowercase(std::string(sha512));
+        for (auto&& source : asset_sources())
+        {
+            if (!source.writable) continue;
+
+            if (source.is_url)
+            {
+                const std::string url = source.location + "/" + key;
+                if (!upload_file(url, file)) System::println(System::Color::warning, "Failed to upload %s", url);
+                continue;
+            }
+
+            // Linked or copied under a temporary name first so that other clients never see a partial file
+            const fs::path destination = fs::u8path(source.location) / fs::u8path(key);
+            if (fs.exists(destination)) continue;
+            const fs::path tmp_destination = temp_path_for(destination);
+            std::error_code ec;
+            fs.create_directories(destination.parent_path(), ec);
+            fs.create_hard_link(file, tmp_destination, ec);
+            if (ec) fs.copy_file(file, tmp_destination, fs::copy_options::overwrite_existing, ec);
+            if (!ec) fs.rename(tmp_destination, destination, ec);
+            if (ec)
+            {
+                fs.remove(tmp_destination, ec);
+                System::println(System::Color::warning, "Failed to store %s", destination.u8string());
+            }
+        }
     }
 }
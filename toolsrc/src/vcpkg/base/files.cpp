@@ -2,19 +2,37 @@
 
 #include <vcpkg/base/files.h>
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/trace.h>
 #include <vcpkg/base/util.h>
 
 #if defined(__linux__)
 #include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
 #include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
 #endif
 
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(__APPLE__)
+#include <copyfile.h>
+#include <sys/clonefile.h>
+#endif
+
 namespace vcpkg::Files
 {
-    static const std::regex FILESYSTEM_INVALID_CHARACTERS_REGEX = std::regex(R"([\/:*?"<>|])");
+    static constexpr Strings::AsciiSet FILESYSTEM_INVALID_CHARACTER_SET = FILESYSTEM_INVALID_CHARACTERS;
 
     void Filesystem::write_contents(const fs::path& file_path, const std::string& data)
     {
@@ -24,6 +42,529 @@ namespace vcpkg::Files
             VCPKG_LINE_INFO, !ec, "error while writing file: %s: %s", file_path.u8string(), ec.message());
     }
 
+    struct MappedString final : MappedFile
+    {
+        explicit MappedString(std::string&& text) : m_text(std::move(text)) {}
+
+        virtual std::string_view contents() const override { return m_text; }
+
+    private:
+        std::string m_text;
+    };
+
+    std::unique_ptr<MappedFile> make_mapped_string(std::string&& text)
+    {
+        return std::make_unique<MappedString>(std::move(text));
+    }
+
+    struct BufferedOutputFile final : OutputFile
+    {
+        static constexpr size_t BUFFER_SIZE = 256 * 1024;
+
+        explicit BufferedOutputFile(FILE* f) : m_file(f) { setvbuf(m_file, nullptr, _IOFBF, BUFFER_SIZE); }
+        BufferedOutputFile(const BufferedOutputFile&) = delete;
+        BufferedOutputFile& operator=(const BufferedOutputFile&) = delete;
+        ~BufferedOutputFile()
+        {
+            if (m_file) fclose(m_file);
+        }
+
+        virtual void write(std::string_view data) override
+        {
+            if (!m_file || m_failed) return;
+            if (fwrite(data.data(), sizeof(data[0]), data.size(), m_file) != data.size()) m_failed = true;
+        }
+
+        virtual void flush() override
+        {
+            if (!m_file || m_failed) return;
+            if (fflush(m_file) != 0) m_failed = true;
+        }
+
+        virtual void close(std::error_code& ec) override
+        {
+            ec.clear();
+            if (!m_file) return;
+            if (fclose(m_file) != 0) m_failed = true;
+            m_file = nullptr;
+            if (m_failed) ec = std::make_error_code(std::errc::no_space_on_device);
+        }
+
+    private:
+        FILE* m_file;
+        bool m_failed = false;
+    };
+
+#if defined(_WIN32)
+    struct LockedFile final : FileLock
+    {
+        explicit LockedFile(HANDLE handle) : m_handle(handle) {}
+        LockedFile(const LockedFile&) = delete;
+        LockedFile& operator=(const LockedFile&) = delete;
+        ~LockedFile() { CloseHandle(m_handle); }
+
+    private:
+        HANDLE m_handle;
+    };
+#else
+    struct LockedFile final : FileLock
+    {
+        explicit LockedFile(int fd) : m_fd(fd) {}
+        LockedFile(const LockedFile&) = delete;
+        LockedFile& operator=(const LockedFile&) = delete;
+        ~LockedFile() { close(m_fd); }
+
+    private:
+        int m_fd;
+    };
+#endif
+
+    /// <summary>
+    /// Files below this size are read into a buffer with a single read; setting up a mapping costs more than the copy.
+    /// </summary>
+    static constexpr uintmax_t MIN_MAPPED_FILE_SIZE = 64 * 1024;
+
+#if defined(_WIN32)
+    struct MappedView final : MappedFile
+    {
+        MappedView(HANDLE mapping, const char* view, size_t size) : m_mapping(mapping), m_view(view), m_size(size) {}
+        MappedView(const MappedView&) = delete;
+        MappedView& operator=(const MappedView&) = delete;
+        ~MappedView()
+        {
+            UnmapViewOfFile(m_view);
+            CloseHandle(m_mapping);
+        }
+
+        virtual std::string_view contents() const override { return {m_view, m_size}; }
+
+    private:
+        HANDLE m_mapping;
+        const char* m_view;
+        size_t m_size;
+    };
+
+    static Expected<std::unique_ptr<MappedFile>> map_file(const fs::path& file_path)
+    {
+        const HANDLE file = CreateFileW(file_path.c_str(),
+                                        GENERIC_READ,
+                                        FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                        nullptr,
+                                        OPEN_EXISTING,
+                                        FILE_FLAG_SEQUENTIAL_SCAN,
+                                        nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return std::make_error_code(std::errc::no_such_file_or_directory);
+        }
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size))
+        {
+            CloseHandle(file);
+            return std::make_error_code(std::errc::io_error);
+        }
+        const auto size = static_cast<size_t>(file_size.QuadPart);
+
+        if (static_cast<uintmax_t>(size) < MIN_MAPPED_FILE_SIZE)
+        {
+            std::string buffer(size, '\0');
+            DWORD bytes_read = 0;
+            const bool ok = size == 0 || (ReadFile(file, &buffer[0], static_cast<DWORD>(size), &bytes_read, nullptr) &&
+                                          bytes_read == size);
+            CloseHandle(file);
+            if (!ok) return std::make_error_code(std::errc::io_error);
+            return make_mapped_string(std::move(buffer));
+        }
+
+        const HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (mapping == nullptr)
+        {
+            return std::make_error_code(std::errc::io_error);
+        }
+
+        const auto view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (view == nullptr)
+        {
+            CloseHandle(mapping);
+            return std::make_error_code(std::errc::io_error);
+        }
+
+        return std::unique_ptr<MappedFile>(std::make_unique<MappedView>(mapping, view, size));
+    }
+#else
+    struct MappedView final : MappedFile
+    {
+        MappedView(void* view, size_t size) : m_view(view), m_size(size) {}
+        MappedView(const MappedView&) = delete;
+        MappedView& operator=(const MappedView&) = delete;
+        ~MappedView() { munmap(m_view, m_size); }
+
+        virtual std::string_view contents() const override { return {static_cast<const char*>(m_view), m_size}; }
+
+    private:
+        void* m_view;
+        size_t m_size;
+    };
+
+    static Expected<std::unique_ptr<MappedFile>> map_file(const fs::path& file_path)
+    {
+        const int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            return std::make_error_code(std::errc::no_such_file_or_directory);
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+        {
+            close(fd);
+            return std::make_error_code(std::errc::io_error);
+        }
+        const auto size = static_cast<size_t>(info.st_size);
+
+        if (static_cast<uintmax_t>(size) < MIN_MAPPED_FILE_SIZE)
+        {
+            std::string buffer(size, '\0');
+            size_t total = 0;
+            while (total < size)
+            {
+                const auto actual = read(fd, &buffer[total], size - total);
+                if (actual <= 0) break;
+                total += static_cast<size_t>(actual);
+            }
+            close(fd);
+            if (total != size) return std::make_error_code(std::errc::io_error);
+            return make_mapped_string(std::move(buffer));
+        }
+
+        void* const view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (view == MAP_FAILED)
+        {
+            return std::make_error_code(std::errc::io_error);
+        }
+
+        return std::unique_ptr<MappedFile>(std::make_unique<MappedView>(view, size));
+    }
+#endif
+
+#if defined(_WIN32)
+    /// <summary>
+    /// Lists dir with FindFirstFileExW, whose results already carry the attributes, size and write time of each entry.
+    /// Large fetches return many entries per call.
+    /// </summary>
+    static void list_directory(const fs::path& dir, std::vector<DirectoryEntry>& out)
+    {
+        // FILETIME counts 100ns ticks from 1601; file_time_type is a system_clock time, which counts from 1970
+        static constexpr uint64_t FILETIME_TICKS_TO_UNIX_EPOCH = 116444736000000000;
+        using FileTimeTicks = std::chrono::duration<int64_t, std::ratio<1, 10000000>>;
+
+        WIN32_FIND_DATAW data;
+        const HANDLE find = FindFirstFileExW(
+            (dir / L"*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+        if (find == INVALID_HANDLE_VALUE) return;
+
+        do
+        {
+            const std::wstring_view name = data.cFileName;
+            if (name == L"." || name == L"..") continue;
+
+            DirectoryEntry entry;
+            entry.path = dir / data.cFileName;
+            const bool is_link = (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0 &&
+                                 (data.dwReserved0 == IO_REPARSE_TAG_SYMLINK ||
+                                  data.dwReserved0 == IO_REPARSE_TAG_MOUNT_POINT);
+            if (is_link)
+                entry.type = fs::file_type::symlink;
+            else if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+                entry.type = fs::file_type::directory;
+            else
+                entry.type = fs::file_type::regular;
+            entry.size = entry.type == fs::file_type::regular
+                             ? (static_cast<uintmax_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow
+                             : 0;
+            const uint64_t ticks = (static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) |
+                                   data.ftLastWriteTime.dwLowDateTime;
+            const auto since_epoch = FileTimeTicks(static_cast<int64_t>(ticks - FILETIME_TICKS_TO_UNIX_EPOCH));
+            entry.last_write_time = fs::stdfs::file_time_type(
+                std::chrono::duration_cast<fs::stdfs::file_time_type::duration>(since_epoch));
+
+            out.push_back(std::move(entry));
+        } while (FindNextFileW(find, &data));
+
+        FindClose(find);
+    }
+#else
+    /// <summary>
+    /// Lists dir with one fstatat per entry, relative to the open directory, for the type, size and write time at
+    /// once.
+    /// </summary>
+    static void list_directory(const fs::path& dir, std::vector<DirectoryEntry>& out)
+    {
+        DIR* const handle = opendir(dir.c_str());
+        if (handle == nullptr) return;
+
+        while (const dirent* const ent = readdir(handle))
+        {
+            if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+
+            DirectoryEntry entry;
+            entry.path = dir / ent->d_name;
+            entry.type = fs::file_type::none;
+            entry.size = 0;
+
+            struct stat info;
+            if (fstatat(dirfd(handle), ent->d_name, &info, AT_SYMLINK_NOFOLLOW) == 0)
+            {
+                if (S_ISREG(info.st_mode))
+                {
+                    entry.type = fs::file_type::regular;
+                    entry.size = static_cast<uintmax_t>(info.st_size);
+                }
+                else if (S_ISDIR(info.st_mode))
+                    entry.type = fs::file_type::directory;
+                else if (S_ISLNK(info.st_mode))
+                    entry.type = fs::file_type::symlink;
+                else
+                    entry.type = fs::file_type::unknown;
+#if defined(__APPLE__)
+                const timespec& mtime = info.st_mtimespec;
+#else
+                const timespec& mtime = info.st_mtim;
+#endif
+                entry.last_write_time = fs::stdfs::file_time_type(
+                    std::chrono::duration_cast<fs::stdfs::file_time_type::duration>(
+                        std::chrono::seconds(mtime.tv_sec) + std::chrono::nanoseconds(mtime.tv_nsec)));
+            }
+
+            out.push_back(std::move(entry));
+        }
+
+        closedir(handle);
+    }
+#endif
+
+    /// <summary>
+    /// Lists everything below root on several threads, since walking a large tree on a network share is bound by the
+    /// latency of each listing. Every directory is one task in a shared queue; each thread takes the most recently
+    /// found directory, and adds the subdirectories it finds for any idle thread to take. The listings are joined in
+    /// the order of a sequential walk, so each directory comes before its contents.
+    /// </summary>
+    static std::vector<DirectoryEntry> walk_directory_tree(const fs::path& root)
+    {
+        static constexpr size_t MAX_WALK_THREADS = 16;
+
+        struct Listing
+        {
+            fs::path dir;
+            std::vector<DirectoryEntry> entries;
+            /// <summary>For each entry that is a directory, in order, the index of its listing</summary>
+            std::vector<size_t> subdirectories;
+        };
+
+        // A deque, so that listings stay in place while others are added
+        std::deque<Listing> listings(1);
+        listings[0].dir = root;
+        list_directory(root, listings[0].entries);
+
+        std::mutex mutex;
+        std::condition_variable work_available;
+        std::vector<size_t> queue;
+        size_t busy = 0;
+
+        const auto add_subdirectories = [&](Listing& listing) {
+            for (auto&& entry : listing.entries)
+            {
+                if (entry.type != fs::file_type::directory) continue;
+                listing.subdirectories.push_back(listings.size());
+                queue.push_back(listings.size());
+                listings.emplace_back();
+                listings.back().dir = entry.path;
+            }
+        };
+        add_subdirectories(listings[0]);
+
+        // A tree without subdirectories is not worth starting threads for
+        if (!queue.empty())
+        {
+            auto work = [&]() {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (true)
+                {
+                    work_available.wait(lock, [&] { return !queue.empty() || busy == 0; });
+                    if (queue.empty()) return;
+
+                    Listing& listing = listings[queue.back()];
+                    queue.pop_back();
+                    ++busy;
+                    lock.unlock();
+
+                    list_directory(listing.dir, listing.entries);
+
+                    lock.lock();
+                    --busy;
+                    add_subdirectories(listing);
+                    // Wakes the others for the new directories, or to finish when there are none left anywhere
+                    work_available.notify_all();
+                }
+            };
+
+            std::vector<std::thread> threads;
+            for (size_t i = 1; i < MAX_WALK_THREADS; ++i)
+            {
+                threads.emplace_back(work);
+            }
+            work();
+            for (auto&& thread : threads)
+            {
+                thread.join();
+            }
+        }
+
+        std::vector<DirectoryEntry> ret;
+        const auto append = [&](const size_t index, const auto& append_ref) -> void {
+            Listing& listing = listings[index];
+            auto subdirectory = listing.subdirectories.begin();
+            for (auto&& entry : listing.entries)
+            {
+                const bool is_directory = entry.type == fs::file_type::directory;
+                ret.push_back(std::move(entry));
+                if (is_directory) append_ref(*subdirectory++, append_ref);
+            }
+        };
+        append(0, append);
+        return ret;
+    }
+
+    /// <summary>
+    /// Copies the contents and permissions of a regular file, letting the kernel move the data: copy_file_range on
+    /// Linux, which also clones on btrfs and XFS and copies on the server for NFS and SMB, or sendfile where that is
+    /// missing; copyfile on macOS, which clones on APFS; CopyFile2 on Windows, without buffering for large files.
+    /// Where newpath exists, it is replaced if `overwrite` is set and an error otherwise.
+    /// </summary>
+    static void copy_regular_file(const fs::path& oldpath, const fs::path& newpath, bool overwrite, std::error_code& ec)
+    {
+        ec.clear();
+#if defined(_WIN32)
+        // Unbuffered copies skip the system cache, which only gets in the way once files reach this size
+        static constexpr uintmax_t UNBUFFERED_SIZE = 256 * 1024 * 1024;
+
+        COPYFILE2_EXTENDED_PARAMETERS parameters = {0};
+        parameters.dwSize = sizeof(parameters);
+        if (!overwrite) parameters.dwCopyFlags |= COPY_FILE_FAIL_IF_EXISTS;
+        std::error_code size_ec;
+        if (fs::stdfs::file_size(oldpath, size_ec) >= UNBUFFERED_SIZE && !size_ec)
+        {
+            parameters.dwCopyFlags |= COPY_FILE_NO_BUFFERING;
+        }
+
+        const HRESULT hr = CopyFile2(oldpath.native().c_str(), newpath.native().c_str(), &parameters);
+        if (FAILED(hr)) ec.assign(HRESULT_CODE(hr), std::system_category());
+#elif defined(__APPLE__)
+        struct stat old_info;
+        struct stat new_info;
+        if (stat(oldpath.c_str(), &old_info) != 0)
+        {
+            ec.assign(errno, std::generic_category());
+            return;
+        }
+        if (stat(newpath.c_str(), &new_info) == 0)
+        {
+            if (!overwrite || (old_info.st_dev == new_info.st_dev && old_info.st_ino == new_info.st_ino))
+            {
+                ec = std::make_error_code(std::errc::file_exists);
+                return;
+            }
+
+            // A clone needs a new file, so the old one is unlinked, leaving any hard links to it untouched
+            unlink(newpath.c_str());
+        }
+
+        if (copyfile(oldpath.c_str(), newpath.c_str(), nullptr, COPYFILE_CLONE) != 0)
+        {
+            ec.assign(errno, std::generic_category());
+        }
+#elif defined(__linux__)
+        const int i_fd = open(oldpath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (i_fd == -1)
+        {
+            ec.assign(errno, std::generic_category());
+            return;
+        }
+
+        struct stat old_info;
+        struct stat new_info;
+        int o_fd = -1;
+        if (fstat(i_fd, &old_info) == 0)
+        {
+            o_fd = open(newpath.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (overwrite ? 0 : O_EXCL), old_info.st_mode);
+        }
+        if (o_fd == -1)
+        {
+            ec.assign(errno, std::generic_category());
+            close(i_fd);
+            return;
+        }
+
+        // The target is only truncated once it is known not to be the source itself
+        if (fstat(o_fd, &new_info) != 0 || ftruncate(o_fd, 0) != 0)
+            ec.assign(errno, std::generic_category());
+        else if (old_info.st_dev == new_info.st_dev && old_info.st_ino == new_info.st_ino)
+            ec = std::make_error_code(std::errc::file_exists);
+
+        off_t remaining = old_info.st_size;
+#if defined(SYS_copy_file_range)
+        bool use_copy_file_range = true;
+#else
+        bool use_copy_file_range = false;
+#endif
+        while (!ec && remaining > 0)
+        {
+            ssize_t copied = -1;
+#if defined(SYS_copy_file_range)
+            if (use_copy_file_range)
+            {
+                copied = syscall(SYS_copy_file_range, i_fd, nullptr, o_fd, nullptr, static_cast<size_t>(remaining), 0u);
+                // Older kernels and some file systems cannot do this at all, which shows on the first call
+                if (copied == -1 && remaining == old_info.st_size &&
+                    (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP))
+                {
+                    use_copy_file_range = false;
+                    continue;
+                }
+            }
+            else
+#endif
+            {
+                copied = sendfile(o_fd, i_fd, nullptr, static_cast<size_t>(remaining));
+            }
+
+            if (copied == -1)
+            {
+                if (errno != EINTR) ec.assign(errno, std::generic_category());
+            }
+            else if (copied == 0)
+            {
+                // The source shrank while it was copied
+                break;
+            }
+            else
+            {
+                remaining -= copied;
+            }
+        }
+
+        if (!ec && fchmod(o_fd, old_info.st_mode & 07777) != 0) ec.assign(errno, std::generic_category());
+        close(i_fd);
+        if (close(o_fd) != 0 && !ec) ec.assign(errno, std::generic_category());
+#else
+        const auto opts = overwrite ? fs::copy_options::overwrite_existing : fs::copy_options::none;
+        fs::stdfs::copy_file(oldpath, newpath, opts, ec);
+#endif
+    }
+
     struct RealFilesystem final : Filesystem
     {
         virtual Expected<std::string> read_contents(const fs::path& file_path) const override
@@ -50,21 +591,28 @@ namespace vcpkg::Files
 
             return std::move(output);
         }
+        virtual Expected<std::unique_ptr<MappedFile>> map_contents(const fs::path& file_path) const override
+        {
+            return map_file(file_path);
+        }
         virtual Expected<std::vector<std::string>> read_lines(const fs::path& file_path) const override
         {
-            std::fstream file_stream(file_path, std::ios_base::in | std::ios_base::binary);
-            if (file_stream.fail())
+            auto maybe_file = map_file(file_path);
+            const auto file = maybe_file.get();
+            if (!file)
             {
-                return std::make_error_code(std::errc::no_such_file_or_directory);
+                return maybe_file.error();
             }
 
+            // Same lines as std::getline: a final newline does not start another line
+            const std::string_view contents = (*file)->contents();
             std::vector<std::string> output;
-            std::string line;
-            while (std::getline(file_stream, line))
+            for (size_t begin = 0; begin < contents.size();)
             {
-                output.push_back(line);
+                const auto end = std::min(contents.find('\n', begin), contents.size());
+                output.emplace_back(contents.substr(begin, end - begin));
+                begin = end + 1;
             }
-            file_stream.close();
 
             return std::move(output);
         }
@@ -87,17 +635,7 @@ namespace vcpkg::Files
 
         virtual std::vector<fs::path> get_files_recursive(const fs::path& dir) const override
         {
-            std::vector<fs::path> ret;
-
-            std::error_code ec;
-            fs::stdfs::recursive_directory_iterator b(dir, ec), e{};
-            if (ec) return ret;
-            for (; b != e; ++b)
-            {
-                ret.push_back(b->path());
-            }
-
-            return ret;
+            return Util::fmap(walk_directory_tree(dir), [](DirectoryEntry& entry) { return std::move(entry.path); });
         }
 
         virtual std::vector<fs::path> get_files_non_recursive(const fs::path& dir) const override
@@ -115,6 +653,18 @@ namespace vcpkg::Files
             return ret;
         }
 
+        virtual std::vector<DirectoryEntry> get_entries_recursive(const fs::path& dir) const override
+        {
+            return walk_directory_tree(dir);
+        }
+
+        virtual std::vector<DirectoryEntry> get_entries_non_recursive(const fs::path& dir) const override
+        {
+            std::vector<DirectoryEntry> ret;
+            list_directory(dir, ret);
+            return ret;
+        }
+
         virtual void write_lines(const fs::path& file_path, const std::vector<std::string>& lines) override
         {
             std::fstream output(file_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
@@ -145,23 +695,8 @@ namespace vcpkg::Files
                 auto dst = newpath;
                 dst.replace_filename(dst.filename() + temp_suffix.c_str());
 
-                int i_fd = open(oldpath.c_str(), O_RDONLY);
-                if (i_fd == -1) return;
-
-                int o_fd = creat(dst.c_str(), 0664);
-                if (o_fd == -1)
-                {
-                    close(i_fd);
-                    return;
-                }
-
-                off_t bytes = 0;
-                struct stat info = {0};
-                fstat(i_fd, &info);
-                auto written_bytes = sendfile(o_fd, i_fd, &bytes, info.st_size);
-                close(i_fd);
-                close(o_fd);
-                if (written_bytes == -1) return;
+                copy_regular_file(oldpath, dst, true, ec);
+                if (ec) return;
 
                 this->rename(dst, newpath, ec);
                 if (ec) return;
@@ -214,12 +749,61 @@ namespace vcpkg::Files
                                fs::copy_options opts,
                                std::error_code& ec) override
         {
-            return fs::stdfs::copy_file(oldpath, newpath, opts, ec);
+            // Only copies that replace a newer target need the times compared
+            if ((opts & fs::copy_options::update_existing) != fs::copy_options::none)
+            {
+                return fs::stdfs::copy_file(oldpath, newpath, opts, ec);
+            }
+
+            const bool skip_existing = (opts & fs::copy_options::skip_existing) != fs::copy_options::none;
+            if (skip_existing && fs::stdfs::exists(newpath, ec)) return false;
+
+            const bool overwrite = (opts & fs::copy_options::overwrite_existing) != fs::copy_options::none;
+            copy_regular_file(oldpath, newpath, overwrite, ec);
+            return !ec;
         }
         virtual void copy_symlink(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec)
         {
             return fs::stdfs::copy_symlink(oldpath, newpath, ec);
         }
+        virtual void create_hard_link(const fs::path& target, const fs::path& link, std::error_code& ec) override
+        {
+            fs::stdfs::create_hard_link(target, link, ec);
+        }
+        virtual void clone_file(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) override
+        {
+            ec.clear();
+#if defined(__linux__) && defined(FICLONE)
+            const int i_fd = open(oldpath.c_str(), O_RDONLY);
+            if (i_fd == -1)
+            {
+                ec.assign(errno, std::generic_category());
+                return;
+            }
+
+            struct stat info = {0};
+            int o_fd = -1;
+            if (fstat(i_fd, &info) == 0) o_fd = open(newpath.c_str(), O_WRONLY | O_CREAT | O_EXCL, info.st_mode);
+            if (o_fd == -1)
+            {
+                ec.assign(errno, std::generic_category());
+                close(i_fd);
+                return;
+            }
+
+            const bool cloned = ioctl(o_fd, FICLONE, i_fd) == 0;
+            if (!cloned) ec.assign(errno, std::generic_category());
+            close(i_fd);
+            close(o_fd);
+            if (!cloned) unlink(newpath.c_str());
+#elif defined(__APPLE__)
+            if (clonefile(oldpath.c_str(), newpath.c_str(), 0) != 0) ec.assign(errno, std::generic_category());
+#else
+            Util::unused(oldpath);
+            Util::unused(newpath);
+            ec = std::make_error_code(std::errc::operation_not_supported);
+#endif
+        }
 
         virtual fs::file_status status(const fs::path& path, std::error_code& ec) const override
         {
@@ -230,6 +814,16 @@ namespace vcpkg::Files
             return fs::stdfs::symlink_status(path, ec);
         }
         virtual void write_contents(const fs::path& file_path, const std::string& data, std::error_code& ec) override
+        {
+            write_with_mode(file_path, data, ec, false);
+        }
+
+        virtual void append_contents(const fs::path& file_path, const std::string& data, std::error_code& ec) override
+        {
+            write_with_mode(file_path, data, ec, true);
+        }
+
+        virtual std::unique_ptr<OutputFile> open_for_write(const fs::path& file_path, std::error_code& ec) override
         {
             ec.clear();
 
@@ -238,18 +832,97 @@ namespace vcpkg::Files
             auto err = _wfopen_s(&f, file_path.native().c_str(), L"wb");
 #else
             f = fopen(file_path.native().c_str(), "wb");
-            int err = f != nullptr ? 0 : 1;
+            int err = f != nullptr ? 0 : errno;
 #endif
             if (err != 0)
             {
                 ec.assign(err, std::system_category());
-                return;
+                return nullptr;
             }
 
-            if (f != nullptr)
-            {
-                auto count = fwrite(data.data(), sizeof(data[0]), data.size(), f);
-                fclose(f);
+            return std::make_unique<BufferedOutputFile>(f);
+        }
+
+        virtual std::unique_ptr<FileLock> lock_file(const fs::path& lock_path,
+                                                    const bool wait,
+                                                    std::error_code& ec) override
+        {
+            ec.clear();
+#if defined(_WIN32)
+            const HANDLE handle = CreateFileW(lock_path.native().c_str(),
+                                              GENERIC_READ | GENERIC_WRITE,
+                                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                              nullptr,
+                                              OPEN_ALWAYS,
+                                              FILE_ATTRIBUTE_NORMAL,
+                                              nullptr);
+            if (handle == INVALID_HANDLE_VALUE)
+            {
+                ec.assign(GetLastError(), std::system_category());
+                return nullptr;
+            }
+
+            OVERLAPPED whole_file{};
+            const DWORD flags = LOCKFILE_EXCLUSIVE_LOCK | (wait ? 0 : LOCKFILE_FAIL_IMMEDIATELY);
+            if (!LockFileEx(handle, flags, 0, MAXDWORD, MAXDWORD, &whole_file))
+            {
+                const DWORD error = GetLastError();
+                CloseHandle(handle);
+                if (error != ERROR_LOCK_VIOLATION) ec.assign(error, std::system_category());
+                return nullptr;
+            }
+
+            return std::make_unique<LockedFile>(handle);
+#else
+            const int fd = open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+            if (fd == -1)
+            {
+                ec.assign(errno, std::generic_category());
+                return nullptr;
+            }
+
+            int result;
+            while ((result = flock(fd, LOCK_EX | (wait ? 0 : LOCK_NB))) != 0 && errno == EINTR)
+            {
+            }
+            if (result != 0)
+            {
+                const int error = errno;
+                close(fd);
+                if (error != EWOULDBLOCK) ec.assign(error, std::generic_category());
+                return nullptr;
+            }
+
+            return std::make_unique<LockedFile>(fd);
+#endif
+        }
+
+        static void write_with_mode(const fs::path& file_path,
+                                    const std::string& data,
+                                    std::error_code& ec,
+                                    const bool append)
+        {
+            ec.clear();
+
+            FILE* f = nullptr;
+#if defined(_WIN32)
+            auto err = _wfopen_s(&f, file_path.native().c_str(), append ? L"ab" : L"wb");
+#else
+            f = fopen(file_path.native().c_str(), append ? "ab" : "wb");
+            int err = f != nullptr ? 0 : 1;
+#endif
+            if (err != 0)
+            {
+                ec.assign(err, std::system_category());
+                return;
+            }
+
+            if (f != nullptr)
+            {
+                // Unbuffered, the data reaches the file in one write, so concurrent appends do not interleave
+                if (append) setvbuf(f, nullptr, _IONBF, 0);
+                auto count = fwrite(data.data(), sizeof(data[0]), data.size(), f);
+                fclose(f);
 
                 if (count != data.size())
                 {
@@ -281,8 +954,7 @@ namespace vcpkg::Files
 
             return ret;
 #else
-            const std::string cmd = Strings::format("which %s", name);
-            auto out = System::cmd_execute_and_capture_output(cmd);
+            auto out = System::process_execute_and_capture_output("which", {name});
             if (out.exit_code != 0)
             {
                 return {};
@@ -293,15 +965,1282 @@ namespace vcpkg::Files
         }
     };
 
-    Filesystem& get_real_filesystem()
+    static Filesystem& get_unmeasured_filesystem()
     {
         static RealFilesystem real_fs;
         return real_fs;
     }
 
+    namespace
+    {
+        struct CallStats
+        {
+            uint64_t calls = 0;
+            uint64_t bytes = 0;
+            double microseconds = 0;
+
+            void add(uint64_t call_bytes, double call_microseconds)
+            {
+                ++calls;
+                bytes += call_bytes;
+                microseconds += call_microseconds;
+            }
+        };
+
+        struct FsStatistics
+        {
+            std::map<std::string, CallStats> by_method;
+            /// <summary>By the category of the innermost trace scope, then by method</summary>
+            std::map<std::pair<std::string, std::string>, CallStats> by_site;
+        };
+    }
+
+    static Util::LockGuarded<FsStatistics> g_fs_statistics;
+
+    /// <summary>Records one call when it goes out of scope. `bytes` is set by the method once it knows them.</summary>
+    struct MeasuredCall
+    {
+        explicit MeasuredCall(const char* method)
+            : method(method), category(Trace::current_category()), timer(Chrono::ElapsedTimer::create_started())
+        {
+        }
+
+        ~MeasuredCall()
+        {
+            const double microseconds = timer.microseconds();
+            auto statistics = g_fs_statistics.lock();
+            statistics->by_method[method].add(bytes, microseconds);
+            statistics->by_site[{category, method}].add(bytes, microseconds);
+        }
+
+        MeasuredCall(const MeasuredCall&) = delete;
+        MeasuredCall& operator=(const MeasuredCall&) = delete;
+
+        const char* method;
+        const char* category;
+        Chrono::ElapsedTimer timer;
+        uint64_t bytes = 0;
+    };
+
+    /// <summary>Forwards everything to the real file system and measures each call. Set up by --x-fs-stats.</summary>
+    struct MeasuredFilesystem final : Filesystem
+    {
+        explicit MeasuredFilesystem(Filesystem& inner) : m_inner(inner) {}
+
+        virtual Expected<std::string> read_contents(const fs::path& file_path) const override
+        {
+            MeasuredCall call("read_contents");
+            auto contents = m_inner.read_contents(file_path);
+            if (const auto p = contents.get()) call.bytes = p->size();
+            return contents;
+        }
+        virtual Expected<std::unique_ptr<MappedFile>> map_contents(const fs::path& file_path) const override
+        {
+            MeasuredCall call("map_contents");
+            auto file = m_inner.map_contents(file_path);
+            if (const auto p = file.get()) call.bytes = (*p)->contents().size();
+            return file;
+        }
+        virtual Expected<std::vector<std::string>> read_lines(const fs::path& file_path) const override
+        {
+            MeasuredCall call("read_lines");
+            auto lines = m_inner.read_lines(file_path);
+            if (const auto p = lines.get())
+            {
+                for (auto&& line : *p)
+                {
+                    call.bytes += line.size() + 1;
+                }
+            }
+            return lines;
+        }
+        virtual fs::path find_file_recursively_up(const fs::path& starting_dir,
+                                                  const std::string& filename) const override
+        {
+            MeasuredCall call("find_file_recursively_up");
+            return m_inner.find_file_recursively_up(starting_dir, filename);
+        }
+        virtual std::vector<fs::path> get_files_recursive(const fs::path& dir) const override
+        {
+            MeasuredCall call("get_files_recursive");
+            return m_inner.get_files_recursive(dir);
+        }
+        virtual std::vector<fs::path> get_files_non_recursive(const fs::path& dir) const override
+        {
+            MeasuredCall call("get_files_non_recursive");
+            return m_inner.get_files_non_recursive(dir);
+        }
+        virtual std::vector<DirectoryEntry> get_entries_recursive(const fs::path& dir) const override
+        {
+            MeasuredCall call("get_entries_recursive");
+            return m_inner.get_entries_recursive(dir);
+        }
+        virtual std::vector<DirectoryEntry> get_entries_non_recursive(const fs::path& dir) const override
+        {
+            MeasuredCall call("get_entries_non_recursive");
+            return m_inner.get_entries_non_recursive(dir);
+        }
+
+        virtual void write_lines(const fs::path& file_path, const std::vector<std::string>& lines) override
+        {
+            MeasuredCall call("write_lines");
+            for (auto&& line : lines)
+            {
+                call.bytes += line.size() + 1;
+            }
+            m_inner.write_lines(file_path, lines);
+        }
+        virtual void write_contents(const fs::path& file_path, const std::string& data, std::error_code& ec) override
+        {
+            MeasuredCall call("write_contents");
+            call.bytes = data.size();
+            m_inner.write_contents(file_path, data, ec);
+        }
+        virtual void append_contents(const fs::path& file_path, const std::string& data, std::error_code& ec) override
+        {
+            MeasuredCall call("append_contents");
+            call.bytes = data.size();
+            m_inner.append_contents(file_path, data, ec);
+        }
+        virtual std::unique_ptr<OutputFile> open_for_write(const fs::path& file_path, std::error_code& ec) override
+        {
+            MeasuredCall call("open_for_write");
+            return m_inner.open_for_write(file_path, ec);
+        }
+        virtual std::unique_ptr<FileLock> lock_file(const fs::path& lock_path, bool wait, std::error_code& ec) override
+        {
+            MeasuredCall call("lock_file");
+            return m_inner.lock_file(lock_path, wait, ec);
+        }
+        virtual void rename(const fs::path& oldpath, const fs::path& newpath) override
+        {
+            MeasuredCall call("rename");
+            m_inner.rename(oldpath, newpath);
+        }
+        virtual void rename(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) override
+        {
+            MeasuredCall call("rename");
+            m_inner.rename(oldpath, newpath, ec);
+        }
+        virtual void rename_or_copy(const fs::path& oldpath,
+                                    const fs::path& newpath,
+                                    StringLiteral temp_suffix,
+                                    std::error_code& ec) override
+        {
+            MeasuredCall call("rename_or_copy");
+            m_inner.rename_or_copy(oldpath, newpath, temp_suffix, ec);
+        }
+        virtual bool remove(const fs::path& path) override
+        {
+            MeasuredCall call("remove");
+            return m_inner.remove(path);
+        }
+        virtual bool remove(const fs::path& path, std::error_code& ec) override
+        {
+            MeasuredCall call("remove");
+            return m_inner.remove(path, ec);
+        }
+        virtual std::uintmax_t remove_all(const fs::path& path, std::error_code& ec) override
+        {
+            MeasuredCall call("remove_all");
+            return m_inner.remove_all(path, ec);
+        }
+        virtual bool exists(const fs::path& path) const override
+        {
+            MeasuredCall call("exists");
+            return m_inner.exists(path);
+        }
+        virtual bool is_directory(const fs::path& path) const override
+        {
+            MeasuredCall call("is_directory");
+            return m_inner.is_directory(path);
+        }
+        virtual bool is_regular_file(const fs::path& path) const override
+        {
+            MeasuredCall call("is_regular_file");
+            return m_inner.is_regular_file(path);
+        }
+        virtual bool is_empty(const fs::path& path) const override
+        {
+            MeasuredCall call("is_empty");
+            return m_inner.is_empty(path);
+        }
+        virtual bool create_directory(const fs::path& path, std::error_code& ec) override
+        {
+            MeasuredCall call("create_directory");
+            return m_inner.create_directory(path, ec);
+        }
+        virtual bool create_directories(const fs::path& path, std::error_code& ec) override
+        {
+            MeasuredCall call("create_directories");
+            return m_inner.create_directories(path, ec);
+        }
+        virtual void copy(const fs::path& oldpath, const fs::path& newpath, fs::copy_options opts) override
+        {
+            MeasuredCall call("copy");
+            m_inner.copy(oldpath, newpath, opts);
+        }
+        virtual bool copy_file(const fs::path& oldpath,
+                               const fs::path& newpath,
+                               fs::copy_options opts,
+                               std::error_code& ec) override
+        {
+            MeasuredCall call("copy_file");
+            const bool copied = m_inner.copy_file(oldpath, newpath, opts, ec);
+            if (copied)
+            {
+                std::error_code size_ec;
+                const auto size = fs::stdfs::file_size(newpath, size_ec);
+                if (!size_ec) call.bytes = size;
+            }
+            return copied;
+        }
+        virtual void copy_symlink(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) override
+        {
+            MeasuredCall call("copy_symlink");
+            m_inner.copy_symlink(oldpath, newpath, ec);
+        }
+        virtual void create_hard_link(const fs::path& target, const fs::path& link, std::error_code& ec) override
+        {
+            MeasuredCall call("create_hard_link");
+            m_inner.create_hard_link(target, link, ec);
+        }
+        virtual void clone_file(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) override
+        {
+            MeasuredCall call("clone_file");
+            m_inner.clone_file(oldpath, newpath, ec);
+        }
+        virtual fs::file_status status(const fs::path& path, std::error_code& ec) const override
+        {
+            MeasuredCall call("status");
+            return m_inner.status(path, ec);
+        }
+        virtual fs::file_status symlink_status(const fs::path& path, std::error_code& ec) const override
+        {
+            MeasuredCall call("symlink_status");
+            return m_inner.symlink_status(path, ec);
+        }
+
+        virtual std::vector<fs::path> find_from_PATH(const std::string& name) const override
+        {
+            MeasuredCall call("find_from_PATH");
+            return m_inner.find_from_PATH(name);
+        }
+
+    private:
+        Filesystem& m_inner;
+    };
+
+    static std::unique_ptr<Filesystem> g_measured_filesystem;
+
+    Filesystem& get_real_filesystem()
+    {
+        if (g_measured_filesystem) return *g_measured_filesystem;
+        return get_unmeasured_filesystem();
+    }
+
+    void enable_statistics()
+    {
+        if (!g_measured_filesystem)
+            g_measured_filesystem = std::make_unique<MeasuredFilesystem>(get_unmeasured_filesystem());
+    }
+
+    static std::string format_call_stats(const std::string& name, const CallStats& stats)
+    {
+        return Strings::format("    %-48s %10llu %12.1f %12.1f",
+                               name,
+                               static_cast<unsigned long long>(stats.calls),
+                               stats.bytes / 1048576.0,
+                               stats.microseconds / 1000.0);
+    }
+
+    void report_statistics()
+    {
+        if (!g_measured_filesystem) return;
+
+        auto statistics = g_fs_statistics.lock();
+        System::println("File system calls:\n    %-48s %10s %12s %12s", "method", "calls", "MiB", "ms");
+        for (auto&& entry : statistics->by_method)
+        {
+            System::println(format_call_stats(entry.first, entry.second));
+            Trace::add_summary("fs",
+                               "fs " + entry.first,
+                               Strings::format(R"({"calls":%llu,"bytes":%llu,"us":%.0f})",
+                                               static_cast<unsigned long long>(entry.second.calls),
+                                               static_cast<unsigned long long>(entry.second.bytes),
+                                               entry.second.microseconds));
+        }
+
+        System::println("File system calls by trace scope:");
+        for (auto&& entry : statistics->by_site)
+        {
+            System::println(format_call_stats(entry.first.first + " " + entry.first.second, entry.second));
+        }
+    }
+
+    /// <summary>
+    /// Forwards everything to another Filesystem, but asks it for the status of each path only once. Anything written
+    /// through this object forgets all statuses, since a rename or remove changes those of whole trees.
+    /// </summary>
+    struct StatCachingFilesystem final : Filesystem
+    {
+        explicit StatCachingFilesystem(Filesystem& inner) : m_inner(inner) {}
+
+        virtual Expected<std::string> read_contents(const fs::path& file_path) const override
+        {
+            return m_inner.read_contents(file_path);
+        }
+        virtual Expected<std::unique_ptr<MappedFile>> map_contents(const fs::path& file_path) const override
+        {
+            return m_inner.map_contents(file_path);
+        }
+        virtual Expected<std::vector<std::string>> read_lines(const fs::path& file_path) const override
+        {
+            return m_inner.read_lines(file_path);
+        }
+        virtual fs::path find_file_recursively_up(const fs::path& starting_dir,
+                                                  const std::string& filename) const override
+        {
+            return m_inner.find_file_recursively_up(starting_dir, filename);
+        }
+        virtual std::vector<fs::path> get_files_recursive(const fs::path& dir) const override
+        {
+            return m_inner.get_files_recursive(dir);
+        }
+        virtual std::vector<fs::path> get_files_non_recursive(const fs::path& dir) const override
+        {
+            return m_inner.get_files_non_recursive(dir);
+        }
+        virtual std::vector<DirectoryEntry> get_entries_recursive(const fs::path& dir) const override
+        {
+            return m_inner.get_entries_recursive(dir);
+        }
+        virtual std::vector<DirectoryEntry> get_entries_non_recursive(const fs::path& dir) const override
+        {
+            return m_inner.get_entries_non_recursive(dir);
+        }
+
+        virtual void write_lines(const fs::path& file_path, const std::vector<std::string>& lines) override
+        {
+            forget_statuses();
+            m_inner.write_lines(file_path, lines);
+        }
+        virtual void write_contents(const fs::path& file_path, const std::string& data, std::error_code& ec) override
+        {
+            forget_statuses();
+            m_inner.write_contents(file_path, data, ec);
+        }
+        virtual void append_contents(const fs::path& file_path, const std::string& data, std::error_code& ec) override
+        {
+            forget_statuses();
+            m_inner.append_contents(file_path, data, ec);
+        }
+        virtual std::unique_ptr<OutputFile> open_for_write(const fs::path& file_path, std::error_code& ec) override
+        {
+            forget_statuses();
+            return m_inner.open_for_write(file_path, ec);
+        }
+        virtual std::unique_ptr<FileLock> lock_file(const fs::path& lock_path, bool wait, std::error_code& ec) override
+        {
+            forget_statuses();
+            return m_inner.lock_file(lock_path, wait, ec);
+        }
+        virtual void rename(const fs::path& oldpath, const fs::path& newpath) override
+        {
+            forget_statuses();
+            m_inner.rename(oldpath, newpath);
+        }
+        virtual void rename(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) override
+        {
+            forget_statuses();
+            m_inner.rename(oldpath, newpath, ec);
+        }
+        virtual void rename_or_copy(const fs::path& oldpath,
+                                    const fs::path& newpath,
+                                    StringLiteral temp_suffix,
+                                    std::error_code& ec) override
+        {
+            forget_statuses();
+            m_inner.rename_or_copy(oldpath, newpath, temp_suffix, ec);
+        }
+        virtual bool remove(const fs::path& path) override
+        {
+            forget_statuses();
+            return m_inner.remove(path);
+        }
+        virtual bool remove(const fs::path& path, std::error_code& ec) override
+        {
+            forget_statuses();
+            return m_inner.remove(path, ec);
+        }
+        virtual std::uintmax_t remove_all(const fs::path& path, std::error_code& ec) override
+        {
+            forget_statuses();
+            return m_inner.remove_all(path, ec);
+        }
+        virtual bool exists(const fs::path& path) const override
+        {
+            std::error_code ec;
+            return fs::stdfs::exists(status(path, ec));
+        }
+        virtual bool is_directory(const fs::path& path) const override
+        {
+            std::error_code ec;
+            return fs::is_directory(status(path, ec));
+        }
+        virtual bool is_regular_file(const fs::path& path) const override
+        {
+            std::error_code ec;
+            return fs::is_regular_file(status(path, ec));
+        }
+        virtual bool is_empty(const fs::path& path) const override { return m_inner.is_empty(path); }
+        virtual bool create_directory(const fs::path& path, std::error_code& ec) override
+        {
+            forget_statuses();
+            return m_inner.create_directory(path, ec);
+        }
+        virtual bool create_directories(const fs::path& path, std::error_code& ec) override
+        {
+            forget_statuses();
+            return m_inner.create_directories(path, ec);
+        }
+        virtual void copy(const fs::path& oldpath, const fs::path& newpath, fs::copy_options opts) override
+        {
+            forget_statuses();
+            m_inner.copy(oldpath, newpath, opts);
+        }
+        virtual bool copy_file(const fs::path& oldpath,
+                               const fs::path& newpath,
+                               fs::copy_options opts,
+                               std::error_code& ec) override
+        {
+            forget_statuses();
+            return m_inner.copy_file(oldpath, newpath, opts, ec);
+        }
+        virtual void copy_symlink(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) override
+        {
+            forget_statuses();
+            m_inner.copy_symlink(oldpath, newpath, ec);
+        }
+        virtual void create_hard_link(const fs::path& target, const fs::path& link, std::error_code& ec) override
+        {
+            forget_statuses();
+            m_inner.create_hard_link(target, link, ec);
+        }
+        virtual void clone_file(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) override
+        {
+            forget_statuses();
+            m_inner.clone_file(oldpath, newpath, ec);
+        }
+        virtual fs::file_status status(const fs::path& path, std::error_code& ec) const override
+        {
+            return cached_status(m_statuses, path, ec, [&](std::error_code& inner_ec) {
+                return m_inner.status(path, inner_ec);
+            });
+        }
+        virtual fs::file_status symlink_status(const fs::path& path, std::error_code& ec) const override
+        {
+            return cached_status(m_symlink_statuses, path, ec, [&](std::error_code& inner_ec) {
+                return m_inner.symlink_status(path, inner_ec);
+            });
+        }
+
+        virtual std::vector<fs::path> find_from_PATH(const std::string& name) const override
+        {
+            return m_inner.find_from_PATH(name);
+        }
+
+    private:
+        struct CachedStatus
+        {
+            fs::file_status status;
+            std::error_code ec;
+        };
+
+        using StatusMap = std::unordered_map<std::string, CachedStatus>;
+
+        template<class F>
+        fs::file_status cached_status(StatusMap& statuses,
+                                      const fs::path& path,
+                                      std::error_code& ec,
+                                      const F& get_status) const
+        {
+            const std::string key = path.u8string();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                const auto it = statuses.find(key);
+                if (it != statuses.end())
+                {
+                    ec = it->second.ec;
+                    return it->second.status;
+                }
+            }
+
+            const fs::file_status status = get_status(ec);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            statuses.emplace(key, CachedStatus{status, ec});
+            return status;
+        }
+
+        void forget_statuses()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_statuses.clear();
+            m_symlink_statuses.clear();
+        }
+
+        Filesystem& m_inner;
+        mutable std::mutex m_mutex;
+        mutable StatusMap m_statuses;
+        mutable StatusMap m_symlink_statuses;
+    };
+
+    std::unique_ptr<Filesystem> make_stat_caching_filesystem(Filesystem& inner)
+    {
+        return std::make_unique<StatCachingFilesystem>(inner);
+    }
+
+    /// <summary>
+    /// Keys are generic paths without a trailing slash, taken as written: "." and ".." are not resolved, and symlinks
+    /// are only followed as the last component of a path.
+    /// </summary>
+    static std::string memory_key(const fs::path& path)
+    {
+        std::string key = path.generic_u8string();
+        while (key.size() > 1 && key.back() == '/' && key[key.size() - 2] != ':')
+        {
+            key.pop_back();
+        }
+        return key;
+    }
+
+    static bool is_memory_root(const std::string& key) { return key.empty() || key.back() == '/' || key.back() == ':'; }
+
+    static std::string memory_parent(const std::string& key)
+    {
+        const auto slash = key.rfind('/');
+        if (slash == std::string::npos) return std::string();
+        return key.substr(0, slash == 0 || key[slash - 1] == ':' ? slash + 1 : slash);
+    }
+
+    static std::string memory_child_prefix(const std::string& key) { return key.back() == '/' ? key : key + '/'; }
+
+    struct MemoryFilesystemImpl final : MemoryFilesystem
+    {
+        virtual Expected<std::string> read_contents(const fs::path& file_path) const override
+        {
+            round_trip();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const Node* node = find_following(memory_key(file_path));
+            if (!node) return std::make_error_code(std::errc::no_such_file_or_directory);
+            if (node->type != fs::file_type::regular) return std::make_error_code(std::errc::is_a_directory);
+            return std::string(*node->contents);
+        }
+        virtual Expected<std::unique_ptr<MappedFile>> map_contents(const fs::path& file_path) const override
+        {
+            auto maybe_contents = read_contents(file_path);
+            if (const auto contents = maybe_contents.get()) return make_mapped_string(std::move(*contents));
+            return maybe_contents.error();
+        }
+        virtual Expected<std::vector<std::string>> read_lines(const fs::path& file_path) const override
+        {
+            auto maybe_contents = read_contents(file_path);
+            const auto contents = maybe_contents.get();
+            if (!contents) return maybe_contents.error();
+
+            std::vector<std::string> output;
+            for (size_t begin = 0; begin < contents->size();)
+            {
+                const auto end = std::min(contents->find('\n', begin), contents->size());
+                output.push_back(contents->substr(begin, end - begin));
+                begin = end + 1;
+            }
+            return output;
+        }
+        virtual fs::path find_file_recursively_up(const fs::path& starting_dir,
+                                                  const std::string& filename) const override
+        {
+            for (std::string dir = memory_key(starting_dir); !is_memory_root(dir); dir = memory_parent(dir))
+            {
+                if (exists(fs::u8path(dir) / filename)) return fs::u8path(dir);
+            }
+            return fs::path();
+        }
+        virtual std::vector<fs::path> get_files_recursive(const fs::path& dir) const override
+        {
+            return Util::fmap(get_entries_recursive(dir), [](DirectoryEntry& entry) { return std::move(entry.path); });
+        }
+        virtual std::vector<fs::path> get_files_non_recursive(const fs::path& dir) const override
+        {
+            return Util::fmap(get_entries_non_recursive(dir),
+                              [](DirectoryEntry& entry) { return std::move(entry.path); });
+        }
+        virtual std::vector<DirectoryEntry> get_entries_recursive(const fs::path& dir) const override
+        {
+            // A walk reads every directory, so it costs a round trip for each
+            size_t directory_count = 0;
+            std::vector<DirectoryEntry> ret;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                const std::string prefix = memory_child_prefix(memory_key(dir));
+                for (auto it = m_nodes.lower_bound(prefix); it != m_nodes.end() && starts_with(it->first, prefix); ++it)
+                {
+                    if (it->second.type == fs::file_type::directory) ++directory_count;
+                    ret.push_back(entry_of(*it));
+                }
+            }
+
+            for (size_t i = 0; i <= directory_count; ++i)
+            {
+                round_trip();
+            }
+            return ret;
+        }
+        virtual std::vector<DirectoryEntry> get_entries_non_recursive(const fs::path& dir) const override
+        {
+            round_trip();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::vector<DirectoryEntry> ret;
+            const std::string prefix = memory_child_prefix(memory_key(dir));
+            for (auto it = m_nodes.lower_bound(prefix); it != m_nodes.end() && starts_with(it->first, prefix); ++it)
+            {
+                if (it->first.find('/', prefix.size()) == std::string::npos) ret.push_back(entry_of(*it));
+            }
+            return ret;
+        }
+
+        virtual void write_lines(const fs::path& file_path, const std::vector<std::string>& lines) override
+        {
+            std::string data;
+            for (auto&& line : lines)
+            {
+                data += line;
+                data += '\n';
+            }
+            std::error_code ec;
+            write_contents(file_path, data, ec);
+        }
+        virtual void write_contents(const fs::path& file_path, const std::string& data, std::error_code& ec) override
+        {
+            round_trip();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            write_file(memory_key(file_path), data, false, ec);
+        }
+        virtual void append_contents(const fs::path& file_path, const std::string& data, std::error_code& ec) override
+        {
+            round_trip();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            write_file(memory_key(file_path), data, true, ec);
+        }
+        virtual std::unique_ptr<OutputFile> open_for_write(const fs::path& file_path, std::error_code& ec) override
+        {
+            write_contents(file_path, std::string(), ec);
+            if (ec) return nullptr;
+            return std::make_unique<MemoryOutputFile>(*this, file_path);
+        }
+        virtual std::unique_ptr<FileLock> lock_file(const fs::path& lock_path, bool wait, std::error_code& ec) override
+        {
+            round_trip();
+            std::unique_lock<std::mutex> lock(m_mutex);
+            const std::string key = memory_key(lock_path);
+            if (!find(key)) write_file(key, std::string(), true, ec);
+            if (ec) return nullptr;
+
+            if (!wait && Util::Sets::contains(m_locked, key)) return nullptr;
+            m_unlocked.wait(lock, [&]() { return !Util::Sets::contains(m_locked, key); });
+            m_locked.insert(key);
+            return std::make_unique<MemoryFileLock>(*this, key);
+        }
+        virtual void rename(const fs::path& oldpath, const fs::path& newpath) override
+        {
+            std::error_code ec;
+            rename(oldpath, newpath, ec);
+            if (ec) throw fs::stdfs::filesystem_error("rename", oldpath, newpath, ec);
+        }
+        virtual void rename(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) override
+        {
+            round_trip();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ec.clear();
+            const std::string old_key = memory_key(oldpath);
+            const std::string new_key = memory_key(newpath);
+            const Node* old_node = find(old_key);
+            if (!old_node || !parent_is_directory(new_key))
+            {
+                ec = std::make_error_code(std::errc::no_such_file_or_directory);
+                return;
+            }
+            if (old_key == new_key) return;
+            if (starts_with(new_key, memory_child_prefix(old_key)))
+            {
+                ec = std::make_error_code(std::errc::invalid_argument);
+                return;
+            }
+
+            if (const Node* new_node = find(new_key))
+            {
+                const bool old_is_directory = old_node->type == fs::file_type::directory;
+                const bool new_is_directory = new_node->type == fs::file_type::directory;
+                if (old_is_directory != new_is_directory)
+                    ec = std::make_error_code(new_is_directory ? std::errc::is_a_directory
+                                                               : std::errc::not_a_directory);
+                else if (new_is_directory && has_children(new_key))
+                    ec = std::make_error_code(std::errc::directory_not_empty);
+                if (ec) return;
+                m_nodes.erase(new_key);
+            }
+
+            const std::string old_prefix = memory_child_prefix(old_key);
+            const std::string new_prefix = memory_child_prefix(new_key);
+            m_nodes.emplace(new_key, std::move(m_nodes.at(old_key)));
+            m_nodes.erase(old_key);
+            auto it = m_nodes.lower_bound(old_prefix);
+            while (it != m_nodes.end() && starts_with(it->first, old_prefix))
+            {
+                m_nodes.emplace(new_prefix + it->first.substr(old_prefix.size()), std::move(it->second));
+                it = m_nodes.erase(it);
+            }
+        }
+        virtual void rename_or_copy(const fs::path& oldpath,
+                                    const fs::path& newpath,
+                                    StringLiteral,
+                                    std::error_code& ec) override
+        {
+            // Everything is on one volume, so renaming always works where copying would
+            rename(oldpath, newpath, ec);
+        }
+        virtual bool remove(const fs::path& path) override
+        {
+            std::error_code ec;
+            const bool removed = remove(path, ec);
+            if (ec) throw fs::stdfs::filesystem_error("remove", path, ec);
+            return removed;
+        }
+        virtual bool remove(const fs::path& path, std::error_code& ec) override
+        {
+            round_trip();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ec.clear();
+            const std::string key = memory_key(path);
+            if (!find(key)) return false;
+            if (has_children(key))
+            {
+                ec = std::make_error_code(std::errc::directory_not_empty);
+                return false;
+            }
+            m_nodes.erase(key);
+            return true;
+        }
+        virtual std::uintmax_t remove_all(const fs::path& path, std::error_code& ec) override
+        {
+            round_trip();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ec.clear();
+            const std::string key = memory_key(path);
+            if (!find(key)) return 0;
+
+            const std::string prefix = memory_child_prefix(key);
+            std::uintmax_t count = m_nodes.erase(key);
+            auto it = m_nodes.lower_bound(prefix);
+            while (it != m_nodes.end() && starts_with(it->first, prefix))
+            {
+                it = m_nodes.erase(it);
+                ++count;
+            }
+            return count;
+        }
+        virtual bool exists(const fs::path& path) const override
+        {
+            std::error_code ec;
+            return fs::stdfs::exists(status(path, ec));
+        }
+        virtual bool is_directory(const fs::path& path) const override
+        {
+            std::error_code ec;
+            return fs::is_directory(status(path, ec));
+        }
+        virtual bool is_regular_file(const fs::path& path) const override
+        {
+            std::error_code ec;
+            return fs::is_regular_file(status(path, ec));
+        }
+        virtual bool is_empty(const fs::path& path) const override
+        {
+            round_trip();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const std::string key = memory_key(path);
+            const Node* node = find_following(key);
+            if (!node) return false;
+            if (node->type == fs::file_type::regular) return node->contents->empty();
+            return !has_children(key);
+        }
+        virtual bool create_directory(const fs::path& path, std::error_code& ec) override
+        {
+            round_trip();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return make_directory(memory_key(path), ec);
+        }
+        virtual bool create_directories(const fs::path& path, std::error_code& ec) override
+        {
+            round_trip();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ec.clear();
+            std::vector<std::string> missing;
+            for (std::string key = memory_key(path); !is_memory_root(key) && !find(key); key = memory_parent(key))
+            {
+                missing.push_back(key);
+            }
+
+            for (auto it = missing.rbegin(); it != missing.rend(); ++it)
+            {
+                make_directory(*it, ec);
+                if (ec) return false;
+            }
+
+            const Node* node = find_following(memory_key(path));
+            if (!node || node->type != fs::file_type::directory)
+                ec = std::make_error_code(std::errc::not_a_directory);
+            return !missing.empty();
+        }
+        virtual void copy(const fs::path& oldpath, const fs::path& newpath, fs::copy_options opts) override
+        {
+            std::error_code ec;
+            if (is_regular_file(oldpath))
+            {
+                copy_file(oldpath, newpath, opts, ec);
+            }
+            else if (is_directory(oldpath))
+            {
+                if (!is_directory(newpath)) create_directory(newpath, ec);
+                const bool recursive = (opts & fs::copy_options::recursive) != fs::copy_options::none;
+                const auto entries = recursive ? get_entries_recursive(oldpath) : std::vector<DirectoryEntry>();
+                const size_t prefix_length = memory_key(oldpath).size() + 1;
+                for (auto it = entries.begin(); it != entries.end() && !ec; ++it)
+                {
+                    const fs::path target = newpath / fs::u8path(memory_key(it->path).substr(prefix_length));
+                    if (it->type == fs::file_type::directory)
+                    {
+                        if (!is_directory(target)) create_directory(target, ec);
+                    }
+                    else if (it->type == fs::file_type::symlink)
+                        copy_symlink(it->path, target, ec);
+                    else
+                        copy_file(it->path, target, opts, ec);
+                }
+            }
+            else
+            {
+                ec = std::make_error_code(std::errc::no_such_file_or_directory);
+            }
+
+            if (ec) throw fs::stdfs::filesystem_error("copy", oldpath, newpath, ec);
+        }
+        virtual bool copy_file(const fs::path& oldpath,
+                               const fs::path& newpath,
+                               fs::copy_options opts,
+                               std::error_code& ec) override
+        {
+            round_trip();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ec.clear();
+            const Node* source = find_following(memory_key(oldpath));
+            if (!source || source->type != fs::file_type::regular)
+            {
+                ec = std::make_error_code(std::errc::no_such_file_or_directory);
+                return false;
+            }
+
+            const std::string key = memory_key(newpath);
+            if (find_following(key))
+            {
+                if ((opts & fs::copy_options::skip_existing) != fs::copy_options::none) return false;
+                if ((opts & fs::copy_options::overwrite_existing) == fs::copy_options::none)
+                {
+                    ec = std::make_error_code(std::errc::file_exists);
+                    return false;
+                }
+            }
+
+            write_file(key, std::string(*source->contents), false, ec);
+            return !ec;
+        }
+        virtual void copy_symlink(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) override
+        {
+            round_trip();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ec.clear();
+            const Node* source = find(memory_key(oldpath));
+            if (!source || source->type != fs::file_type::symlink)
+            {
+                ec = std::make_error_code(std::errc::invalid_argument);
+                return;
+            }
+
+            Node link = *source;
+            link.last_write_time = fs::stdfs::file_time_type::clock::now();
+            add_node(memory_key(newpath), std::move(link), ec);
+        }
+        virtual void create_hard_link(const fs::path& target, const fs::path& link, std::error_code& ec) override
+        {
+            round_trip();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ec.clear();
+            const Node* source = find_following(memory_key(target));
+            if (!source || source->type != fs::file_type::regular)
+            {
+                ec = std::make_error_code(std::errc::no_such_file_or_directory);
+                return;
+            }
+
+            // Both names share the contents, as they share an inode on disk
+            add_node(memory_key(link), Node(*source), ec);
+        }
+        virtual void clone_file(const fs::path& oldpath, const fs::path& newpath, std::error_code& ec) override
+        {
+            round_trip();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ec.clear();
+            const Node* source = find_following(memory_key(oldpath));
+            if (!source || source->type != fs::file_type::regular)
+            {
+                ec = std::make_error_code(std::errc::no_such_file_or_directory);
+                return;
+            }
+
+            Node clone = *source;
+            clone.contents = std::make_shared<std::string>(*source->contents);
+            add_node(memory_key(newpath), std::move(clone), ec);
+        }
+        virtual fs::file_status status(const fs::path& path, std::error_code& ec) const override
+        {
+            round_trip();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return status_of(find_following(memory_key(path)), ec);
+        }
+        virtual fs::file_status symlink_status(const fs::path& path, std::error_code& ec) const override
+        {
+            round_trip();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return status_of(find(memory_key(path)), ec);
+        }
+
+        virtual std::vector<fs::path> find_from_PATH(const std::string&) const override { return {}; }
+
+        virtual void set_latency(std::chrono::microseconds latency) override { m_latency_us = latency.count(); }
+        virtual uint64_t call_count() const override { return m_calls; }
+        virtual void reset_call_count() override { m_calls = 0; }
+
+    private:
+        struct Node
+        {
+            fs::file_type type;
+            /// <summary>Shared by the hard links of a regular file</summary>
+            std::shared_ptr<std::string> contents;
+            /// <summary>Where a symlink points, relative to its directory unless absolute</summary>
+            std::string target;
+            fs::stdfs::file_time_type last_write_time;
+        };
+
+        struct MemoryOutputFile final : OutputFile
+        {
+            MemoryOutputFile(MemoryFilesystemImpl& fs, const fs::path& path) : m_fs(fs), m_path(path) {}
+
+            virtual void write(std::string_view data) override { m_data.append(data.data(), data.size()); }
+            virtual void flush() override {}
+            virtual void close(std::error_code& ec) override { m_fs.write_contents(m_path, m_data, ec); }
+
+        private:
+            MemoryFilesystemImpl& m_fs;
+            fs::path m_path;
+            std::string m_data;
+        };
+
+        struct MemoryFileLock final : FileLock
+        {
+            MemoryFileLock(MemoryFilesystemImpl& fs, const std::string& key) : m_fs(fs), m_key(key) {}
+            MemoryFileLock(const MemoryFileLock&) = delete;
+            MemoryFileLock& operator=(const MemoryFileLock&) = delete;
+            ~MemoryFileLock()
+            {
+                std::lock_guard<std::mutex> lock(m_fs.m_mutex);
+                m_fs.m_locked.erase(m_key);
+                m_fs.m_unlocked.notify_all();
+            }
+
+        private:
+            MemoryFilesystemImpl& m_fs;
+            std::string m_key;
+        };
+
+        static bool starts_with(const std::string& s, const std::string& prefix)
+        {
+            return s.compare(0, prefix.size(), prefix) == 0;
+        }
+
+        /// <summary>Counts the call and waits as long as a round trip to the server would, without the lock</summary>
+        void round_trip() const
+        {
+            ++m_calls;
+            const long long latency_us = m_latency_us;
+            if (latency_us > 0) std::this_thread::sleep_for(std::chrono::microseconds(latency_us));
+        }
+
+        const Node* find(const std::string& key) const
+        {
+            const auto it = m_nodes.find(key);
+            return it == m_nodes.end() ? nullptr : &it->second;
+        }
+
+        Node* find(const std::string& key)
+        {
+            const auto it = m_nodes.find(key);
+            return it == m_nodes.end() ? nullptr : &it->second;
+        }
+
+        /// <summary>Where key leads once the symlinks it names are followed, as far as they go</summary>
+        std::string resolve(const std::string& key) const
+        {
+            std::string resolved = key;
+            for (int hops = 0; hops < 40; ++hops)
+            {
+                const Node* node = find(resolved);
+                if (!node || node->type != fs::file_type::symlink) break;
+                const fs::path target = fs::u8path(node->target);
+                resolved = target.has_root_directory() ? memory_key(target)
+                                                       : memory_key(fs::u8path(memory_parent(resolved)) / target);
+            }
+            return resolved;
+        }
+
+        /// <summary>The node at key with symlinks followed, or null where there is none or the links loop</summary>
+        const Node* find_following(const std::string& key) const
+        {
+            const Node* node = find(resolve(key));
+            return node && node->type != fs::file_type::symlink ? node : nullptr;
+        }
+
+        bool parent_is_directory(const std::string& key) const
+        {
+            const std::string parent = memory_parent(key);
+            if (is_memory_root(parent)) return true;
+            const Node* node = find_following(parent);
+            return node && node->type == fs::file_type::directory;
+        }
+
+        bool has_children(const std::string& key) const
+        {
+            const std::string prefix = memory_child_prefix(key);
+            const auto it = m_nodes.lower_bound(prefix);
+            return it != m_nodes.end() && starts_with(it->first, prefix);
+        }
+
+        static fs::file_status status_of(const Node* node, std::error_code& ec)
+        {
+            ec.clear();
+            if (node) return fs::file_status(node->type);
+            ec = std::make_error_code(std::errc::no_such_file_or_directory);
+            return fs::file_status(fs::file_type::not_found);
+        }
+
+        static DirectoryEntry entry_of(const std::pair<const std::string, Node>& node)
+        {
+            const uintmax_t size = node.second.type == fs::file_type::regular ? node.second.contents->size() : 0;
+            return {fs::u8path(node.first), node.second.type, size, node.second.last_write_time};
+        }
+
+        void add_node(const std::string& key, Node node, std::error_code& ec)
+        {
+            if (find(key))
+                ec = std::make_error_code(std::errc::file_exists);
+            else if (!parent_is_directory(key))
+                ec = std::make_error_code(std::errc::no_such_file_or_directory);
+            else
+                m_nodes.emplace(key, std::move(node));
+        }
+
+        bool make_directory(const std::string& key, std::error_code& ec)
+        {
+            ec.clear();
+            if (const Node* node = find_following(key))
+            {
+                if (node->type != fs::file_type::directory) ec = std::make_error_code(std::errc::file_exists);
+                return false;
+            }
+
+            add_node(key, Node{fs::file_type::directory, nullptr, {}, fs::stdfs::file_time_type::clock::now()}, ec);
+            return !ec;
+        }
+
+        void write_file(const std::string& key, const std::string& data, bool append, std::error_code& ec)
+        {
+            ec.clear();
+            const std::string resolved = resolve(key);
+            if (Node* node = find(resolved))
+            {
+                if (node->type != fs::file_type::regular)
+                {
+                    ec = std::make_error_code(std::errc::is_a_directory);
+                    return;
+                }
+
+                // Written in place, so hard links see the change as they would on disk
+                if (append)
+                    *node->contents += data;
+                else
+                    *node->contents = data;
+                node->last_write_time = fs::stdfs::file_time_type::clock::now();
+                return;
+            }
+
+            add_node(resolved,
+                     Node{fs::file_type::regular,
+                          std::make_shared<std::string>(data),
+                          {},
+                          fs::stdfs::file_time_type::clock::now()},
+                     ec);
+        }
+
+        mutable std::mutex m_mutex;
+        std::map<std::string, Node> m_nodes;
+        std::set<std::string> m_locked;
+        std::condition_variable m_unlocked;
+        mutable std::atomic<uint64_t> m_calls{0};
+        std::atomic<long long> m_latency_us{0};
+    };
+
+    std::unique_ptr<MemoryFilesystem> make_memory_filesystem() { return std::make_unique<MemoryFilesystemImpl>(); }
+
+    /// <summary>
+    /// Removes the directories moved to the trash by remove_all_in_background, one at a time, on a thread that yields
+    /// the processor and the disk to the builds.
+    /// </summary>
+    struct BackgroundRemover
+    {
+        static BackgroundRemover& get()
+        {
+            // Never destroyed: vcpkg waits for the removals on its way out, but may also exit from another thread
+            static BackgroundRemover* remover = new BackgroundRemover();
+            return *remover;
+        }
+
+        void add(Filesystem& fs, const fs::path& dir, const fs::path& trash_dir)
+        {
+            fs::path trashed;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                trashed = trash_dir / Strings::format("%s.%08x", dir.filename().u8string(), random());
+            }
+
+            std::error_code ec;
+            fs.create_directories(trash_dir, ec);
+            fs.rename(dir, trashed, ec);
+            if (ec)
+            {
+                // Not there, or on another volume than the trash
+                fs.remove_all(dir, ec);
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (trash_dirs.insert(trash_dir.u8string()).second)
+            {
+                // What a killed vcpkg process left in the trash is removed along with the new entry
+                for (auto&& entry : fs.get_files_non_recursive(trash_dir))
+                {
+                    queue.push_back({&fs, std::move(entry)});
+                }
+            }
+            else
+            {
+                queue.push_back({&fs, std::move(trashed)});
+            }
+
+            unfinished = queue.size() + (removing ? 1 : 0);
+            changed.notify_all();
+        }
+
+        void wait_all()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (unfinished == 0) return;
+            System::println("Waiting for %zu directories to be removed", unfinished);
+            changed.wait(lock, [&]() { return unfinished == 0; });
+        }
+
+    private:
+        struct Entry
+        {
+            Filesystem* fs;
+            fs::path path;
+        };
+
+        BackgroundRemover()
+        {
+            std::thread([this]() { run(); }).detach();
+        }
+
+        static void lower_thread_priority()
+        {
+#if defined(_WIN32)
+            // Lowers the priority of the thread's disk access as well
+            SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+#elif defined(__linux__)
+            // The disk schedulers derive the priority of the thread's disk access from this
+            setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+#elif defined(__APPLE__)
+            setpriority(PRIO_DARWIN_THREAD, 0, PRIO_DARWIN_BG);
+#endif
+        }
+
+        void run()
+        {
+            lower_thread_priority();
+            while (true)
+            {
+                Entry entry;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [&]() { return !queue.empty(); });
+                    entry = std::move(queue.front());
+                    queue.pop_front();
+                    removing = true;
+                }
+
+                std::error_code ec;
+                entry.fs->remove_all(entry.path, ec);
+
+                std::lock_guard<std::mutex> lock(mutex);
+                removing = false;
+                unfinished = queue.size();
+                changed.notify_all();
+            }
+        }
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<Entry> queue;
+        std::set<std::string> trash_dirs;
+        std::random_device random;
+        bool removing = false;
+        size_t unfinished = 0;
+    };
+
+    static std::atomic<bool> g_removing_in_background{false};
+
+    void remove_all_in_background(Filesystem& fs, const fs::path& dir, const fs::path& scratch_root)
+    {
+        g_removing_in_background = true;
+        BackgroundRemover::get().add(fs, dir, scratch_root / ".trash");
+    }
+
+    void wait_for_background_removals()
+    {
+        if (g_removing_in_background) BackgroundRemover::get().wait_all();
+    }
+
     bool has_invalid_chars_for_filesystem(const std::string& s)
     {
-        return std::regex_search(s, FILESYSTEM_INVALID_CHARACTERS_REGEX);
+        return FILESYSTEM_INVALID_CHARACTER_SET.contains_any_of(s);
     }
 
     void print_paths(const std::vector<fs::path>& paths)
@@ -1,246 +1,729 @@
 #include "pch.h"
 
 #include <vcpkg/base/checks.h>
+#include <vcpkg/base/hash.h>
 #include <vcpkg/base/strings.h>
 #include <vcpkg/base/system.h>
 #include <vcpkg/base/util.h>
 
-#if defined(_WIN32)
-#include <bcrypt.h>
-
-#ifndef NT_SUCCESS
-#define NT_SUCCESS(Status) (((NTSTATUS)(Status)) >= 0)
+#if defined(_M_X64) || defined(__x86_64__)
+#define VCPKG_HASH_SHA_NI 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define VCPKG_TARGET_SHA_NI
+#else
+#include <cpuid.h>
+#define VCPKG_TARGET_SHA_NI __attribute__((target("sha,sse4.1")))
 #endif
 #endif
 
 namespace vcpkg::Hash
 {
-    static void verify_has_only_allowed_chars(const std::string& s)
+    Optional<Algorithm> algorithm_from_string(const std::string& hash_type)
     {
-        static const std::regex ALLOWED_CHARS{"^[a-zA-Z0-9-]*$"};
-        Checks::check_exit(VCPKG_LINE_INFO,
-                           std::regex_match(s, ALLOWED_CHARS),
-                           "Only alphanumeric chars and dashes are currently allowed. String was:\n"
-                           "    % s",
-                           s);
+        const std::string upper = Strings::ascii_to_uppercase(hash_type);
+        if (upper == "SHA1") return Algorithm::SHA1;
+        if (upper == "SHA256") return Algorithm::SHA256;
+        if (upper == "SHA512") return Algorithm::SHA512;
+        return nullopt;
     }
-#if defined(_WIN32)
+
     namespace
     {
-        std::string to_hex(const unsigned char* string, const size_t bytes)
+        template<class Word>
+        Word rotr(const Word value, const int count)
+        {
+            return (value >> count) | (value << (sizeof(Word) * 8 - count));
+        }
+
+        template<class Word>
+        Word load_big_endian(const unsigned char* bytes)
         {
-            static constexpr char HEX_MAP[] = "0123456789abcdef";
+            Word value = 0;
+            for (size_t i = 0; i < sizeof(Word); ++i)
+                value = (value << 8) | bytes[i];
+            return value;
+        }
+
+        template<class Word>
+        void store_big_endian(unsigned char* bytes, const Word value)
+        {
+            for (size_t i = 0; i < sizeof(Word); ++i)
+                bytes[i] = static_cast<unsigned char>(value >> (8 * (sizeof(Word) - 1 - i)));
+        }
 
-            std::string output;
-            output.resize(2 * bytes);
+        static constexpr uint32_t SHA256_ROUND_CONSTANTS[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+        };
+
+        static constexpr uint64_t SHA512_ROUND_CONSTANTS[80] = {
+            0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc, 0x3956c25bf348b538,
+            0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118, 0xd807aa98a3030242, 0x12835b0145706fbe,
+            0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2, 0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235,
+            0xc19bf174cf692694, 0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+            0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5, 0x983e5152ee66dfab,
+            0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4, 0xc6e00bf33da88fc2, 0xd5a79147930aa725,
+            0x06ca6351e003826f, 0x142929670a0e6e70, 0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed,
+            0x53380d139d95b3df, 0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
+            0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30, 0xd192e819d6ef5218,
+            0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8, 0x19a4c116b8d2d0c8, 0x1e376c085141ab53,
+            0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8, 0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373,
+            0x682e6ff3d6b2b8a3, 0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+            0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b, 0xca273eceea26619c,
+            0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178, 0x06f067aa72176fba, 0x0a637dc5a2c898a6,
+            0x113f9804bef90dae, 0x1b710b35131c471b, 0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc,
+            0x431d67c49c100d4c, 0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817,
+        };
 
-            size_t current_char = 0;
-            for (size_t i = 0; i < bytes; i++)
+        void sha1_blocks_portable(uint32_t* state, const unsigned char* data, size_t block_count)
+        {
+            for (; block_count != 0; --block_count, data += 64)
             {
-                // high
-                output[current_char] = HEX_MAP[(string[i] & 0xF0) >> 4];
-                ++current_char;
-                // low
-                output[current_char] = HEX_MAP[(string[i] & 0x0F)];
-                ++current_char;
-            }
+                uint32_t w[80];
+                for (int i = 0; i < 16; ++i)
+                    w[i] = load_big_endian<uint32_t>(data + 4 * i);
+                for (int i = 16; i < 80; ++i)
+                    w[i] = rotr<uint32_t>(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 31);
+
+                uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+                for (int i = 0; i < 80; ++i)
+                {
+                    uint32_t f;
+                    if (i < 20)
+                        f = ((b & c) | (~b & d)) + 0x5a827999;
+                    else if (i < 40)
+                        f = (b ^ c ^ d) + 0x6ed9eba1;
+                    else if (i < 60)
+                        f = ((b & c) | (b & d) | (c & d)) + 0x8f1bbcdc;
+                    else
+                        f = (b ^ c ^ d) + 0xca62c1d6;
+
+                    const uint32_t t = rotr<uint32_t>(a, 27) + f + e + w[i];
+                    e = d;
+                    d = c;
+                    c = rotr<uint32_t>(b, 2);
+                    b = a;
+                    a = t;
+                }
 
-            return output;
+                state[0] += a;
+                state[1] += b;
+                state[2] += c;
+                state[3] += d;
+                state[4] += e;
+            }
         }
 
-        class BCryptHasher
+        void sha256_blocks_portable(uint32_t* state, const unsigned char* data, size_t block_count)
         {
-            struct BCryptAlgorithmHandle : Util::ResourceBase
+            for (; block_count != 0; --block_count, data += 64)
             {
-                BCRYPT_ALG_HANDLE handle = nullptr;
+                uint32_t w[64];
+                for (int i = 0; i < 16; ++i)
+                    w[i] = load_big_endian<uint32_t>(data + 4 * i);
+                for (int i = 16; i < 64; ++i)
+                {
+                    const uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                    const uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+                }
 
-                ~BCryptAlgorithmHandle()
+                uint32_t v[8];
+                std::copy(state, state + 8, v);
+                for (int i = 0; i < 64; ++i)
                 {
-                    if (handle) BCryptCloseAlgorithmProvider(handle, 0);
+                    const uint32_t s1 = rotr(v[4], 6) ^ rotr(v[4], 11) ^ rotr(v[4], 25);
+                    const uint32_t ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+                    const uint32_t t1 = v[7] + s1 + ch + SHA256_ROUND_CONSTANTS[i] + w[i];
+                    const uint32_t s0 = rotr(v[0], 2) ^ rotr(v[0], 13) ^ rotr(v[0], 22);
+                    const uint32_t maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+                    std::copy_backward(v, v + 7, v + 8);
+                    v[4] += t1;
+                    v[0] = t1 + s0 + maj;
                 }
-            };
 
-            struct BCryptHashHandle : Util::ResourceBase
+                for (int i = 0; i < 8; ++i)
+                    state[i] += v[i];
+            }
+        }
+
+        void sha512_blocks_portable(uint64_t* state, const unsigned char* data, size_t block_count)
+        {
+            for (; block_count != 0; --block_count, data += 128)
             {
-                BCRYPT_HASH_HANDLE handle = nullptr;
+                uint64_t w[80];
+                for (int i = 0; i < 16; ++i)
+                    w[i] = load_big_endian<uint64_t>(data + 8 * i);
+                for (int i = 16; i < 80; ++i)
+                {
+                    const uint64_t s0 = rotr(w[i - 15], 1) ^ rotr(w[i - 15], 8) ^ (w[i - 15] >> 7);
+                    const uint64_t s1 = rotr(w[i - 2], 19) ^ rotr(w[i - 2], 61) ^ (w[i - 2] >> 6);
+                    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+                }
 
-                ~BCryptHashHandle()
+                uint64_t v[8];
+                std::copy(state, state + 8, v);
+                for (int i = 0; i < 80; ++i)
                 {
-                    if (handle) BCryptDestroyHash(handle);
+                    const uint64_t s1 = rotr(v[4], 14) ^ rotr(v[4], 18) ^ rotr(v[4], 41);
+                    const uint64_t ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+                    const uint64_t t1 = v[7] + s1 + ch + SHA512_ROUND_CONSTANTS[i] + w[i];
+                    const uint64_t s0 = rotr(v[0], 28) ^ rotr(v[0], 34) ^ rotr(v[0], 39);
+                    const uint64_t maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+                    std::copy_backward(v, v + 7, v + 8);
+                    v[4] += t1;
+                    v[0] = t1 + s0 + maj;
                 }
-            };
 
-            static void initialize_hash_handle(BCryptHashHandle& hash_handle,
-                                               const BCryptAlgorithmHandle& algorithm_handle)
+                for (int i = 0; i < 8; ++i)
+                    state[i] += v[i];
+            }
+        }
+
+#if defined(VCPKG_HASH_SHA_NI)
+        bool cpu_has_sha_ni()
+        {
+#if defined(_MSC_VER)
+            int leaf1[4], leaf7[4];
+            __cpuid(leaf1, 1);
+            __cpuidex(leaf7, 7, 0);
+            const unsigned int ecx1 = static_cast<unsigned int>(leaf1[2]);
+            const unsigned int ebx7 = static_cast<unsigned int>(leaf7[1]);
+#else
+            unsigned int eax, ebx, ecx1, edx, ebx7, ecx7;
+            if (!__get_cpuid(1, &eax, &ebx, &ecx1, &edx)) return false;
+            if (!__get_cpuid_count(7, 0, &eax, &ebx7, &ecx7, &edx)) return false;
+#endif
+            const bool has_ssse3 = (ecx1 & (1u << 9)) != 0;
+            const bool has_sse41 = (ecx1 & (1u << 19)) != 0;
+            const bool has_sha = (ebx7 & (1u << 29)) != 0;
+            return has_ssse3 && has_sse41 && has_sha;
+        }
+
+        // Four of SHA-1's 80 rounds. The message schedule is kept in four registers holding 16 words, and each group
+        // extends it for the group three steps ahead.
+        template<int GROUP>
+        VCPKG_TARGET_SHA_NI inline void sha1_ni_group(__m128i& abcd, __m128i (&e)[2], __m128i (&msg)[4])
+        {
+            __m128i& current_e = e[GROUP % 2];
+            const __m128i& w = msg[GROUP % 4];
+            if (GROUP == 0)
+                current_e = _mm_add_epi32(current_e, w);
+            else
+                current_e = _mm_sha1nexte_epu32(current_e, w);
+            e[(GROUP + 1) % 2] = abcd;
+            if (GROUP >= 3 && GROUP <= 18) msg[(GROUP + 1) % 4] = _mm_sha1msg2_epu32(msg[(GROUP + 1) % 4], w);
+            abcd = _mm_sha1rnds4_epu32(abcd, current_e, GROUP / 5);
+            if (GROUP >= 1 && GROUP <= 16) msg[(GROUP + 3) % 4] = _mm_sha1msg1_epu32(msg[(GROUP + 3) % 4], w);
+            if (GROUP >= 2 && GROUP <= 17) msg[(GROUP + 2) % 4] = _mm_xor_si128(msg[(GROUP + 2) % 4], w);
+        }
+
+        template<int... GROUPS>
+        VCPKG_TARGET_SHA_NI inline void sha1_ni_block(__m128i& abcd,
+                                                      __m128i (&e)[2],
+                                                      __m128i (&msg)[4],
+                                                      std::integer_sequence<int, GROUPS...>)
+        {
+            (sha1_ni_group<GROUPS>(abcd, e, msg), ...);
+        }
+
+        VCPKG_TARGET_SHA_NI void sha1_blocks_sha_ni(uint32_t* state, const unsigned char* data, size_t block_count)
+        {
+            const __m128i byte_swap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+            __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+            __m128i e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+
+            for (; block_count != 0; --block_count, data += 64)
+            {
+                const __m128i abcd_save = abcd;
+                const __m128i e0_save = e0;
+
+                __m128i msg[4];
+                for (int i = 0; i < 4; ++i)
+                    msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i)),
+                                              byte_swap);
+
+                __m128i e[2] = {e0, _mm_setzero_si128()};
+                sha1_ni_block(abcd, e, msg, std::make_integer_sequence<int, 20>{});
+
+                e0 = _mm_sha1nexte_epu32(e[0], e0_save);
+                abcd = _mm_add_epi32(abcd, abcd_save);
+            }
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1B));
+            state[4] = static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+        }
+
+        // Four of SHA-256's 64 rounds, extending the message schedule for the group three steps ahead.
+        template<int GROUP>
+        VCPKG_TARGET_SHA_NI inline void sha256_ni_group(__m128i& state0, __m128i& state1, __m128i (&msg)[4])
+        {
+            const __m128i& w = msg[GROUP % 4];
+            __m128i k_plus_w = _mm_add_epi32(
+                w, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&SHA256_ROUND_CONSTANTS[4 * GROUP])));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, k_plus_w);
+            if (GROUP >= 3 && GROUP <= 14)
+            {
+                __m128i& next = msg[(GROUP + 1) % 4];
+                next = _mm_add_epi32(next, _mm_alignr_epi8(w, msg[(GROUP + 3) % 4], 4));
+                next = _mm_sha256msg2_epu32(next, w);
+            }
+            k_plus_w = _mm_shuffle_epi32(k_plus_w, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, k_plus_w);
+            if (GROUP >= 1 && GROUP <= 12) msg[(GROUP + 3) % 4] = _mm_sha256msg1_epu32(msg[(GROUP + 3) % 4], w);
+        }
+
+        template<int... GROUPS>
+        VCPKG_TARGET_SHA_NI inline void sha256_ni_block(__m128i& state0,
+                                                        __m128i& state1,
+                                                        __m128i (&msg)[4],
+                                                        std::integer_sequence<int, GROUPS...>)
+        {
+            (sha256_ni_group<GROUPS>(state0, state1, msg), ...);
+        }
+
+        VCPKG_TARGET_SHA_NI void sha256_blocks_sha_ni(uint32_t* state, const unsigned char* data, size_t block_count)
+        {
+            const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+            // The rounds instruction wants the state as ABEF and CDGH rather than ABCD and EFGH
+            const __m128i dcba = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0])), 0xB1);
+            const __m128i hgfe = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4])), 0x1B);
+            __m128i state0 = _mm_alignr_epi8(dcba, hgfe, 8);
+            __m128i state1 = _mm_blend_epi16(hgfe, dcba, 0xF0);
+
+            for (; block_count != 0; --block_count, data += 64)
             {
-                const NTSTATUS error_code =
-                    BCryptCreateHash(algorithm_handle.handle, &hash_handle.handle, nullptr, 0, nullptr, 0, 0);
-                Checks::check_exit(VCPKG_LINE_INFO, NT_SUCCESS(error_code), "Failed to initialize the hasher");
+                const __m128i state0_save = state0;
+                const __m128i state1_save = state1;
+
+                __m128i msg[4];
+                for (int i = 0; i < 4; ++i)
+                    msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i)),
+                                              byte_swap);
+
+                sha256_ni_block(state0, state1, msg, std::make_integer_sequence<int, 16>{});
+
+                state0 = _mm_add_epi32(state0, state0_save);
+                state1 = _mm_add_epi32(state1, state1_save);
             }
 
-            static void hash_data(BCryptHashHandle& hash_handle, const unsigned char* buffer, const size_t& data_size)
+            const __m128i feba = _mm_shuffle_epi32(state0, 0x1B);
+            const __m128i dchg = _mm_shuffle_epi32(state1, 0xB1);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), _mm_blend_epi16(feba, dchg, 0xF0));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), _mm_alignr_epi8(dchg, feba, 8));
+        }
+#endif
+
+        using Sha32BlockFunction = void (*)(uint32_t*, const unsigned char*, size_t);
+
+        Sha32BlockFunction select_sha1_blocks()
+        {
+#if defined(VCPKG_HASH_SHA_NI)
+            if (cpu_has_sha_ni()) return &sha1_blocks_sha_ni;
+#endif
+            return &sha1_blocks_portable;
+        }
+
+        Sha32BlockFunction select_sha256_blocks()
+        {
+#if defined(VCPKG_HASH_SHA_NI)
+            if (cpu_has_sha_ni()) return &sha256_blocks_sha_ni;
+#endif
+            return &sha256_blocks_portable;
+        }
+
+        struct Sha1Traits
+        {
+            using Word = uint32_t;
+            static constexpr size_t BLOCK_SIZE = 64;
+            static constexpr size_t DIGEST_WORDS = 5;
+            static constexpr Word INITIAL_STATE[8] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+
+            static void process_blocks(Word* state, const unsigned char* data, size_t block_count)
             {
-                const NTSTATUS error_code = BCryptHashData(
-                    hash_handle.handle, const_cast<unsigned char*>(buffer), static_cast<ULONG>(data_size), 0);
-                Checks::check_exit(VCPKG_LINE_INFO, NT_SUCCESS(error_code), "Failed to hash data");
+                static const Sha32BlockFunction BLOCKS = select_sha1_blocks();
+                BLOCKS(state, data, block_count);
             }
+        };
+
+        struct Sha256Traits
+        {
+            using Word = uint32_t;
+            static constexpr size_t BLOCK_SIZE = 64;
+            static constexpr size_t DIGEST_WORDS = 8;
+            static constexpr Word INITIAL_STATE[8] = {
+                0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
 
-            static std::string finalize_hash_handle(const BCryptHashHandle& hash_handle, const ULONG length_in_bytes)
+            static void process_blocks(Word* state, const unsigned char* data, size_t block_count)
             {
-                std::unique_ptr<unsigned char[]> hash_buffer = std::make_unique<UCHAR[]>(length_in_bytes);
-                const NTSTATUS error_code = BCryptFinishHash(hash_handle.handle, hash_buffer.get(), length_in_bytes, 0);
-                Checks::check_exit(VCPKG_LINE_INFO, NT_SUCCESS(error_code), "Failed to finalize the hash");
-                return to_hex(hash_buffer.get(), length_in_bytes);
+                static const Sha32BlockFunction BLOCKS = select_sha256_blocks();
+                BLOCKS(state, data, block_count);
             }
+        };
 
-        public:
-            explicit BCryptHasher(const std::string& hash_type)
+        struct Sha512Traits
+        {
+            using Word = uint64_t;
+            static constexpr size_t BLOCK_SIZE = 128;
+            static constexpr size_t DIGEST_WORDS = 8;
+            static constexpr Word INITIAL_STATE[8] = {0x6a09e667f3bcc908,
+                                                      0xbb67ae8584caa73b,
+                                                      0x3c6ef372fe94f82b,
+                                                      0xa54ff53a5f1d36f1,
+                                                      0x510e527fade682d1,
+                                                      0x9b05688c2b3e6c1f,
+                                                      0x1f83d9abfb41bd6b,
+                                                      0x5be0cd19137e2179};
+
+            static void process_blocks(Word* state, const unsigned char* data, size_t block_count)
             {
-                NTSTATUS error_code =
-                    BCryptOpenAlgorithmProvider(&this->algorithm_handle.handle,
-                                                Strings::to_utf16(Strings::ascii_to_uppercase(hash_type)).c_str(),
-                                                nullptr,
-                                                0);
-                Checks::check_exit(VCPKG_LINE_INFO, NT_SUCCESS(error_code), "Failed to open the algorithm provider");
-
-                DWORD hash_buffer_bytes;
-                DWORD cb_data;
-                error_code = BCryptGetProperty(this->algorithm_handle.handle,
-                                               BCRYPT_HASH_LENGTH,
-                                               reinterpret_cast<PUCHAR>(&hash_buffer_bytes),
-                                               sizeof(DWORD),
-                                               &cb_data,
-                                               0);
-                Checks::check_exit(VCPKG_LINE_INFO, NT_SUCCESS(error_code), "Failed to get hash length");
-                this->length_in_bytes = hash_buffer_bytes;
+                sha512_blocks_portable(state, data, block_count);
             }
+        };
+
+        template<class Traits>
+        struct ShaHasher : Hasher
+        {
+            using Word = typename Traits::Word;
 
-            std::string hash_file(const fs::path& path) const
+            ShaHasher() { clear(); }
+
+            virtual void add_bytes(const void* data, size_t size) override
             {
-                BCryptHashHandle hash_handle;
-                initialize_hash_handle(hash_handle, this->algorithm_handle);
+                auto bytes = static_cast<const unsigned char*>(data);
+                m_total_bytes += size;
+
+                if (m_buffered != 0)
+                {
+                    const size_t taken = std::min(size, Traits::BLOCK_SIZE - m_buffered);
+                    std::copy(bytes, bytes + taken, m_buffer + m_buffered);
+                    m_buffered += taken;
+                    bytes += taken;
+                    size -= taken;
+                    if (m_buffered != Traits::BLOCK_SIZE) return;
+                    Traits::process_blocks(m_state, m_buffer, 1);
+                    m_buffered = 0;
+                }
+
+                const size_t block_count = size / Traits::BLOCK_SIZE;
+                if (block_count != 0) Traits::process_blocks(m_state, bytes, block_count);
+                bytes += block_count * Traits::BLOCK_SIZE;
+                size -= block_count * Traits::BLOCK_SIZE;
 
-                FILE* file = nullptr;
-                const auto ec = _wfopen_s(&file, path.c_str(), L"rb");
-                Checks::check_exit(VCPKG_LINE_INFO, ec == 0, "Failed to open file: %s", path.u8string());
-                if (file != nullptr)
+                std::copy(bytes, bytes + size, m_buffer);
+                m_buffered = size;
+            }
+
+            virtual std::string get_hash() override
+            {
+                // Padding is a one bit, zeros, and the message length in bits in the last 2 * sizeof(Word) bytes
+                const uint64_t total_bytes = m_total_bytes;
+                unsigned char padding[2 * Traits::BLOCK_SIZE] = {0x80};
+                const size_t length_size = 2 * sizeof(Word);
+                size_t padding_size = Traits::BLOCK_SIZE - m_buffered;
+                if (padding_size < 1 + length_size) padding_size += Traits::BLOCK_SIZE;
+                store_big_endian<uint64_t>(padding + padding_size - 8, total_bytes << 3);
+                if (length_size == 16) store_big_endian<uint64_t>(padding + padding_size - 16, total_bytes >> 61);
+                add_bytes(padding, padding_size);
+
+                unsigned char digest[Traits::DIGEST_WORDS * sizeof(Word)];
+                for (size_t i = 0; i < Traits::DIGEST_WORDS; ++i)
+                    store_big_endian<Word>(digest + i * sizeof(Word), m_state[i]);
+
+                static constexpr char HEX_MAP[] = "0123456789abcdef";
+                std::string output;
+                output.reserve(2 * sizeof(digest));
+                for (const unsigned char byte : digest)
                 {
-                    unsigned char buffer[4096];
-                    while (const auto actual_size = fread(buffer, 1, sizeof(buffer), file))
-                    {
-                        hash_data(hash_handle, buffer, actual_size);
-                    }
-                    fclose(file);
+                    output.push_back(HEX_MAP[byte >> 4]);
+                    output.push_back(HEX_MAP[byte & 0x0F]);
                 }
 
-                return finalize_hash_handle(hash_handle, length_in_bytes);
+                clear();
+                return output;
             }
 
-            std::string hash_string(const std::string& s) const
+            virtual void clear() override
             {
-                BCryptHashHandle hash_handle;
-                initialize_hash_handle(hash_handle, this->algorithm_handle);
-                hash_data(hash_handle, reinterpret_cast<const unsigned char*>(s.c_str()), s.size());
-                return finalize_hash_handle(hash_handle, length_in_bytes);
+                std::copy(std::begin(Traits::INITIAL_STATE), std::end(Traits::INITIAL_STATE), m_state);
+                m_buffered = 0;
+                m_total_bytes = 0;
             }
 
         private:
-            BCryptAlgorithmHandle algorithm_handle;
-            ULONG length_in_bytes;
+            Word m_state[8];
+            unsigned char m_buffer[Traits::BLOCK_SIZE];
+            size_t m_buffered;
+            uint64_t m_total_bytes;
         };
     }
 
-    std::string get_file_hash(const Files::Filesystem& fs, const fs::path& path, const std::string& hash_type)
+    std::unique_ptr<Hasher> get_hasher_for(const Algorithm algorithm)
+    {
+        switch (algorithm)
+        {
+            case Algorithm::SHA1: return std::make_unique<ShaHasher<Sha1Traits>>();
+            case Algorithm::SHA256: return std::make_unique<ShaHasher<Sha256Traits>>();
+            case Algorithm::SHA512: return std::make_unique<ShaHasher<Sha512Traits>>();
+            default: Checks::unreachable(VCPKG_LINE_INFO);
+        }
+    }
+
+    static std::unique_ptr<Hasher> get_hasher_or_exit(const std::string& hash_type)
+    {
+        const auto maybe_algorithm = algorithm_from_string(hash_type);
+        if (const auto algorithm = maybe_algorithm.get()) return get_hasher_for(*algorithm);
+        Checks::exit_with_message(
+            VCPKG_LINE_INFO, "Unsupported hash algorithm %s, expected SHA1, SHA256 or SHA512", hash_type);
+    }
+
+    static bool is_git_blob(const std::string& hash_type)
+    {
+        return Strings::case_insensitive_ascii_equals(hash_type, GIT_BLOB);
+    }
+
+    static std::string get_file_hash_uncached(const Files::Filesystem& fs,
+                                              const fs::path& path,
+                                              const std::string& hash_type)
     {
         Checks::check_exit(VCPKG_LINE_INFO, fs.exists(path), "File %s does not exist", path.u8string());
-        return BCryptHasher{hash_type}.hash_file(path);
+        const auto hasher = is_git_blob(hash_type) ? get_hasher_for(Algorithm::SHA1) : get_hasher_or_exit(hash_type);
+
+        const auto maybe_file = fs.map_contents(path);
+        const auto file = maybe_file.get();
+        Checks::check_exit(VCPKG_LINE_INFO, file != nullptr, "Failed to read file: %s", path.u8string());
+
+        const std::string_view contents = (*file)->contents();
+        if (is_git_blob(hash_type))
+        {
+            // The header git hashes in front of the contents of every blob, with its terminating zero
+            const std::string header = Strings::format("blob %zu", contents.size());
+            hasher->add_bytes(header.c_str(), header.size() + 1);
+        }
+        hasher->add_bytes(contents.data(), contents.size());
+        return hasher->get_hash();
     }
 
     std::string get_string_hash(const std::string& s, const std::string& hash_type)
     {
-        verify_has_only_allowed_chars(s);
-        return BCryptHasher{hash_type}.hash_string(s);
+        const auto hasher = get_hasher_or_exit(hash_type);
+        hasher->add_bytes(s.data(), s.size());
+        return hasher->get_hash();
     }
 
-#else
-    static std::string get_digest_size(const std::string& hash_type)
+    namespace
     {
-        if (!Strings::case_insensitive_ascii_starts_with(hash_type, "SHA"))
+        struct CachedFileHash
+        {
+            uintmax_t size;
+            long long write_time;
+            std::string hash;
+        };
+
+        struct FileHashCache
         {
-            Checks::exit_with_message(
-                VCPKG_LINE_INFO, "shasum only supports SHA hashes, but %s was provided", hash_type);
+            fs::path cache_file;
+            bool loaded = false;
+            size_t record_count = 0;
+            /// <summary>Keyed by `<hash type> <path>`.</summary>
+            std::unordered_map<std::string, CachedFileHash> hashes;
+        };
+
+        Util::LockGuarded<FileHashCache> g_file_hash_cache;
+
+        struct GitBlobIds
+        {
+            /// <summary>Empty unless enabled.</summary>
+            fs::path worktree;
+            std::vector<std::string> pathspecs;
+            bool loaded = false;
+            /// <summary>Keyed by path, as `worktree / <path from git>` gives it.</summary>
+            std::unordered_map<std::string, std::string> ids;
+        };
+
+        Util::LockGuarded<GitBlobIds> g_git_blob_ids;
+    }
+
+    /// <summary>Runs git in `worktree` and returns the entries it prints, which are separated by zeros.</summary>
+    static Optional<std::vector<std::string>> list_git_entries(const fs::path& worktree,
+                                                               std::vector<std::string> arguments)
+    {
+        arguments.insert(arguments.begin(), {"-C", worktree.u8string()});
+        const auto output = System::process_execute_and_capture_output(fs::u8path("git"), arguments);
+        if (output.exit_code != 0) return nullopt;
+        return Strings::split(output.output, std::string(1, '\0'));
+    }
+
+    static void load_git_blob_ids(const Files::Filesystem& fs, GitBlobIds& git)
+    {
+        git.loaded = true;
+        if (!fs.exists(git.worktree / ".git")) return;
+
+        // Entries are "<mode> <id> <stage>\ti/<eol> w/<eol> attr/<attributes>\t<path>", with the line endings of the
+        // blob and of the file in the work tree
+        std::vector<std::string> arguments{"ls-files", "-s", "--eol", "-z", "--"};
+        arguments.insert(arguments.end(), git.pathspecs.begin(), git.pathspecs.end());
+        const auto maybe_entries = list_git_entries(git.worktree, arguments);
+        const auto p_entries = maybe_entries.get();
+        if (!p_entries) return;
+
+        std::unordered_map<std::string, std::string> ids;
+        for (auto&& entry : *p_entries)
+        {
+            const auto fields = Strings::split(entry, "\t");
+            if (fields.size() != 3) continue;
+            const auto stage = Strings::split(fields[0], " ");
+            auto eols = Strings::split(fields[1], " ");
+            Util::erase_remove_if(eols, [](const std::string& field) { return field.empty(); });
+            // Symlinks and submodules are not blobs of file contents, and conflicted files have several ids
+            if (stage.size() != 3 || (stage[0] != "100644" && stage[0] != "100755") || stage[2] != "0") continue;
+            // The blob only holds the bytes of the file if git does not convert its line endings
+            if (eols.size() < 2 || eols[0].substr(2) != eols[1].substr(2)) continue;
+            ids.emplace((git.worktree / fs::u8path(fields[2])).u8string(), stage[1]);
         }
 
-        return hash_type.substr(3, hash_type.length() - 3);
+        arguments = {"ls-files", "-m", "-z", "--"};
+        arguments.insert(arguments.end(), git.pathspecs.begin(), git.pathspecs.end());
+        const auto maybe_modified = list_git_entries(git.worktree, arguments);
+        const auto p_modified = maybe_modified.get();
+        if (!p_modified) return;
+
+        for (auto&& path : *p_modified)
+        {
+            ids.erase((git.worktree / fs::u8path(path)).u8string());
+        }
+
+        Debug::println("Took %zu file hashes from git", ids.size());
+        git.ids = std::move(ids);
     }
 
-    static std::string parse_shasum_output(const std::string& shasum_output)
+    void enable_git_blob_ids(const fs::path& worktree, std::vector<std::string> pathspecs)
     {
-        std::vector<std::string> split = Strings::split(shasum_output, " ");
-        Checks::check_exit(VCPKG_LINE_INFO,
-                           split.size() == 3,
-                           "Expected output of the form [hash filename\n] (3 tokens), but got\n"
-                           "[%s] (%s tokens)",
-                           shasum_output,
-                           std::to_string(split.size()));
-
-        return split[0];
+        auto git = g_git_blob_ids.lock();
+        git->worktree = worktree;
+        git->pathspecs = std::move(pathspecs);
+        git->loaded = false;
+        git->ids.clear();
     }
 
-    std::string get_file_hash(const Files::Filesystem& fs, const fs::path& path, const std::string& hash_type)
+    static Optional<std::string> find_git_blob_id(const Files::Filesystem& fs, const fs::path& path)
     {
-        const std::string digest_size = get_digest_size(hash_type);
-        Checks::check_exit(VCPKG_LINE_INFO, fs.exists(path), "File %s does not exist", path.u8string());
+        auto git = g_git_blob_ids.lock();
+        if (git->worktree.empty()) return nullopt;
+        if (!git->loaded) load_git_blob_ids(fs, *git);
 
-        // Try hash-specific tools, like sha512sum
+        const auto it = git->ids.find(path.u8string());
+        if (it == git->ids.end()) return nullopt;
+        return it->second;
+    }
+
+    // Records are `<hash type> <size> <write time> <hash> <path>` lines; a later record for a key replaces earlier ones
+    static void load_file_hash_cache(const Files::Filesystem& fs, FileHashCache& cache)
+    {
+        cache.loaded = true;
+        auto maybe_lines = fs.read_lines(cache.cache_file);
+        auto lines = maybe_lines.get();
+        if (!lines) return;
+
+        for (auto&& line : *lines)
         {
-            const auto ec_data = System::cmd_execute_and_capture_output(
-                Strings::format(R"(sha%ssum "%s")", digest_size, path.u8string()));
-            if (ec_data.exit_code == 0)
-            {
-                return parse_shasum_output(ec_data.output);
-            }
+            char hash_type[16] = {};
+            char hash[129] = {};
+            unsigned long long size;
+            long long write_time;
+            int path_offset = 0;
+            if (std::sscanf(line.c_str(), "%15s %llu %lld %128s %n", hash_type, &size, &write_time, hash, &path_offset) !=
+                    4 ||
+                path_offset == 0)
+                continue;
+
+            ++cache.record_count;
+            cache.hashes[Strings::format("%s %s", hash_type, line.substr(path_offset))] =
+                CachedFileHash{size, write_time, hash};
         }
 
-        // Try shasum
+        // Files that are rehashed after every change leave superseded records behind; compact once they dominate
+        if (cache.record_count > 1000 && cache.record_count > 2 * cache.hashes.size())
         {
-            const auto ec_data = System::cmd_execute_and_capture_output(
-                Strings::format(R"(shasum -a %s "%s")", digest_size, path.u8string()));
-            if (ec_data.exit_code == 0)
+            std::string contents;
+            for (auto&& entry : cache.hashes)
             {
-                return parse_shasum_output(ec_data.output);
+                const auto space = entry.first.find(' ');
+                contents += Strings::format("%s %llu %lld %s %s\n",
+                                            entry.first.substr(0, space),
+                                            static_cast<unsigned long long>(entry.second.size),
+                                            entry.second.write_time,
+                                            entry.second.hash,
+                                            entry.first.substr(space + 1));
             }
-        }
 
-        Checks::exit_with_message(VCPKG_LINE_INFO, "Could not hash file %s with %s", path.u8string(), hash_type);
+            const fs::path tmp_file = cache.cache_file.u8string() + ".tmp";
+            std::ofstream(tmp_file.native(), std::ios::binary | std::ios::trunc) << contents;
+            std::error_code ec;
+            fs::stdfs::rename(tmp_file, cache.cache_file, ec);
+            cache.record_count = cache.hashes.size();
+        }
     }
 
-    std::string get_string_hash(const std::string& s, const std::string& hash_type)
+    void enable_file_hash_cache(const fs::path& cache_file)
     {
-        const std::string digest_size = get_digest_size(hash_type);
-        verify_has_only_allowed_chars(s);
+        auto cache = g_file_hash_cache.lock();
+        cache->cache_file = cache_file;
+        cache->loaded = false;
+        cache->hashes.clear();
+    }
 
-        // Try hash-specific tools, like sha512sum
+    std::string get_file_hash(const Files::Filesystem& fs, const fs::path& path, const std::string& hash_type)
+    {
+        if (is_git_blob(hash_type))
         {
-            const auto ec_data =
-                System::cmd_execute_and_capture_output(Strings::format(R"(echo -n "%s" | sha%ssum)", s, digest_size));
-            if (ec_data.exit_code == 0)
-            {
-                return parse_shasum_output(ec_data.output);
-            }
+            auto maybe_id = find_git_blob_id(fs, path);
+            if (auto p_id = maybe_id.get()) return std::move(*p_id);
         }
 
-        // Try shasum
+        std::error_code ec;
+        const uintmax_t size = fs::stdfs::file_size(path, ec);
+        const auto file_time = fs::stdfs::last_write_time(path, ec);
+        if (ec) return get_file_hash_uncached(fs, path, hash_type);
+
+        const long long write_time = file_time.time_since_epoch().count();
+        const std::string key = Strings::format("%s %s", Strings::ascii_to_uppercase(hash_type), path.u8string());
         {
-            const auto ec_data = System::cmd_execute_and_capture_output(
-                Strings::format(R"(echo -n "%s" | shasum -a %s)", s, digest_size));
-            if (ec_data.exit_code == 0)
-            {
-                return parse_shasum_output(ec_data.output);
-            }
+            auto cache = g_file_hash_cache.lock();
+            if (cache->cache_file.empty()) return get_file_hash_uncached(fs, path, hash_type);
+            if (!cache->loaded) load_file_hash_cache(fs, *cache);
+
+            const auto it = cache->hashes.find(key);
+            if (it != cache->hashes.end() && it->second.size == size && it->second.write_time == write_time)
+                return it->second.hash;
         }
 
-        Checks::exit_with_message(VCPKG_LINE_INFO, "Could not hash input string with %s", hash_type);
+        std::string hash = get_file_hash_uncached(fs, path, hash_type);
+
+        // A file written moments ago may be written again within the same write time tick, so it is not remembered
+        if (fs::stdfs::file_time_type::clock::now() - file_time < std::chrono::seconds(2)) return hash;
+
+        const auto space = key.find(' ');
+        auto cache = g_file_hash_cache.lock();
+        cache->hashes[key] = CachedFileHash{size, write_time, hash};
+        ++cache->record_count;
+        std::ofstream(cache->cache_file.native(), std::ios::binary | std::ios::app)
+            << Strings::format("%s %llu %lld %s %s\n",
+                               key.substr(0, space),
+                               static_cast<unsigned long long>(size),
+                               write_time,
+                               hash,
+                               key.substr(space + 1));
+        return hash;
     }
-#endif
 }
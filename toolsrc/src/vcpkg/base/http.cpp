@@ -0,0 +1,651 @@
+#include "pch.h"
+
+#if !defined(_WIN32)
+
+#include <vcpkg/base/http.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/base/transfers.h>
+#include <vcpkg/base/util.h>
+
+#include <climits>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+
+#if VCPKG_BUILTIN_HTTPS
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#endif
+
+namespace vcpkg::Http
+{
+    static constexpr int MAX_REDIRECTS = 10;
+    static constexpr size_t MAX_IDLE_CONNECTIONS_PER_HOST = 8;
+
+    struct Url
+    {
+        bool is_https = false;
+        std::string host;
+        std::string port;
+        /// <summary>Path and query, always starting with '/'.</summary>
+        std::string target;
+
+        /// <summary>Connections are pooled, and TLS sessions resumed, per origin.</summary>
+        std::string origin() const { return Strings::format("%s://%s:%s", is_https ? "https" : "http", host, port); }
+    };
+
+    static Optional<Url> parse_url(const std::string& text)
+    {
+        Url url;
+        size_t pos;
+        if (Strings::case_insensitive_ascii_starts_with(text, "http://"))
+            pos = 7;
+        else if (Strings::case_insensitive_ascii_starts_with(text, "https://"))
+        {
+            url.is_https = true;
+            pos = 8;
+        }
+        else
+            return nullopt;
+
+        const auto authority_end = std::min(text.find_first_of("/?#", pos), text.size());
+        std::string authority = text.substr(pos, authority_end - pos);
+        if (authority.find('@') != std::string::npos) return nullopt;
+
+        // [::1]:8080 keeps the brackets out of the host name
+        const auto port_colon = authority.rfind(':');
+        if (port_colon != std::string::npos && authority.find(']', port_colon) == std::string::npos)
+        {
+            url.port = authority.substr(port_colon + 1);
+            authority.resize(port_colon);
+        }
+        if (authority.size() >= 2 && authority.front() == '[' && authority.back() == ']')
+            authority = authority.substr(1, authority.size() - 2);
+        if (authority.empty()) return nullopt;
+        url.host = Strings::ascii_to_lowercase(std::move(authority));
+        if (url.port.empty()) url.port = url.is_https ? "443" : "80";
+
+        url.target = text.substr(authority_end, text.find('#', authority_end) - authority_end);
+        if (url.target.empty() || url.target.front() != '/') url.target.insert(0, "/");
+        return url;
+    }
+
+    static std::string resolve_redirect(const Url& base, const std::string& location)
+    {
+        if (Strings::case_insensitive_ascii_starts_with(location, "http://") ||
+            Strings::case_insensitive_ascii_starts_with(location, "https://"))
+            return location;
+
+        const std::string scheme = base.is_https ? "https:" : "http:";
+        if (Strings::case_insensitive_ascii_starts_with(location, "//")) return scheme + location;
+
+        std::string authority = base.host.find(':') == std::string::npos ? base.host : "[" + base.host + "]";
+        authority += ":" + base.port;
+        if (!location.empty() && location.front() == '/') return scheme + "//" + authority + location;
+
+        const auto last_slash = base.target.rfind('/', base.target.find('?'));
+        return scheme + "//" + authority + base.target.substr(0, last_slash + 1) + location;
+    }
+
+    /// <summary>
+    /// Writes to a socket whose peer has gone away raise SIGPIPE in the writing thread, and TLS writes alerts even
+    /// while reading. It is blocked, and a pending one consumed, around every use of a connection instead of being
+    /// ignored process-wide, which child processes would inherit.
+    /// </summary>
+    struct SigpipeBlock
+    {
+        SigpipeBlock()
+        {
+            sigemptyset(&m_sigpipe);
+            sigaddset(&m_sigpipe, SIGPIPE);
+            sigset_t pending;
+            sigpending(&pending);
+            m_was_pending = sigismember(&pending, SIGPIPE) == 1;
+            pthread_sigmask(SIG_BLOCK, &m_sigpipe, &m_old_mask);
+        }
+
+        ~SigpipeBlock()
+        {
+            sigset_t pending;
+            sigpending(&pending);
+            if (!m_was_pending && sigismember(&pending, SIGPIPE) == 1)
+            {
+                static const timespec NO_WAIT = {0, 0};
+                sigtimedwait(&m_sigpipe, nullptr, &NO_WAIT);
+            }
+            pthread_sigmask(SIG_SETMASK, &m_old_mask, nullptr);
+        }
+
+        SigpipeBlock(const SigpipeBlock&) = delete;
+        SigpipeBlock& operator=(const SigpipeBlock&) = delete;
+
+    private:
+        sigset_t m_sigpipe;
+        sigset_t m_old_mask;
+        bool m_was_pending;
+    };
+
+#if VCPKG_BUILTIN_HTTPS
+    static SSL_CTX* tls_context()
+    {
+        static SSL_CTX* const CONTEXT = []() {
+            OPENSSL_init_ssl(0, nullptr);
+            SSL_CTX* context = SSL_CTX_new(TLS_client_method());
+            if (!context) return context;
+            SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION);
+            SSL_CTX_set_default_verify_paths(context);
+            SSL_CTX_set_verify(context, SSL_VERIFY_PEER, nullptr);
+            SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+            return context;
+        }();
+        return CONTEXT;
+    }
+#endif
+
+    struct Connection
+    {
+        std::string origin;
+        int fd = -1;
+#if VCPKG_BUILTIN_HTTPS
+        SSL* ssl = nullptr;
+#endif
+
+        Connection() = default;
+        Connection(const Connection&) = delete;
+        Connection& operator=(const Connection&) = delete;
+
+        ~Connection()
+        {
+#if VCPKG_BUILTIN_HTTPS
+            if (ssl)
+            {
+                SigpipeBlock block;
+                SSL_shutdown(ssl);
+                SSL_free(ssl);
+            }
+#endif
+            if (fd != -1) close(fd);
+        }
+
+        bool write_all(const char* data, size_t size)
+        {
+            while (size > 0)
+            {
+                ssize_t written;
+#if VCPKG_BUILTIN_HTTPS
+                if (ssl)
+                    written = SSL_write(ssl, data, static_cast<int>(std::min<size_t>(size, INT_MAX)));
+                else
+#endif
+                {
+                    written = ::send(fd, data, size, 0);
+                    if (written < 0 && errno == EINTR) continue;
+                }
+                if (written <= 0) return false;
+                data += written;
+                size -= static_cast<size_t>(written);
+            }
+            return true;
+        }
+
+        /// <summary>Reads at least one more byte into the buffer. Returns false at the end of the stream.</summary>
+        bool fill()
+        {
+            if (m_pos != 0)
+            {
+                m_buffer.erase(0, m_pos);
+                m_pos = 0;
+            }
+
+            char chunk[64 * 1024];
+            while (true)
+            {
+                ssize_t n;
+#if VCPKG_BUILTIN_HTTPS
+                if (ssl)
+                    n = SSL_read(ssl, chunk, sizeof(chunk));
+                else
+#endif
+                {
+                    n = ::recv(fd, chunk, sizeof(chunk), 0);
+                    if (n < 0 && errno == EINTR) continue;
+                }
+                if (n <= 0) return false;
+                m_buffer.append(chunk, static_cast<size_t>(n));
+                return true;
+            }
+        }
+
+        bool read_line(std::string& line)
+        {
+            while (true)
+            {
+                const auto end = m_buffer.find('\n', m_pos);
+                if (end != std::string::npos)
+                {
+                    line.assign(m_buffer, m_pos, end - m_pos);
+                    if (!line.empty() && line.back() == '\r') line.pop_back();
+                    m_pos = end + 1;
+                    return true;
+                }
+                if (m_buffer.size() - m_pos > 64 * 1024 || !fill()) return false;
+            }
+        }
+
+        /// <summary>
+        /// Passes the next `size` bytes to `on_data`, or everything up to the end of the stream if `size` is not
+        /// given. Returns false if the stream ends early.
+        /// </summary>
+        bool read_body(Optional<uint64_t> size, const BodyCallback& on_data)
+        {
+            while (true)
+            {
+                const size_t available = m_buffer.size() - m_pos;
+                const auto p_size = size.get();
+                const size_t take = p_size ? static_cast<size_t>(std::min<uint64_t>(*p_size, available)) : available;
+                if (take > 0)
+                {
+                    on_data(std::string_view(m_buffer.data() + m_pos, take));
+                    m_pos += take;
+                    if (p_size) *p_size -= take;
+                }
+                if (p_size && *p_size == 0) return true;
+                if (!fill()) return !p_size;
+            }
+        }
+
+    private:
+        std::string m_buffer;
+        size_t m_pos = 0;
+    };
+
+    struct Pool
+    {
+        std::map<std::string, std::vector<std::unique_ptr<Connection>>> idle;
+#if VCPKG_BUILTIN_HTTPS
+        std::map<std::string, SSL_SESSION*> sessions;
+#endif
+    };
+
+    // Never destroyed: closing TLS connections during static destruction would race OpenSSL's own cleanup
+    static Util::LockGuarded<Pool>& pool()
+    {
+        static auto* const POOL = new Util::LockGuarded<Pool>();
+        return *POOL;
+    }
+
+    static std::unique_ptr<Connection> take_idle(const std::string& origin)
+    {
+        auto locked = pool().lock();
+        auto it = locked->idle.find(origin);
+        if (it == locked->idle.end() || it->second.empty()) return nullptr;
+        auto connection = std::move(it->second.back());
+        it->second.pop_back();
+        return connection;
+    }
+
+    static void return_idle(std::unique_ptr<Connection> connection)
+    {
+        auto locked = pool().lock();
+#if VCPKG_BUILTIN_HTTPS
+        if (connection->ssl)
+        {
+            // Sessions arrive after the handshake in TLS 1.3, so they are saved once a response has been read
+            if (SSL_SESSION* session = SSL_get1_session(connection->ssl))
+            {
+                auto& slot = locked->sessions[connection->origin];
+                if (slot) SSL_SESSION_free(slot);
+                slot = session;
+            }
+        }
+#endif
+        auto& idle = locked->idle[connection->origin];
+        if (idle.size() < MAX_IDLE_CONNECTIONS_PER_HOST) idle.push_back(std::move(connection));
+    }
+
+    static ExpectedT<std::unique_ptr<Connection>, std::string> connect_to(const Url& url)
+    {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addresses = nullptr;
+        const int gai = getaddrinfo(url.host.c_str(), url.port.c_str(), &hints, &addresses);
+        if (gai != 0) return Strings::format("Could not resolve %s: %s", url.host, gai_strerror(gai));
+
+        auto connection = std::make_unique<Connection>();
+        connection->origin = url.origin();
+        int last_errno = 0;
+        for (addrinfo* address = addresses; address; address = address->ai_next)
+        {
+            const int fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (fd == -1)
+            {
+                last_errno = errno;
+                continue;
+            }
+            if (connect(fd, address->ai_addr, address->ai_addrlen) == 0)
+            {
+                connection->fd = fd;
+                break;
+            }
+            last_errno = errno;
+            close(fd);
+        }
+        freeaddrinfo(addresses);
+        if (connection->fd == -1)
+            return Strings::format("Could not connect to %s:%s: %s", url.host, url.port, std::strerror(last_errno));
+
+        // A stalled server fails the transfer instead of hanging the build
+        const timeval timeout = {60, 0};
+        setsockopt(connection->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(connection->fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        const int one = 1;
+        setsockopt(connection->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#if defined(SO_NOSIGPIPE)
+        setsockopt(connection->fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+        if (!url.is_https) return connection;
+
+#if VCPKG_BUILTIN_HTTPS
+        SSL_CTX* const context = tls_context();
+        if (!context) return std::string("Could not initialize TLS");
+        connection->ssl = SSL_new(context);
+        if (!connection->ssl) return std::string("Could not initialize TLS");
+        SSL_set_fd(connection->ssl, connection->fd);
+        SSL_set_tlsext_host_name(connection->ssl, url.host.c_str());
+        SSL_set1_host(connection->ssl, url.host.c_str());
+        {
+            auto locked = pool().lock();
+            const auto it = locked->sessions.find(connection->origin);
+            if (it != locked->sessions.end()) SSL_set_session(connection->ssl, it->second);
+        }
+
+        SigpipeBlock block;
+        if (SSL_connect(connection->ssl) != 1)
+        {
+            char message[256];
+            ERR_error_string_n(ERR_get_error(), message, sizeof(message));
+            const long verify_result = SSL_get_verify_result(connection->ssl);
+            return Strings::format("TLS handshake with %s failed: %s",
+                                   url.host,
+                                   verify_result != X509_V_OK ? X509_verify_cert_error_string(verify_result) : message);
+        }
+        return connection;
+#else
+        return Strings::format("%s: this vcpkg was built without HTTPS support", url.host);
+#endif
+    }
+
+    static bool is_supported(const Url& url)
+    {
+#if !VCPKG_BUILTIN_HTTPS
+        if (url.is_https) return false;
+#endif
+        std::vector<std::string> proxy_variables = {"all_proxy", "ALL_PROXY"};
+        proxy_variables.push_back(url.is_https ? "https_proxy" : "http_proxy");
+        proxy_variables.push_back(url.is_https ? "HTTPS_PROXY" : "HTTP_PROXY");
+        for (auto&& name : proxy_variables)
+        {
+            const auto maybe_proxy = System::get_environment_variable(name);
+            if (const auto p_proxy = maybe_proxy.get())
+            {
+                if (!p_proxy->empty()) return false;
+            }
+        }
+        return true;
+    }
+
+    bool is_supported(const std::string& url)
+    {
+        const auto maybe_url = parse_url(url);
+        const auto p_url = maybe_url.get();
+        return p_url && is_supported(*p_url);
+    }
+
+    static bool parse_status_line(const std::string& line, int& status, bool& is_http_10)
+    {
+        if (!Strings::case_insensitive_ascii_starts_with(line, "HTTP/1.") || line.size() < 12 || line[8] != ' ')
+            return false;
+        is_http_10 = line[7] == '0';
+        status = std::atoi(line.c_str() + 9);
+        return status >= 100 && status < 600;
+    }
+
+    static std::string trim(const std::string& s)
+    {
+        const auto first = s.find_first_not_of(" \t");
+        if (first == std::string::npos) return std::string();
+        return s.substr(first, s.find_last_not_of(" \t") - first + 1);
+    }
+
+    enum class Outcome
+    {
+        DONE,
+        /// <summary>A pooled connection the server had already closed; the request can be sent again.</summary>
+        STALE,
+        FAILED,
+    };
+
+    /// <summary>
+    /// One request and response over `connection`, which goes back to the pool if it can be reused. `reused` is
+    /// whether it came from the pool.
+    /// </summary>
+    static Outcome exchange(std::unique_ptr<Connection> connection,
+                            const bool reused,
+                            const Url& url,
+                            const Request& request,
+                            const std::function<bool(const Response&)>& wants_body,
+                            const BodyCallback& on_body,
+                            Transfers::Slot& slot,
+                            Response& response,
+                            std::string& error)
+    {
+        SigpipeBlock block;
+        const bool is_head = request.method == "HEAD";
+
+        std::string header = Strings::format("%s %s HTTP/1.1\r\n", request.method, url.target);
+        const bool default_port = url.port == (url.is_https ? "443" : "80");
+        const std::string host = url.host.find(':') == std::string::npos ? url.host : "[" + url.host + "]";
+        header += "Host: " + (default_port ? host : host + ":" + url.port) + "\r\n";
+        header += "User-Agent: vcpkg\r\nAccept-Encoding: identity\r\n";
+        for (auto&& extra : request.headers)
+            header += extra + "\r\n";
+
+        std::ifstream upload;
+        uint64_t upload_remaining = 0;
+        if (!request.upload.empty())
+        {
+            std::error_code ec;
+            const uint64_t size = fs::stdfs::file_size(request.upload, ec);
+            upload.open(request.upload.native().c_str(), std::ios::binary);
+            upload_remaining = request.upload_length.value_or(size - std::min(size, request.upload_offset));
+            if (ec || !upload || request.upload_offset + upload_remaining > size ||
+                !upload.seekg(static_cast<std::streamoff>(request.upload_offset)))
+            {
+                error = "Could not read " + request.upload.u8string();
+                return Outcome::FAILED;
+            }
+            header += Strings::format("Content-Length: %llu\r\n", static_cast<unsigned long long>(upload_remaining));
+        }
+        else if (!request.body.empty() || request.method == "PUT" || request.method == "POST")
+            header += Strings::format("Content-Length: %zd\r\n", request.body.size());
+        header += "\r\n";
+        if (request.upload.empty()) header += request.body;
+
+        bool sent = connection->write_all(header.data(), header.size());
+        char chunk[64 * 1024];
+        while (sent && upload_remaining > 0)
+        {
+            upload.read(chunk, static_cast<std::streamsize>(std::min<uint64_t>(upload_remaining, sizeof(chunk))));
+            const auto count = static_cast<size_t>(upload.gcount());
+            if (count == 0)
+            {
+                // The file shrank; the server still waits for the rest, so the connection cannot be used again
+                error = "Could not read " + request.upload.u8string();
+                return Outcome::FAILED;
+            }
+            slot.throttle(count);
+            sent = connection->write_all(chunk, count);
+            upload_remaining -= count;
+        }
+
+        std::string line;
+        bool is_http_10 = false;
+        do
+        {
+            if (!connection->read_line(line))
+            {
+                // A pooled connection the server closed while idle ends before any response
+                if (reused && response.status == 0) return Outcome::STALE;
+                error = Strings::format("No HTTP response from %s:%s", url.host, url.port);
+                return Outcome::FAILED;
+            }
+            if (!parse_status_line(line, response.status, is_http_10))
+            {
+                error = Strings::format("Invalid HTTP response from %s:%s", url.host, url.port);
+                return Outcome::FAILED;
+            }
+
+            response.headers.clear();
+            while (true)
+            {
+                if (!connection->read_line(line))
+                {
+                    error = Strings::format("Truncated HTTP response from %s:%s", url.host, url.port);
+                    return Outcome::FAILED;
+                }
+                if (line.empty()) break;
+                const auto colon = line.find(':');
+                if (colon == std::string::npos) continue;
+                response.headers[Strings::ascii_to_lowercase(line.substr(0, colon))] = trim(line.substr(colon + 1));
+            }
+            // 1xx responses are followed by the real one
+        } while (response.status < 200);
+
+        if (!sent)
+        {
+            // The server answered before reading everything, typically with an error; the connection is unusable
+            return Outcome::DONE;
+        }
+
+        const auto header_value = [&](const std::string& name) -> std::string {
+            const auto it = response.headers.find(name);
+            return it == response.headers.end() ? std::string() : Strings::ascii_to_lowercase(it->second);
+        };
+
+        const std::string connection_header = header_value("connection");
+        bool keep_alive = is_http_10 ? connection_header.find("keep-alive") != std::string::npos
+                                     : connection_header.find("close") == std::string::npos;
+
+        const bool deliver = wants_body(response);
+        const BodyCallback sink = [&](std::string_view data) {
+            slot.throttle(data.size());
+            if (deliver) on_body(data);
+        };
+
+        bool complete;
+        if (is_head || response.status == 204 || response.status == 304)
+            complete = true;
+        else if (header_value("transfer-encoding").find("chunked") != std::string::npos)
+        {
+            complete = false;
+            while (connection->read_line(line))
+            {
+                const uint64_t chunk_size = std::strtoull(line.c_str(), nullptr, 16);
+                if (chunk_size == 0)
+                {
+                    // Trailers end with an empty line
+                    while (connection->read_line(line) && !line.empty())
+                    {
+                    }
+                    complete = line.empty();
+                    break;
+                }
+                if (!connection->read_body(chunk_size, sink) || !connection->read_line(line)) break;
+            }
+        }
+        else
+        {
+            const std::string length = header_value("content-length");
+            if (!length.empty())
+                complete = connection->read_body(std::strtoull(length.c_str(), nullptr, 10), sink);
+            else
+            {
+                keep_alive = false;
+                complete = connection->read_body(nullopt, sink);
+            }
+        }
+
+        if (!complete)
+        {
+            error = Strings::format("Truncated HTTP response from %s:%s", url.host, url.port);
+            return Outcome::FAILED;
+        }
+
+        if (keep_alive) return_idle(std::move(connection));
+        return Outcome::DONE;
+    }
+
+    ExpectedT<Response, std::string> send(const Request& request,
+                                          const std::function<bool(const Response&)>& wants_body,
+                                          const BodyCallback& on_body)
+    {
+        std::string current_url = request.url;
+        const bool follows_redirects = request.method == "GET" || request.method == "HEAD";
+        for (int redirects = 0;; ++redirects)
+        {
+            const auto maybe_url = parse_url(current_url);
+            const auto p_url = maybe_url.get();
+            if (!p_url || !is_supported(*p_url)) return "Unsupported URL: " + current_url;
+
+            const auto is_redirect = [&](const Response& response) {
+                return follows_redirects && response.headers.count("location") != 0 &&
+                       (response.status == 301 || response.status == 302 || response.status == 303 ||
+                        response.status == 307 || response.status == 308);
+            };
+            const auto wants_final_body = [&](const Response& response) {
+                return !is_redirect(response) && wants_body(response);
+            };
+
+            // Each hop of a redirect waits for its own host
+            Transfers::Slot slot(current_url);
+            Response response;
+            std::string error;
+            Outcome outcome = Outcome::STALE;
+            // Stale pooled connections are dropped one by one until a new connection is made at the latest
+            while (outcome == Outcome::STALE)
+            {
+                auto connection = take_idle(p_url->origin());
+                const bool reused = connection != nullptr;
+                if (!reused)
+                {
+                    auto maybe_connection = connect_to(*p_url);
+                    if (auto p_connection = maybe_connection.get())
+                        connection = std::move(*p_connection);
+                    else
+                        return maybe_connection.error();
+                }
+                outcome = exchange(std::move(connection),
+                                   reused,
+                                   *p_url,
+                                   request,
+                                   wants_final_body,
+                                   on_body,
+                                   slot,
+                                   response,
+                                   error);
+            }
+            if (outcome != Outcome::DONE) return error.empty() ? "HTTP request failed: " + current_url : error;
+
+            if (!is_redirect(response)) return response;
+            if (redirects == MAX_REDIRECTS) return "Too many redirects: " + request.url;
+            current_url = resolve_redirect(*p_url, response.headers["location"]);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,153 @@
+#include "pch.h"
+
+#include <vcpkg/base/checks.h>
+#include <vcpkg/base/json.h>
+
+namespace vcpkg::Json
+{
+    static constexpr size_t FLUSH_SIZE = 64 * 1024;
+
+    void append_string(std::string& out, std::string_view s)
+    {
+        static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+        out.push_back('"');
+        for (const char c : s)
+        {
+            switch (c)
+            {
+                case '"': out.append("\\\""); break;
+                case '\\': out.append("\\\\"); break;
+                case '\n': out.append("\\n"); break;
+                case '\r': out.append("\\r"); break;
+                case '\t': out.append("\\t"); break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20)
+                    {
+                        out.append("\\u00");
+                        out.push_back(HEX_DIGITS[c >> 4]);
+                        out.push_back(HEX_DIGITS[c & 0xF]);
+                    }
+                    else
+                    {
+                        out.push_back(c);
+                    }
+            }
+        }
+        out.push_back('"');
+    }
+
+    Writer::Writer() : Writer([](std::string_view chunk) { fwrite(chunk.data(), 1, chunk.size(), stdout); }) {}
+
+    Writer::Writer(std::function<void(std::string_view)> sink) : m_sink(std::move(sink)) {}
+
+    Writer::~Writer() { flush(); }
+
+    void Writer::flush()
+    {
+        if (m_buffer.empty()) return;
+        m_sink(m_buffer);
+        m_buffer.clear();
+    }
+
+    void Writer::start_value()
+    {
+        if (m_after_key)
+        {
+            m_after_key = false;
+            return;
+        }
+        if (m_has_members.empty()) return;
+        if (m_has_members.back()) m_buffer.push_back(',');
+        m_has_members.back() = true;
+    }
+
+    void Writer::end_value()
+    {
+        if (!m_has_members.empty())
+        {
+            if (m_buffer.size() >= FLUSH_SIZE) flush();
+            return;
+        }
+
+        // The document is complete
+        m_buffer.push_back('\n');
+        flush();
+    }
+
+    Writer& Writer::start_object()
+    {
+        start_value();
+        m_buffer.push_back('{');
+        m_has_members.push_back(false);
+        return *this;
+    }
+
+    Writer& Writer::end_object()
+    {
+        Checks::check_exit(VCPKG_LINE_INFO, !m_has_members.empty() && !m_after_key);
+        m_buffer.push_back('}');
+        m_has_members.pop_back();
+        end_value();
+        return *this;
+    }
+
+    Writer& Writer::start_array()
+    {
+        start_value();
+        m_buffer.push_back('[');
+        m_has_members.push_back(false);
+        return *this;
+    }
+
+    Writer& Writer::end_array()
+    {
+        Checks::check_exit(VCPKG_LINE_INFO, !m_has_members.empty() && !m_after_key);
+        m_buffer.push_back(']');
+        m_has_members.pop_back();
+        end_value();
+        return *this;
+    }
+
+    Writer& Writer::key(std::string_view name)
+    {
+        Checks::check_exit(VCPKG_LINE_INFO, !m_has_members.empty() && !m_after_key);
+        start_value();
+        append_string(m_buffer, name);
+        m_buffer.push_back(':');
+        m_after_key = true;
+        return *this;
+    }
+
+    Writer& Writer::string(std::string_view s)
+    {
+        start_value();
+        append_string(m_buffer, s);
+        end_value();
+        return *this;
+    }
+
+    Writer& Writer::number(int64_t n)
+    {
+        start_value();
+        m_buffer.append(std::to_string(n));
+        end_value();
+        return *this;
+    }
+
+    Writer& Writer::boolean(bool b)
+    {
+        start_value();
+        m_buffer.append(b ? "true" : "false");
+        end_value();
+        return *this;
+    }
+
+    Writer& Writer::null()
+    {
+        start_value();
+        m_buffer.append("null");
+        end_value();
+        return *this;
+    }
+}
@@ -0,0 +1,186 @@
+#include "pch.h"
+
+#include <vcpkg/base/checks.h>
+#include <vcpkg/base/openmetrics.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/base/util.h>
+
+namespace vcpkg::OpenMetrics
+{
+    static constexpr double BUCKET_BOUNDS[] = {0.1, 0.5, 1, 5, 10, 30, 60, 300, 900, 1800, 3600};
+    static constexpr const char* BUCKET_LABELS[] = {
+        "0.1", "0.5", "1", "5", "10", "30", "60", "300", "900", "1800", "3600"};
+    static constexpr size_t BUCKET_COUNT = sizeof(BUCKET_BOUNDS) / sizeof(BUCKET_BOUNDS[0]);
+
+    namespace
+    {
+        struct Series
+        {
+            /// <summary>The value of a counter, or the sum of the observations of a histogram</summary>
+            double sum = 0.0;
+            uint64_t count = 0;
+            /// <summary>Observations per bucket, each counted only in the lowest bucket it fits</summary>
+            std::array<uint64_t, BUCKET_COUNT> buckets{};
+        };
+
+        struct Family
+        {
+            std::string help;
+            bool is_histogram;
+            std::map<Labels, Series> series;
+        };
+
+        struct State
+        {
+            fs::path path;
+            std::map<std::string, Family> families;
+        };
+    }
+
+    static std::atomic<bool> g_enabled{false};
+    static Util::LockGuarded<State> g_state;
+
+    void enable(const fs::path& path)
+    {
+        g_state.lock()->path = path;
+        g_enabled = true;
+    }
+
+    bool is_enabled() { return g_enabled; }
+
+    static Series& get_series(State& state, const char* name, const char* help, bool is_histogram, Labels&& labels)
+    {
+        Family& family = state.families.emplace(name, Family{help, is_histogram, {}}).first->second;
+        Checks::check_exit(VCPKG_LINE_INFO, family.is_histogram == is_histogram, "%s changed its type", name);
+        Util::sort(labels);
+        return family.series[std::move(labels)];
+    }
+
+    void add_counter(const char* name, const char* help, Labels labels, double value)
+    {
+        if (!g_enabled) return;
+
+        auto state = g_state.lock();
+        get_series(*state, name, help, false, std::move(labels)).sum += value;
+    }
+
+    void observe_seconds(const char* name, const char* help, Labels labels, std::chrono::microseconds duration)
+    {
+        if (!g_enabled) return;
+
+        const double seconds = duration.count() / 1e6;
+        auto state = g_state.lock();
+        Series& series = get_series(*state, name, help, true, std::move(labels));
+        series.sum += seconds;
+        ++series.count;
+        const auto bucket = std::lower_bound(std::begin(BUCKET_BOUNDS), std::end(BUCKET_BOUNDS), seconds);
+        if (bucket != std::end(BUCKET_BOUNDS)) ++series.buckets[bucket - std::begin(BUCKET_BOUNDS)];
+    }
+
+    static void append_escaped(std::string& out, const std::string& value, bool is_help)
+    {
+        for (const char c : value)
+        {
+            switch (c)
+            {
+                case '\\': out.append("\\\\"); break;
+                case '\n': out.append("\\n"); break;
+                case '"':
+                    if (is_help)
+                        out.push_back(c);
+                    else
+                        out.append("\\\"");
+                    break;
+                default: out.push_back(c);
+            }
+        }
+    }
+
+    static void append_sample(std::string& out,
+                              const std::string& name,
+                              const Labels& labels,
+                              const char* le,
+                              const std::string& value)
+    {
+        out.append(name);
+        if (!labels.empty() || le)
+        {
+            out.push_back('{');
+            bool first = true;
+            for (auto&& label : labels)
+            {
+                if (!first) out.push_back(',');
+                first = false;
+                out.append(label.first);
+                out.append("=\"");
+                append_escaped(out, label.second, false);
+                out.push_back('"');
+            }
+            if (le)
+            {
+                if (!first) out.push_back(',');
+                Strings::append_to(out, "le=\"%s\"", le);
+            }
+            out.push_back('}');
+        }
+        Strings::append_to(out, " %s\n", value);
+    }
+
+    static std::string format_number(double value)
+    {
+        // Counts and byte counts print as integers
+        if (value == std::floor(value) && std::abs(value) < 9007199254740992.0) return Strings::format("%.0f", value);
+        return Strings::format("%.6f", value);
+    }
+
+    void write()
+    {
+        if (!g_enabled) return;
+
+        auto state = g_state.lock();
+        std::string text;
+        for (auto&& family : state->families)
+        {
+            const std::string& name = family.first;
+            text.append("# HELP ");
+            text.append(name);
+            text.push_back(' ');
+            append_escaped(text, family.second.help, true);
+            Strings::append_to(text, "\n# TYPE %s %s\n", name, family.second.is_histogram ? "histogram" : "counter");
+
+            for (auto&& series : family.second.series)
+            {
+                const Labels& labels = series.first;
+                const Series& values = series.second;
+                if (!family.second.is_histogram)
+                {
+                    append_sample(text, name, labels, nullptr, format_number(values.sum));
+                    continue;
+                }
+
+                uint64_t cumulative = 0;
+                for (size_t i = 0; i < BUCKET_COUNT; ++i)
+                {
+                    cumulative += values.buckets[i];
+                    append_sample(text, name + "_bucket", labels, BUCKET_LABELS[i], std::to_string(cumulative));
+                }
+                append_sample(text, name + "_bucket", labels, "+Inf", std::to_string(values.count));
+                append_sample(text, name + "_sum", labels, nullptr, format_number(values.sum));
+                append_sample(text, name + "_count", labels, nullptr, std::to_string(values.count));
+            }
+        }
+
+        // The collector may read the file at any moment, so it only ever sees a complete one
+        auto& filesystem = Files::get_real_filesystem();
+        const fs::path temp_path = state->path.u8string() + ".tmp";
+        std::error_code ec;
+        filesystem.write_contents(temp_path, text, ec);
+        if (!ec) filesystem.rename(temp_path, state->path, ec);
+        if (ec)
+        {
+            System::println(
+                System::Color::warning, "Warning: failed to write %s: %s", state->path.u8string(), ec.message());
+        }
+    }
+}
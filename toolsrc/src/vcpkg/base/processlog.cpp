@@ -0,0 +1,107 @@
+#include "pch.h"
+
+#include <vcpkg/base/json.h>
+#include <vcpkg/base/processlog.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/base/trace.h>
+#include <vcpkg/base/util.h>
+
+namespace vcpkg::ProcessLog
+{
+    namespace
+    {
+        struct Entry
+        {
+            std::string command_line;
+            std::string cwd;
+            const char* category;
+            double start_us;
+            double duration_us;
+            int exit_code;
+            uint64_t output_bytes;
+        };
+
+        struct State
+        {
+            fs::path path;
+            std::vector<Entry> entries;
+        };
+    }
+
+    static std::atomic<bool> g_enabled{false};
+    static Chrono::ElapsedTimer g_start;
+    static Util::LockGuarded<State> g_state;
+
+    void enable(const fs::path& path)
+    {
+        g_state.lock()->path = path;
+        g_start = Chrono::ElapsedTimer::create_started();
+        g_enabled = true;
+    }
+
+    bool is_enabled() { return g_enabled; }
+
+    Spawn::Spawn(std::string command_line)
+        : m_command_line(g_enabled ? std::move(command_line) : std::string())
+        , m_category(Trace::current_category())
+        , m_start_us(g_enabled ? g_start.microseconds() : -1.0)
+    {
+        if (m_start_us < 0) return;
+
+        std::error_code ec;
+        m_cwd = fs::stdfs::current_path(ec).u8string();
+    }
+
+    void Spawn::finish(int exit_code)
+    {
+        if (m_start_us < 0) return;
+
+        const double end_us = g_start.microseconds();
+        g_state.lock()->entries.push_back({std::move(m_command_line),
+                                           std::move(m_cwd),
+                                           m_category,
+                                           m_start_us,
+                                           end_us - m_start_us,
+                                           exit_code,
+                                           m_output_bytes});
+        m_start_us = -1.0;
+    }
+
+    void write()
+    {
+        if (!g_enabled) return;
+
+        auto state = g_state.lock();
+        // Processes run in parallel finish out of order
+        std::stable_sort(state->entries.begin(), state->entries.end(), [](const Entry& lhs, const Entry& rhs) {
+            return lhs.start_us < rhs.start_us;
+        });
+
+        std::string text;
+        for (auto&& entry : state->entries)
+        {
+            text.append("{\"command\":");
+            Json::append_string(text, entry.command_line);
+            text.append(",\"cwd\":");
+            Json::append_string(text, entry.cwd);
+            Strings::append_to(text,
+                               R"(,"category":"%s","start_us":%.0f,"duration_us":%.0f,"exit_code":%d,)"
+                               R"("output_bytes":%llu})",
+                               entry.category,
+                               entry.start_us,
+                               entry.duration_us,
+                               entry.exit_code,
+                               static_cast<unsigned long long>(entry.output_bytes));
+            text.push_back('\n');
+        }
+
+        std::error_code ec;
+        Files::get_real_filesystem().write_contents(state->path, text, ec);
+        if (ec)
+        {
+            System::println(
+                System::Color::warning, "Warning: failed to write %s: %s", state->path.u8string(), ec.message());
+        }
+    }
+}
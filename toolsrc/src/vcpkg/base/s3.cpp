@@ -0,0 +1,479 @@
+#include "pch.h"
+
+#include <vcpkg/base/chrono.h>
+#include <vcpkg/base/hash.h>
+#include <vcpkg/base/http.h>
+#include <vcpkg/base/s3.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/base/threadpool.h>
+
+namespace vcpkg::S3
+{
+    /// <summary>
+    /// Objects larger than this are transferred in parts of this size, or of the size that keeps an upload within
+    /// MAX_PARTS, with up to TRANSFER_CONNECTIONS parts at once.
+    /// </summary>
+    static constexpr uint64_t PART_SIZE = 32 * 1024 * 1024;
+    static constexpr uint64_t MAX_PARTS = 10000;
+    static constexpr size_t TRANSFER_CONNECTIONS = 8;
+
+    static constexpr const char* EMPTY_PAYLOAD_HASH =
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+    /// <summary>Files are not read twice to sign their hash; TLS already protects them in transit</summary>
+    static constexpr const char* UNSIGNED_PAYLOAD = "UNSIGNED-PAYLOAD";
+
+    static std::string sha256_hex(std::string_view data)
+    {
+        const auto hasher = Hash::get_hasher_for(Hash::Algorithm::SHA256);
+        hasher->add_bytes(data.data(), data.size());
+        return hasher->get_hash();
+    }
+
+    static std::string hex_to_bytes(const std::string& hex)
+    {
+        const auto digit = [](const char c) { return c <= '9' ? c - '0' : c - 'a' + 10; };
+        std::string ret;
+        for (size_t i = 0; i + 1 < hex.size(); i += 2)
+        {
+            ret.push_back(static_cast<char>(digit(hex[i]) * 16 + digit(hex[i + 1])));
+        }
+        return ret;
+    }
+
+    static std::string hmac_sha256_hex(std::string key, std::string_view message)
+    {
+        static constexpr size_t BLOCK_SIZE = 64;
+        if (key.size() > BLOCK_SIZE) key = hex_to_bytes(sha256_hex(key));
+        key.resize(BLOCK_SIZE, '\0');
+
+        const auto hasher = Hash::get_hasher_for(Hash::Algorithm::SHA256);
+        std::string pad(BLOCK_SIZE, '\0');
+        for (size_t i = 0; i < BLOCK_SIZE; ++i)
+        {
+            pad[i] = static_cast<char>(key[i] ^ 0x36);
+        }
+        hasher->add_bytes(pad.data(), pad.size());
+        hasher->add_bytes(message.data(), message.size());
+        const std::string inner = hex_to_bytes(hasher->get_hash());
+
+        for (size_t i = 0; i < BLOCK_SIZE; ++i)
+        {
+            pad[i] = static_cast<char>(key[i] ^ 0x5c);
+        }
+        hasher->add_bytes(pad.data(), pad.size());
+        hasher->add_bytes(inner.data(), inner.size());
+        return hasher->get_hash();
+    }
+
+    static std::string hmac_sha256(std::string key, std::string_view message)
+    {
+        return hex_to_bytes(hmac_sha256_hex(std::move(key), message));
+    }
+
+    /// <summary>Percent-encodes all but the unreserved characters of RFC 3986, and `/` too unless `in_path`</summary>
+    static std::string uri_encode(const std::string& s, const bool in_path)
+    {
+        std::string ret;
+        for (const char c : s)
+        {
+            if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' || c == '_' ||
+                c == '.' || c == '~' || (in_path && c == '/'))
+                ret.push_back(c);
+            else
+                Strings::append_to(ret, "%%%02X", static_cast<unsigned int>(static_cast<unsigned char>(c)));
+        }
+        return ret;
+    }
+
+    /// <summary>The current time as `YYYYMMDDTHHMMSSZ`</summary>
+    static std::string amz_date()
+    {
+        // `YYYY-MM-DDTHH:MM:SS.0Z`
+        const std::string now = Chrono::CTime::get_current_date_time().value_or_exit(VCPKG_LINE_INFO).to_string();
+        std::string ret;
+        for (const char c : now.substr(0, 19))
+        {
+            if (c != '-' && c != ':') ret.push_back(c);
+        }
+        ret.push_back('Z');
+        return ret;
+    }
+
+    /// <summary>The text of the first `<name>` element of `xml`, or an empty string</summary>
+    static std::string xml_element(const std::string& xml, const std::string& name)
+    {
+        const std::string open = "<" + name + ">";
+        const auto begin = xml.find(open);
+        if (begin == std::string::npos) return {};
+        const auto end = xml.find("</" + name + ">", begin);
+        if (end == std::string::npos) return {};
+        return xml.substr(begin + open.size(), end - begin - open.size());
+    }
+
+    Bucket Bucket::from_environment(const std::string& name)
+    {
+        const auto env = [](const char* variable) {
+            return System::get_environment_variable(variable).value_or(std::string());
+        };
+
+        std::string region = env("AWS_REGION");
+        if (region.empty()) region = env("AWS_DEFAULT_REGION");
+        if (region.empty()) region = "us-east-1";
+
+        std::string endpoint = env("AWS_ENDPOINT_URL");
+        if (endpoint.empty()) endpoint = "https://s3." + region + ".amazonaws.com";
+
+        Optional<Credentials> credentials;
+        Credentials from_env{env("AWS_ACCESS_KEY_ID"), env("AWS_SECRET_ACCESS_KEY"), env("AWS_SESSION_TOKEN")};
+        if (!from_env.access_key_id.empty() && !from_env.secret_access_key.empty())
+            credentials = std::move(from_env);
+
+        return Bucket(endpoint, std::move(region), name, std::move(credentials));
+    }
+
+    Bucket::Bucket(const std::string& endpoint,
+                   std::string region,
+                   std::string name,
+                   Optional<Credentials> credentials)
+        : m_endpoint(endpoint)
+        , m_region(std::move(region))
+        , m_name(std::move(name))
+        , m_credentials(std::move(credentials))
+    {
+        while (Strings::ends_with(m_endpoint, "/"))
+            m_endpoint.pop_back();
+
+        // Signed as the Host header the HTTP clients send, which leaves out a default port
+        const auto scheme_end = m_endpoint.find("://");
+        m_host = scheme_end == std::string::npos ? m_endpoint : m_endpoint.substr(scheme_end + 3);
+        const bool is_https = Strings::case_insensitive_ascii_starts_with(m_endpoint, "https://");
+        if (is_https ? Strings::ends_with(m_host, ":443") : Strings::ends_with(m_host, ":80"))
+            m_host.erase(m_host.rfind(':'));
+    }
+
+    std::string Bucket::location(const std::string& key) const { return "s3://" + m_name + "/" + key; }
+
+    Bucket::Target Bucket::target(const std::string& key, const std::string& canonical_query) const
+    {
+        Target ret;
+        ret.canonical_uri = "/" + uri_encode(m_name, false) + "/" + uri_encode(key, true);
+        ret.canonical_query = canonical_query;
+        ret.url = m_endpoint + ret.canonical_uri;
+        if (!canonical_query.empty()) ret.url += "?" + canonical_query;
+        return ret;
+    }
+
+    std::vector<std::string> Bucket::sign(const std::string& method,
+                                          const Target& target,
+                                          const std::string& payload_hash) const
+    {
+        const auto p_credentials = m_credentials.get();
+        if (!p_credentials) return {};
+
+        const std::string date_time = amz_date();
+        const std::string date = date_time.substr(0, 8);
+
+        // In the order of their names, as the canonical request lists them
+        std::vector<std::pair<std::string, std::string>> headers = {
+            {"host", m_host}, {"x-amz-content-sha256", payload_hash}, {"x-amz-date", date_time}};
+        if (!p_credentials->session_token.empty())
+            headers.emplace_back("x-amz-security-token", p_credentials->session_token);
+
+        std::string canonical_request =
+            Strings::format("%s\n%s\n%s\n", method, target.canonical_uri, target.canonical_query);
+        for (auto&& header : headers)
+        {
+            Strings::append_to(canonical_request, "%s:%s\n", header.first, header.second);
+        }
+        const std::string signed_headers = Strings::join(";", headers, [](auto&& header) { return header.first; });
+        Strings::append_to(canonical_request, "\n%s\n%s", signed_headers, payload_hash);
+
+        const std::string scope = Strings::format("%s/%s/s3/aws4_request", date, m_region);
+        const std::string string_to_sign =
+            Strings::format("AWS4-HMAC-SHA256\n%s\n%s\n%s", date_time, scope, sha256_hex(canonical_request));
+        std::string key = hmac_sha256("AWS4" + p_credentials->secret_access_key, date);
+        key = hmac_sha256(std::move(key), m_region);
+        key = hmac_sha256(std::move(key), "s3");
+        key = hmac_sha256(std::move(key), "aws4_request");
+
+        // The clients send the Host header themselves
+        std::vector<std::string> ret;
+        for (auto it = headers.begin() + 1; it != headers.end(); ++it)
+        {
+            ret.push_back(it->first + ": " + it->second);
+        }
+        ret.push_back(Strings::format("Authorization: AWS4-HMAC-SHA256 Credential=%s/%s, SignedHeaders=%s, "
+                                      "Signature=%s",
+                                      p_credentials->access_key_id,
+                                      scope,
+                                      signed_headers,
+                                      hmac_sha256_hex(std::move(key), string_to_sign)));
+        return ret;
+    }
+
+    /// <summary>A transfer through curl, which reports only whether it succeeded</summary>
+    static bool curl(const std::vector<std::string>& headers,
+                     std::vector<std::string> arguments,
+                     const std::string& url,
+                     const bool show_errors)
+    {
+        arguments.insert(arguments.begin(), {"--silent", "--show-error", "--fail"});
+        for (auto&& header : headers)
+        {
+            arguments.push_back("--header");
+            arguments.push_back(header);
+        }
+        arguments.push_back(url);
+
+        const auto output = System::process_execute_and_capture_output("curl", arguments);
+        if (show_errors && output.exit_code != 0) System::print("%s", output.output);
+        return output.exit_code == 0;
+    }
+
+#if !defined(_WIN32)
+    /// <summary>Sends `request` through the built-in client, collecting the body of the response in `body`</summary>
+    static ExpectedT<Http::Response, std::string> send_native(const Http::Request& request, std::string& body)
+    {
+        return Http::send(
+            request,
+            [](const Http::Response&) { return true; },
+            [&](std::string_view data) { body.append(data.data(), data.size()); });
+    }
+
+    /// <summary>Whether the request got a successful response; prints why not otherwise</summary>
+    static bool succeeded(const ExpectedT<Http::Response, std::string>& maybe_response, const std::string& url)
+    {
+        const auto p_response = maybe_response.get();
+        if (!p_response)
+            System::println(System::Color::error, "Error: %s", maybe_response.error());
+        else if (!p_response->is_success())
+            System::println(System::Color::error, "Error: %s returned HTTP status %d", url, p_response->status);
+        return p_response && p_response->is_success();
+    }
+
+    bool Bucket::uses_builtin_client() const { return Http::is_supported(m_endpoint + "/"); }
+
+    Optional<uint64_t> Bucket::native_size(const Target& target) const
+    {
+        Http::Request request;
+        request.method = "HEAD";
+        request.url = target.url;
+        request.headers = sign("HEAD", target, EMPTY_PAYLOAD_HASH);
+        std::string body;
+        const auto maybe_response = send_native(request, body);
+        const auto p_response = maybe_response.get();
+        if (!p_response || !p_response->is_success()) return nullopt;
+
+        // A size the server leaves out only means the object is not split into ranges
+        const auto it_length = p_response->headers.find("content-length");
+        if (it_length == p_response->headers.end()) return 0;
+        return std::strtoull(it_length->second.c_str(), nullptr, 10);
+    }
+
+    bool Bucket::native_download(const Target& target, const uint64_t size, const fs::path& destination) const
+    {
+        {
+            std::ofstream create(destination.native().c_str(), std::ios::binary | std::ios::trunc);
+            if (!create) return false;
+        }
+        std::error_code ec;
+        fs::stdfs::resize_file(destination, size, ec);
+        if (ec) return false;
+
+        const size_t range_count = static_cast<size_t>((size + PART_SIZE - 1) / PART_SIZE);
+        std::atomic<bool> failed{false};
+        ThreadPool::parallel_for(range_count, TRANSFER_CONNECTIONS, [&](size_t i) {
+            if (failed) return;
+
+            const uint64_t offset = i * PART_SIZE;
+            const uint64_t length = std::min(PART_SIZE, size - offset);
+            std::fstream out(destination.native().c_str(), std::ios::in | std::ios::out | std::ios::binary);
+            if (!out.seekp(static_cast<std::streamoff>(offset)))
+            {
+                failed = true;
+                return;
+            }
+
+            Http::Request request;
+            request.url = target.url;
+            request.headers = sign("GET", target, EMPTY_PAYLOAD_HASH);
+            if (range_count > 1)
+            {
+                request.headers.push_back(Strings::format("Range: bytes=%llu-%llu",
+                                                          static_cast<unsigned long long>(offset),
+                                                          static_cast<unsigned long long>(offset + length - 1)));
+            }
+
+            bool accepted = false;
+            uint64_t received = 0;
+            bool overflowed = false;
+            const auto maybe_response = Http::send(
+                request,
+                [&](const Http::Response& response) {
+                    // A server ignoring the range sends the whole object
+                    accepted = range_count > 1 ? response.status == 206 : response.is_success();
+                    return accepted;
+                },
+                [&](std::string_view data) {
+                    if (received + data.size() > length)
+                    {
+                        overflowed = true;
+                        return;
+                    }
+                    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+                    received += data.size();
+                });
+            out.flush();
+            if (!maybe_response.get() || !accepted || overflowed || received != length || !out) failed = true;
+        });
+        return !failed;
+    }
+
+    bool Bucket::native_multipart_upload(const std::string& key, const fs::path& file, const uint64_t size) const
+    {
+        const uint64_t part_size = std::max(PART_SIZE, (size + MAX_PARTS - 1) / MAX_PARTS);
+        const size_t part_count = static_cast<size_t>((size + part_size - 1) / part_size);
+
+        const Target create = target(key, "uploads=");
+        Http::Request request;
+        request.method = "POST";
+        request.url = create.url;
+        request.headers = sign("POST", create, EMPTY_PAYLOAD_HASH);
+        std::string body;
+        if (!succeeded(send_native(request, body), create.url)) return false;
+        const std::string upload_id = xml_element(body, "UploadId");
+        if (upload_id.empty())
+        {
+            System::println(System::Color::error, "Error: %s did not start a multipart upload", create.url);
+            return false;
+        }
+
+        const Target upload = target(key, "uploadId=" + uri_encode(upload_id, false));
+        // Parts already stored would otherwise be kept, and paid for, until the bucket's lifecycle rules expire them
+        const auto abort = [&]() {
+            Http::Request abort_request;
+            abort_request.method = "DELETE";
+            abort_request.url = upload.url;
+            abort_request.headers = sign("DELETE", upload, EMPTY_PAYLOAD_HASH);
+            std::string abort_body;
+            send_native(abort_request, abort_body);
+            return false;
+        };
+
+        std::vector<std::string> etags(part_count);
+        std::atomic<bool> failed{false};
+        ThreadPool::parallel_for(part_count, TRANSFER_CONNECTIONS, [&](size_t i) {
+            if (failed) return;
+
+            const Target part = target(key, Strings::format("partNumber=%zd&%s", i + 1, upload.canonical_query));
+            Http::Request part_request;
+            part_request.method = "PUT";
+            part_request.url = part.url;
+            part_request.headers = sign("PUT", part, UNSIGNED_PAYLOAD);
+            part_request.upload = file;
+            part_request.upload_offset = i * part_size;
+            part_request.upload_length = std::min(part_size, size - i * part_size);
+            std::string part_body;
+            const auto maybe_response = send_native(part_request, part_body);
+            if (!succeeded(maybe_response, part.url))
+            {
+                failed = true;
+                return;
+            }
+            const auto& headers = maybe_response.get()->headers;
+            const auto it_etag = headers.find("etag");
+            if (it_etag == headers.end())
+            {
+                System::println(System::Color::error, "Error: %s returned no ETag", part.url);
+                failed = true;
+                return;
+            }
+            etags[i] = it_etag->second;
+        });
+        if (failed) return abort();
+
+        std::string manifest = "<CompleteMultipartUpload>";
+        for (size_t i = 0; i < part_count; ++i)
+        {
+            Strings::append_to(manifest, "<Part><PartNumber>%zd</PartNumber><ETag>%s</ETag></Part>", i + 1, etags[i]);
+        }
+        manifest += "</CompleteMultipartUpload>";
+
+        request.url = upload.url;
+        request.headers = sign("POST", upload, sha256_hex(manifest));
+        request.body = std::move(manifest);
+        body.clear();
+        if (!succeeded(send_native(request, body), upload.url)) return abort();
+        // A completion that fails after it started still answers 200, with the error in the body
+        if (body.find("<Error>") != std::string::npos)
+        {
+            System::println(
+                System::Color::error, "Error: %s failed: %s", upload.url, xml_element(body, "Message"));
+            return abort();
+        }
+        return true;
+    }
+#endif
+
+    bool Bucket::exists(const std::string& key) const
+    {
+        const Target object = target(key);
+#if !defined(_WIN32)
+        if (uses_builtin_client()) return native_size(object).has_value();
+#endif
+        return curl(sign("HEAD", object, EMPTY_PAYLOAD_HASH), {"--head"}, object.url, false);
+    }
+
+    bool Bucket::download(const std::string& key, const fs::path& destination) const
+    {
+        const Target object = target(key);
+        const fs::path part_path = destination.u8string() + ".part";
+        std::error_code ec;
+        fs::stdfs::create_directories(destination.parent_path(), ec);
+        bool downloaded = false;
+#if !defined(_WIN32)
+        if (uses_builtin_client())
+        {
+            const auto maybe_size = native_size(object);
+            const auto p_size = maybe_size.get();
+            downloaded = p_size && native_download(object, *p_size, part_path);
+        }
+        else
+#endif
+        {
+            downloaded = curl(
+                sign("GET", object, EMPTY_PAYLOAD_HASH), {"--output", part_path.u8string()}, object.url, false);
+        }
+
+        if (downloaded) fs::stdfs::rename(part_path, destination, ec);
+        if (!downloaded || ec)
+        {
+            fs::stdfs::remove(part_path, ec);
+            return false;
+        }
+        return true;
+    }
+
+    bool Bucket::upload(const std::string& key, const fs::path& file) const
+    {
+        const Target object = target(key);
+#if !defined(_WIN32)
+        if (uses_builtin_client())
+        {
+            std::error_code ec;
+            const uint64_t size = fs::stdfs::file_size(file, ec);
+            if (!ec && size > PART_SIZE) return native_multipart_upload(key, file, size);
+
+            Http::Request request;
+            request.method = "PUT";
+            request.url = object.url;
+            request.headers = sign("PUT", object, UNSIGNED_PAYLOAD);
+            request.upload = file;
+            std::string body;
+            return succeeded(send_native(request, body), object.url);
+        }
+#endif
+        return curl(sign("PUT", object, UNSIGNED_PAYLOAD), {"--upload-file", file.u8string()}, object.url, true);
+    }
+}
@@ -4,14 +4,128 @@
 #include <vcpkg/base/strings.h>
 #include <vcpkg/base/util.h>
 
+#if defined(_M_X64) || defined(__x86_64__)
+#define VCPKG_STRINGS_SSE2 1
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define VCPKG_STRINGS_NEON 1
+#include <arm_neon.h>
+#endif
+
 namespace vcpkg::Strings::details
 {
     // To disambiguate between two overloads
     static bool is_space(const char c) { return std::isspace(c) != 0; }
 
-    // Avoids C4244 warnings because of char<->int conversion that occur when using std::tolower()
-    static char tolower_char(const char c) { return static_cast<char>(std::tolower(c)); }
-    static char toupper_char(const char c) { return static_cast<char>(std::toupper(c)); }
+    // Only ASCII letters change, unlike with std::tolower(), whatever the locale
+    static char tolower_char(const char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c | 0x20) : c; }
+    static char toupper_char(const char c) { return c >= 'a' && c <= 'z' ? static_cast<char>(c & ~0x20) : c; }
+
+    // The comparisons below take 16 bytes at a time, folding upper case ASCII to lower case as they load them. SSE2
+    // and NEON are part of every x64 and ARM64 processor, so no check is needed at run time.
+#if defined(VCPKG_STRINGS_SSE2)
+    static __m128i load_lowercase(const char* p)
+    {
+        // 'A' to 'Z' are the only bytes below -102 once 63 is added, as SSE2 only compares signed bytes
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i is_upper = _mm_cmplt_epi8(_mm_add_epi8(bytes, _mm_set1_epi8(63)), _mm_set1_epi8(-102));
+        return _mm_or_si128(bytes, _mm_and_si128(is_upper, _mm_set1_epi8(0x20)));
+    }
+
+    static unsigned count_trailing_zeros(const unsigned mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return index;
+#else
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+    }
+#elif defined(VCPKG_STRINGS_NEON)
+    static uint8x16_t load_lowercase(const char* p)
+    {
+        const uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+        const uint8x16_t is_upper = vcltq_u8(vsubq_u8(bytes, vdupq_n_u8('A')), vdupq_n_u8(26));
+        return vorrq_u8(bytes, vandq_u8(is_upper, vdupq_n_u8(0x20)));
+    }
+#endif
+
+    /// <summary>Whether the `n` bytes at `a` and at `b` are the same but for the case of ASCII letters</summary>
+    static bool equals_ignoring_case(const char* a, const char* b, const size_t n)
+    {
+        size_t i = 0;
+#if defined(VCPKG_STRINGS_SSE2)
+        for (; i + 16 <= n; i += 16)
+        {
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(load_lowercase(a + i), load_lowercase(b + i))) != 0xFFFF) return false;
+        }
+#elif defined(VCPKG_STRINGS_NEON)
+        for (; i + 16 <= n; i += 16)
+        {
+            if (vmaxvq_u8(veorq_u8(load_lowercase(a + i), load_lowercase(b + i))) != 0) return false;
+        }
+#endif
+        for (; i < n; ++i)
+        {
+            if (tolower_char(a[i]) != tolower_char(b[i])) return false;
+        }
+        return true;
+    }
+
+    /// <summary>
+    /// The first position of `pattern` in `s`, ignoring the case of ASCII letters, or npos. Blocks of 16 positions
+    /// are ruled out at once by the first and the last character of the pattern, so only the rare positions where
+    /// both match are compared in full.
+    /// </summary>
+    static size_t find_ignoring_case(const std::string_view s, const std::string_view pattern)
+    {
+        const size_t m = pattern.size();
+        if (m == 0) return 0;
+        if (m > s.size()) return std::string_view::npos;
+
+        const size_t end = s.size() - m + 1;
+        const char first = tolower_char(pattern.front());
+        const char last = tolower_char(pattern.back());
+        size_t i = 0;
+#if defined(VCPKG_STRINGS_SSE2)
+        const __m128i firsts = _mm_set1_epi8(first);
+        const __m128i lasts = _mm_set1_epi8(last);
+        for (; i + 16 <= end; i += 16)
+        {
+            const __m128i first_matches = _mm_cmpeq_epi8(load_lowercase(s.data() + i), firsts);
+            const __m128i last_matches = _mm_cmpeq_epi8(load_lowercase(s.data() + i + m - 1), lasts);
+            for (unsigned mask = _mm_movemask_epi8(_mm_and_si128(first_matches, last_matches)); mask != 0;
+                 mask &= mask - 1)
+            {
+                const size_t candidate = i + count_trailing_zeros(mask);
+                if (equals_ignoring_case(s.data() + candidate, pattern.data(), m)) return candidate;
+            }
+        }
+#elif defined(VCPKG_STRINGS_NEON)
+        const uint8x16_t firsts = vdupq_n_u8(static_cast<uint8_t>(first));
+        const uint8x16_t lasts = vdupq_n_u8(static_cast<uint8_t>(last));
+        for (; i + 16 <= end; i += 16)
+        {
+            const uint8x16_t first_matches = vceqq_u8(load_lowercase(s.data() + i), firsts);
+            const uint8x16_t last_matches = vceqq_u8(load_lowercase(s.data() + i + m - 1), lasts);
+            if (vmaxvq_u8(vandq_u8(first_matches, last_matches)) == 0) continue;
+            for (size_t candidate = i; candidate < i + 16; ++candidate)
+            {
+                if (tolower_char(s[candidate]) == first &&
+                    equals_ignoring_case(s.data() + candidate, pattern.data(), m))
+                {
+                    return candidate;
+                }
+            }
+        }
+#endif
+        for (; i < end; ++i)
+        {
+            if (tolower_char(s[i]) == first && equals_ignoring_case(s.data() + i, pattern.data(), m)) return i;
+        }
+        return std::string_view::npos;
+    }
 
 #if defined(_WIN32)
     static _locale_t& c_locale()
@@ -21,29 +135,48 @@ namespace vcpkg::Strings::details
     }
 #endif
 
-    std::string format_internal(const char* fmtstr, ...)
+    void append_internal(std::string& output, const char* fmtstr, ...)
     {
+        // Formats into a buffer on the stack and appends that, so `output` grows geometrically like any append; only
+        // output that does not fit is formatted a second time, straight into `output` grown by exactly that much.
+        char buffer[256];
+
         va_list args;
         va_start(args, fmtstr);
+        va_list retry_args;
+        va_copy(retry_args, args);
 
 #if defined(_WIN32)
-        const int sz = _vscprintf_l(fmtstr, c_locale(), args);
+        // Unlike vsnprintf, this returns -1 rather than the required size when the output is truncated
+        int sz = _vsnprintf_l(buffer, sizeof(buffer), fmtstr, c_locale(), args);
+        if (sz < 0 || static_cast<size_t>(sz) >= sizeof(buffer))
+        {
+            va_list size_args;
+            va_copy(size_args, retry_args);
+            sz = _vscprintf_l(fmtstr, c_locale(), size_args);
+            va_end(size_args);
+        }
 #else
-        const int sz = vsnprintf(nullptr, 0, fmtstr, args);
+        const int sz = vsnprintf(buffer, sizeof(buffer), fmtstr, args);
 #endif
-        Checks::check_exit(VCPKG_LINE_INFO, sz > 0);
-
-        std::string output(sz, '\0');
+        va_end(args);
+        Checks::check_exit(VCPKG_LINE_INFO, sz >= 0);
 
+        if (static_cast<size_t>(sz) < sizeof(buffer))
+        {
+            output.append(buffer, sz);
+        }
+        else
+        {
+            const size_t old_size = output.size();
+            output.resize(old_size + sz);
 #if defined(_WIN32)
-        _vsnprintf_s_l(&output.at(0), output.size() + 1, output.size(), fmtstr, c_locale(), args);
+            _vsnprintf_s_l(&output[old_size], sz + 1, sz, fmtstr, c_locale(), retry_args);
 #else
-        va_start(args, fmtstr);
-        vsnprintf(&output.at(0), output.size() + 1, fmtstr, args);
+            vsnprintf(&output[old_size], sz + 1, fmtstr, retry_args);
 #endif
-        va_end(args);
-
-        return output;
+        }
+        va_end(retry_args);
     }
 }
 
@@ -83,28 +216,31 @@ namespace vcpkg::Strings
         return ret;
     }
 
+    bool AsciiSet::contains_any_of(const std::string& s) const
+    {
+        return std::any_of(s.begin(), s.end(), [this](const char c) { return contains(c); });
+    }
+
+    bool AsciiSet::contains_only(const std::string& s) const
+    {
+        return std::all_of(s.begin(), s.end(), [this](const char c) { return contains(c); });
+    }
+
     std::string::const_iterator case_insensitive_ascii_find(const std::string& s, const std::string& pattern)
     {
-        const std::string pattern_as_lower_case(ascii_to_lowercase(pattern));
-        return search(s.begin(),
-                      s.end(),
-                      pattern_as_lower_case.begin(),
-                      pattern_as_lower_case.end(),
-                      [](const char a, const char b) { return details::tolower_char(a) == b; });
+        const size_t pos = details::find_ignoring_case(s, pattern);
+        return pos == std::string_view::npos ? s.end() : s.begin() + pos;
     }
 
     bool case_insensitive_ascii_contains(const std::string& s, const std::string& pattern)
     {
-        return case_insensitive_ascii_find(s, pattern) != s.end();
+        return details::find_ignoring_case(s, pattern) != std::string_view::npos;
     }
 
     bool case_insensitive_ascii_equals(const CStringView left, const CStringView right)
     {
-#if defined(_WIN32)
-        return _stricmp(left.c_str(), right.c_str()) == 0;
-#else
-        return strcasecmp(left.c_str(), right.c_str()) == 0;
-#endif
+        const size_t size = strlen(left.c_str());
+        return size == strlen(right.c_str()) && details::equals_ignoring_case(left.c_str(), right.c_str(), size);
     }
 
     std::string ascii_to_lowercase(std::string s)
@@ -121,11 +257,7 @@ namespace vcpkg::Strings
 
     bool case_insensitive_ascii_starts_with(const std::string& s, const std::string& pattern)
     {
-#if defined(_WIN32)
-        return _strnicmp(s.c_str(), pattern.c_str(), pattern.size()) == 0;
-#else
-        return strncasecmp(s.c_str(), pattern.c_str(), pattern.size()) == 0;
-#endif
+        return s.size() >= pattern.size() && details::equals_ignoring_case(s.data(), pattern.data(), pattern.size());
     }
 
     bool ends_with(const std::string& s, StringLiteral pattern)
@@ -165,28 +297,36 @@ namespace vcpkg::Strings
     std::vector<std::string> split(const std::string& s, const std::string& delimiter)
     {
         std::vector<std::string> output;
-
-        if (delimiter.empty())
+        for (std::string_view piece : split_view(s, delimiter))
         {
-            output.push_back(s);
-            return output;
+            output.emplace_back(piece);
         }
+        return output;
+    }
 
-        const size_t delimiter_length = delimiter.length();
-        size_t i = 0;
-        for (size_t pos = s.find(delimiter); pos != std::string::npos; pos = s.find(delimiter, pos))
+    SplitRange::iterator::iterator(std::string_view rest, std::string_view delimiter)
+        : m_rest(rest), m_delimiter(delimiter), m_piece(rest), m_at_end(false)
+    {
+        // Nothing at all is no piece, while an empty delimiter leaves the whole string as the only one
+        if (m_rest.empty() && !m_delimiter.empty())
         {
-            output.push_back(s.substr(i, pos - i));
-            pos += delimiter_length;
-            i = pos;
+            *this = iterator();
+            return;
         }
 
-        // Add the rest of the string after the last delimiter, unless there is nothing after it
-        if (i != s.length())
+        if (!m_delimiter.empty()) m_piece = m_rest.substr(0, m_rest.find(m_delimiter));
+    }
+
+    SplitRange::iterator& SplitRange::iterator::operator++()
+    {
+        if (m_piece.size() == m_rest.size())
         {
-            output.push_back(s.substr(i, s.length()));
+            *this = iterator();
+            return *this;
         }
 
-        return output;
+        // Nothing after the last delimiter is not a piece either
+        *this = iterator(m_rest.substr(m_piece.size() + m_delimiter.size()), m_delimiter);
+        return *this;
     }
 }
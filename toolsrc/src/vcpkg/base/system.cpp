@@ -1,12 +1,19 @@
 #include "pch.h"
 
 #include <vcpkg/base/checks.h>
+#include <vcpkg/base/openmetrics.h>
+#include <vcpkg/base/processlog.h>
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/trace.h>
 #include <vcpkg/globalstate.h>
 #include <vcpkg/metrics.h>
 
 #include <ctime>
 
+#if defined(_WIN32)
+#include <psapi.h>
+#endif
+
 #if defined(__APPLE__)
 #include <mach-o/dyld.h>
 #endif
@@ -15,6 +22,17 @@
 #include <sys/sysctl.h>
 #endif
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+extern char** environ;
+#endif
+
 #pragma comment(lib, "Advapi32")
 
 namespace vcpkg::System
@@ -116,15 +134,29 @@ namespace vcpkg::System
             R"("%s" %s -P "%s")", cmake_exe.u8string(), cmd_cmake_pass_variables, cmake_script.generic_u8string());
     }
 
-#if defined(_WIN32)
-    static std::wstring compute_clean_environment(const std::unordered_map<std::string, std::string>& extra_env)
+    /// <summary>Counts a process about to be started, by the trace category of the work that starts it.</summary>
+    static void count_spawn()
     {
-        static const std::string SYSTEM_ROOT = get_environment_variable("SystemRoot").value_or_exit(VCPKG_LINE_INFO);
-        static const std::string SYSTEM_32 = SYSTEM_ROOT + R"(\system32)";
-        std::string new_path = Strings::format(
-            R"(Path=%s;%s;%s\Wbem;%s\WindowsPowerShell\v1.0\)", SYSTEM_32, SYSTEM_ROOT, SYSTEM_32, SYSTEM_32);
+        OpenMetrics::add_counter("vcpkg_process_spawns_total",
+                                 "Processes started by vcpkg, by the kind of work that started them.",
+                                 {{"category", Trace::current_category()}});
+    }
 
-        std::vector<std::wstring> env_wstrings = {
+#if defined(_WIN32)
+    struct CleanVariable
+    {
+        std::string name;
+        /// <summary>The variable as it goes into an environment block: NAME=VALUE and a terminating null.</summary>
+        std::wstring entry;
+    };
+
+    /// <summary>
+    /// The variables that every clean environment passes through from this one. vcpkg never changes its own
+    /// environment, so they are read once per process.
+    /// </summary>
+    static std::vector<CleanVariable> compute_clean_environment_base()
+    {
+        static const std::vector<std::wstring> env_wstrings = {
             L"ALLUSERSPROFILE",
             L"APPDATA",
             L"CommonProgramFiles",
@@ -174,20 +206,45 @@ namespace vcpkg::System
             L"ANDROID_NDK_HOME",
         };
 
-        std::wstring env_cstr;
+        std::vector<CleanVariable> variables;
 
         for (auto&& env_wstring : env_wstrings)
         {
-            const Optional<std::string> value = System::get_environment_variable(Strings::to_utf8(env_wstring.c_str()));
+            std::string name = Strings::to_utf8(env_wstring.c_str());
+            const Optional<std::string> value = System::get_environment_variable(name);
             const auto v = value.get();
             if (!v || v->empty()) continue;
 
-            env_cstr.append(env_wstring);
-            env_cstr.push_back(L'=');
-            env_cstr.append(Strings::to_utf16(*v));
-            env_cstr.push_back(L'\0');
+            std::wstring entry = env_wstring;
+            entry.push_back(L'=');
+            entry.append(Strings::to_utf16(*v));
+            entry.push_back(L'\0');
+            variables.push_back({std::move(name), std::move(entry)});
         }
 
+        return variables;
+    }
+
+    static std::wstring compute_clean_environment(const std::unordered_map<std::string, std::string>& extra_env)
+    {
+        static const std::string SYSTEM_ROOT = get_environment_variable("SystemRoot").value_or_exit(VCPKG_LINE_INFO);
+        static const std::string SYSTEM_32 = SYSTEM_ROOT + R"(\system32)";
+        static const std::string CLEAN_PATH = Strings::format(
+            R"(Path=%s;%s;%s\Wbem;%s\WindowsPowerShell\v1.0\)", SYSTEM_32, SYSTEM_ROOT, SYSTEM_32, SYSTEM_32);
+        static const std::vector<CleanVariable> BASE = compute_clean_environment_base();
+
+        std::wstring env_cstr;
+
+        // Names in an environment block are case-insensitive, and extra_env replaces the variables it names
+        for (auto&& variable : BASE)
+        {
+            const bool is_replaced = std::any_of(extra_env.begin(), extra_env.end(), [&](auto&& item) {
+                return Strings::case_insensitive_ascii_equals(item.first, variable.name);
+            });
+            if (!is_replaced) env_cstr.append(variable.entry);
+        }
+
+        std::string new_path = CLEAN_PATH;
         if (extra_env.find("PATH") != extra_env.end())
             new_path += Strings::format(";%s", extra_env.find("PATH")->second);
         env_cstr.append(Strings::to_utf16(new_path));
@@ -211,16 +268,27 @@ namespace vcpkg::System
 #if defined(_WIN32)
     /// <param name="maybe_environment">If non-null, an environment block to use for the new process. If null, the new
     /// process will inherit the current environment.</param>
+    /// <param name="maybe_output">If non-null, an inheritable handle that receives both stdout and stderr of the new
+    /// process.</param>
     static void windows_create_process(const CStringView cmd_line,
                                        const wchar_t* maybe_environment,
                                        DWORD dwCreationFlags,
-                                       PROCESS_INFORMATION* process_info) noexcept
+                                       PROCESS_INFORMATION* process_info,
+                                       HANDLE maybe_output = nullptr) noexcept
     {
         Checks::check_exit(VCPKG_LINE_INFO, process_info != nullptr);
+        count_spawn();
 
         STARTUPINFOW startup_info;
         memset(&startup_info, 0, sizeof(STARTUPINFOW));
         startup_info.cb = sizeof(STARTUPINFOW);
+        if (maybe_output)
+        {
+            startup_info.dwFlags = STARTF_USESTDHANDLES;
+            startup_info.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+            startup_info.hStdOutput = maybe_output;
+            startup_info.hStdError = maybe_output;
+        }
 
         // Flush stdout before launching external process
         fflush(nullptr);
@@ -232,7 +300,7 @@ namespace vcpkg::System
                                                 Strings::to_utf16(actual_cmd_line).data(),
                                                 nullptr,
                                                 nullptr,
-                                                FALSE,
+                                                maybe_output ? TRUE : FALSE,
                                                 IDLE_PRIORITY_CLASS | CREATE_UNICODE_ENVIRONMENT | dwCreationFlags,
                                                 (void*)maybe_environment,
                                                 nullptr,
@@ -264,6 +332,7 @@ namespace vcpkg::System
                           const std::unordered_map<std::string, std::string>& extra_env) noexcept
     {
         auto timer = Chrono::ElapsedTimer::create_started();
+        ProcessLog::Spawn spawn(cmd_line.c_str());
 #if defined(_WIN32)
 
         PROCESS_INFORMATION process_info;
@@ -286,18 +355,38 @@ namespace vcpkg::System
 
         Debug::println("CreateProcessW() returned %lu after %d us", exit_code, static_cast<int>(timer.microseconds()));
 
+        spawn.finish(static_cast<int>(exit_code));
         return static_cast<int>(exit_code);
 #else
+        count_spawn();
         Debug::println("system(%s)", cmd_line.c_str());
         fflush(nullptr);
         int rc = system(cmd_line.c_str());
         Debug::println("system() returned %d after %d us", rc, static_cast<int>(timer.microseconds()));
+        spawn.finish(rc);
         return rc;
 #endif
     }
 
+    int cmd_execute_clean(const CStringView cmd_line,
+                          const std::unordered_map<std::string, std::string>& extra_env,
+                          const OutputCallback& on_output) noexcept
+    {
+        std::promise<ProcessExit> exited;
+        auto result = exited.get_future();
+        cmd_execute_clean_async(
+            cmd_line,
+            extra_env,
+            std::cref(on_output),
+            [&](const ProcessExit& exit) { exited.set_value(exit); },
+            nullopt);
+        return result.get().exit_code;
+    }
+
     int cmd_execute(const CStringView cmd_line) noexcept
     {
+        ProcessLog::Spawn spawn(cmd_line.c_str());
+        count_spawn();
         // Flush stdout before launching external process
         fflush(nullptr);
 
@@ -314,12 +403,22 @@ namespace vcpkg::System
         const int exit_code = system(cmd_line.c_str());
         Debug::println("_system() returned %d", exit_code);
 #endif
+        spawn.finish(exit_code);
         return exit_code;
     }
 
+    static ExitCodeAndOutput finish_captured(ProcessLog::Spawn& spawn, const int exit_code, std::string output)
+    {
+        spawn.add_output(output.size());
+        spawn.finish(exit_code);
+        return {exit_code, std::move(output)};
+    }
+
     ExitCodeAndOutput cmd_execute_and_capture_output(const CStringView cmd_line) noexcept
     {
         auto timer = Chrono::ElapsedTimer::create_started();
+        ProcessLog::Spawn spawn(cmd_line.c_str());
+        count_spawn();
 
 #if defined(_WIN32)
         const auto actual_cmd_line = Strings::format(R"###("%s 2>&1")###", cmd_line);
@@ -334,7 +433,7 @@ namespace vcpkg::System
         if (pipe == nullptr)
         {
             GlobalState::g_ctrl_c_state.transition_from_spawn_process();
-            return {1, Strings::to_utf8(output.c_str())};
+            return finish_captured(spawn, 1, Strings::to_utf8(output.c_str()));
         }
         while (fgetws(buf, 1024, pipe))
         {
@@ -343,7 +442,7 @@ namespace vcpkg::System
         if (!feof(pipe))
         {
             GlobalState::g_ctrl_c_state.transition_from_spawn_process();
-            return {1, Strings::to_utf8(output.c_str())};
+            return finish_captured(spawn, 1, Strings::to_utf8(output.c_str()));
         }
 
         const auto ec = _pclose(pipe);
@@ -359,7 +458,7 @@ namespace vcpkg::System
 
         Debug::println("_pclose() returned %d after %8d us", ec, static_cast<int>(timer.microseconds()));
 
-        return {ec, Strings::to_utf8(output.c_str())};
+        return finish_captured(spawn, ec, Strings::to_utf8(output.c_str()));
 #else
         const auto actual_cmd_line = Strings::format(R"###(%s 2>&1)###", cmd_line);
 
@@ -371,7 +470,7 @@ namespace vcpkg::System
         const auto pipe = popen(actual_cmd_line.c_str(), "r");
         if (pipe == nullptr)
         {
-            return {1, output};
+            return finish_captured(spawn, 1, std::move(output));
         }
         while (fgets(buf, 1024, pipe))
         {
@@ -379,17 +478,877 @@ namespace vcpkg::System
         }
         if (!feof(pipe))
         {
-            return {1, output};
+            return finish_captured(spawn, 1, std::move(output));
         }
 
         const auto ec = pclose(pipe);
 
         Debug::println("_pclose() returned %d after %8d us", ec, (int)timer.microseconds());
 
-        return {ec, output};
+        return finish_captured(spawn, ec, std::move(output));
 #endif
     }
 
+#if defined(_WIN32)
+    /// <summary>
+    /// Quotes argument so that CommandLineToArgvW and the C runtime of the child split it back out unchanged.
+    /// </summary>
+    static void append_quoted_argument(std::wstring& cmd_line, const std::wstring& argument)
+    {
+        if (!argument.empty() && argument.find_first_of(L" \t\n\v\"") == std::wstring::npos)
+        {
+            cmd_line.append(argument);
+            return;
+        }
+
+        cmd_line.push_back(L'"');
+        size_t backslashes = 0;
+        for (const wchar_t ch : argument)
+        {
+            if (ch == L'\\')
+            {
+                ++backslashes;
+                continue;
+            }
+
+            // Backslashes are only special in front of a quote, where each of them and the quote must be escaped
+            if (ch == L'"') backslashes = backslashes * 2 + 1;
+            cmd_line.append(backslashes, L'\\');
+            backslashes = 0;
+            cmd_line.push_back(ch);
+        }
+        cmd_line.append(backslashes * 2, L'\\');
+        cmd_line.push_back(L'"');
+    }
+#endif
+
+#if defined(_WIN32)
+    /// <summary>
+    /// Creates a pipe whose read end supports overlapped reads, which anonymous pipes do not. Only the write end is
+    /// inheritable.
+    /// </summary>
+    static bool create_overlapped_pipe(HANDLE& read_end, HANDLE& write_end)
+    {
+        static std::atomic<unsigned long> next_pipe{0};
+        const std::wstring name =
+            Strings::to_utf16(Strings::format(R"(\\.\pipe\vcpkg-%lu-%lu)", GetCurrentProcessId(), next_pipe++));
+
+        read_end = CreateNamedPipeW(name.c_str(),
+                                    PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+                                    PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                    1,
+                                    0,
+                                    4096,
+                                    0,
+                                    nullptr);
+        if (read_end == INVALID_HANDLE_VALUE)
+        {
+            read_end = nullptr;
+            return false;
+        }
+
+        SECURITY_ATTRIBUTES inheritable;
+        memset(&inheritable, 0, sizeof(SECURITY_ATTRIBUTES));
+        inheritable.nLength = sizeof(SECURITY_ATTRIBUTES);
+        inheritable.bInheritHandle = TRUE;
+        write_end = CreateFileW(
+            name.c_str(), GENERIC_WRITE, 0, &inheritable, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (write_end == INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(read_end);
+            read_end = nullptr;
+            write_end = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    /// <summary>
+    /// Watches every child started by the _async functions from one thread, through an I/O completion port: the
+    /// reads of all output pipes complete on it, and a thread pool wait posts each process exit to it.
+    /// </summary>
+    struct ProcessSupervisor
+    {
+        struct Stream
+        {
+            OVERLAPPED overlapped;
+            HANDLE pipe = nullptr;
+            OutputCallback callback;
+            char buf[4096];
+        };
+
+        struct Child
+        {
+            HANDLE process = nullptr;
+            DWORD process_id = 0;
+            HANDLE wait = nullptr;
+            std::array<Stream, 2> streams;
+            size_t open_streams = 0;
+            OVERLAPPED exit_overlapped;
+            bool exited = false;
+            ExitCallback on_exit;
+            Optional<std::chrono::steady_clock::time_point> deadline;
+            bool timed_out = false;
+            /// <summary>Holds the process and its descendants, to measure their memory; null if unavailable</summary>
+            HANDLE job = nullptr;
+        };
+
+        static ProcessSupervisor& get()
+        {
+            // Never destroyed: children may still be running when vcpkg exits
+            static ProcessSupervisor* supervisor = new ProcessSupervisor();
+            return *supervisor;
+        }
+
+        /// <summary>Takes ownership of child, whose process is running and whose streams are open.</summary>
+        void add(Child* child)
+        {
+            PostQueuedCompletionStatus(m_port, 0, reinterpret_cast<ULONG_PTR>(child), nullptr);
+        }
+
+    private:
+        ProcessSupervisor()
+        {
+            m_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               m_port != nullptr,
+                               "CreateIoCompletionPort failed with error code: %lu",
+                               GetLastError());
+            std::thread([this]() { run(); }).detach();
+        }
+
+        static VOID CALLBACK on_process_exited(PVOID context, BOOLEAN)
+        {
+            auto child = static_cast<Child*>(context);
+            PostQueuedCompletionStatus(get().m_port, 0, reinterpret_cast<ULONG_PTR>(child), &child->exit_overlapped);
+        }
+
+        /// <summary>Returns false once the pipe is closed.</summary>
+        static bool start_read(Stream& stream)
+        {
+            memset(&stream.overlapped, 0, sizeof(OVERLAPPED));
+            // Even a read that completes at once is reported through the port
+            if (ReadFile(stream.pipe, stream.buf, sizeof(stream.buf), nullptr, &stream.overlapped)) return true;
+            return GetLastError() == ERROR_IO_PENDING;
+        }
+
+        static void close_stream(Child& child, Stream& stream)
+        {
+            CloseHandle(stream.pipe);
+            stream.pipe = nullptr;
+            --child.open_streams;
+        }
+
+        void start(Child& child)
+        {
+            for (auto&& stream : child.streams)
+            {
+                if (stream.pipe == nullptr) continue;
+                CreateIoCompletionPort(stream.pipe, m_port, reinterpret_cast<ULONG_PTR>(&child), 0);
+                if (!start_read(stream)) close_stream(child, stream);
+            }
+
+            memset(&child.exit_overlapped, 0, sizeof(OVERLAPPED));
+            if (!RegisterWaitForSingleObject(
+                    &child.wait, child.process, on_process_exited, &child, INFINITE, WT_EXECUTEONLYONCE))
+            {
+                // Without a wait there is no other way to learn of the exit
+                WaitForSingleObject(child.process, INFINITE);
+                child.wait = nullptr;
+                child.exited = true;
+            }
+        }
+
+        void finish(Child* child)
+        {
+            if (child->wait != nullptr) UnregisterWait(child->wait);
+            DWORD exit_code = 0;
+            GetExitCodeProcess(child->process, &exit_code);
+            CloseHandle(child->process);
+            GlobalState::g_ctrl_c_state.transition_from_spawn_process();
+            Debug::println("Supervised process %lu exited with %lu", child->process_id, exit_code);
+
+            uint64_t peak_memory_kib = 0;
+            if (child->job != nullptr)
+            {
+                JOBOBJECT_EXTENDED_LIMIT_INFORMATION info;
+                if (QueryInformationJobObject(
+                        child->job, JobObjectExtendedLimitInformation, &info, sizeof(info), nullptr))
+                {
+                    peak_memory_kib = info.PeakJobMemoryUsed / 1024;
+                }
+                CloseHandle(child->job);
+            }
+
+            child->on_exit({static_cast<int>(exit_code), child->timed_out, peak_memory_kib});
+            delete child;
+        }
+
+        void run()
+        {
+            std::vector<Child*> children;
+            while (true)
+            {
+                DWORD wait_ms = INFINITE;
+                const auto now = std::chrono::steady_clock::now();
+                for (Child* child : children)
+                {
+                    const auto deadline = child->deadline.get();
+                    if (!deadline || child->timed_out || child->exited) continue;
+                    if (*deadline <= now)
+                    {
+                        if (child->job != nullptr)
+                            TerminateJobObject(child->job, 1);
+                        else
+                            TerminateProcess(child->process, 1);
+                        child->timed_out = true;
+                        continue;
+                    }
+
+                    const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(*deadline - now);
+                    wait_ms = std::min(wait_ms, static_cast<DWORD>(remaining.count()) + 1);
+                }
+
+                DWORD bytes = 0;
+                ULONG_PTR key = 0;
+                OVERLAPPED* overlapped = nullptr;
+                const BOOL succeeded = GetQueuedCompletionStatus(m_port, &bytes, &key, &overlapped, wait_ms);
+                Child* child = reinterpret_cast<Child*>(key);
+                if (overlapped == nullptr)
+                {
+                    // Either the wait timed out, or a new child was added
+                    if (child == nullptr) continue;
+                    children.push_back(child);
+                    start(*child);
+                }
+                else if (overlapped == &child->exit_overlapped)
+                {
+                    child->exited = true;
+                }
+                else
+                {
+                    Stream& stream =
+                        overlapped == &child->streams[0].overlapped ? child->streams[0] : child->streams[1];
+                    if (succeeded && bytes != 0 && stream.callback)
+                    {
+                        stream.callback(std::string_view(stream.buf, bytes));
+                    }
+
+                    // A failed read means every process holding the write end has closed it
+                    if (!succeeded || !start_read(stream)) close_stream(*child, stream);
+                }
+
+                if (child->exited && child->open_streams == 0)
+                {
+                    Util::erase_remove_if(children, [&](const Child* c) { return c == child; });
+                    finish(child);
+                }
+            }
+        }
+
+        HANDLE m_port;
+    };
+
+    /// <summary>
+    /// Starts cmd_line with stdout and stderr on the given pipes, inheriting only those and nothing else that another
+    /// thread may be creating for its own child at the same time. The process starts suspended.
+    /// </summary>
+    static bool windows_create_supervised_process(std::wstring cmd_line,
+                                                  const wchar_t* maybe_environment,
+                                                  HANDLE out_write,
+                                                  HANDLE err_write,
+                                                  PROCESS_INFORMATION& process_info)
+    {
+        count_spawn();
+        SECURITY_ATTRIBUTES inheritable;
+        memset(&inheritable, 0, sizeof(SECURITY_ATTRIBUTES));
+        inheritable.nLength = sizeof(SECURITY_ATTRIBUTES);
+        inheritable.bInheritHandle = TRUE;
+        const HANDLE null_input = CreateFileW(
+            L"NUL", GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, &inheritable, OPEN_EXISTING, 0, nullptr);
+
+        std::vector<HANDLE> inherited = {out_write};
+        if (err_write != out_write) inherited.push_back(err_write);
+        if (null_input != INVALID_HANDLE_VALUE) inherited.push_back(null_input);
+
+        SIZE_T attribute_list_size = 0;
+        InitializeProcThreadAttributeList(nullptr, 1, 0, &attribute_list_size);
+        std::vector<unsigned char> attribute_list_storage(attribute_list_size);
+        const auto attribute_list = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attribute_list_storage.data());
+        bool succeeded = InitializeProcThreadAttributeList(attribute_list, 1, 0, &attribute_list_size) &&
+                         UpdateProcThreadAttribute(attribute_list,
+                                                   0,
+                                                   PROC_THREAD_ATTRIBUTE_HANDLE_LIST,
+                                                   inherited.data(),
+                                                   inherited.size() * sizeof(HANDLE),
+                                                   nullptr,
+                                                   nullptr);
+
+        STARTUPINFOEXW startup_info;
+        memset(&startup_info, 0, sizeof(STARTUPINFOEXW));
+        startup_info.StartupInfo.cb = sizeof(STARTUPINFOEXW);
+        startup_info.StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+        startup_info.StartupInfo.hStdInput = null_input;
+        startup_info.StartupInfo.hStdOutput = out_write;
+        startup_info.StartupInfo.hStdError = err_write;
+        startup_info.lpAttributeList = attribute_list;
+
+        if (succeeded)
+        {
+            succeeded = TRUE == CreateProcessW(nullptr,
+                                               cmd_line.data(),
+                                               nullptr,
+                                               nullptr,
+                                               TRUE,
+                                               IDLE_PRIORITY_CLASS | CREATE_UNICODE_ENVIRONMENT |
+                                                   EXTENDED_STARTUPINFO_PRESENT | CREATE_SUSPENDED,
+                                               (void*)maybe_environment,
+                                               nullptr,
+                                               &startup_info.StartupInfo,
+                                               &process_info);
+        }
+        if (!succeeded) Debug::println("CreateProcessW() failed with error code: %lu", GetLastError());
+
+        DeleteProcThreadAttributeList(attribute_list);
+        if (null_input != INVALID_HANDLE_VALUE) CloseHandle(null_input);
+        return succeeded;
+    }
+
+    /// <summary>
+    /// Starts cmd_line under the supervisor. With merge_output, stderr goes to the pipe of stdout and on_stderr is
+    /// unused.
+    /// </summary>
+    static void spawn_supervised(std::wstring cmd_line,
+                                 const wchar_t* maybe_environment,
+                                 const bool merge_output,
+                                 OutputCallback on_stdout,
+                                 OutputCallback on_stderr,
+                                 ExitCallback on_exit,
+                                 const Optional<std::chrono::milliseconds>& timeout)
+    {
+        auto child = std::make_unique<ProcessSupervisor::Child>();
+        HANDLE out_write = nullptr;
+        HANDLE err_write = nullptr;
+        bool succeeded = create_overlapped_pipe(child->streams[0].pipe, out_write);
+        if (succeeded && !merge_output)
+        {
+            succeeded = create_overlapped_pipe(child->streams[1].pipe, err_write);
+        }
+        if (!succeeded)
+        {
+            Debug::println("Creating a pipe failed with error code: %lu", GetLastError());
+            for (auto&& handle : {child->streams[0].pipe, child->streams[1].pipe, out_write})
+            {
+                if (handle != nullptr) CloseHandle(handle);
+            }
+            on_exit({1, false});
+            return;
+        }
+
+        // Flush stdout before launching external process
+        fflush(nullptr);
+
+        GlobalState::g_ctrl_c_state.transition_to_spawn_process();
+        PROCESS_INFORMATION process_info;
+        memset(&process_info, 0, sizeof(PROCESS_INFORMATION));
+        succeeded = windows_create_supervised_process(
+            std::move(cmd_line), maybe_environment, out_write, merge_output ? out_write : err_write, process_info);
+        CloseHandle(out_write);
+        if (err_write != nullptr) CloseHandle(err_write);
+        if (!succeeded)
+        {
+            GlobalState::g_ctrl_c_state.transition_from_spawn_process();
+            for (auto&& stream : child->streams)
+            {
+                if (stream.pipe != nullptr) CloseHandle(stream.pipe);
+            }
+            on_exit({1, false});
+            return;
+        }
+        // Assigned before it runs, so that every process it starts is in the job as well. Older versions of Windows
+        // refuse when vcpkg runs in a job of its own; the memory is not measured then.
+        child->job = CreateJobObjectW(nullptr, nullptr);
+        if (child->job != nullptr && !AssignProcessToJobObject(child->job, process_info.hProcess))
+        {
+            CloseHandle(child->job);
+            child->job = nullptr;
+        }
+        ResumeThread(process_info.hThread);
+        CloseHandle(process_info.hThread);
+
+        child->process = process_info.hProcess;
+        child->process_id = process_info.dwProcessId;
+        child->streams[0].callback = std::move(on_stdout);
+        child->streams[1].callback = std::move(on_stderr);
+        child->open_streams = merge_output ? 1 : 2;
+        child->on_exit = std::move(on_exit);
+        if (const auto t = timeout.get()) child->deadline = std::chrono::steady_clock::now() + *t;
+        ProcessSupervisor::get().add(child.release());
+    }
+#else
+    /// <summary>Creates a pipe that no child inherits, even one that another thread starts at the same time.</summary>
+    // The process groups of supervised children with a timeout. They no longer receive the signals that the terminal
+    // sends to vcpkg's own group, so vcpkg passes these on before it stops.
+    static constexpr size_t MAX_PROCESS_GROUPS = 256;
+    static std::atomic<pid_t> g_process_groups[MAX_PROCESS_GROUPS];
+
+    static void forward_signal_to_process_groups(int signal_number)
+    {
+        for (auto&& group : g_process_groups)
+        {
+            const pid_t pgid = group.load();
+            if (pgid > 0) kill(-pgid, signal_number);
+        }
+        signal(signal_number, SIG_DFL);
+        raise(signal_number);
+    }
+
+    static void register_process_group(pid_t pgid)
+    {
+        static std::once_flag s_handlers_installed;
+        std::call_once(s_handlers_installed, []() {
+            for (const int signal_number : {SIGINT, SIGTERM, SIGHUP})
+            {
+                // Signals vcpkg was started ignoring, as under nohup, stay ignored
+                struct sigaction action = {};
+                if (sigaction(signal_number, nullptr, &action) != 0 || action.sa_handler == SIG_IGN) continue;
+                action = {};
+                action.sa_handler = forward_signal_to_process_groups;
+                sigemptyset(&action.sa_mask);
+                sigaction(signal_number, &action, nullptr);
+            }
+        });
+
+        for (auto&& group : g_process_groups)
+        {
+            pid_t expected = 0;
+            if (group.compare_exchange_strong(expected, pgid)) return;
+        }
+    }
+
+    static void unregister_process_group(pid_t pgid)
+    {
+        for (auto&& group : g_process_groups)
+        {
+            pid_t expected = pgid;
+            if (group.compare_exchange_strong(expected, 0)) return;
+        }
+    }
+
+    static bool create_cloexec_pipe(int fds[2])
+    {
+#if defined(__linux__) || defined(__FreeBSD__)
+        return pipe2(fds, O_CLOEXEC) == 0;
+#else
+        if (pipe(fds) != 0) return false;
+        // A child started in between inherits the pipe, which can only delay the end of this one's output
+        fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+        return true;
+#endif
+    }
+
+    /// <summary>
+    /// Watches every child started by the _async functions from one thread, which polls the output pipes of all of
+    /// them at once. New children wake it through a pipe of its own.
+    /// </summary>
+    struct ProcessSupervisor
+    {
+        struct Child
+        {
+            pid_t pid = 0;
+            /// <summary>stdout and stderr; -1 once closed, or when stderr goes to stdout</summary>
+            std::array<int, 2> fds = {{-1, -1}};
+            std::array<OutputCallback, 2> callbacks;
+            ExitCallback on_exit;
+            /// <summary>Set with the deadline; the child leads a process group of its own.</summary>
+            Optional<std::chrono::steady_clock::time_point> deadline;
+            bool timed_out = false;
+            int exit_code = 0;
+            uint64_t peak_memory_kib = 0;
+        };
+
+        static ProcessSupervisor& get()
+        {
+            // Never destroyed: children may still be running when vcpkg exits
+            static ProcessSupervisor* supervisor = new ProcessSupervisor();
+            return *supervisor;
+        }
+
+        void add(std::unique_ptr<Child> child)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_added.push_back(std::move(child));
+            }
+            const char wake = 0;
+            while (write(m_wake[1], &wake, 1) < 0 && errno == EINTR)
+            {
+            }
+        }
+
+    private:
+        ProcessSupervisor()
+        {
+            Checks::check_exit(VCPKG_LINE_INFO, create_cloexec_pipe(m_wake.data()), "pipe() failed");
+            fcntl(m_wake[0], F_SETFL, O_NONBLOCK);
+            fcntl(m_wake[1], F_SETFL, O_NONBLOCK);
+            std::thread([this]() { run(); }).detach();
+        }
+
+        static void close_fd(int& fd)
+        {
+            close(fd);
+            fd = -1;
+        }
+
+        void run()
+        {
+            std::vector<std::unique_ptr<Child>> children;
+            std::vector<pollfd> fds;
+            std::vector<int*> fd_owners;
+            char buf[4096];
+            while (true)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    for (auto&& child : m_added)
+                    {
+                        children.push_back(std::move(child));
+                    }
+                    m_added.clear();
+                }
+
+                int wait_ms = -1;
+                const auto shorten_wait = [&](int ms) { wait_ms = wait_ms < 0 ? ms : std::min(wait_ms, ms); };
+
+                const auto now = std::chrono::steady_clock::now();
+                std::vector<std::unique_ptr<Child>> exited;
+                for (auto&& child : children)
+                {
+                    if (const auto deadline = child->deadline.get())
+                    {
+                        if (!child->timed_out && *deadline <= now)
+                        {
+                            // Processes that left the group may still hold the pipes, so they are not read to the end
+                            kill(-child->pid, SIGKILL);
+                            child->timed_out = true;
+                            for (auto&& fd : child->fds)
+                            {
+                                if (fd >= 0) close_fd(fd);
+                            }
+                        }
+                        else if (!child->timed_out)
+                        {
+                            shorten_wait(static_cast<int>(
+                                std::chrono::duration_cast<std::chrono::milliseconds>(*deadline - now).count() + 1));
+                        }
+                    }
+
+                    if (child->fds[0] >= 0 || child->fds[1] >= 0) continue;
+
+                    // The output is closed, so the child has exited or is about to
+                    int status = 0;
+                    rusage usage;
+                    memset(&usage, 0, sizeof(rusage));
+                    const pid_t reaped = wait4(child->pid, &status, WNOHANG, &usage);
+                    if (reaped == 0 || (reaped < 0 && errno == EINTR))
+                    {
+                        shorten_wait(5);
+                        continue;
+                    }
+
+                    child->exit_code = 1;
+                    if (child->deadline.has_value()) unregister_process_group(child->pid);
+                    if (reaped > 0)
+                    {
+                        child->exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+                        // The largest of the child and the descendants it waited for; in bytes on macOS
+#if defined(__APPLE__)
+                        child->peak_memory_kib = static_cast<uint64_t>(usage.ru_maxrss) / 1024;
+#else
+                        child->peak_memory_kib = static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+                    }
+                    Debug::println(
+                        "Supervised process %d exited with %d", static_cast<int>(child->pid), child->exit_code);
+                    exited.push_back(std::move(child));
+                }
+
+                if (!exited.empty())
+                {
+                    Util::erase_remove_if(children, [](const std::unique_ptr<Child>& child) { return !child; });
+                    for (auto&& child : exited)
+                    {
+                        child->on_exit({child->exit_code, child->timed_out, child->peak_memory_kib});
+                    }
+                    // on_exit may have started new children
+                    continue;
+                }
+
+                fds.clear();
+                fd_owners.clear();
+                fds.push_back({m_wake[0], POLLIN, 0});
+                fd_owners.push_back(nullptr);
+                for (auto&& child : children)
+                {
+                    for (auto&& fd : child->fds)
+                    {
+                        if (fd < 0) continue;
+                        fds.push_back({fd, POLLIN, 0});
+                        fd_owners.push_back(&fd);
+                    }
+                }
+
+                if (poll(fds.data(), static_cast<nfds_t>(fds.size()), wait_ms) < 0) continue;
+
+                if (fds[0].revents != 0)
+                {
+                    while (read(m_wake[0], buf, sizeof(buf)) > 0)
+                    {
+                    }
+                }
+
+                size_t owner = 1;
+                for (auto&& child : children)
+                {
+                    for (size_t i = 0; i < child->fds.size(); ++i)
+                    {
+                        if (owner == fds.size() || fd_owners[owner] != &child->fds[i]) continue;
+                        const short revents = fds[owner++].revents;
+                        if (revents == 0) continue;
+
+                        const ssize_t bytes_read = read(child->fds[i], buf, sizeof(buf));
+                        if (bytes_read > 0)
+                        {
+                            if (child->callbacks[i])
+                                child->callbacks[i](std::string_view(buf, static_cast<size_t>(bytes_read)));
+                        }
+                        else if (bytes_read == 0 || (errno != EINTR && errno != EAGAIN))
+                        {
+                            close_fd(child->fds[i]);
+                        }
+                    }
+                }
+            }
+        }
+
+        std::array<int, 2> m_wake;
+        std::mutex m_mutex;
+        std::vector<std::unique_ptr<Child>> m_added;
+    };
+
+    /// <summary>
+    /// Starts program under the supervisor. With merge_output, stderr goes to the pipe of stdout and on_stderr is
+    /// unused.
+    /// </summary>
+    static void spawn_supervised(const std::string& program,
+                                 const std::vector<std::string>& arguments,
+                                 const bool merge_output,
+                                 OutputCallback on_stdout,
+                                 OutputCallback on_stderr,
+                                 ExitCallback on_exit,
+                                 const Optional<std::chrono::milliseconds>& timeout)
+    {
+        int out_pipe[2];
+        int err_pipe[2] = {-1, -1};
+        if (!create_cloexec_pipe(out_pipe))
+        {
+            on_exit({127, false});
+            return;
+        }
+        if (!merge_output && !create_cloexec_pipe(err_pipe))
+        {
+            close(out_pipe[0]);
+            close(out_pipe[1]);
+            on_exit({127, false});
+            return;
+        }
+
+        // dup2 clears FD_CLOEXEC, so the child keeps exactly its three standard streams
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+        posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, merge_output ? out_pipe[1] : err_pipe[1], STDERR_FILENO);
+
+        std::vector<char*> argv;
+        argv.push_back(const_cast<char*>(program.c_str()));
+        for (auto&& argument : arguments)
+        {
+            argv.push_back(const_cast<char*>(argument.c_str()));
+        }
+        argv.push_back(nullptr);
+
+        // Flush stdout before launching external process
+        fflush(nullptr);
+
+        // A child that can time out leads a process group, so that everything it starts is killed along with it
+        posix_spawnattr_t attributes;
+        posix_spawnattr_init(&attributes);
+        if (timeout.has_value())
+        {
+            posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+            posix_spawnattr_setpgroup(&attributes, 0);
+        }
+
+        count_spawn();
+        pid_t pid = 0;
+        const int spawn_error = posix_spawnp(&pid, program.c_str(), &actions, &attributes, argv.data(), environ);
+        posix_spawn_file_actions_destroy(&actions);
+        posix_spawnattr_destroy(&attributes);
+        close(out_pipe[1]);
+        if (!merge_output) close(err_pipe[1]);
+        if (spawn_error != 0)
+        {
+            Debug::println("posix_spawnp() failed: %s", std::generic_category().message(spawn_error));
+            close(out_pipe[0]);
+            if (!merge_output) close(err_pipe[0]);
+            on_exit({127, false});
+            return;
+        }
+
+        auto child = std::make_unique<ProcessSupervisor::Child>();
+        child->pid = pid;
+        child->fds = {{out_pipe[0], err_pipe[0]}};
+        for (auto&& fd : child->fds)
+        {
+            if (fd >= 0) fcntl(fd, F_SETFL, O_NONBLOCK);
+        }
+        child->callbacks = {{std::move(on_stdout), std::move(on_stderr)}};
+        child->on_exit = std::move(on_exit);
+        if (const auto t = timeout.get())
+        {
+            register_process_group(pid);
+            child->deadline = std::chrono::steady_clock::now() + *t;
+        }
+        ProcessSupervisor::get().add(std::move(child));
+    }
+#endif
+
+    /// <summary>
+    /// Wraps the callbacks of a supervised process so that it is recorded in the process log. `maybe_on_stderr` is
+    /// null when stderr is merged into stdout.
+    /// </summary>
+    static void log_supervised(std::string command_line,
+                               OutputCallback& on_stdout,
+                               OutputCallback* maybe_on_stderr,
+                               ExitCallback& on_exit)
+    {
+        if (!ProcessLog::is_enabled()) return;
+
+        // The supervisor calls back on a single thread, so the counting needs no lock
+        auto spawn = std::make_shared<ProcessLog::Spawn>(std::move(command_line));
+        for (OutputCallback* callback : {&on_stdout, maybe_on_stderr})
+        {
+            if (!callback) continue;
+            *callback = [spawn, inner = std::move(*callback)](std::string_view data) {
+                spawn->add_output(data.size());
+                if (inner) inner(data);
+            };
+        }
+        on_exit = [spawn, inner = std::move(on_exit)](const ProcessExit& exit) {
+            spawn->finish(exit.exit_code);
+            inner(exit);
+        };
+    }
+
+    void process_execute_async(const fs::path& program,
+                               const std::vector<std::string>& arguments,
+                               OutputCallback on_stdout,
+                               OutputCallback on_stderr,
+                               ExitCallback on_exit,
+                               const Optional<std::chrono::milliseconds>& timeout) noexcept
+    {
+        Debug::println("process_execute_async(%s %s)", program.u8string(), Strings::join(" ", arguments));
+        log_supervised(program.u8string() + ' ' + Strings::join(" ", arguments), on_stdout, &on_stderr, on_exit);
+#if defined(_WIN32)
+        std::wstring cmd_line;
+        append_quoted_argument(cmd_line, program.native());
+        for (auto&& argument : arguments)
+        {
+            cmd_line.push_back(L' ');
+            append_quoted_argument(cmd_line, Strings::to_utf16(argument));
+        }
+
+        spawn_supervised(std::move(cmd_line),
+                         nullptr,
+                         false,
+                         std::move(on_stdout),
+                         std::move(on_stderr),
+                         std::move(on_exit),
+                         timeout);
+#else
+        spawn_supervised(program.u8string(),
+                         arguments,
+                         false,
+                         std::move(on_stdout),
+                         std::move(on_stderr),
+                         std::move(on_exit),
+                         timeout);
+#endif
+    }
+
+    void cmd_execute_clean_async(const CStringView cmd_line,
+                                 const std::unordered_map<std::string, std::string>& extra_env,
+                                 OutputCallback on_output,
+                                 ExitCallback on_exit,
+                                 const Optional<std::chrono::milliseconds>& timeout) noexcept
+    {
+        log_supervised(cmd_line.c_str(), on_output, nullptr, on_exit);
+#if defined(_WIN32)
+        // Wrapping the command in a single set of quotes causes cmd.exe to correctly execute
+        const std::string actual_cmd_line = Strings::format(R"###(cmd.exe /c "%s")###", cmd_line);
+        Debug::println("cmd_execute_clean_async(%s)", actual_cmd_line);
+        const auto clean_env = compute_clean_environment(extra_env);
+        spawn_supervised(Strings::to_utf16(actual_cmd_line),
+                         clean_env.c_str(),
+                         true,
+                         std::move(on_output),
+                         nullptr,
+                         std::move(on_exit),
+                         timeout);
+#else
+        // Like system(), which cmd_execute_clean uses here, the child inherits this environment
+        Util::unused(extra_env);
+        Debug::println("cmd_execute_clean_async(%s)", cmd_line.c_str());
+        spawn_supervised(
+            "/bin/sh", {"-c", cmd_line.c_str()}, true, std::move(on_output), nullptr, std::move(on_exit), timeout);
+#endif
+    }
+
+    ProcessExit process_execute(const fs::path& program,
+                                const std::vector<std::string>& arguments,
+                                const OutputCallback& on_stdout,
+                                const OutputCallback& on_stderr,
+                                const Optional<std::chrono::milliseconds>& timeout) noexcept
+    {
+        // The supervisor calls back on a single thread, and the callbacks outlive the process, so they are passed
+        // by reference
+        std::promise<ProcessExit> exited;
+        auto result = exited.get_future();
+        process_execute_async(program,
+                              arguments,
+                              on_stdout ? OutputCallback(std::cref(on_stdout)) : OutputCallback(),
+                              on_stderr ? OutputCallback(std::cref(on_stderr)) : OutputCallback(),
+                              [&](const ProcessExit& exit) { exited.set_value(exit); },
+                              timeout);
+        return result.get();
+    }
+
+    ExitCodeAndOutput process_execute_and_capture_output(const fs::path& program,
+                                                         const std::vector<std::string>& arguments) noexcept
+    {
+        std::string output;
+        const auto append = [&](std::string_view data) { output.append(data.data(), data.size()); };
+        const auto result = process_execute(program, arguments, append, append, nullopt);
+#if defined(_WIN32)
+        // Match the text mode pipes of cmd_execute_and_capture_output
+        output = Strings::replace_all(std::move(output), "\r\n", "\n");
+#endif
+        return {result.exit_code, std::move(output)};
+    }
+
     void println() { putchar('\n'); }
 
     void print(const CStringView message) { fputs(message.c_str(), stdout); }
@@ -423,6 +1382,39 @@ namespace vcpkg::System
         println();
     }
 
+    uint64_t get_physical_memory_kib() noexcept
+    {
+#if defined(_WIN32)
+        MEMORYSTATUSEX status;
+        status.dwLength = sizeof(MEMORYSTATUSEX);
+        if (!GlobalMemoryStatusEx(&status)) return 0;
+        return status.ullTotalPhys / 1024;
+#else
+        const long pages = sysconf(_SC_PHYS_PAGES);
+        const long page_size = sysconf(_SC_PAGESIZE);
+        if (pages <= 0 || page_size <= 0) return 0;
+        return static_cast<uint64_t>(pages) * static_cast<uint64_t>(page_size) / 1024;
+#endif
+    }
+
+    uint64_t get_peak_memory_kib() noexcept
+    {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+        return counters.PeakWorkingSetSize / 1024;
+#else
+        rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+        // In bytes on macOS
+#if defined(__APPLE__)
+        return static_cast<uint64_t>(usage.ru_maxrss) / 1024;
+#else
+        return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+#endif
+    }
+
     Optional<std::string> get_environment_variable(const CStringView varname) noexcept
     {
 #if defined(_WIN32)
@@ -0,0 +1,353 @@
+#include "pch.h"
+
+#include <vcpkg/base/optional.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/tar.h>
+#include <vcpkg/base/util.h>
+
+namespace vcpkg::Tar
+{
+    static constexpr size_t BLOCK_SIZE = 512;
+    static constexpr size_t NAME_SIZE = 100;
+    static constexpr size_t PREFIX_SIZE = 155;
+    /// <summary>The largest size that fits the 11 octal digits of a ustar header; larger files need a pax record.</summary>
+    static constexpr uint64_t MAX_OCTAL_SIZE = 077777777777;
+
+    static constexpr char TYPE_FILE = '0';
+    static constexpr char TYPE_OLD_FILE = '\0';
+    static constexpr char TYPE_CONTIGUOUS_FILE = '7';
+    static constexpr char TYPE_DIRECTORY = '5';
+    static constexpr char TYPE_PAX = 'x';
+    static constexpr char TYPE_PAX_GLOBAL = 'g';
+    static constexpr char TYPE_GNU_LONG_NAME = 'L';
+
+    static constexpr size_t IO_CHUNK_SIZE = size_t(1) << 20;
+
+    /// <summary>Writes `value` as zero padded octal digits followed by a NUL into the `size` bytes of `field`.</summary>
+    static void put_octal(char* field, size_t size, uint64_t value)
+    {
+        field[size - 1] = '\0';
+        for (size_t i = size - 1; i-- > 0;)
+        {
+            field[i] = static_cast<char>('0' + (value & 7));
+            value >>= 3;
+        }
+    }
+
+    static uint32_t header_checksum(const char* header)
+    {
+        // The checksum field itself counts as spaces
+        uint32_t sum = 0;
+        for (size_t i = 0; i < BLOCK_SIZE; ++i)
+            sum += (i >= 148 && i < 156) ? ' ' : static_cast<uint8_t>(header[i]);
+        return sum;
+    }
+
+    static std::string make_header(
+        const std::string& name, const uint32_t mode, const uint64_t size, const int64_t mtime, const char type)
+    {
+        std::string header(BLOCK_SIZE, '\0');
+        std::copy_n(name.begin(), std::min(name.size(), NAME_SIZE), header.begin());
+        put_octal(&header[100], 8, mode);
+        put_octal(&header[108], 8, 0); // uid
+        put_octal(&header[116], 8, 0); // gid
+        put_octal(&header[124], 12, std::min(size, MAX_OCTAL_SIZE));
+        put_octal(&header[136], 12, static_cast<uint64_t>(std::max<int64_t>(mtime, 0)));
+        header[156] = type;
+        std::copy_n("ustar\0" "00", 8, &header[257]);
+        put_octal(&header[148], 7, header_checksum(header.data()));
+        header[155] = ' ';
+        return header;
+    }
+
+    /// <summary>A pax record is `<length> <key>=<value>\n`, where the length counts its own digits.</summary>
+    static std::string pax_record(const std::string& key, const std::string& value)
+    {
+        const size_t payload = key.size() + value.size() + 3;
+        size_t length = payload + 1;
+        while (length != payload + std::to_string(length).size())
+            length = payload + std::to_string(length).size();
+        return Strings::format("%zd %s=%s\n", length, key, value);
+    }
+
+    static void write_padding(std::ofstream& out, const uint64_t size)
+    {
+        static const char ZEROS[BLOCK_SIZE] = {};
+        const size_t remainder = static_cast<size_t>(size % BLOCK_SIZE);
+        if (remainder != 0) out.write(ZEROS, BLOCK_SIZE - remainder);
+    }
+
+    ExpectedT<size_t, std::string> create_from_directory(const fs::path& source_dir, const fs::path& archive_path)
+    {
+        std::error_code ec;
+        std::vector<fs::path> paths;
+        for (fs::stdfs::recursive_directory_iterator it(source_dir, ec), end; !ec && it != end; it.increment(ec))
+        {
+            paths.push_back(it->path());
+        }
+        if (ec) return Strings::format("Failed to enumerate %s: %s", source_dir.u8string(), ec.message());
+        Util::sort(paths);
+
+        std::ofstream out(archive_path.native().c_str(), std::ios::binary | std::ios::trunc);
+        if (!out) return Strings::format("Failed to create %s", archive_path.u8string());
+
+        const std::string root = source_dir.generic_u8string();
+        size_t entry_count = 0;
+        std::vector<char> chunk(IO_CHUNK_SIZE);
+
+        for (auto&& path : paths)
+        {
+            // Symlinks are followed, like the zip writer does
+            const auto status = fs::stdfs::status(path, ec);
+            const bool is_directory = !ec && fs::is_directory(status);
+            if (ec || (!is_directory && !fs::is_regular_file(status))) continue;
+
+            std::string name = path.generic_u8string().substr(root.size());
+            while (!name.empty() && name.front() == '/')
+                name.erase(0, 1);
+            if (is_directory) name.push_back('/');
+
+            const uint64_t size = is_directory ? 0 : fs::stdfs::file_size(path, ec);
+            if (ec) return Strings::format("Failed to read %s: %s", path.u8string(), ec.message());
+            const auto write_time = fs::stdfs::last_write_time(path, ec);
+            const int64_t mtime = ec ? 0 : static_cast<int64_t>(fs::stdfs::file_time_type::clock::to_time_t(write_time));
+#if defined(_WIN32)
+            const uint32_t mode = is_directory ? 0755 : 0644;
+#else
+            const uint32_t mode = static_cast<uint32_t>(status.permissions()) & 0777;
+#endif
+
+            std::string pax;
+            if (name.size() > NAME_SIZE) pax += pax_record("path", name);
+            if (size > MAX_OCTAL_SIZE) pax += pax_record("size", std::to_string(size));
+            if (!pax.empty())
+            {
+                const std::string pax_header = make_header("././@PaxHeader", 0644, pax.size(), mtime, TYPE_PAX);
+                out.write(pax_header.data(), pax_header.size());
+                out.write(pax.data(), pax.size());
+                write_padding(out, pax.size());
+            }
+
+            const std::string header = make_header(name, mode, size, mtime, is_directory ? TYPE_DIRECTORY : TYPE_FILE);
+            out.write(header.data(), header.size());
+            ++entry_count;
+            if (is_directory) continue;
+
+            std::ifstream in(path.native().c_str(), std::ios::binary);
+            if (!in) return Strings::format("Failed to open %s", path.u8string());
+            uint64_t read_size = 0;
+            while (in)
+            {
+                in.read(chunk.data(), chunk.size());
+                const size_t count = static_cast<size_t>(in.gcount());
+                out.write(chunk.data(), count);
+                read_size += count;
+            }
+            if (read_size != size) return Strings::format("%s changed while it was being archived", path.u8string());
+            write_padding(out, size);
+        }
+
+        // The archive ends with two zero blocks
+        const std::string end_of_archive(2 * BLOCK_SIZE, '\0');
+        out.write(end_of_archive.data(), end_of_archive.size());
+
+        out.close();
+        if (!out) return Strings::format("Failed to write %s", archive_path.u8string());
+        return entry_count;
+    }
+
+    /// <summary>Parses an octal header field, or a GNU base-256 one when the high bit of its first byte is set.</summary>
+    static bool parse_number(const char* field, const size_t size, uint64_t& value)
+    {
+        value = 0;
+        if ((static_cast<uint8_t>(field[0]) & 0x80) != 0)
+        {
+            value = static_cast<uint8_t>(field[0]) & 0x7F;
+            for (size_t i = 1; i < size; ++i)
+                value = (value << 8) | static_cast<uint8_t>(field[i]);
+            return true;
+        }
+
+        size_t i = 0;
+        while (i < size && field[i] == ' ')
+            ++i;
+        for (; i < size && field[i] >= '0' && field[i] <= '7'; ++i)
+            value = (value << 3) | static_cast<uint64_t>(field[i] - '0');
+        return i == size || field[i] == '\0' || field[i] == ' ';
+    }
+
+    static std::string field_string(const char* field, const size_t size)
+    {
+        return std::string(field, std::find(field, field + size, '\0'));
+    }
+
+    static bool parse_decimal(const std::string& text, uint64_t& value)
+    {
+        value = 0;
+        for (char ch : text)
+        {
+            if (ch < '0' || ch > '9') return false;
+            value = value * 10 + static_cast<uint64_t>(ch - '0');
+        }
+        return !text.empty();
+    }
+
+    static bool parse_pax_records(const std::string& records, std::string& path, Optional<uint64_t>& size)
+    {
+        for (size_t position = 0; position < records.size();)
+        {
+            const size_t space = records.find(' ', position);
+            if (space == std::string::npos) return false;
+            uint64_t length;
+            if (!parse_decimal(records.substr(position, space - position), length) || length <= space - position ||
+                position + length > records.size() || records[position + length - 1] != '\n')
+                return false;
+
+            const std::string record = records.substr(space + 1, position + length - space - 2);
+            const size_t equals = record.find('=');
+            if (equals == std::string::npos) return false;
+            const std::string key = record.substr(0, equals);
+            const std::string value = record.substr(equals + 1);
+            if (key == "path")
+            {
+                path = value;
+            }
+            else if (key == "size")
+            {
+                uint64_t parsed_size;
+                if (!parse_decimal(value, parsed_size)) return false;
+                size = parsed_size;
+            }
+            position += length;
+        }
+        return true;
+    }
+
+    static bool read_exactly(std::ifstream& in, char* buffer, const size_t size)
+    {
+        in.read(buffer, size);
+        return static_cast<size_t>(in.gcount()) == size;
+    }
+
+    static bool skip_padding(std::ifstream& in, const uint64_t size)
+    {
+        const size_t remainder = static_cast<size_t>(size % BLOCK_SIZE);
+        if (remainder == 0) return true;
+        char padding[BLOCK_SIZE];
+        return read_exactly(in, padding, BLOCK_SIZE - remainder);
+    }
+
+    /// <summary>
+    /// Rejects names that would be written outside of the destination directory.
+    /// </summary>
+    static bool is_safe_entry_name(const std::string& name)
+    {
+        if (name.empty() || name.front() == '/' || name.find(':') != std::string::npos) return false;
+        for (auto&& component : Strings::split(name, "/"))
+        {
+            if (component == "..") return false;
+        }
+        return true;
+    }
+
+    ExpectedT<size_t, std::string> extract(const fs::path& archive_path, const fs::path& destination)
+    {
+        const std::string archive = archive_path.u8string();
+        std::ifstream in(archive_path.native().c_str(), std::ios::binary);
+        if (!in) return Strings::format("Failed to open %s", archive);
+
+        std::error_code ec;
+        fs::stdfs::create_directories(destination, ec);
+
+        // Extended names and sizes apply to the entry that follows them
+        std::string next_path;
+        Optional<uint64_t> next_size;
+        size_t entry_count = 0;
+        std::vector<char> chunk(IO_CHUNK_SIZE);
+
+        char header[BLOCK_SIZE];
+        while (true)
+        {
+            in.read(header, BLOCK_SIZE);
+            const size_t header_size = static_cast<size_t>(in.gcount());
+            if (header_size == 0) break;
+            if (header_size != BLOCK_SIZE) return Strings::format("%s is truncated", archive);
+            if (std::all_of(header, header + BLOCK_SIZE, [](char ch) { return ch == '\0'; })) break;
+
+            uint64_t checksum, size, mode;
+            if (!parse_number(header + 148, 8, checksum) || checksum != header_checksum(header))
+                return Strings::format("%s has a corrupt header at offset %lld",
+                                       archive,
+                                       static_cast<long long>(in.tellg()) - static_cast<long long>(BLOCK_SIZE));
+            if (!parse_number(header + 124, 12, size) || !parse_number(header + 100, 8, mode))
+                return Strings::format("%s has a corrupt header", archive);
+
+            const char type = header[156];
+            if (type == TYPE_PAX || type == TYPE_PAX_GLOBAL || type == TYPE_GNU_LONG_NAME)
+            {
+                if (size > IO_CHUNK_SIZE) return Strings::format("%s has an oversized extended header", archive);
+                std::string data(static_cast<size_t>(size), '\0');
+                if (!read_exactly(in, &data[0], data.size()) || !skip_padding(in, size))
+                    return Strings::format("%s is truncated", archive);
+
+                if (type == TYPE_GNU_LONG_NAME)
+                    next_path = field_string(data.data(), data.size());
+                else if (type == TYPE_PAX && !parse_pax_records(data, next_path, next_size))
+                    return Strings::format("%s has a corrupt pax header", archive);
+                continue;
+            }
+
+            std::string name = std::move(next_path);
+            next_path.clear();
+            if (name.empty())
+            {
+                name = field_string(header, NAME_SIZE);
+                const std::string prefix = field_string(header + 345, PREFIX_SIZE);
+                if (field_string(header + 257, 6).compare(0, 5, "ustar") == 0 && !prefix.empty())
+                    name = prefix + "/" + name;
+            }
+            if (const auto p_size = next_size.get()) size = *p_size;
+            next_size = nullopt;
+
+            const bool is_directory = type == TYPE_DIRECTORY;
+            if (!is_directory && type != TYPE_FILE && type != TYPE_OLD_FILE && type != TYPE_CONTIGUOUS_FILE)
+                return Strings::format("%s has an unsupported entry type '%c' for %s", archive, type, name);
+
+            std::replace(name.begin(), name.end(), '\\', '/');
+            while (name.compare(0, 2, "./") == 0)
+                name.erase(0, 2);
+            while (!name.empty() && name.back() == '/')
+                name.pop_back();
+            if (name.empty() || name == ".")
+            {
+                if (!is_directory) return Strings::format("%s has a file entry without a name", archive);
+                continue;
+            }
+            if (!is_safe_entry_name(name)) return Strings::format("%s has an unsafe entry %s", archive, name);
+
+            const fs::path target = destination / fs::u8path(name);
+            fs::stdfs::create_directories(is_directory ? target : target.parent_path(), ec);
+            ++entry_count;
+            if (is_directory) continue;
+
+            std::ofstream out(target.native().c_str(), std::ios::binary | std::ios::trunc);
+            if (!out) return Strings::format("Failed to create %s", target.u8string());
+            for (uint64_t remaining = size; remaining > 0;)
+            {
+                const size_t count = static_cast<size_t>(std::min<uint64_t>(remaining, chunk.size()));
+                if (!read_exactly(in, chunk.data(), count)) return Strings::format("%s is truncated", archive);
+                out.write(chunk.data(), count);
+                remaining -= count;
+            }
+            if (!skip_padding(in, size)) return Strings::format("%s is truncated", archive);
+            out.close();
+            if (!out) return Strings::format("Failed to write %s", target.u8string());
+
+#if !defined(_WIN32)
+            if ((mode & 0777) != 0) fs::stdfs::permissions(target, static_cast<fs::stdfs::perms>(mode & 0777), ec);
+#endif
+        }
+
+        return entry_count;
+    }
+}
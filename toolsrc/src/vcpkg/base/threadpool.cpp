@@ -0,0 +1,219 @@
+#include "pch.h"
+
+#include <vcpkg/base/checks.h>
+#include <vcpkg/base/threadpool.h>
+
+namespace vcpkg::ThreadPool
+{
+    static std::atomic<size_t> g_max_threads{0};
+
+    void set_max_threads(size_t max_threads)
+    {
+        Checks::check_exit(VCPKG_LINE_INFO, max_threads > 0);
+        g_max_threads = max_threads;
+    }
+
+    size_t get_max_threads()
+    {
+        const size_t max_threads = g_max_threads.load();
+        if (max_threads != 0) return max_threads;
+        return std::max<size_t>(16, std::thread::hardware_concurrency());
+    }
+
+    using Task = std::function<void()>;
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    /// <summary>
+    /// Workers take the newest task of their own queue, and steal the oldest task of another when theirs is empty.
+    /// Tasks queued by other threads are spread over the workers in turn.
+    /// </summary>
+    struct Pool
+    {
+        explicit Pool(size_t worker_count) : workers(worker_count)
+        {
+            for (size_t i = 0; i < worker_count; ++i)
+            {
+                // The pool lives until the process exits, so the workers are never joined
+                std::thread([this, i]() { run(i); }).detach();
+            }
+        }
+
+        void push(Task task)
+        {
+            const size_t index = current_worker != nullptr && current_worker->pool == this
+                                     ? current_worker->index
+                                     : next_worker++ % workers.size();
+            {
+                std::lock_guard<std::mutex> lock(workers[index].mutex);
+                workers[index].tasks.push_back(std::move(task));
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            ++queued;
+            work_available.notify_one();
+        }
+
+    private:
+        struct CurrentWorker
+        {
+            Pool* pool;
+            size_t index;
+        };
+
+        static thread_local const CurrentWorker* current_worker;
+
+        bool try_take(const size_t index, Task& task)
+        {
+            {
+                Worker& own = workers[index];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.tasks.empty())
+                {
+                    task = std::move(own.tasks.back());
+                    own.tasks.pop_back();
+                    return true;
+                }
+            }
+
+            for (size_t offset = 1; offset < workers.size(); ++offset)
+            {
+                Worker& victim = workers[(index + offset) % workers.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tasks.empty())
+                {
+                    task = std::move(victim.tasks.front());
+                    victim.tasks.pop_front();
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void run(const size_t index)
+        {
+            const CurrentWorker self{this, index};
+            current_worker = &self;
+
+            while (true)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    work_available.wait(lock, [&]() { return queued != 0; });
+                    --queued;
+                }
+
+                // Every push counts one task, so one is queued somewhere even if another worker took this one's
+                Task task;
+                while (!try_take(index, task))
+                {
+                    std::this_thread::yield();
+                }
+                task();
+            }
+        }
+
+        std::vector<Worker> workers;
+        std::atomic<size_t> next_worker{0};
+
+        std::mutex mutex;
+        std::condition_variable work_available;
+        size_t queued = 0;
+    };
+
+    thread_local const Pool::CurrentWorker* Pool::current_worker = nullptr;
+
+    static Pool& get_pool()
+    {
+        // Never destroyed: workers may still be running when the process exits
+        static Pool* pool = new Pool(std::max<size_t>(1, get_max_threads() - 1));
+        return *pool;
+    }
+
+    /// <summary>
+    /// The state shared by the caller of parallel_for and the tasks that help it. A task that starts after the caller
+    /// has finished finds the job closed and returns without touching `f`, so the caller never waits for tasks that
+    /// have not started.
+    /// </summary>
+    struct ParallelJob
+    {
+        ParallelJob(size_t count, const std::function<void(size_t)>& f) : count(count), f(f) {}
+
+        void work()
+        {
+            for (size_t i = next++; i < count; i = next++)
+            {
+                try
+                {
+                    f(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!error) error = std::current_exception();
+                    next = count;
+                }
+            }
+        }
+
+        void help()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (closed) return;
+                ++helping;
+            }
+
+            work();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--helping == 0) helpers_done.notify_all();
+        }
+
+        void finish()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            closed = true;
+            helpers_done.wait(lock, [&]() { return helping == 0; });
+            if (error) std::rethrow_exception(error);
+        }
+
+        const size_t count;
+        const std::function<void(size_t)>& f;
+        std::atomic<size_t> next{0};
+
+        std::mutex mutex;
+        std::condition_variable helpers_done;
+        size_t helping = 0;
+        bool closed = false;
+        std::exception_ptr error;
+    };
+
+    void parallel_for(size_t count, size_t max_parallelism, const std::function<void(size_t)>& f)
+    {
+        const size_t thread_count = std::min({count, max_parallelism, get_max_threads()});
+        if (thread_count <= 1)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                f(i);
+            }
+            return;
+        }
+
+        auto job = std::make_shared<ParallelJob>(count, f);
+        Pool& pool = get_pool();
+        for (size_t i = 1; i < thread_count; ++i)
+        {
+            pool.push([job]() { job->help(); });
+        }
+
+        job->work();
+        job->finish();
+    }
+}
@@ -0,0 +1,124 @@
+#include "pch.h"
+
+#include <vcpkg/base/json.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/base/trace.h>
+#include <vcpkg/base/util.h>
+
+namespace vcpkg::Trace
+{
+    namespace
+    {
+        struct Event
+        {
+            const char* category;
+            std::string name;
+            double start_us;
+            double duration_us;
+            int thread;
+            /// <summary>Set only for the summaries, which are instant events</summary>
+            std::string args;
+        };
+
+        struct State
+        {
+            fs::path path;
+            std::vector<Event> events;
+        };
+    }
+
+    static std::atomic<bool> g_enabled{false};
+    static Chrono::ElapsedTimer g_start;
+    static Util::LockGuarded<State> g_state;
+    static thread_local const char* t_category = "other";
+
+    static int current_thread()
+    {
+        // Small numbers read better in the viewer than the native thread ids
+        static std::atomic<int> next_thread{1};
+        static thread_local const int thread = next_thread++;
+        return thread;
+    }
+
+    void enable(const fs::path& path)
+    {
+        g_state.lock()->path = path;
+        g_start = Chrono::ElapsedTimer::create_started();
+        g_enabled = true;
+        // The main thread comes first
+        current_thread();
+    }
+
+    bool is_enabled() { return g_enabled; }
+
+    Scope::Scope(const char* category, std::string name)
+        : m_category(category)
+        , m_outer_category(t_category)
+        , m_name(std::move(name))
+        , m_start_us(g_enabled ? g_start.microseconds() : -1.0)
+    {
+        t_category = category;
+    }
+
+    Scope::~Scope()
+    {
+        t_category = m_outer_category;
+        if (m_start_us < 0) return;
+
+        const double end_us = g_start.microseconds();
+        const int thread = current_thread();
+        g_state.lock()->events.push_back(
+            {m_category, std::move(m_name), m_start_us, end_us - m_start_us, thread, {}});
+    }
+
+    const char* current_category() { return t_category; }
+
+    void add_summary(const char* category, std::string name, std::string args)
+    {
+        if (!g_enabled) return;
+
+        const double now_us = g_start.microseconds();
+        g_state.lock()->events.push_back({category, std::move(name), now_us, 0.0, 1, std::move(args)});
+    }
+
+    void write()
+    {
+        if (!g_enabled) return;
+
+        auto state = g_state.lock();
+        state->events.push_back({"vcpkg", "vcpkg", 0.0, g_start.microseconds(), 1, {}});
+
+        std::string json = "{\"traceEvents\":[\n";
+        for (auto&& event : state->events)
+        {
+            json.append("{\"name\":");
+            Json::append_string(json, event.name);
+            if (!event.args.empty())
+            {
+                json.append(Strings::format(R"(,"cat":"%s","ph":"i","s":"g","ts":%.3f,"pid":1,"tid":%d,"args":%s},)",
+                                            event.category,
+                                            event.start_us,
+                                            event.thread,
+                                            event.args));
+                json.push_back('\n');
+                continue;
+            }
+            json.append(Strings::format(R"(,"cat":"%s","ph":"X","ts":%.3f,"dur":%.3f,"pid":1,"tid":%d},)",
+                                        event.category,
+                                        event.start_us,
+                                        event.duration_us,
+                                        event.thread));
+            json.push_back('\n');
+        }
+        json.append("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"vcpkg\"}}\n]}\n");
+
+        std::error_code ec;
+        Files::get_real_filesystem().write_contents(state->path, json, ec);
+        if (ec)
+        {
+            System::println(
+                System::Color::warning, "Warning: failed to write %s: %s", state->path.u8string(), ec.message());
+        }
+    }
+}
@@ -0,0 +1,175 @@
+#include "pch.h"
+
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/transfers.h>
+
+#include <condition_variable>
+#include <mutex>
+
+namespace vcpkg::Transfers
+{
+    using Clock = std::chrono::steady_clock;
+
+    namespace
+    {
+        /// <summary>
+        /// A token bucket that may go into debt: a transfer counts what it moved at once, and the next one to count
+        /// waits until the debt is paid off. Idle time saves up at most one second of the rate.
+        /// </summary>
+        struct Bucket
+        {
+            double available = 0;
+            Clock::time_point updated = Clock::now();
+
+            void refill(const uint64_t rate, const Clock::time_point now)
+            {
+                const double elapsed = std::chrono::duration<double>(now - updated).count();
+                available = std::min(static_cast<double>(rate), available + elapsed * static_cast<double>(rate));
+                updated = now;
+            }
+
+            /// <summary>How long until the debt is paid off, at `rate`.</summary>
+            Clock::duration time_to_pay(const uint64_t rate) const
+            {
+                if (rate == 0 || available >= 0) return Clock::duration::zero();
+                return std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(-available / static_cast<double>(rate)));
+            }
+        };
+
+        struct Host
+        {
+            size_t active = 0;
+            Bucket bucket;
+        };
+
+        struct Waiter
+        {
+            int64_t priority;
+            uint64_t sequence;
+            const std::string* host;
+        };
+
+        struct State
+        {
+            Limits limits;
+            size_t active = 0;
+            std::map<std::string, Host> hosts;
+            Bucket bucket;
+            uint64_t next_sequence = 0;
+            /// <summary>The transfers waiting to start</summary>
+            std::vector<Waiter> starting;
+            /// <summary>The transfers waiting for their rate</summary>
+            std::vector<Waiter> throttled;
+        };
+    }
+
+    static std::mutex g_mutex;
+    static std::condition_variable g_changed;
+    static State g_state;
+    static thread_local int64_t t_priority = FOREGROUND;
+
+    void set_limits(const Limits& limits)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_state.limits = limits;
+        g_changed.notify_all();
+    }
+
+    PriorityScope::PriorityScope(int64_t priority) : m_outer_priority(t_priority) { t_priority = priority; }
+
+    PriorityScope::~PriorityScope() { t_priority = m_outer_priority; }
+
+    int64_t current_priority() { return t_priority; }
+
+    /// <summary>The host and port of `url`, which are limited together.</summary>
+    static std::string host_of(const std::string& url)
+    {
+        const auto scheme_end = url.find("://");
+        const size_t begin = scheme_end == std::string::npos ? 0 : scheme_end + 3;
+        const size_t end = std::min(url.find_first_of("/?#", begin), url.size());
+        std::string authority = url.substr(begin, end - begin);
+        const auto at = authority.rfind('@');
+        if (at != std::string::npos) authority.erase(0, at + 1);
+        return Strings::ascii_to_lowercase(std::move(authority));
+    }
+
+    static bool goes_before(const Waiter& lhs, const Waiter& rhs)
+    {
+        if (lhs.priority != rhs.priority) return lhs.priority > rhs.priority;
+        return lhs.sequence < rhs.sequence;
+    }
+
+    static bool has_room(const State& state, const std::string& host)
+    {
+        if (state.limits.max_transfers != 0 && state.active >= state.limits.max_transfers) return false;
+        const auto it = state.hosts.find(host);
+        return state.limits.max_transfers_per_host == 0 || it == state.hosts.end() ||
+               it->second.active < state.limits.max_transfers_per_host;
+    }
+
+    Slot::Slot(const std::string& url) : m_host(host_of(url)), m_priority(t_priority)
+    {
+        std::unique_lock<std::mutex> lock(g_mutex);
+        const Waiter self{m_priority, g_state.next_sequence++, &m_host};
+        g_state.starting.push_back(self);
+
+        // Transfers to a host that is full do not hold back the ones to other hosts
+        g_changed.wait(lock, [&]() {
+            if (!has_room(g_state, m_host)) return false;
+            return std::none_of(g_state.starting.begin(), g_state.starting.end(), [&](const Waiter& other) {
+                return goes_before(other, self) && has_room(g_state, *other.host);
+            });
+        });
+
+        g_state.starting.erase(std::find_if(g_state.starting.begin(), g_state.starting.end(), [&](const Waiter& w) {
+            return w.sequence == self.sequence;
+        }));
+        ++g_state.active;
+        ++g_state.hosts[m_host].active;
+        g_changed.notify_all();
+    }
+
+    Slot::~Slot()
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        --g_state.active;
+        --g_state.hosts[m_host].active;
+        g_changed.notify_all();
+    }
+
+    void Slot::throttle(size_t bytes)
+    {
+        std::unique_lock<std::mutex> lock(g_mutex);
+        const Limits& limits = g_state.limits;
+        if (bytes == 0 || (limits.max_rate == 0 && limits.max_rate_per_host == 0)) return;
+
+        Host& host = g_state.hosts[m_host];
+        const Waiter self{m_priority, g_state.next_sequence++, &m_host};
+        g_state.throttled.push_back(self);
+        while (true)
+        {
+            const auto now = Clock::now();
+            g_state.bucket.refill(limits.max_rate, now);
+            host.bucket.refill(limits.max_rate_per_host, now);
+
+            // A more urgent transfer waiting on a limit this one shares gets the bandwidth first
+            const bool is_next =
+                std::none_of(g_state.throttled.begin(), g_state.throttled.end(), [&](const Waiter& other) {
+                    return other.priority > m_priority && (limits.max_rate != 0 || *other.host == m_host);
+                });
+            const auto wait = std::max(g_state.bucket.time_to_pay(limits.max_rate),
+                                       host.bucket.time_to_pay(limits.max_rate_per_host));
+            if (is_next && wait == Clock::duration::zero()) break;
+
+            g_changed.wait_for(lock, is_next ? wait : std::chrono::milliseconds(10));
+        }
+
+        g_state.throttled.erase(std::find_if(g_state.throttled.begin(),
+                                             g_state.throttled.end(),
+                                             [&](const Waiter& w) { return w.sequence == self.sequence; }));
+        if (limits.max_rate != 0) g_state.bucket.available -= static_cast<double>(bytes);
+        if (limits.max_rate_per_host != 0) host.bucket.available -= static_cast<double>(bytes);
+        g_changed.notify_all();
+    }
+}
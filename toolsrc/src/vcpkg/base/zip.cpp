@@ -0,0 +1,855 @@
+#include "pch.h"
+
+#include <vcpkg/base/deflate.h>
+#include <vcpkg/base/optional.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/util.h>
+#include <vcpkg/base/zip.h>
+
+namespace vcpkg::Zip
+{
+    static constexpr uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+    static constexpr uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+    static constexpr uint32_t END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06054b50;
+    static constexpr uint32_t ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06064b50;
+    static constexpr uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+
+    static constexpr size_t LOCAL_HEADER_SIZE = 30;
+    static constexpr size_t CENTRAL_HEADER_SIZE = 46;
+    static constexpr size_t END_OF_CENTRAL_DIRECTORY_SIZE = 22;
+    static constexpr size_t ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE = 56;
+    static constexpr size_t ZIP64_LOCATOR_SIZE = 20;
+
+    static constexpr uint16_t ZIP64_EXTRA_ID = 0x0001;
+    static constexpr uint16_t METHOD_STORED = 0;
+    static constexpr uint16_t METHOD_DEFLATE = 8;
+    static constexpr uint16_t FLAG_ENCRYPTED = 1 << 0;
+    static constexpr uint16_t FLAG_UTF8 = 1 << 11;
+    static constexpr uint16_t VERSION = 45;
+    static constexpr uint16_t HOST_UNIX = 3;
+    static constexpr uint32_t DOS_DIRECTORY_ATTRIBUTE = 0x10;
+
+    static constexpr uint32_t MAX_16 = 0xFFFF;
+    static constexpr uint32_t MAX_32 = 0xFFFFFFFF;
+    /// <summary>
+    /// Files at least this large get zip64 sizes in their local header. It leaves room for the few bytes deflate adds
+    /// to incompressible data, so smaller files never outgrow 32 bit sizes.
+    /// </summary>
+    static constexpr uint64_t ZIP64_LOCAL_THRESHOLD = 0xFF000000;
+
+    static constexpr size_t IO_CHUNK_SIZE = size_t(1) << 20;
+    static constexpr uint64_t PARALLEL_SIZE_LIMIT = uint64_t(16) << 20;
+
+    static uint32_t update_crc32(uint32_t crc, const char* data, size_t size)
+    {
+        static const std::array<uint32_t, 256> TABLE = []() {
+            std::array<uint32_t, 256> table;
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; ++bit)
+                    value = (value & 1) ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+                table[i] = value;
+            }
+            return table;
+        }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i)
+            crc = TABLE[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    static void put16(std::string& out, uint64_t value)
+    {
+        for (int i = 0; i < 2; ++i)
+            out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+
+    static void put32(std::string& out, uint64_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+            out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+
+    static void put64(std::string& out, uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i)
+            out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+
+    static uint64_t get_le(const char* data, size_t size)
+    {
+        uint64_t value = 0;
+        for (size_t i = size; i-- > 0;)
+            value = (value << 8) | static_cast<uint8_t>(data[i]);
+        return value;
+    }
+
+    static uint16_t get16(const char* data) { return static_cast<uint16_t>(get_le(data, 2)); }
+    static uint32_t get32(const char* data) { return static_cast<uint32_t>(get_le(data, 4)); }
+    static uint64_t get64(const char* data) { return get_le(data, 8); }
+
+    static uint32_t to_dos_date_time(const std::time_t time)
+    {
+        tm parts{};
+#if defined(_WIN32)
+        if (localtime_s(&parts, &time) != 0) return 0;
+#else
+        if (localtime_r(&time, &parts) == nullptr) return 0;
+#endif
+        // DOS timestamps start in 1980 and have a two second resolution
+        if (parts.tm_year < 80) return (1 << 5 | 1) << 16;
+        const uint32_t date = static_cast<uint32_t>((parts.tm_year - 80) << 9 | (parts.tm_mon + 1) << 5 | parts.tm_mday);
+        const uint32_t clock = static_cast<uint32_t>(parts.tm_hour << 11 | parts.tm_min << 5 | parts.tm_sec / 2);
+        return date << 16 | clock;
+    }
+
+    struct CentralEntry
+    {
+        std::string name;
+        uint16_t method;
+        uint32_t dos_date_time;
+        uint32_t crc;
+        uint64_t compressed_size;
+        uint64_t uncompressed_size;
+        uint64_t offset;
+        uint32_t external_attributes;
+    };
+
+    static void write_central_entry(std::string& out, const CentralEntry& entry)
+    {
+        const bool zip64_sizes = entry.compressed_size >= MAX_32 || entry.uncompressed_size >= MAX_32;
+        const bool zip64_offset = entry.offset >= MAX_32;
+
+        std::string extra;
+        if (zip64_sizes || zip64_offset)
+        {
+            put16(extra, ZIP64_EXTRA_ID);
+            put16(extra, (zip64_sizes ? 16 : 0) + (zip64_offset ? 8 : 0));
+            if (zip64_sizes)
+            {
+                put64(extra, entry.uncompressed_size);
+                put64(extra, entry.compressed_size);
+            }
+            if (zip64_offset) put64(extra, entry.offset);
+        }
+
+#if defined(_WIN32)
+        const uint16_t version_made_by = VERSION;
+#else
+        const uint16_t version_made_by = HOST_UNIX << 8 | VERSION;
+#endif
+
+        put32(out, CENTRAL_HEADER_SIGNATURE);
+        put16(out, version_made_by);
+        put16(out, VERSION);
+        put16(out, FLAG_UTF8);
+        put16(out, entry.method);
+        put32(out, entry.dos_date_time);
+        put32(out, entry.crc);
+        put32(out, zip64_sizes ? MAX_32 : entry.compressed_size);
+        put32(out, zip64_sizes ? MAX_32 : entry.uncompressed_size);
+        put16(out, entry.name.size());
+        put16(out, extra.size());
+        put16(out, 0); // comment length
+        put16(out, 0); // disk number
+        put16(out, 0); // internal attributes
+        put32(out, entry.external_attributes);
+        put32(out, zip64_offset ? MAX_32 : entry.offset);
+        out += entry.name;
+        out += extra;
+    }
+
+    static void write_end_of_central_directory(std::string& out,
+                                               const uint64_t entry_count,
+                                               const uint64_t directory_size,
+                                               const uint64_t directory_offset)
+    {
+        const bool zip64 = entry_count >= MAX_16 || directory_size >= MAX_32 || directory_offset >= MAX_32;
+        if (zip64)
+        {
+            const uint64_t record_offset = directory_offset + directory_size;
+            put32(out, ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE);
+            put64(out, ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE - 12);
+            put16(out, VERSION);
+            put16(out, VERSION);
+            put32(out, 0);
+            put32(out, 0);
+            put64(out, entry_count);
+            put64(out, entry_count);
+            put64(out, directory_size);
+            put64(out, directory_offset);
+
+            put32(out, ZIP64_LOCATOR_SIGNATURE);
+            put32(out, 0);
+            put64(out, record_offset);
+            put32(out, 1);
+        }
+
+        put32(out, END_OF_CENTRAL_DIRECTORY_SIGNATURE);
+        put16(out, 0);
+        put16(out, 0);
+        put16(out, std::min<uint64_t>(entry_count, MAX_16));
+        put16(out, std::min<uint64_t>(entry_count, MAX_16));
+        put32(out, std::min<uint64_t>(directory_size, MAX_32));
+        put32(out, std::min<uint64_t>(directory_offset, MAX_32));
+        put16(out, 0);
+    }
+
+    struct EntryMetadata
+    {
+        uint32_t dos_date_time;
+        uint32_t external_attributes;
+        uint64_t size;
+    };
+
+    static ExpectedT<EntryMetadata, std::string> read_metadata(const SourceEntry& entry)
+    {
+        uint32_t mode = entry.is_directory ? 0755 : 0644;
+        EntryMetadata metadata{to_dos_date_time(std::time(nullptr)), 0, entry.contents.size()};
+        if (!entry.source.empty())
+        {
+            std::error_code ec;
+            const auto status = fs::stdfs::status(entry.source, ec);
+            if (!ec) metadata.size = entry.is_directory ? 0 : fs::stdfs::file_size(entry.source, ec);
+            if (ec) return Strings::format("Failed to read %s: %s", entry.source.u8string(), ec.message());
+            mode = static_cast<uint32_t>(status.permissions()) & 0777;
+
+            const auto write_time = fs::stdfs::last_write_time(entry.source, ec);
+            metadata.dos_date_time =
+                ec ? 0 : to_dos_date_time(fs::stdfs::file_time_type::clock::to_time_t(write_time));
+        }
+        if (entry.is_directory) metadata.size = 0;
+
+#if defined(_WIN32)
+        Util::unused(mode);
+        metadata.external_attributes = entry.is_directory ? DOS_DIRECTORY_ATTRIBUTE : 0;
+#else
+        metadata.external_attributes = ((entry.is_directory ? 0040000 : 0100000) | mode) << 16;
+        if (entry.is_directory) metadata.external_attributes |= DOS_DIRECTORY_ATTRIBUTE;
+#endif
+        return metadata;
+    }
+
+    using ConsumeFn = std::function<void(const char* data, size_t size)>;
+
+    /// <summary>Passes the data of a file entry to `consume` in chunks and returns its size.</summary>
+    static ExpectedT<uint64_t, std::string> read_data(const SourceEntry& entry,
+                                                      std::vector<char>& chunk,
+                                                      const ConsumeFn& consume)
+    {
+        if (entry.source.empty())
+        {
+            consume(entry.contents.data(), entry.contents.size());
+            return uint64_t(entry.contents.size());
+        }
+
+        std::ifstream in(entry.source.native().c_str(), std::ios::binary);
+        if (!in) return Strings::format("Failed to open %s", entry.source.u8string());
+
+        uint64_t read_size = 0;
+        while (in)
+        {
+            in.read(chunk.data(), chunk.size());
+            const size_t count = static_cast<size_t>(in.gcount());
+            consume(chunk.data(), count);
+            read_size += count;
+        }
+        return read_size;
+    }
+
+    /// <summary>A file entry deflated into memory ahead of the writer.</summary>
+    struct Deflated
+    {
+        bool ready = false;
+        std::string data;
+        uint32_t crc = 0;
+        uint64_t size = 0;
+        std::string error;
+    };
+
+    static void deflate_to_memory(const SourceEntry& entry, std::vector<char>& chunk, Deflated& out)
+    {
+        Deflate::Compressor compressor([&](const char* data, size_t size) { out.data.append(data, size); });
+        const auto maybe_size = read_data(entry, chunk, [&](const char* data, size_t size) {
+            out.crc = update_crc32(out.crc, data, size);
+            compressor.write(data, size);
+        });
+        compressor.finish();
+        if (const auto size = maybe_size.get())
+            out.size = *size;
+        else
+            out.error = maybe_size.error();
+    }
+
+    /// <summary>
+    /// The local header of `entry`. Its sizes are the zip64 extra field instead when `zip64` is set.
+    /// </summary>
+    static std::string make_local_header(const CentralEntry& entry, const bool zip64)
+    {
+        std::string header;
+        put32(header, LOCAL_HEADER_SIGNATURE);
+        put16(header, VERSION);
+        put16(header, FLAG_UTF8);
+        put16(header, entry.method);
+        put32(header, entry.dos_date_time);
+        put32(header, entry.crc);
+        put32(header, zip64 ? MAX_32 : entry.compressed_size);
+        put32(header, zip64 ? MAX_32 : entry.uncompressed_size);
+        put16(header, entry.name.size());
+        put16(header, zip64 ? 20 : 0);
+        header += entry.name;
+        if (zip64)
+        {
+            put16(header, ZIP64_EXTRA_ID);
+            put16(header, 16);
+            put64(header, entry.uncompressed_size);
+            put64(header, entry.compressed_size);
+        }
+        return header;
+    }
+
+    /// <summary>One archive being written by compress_entries, and the entries written to it so far.</summary>
+    struct ArchiveWriter
+    {
+        const ArchiveLayout* layout;
+        std::ofstream out;
+        std::vector<CentralEntry> entries;
+        uint64_t offset = 0;
+
+        void write(const char* data, size_t size)
+        {
+            out.write(data, size);
+            offset += size;
+        }
+
+        void write(const std::string& data) { write(data.data(), data.size()); }
+    };
+
+    ExpectedT<size_t, std::string> compress_entries(const std::vector<SourceEntry>& sources,
+                                                    const std::vector<ArchiveLayout>& archives)
+    {
+        // The archives each entry is written to
+        std::vector<std::vector<size_t>> targets(sources.size());
+        for (size_t a = 0; a < archives.size(); ++a)
+        {
+            for (size_t i = 0; i < sources.size() && i < archives[a].names.size(); ++i)
+            {
+                if (!archives[a].names[i].empty()) targets[i].push_back(a);
+            }
+        }
+
+        std::vector<EntryMetadata> metadata(sources.size());
+        for (size_t i = 0; i < sources.size(); ++i)
+        {
+            if (targets[i].empty()) continue;
+            auto maybe_metadata = read_metadata(sources[i]);
+            if (const auto p_metadata = maybe_metadata.get())
+                metadata[i] = *p_metadata;
+            else
+                return maybe_metadata.error();
+        }
+
+        std::vector<ArchiveWriter> writers(archives.size());
+        for (size_t a = 0; a < archives.size(); ++a)
+        {
+            writers[a].layout = &archives[a];
+            writers[a].out.open(archives[a].path.native().c_str(), std::ios::binary | std::ios::trunc);
+            if (!writers[a].out) return Strings::format("Failed to create %s", archives[a].path.u8string());
+        }
+
+        // Files up to PARALLEL_SIZE_LIMIT are deflated into memory by worker threads, at most `window` entries ahead of
+        // the writer, which keeps the memory held bounded. Larger files are deflated by the writer straight into the
+        // archives. Either way each file is read and deflated once, however many archives it goes to.
+        std::vector<size_t> parallel_jobs;
+        for (size_t i = 0; i < sources.size(); ++i)
+        {
+            if (!targets[i].empty() && !sources[i].is_directory && metadata[i].size <= PARALLEL_SIZE_LIMIT)
+                parallel_jobs.push_back(i);
+        }
+        const size_t thread_count =
+            std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), parallel_jobs.size());
+        const size_t window = 4 * thread_count;
+
+        std::vector<Deflated> deflated(sources.size());
+        std::mutex mutex;
+        std::condition_variable changed;
+        size_t next_job = 0;
+        size_t write_index = 0;
+        bool cancelled = false;
+
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < thread_count; ++t)
+        {
+            workers.emplace_back([&]() {
+                std::vector<char> chunk(IO_CHUNK_SIZE);
+                for (;;)
+                {
+                    size_t job;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        changed.wait(lock, [&]() {
+                            return cancelled || next_job == parallel_jobs.size() ||
+                                   parallel_jobs[next_job] < write_index + window;
+                        });
+                        if (cancelled || next_job == parallel_jobs.size()) return;
+                        job = parallel_jobs[next_job++];
+                    }
+
+                    Deflated result;
+                    deflate_to_memory(sources[job], chunk, result);
+                    result.ready = true;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        deflated[job] = std::move(result);
+                    }
+                    changed.notify_all();
+                }
+            });
+        }
+
+        size_t written_count = 0;
+        const auto write_entries = [&]() -> Optional<std::string> {
+            std::vector<char> chunk(IO_CHUNK_SIZE);
+            for (size_t i = 0; i < sources.size(); ++i)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    write_index = i;
+                }
+                changed.notify_all();
+                if (targets[i].empty()) continue;
+                ++written_count;
+
+                const SourceEntry& source = sources[i];
+                CentralEntry entry;
+                entry.method = source.is_directory ? METHOD_STORED : METHOD_DEFLATE;
+                entry.dos_date_time = metadata[i].dos_date_time;
+                entry.crc = 0;
+                entry.compressed_size = 0;
+                entry.uncompressed_size = metadata[i].size;
+                entry.external_attributes = metadata[i].external_attributes;
+
+                // The entry as it is in each of its archives, which differ only in name and offset
+                const auto entries_of = [&](const bool zip64_local) {
+                    std::vector<CentralEntry> copies;
+                    for (const size_t a : targets[i])
+                    {
+                        copies.push_back(entry);
+                        copies.back().name = archives[a].names[i];
+                        copies.back().offset = writers[a].offset;
+                        writers[a].write(make_local_header(copies.back(), zip64_local));
+                    }
+                    return copies;
+                };
+
+                std::vector<CentralEntry> copies;
+                if (source.is_directory)
+                {
+                    copies = entries_of(false);
+                }
+                else if (metadata[i].size <= PARALLEL_SIZE_LIMIT)
+                {
+                    Deflated result;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        changed.wait(lock, [&]() { return deflated[i].ready; });
+                        result = std::move(deflated[i]);
+                    }
+                    if (!result.error.empty()) return result.error;
+                    if (result.size != entry.uncompressed_size)
+                        return Strings::format("%s changed while it was being archived", source.source.u8string());
+
+                    entry.crc = result.crc;
+                    entry.compressed_size = result.data.size();
+                    copies = entries_of(entry.compressed_size >= MAX_32);
+                    for (const size_t a : targets[i])
+                        writers[a].write(result.data);
+                }
+                else
+                {
+                    const bool zip64_local = entry.uncompressed_size >= ZIP64_LOCAL_THRESHOLD;
+                    copies = entries_of(zip64_local);
+
+                    Deflate::Compressor compressor([&](const char* data, size_t size) {
+                        for (const size_t a : targets[i])
+                            writers[a].write(data, size);
+                        entry.compressed_size += size;
+                    });
+                    const auto maybe_size = read_data(source, chunk, [&](const char* data, size_t size) {
+                        entry.crc = update_crc32(entry.crc, data, size);
+                        compressor.write(data, size);
+                    });
+                    compressor.finish();
+                    if (!maybe_size.has_value()) return maybe_size.error();
+                    if (*maybe_size.get() != entry.uncompressed_size)
+                        return Strings::format("%s changed while it was being archived", source.source.u8string());
+
+                    // Sizes are only known now: patch them into the local headers
+                    for (size_t t = 0; t < copies.size(); ++t)
+                    {
+                        CentralEntry& copy = copies[t];
+                        copy.crc = entry.crc;
+                        copy.compressed_size = entry.compressed_size;
+                        std::ofstream& out = writers[targets[i][t]].out;
+
+                        std::string sizes;
+                        put32(sizes, copy.crc);
+                        if (zip64_local)
+                        {
+                            out.seekp(static_cast<std::streamoff>(copy.offset + 14));
+                            out.write(sizes.data(), sizes.size());
+                            sizes.clear();
+                            put64(sizes, copy.uncompressed_size);
+                            put64(sizes, copy.compressed_size);
+                            out.seekp(
+                                static_cast<std::streamoff>(copy.offset + LOCAL_HEADER_SIZE + copy.name.size() + 4));
+                        }
+                        else
+                        {
+                            put32(sizes, copy.compressed_size);
+                            put32(sizes, copy.uncompressed_size);
+                            out.seekp(static_cast<std::streamoff>(copy.offset + 14));
+                        }
+                        out.write(sizes.data(), sizes.size());
+                        out.seekp(static_cast<std::streamoff>(writers[targets[i][t]].offset));
+                    }
+                }
+
+                for (size_t t = 0; t < copies.size(); ++t)
+                    writers[targets[i][t]].entries.push_back(std::move(copies[t]));
+            }
+            return nullopt;
+        };
+        const auto maybe_error = write_entries();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            cancelled = true;
+        }
+        changed.notify_all();
+        for (auto&& worker : workers)
+            worker.join();
+        if (const auto error = maybe_error.get()) return *error;
+
+        for (auto&& writer : writers)
+        {
+            std::string directory;
+            for (auto&& entry : writer.entries)
+                write_central_entry(directory, entry);
+            write_end_of_central_directory(directory, writer.entries.size(), directory.size(), writer.offset);
+            writer.out.write(directory.data(), directory.size());
+
+            writer.out.close();
+            if (!writer.out) return Strings::format("Failed to write %s", writer.layout->path.u8string());
+        }
+        return written_count;
+    }
+
+    ExpectedT<size_t, std::string> compress_entries(const std::vector<SourceEntry>& entries,
+                                                    const fs::path& archive_path)
+    {
+        const ArchiveLayout layout{
+            archive_path, Util::fmap(entries, [](const SourceEntry& entry) { return entry.name; })};
+        return compress_entries(entries, {layout});
+    }
+
+    ExpectedT<size_t, std::string> compress_directory(const fs::path& source_dir,
+                                                      const fs::path& archive_path,
+                                                      const std::string& prefix)
+    {
+        std::error_code ec;
+        std::vector<fs::path> paths;
+        for (fs::stdfs::recursive_directory_iterator it(source_dir, ec), end; !ec && it != end; it.increment(ec))
+        {
+            paths.push_back(it->path());
+        }
+        if (ec) return Strings::format("Failed to enumerate %s: %s", source_dir.u8string(), ec.message());
+        Util::sort(paths);
+
+        const std::string root = source_dir.generic_u8string();
+        std::vector<SourceEntry> sources;
+        for (auto&& path : paths)
+        {
+            // Symlinks are followed, like `zip -r` does
+            const auto status = fs::stdfs::status(path, ec);
+            const bool is_directory = !ec && fs::is_directory(status);
+            if (ec || (!is_directory && !fs::is_regular_file(status))) continue;
+
+            std::string relative = path.generic_u8string().substr(root.size());
+            while (!relative.empty() && relative.front() == '/')
+                relative.erase(0, 1);
+
+            sources.push_back({prefix + relative + (is_directory ? "/" : ""), is_directory, path, {}});
+        }
+
+        return compress_entries(sources, archive_path);
+    }
+
+    struct ArchiveEntry
+    {
+        std::string name;
+        uint16_t version_made_by;
+        uint16_t flags;
+        uint16_t method;
+        uint32_t crc;
+        uint64_t compressed_size;
+        uint64_t uncompressed_size;
+        uint64_t offset;
+        uint32_t external_attributes;
+    };
+
+    static bool read_at(std::ifstream& in, uint64_t offset, char* buffer, size_t size)
+    {
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(offset));
+        in.read(buffer, size);
+        return static_cast<size_t>(in.gcount()) == size;
+    }
+
+    static ExpectedT<std::vector<ArchiveEntry>, std::string> read_central_directory(std::ifstream& in,
+                                                                                    const std::string& archive)
+    {
+        in.seekg(0, std::ios::end);
+        const uint64_t file_size = static_cast<uint64_t>(in.tellg());
+
+        // The end of central directory record is followed by a comment of at most 64 KiB
+        const size_t tail_size =
+            static_cast<size_t>(std::min<uint64_t>(file_size, END_OF_CENTRAL_DIRECTORY_SIZE + MAX_16));
+        std::string tail(tail_size, '\0');
+        if (!read_at(in, file_size - tail_size, &tail[0], tail_size))
+            return Strings::format("Failed to read %s", archive);
+
+        size_t eocd = std::string::npos;
+        for (size_t i = tail_size >= END_OF_CENTRAL_DIRECTORY_SIZE ? tail_size - END_OF_CENTRAL_DIRECTORY_SIZE + 1 : 0;
+             i-- > 0;)
+        {
+            if (get32(&tail[i]) == END_OF_CENTRAL_DIRECTORY_SIGNATURE)
+            {
+                eocd = i;
+                break;
+            }
+        }
+        if (eocd == std::string::npos) return Strings::format("%s is not a zip archive", archive);
+
+        uint64_t entry_count = get16(&tail[eocd + 10]);
+        uint64_t directory_size = get32(&tail[eocd + 12]);
+        uint64_t directory_offset = get32(&tail[eocd + 16]);
+
+        const uint64_t eocd_offset = file_size - tail_size + eocd;
+        if ((entry_count == MAX_16 || directory_size == MAX_32 || directory_offset == MAX_32) &&
+            eocd_offset >= ZIP64_LOCATOR_SIZE)
+        {
+            char locator[ZIP64_LOCATOR_SIZE];
+            char record[ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE];
+            if (read_at(in, eocd_offset - ZIP64_LOCATOR_SIZE, locator, sizeof(locator)) &&
+                get32(locator) == ZIP64_LOCATOR_SIGNATURE &&
+                read_at(in, get64(locator + 8), record, sizeof(record)) &&
+                get32(record) == ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE)
+            {
+                entry_count = get64(record + 32);
+                directory_size = get64(record + 40);
+                directory_offset = get64(record + 48);
+            }
+        }
+
+        if (directory_offset + directory_size > file_size) return Strings::format("%s is truncated", archive);
+        std::string directory(static_cast<size_t>(directory_size), '\0');
+        if (directory_size != 0 && !read_at(in, directory_offset, &directory[0], directory.size()))
+            return Strings::format("Failed to read %s", archive);
+
+        std::vector<ArchiveEntry> entries;
+        size_t position = 0;
+        for (uint64_t i = 0; i < entry_count; ++i)
+        {
+            if (position + CENTRAL_HEADER_SIZE > directory.size() ||
+                get32(&directory[position]) != CENTRAL_HEADER_SIGNATURE)
+                return Strings::format("%s has a corrupt central directory", archive);
+
+            const char* header = &directory[position];
+            ArchiveEntry entry;
+            entry.version_made_by = get16(header + 4);
+            entry.flags = get16(header + 8);
+            entry.method = get16(header + 10);
+            entry.crc = get32(header + 16);
+            entry.compressed_size = get32(header + 20);
+            entry.uncompressed_size = get32(header + 24);
+            const size_t name_size = get16(header + 28);
+            const size_t extra_size = get16(header + 30);
+            const size_t comment_size = get16(header + 32);
+            entry.external_attributes = get32(header + 38);
+            entry.offset = get32(header + 42);
+
+            if (position + CENTRAL_HEADER_SIZE + name_size + extra_size + comment_size > directory.size())
+                return Strings::format("%s has a corrupt central directory", archive);
+            entry.name = directory.substr(position + CENTRAL_HEADER_SIZE, name_size);
+
+            // The zip64 extra field holds exactly the values whose 32 bit fields are saturated, in this order
+            const char* extra = header + CENTRAL_HEADER_SIZE + name_size;
+            for (size_t field = 0; field + 4 <= extra_size;)
+            {
+                const uint16_t id = get16(extra + field);
+                const size_t size = get16(extra + field + 2);
+                if (field + 4 + size > extra_size) break;
+                if (id == ZIP64_EXTRA_ID)
+                {
+                    const char* value = extra + field + 4;
+                    const char* value_end = value + size;
+                    for (uint64_t* target : {&entry.uncompressed_size, &entry.compressed_size, &entry.offset})
+                    {
+                        if (*target != MAX_32 || value + 8 > value_end) continue;
+                        *target = get64(value);
+                        value += 8;
+                    }
+                }
+                field += 4 + size;
+            }
+
+            entries.push_back(std::move(entry));
+            position += CENTRAL_HEADER_SIZE + name_size + extra_size + comment_size;
+        }
+
+        return entries;
+    }
+
+    /// <summary>
+    /// Rejects names that would be written outside of the destination directory.
+    /// </summary>
+    static bool is_safe_entry_name(const std::string& name)
+    {
+        if (name.empty() || name.front() == '/' || name.find(':') != std::string::npos) return false;
+        for (auto&& component : Strings::split(name, "/"))
+        {
+            if (component == "..") return false;
+        }
+        return true;
+    }
+
+    static ExpectedT<size_t, std::string> extract_entry(std::ifstream& in,
+                                                        const ArchiveEntry& entry,
+                                                        const fs::path& target,
+                                                        const std::string& archive)
+    {
+        char header[LOCAL_HEADER_SIZE];
+        if (!read_at(in, entry.offset, header, sizeof(header)) || get32(header) != LOCAL_HEADER_SIGNATURE)
+            return Strings::format("%s has a corrupt entry %s", archive, entry.name);
+        const uint64_t data_offset = entry.offset + LOCAL_HEADER_SIZE + get16(header + 26) + get16(header + 28);
+
+        std::ofstream out(target.native().c_str(), std::ios::binary | std::ios::trunc);
+        if (!out) return Strings::format("Failed to create %s", target.u8string());
+
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(data_offset));
+        uint64_t remaining = entry.compressed_size;
+        auto read = [&](char* buffer, size_t capacity) -> size_t {
+            const size_t count = static_cast<size_t>(std::min<uint64_t>(capacity, remaining));
+            in.read(buffer, count);
+            const size_t actual = static_cast<size_t>(in.gcount());
+            remaining -= actual;
+            return actual;
+        };
+
+        uint32_t crc = 0;
+        uint64_t written = 0;
+        auto write = [&](const char* data, size_t size) {
+            crc = update_crc32(crc, data, size);
+            out.write(data, size);
+            written += size;
+        };
+
+        if (entry.method == METHOD_DEFLATE)
+        {
+            if (!Deflate::decompress(read, write))
+                return Strings::format("%s has corrupt compressed data for %s", archive, entry.name);
+        }
+        else
+        {
+            std::vector<char> chunk(IO_CHUNK_SIZE);
+            for (size_t count; (count = read(chunk.data(), chunk.size())) > 0;)
+                write(chunk.data(), count);
+        }
+
+        out.close();
+        if (!out) return Strings::format("Failed to write %s", target.u8string());
+        if (written != entry.uncompressed_size || crc != entry.crc)
+            return Strings::format("%s failed the integrity check for %s", archive, entry.name);
+
+#if !defined(_WIN32)
+        const uint32_t mode = (entry.external_attributes >> 16) & 0777;
+        if ((entry.version_made_by >> 8) == HOST_UNIX && mode != 0)
+        {
+            std::error_code ec;
+            fs::stdfs::permissions(target, static_cast<fs::stdfs::perms>(mode), ec);
+        }
+#endif
+        return 1;
+    }
+
+    /// <summary>Whether `file` has exactly the contents that `entry` describes, judged by size and CRC-32.</summary>
+    static bool file_matches_entry(const fs::path& file, const ArchiveEntry& entry)
+    {
+        std::error_code ec;
+        if (!fs::stdfs::is_regular_file(file, ec) || fs::stdfs::file_size(file, ec) != entry.uncompressed_size || ec)
+            return false;
+
+        std::ifstream in(file.native().c_str(), std::ios::binary);
+        if (!in) return false;
+        uint32_t crc = 0;
+        std::vector<char> chunk(IO_CHUNK_SIZE);
+        while (in)
+        {
+            in.read(chunk.data(), chunk.size());
+            crc = update_crc32(crc, chunk.data(), static_cast<size_t>(in.gcount()));
+        }
+        return in.eof() && crc == entry.crc;
+    }
+
+    ExpectedT<size_t, std::string> extract(const fs::path& archive_path,
+                                           const fs::path& destination,
+                                           const std::vector<fs::path>& reuse_dirs)
+    {
+        const std::string archive = archive_path.u8string();
+        std::ifstream in(archive_path.native().c_str(), std::ios::binary);
+        if (!in) return Strings::format("Failed to open %s", archive);
+
+        auto maybe_entries = read_central_directory(in, archive);
+        auto entries = maybe_entries.get();
+        if (!entries) return std::move(maybe_entries).error();
+
+        std::error_code ec;
+        fs::stdfs::create_directories(destination, ec);
+
+        for (auto&& entry : *entries)
+        {
+            if ((entry.flags & FLAG_ENCRYPTED) != 0)
+                return Strings::format("%s has an encrypted entry %s", archive, entry.name);
+            if (entry.method != METHOD_STORED && entry.method != METHOD_DEFLATE)
+                return Strings::format(
+                    "%s uses unsupported compression method %d for %s", archive, entry.method, entry.name);
+
+            std::string name = entry.name;
+            std::replace(name.begin(), name.end(), '\\', '/');
+            if (!is_safe_entry_name(name)) return Strings::format("%s has an unsafe entry %s", archive, entry.name);
+
+            const bool is_directory = name.back() == '/';
+            const fs::path target = destination / fs::u8path(name);
+            fs::stdfs::create_directories(is_directory ? target : target.parent_path(), ec);
+            if (is_directory) continue;
+
+            const bool reused = std::any_of(reuse_dirs.begin(), reuse_dirs.end(), [&](const fs::path& reuse_dir) {
+                const fs::path previous = reuse_dir / fs::u8path(name);
+                if (!file_matches_entry(previous, entry)) return false;
+                fs::stdfs::remove(target, ec);
+                fs::stdfs::create_hard_link(previous, target, ec);
+                return !ec;
+            });
+            if (reused) continue;
+
+            auto maybe_extracted = extract_entry(in, entry, target, archive);
+            if (!maybe_extracted.has_value()) return std::move(maybe_extracted).error();
+        }
+
+        return entries->size();
+    }
+}
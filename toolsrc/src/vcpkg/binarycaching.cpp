@@ -0,0 +1,1269 @@
+#include "pch.h"
+
+#include <vcpkg/base/downloads.h>
+#include <vcpkg/base/hash.h>
+#include <vcpkg/base/openmetrics.h>
+#include <vcpkg/base/s3.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/base/threadpool.h>
+#include <vcpkg/base/util.h>
+#include <vcpkg/binarycaching.h>
+
+namespace vcpkg
+{
+    const std::string& archive_extension(const ArchiveFormat format)
+    {
+        static const std::string ZIP_EXTENSION = ".zip";
+        static const std::string TAR_ZSTD_EXTENSION = ".tar.zst";
+        static const std::string MANIFEST_EXTENSION = ".manifest";
+
+        switch (format)
+        {
+            case ArchiveFormat::ZIP: return ZIP_EXTENSION;
+            case ArchiveFormat::TAR_ZSTD: return TAR_ZSTD_EXTENSION;
+            case ArchiveFormat::MANIFEST: return MANIFEST_EXTENSION;
+            default: Checks::unreachable(VCPKG_LINE_INFO);
+        }
+    }
+
+    ExpectedT<ArchiveEncoding, std::string> ArchiveEncoding::parse(const std::string& text)
+    {
+        const auto colon = text.find(':');
+        const std::string name = Strings::ascii_to_lowercase(text.substr(0, colon));
+
+        ArchiveEncoding encoding;
+        if (name == "zip" || name == "cas")
+        {
+            if (colon != std::string::npos)
+                return Strings::format("the %s archive format does not take a level", name);
+            if (name == "cas") encoding.format = ArchiveFormat::MANIFEST;
+            return encoding;
+        }
+        if (name != "zstd") return Strings::format("unknown archive format '%s', expected zip, zstd or cas", text);
+
+        encoding.format = ArchiveFormat::TAR_ZSTD;
+        if (colon == std::string::npos) return encoding;
+
+        const std::string level = text.substr(colon + 1);
+        const bool is_number = !level.empty() && level.size() <= 2 &&
+                               std::all_of(level.begin(), level.end(), [](char ch) { return ch >= '0' && ch <= '9'; });
+        encoding.level = is_number ? std::stoi(level) : 0;
+        if (encoding.level < 1 || encoding.level > 22)
+            return Strings::format("invalid zstd level '%s', expected 1 through 22", level);
+        return encoding;
+    }
+
+    std::string ArchiveEncoding::to_string() const
+    {
+        if (format == ArchiveFormat::ZIP) return "zip";
+        if (format == ArchiveFormat::MANIFEST) return "cas";
+        return level == 0 ? "zstd" : Strings::format("zstd:%d", level);
+    }
+
+    bool operator==(const ArchiveEncoding& lhs, const ArchiveEncoding& rhs)
+    {
+        return lhs.format == rhs.format && lhs.level == rhs.level;
+    }
+
+    bool operator!=(const ArchiveEncoding& lhs, const ArchiveEncoding& rhs) { return !(lhs == rhs); }
+
+    static std::string archive_subpath(const std::string& abi_tag, const ArchiveFormat format)
+    {
+        return Strings::format("%s/%s%s", abi_tag.substr(0, 2), abi_tag, archive_extension(format));
+    }
+
+    static std::string tombstone_subpath(const std::string& abi_tag)
+    {
+        return "fail/" + archive_subpath(abi_tag, ArchiveFormat::ZIP);
+    }
+
+    static const std::string METADATA_EXTENSION = ".meta";
+
+    static std::string metadata_subpath(const std::string& abi_tag)
+    {
+        return Strings::format("%s/%s%s", abi_tag.substr(0, 2), abi_tag, METADATA_EXTENSION);
+    }
+
+    static const std::string LEASE_EXTENSION = ".lease";
+
+    static std::string lease_subpath(const std::string& abi_tag)
+    {
+        return Strings::format("%s/%s%s", abi_tag.substr(0, 2), abi_tag, LEASE_EXTENSION);
+    }
+
+    std::string ArchiveMetadata::to_string() const
+    {
+        return Strings::format("Package: %s\nVersion: %s\nTriplet: %s\nFeatures: %s\nSize: %s\nCreated: %s\n",
+                               name,
+                               version,
+                               triplet,
+                               Strings::join(",", features),
+                               std::to_string(size),
+                               std::to_string(created));
+    }
+
+    ExpectedT<ArchiveMetadata, std::string> ArchiveMetadata::parse(const std::string& abi_tag, const std::string& text)
+    {
+        ArchiveMetadata metadata;
+        metadata.abi_tag = abi_tag;
+        std::string size;
+        for (const std::string_view line : Strings::split_view(text, "\n"))
+        {
+            const auto colon = line.find(": ");
+            if (colon == std::string_view::npos) continue;
+            const std::string_view key = line.substr(0, colon);
+            std::string value = Strings::trim(std::string(line.substr(colon + 2)));
+
+            if (key == "Package")
+                metadata.name = std::move(value);
+            else if (key == "Version")
+                metadata.version = std::move(value);
+            else if (key == "Triplet")
+                metadata.triplet = std::move(value);
+            else if (key == "Features")
+                metadata.features = Strings::split(value, ",");
+            else if (key == "Size")
+                size = std::move(value);
+            else if (key == "Created")
+                metadata.created = std::strtoll(value.c_str(), nullptr, 10);
+        }
+
+        if (metadata.name.empty() || metadata.triplet.empty() || size.empty())
+            return Strings::format("incomplete binary cache metadata for %s", abi_tag);
+        metadata.size = std::strtoull(size.c_str(), nullptr, 10);
+        return metadata;
+    }
+
+    /// <summary>
+    /// A suffix for temporary files that no other thread or process picks, since several may fetch or store the same
+    /// blob at once.
+    /// </summary>
+    static std::string unique_temp_suffix()
+    {
+        static std::atomic<uint64_t> counter{0};
+        static const uint64_t process_nonce = std::random_device{}();
+        return Strings::format(".%llx-%llx.tmp",
+                               static_cast<unsigned long long>(process_nonce),
+                               static_cast<unsigned long long>(counter++));
+    }
+
+    static std::string blob_subpath(const std::string& sha1)
+    {
+        return Strings::format("blobs/%s/%s", sha1.substr(0, 2), sha1);
+    }
+
+    /// <summary>
+    /// The provider's own format first, so a provider that has switched formats is asked for new archives before old
+    /// ones.
+    /// </summary>
+    static std::vector<ArchiveFormat> lookup_order(const ArchiveProvider& provider)
+    {
+        std::vector<ArchiveFormat> formats{provider.encoding().format};
+        for (auto&& format : ALL_ARCHIVE_FORMATS)
+        {
+            if (format != provider.encoding().format) formats.push_back(format);
+        }
+        return formats;
+    }
+
+    /// <summary>
+    /// The last access record of a local archive or blob is its write time, which is refreshed whenever it is used.
+    /// </summary>
+    static void record_access(const fs::path& path)
+    {
+        std::error_code ec;
+        fs::stdfs::last_write_time(path, fs::stdfs::file_time_type::clock::now(), ec); // Ignore error
+    }
+
+    static const std::string MANIFEST_HEADER = "vcpkg-manifest 1";
+
+    /// <summary>
+    /// One line of a manifest: `d <path>` for a directory, or `f <sha1> <size> <octal mode> <path>` for a file.
+    /// </summary>
+    struct ManifestEntry
+    {
+        std::string path;
+        bool is_directory = false;
+        std::string sha1;
+        uint64_t size = 0;
+        uint32_t mode = 0;
+    };
+
+    static ExpectedT<std::vector<ManifestEntry>, std::string> read_manifest(const Files::Filesystem& fs,
+                                                                            const fs::path& manifest_path)
+    {
+        auto maybe_lines = fs.read_lines(manifest_path);
+        auto lines = maybe_lines.get();
+        if (!lines || lines->empty() || lines->front() != MANIFEST_HEADER)
+            return Strings::format("%s is not a binary cache manifest", manifest_path.u8string());
+
+        std::vector<ManifestEntry> entries;
+        for (size_t i = 1; i < lines->size(); ++i)
+        {
+            const std::string& line = (*lines)[i];
+            if (line.empty()) continue;
+
+            ManifestEntry entry;
+            if (line.compare(0, 2, "d ") == 0)
+            {
+                entry.is_directory = true;
+                entry.path = line.substr(2);
+            }
+            else
+            {
+                char sha1[41] = {};
+                unsigned long long size;
+                unsigned int mode;
+                int path_offset = 0;
+                if (std::sscanf(line.c_str(), "f %40s %llu %o %n", sha1, &size, &mode, &path_offset) != 3 ||
+                    path_offset == 0)
+                    return Strings::format("%s has a corrupt line: %s", manifest_path.u8string(), line);
+                entry.sha1 = sha1;
+                entry.size = size;
+                entry.mode = mode;
+                entry.path = line.substr(path_offset);
+            }
+
+            const auto components = Strings::split(entry.path, "/");
+            if (entry.path.empty() || entry.path.front() == '/' || entry.path.find(':') != std::string::npos ||
+                std::find(components.begin(), components.end(), "..") != components.end())
+                return Strings::format("%s has an unsafe path: %s", manifest_path.u8string(), entry.path);
+            entries.push_back(std::move(entry));
+        }
+        return entries;
+    }
+
+    struct DirectoryArchiveProvider : ArchiveProvider
+    {
+        DirectoryArchiveProvider(Files::Filesystem& fs, const fs::path& root, const ArchiveEncoding& encoding)
+            : m_fs(fs), m_root(root), m_encoding(encoding)
+        {
+        }
+
+        fs::path archive_path(const std::string& abi_tag, const ArchiveFormat format) const
+        {
+            return m_root / fs::u8path(archive_subpath(abi_tag, format));
+        }
+        fs::path tombstone_path(const std::string& abi_tag) const { return m_root / fs::u8path(tombstone_subpath(abi_tag)); }
+
+        virtual std::string location() const override { return m_root.u8string(); }
+
+        virtual const char* kind() const override { return "files"; }
+
+        virtual const ArchiveEncoding& encoding() const override { return m_encoding; }
+
+        virtual bool has_archive(const std::string& abi_tag, const ArchiveFormat format) const override
+        {
+            return m_fs.exists(archive_path(abi_tag, format));
+        }
+
+        virtual bool fetch_archive(const std::string& abi_tag,
+                                   const ArchiveFormat format,
+                                   const fs::path& destination) const override
+        {
+            const fs::path source = archive_path(abi_tag, format);
+            if (!m_fs.exists(source)) return false;
+
+            std::error_code ec;
+            m_fs.create_directories(destination.parent_path(), ec);
+            return m_fs.copy_file(source, destination, fs::copy_options::overwrite_existing, ec) && !ec;
+        }
+
+        virtual bool store_archive(const std::string& abi_tag,
+                                   const ArchiveFormat format,
+                                   const fs::path& archive) const override
+        {
+            return store_file(archive, archive_path(abi_tag, format));
+        }
+
+        virtual bool has_blob(const std::string& sha1) const override
+        {
+            return m_fs.exists(m_root / fs::u8path(blob_subpath(sha1)));
+        }
+
+        virtual bool fetch_blob(const std::string& sha1, const fs::path& destination) const override
+        {
+            std::error_code ec;
+            m_fs.copy_file(
+                m_root / fs::u8path(blob_subpath(sha1)), destination, fs::copy_options::overwrite_existing, ec);
+            return !ec;
+        }
+
+        virtual bool store_blob(const std::string& sha1, const fs::path& file) const override
+        {
+            return store_file(file, m_root / fs::u8path(blob_subpath(sha1)));
+        }
+
+        virtual bool has_tombstone(const std::string& abi_tag) const override
+        {
+            return m_fs.exists(tombstone_path(abi_tag));
+        }
+
+        virtual bool store_tombstone(const std::string& abi_tag) const override
+        {
+            const fs::path destination = tombstone_path(abi_tag);
+            std::error_code ec;
+            m_fs.create_directories(destination.parent_path(), ec);
+            m_fs.write_contents(destination, "", ec);
+            return !ec;
+        }
+
+        virtual void purge_tombstone(const std::string& abi_tag) const override
+        {
+            std::error_code ec;
+            m_fs.remove(tombstone_path(abi_tag), ec); // Ignore error
+        }
+
+    private:
+        bool store_file(const fs::path& source, const fs::path& destination) const
+        {
+            // Copy under a temporary name first so that concurrent readers never see a partial file
+            const fs::path tmp_destination = destination.u8string() + unique_temp_suffix();
+            std::error_code ec;
+            m_fs.create_directories(destination.parent_path(), ec);
+            m_fs.copy_file(source, tmp_destination, fs::copy_options::overwrite_existing, ec);
+            if (!ec) m_fs.rename(tmp_destination, destination, ec);
+            if (ec)
+            {
+                System::println(
+                    System::Color::warning, "Failed to store binary cache %s: %s", destination.u8string(), ec.message());
+                return false;
+            }
+            return true;
+        }
+
+        Files::Filesystem& m_fs;
+        fs::path m_root;
+        ArchiveEncoding m_encoding;
+    };
+
+    struct HttpArchiveProvider : ArchiveProvider
+    {
+        HttpArchiveProvider(Files::Filesystem& fs, const std::string& url_prefix, const ArchiveEncoding& encoding)
+            : m_fs(fs), m_url_prefix(url_prefix), m_encoding(encoding)
+        {
+            if (!Strings::ends_with(m_url_prefix, "/")) m_url_prefix.push_back('/');
+        }
+
+        std::string archive_url(const std::string& abi_tag, const ArchiveFormat format) const
+        {
+            return m_url_prefix + archive_subpath(abi_tag, format);
+        }
+        std::string tombstone_url(const std::string& abi_tag) const { return m_url_prefix + tombstone_subpath(abi_tag); }
+
+        virtual std::string location() const override { return m_url_prefix; }
+
+        virtual const char* kind() const override { return "http"; }
+
+        virtual const ArchiveEncoding& encoding() const override { return m_encoding; }
+
+        virtual bool has_archive(const std::string& abi_tag, const ArchiveFormat format) const override
+        {
+            return Downloads::url_exists(archive_url(abi_tag, format));
+        }
+
+        virtual bool fetch_archive(const std::string& abi_tag,
+                                   const ArchiveFormat format,
+                                   const fs::path& destination) const override
+        {
+            return Downloads::try_download_file(m_fs, archive_url(abi_tag, format), destination);
+        }
+
+        virtual bool store_archive(const std::string& abi_tag,
+                                   const ArchiveFormat format,
+                                   const fs::path& archive) const override
+        {
+            const auto url = archive_url(abi_tag, format);
+            if (!Downloads::upload_file(url, archive))
+            {
+                System::println(System::Color::warning, "Failed to upload binary cache %s", url);
+                return false;
+            }
+            return true;
+        }
+
+        virtual bool has_blob(const std::string& sha1) const override
+        {
+            return Downloads::url_exists(m_url_prefix + blob_subpath(sha1));
+        }
+
+        virtual bool fetch_blob(const std::string& sha1, const fs::path& destination) const override
+        {
+            return Downloads::try_download_file(m_fs, m_url_prefix + blob_subpath(sha1), destination);
+        }
+
+        virtual bool store_blob(const std::string& sha1, const fs::path& file) const override
+        {
+            return Downloads::upload_file(m_url_prefix + blob_subpath(sha1), file);
+        }
+
+        virtual bool has_tombstone(const std::string& abi_tag) const override
+        {
+            return Downloads::url_exists(tombstone_url(abi_tag));
+        }
+
+        virtual bool store_tombstone(const std::string& abi_tag) const override
+        {
+            // PUT needs a body; an empty file is the tombstone
+            const fs::path empty_file = fs::stdfs::temp_directory_path() / ("vcpkg-tombstone-" + abi_tag);
+            std::error_code ec;
+            m_fs.write_contents(empty_file, "", ec);
+            if (ec) return false;
+            const bool stored = Downloads::upload_file(tombstone_url(abi_tag), empty_file);
+            m_fs.remove(empty_file, ec);
+            return stored;
+        }
+
+        virtual void purge_tombstone(const std::string&) const override
+        {
+            // Remote tombstones are only ever removed by the server's own retention policy
+        }
+
+    private:
+        Files::Filesystem& m_fs;
+        std::string m_url_prefix;
+        ArchiveEncoding m_encoding;
+    };
+
+    struct S3ArchiveProvider : ArchiveProvider
+    {
+        S3ArchiveProvider(Files::Filesystem& fs, const std::string& url, const ArchiveEncoding& encoding)
+            : m_fs(fs), m_bucket(S3::Bucket::from_environment(bucket_of(url))), m_encoding(encoding)
+        {
+            const auto slash = url.find('/', 5);
+            if (slash != std::string::npos) m_prefix = url.substr(slash + 1);
+            if (!m_prefix.empty() && !Strings::ends_with(m_prefix, "/")) m_prefix.push_back('/');
+        }
+
+        /// <summary>The bucket of `s3://<bucket>/<prefix>`</summary>
+        static std::string bucket_of(const std::string& url) { return url.substr(5, url.find('/', 5) - 5); }
+
+        virtual std::string location() const override { return m_bucket.location(m_prefix); }
+
+        virtual const char* kind() const override { return "s3"; }
+
+        virtual const ArchiveEncoding& encoding() const override { return m_encoding; }
+
+        virtual bool has_archive(const std::string& abi_tag, const ArchiveFormat format) const override
+        {
+            return m_bucket.exists(m_prefix + archive_subpath(abi_tag, format));
+        }
+
+        virtual bool fetch_archive(const std::string& abi_tag,
+                                   const ArchiveFormat format,
+                                   const fs::path& destination) const override
+        {
+            return m_bucket.download(m_prefix + archive_subpath(abi_tag, format), destination);
+        }
+
+        virtual bool store_archive(const std::string& abi_tag,
+                                   const ArchiveFormat format,
+                                   const fs::path& archive) const override
+        {
+            const std::string key = m_prefix + archive_subpath(abi_tag, format);
+            if (!m_bucket.upload(key, archive))
+            {
+                System::println(System::Color::warning, "Failed to upload binary cache %s", m_bucket.location(key));
+                return false;
+            }
+            return true;
+        }
+
+        virtual bool has_blob(const std::string& sha1) const override
+        {
+            return m_bucket.exists(m_prefix + blob_subpath(sha1));
+        }
+
+        virtual bool fetch_blob(const std::string& sha1, const fs::path& destination) const override
+        {
+            return m_bucket.download(m_prefix + blob_subpath(sha1), destination);
+        }
+
+        virtual bool store_blob(const std::string& sha1, const fs::path& file) const override
+        {
+            return m_bucket.upload(m_prefix + blob_subpath(sha1), file);
+        }
+
+        virtual bool has_tombstone(const std::string& abi_tag) const override
+        {
+            return m_bucket.exists(m_prefix + tombstone_subpath(abi_tag));
+        }
+
+        virtual bool store_tombstone(const std::string& abi_tag) const override
+        {
+            const fs::path empty_file = fs::stdfs::temp_directory_path() / ("vcpkg-tombstone-" + abi_tag);
+            std::error_code ec;
+            m_fs.write_contents(empty_file, "", ec);
+            if (ec) return false;
+            const bool stored = m_bucket.upload(m_prefix + tombstone_subpath(abi_tag), empty_file);
+            m_fs.remove(empty_file, ec);
+            return stored;
+        }
+
+        virtual void purge_tombstone(const std::string&) const override
+        {
+            // Like remote HTTP tombstones, these are left to the bucket's lifecycle rules
+        }
+
+    private:
+        Files::Filesystem& m_fs;
+        S3::Bucket m_bucket;
+        /// <summary>Empty, or ending in a slash</summary>
+        std::string m_prefix;
+        ArchiveEncoding m_encoding;
+    };
+
+    std::unique_ptr<ArchiveProvider> make_directory_archive_provider(Files::Filesystem& fs,
+                                                                     const fs::path& root,
+                                                                     const ArchiveEncoding& encoding)
+    {
+        return std::make_unique<DirectoryArchiveProvider>(fs, root, encoding);
+    }
+
+    std::unique_ptr<ArchiveProvider> make_http_archive_provider(Files::Filesystem& fs,
+                                                                const std::string& url_prefix,
+                                                                const ArchiveEncoding& encoding)
+    {
+        return std::make_unique<HttpArchiveProvider>(fs, url_prefix, encoding);
+    }
+
+    std::unique_ptr<ArchiveProvider> make_s3_archive_provider(Files::Filesystem& fs,
+                                                              const std::string& url,
+                                                              const ArchiveEncoding& encoding)
+    {
+        return std::make_unique<S3ArchiveProvider>(fs, url, encoding);
+    }
+
+    BinaryCache::BinaryCache(Files::Filesystem& fs,
+                             const fs::path& local_root,
+                             const ArchiveEncoding& local_encoding,
+                             std::vector<std::unique_ptr<ArchiveProvider>>&& remotes)
+        : m_fs(&fs)
+        , m_local_root(local_root)
+        , m_local_encoding(local_encoding)
+        , m_local(make_directory_archive_provider(fs, local_root, local_encoding))
+        , m_remotes(std::move(remotes))
+    {
+    }
+
+    static ArchiveEncoding parse_encoding_or_exit(const std::string& text, const std::string& origin)
+    {
+        auto maybe_encoding = ArchiveEncoding::parse(text);
+        if (auto encoding = maybe_encoding.get()) return *encoding;
+        Checks::exit_with_message(VCPKG_LINE_INFO, "Error: invalid %s: %s", origin, maybe_encoding.error());
+    }
+
+    BinaryCache BinaryCache::from_environment(Files::Filesystem& fs, const fs::path& local_root)
+    {
+        ArchiveEncoding default_encoding;
+        const auto maybe_format = System::get_environment_variable("VCPKG_BINARY_CACHE_FORMAT");
+        if (auto p_format = maybe_format.get())
+        {
+            default_encoding = parse_encoding_or_exit(*p_format, "VCPKG_BINARY_CACHE_FORMAT");
+        }
+
+        std::vector<std::unique_ptr<ArchiveProvider>> remotes;
+
+        const auto maybe_sources = System::get_environment_variable("VCPKG_BINARY_CACHE");
+        if (auto p_sources = maybe_sources.get())
+        {
+            for (auto&& entry : Strings::split(*p_sources, ";"))
+            {
+                // `<location>,<encoding>`; a comma that is not followed by an encoding is part of the location
+                std::string source = entry;
+                ArchiveEncoding encoding = default_encoding;
+                const auto comma = entry.rfind(',');
+                if (comma != std::string::npos)
+                {
+                    const std::string suffix = Strings::ascii_to_lowercase(entry.substr(comma + 1));
+                    if (suffix.compare(0, 3, "zip") == 0 || suffix.compare(0, 4, "zstd") == 0 ||
+                        suffix.compare(0, 3, "cas") == 0)
+                    {
+                        source = entry.substr(0, comma);
+                        encoding = parse_encoding_or_exit(suffix, "VCPKG_BINARY_CACHE entry " + entry);
+                    }
+                }
+
+                if (Strings::case_insensitive_ascii_starts_with(source, "http://") ||
+                    Strings::case_insensitive_ascii_starts_with(source, "https://"))
+                    remotes.push_back(make_http_archive_provider(fs, source, encoding));
+                else if (Strings::case_insensitive_ascii_starts_with(source, "s3://"))
+                    remotes.push_back(make_s3_archive_provider(fs, source, encoding));
+                else
+                    remotes.push_back(make_directory_archive_provider(fs, fs::u8path(source), encoding));
+            }
+        }
+
+        return BinaryCache(fs, local_root, default_encoding, std::move(remotes));
+    }
+
+    fs::path BinaryCache::local_archive_path(const std::string& abi_tag) const
+    {
+        return m_local_root / fs::u8path(archive_subpath(abi_tag, m_local_encoding.format));
+    }
+
+    bool BinaryCache::uses_format(const ArchiveFormat format) const
+    {
+        if (m_local_encoding.format == format) return true;
+        return std::any_of(
+            m_remotes.begin(), m_remotes.end(), [&](auto&& remote) { return remote->encoding().format == format; });
+    }
+
+    bool BinaryCache::has_archive(const std::string& abi_tag) const
+    {
+        auto provider_has_archive = [&](const ArchiveProvider& provider) {
+            const auto formats = lookup_order(provider);
+            return std::any_of(formats.begin(), formats.end(), [&](ArchiveFormat format) {
+                return provider.has_archive(abi_tag, format);
+            });
+        };
+
+        if (provider_has_archive(*m_local)) return true;
+        return std::any_of(
+            m_remotes.begin(), m_remotes.end(), [&](auto&& remote) { return provider_has_archive(*remote); });
+    }
+
+    std::vector<bool> BinaryCache::has_archives(const std::vector<std::string>& abi_tags,
+                                                const size_t max_concurrency) const
+    {
+        // std::vector<bool> packs its elements, so the workers write to separate bytes instead
+        std::vector<char> found(abi_tags.size(), 0);
+        std::atomic<size_t> next{0};
+        auto probe = [&]() {
+            for (size_t i = next++; i < abi_tags.size(); i = next++)
+            {
+                found[i] = has_archive(abi_tags[i]);
+            }
+        };
+
+        // The local tier is only a stat per tag; threads are worth it for remote round trips
+        const size_t thread_count = m_remotes.empty() ? 0 : std::min(max_concurrency, abi_tags.size());
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < thread_count; ++i)
+        {
+            threads.emplace_back(probe);
+        }
+        probe();
+        for (auto&& thread : threads)
+        {
+            thread.join();
+        }
+
+        return std::vector<bool>(found.begin(), found.end());
+    }
+
+    /// <summary>Counts one lookup of an archive in the tier labelled `backend`, and the bytes it restored.</summary>
+    static void count_lookup(const char* backend, const fs::path* restored)
+    {
+        OpenMetrics::add_counter("vcpkg_binary_cache_lookups_total",
+                                 "Archives looked up to restore packages, by binary cache tier and result.",
+                                 {{"backend", backend}, {"result", restored ? "hit" : "miss"}});
+        if (!restored) return;
+
+        std::error_code ec;
+        const auto size = fs::stdfs::file_size(*restored, ec);
+        if (ec) return;
+        OpenMetrics::add_counter("vcpkg_binary_cache_restored_bytes_total",
+                                 "Bytes of the archives packages were restored from, by binary cache tier.",
+                                 {{"backend", backend}},
+                                 static_cast<double>(size));
+    }
+
+    Optional<CachedArchive> BinaryCache::fetch_archive(const std::string& abi_tag) const
+    {
+        for (auto&& format : lookup_order(*m_local))
+        {
+            if (m_local->has_archive(abi_tag, format))
+            {
+                const fs::path local_path = m_local_root / fs::u8path(archive_subpath(abi_tag, format));
+                record_access(local_path);
+                count_lookup("local", &local_path);
+                return CachedArchive{local_path, format};
+            }
+        }
+        count_lookup("local", nullptr);
+
+        for (auto&& remote : m_remotes)
+        {
+            for (auto&& format : lookup_order(*remote))
+            {
+                const fs::path local_path = m_local_root / fs::u8path(archive_subpath(abi_tag, format));
+                const fs::path download_path = local_path.u8string() + ".download";
+                if (!remote->fetch_archive(abi_tag, format, download_path)) continue;
+
+                System::println("Downloaded cached binary package %s from %s", abi_tag, remote->location());
+
+                std::error_code ec;
+                m_fs->rename(download_path, local_path, ec);
+                if (!ec)
+                {
+                    count_lookup(remote->kind(), &local_path);
+                    return CachedArchive{local_path, format};
+                }
+                m_fs->remove(download_path, ec);
+            }
+            count_lookup(remote->kind(), nullptr);
+        }
+
+        return nullopt;
+    }
+
+    /// <summary>Counts the bytes of `archive`, stored in the tier labelled `backend`.</summary>
+    static void count_upload(const char* backend, const fs::path& archive)
+    {
+        std::error_code ec;
+        const auto size = fs::stdfs::file_size(archive, ec);
+        if (ec) return;
+        OpenMetrics::add_counter("vcpkg_binary_cache_uploaded_bytes_total",
+                                 "Bytes of the archives stored for built packages, by binary cache tier.",
+                                 {{"backend", backend}},
+                                 static_cast<double>(size));
+    }
+
+    std::vector<ArchiveEncoding> BinaryCache::store_encodings() const
+    {
+        std::vector<ArchiveEncoding> encodings{m_local_encoding};
+        for (auto&& remote : m_remotes)
+        {
+            if (std::find(encodings.begin(), encodings.end(), remote->encoding()) == encodings.end())
+                encodings.push_back(remote->encoding());
+        }
+        return encodings;
+    }
+
+    void BinaryCache::store_archive(const std::string& abi_tag,
+                                    const ArchiveEncoding& encoding,
+                                    const fs::path& archive) const
+    {
+        fs::path upload_path = archive;
+        std::error_code ec;
+        if (encoding == m_local_encoding)
+        {
+            const fs::path local_path = local_archive_path(abi_tag);
+            m_fs->create_directories(local_path.parent_path(), ec);
+            m_fs->rename_or_copy(archive, local_path, ".tmp", ec);
+            if (ec)
+            {
+                System::println(
+                    System::Color::warning, "Failed to store binary cache %s: %s", local_path.u8string(), ec.message());
+                return;
+            }
+            System::println("Stored binary cache: %s", local_path.u8string());
+            count_upload("local", local_path);
+            upload_path = local_path;
+        }
+
+        std::vector<std::string> blobs;
+        if (encoding.format == ArchiveFormat::MANIFEST)
+        {
+            auto maybe_entries = read_manifest(*m_fs, upload_path);
+            if (auto entries = maybe_entries.get())
+            {
+                for (auto&& entry : *entries)
+                {
+                    if (!entry.is_directory) blobs.push_back(entry.sha1);
+                }
+                Util::sort_unique_erase(blobs);
+            }
+        }
+
+        for (auto&& remote : m_remotes)
+        {
+            if (remote->encoding() != encoding) continue;
+
+            // Blobs go first, so that a reader never finds a manifest whose blobs are still missing
+            const bool stored_blobs = std::all_of(blobs.begin(), blobs.end(), [&](const std::string& sha1) {
+                return remote->has_blob(sha1) || remote->store_blob(sha1, local_blob_path(sha1));
+            });
+            if (!stored_blobs)
+            {
+                System::println(System::Color::warning, "Failed to upload binary cache blobs to %s", remote->location());
+                continue;
+            }
+
+            if (remote->store_archive(abi_tag, encoding.format, upload_path))
+            {
+                System::println("Uploaded binary cache %s to %s", abi_tag, remote->location());
+                count_upload(remote->kind(), upload_path);
+            }
+        }
+
+        // An archive in an encoding only remotes use is not kept locally
+        if (upload_path == archive) m_fs->remove(archive, ec);
+    }
+
+    void BinaryCache::store_metadata(ArchiveMetadata metadata) const
+    {
+        metadata.size = 0;
+        for (auto&& format : ALL_ARCHIVE_FORMATS)
+        {
+            const fs::path archive = m_local_root / fs::u8path(archive_subpath(metadata.abi_tag, format));
+            std::error_code ec;
+            const auto size = fs::stdfs::file_size(archive, ec);
+            if (!ec) metadata.size += size;
+        }
+        metadata.created = std::chrono::duration_cast<std::chrono::seconds>(
+                               std::chrono::system_clock::now().time_since_epoch())
+                               .count();
+
+        const fs::path path = m_local_root / fs::u8path(metadata_subpath(metadata.abi_tag));
+        const fs::path tmp_path = path.u8string() + unique_temp_suffix();
+        std::error_code ec;
+        m_fs->create_directories(path.parent_path(), ec);
+        m_fs->write_contents(tmp_path, metadata.to_string(), ec);
+        if (!ec) m_fs->rename(tmp_path, path, ec);
+        if (ec)
+        {
+            m_fs->remove(tmp_path, ec);
+            System::println(System::Color::warning, "Failed to store binary cache metadata %s", path.u8string());
+        }
+    }
+
+    bool BinaryCache::has_metadata(const std::string& abi_tag) const
+    {
+        return m_fs->exists(m_local_root / fs::u8path(metadata_subpath(abi_tag)));
+    }
+
+    std::vector<ArchiveMetadata> BinaryCache::load_all_metadata() const
+    {
+        std::vector<fs::path> paths;
+        for (auto&& entry : m_fs->get_entries_recursive(m_local_root))
+        {
+            if (entry.type == fs::file_type::regular && entry.path.extension() == METADATA_EXTENSION)
+                paths.push_back(entry.path);
+        }
+
+        auto loaded = ThreadPool::parallel_transform(paths, [&](const fs::path& path) -> Optional<ArchiveMetadata> {
+            const auto maybe_contents = m_fs->read_contents(path);
+            const auto contents = maybe_contents.get();
+            if (!contents) return nullopt;
+            auto maybe_metadata = ArchiveMetadata::parse(path.stem().u8string(), *contents);
+            if (auto metadata = maybe_metadata.get()) return std::move(*metadata);
+            return nullopt;
+        });
+
+        std::vector<ArchiveMetadata> all_metadata;
+        for (auto&& maybe_metadata : loaded)
+        {
+            if (auto metadata = maybe_metadata.get()) all_metadata.push_back(std::move(*metadata));
+        }
+        return all_metadata;
+    }
+
+    fs::path BinaryCache::local_blob_path(const std::string& sha1) const
+    {
+        return m_local_root / fs::u8path(blob_subpath(sha1));
+    }
+
+    ExpectedT<size_t, std::string> BinaryCache::write_manifest(const fs::path& package_dir,
+                                                               const fs::path& manifest_path) const
+    {
+        std::error_code ec;
+        std::vector<fs::path> paths;
+        for (fs::stdfs::recursive_directory_iterator it(package_dir, ec), end; !ec && it != end; it.increment(ec))
+        {
+            paths.push_back(it->path());
+        }
+        if (ec) return Strings::format("Failed to enumerate %s: %s", package_dir.u8string(), ec.message());
+        Util::sort(paths);
+
+        const std::string root = package_dir.generic_u8string();
+        std::string manifest = MANIFEST_HEADER + "\n";
+        size_t entry_count = 0;
+        for (auto&& path : paths)
+        {
+            const auto status = m_fs->status(path, ec);
+            const bool is_directory = !ec && fs::is_directory(status);
+            if (ec || (!is_directory && !fs::is_regular_file(status))) continue;
+
+            std::string relative = path.generic_u8string().substr(root.size());
+            while (!relative.empty() && relative.front() == '/')
+                relative.erase(0, 1);
+            ++entry_count;
+
+            if (is_directory)
+            {
+                manifest += Strings::format("d %s\n", relative);
+                continue;
+            }
+
+            const std::string sha1 = Hash::get_file_hash(*m_fs, path, "SHA1");
+            const uint64_t size = fs::stdfs::file_size(path, ec);
+            if (ec) return Strings::format("Failed to read %s: %s", path.u8string(), ec.message());
+            if (m_local->has_blob(sha1))
+                record_access(local_blob_path(sha1));
+            else if (!m_local->store_blob(sha1, path))
+                return Strings::format("Failed to store %s in the blob store", path.u8string());
+
+            const auto mode = static_cast<unsigned int>(status.permissions()) & 0777;
+            manifest += Strings::format("f %s %llu %o %s\n", sha1, static_cast<unsigned long long>(size), mode, relative);
+        }
+
+        m_fs->write_contents(manifest_path, manifest, ec);
+        if (ec) return Strings::format("Failed to write %s: %s", manifest_path.u8string(), ec.message());
+        return entry_count;
+    }
+
+    /// <summary>Whether `file` has exactly the contents and mode that `entry` describes.</summary>
+    static bool file_matches_entry(const Files::Filesystem& fs, const fs::path& file, const ManifestEntry& entry)
+    {
+        std::error_code ec;
+        const auto status = fs.status(file, ec);
+        if (ec || status.type() != fs::file_type::regular) return false;
+#if !defined(_WIN32)
+        if ((static_cast<uint32_t>(status.permissions()) & 0777) != entry.mode) return false;
+#endif
+        if (fs::stdfs::file_size(file, ec) != entry.size || ec) return false;
+        return Hash::get_file_hash(fs, file, "SHA1") == entry.sha1;
+    }
+
+    ExpectedT<size_t, std::string> BinaryCache::restore_manifest(const fs::path& manifest_path,
+                                                                 const fs::path& package_dir,
+                                                                 const std::vector<fs::path>& reuse_dirs) const
+    {
+        auto maybe_entries = read_manifest(*m_fs, manifest_path);
+        auto entries = maybe_entries.get();
+        if (!entries) return std::move(maybe_entries).error();
+
+        std::error_code ec;
+        m_fs->create_directories(package_dir, ec);
+        for (auto&& entry : *entries)
+        {
+            const fs::path target = package_dir / fs::u8path(entry.path);
+            if (entry.is_directory)
+            {
+                m_fs->create_directories(target, ec);
+                continue;
+            }
+
+            const bool reused = std::any_of(reuse_dirs.begin(), reuse_dirs.end(), [&](const fs::path& reuse_dir) {
+                const fs::path previous = reuse_dir / fs::u8path(entry.path);
+                if (!file_matches_entry(*m_fs, previous, entry)) return false;
+                m_fs->create_directories(target.parent_path(), ec);
+                m_fs->remove(target, ec);
+                m_fs->create_hard_link(previous, target, ec);
+                return !ec;
+            });
+            ec.clear();
+            if (reused) continue;
+
+            const fs::path blob = local_blob_path(entry.sha1);
+            if (!m_fs->exists(blob))
+            {
+                const fs::path download_path = blob.u8string() + unique_temp_suffix();
+                m_fs->create_directories(blob.parent_path(), ec);
+                const bool downloaded = std::any_of(m_remotes.begin(), m_remotes.end(), [&](auto&& remote) {
+                    if (remote->fetch_blob(entry.sha1, download_path) &&
+                        Hash::get_file_hash(*m_fs, download_path, "SHA1") == entry.sha1)
+                        return true;
+                    m_fs->remove(download_path, ec);
+                    return false;
+                });
+                if (downloaded) m_fs->rename(download_path, blob, ec);
+                if (ec)
+                {
+                    // Another restore may have published the same blob first
+                    m_fs->remove(download_path, ec);
+                    ec.clear();
+                }
+                if (!downloaded || !m_fs->exists(blob))
+                    return Strings::format(
+                        "%s refers to blob %s for %s, which no tier has", manifest_path.u8string(), entry.sha1, entry.path);
+            }
+
+            m_fs->create_directories(target.parent_path(), ec);
+            m_fs->remove(target, ec);
+
+            // A hard link shares the blob's permissions, so a file whose mode differs from the blob's is copied
+#if defined(_WIN32)
+            const bool same_mode = true;
+#else
+            const bool same_mode = (static_cast<uint32_t>(m_fs->status(blob, ec).permissions()) & 0777) == entry.mode;
+#endif
+            ec.clear();
+            if (same_mode) m_fs->create_hard_link(blob, target, ec);
+            if (!same_mode || ec)
+            {
+                ec.clear();
+                m_fs->copy_file(blob, target, fs::copy_options::overwrite_existing, ec);
+                if (ec) return Strings::format("Failed to restore %s: %s", target.u8string(), ec.message());
+#if !defined(_WIN32)
+                fs::stdfs::permissions(target, static_cast<fs::stdfs::perms>(entry.mode), ec);
+#endif
+            }
+        }
+
+        return entries->size();
+    }
+
+    ExpectedT<uint64_t, std::string> parse_cache_size(const std::string& text)
+    {
+        static constexpr std::pair<char, int> SUFFIXES[] = {{'K', 10}, {'M', 20}, {'G', 30}, {'T', 40}};
+
+        std::string digits = text;
+        int shift = 0;
+        if (!digits.empty())
+        {
+            const char last = static_cast<char>(std::toupper(static_cast<unsigned char>(digits.back())));
+            for (auto&& suffix : SUFFIXES)
+            {
+                if (suffix.first == last)
+                {
+                    shift = suffix.second;
+                    digits.pop_back();
+                }
+            }
+        }
+
+        const bool is_number = !digits.empty() && digits.size() <= 12 &&
+                               std::all_of(digits.begin(), digits.end(), [](char ch) { return ch >= '0' && ch <= '9'; });
+        if (!is_number) return Strings::format("invalid size '%s', expected a number optionally followed by K, M, G or T", text);
+        return std::stoull(digits) << shift;
+    }
+
+    static constexpr auto GC_GRACE_PERIOD = std::chrono::hours(1);
+
+    struct CachedFile
+    {
+        fs::path path;
+        uint64_t size = 0;
+        fs::stdfs::file_time_type last_access;
+        std::vector<std::string> blobs;
+    };
+
+    static Optional<ArchiveFormat> archive_format_of(const std::string& filename)
+    {
+        for (auto&& format : ALL_ARCHIVE_FORMATS)
+        {
+            const std::string& extension = archive_extension(format);
+            if (filename.size() > extension.size() &&
+                filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0)
+                return format;
+        }
+        return nullopt;
+    }
+
+    static bool is_in_use(const fs::path& path, const fs::stdfs::file_time_type cutoff)
+    {
+        std::error_code ec;
+        const auto last_access = fs::stdfs::last_write_time(path, ec);
+        return ec || last_access > cutoff;
+    }
+
+    CacheGcResult BinaryCache::collect_garbage(const uint64_t max_size) const
+    {
+        const auto cutoff = fs::stdfs::file_time_type::clock::now() - GC_GRACE_PERIOD;
+        const std::string root = m_local_root.generic_u8string();
+
+        std::vector<CachedFile> archives;
+        std::map<std::string, CachedFile> blobs;
+        std::map<std::string, CachedFile> metadata;
+        for (auto&& entry : m_fs->get_entries_recursive(m_local_root))
+        {
+            if (entry.type != fs::file_type::regular) continue;
+
+            std::error_code file_ec;
+            CachedFile file;
+            file.path = entry.path;
+            file.size = entry.size;
+            file.last_access = entry.last_write_time;
+
+            std::string relative = file.path.generic_u8string().substr(root.size());
+            while (!relative.empty() && relative.front() == '/')
+                relative.erase(0, 1);
+            const std::string filename = file.path.filename().u8string();
+            if (Strings::ends_with(filename, ".tmp") || Strings::ends_with(filename, ".download"))
+            {
+                // Left behind by an interrupted store or download
+                if (file.last_access < cutoff) m_fs->remove(file.path, file_ec);
+            }
+            else if (relative.compare(0, 6, "blobs/") == 0)
+            {
+                blobs.emplace(filename, std::move(file));
+            }
+            else if (file.path.extension() == METADATA_EXTENSION)
+            {
+                metadata.emplace(file.path.stem().u8string(), std::move(file));
+            }
+            else if (file.path.extension() == LEASE_EXTENSION)
+            {
+                // Removed only while locked here, so never from under a build that holds it
+                if (file.last_access < cutoff)
+                {
+                    auto lease = m_fs->lock_file(file.path, false, file_ec);
+                    if (lease) m_fs->remove(file.path, file_ec);
+                }
+            }
+            else if (const auto format = archive_format_of(filename))
+            {
+                if (format.value_or_exit(VCPKG_LINE_INFO) == ArchiveFormat::MANIFEST)
+                {
+                    auto maybe_entries = read_manifest(*m_fs, file.path);
+                    if (auto entries = maybe_entries.get())
+                    {
+                        for (auto&& entry : *entries)
+                        {
+                            if (!entry.is_directory) file.blobs.push_back(entry.sha1);
+                        }
+                        Util::sort_unique_erase(file.blobs);
+                    }
+                }
+                archives.push_back(std::move(file));
+            }
+        }
+
+        // Archives of every format of a package share its metadata, so it goes with the last of them
+        const auto abi_of = [](const CachedFile& file) {
+            const std::string filename = file.path.filename().u8string();
+            return filename.substr(0, filename.find('.'));
+        };
+        std::map<std::string, size_t> archives_per_abi;
+        std::map<std::string, size_t> blob_references;
+        for (auto&& archive : archives)
+        {
+            ++archives_per_abi[abi_of(archive)];
+            for (auto&& sha1 : archive.blobs)
+            {
+                ++blob_references[sha1];
+            }
+        }
+
+        CacheGcResult result;
+        auto remove_file = [&](const CachedFile& file) {
+            std::error_code remove_ec;
+            // A file held open by another process (on Windows) cannot be removed; it is retried by a later run
+            if (!m_fs->remove(file.path, remove_ec) || remove_ec) return false;
+            ++result.removed_files;
+            result.removed_bytes += file.size;
+            return true;
+        };
+
+        // Blobs stored within the grace period may belong to a manifest still being written
+        std::vector<const CachedFile*> unreferenced_blobs;
+        for (auto&& blob : blobs)
+        {
+            if (blob_references[blob.first] == 0)
+                unreferenced_blobs.push_back(&blob.second);
+            else
+                result.remaining_bytes += blob.second.size;
+        }
+
+        for (auto&& archive : archives)
+        {
+            result.remaining_bytes += archive.size;
+        }
+
+        std::sort(archives.begin(), archives.end(), [](const CachedFile& lhs, const CachedFile& rhs) {
+            return lhs.last_access < rhs.last_access;
+        });
+
+        for (auto&& archive : archives)
+        {
+            if (result.remaining_bytes <= max_size || archive.last_access > cutoff) break;
+            if (is_in_use(archive.path, cutoff) || !remove_file(archive)) continue;
+
+            result.remaining_bytes -= archive.size;
+            --archives_per_abi[abi_of(archive)];
+            for (auto&& sha1 : archive.blobs)
+            {
+                const auto blob = blobs.find(sha1);
+                if (--blob_references[sha1] != 0 || blob == blobs.end()) continue;
+                unreferenced_blobs.push_back(&blob->second);
+                result.remaining_bytes -= blob->second.size;
+            }
+        }
+
+        for (auto&& blob : unreferenced_blobs)
+        {
+            // The write time is read again, since a manifest being written may have reused the blob meanwhile
+            if (blob->last_access > cutoff || is_in_use(blob->path, cutoff) || !remove_file(*blob))
+                result.remaining_bytes += blob->size;
+        }
+
+        for (auto&& entry : metadata)
+        {
+            const CachedFile& file = entry.second;
+            if (archives_per_abi[entry.first] != 0 || is_in_use(file.path, cutoff) || !remove_file(file))
+                result.remaining_bytes += file.size;
+        }
+
+        return result;
+    }
+
+    void BinaryCache::collect_garbage_from_environment() const
+    {
+        const auto maybe_max_size = System::get_environment_variable("VCPKG_BINARY_CACHE_MAX_SIZE");
+        const auto p_max_size = maybe_max_size.get();
+        if (!p_max_size) return;
+
+        const auto maybe_size = parse_cache_size(*p_max_size);
+        const auto p_size = maybe_size.get();
+        if (!p_size)
+        {
+            System::println(System::Color::warning, "Ignoring VCPKG_BINARY_CACHE_MAX_SIZE: %s", maybe_size.error());
+            return;
+        }
+
+        // Stamped before scanning, so that concurrent vcpkg processes do not all scan the cache at once
+        const fs::path stamp = m_local_root / "gc.stamp";
+        if (m_fs->exists(stamp) && is_in_use(stamp, fs::stdfs::file_time_type::clock::now() - GC_GRACE_PERIOD)) return;
+        std::error_code ec;
+        m_fs->create_directories(m_local_root, ec);
+        m_fs->write_contents(stamp, "", ec);
+        if (ec) return;
+
+        const auto result = collect_garbage(*p_size);
+        if (result.removed_files != 0)
+            System::println("Removed %zd files (%s MiB) from the binary cache",
+                            result.removed_files,
+                            std::to_string(result.removed_bytes >> 20));
+    }
+
+    Optional<std::string> BinaryCache::find_tombstone(const std::string& abi_tag) const
+    {
+        if (m_local->has_tombstone(abi_tag)) return m_local->location();
+        for (auto&& remote : m_remotes)
+        {
+            if (remote->has_tombstone(abi_tag)) return remote->location();
+        }
+        return nullopt;
+    }
+
+    void BinaryCache::store_tombstone(const std::string& abi_tag) const
+    {
+        m_local->store_tombstone(abi_tag);
+        for (auto&& remote : m_remotes)
+        {
+            remote->store_tombstone(abi_tag);
+        }
+    }
+
+    void BinaryCache::purge_tombstone(const std::string& abi_tag) const
+    {
+        m_local->purge_tombstone(abi_tag);
+        for (auto&& remote : m_remotes)
+        {
+            remote->purge_tombstone(abi_tag);
+        }
+    }
+
+    std::unique_ptr<Files::FileLock> BinaryCache::try_lease_build(const std::string& abi_tag) const
+    {
+        const fs::path path = m_local_root / fs::u8path(lease_subpath(abi_tag));
+        std::error_code ec;
+        m_fs->create_directories(path.parent_path(), ec);
+        auto lease = m_fs->lock_file(path, false, ec);
+        if (lease || !ec) return lease;
+
+        // A cache that cannot be locked, such as a read-only share, must not keep the package from being built
+        System::println(System::Color::warning, "Failed to lock %s: %s", path.u8string(), ec.message());
+        return std::make_unique<Files::FileLock>();
+    }
+
+    void BinaryCache::wait_for_lease(const std::string& abi_tag) const
+    {
+        std::error_code ec;
+        Util::unused(m_fs->lock_file(m_local_root / fs::u8path(lease_subpath(abi_tag)), true, ec));
+    }
+}
@@ -8,29 +8,50 @@ namespace vcpkg
 {
     namespace Fields
     {
-        static const std::string PACKAGE = "Package";
-        static const std::string VERSION = "Version";
-        static const std::string ARCHITECTURE = "Architecture";
-        static const std::string MULTI_ARCH = "Multi-Arch";
+        static constexpr std::string_view NAMES[] = {
+            "Package",
+            "Version",
+            "Architecture",
+            "Multi-Arch",
+            "Abi",
+            "Output-Abi",
+            "Feature",
+            "Description",
+            "Maintainer",
+            "Depends",
+            "Default-Features",
+        };
+        static constexpr Parse::FieldTable TABLE = NAMES;
+
+        static constexpr size_t PACKAGE = TABLE.id("Package");
+        static constexpr size_t VERSION = TABLE.id("Version");
+        static constexpr size_t ARCHITECTURE = TABLE.id("Architecture");
+        static constexpr size_t MULTI_ARCH = TABLE.id("Multi-Arch");
     }
 
     namespace Fields
     {
-        static const std::string ABI = "Abi";
-        static const std::string FEATURE = "Feature";
-        static const std::string DESCRIPTION = "Description";
-        static const std::string MAINTAINER = "Maintainer";
-        static const std::string DEPENDS = "Depends";
-        static const std::string DEFAULTFEATURES = "Default-Features";
+        static constexpr size_t ABI = TABLE.id("Abi");
+        static constexpr size_t OUTPUT_ABI = TABLE.id("Output-Abi");
+        static constexpr size_t FEATURE = TABLE.id("Feature");
+        static constexpr size_t DESCRIPTION = TABLE.id("Description");
+        static constexpr size_t MAINTAINER = TABLE.id("Maintainer");
+        static constexpr size_t DEPENDS = TABLE.id("Depends");
+        static constexpr size_t DEFAULTFEATURES = TABLE.id("Default-Features");
     }
 
     BinaryParagraph::BinaryParagraph() = default;
 
     BinaryParagraph::BinaryParagraph(std::unordered_map<std::string, std::string> fields)
+        : BinaryParagraph(Parse::RawParagraphView::from_raw_paragraph(fields))
+    {
+    }
+
+    BinaryParagraph::BinaryParagraph(const Parse::RawParagraphView& fields)
     {
         using namespace vcpkg::Parse;
 
-        ParagraphParser parser(std::move(fields));
+        ParagraphParser parser(fields, Fields::TABLE);
 
         {
             std::string name;
@@ -49,14 +70,15 @@ namespace vcpkg
         this->maintainer = parser.optional_field(Fields::MAINTAINER);
 
         this->abi = parser.optional_field(Fields::ABI);
+        this->output_abi = parser.optional_field(Fields::OUTPUT_ABI);
 
         std::string multi_arch;
         parser.required_field(Fields::MULTI_ARCH, multi_arch);
 
-        this->depends = parse_comma_list(parser.optional_field(Fields::DEPENDS));
+        this->depends = parse_comma_list(parser.optional_field_view(Fields::DEPENDS));
         if (this->feature.empty())
         {
-            this->default_features = parse_comma_list(parser.optional_field(Fields::DEFAULTFEATURES));
+            this->default_features = parse_comma_list(parser.optional_field_view(Fields::DEFAULTFEATURES));
         }
 
         if (const auto err = parser.error_info(this->spec.to_string()))
@@ -109,7 +131,7 @@ namespace vcpkg
         if (!pgh.depends.empty())
         {
             out_str.append("Depends: ");
-            out_str.append(Strings::join(", ", pgh.depends));
+            Strings::join_to(out_str, ", ", pgh.depends, [](std::string& out, const std::string& d) { out.append(d); });
             out_str.push_back('\n');
         }
 
@@ -118,6 +140,7 @@ namespace vcpkg
 
         if (!pgh.maintainer.empty()) out_str.append("Maintainer: ").append(pgh.maintainer).push_back('\n');
         if (!pgh.abi.empty()) out_str.append("Abi: ").append(pgh.abi).push_back('\n');
+        if (!pgh.output_abi.empty()) out_str.append("Output-Abi: ").append(pgh.output_abi).push_back('\n');
         if (!pgh.description.empty()) out_str.append("Description: ").append(pgh.description).push_back('\n');
     }
 }
@@ -2,22 +2,32 @@
 
 #include <vcpkg/base/checks.h>
 #include <vcpkg/base/chrono.h>
+#include <vcpkg/base/downloads.h>
 #include <vcpkg/base/enums.h>
 #include <vcpkg/base/hash.h>
 #include <vcpkg/base/optional.h>
 #include <vcpkg/base/stringliteral.h>
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/tar.h>
+#include <vcpkg/base/threadpool.h>
+#include <vcpkg/base/trace.h>
+#include <vcpkg/base/transfers.h>
+#include <vcpkg/base/zip.h>
 
 #include <vcpkg/build.h>
+#include <vcpkg/buildhistory.h>
 #include <vcpkg/commands.h>
 #include <vcpkg/dependencies.h>
+#include <vcpkg/downloadreferences.h>
 #include <vcpkg/globalstate.h>
 #include <vcpkg/help.h>
 #include <vcpkg/input.h>
 #include <vcpkg/metrics.h>
 #include <vcpkg/paragraphs.h>
 #include <vcpkg/postbuildlint.h>
+#include <vcpkg/remove.h>
 #include <vcpkg/statusparagraphs.h>
+#include <vcpkg/tripletenvironment.h>
 #include <vcpkg/vcpkglib.h>
 
 using vcpkg::Build::BuildResult;
@@ -30,6 +40,8 @@ namespace vcpkg::Build::Command
     using Dependencies::InstallPlanType;
 
     static constexpr StringLiteral OPTION_CHECKS_ONLY = "--checks-only";
+    static constexpr StringLiteral OPTION_LINT_ONLY = "--x-lint-only";
+    static constexpr StringLiteral OPTION_INCREMENTAL = "--x-incremental";
 
     void perform_and_exit_ex(const FullPackageSpec& full_spec,
                              const fs::path& port_dir,
@@ -46,6 +58,8 @@ namespace vcpkg::Build::Command
             Checks::exit_success(VCPKG_LINE_INFO);
         }
 
+        Build::prefetch_build_tools(paths);
+
         const ParseExpected<SourceControlFile> source_control_file =
             Paragraphs::try_load_port(paths.get_filesystem(), port_dir);
 
@@ -62,7 +76,8 @@ namespace vcpkg::Build::Command
                            scf->core_paragraph->name,
                            spec.name());
 
-        const StatusParagraphs status_db = database_load_check(paths);
+        // The dependencies are built against in this tree
+        const StatusParagraphs status_db = database_load_check(paths, InstalledBase::IMPORT);
         const Build::BuildPackageOptions build_package_options{
             Build::UseHeadVersion::NO,
             Build::AllowDownloads::YES,
@@ -71,16 +86,19 @@ namespace vcpkg::Build::Command
             Build::DownloadTool::BUILT_IN,
             GlobalState::g_binary_caching ? Build::BinaryCaching::YES : Build::BinaryCaching::NO,
             Build::FailOnTombstone::NO,
+            Util::Enum::to_enum<Build::Incremental>(Util::Sets::contains(options.switches, OPTION_INCREMENTAL)),
         };
 
-        std::set<std::string> features_as_set(full_spec.features.begin(), full_spec.features.end());
-        features_as_set.emplace("core");
+        FeatureList features{"core"};
+        for (auto&& feature : full_spec.features)
+            features.insert(feature);
 
         const Build::BuildPackageConfig build_config{
-            *scf, spec.triplet(), fs::path{port_dir}, build_package_options, features_as_set};
+            *scf, spec.triplet(), fs::path{port_dir}, build_package_options, features};
 
         const auto build_timer = Chrono::ElapsedTimer::create_started();
         const auto result = Build::build_package(paths, build_config, status_db);
+        Build::wait_for_archives();
         System::println("Elapsed time for package %s: %s", spec.to_string(), build_timer.to_string());
 
         if (result.code == BuildResult::CASCADED_DUE_TO_MISSING_DEPENDENCIES)
@@ -109,22 +127,106 @@ namespace vcpkg::Build::Command
         Checks::exit_success(VCPKG_LINE_INFO);
     }
 
-    static constexpr std::array<CommandSwitch, 1> BUILD_SWITCHES = {{
+    /// <summary>
+    /// The packages in packages/ that finished building. Their directories are named <port>_<triplet>, and port
+    /// names cannot contain an underscore.
+    /// </summary>
+    static std::vector<PackageSpec> find_built_packages(const VcpkgPaths& paths)
+    {
+        auto& fs = paths.get_filesystem();
+        std::vector<PackageSpec> specs;
+        for (auto&& package_dir : fs.get_files_non_recursive(paths.packages))
+        {
+            if (!fs.exists(package_dir / "BUILD_INFO")) continue;
+
+            const std::string dir_name = package_dir.filename().u8string();
+            const auto underscore = dir_name.find('_');
+            if (underscore == std::string::npos) continue;
+
+            auto maybe_spec = PackageSpec::from_name_and_triplet(
+                dir_name.substr(0, underscore), Triplet::from_canonical_name(dir_name.substr(underscore + 1)));
+            if (auto spec = maybe_spec.get()) specs.push_back(std::move(*spec));
+        }
+        std::sort(specs.begin(), specs.end(), [](const PackageSpec& left, const PackageSpec& right) {
+            return left.to_string() < right.to_string();
+        });
+        return specs;
+    }
+
+    /// <summary>
+    /// Runs the post-build checks on already-built packages in parallel. The triplets are evaluated once each, up
+    /// front, rather than once per package.
+    /// </summary>
+    static void lint_and_exit(const VcpkgCmdArguments& args,
+                              const VcpkgPaths& paths,
+                              const Triplet& default_triplet,
+                              CStringView example_text)
+    {
+        const std::vector<PackageSpec> specs =
+            args.command_arguments.empty()
+                ? find_built_packages(paths)
+                : Input::check_and_get_package_specs(args.command_arguments, default_triplet, example_text, paths);
+
+        std::vector<Triplet> triplets = Util::fmap(specs, [](const PackageSpec& spec) { return spec.triplet(); });
+        Util::sort_unique_erase(triplets);
+        const auto pre_build_infos = ThreadPool::parallel_transform(
+            triplets, [&](const Triplet& triplet) { return PreBuildInfo::from_triplet_file(paths, triplet); });
+
+        const auto error_counts = ThreadPool::parallel_transform(specs, [&](const PackageSpec& spec) {
+            const size_t triplet_index = Util::find(triplets, spec.triplet()) - triplets.begin();
+            const auto build_info = read_build_info(paths.get_filesystem(), paths.build_info_file_path(spec));
+            return PostBuildLint::perform_all_checks(spec, paths, pre_build_infos[triplet_index], build_info);
+        });
+
+        std::vector<const PackageSpec*> failed;
+        for (size_t i = 0; i < specs.size(); ++i)
+        {
+            if (error_counts[i] != 0) failed.push_back(&specs[i]);
+        }
+
+        System::println("Checked %zd package(s).", specs.size());
+        if (failed.empty()) Checks::exit_success(VCPKG_LINE_INFO);
+
+        System::println(System::Color::error, "The following packages failed the post-build checks:");
+        for (auto&& spec : failed)
+            System::println("    %s", spec->to_string());
+        Checks::exit_fail(VCPKG_LINE_INFO);
+    }
+
+    static constexpr std::array<CommandSwitch, 3> BUILD_SWITCHES = {{
         {OPTION_CHECKS_ONLY, "Only run checks, do not rebuild package"},
+        {OPTION_INCREMENTAL,
+         "Keep the CMake build directories of the previous build while sources, patches and options are unchanged "
+         "(experimental)"},
+        {OPTION_LINT_ONLY,
+         "Run the checks on the given already-built packages, or on all of packages/ if none are given, in parallel"},
     }};
 
     const CommandStructure COMMAND_STRUCTURE = {
         Help::create_example_string("build zlib:x64-windows"),
-        1,
-        1,
+        0,
+        SIZE_MAX,
         {BUILD_SWITCHES, {}},
         nullptr,
     };
 
     void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet)
     {
-        // Build only takes a single package and all dependencies must already be installed
         const ParsedArguments options = args.parse_arguments(COMMAND_STRUCTURE);
+        if (Util::Sets::contains(options.switches, OPTION_LINT_ONLY))
+        {
+            lint_and_exit(args, paths, default_triplet, COMMAND_STRUCTURE.example_text);
+        }
+
+        // Build only takes a single package and all dependencies must already be installed
+        if (args.command_arguments.size() != 1)
+        {
+            System::println(System::Color::error,
+                            "Error: 'build' requires 1 argument, but %zd were provided.",
+                            args.command_arguments.size());
+            System::print(COMMAND_STRUCTURE.example_text);
+            Checks::exit_fail(VCPKG_LINE_INFO);
+        }
         const std::string command_argument = args.command_arguments.at(0);
         const FullPackageSpec spec =
             Input::check_and_get_full_package_spec(command_argument, default_triplet, COMMAND_STRUCTURE.example_text);
@@ -192,10 +294,24 @@ namespace vcpkg::Build
         return nullopt;
     }
 
-    namespace BuildInfoRequiredField
+    namespace BuildInfoFields
     {
-        static const std::string CRT_LINKAGE = "CRTLinkage";
-        static const std::string LIBRARY_LINKAGE = "LibraryLinkage";
+        static constexpr std::string_view NAMES[] = {
+            "CRTLinkage",
+            "LibraryLinkage",
+            "Version",
+            // The names of the policies, as given by to_string(BuildPolicy)
+            "PolicyEmptyPackage",
+            "PolicyDLLsWithoutLIBs",
+            "PolicyOnlyReleaseCRT",
+            "PolicyEmptyIncludeFolder",
+            "PolicyAllowObsoleteMsvcrt",
+        };
+        static constexpr Parse::FieldTable TABLE = NAMES;
+
+        static constexpr size_t CRT_LINKAGE = TABLE.id("CRTLinkage");
+        static constexpr size_t LIBRARY_LINKAGE = TABLE.id("LibraryLinkage");
+        static constexpr size_t VERSION = TABLE.id("Version");
     }
 
     CStringView to_vcvarsall_target(const std::string& cmake_system_name)
@@ -253,6 +369,146 @@ namespace vcpkg::Build
                                tonull);
     }
 
+    std::string describe_install_stamp(const fs::path& path)
+    {
+        std::error_code ec;
+        const auto write_time = fs::stdfs::last_write_time(path, ec);
+        if (ec) return path.u8string() + " missing\n";
+        const auto size = fs::stdfs::is_directory(path, ec) ? 0 : fs::stdfs::file_size(path, ec);
+        return Strings::format("%s %llu %lld\n",
+                               path.u8string(),
+                               static_cast<unsigned long long>(size),
+                               static_cast<long long>(write_time.time_since_epoch().count()));
+    }
+
+    /// <summary>Reads the NAME=VALUE lines printed by cmd's set.</summary>
+    static std::unordered_map<std::string, std::string> parse_environment(const std::vector<std::string>& lines)
+    {
+        std::unordered_map<std::string, std::string> environment;
+        for (auto&& line : lines)
+        {
+            const auto equals = line.find('=', 1);
+            if (equals == std::string::npos) continue;
+            auto name = line.substr(0, equals);
+            // Windows treats the names case-insensitively; cmd_execute_clean expects PATH in capitals
+            if (Strings::case_insensitive_ascii_equals(name, "PATH")) name = "PATH";
+            auto value = line.substr(equals + 1);
+            if (!value.empty() && value.back() == '\r') value.pop_back();
+            environment[std::move(name)] = std::move(value);
+        }
+        return environment;
+    }
+
+    /// <summary>
+    /// Runs env_cmd in the clean environment and returns the variables that it sets or changes. cmd_execute_clean adds
+    /// them to the clean environment again, and appends PATH to the clean one, so only the directories that env_cmd
+    /// put in front of the clean PATH are kept.
+    /// </summary>
+    static Optional<std::unordered_map<std::string, std::string>> capture_build_env(Files::Filesystem& fs,
+                                                                                   const fs::path& capture_stem,
+                                                                                   const std::string& env_cmd)
+    {
+        const fs::path before_file = fs::path(capture_stem).concat(".before.tmp");
+        const fs::path after_file = fs::path(capture_stem).concat(".after.tmp");
+        const int exit_code = System::cmd_execute_clean(Strings::format(
+            R"(set > "%s" & %s && set > "%s")", before_file.u8string(), env_cmd, after_file.u8string()));
+
+        auto maybe_before = fs.read_lines(before_file);
+        auto maybe_after = fs.read_lines(after_file);
+        std::error_code ec;
+        fs.remove(before_file, ec);
+        fs.remove(after_file, ec);
+
+        const auto before_lines = maybe_before.get();
+        const auto after_lines = maybe_after.get();
+        if (exit_code != 0 || !before_lines || !after_lines) return nullopt;
+
+        const auto before = parse_environment(*before_lines);
+        auto changed = parse_environment(*after_lines);
+        for (auto it = changed.begin(); it != changed.end();)
+        {
+            const auto it_before = before.find(it->first);
+            if (it_before != before.end() && it_before->second == it->second)
+                it = changed.erase(it);
+            else
+                ++it;
+        }
+
+        const auto it_path = changed.find("PATH");
+        const auto it_path_before = before.find("PATH");
+        if (it_path != changed.end() && it_path_before != before.end())
+        {
+            std::string& path = it_path->second;
+            const std::string clean_suffix = ";" + it_path_before->second;
+            if (path.size() > clean_suffix.size() &&
+                path.compare(path.size() - clean_suffix.size(), clean_suffix.size(), clean_suffix) == 0)
+            {
+                path.resize(path.size() - clean_suffix.size());
+            }
+        }
+
+        return changed;
+    }
+
+    std::vector<fs::path> get_build_env_stamp_paths(const Toolset& toolset)
+    {
+        // A Visual Studio update rewrites the default tools version next to vcvarsall, and a new Windows SDK adds a
+        // directory to the SDK includes, which vcvarsall picks the newest of
+        const fs::path program_files_x86 =
+            fs::u8path(System::get_environment_variable("ProgramFiles(x86)").value_or("C:\\Program Files (x86)"));
+        return {
+            toolset.vcvarsall,
+            toolset.vcvarsall.parent_path() / "Microsoft.VCToolsVersion.default.txt",
+            program_files_x86 / "Windows Kits" / "10" / "Include",
+        };
+    }
+
+    Optional<std::unordered_map<std::string, std::string>> get_build_env(const VcpkgPaths& paths,
+                                                                         const PreBuildInfo& pre_build_info,
+                                                                         const Toolset& toolset)
+    {
+        const std::string env_cmd = make_build_env_cmd(pre_build_info, toolset);
+        if (env_cmd.empty()) return std::unordered_map<std::string, std::string>();
+
+        std::string key = Strings::format("%s\n%s\n", env_cmd, toolset.version);
+        for (auto&& path : get_build_env_stamp_paths(toolset))
+        {
+            key += describe_install_stamp(path);
+        }
+        const std::string key_hash = Hash::get_string_hash(key, "SHA1");
+
+        static std::mutex mutex;
+        static std::map<std::string, std::unordered_map<std::string, std::string>> captured;
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto it = captured.find(key_hash);
+        if (it != captured.end()) return it->second;
+
+        auto& fs = paths.get_filesystem();
+        const fs::path cache_file = paths.vcpkg_dir / "vcvars" / (key_hash + ".txt");
+        const auto maybe_cached = fs.read_lines(cache_file);
+        if (const auto cached = maybe_cached.get())
+        {
+            return captured.emplace(key_hash, parse_environment(*cached)).first->second;
+        }
+
+        std::error_code ec;
+        fs.create_directories(cache_file.parent_path(), ec);
+        auto maybe_env = capture_build_env(fs, paths.vcpkg_dir / "vcvars" / key_hash, env_cmd);
+        const auto env = maybe_env.get();
+        if (!env) return nullopt;
+
+        std::string contents;
+        for (auto&& variable : *env)
+        {
+            Strings::append_to(contents, "%s=%s\n", variable.first, variable.second);
+        }
+        const fs::path tmp_file = fs::path(cache_file).replace_extension(".tmp");
+        fs.write_contents(tmp_file, contents, ec);
+        if (!ec) fs.rename(tmp_file, cache_file, ec);
+
+        return captured.emplace(key_hash, std::move(*env)).first->second;
+    }
+
     static BinaryParagraph create_binary_feature_control_file(const SourceParagraph& source_paragraph,
                                                               const FeatureParagraph& feature_paragraph,
                                                               const Triplet& triplet)
@@ -291,20 +547,18 @@ namespace vcpkg::Build
     {
         const Triplet& triplet = config.triplet;
 
-        const std::vector<std::string> dep_strings =
-            Util::fmap_flatten(config.feature_list, [&](std::string const& feature) -> std::vector<std::string> {
+        auto dep_fspecs =
+            Util::fmap_flatten(config.feature_list, [&](std::string const& feature) -> std::vector<FeatureSpec> {
                 if (feature == "core")
                 {
-                    return filter_dependencies(config.scf.core_paragraph->depends, triplet);
+                    return filter_dependencies_to_specs(config.scf.core_paragraph->depends, triplet);
                 }
 
                 auto maybe_feature = config.scf.find_feature(feature);
                 Checks::check_exit(VCPKG_LINE_INFO, maybe_feature.has_value());
 
-                return filter_dependencies(maybe_feature.get()->depends, triplet);
+                return filter_dependencies_to_specs(maybe_feature.get()->depends, triplet);
             });
-
-        auto dep_fspecs = FeatureSpec::from_strings_and_triplet(dep_strings, triplet);
         Util::sort_unique_erase(dep_fspecs);
 
         // expand defaults
@@ -337,12 +591,491 @@ namespace vcpkg::Build
         return ret;
     }
 
+    void prefetch_build_tools(const VcpkgPaths& paths)
+    {
+        std::vector<std::string> tools = {Tools::CMAKE, Tools::GIT};
+#if !defined(_WIN32)
+        tools.push_back(Tools::NINJA);
+#endif
+        paths.prefetch_tools(std::move(tools));
+    }
+
+    std::unique_ptr<Files::FileLock> lock_package_dir(const VcpkgPaths& paths, const PackageSpec& spec)
+    {
+        return lock_vcpkg_dir(paths, "packages-" + spec.dir());
+    }
+
+    namespace
+    {
+        struct SharedSourcesState
+        {
+            std::set<std::string> ports;
+            fs::path dir;
+        };
+    }
+
+    static Util::LockGuarded<SharedSourcesState> g_shared_sources;
+
+    /// <summary>Shared source caches are buildtrees/.sources-<key>, each locked by the process that uses it.</summary>
+    static constexpr StringLiteral SHARED_SOURCES_PREFIX = ".sources-";
+
+    SharedSources::SharedSources(const VcpkgPaths& paths, std::set<std::string> ports) : m_paths(paths)
+    {
+        auto& fs = paths.get_filesystem();
+        if (ports.empty() || System::get_environment_variable("VCPKG_SOURCE_CACHE").has_value()) return;
+
+        // Left behind by a vcpkg that exited without cleaning up
+        for (auto&& dir : fs.get_files_non_recursive(paths.buildtrees))
+        {
+            const std::string name = dir.filename().u8string();
+            if (name.compare(0, SHARED_SOURCES_PREFIX.size(), SHARED_SOURCES_PREFIX.c_str()) != 0) continue;
+            const auto stale_lock = try_lock_vcpkg_dir(paths, "sources-" + name.substr(SHARED_SOURCES_PREFIX.size()));
+            if (stale_lock) Files::remove_all_in_background(fs, dir, paths.buildtrees);
+        }
+
+        std::random_device random;
+        const std::string key = Strings::format("%08x", random());
+        m_lock = lock_vcpkg_dir(paths, "sources-" + key);
+        m_dir = paths.buildtrees / (SHARED_SOURCES_PREFIX.c_str() + key);
+
+        auto state = g_shared_sources.lock();
+        state->ports = std::move(ports);
+        state->dir = m_dir;
+    }
+
+    SharedSources::~SharedSources()
+    {
+        if (m_dir.empty()) return;
+
+        *g_shared_sources.lock() = SharedSourcesState();
+        Files::remove_all_in_background(m_paths.get_filesystem(), m_dir, m_paths.buildtrees);
+    }
+
+    static Optional<fs::path> get_shared_sources_dir(const std::string& port)
+    {
+        auto state = g_shared_sources.lock();
+        if (!Util::Sets::contains(state->ports, port)) return nullopt;
+        return state->dir;
+    }
+
+    /// <summary>
+    /// The largest buildtree, set by VCPKG_BUILDTREES_MAX_SIZE, that a port may leave in a VCPKG_BUILDTREES override.
+    /// Such overrides are often RAM disks, which the few very large ports would fill.
+    /// </summary>
+    static Optional<uint64_t> get_buildtrees_max_size()
+    {
+        const auto maybe_max_size = System::get_environment_variable("VCPKG_BUILDTREES_MAX_SIZE");
+        const auto p_max_size = maybe_max_size.get();
+        if (!p_max_size) return nullopt;
+
+        const auto maybe_size = parse_cache_size(*p_max_size);
+        if (const auto p_size = maybe_size.get()) return *p_size;
+        System::println(System::Color::warning, "Ignoring VCPKG_BUILDTREES_MAX_SIZE: %s", maybe_size.error());
+        return nullopt;
+    }
+
+    /// <summary>How long port builds may run, from VCPKG_BUILD_TIMEOUT</summary>
+    struct BuildTimeouts
+    {
+        Optional<std::chrono::milliseconds> all_ports;
+        std::unordered_map<std::string, std::chrono::milliseconds> ports;
+        /// <summary>Multiple of the last recorded build time that a port may take; 0 when not predicting.</summary>
+        double history_factor = 0.0;
+        BuildHistory::Durations history;
+    };
+
+    static constexpr double DEFAULT_HISTORY_FACTOR = 3.0;
+    // Predicted from a short build, a timeout would also stop the same build slowed down by a cold compiler cache
+    static constexpr std::chrono::minutes MIN_PREDICTED_BUILD_TIMEOUT{15};
+
+    /// <summary>A positive number of seconds, minutes or hours, such as 90m</summary>
+    static Optional<std::chrono::milliseconds> parse_build_timeout(const std::string& text)
+    {
+        char* end = nullptr;
+        const double value = std::strtod(text.c_str(), &end);
+        if (end == text.c_str() || !(value > 0.0)) return nullopt;
+
+        const std::string unit = end;
+        double seconds = value;
+        if (unit == "m")
+            seconds *= 60;
+        else if (unit == "h")
+            seconds *= 3600;
+        else if (unit != "s")
+            return nullopt;
+        return std::chrono::milliseconds(static_cast<long long>(seconds * 1000));
+    }
+
+    static BuildTimeouts load_build_timeouts(const VcpkgPaths& paths)
+    {
+        BuildTimeouts timeouts;
+        const auto maybe_value = System::get_environment_variable("VCPKG_BUILD_TIMEOUT");
+        const auto p_value = maybe_value.get();
+        if (!p_value) return timeouts;
+
+        // Entries are "<duration>" for every port, "<port>=<duration>" for one, and "auto" or "auto=<factor>"
+        for (auto&& entry : Strings::split(*p_value, ","))
+        {
+            const auto equals = entry.find('=');
+            const std::string name = equals == std::string::npos ? std::string() : entry.substr(0, equals);
+            const std::string value = equals == std::string::npos ? entry : entry.substr(equals + 1);
+            if (entry == "auto" || name == "auto")
+            {
+                char* end = nullptr;
+                const double factor = name.empty() ? DEFAULT_HISTORY_FACTOR : std::strtod(value.c_str(), &end);
+                if (factor > 0.0 && (!end || (end != value.c_str() && *end == '\0')))
+                {
+                    timeouts.history_factor = factor;
+                    continue;
+                }
+            }
+            else
+            {
+                const auto maybe_timeout = parse_build_timeout(value);
+                if (const auto p_timeout = maybe_timeout.get())
+                {
+                    if (name.empty())
+                        timeouts.all_ports = *p_timeout;
+                    else
+                        timeouts.ports[name] = *p_timeout;
+                    continue;
+                }
+            }
+
+            System::println(System::Color::warning,
+                            "Ignoring %s in VCPKG_BUILD_TIMEOUT: expected a duration such as 90m, <port>=<duration> "
+                            "or auto=<factor>",
+                            entry);
+        }
+
+        if (timeouts.history_factor > 0.0) timeouts.history = BuildHistory::load_durations(paths);
+        return timeouts;
+    }
+
+    /// <summary>
+    /// How long the build of `spec` may run: the timeout given for its port, else a multiple of its last recorded
+    /// build time when predicting, else the timeout given for every port.
+    /// </summary>
+    static Optional<std::chrono::milliseconds> get_build_timeout(const VcpkgPaths& paths, const PackageSpec& spec)
+    {
+        static const BuildTimeouts timeouts = load_build_timeouts(paths);
+
+        const auto it_port = timeouts.ports.find(spec.name());
+        if (it_port != timeouts.ports.end()) return it_port->second;
+
+        const auto it_history = timeouts.history.find(spec);
+        if (it_history != timeouts.history.end())
+        {
+            const auto predicted = std::chrono::milliseconds(
+                static_cast<long long>(it_history->second.count() / 1000 * timeouts.history_factor));
+            return std::max<std::chrono::milliseconds>(predicted, MIN_PREDICTED_BUILD_TIMEOUT);
+        }
+
+        return timeouts.all_ports;
+    }
+
+    /// <summary>The ports whose buildtree outgrew VCPKG_BUILDTREES_MAX_SIZE, one name per line</summary>
+    static fs::path get_large_buildtrees_path(const VcpkgPaths& paths) { return paths.vcpkg_dir / "large-buildtrees"; }
+
+    /// <summary>
+    /// Where the buildtree of `port` goes: the VCPKG_BUILDTREES override, unless the port outgrew it before and is
+    /// built in the buildtrees directory of the root instead.
+    /// </summary>
+    static fs::path get_buildtrees_root(const VcpkgPaths& paths, const std::string& port)
+    {
+        const fs::path disk_buildtrees = paths.root / "buildtrees";
+        if (paths.buildtrees == disk_buildtrees) return paths.buildtrees;
+
+        const auto maybe_lines = paths.get_filesystem().read_lines(get_large_buildtrees_path(paths));
+        if (const auto lines = maybe_lines.get())
+        {
+            if (Util::find(*lines, port) != lines->end()) return disk_buildtrees;
+        }
+        return paths.buildtrees;
+    }
+
+    /// <summary>
+    /// Records the port of `buildtree` as too large for the VCPKG_BUILDTREES override if it is, so that its later
+    /// builds go to the root. Returns true if it was recorded.
+    /// </summary>
+    static bool record_large_buildtree(const VcpkgPaths& paths, const PackageSpec& spec, const fs::path& buildtree)
+    {
+        if (buildtree.parent_path() != paths.buildtrees || paths.buildtrees == paths.root / "buildtrees") return false;
+
+        const auto maybe_max_size = get_buildtrees_max_size();
+        const auto p_max_size = maybe_max_size.get();
+        if (!p_max_size) return false;
+
+        auto& fs = paths.get_filesystem();
+        uint64_t size = 0;
+        for (auto&& entry : fs.get_entries_recursive(buildtree))
+        {
+            size += entry.size;
+        }
+        if (size <= *p_max_size) return false;
+
+        std::error_code ec;
+        fs.append_contents(get_large_buildtrees_path(paths), spec.name() + "\n", ec);
+        System::println("The buildtree of %s takes %s MiB, more than VCPKG_BUILDTREES_MAX_SIZE; it will be built in %s "
+                        "from now on",
+                        spec.name(),
+                        std::to_string(size >> 20),
+                        (paths.root / "buildtrees").u8string());
+        return !ec;
+    }
+
+    /// <summary>
+    /// The directories one build of a package writes to. A build uses buildtrees/<port> and packages/<port>_<triplet>
+    /// when no other build holds them; otherwise it gets directories of its own, named after its ABI tag, and the
+    /// package directory is moved into place once the build succeeds. Variants of a package can then be built at the
+    /// same time, in one plan or in several vcpkg processes.
+    /// </summary>
+    struct BuildDirs
+    {
+        static BuildDirs acquire(const VcpkgPaths& paths, const PackageSpec& spec, const std::string& abi_tag)
+        {
+            // Builds without an ABI tag could be anything, so they never share a directory of their own
+            std::string key = abi_tag.substr(0, 16);
+            if (key.empty())
+            {
+                std::random_device random;
+                key = Strings::format("%08x", random());
+            }
+
+            const fs::path buildtrees_root = get_buildtrees_root(paths, spec.name());
+            BuildDirs dirs;
+            dirs.buildtrees = buildtrees_root / spec.name();
+            dirs.buildtrees_lock = try_lock_vcpkg_dir(paths, "buildtrees-" + spec.name());
+            if (!dirs.buildtrees_lock)
+            {
+                const std::string name = spec.name() + "." + key;
+                dirs.buildtrees = buildtrees_root / name;
+                dirs.buildtrees_lock = lock_vcpkg_dir(paths, "buildtrees-" + name);
+            }
+
+            dirs.packages = paths.package_dir(spec);
+            dirs.packages_lock = try_lock_vcpkg_dir(paths, "packages-" + spec.dir());
+            if (!dirs.packages_lock)
+            {
+                const std::string name = spec.dir() + "." + key;
+                dirs.packages = paths.packages / name;
+                dirs.staging_lock = lock_vcpkg_dir(paths, "packages-" + name);
+            }
+
+            return dirs;
+        }
+
+        bool is_staged() const { return staging_lock != nullptr; }
+
+        /// <summary>Replaces packages/<port>_<triplet> with the staged package directory.</summary>
+        void publish(const VcpkgPaths& paths, const PackageSpec& spec)
+        {
+            if (!is_staged()) return;
+
+            auto& fs = paths.get_filesystem();
+            packages_lock = lock_package_dir(paths, spec);
+            const fs::path package_dir = paths.package_dir(spec);
+            std::error_code ec;
+            Files::remove_all_in_background(fs, package_dir, paths.packages);
+            fs.rename(packages, package_dir, ec);
+            Checks::check_exit(
+                VCPKG_LINE_INFO, !ec, "Failed to move %s into place: %s", packages.u8string(), ec.message());
+            packages = package_dir;
+            staging_lock.reset();
+        }
+
+        /// <summary>Removes the staged package directory of a build that failed.</summary>
+        void discard(const VcpkgPaths& paths)
+        {
+            if (!is_staged()) return;
+
+            Files::remove_all_in_background(paths.get_filesystem(), packages, paths.packages);
+            staging_lock.reset();
+        }
+
+        fs::path buildtrees;
+        fs::path packages;
+        std::unique_ptr<Files::FileLock> buildtrees_lock;
+        std::unique_ptr<Files::FileLock> packages_lock;
+        std::unique_ptr<Files::FileLock> staging_lock;
+    };
+
+    /// <summary>
+    /// Reads the log that ccache writes to CCACHE_STATSLOG: a "# <source file>" line for each compilation, followed by
+    /// the names of the counters it updated.
+    /// </summary>
+    static Optional<CompilerCacheStats> read_compiler_cache_log(const Files::Filesystem& fs, const fs::path& log_path)
+    {
+        auto maybe_lines = fs.read_lines(log_path);
+        auto p_lines = maybe_lines.get();
+        if (!p_lines) return nullopt;
+
+        CompilerCacheStats stats;
+        for (auto&& line : *p_lines)
+        {
+            if (line == "direct_cache_hit" || line == "preprocessed_cache_hit")
+                ++stats.hits;
+            else if (line == "cache_miss")
+                ++stats.misses;
+        }
+        return stats;
+    }
+
+    static fs::path get_compiler_cache_log_path(const BuildDirs& dirs, const Triplet& triplet)
+    {
+        return dirs.buildtrees / (triplet.canonical_name() + ".compiler-cache.log");
+    }
+
+    // Lines printed from each log that a failed build names
+    static constexpr size_t FAILED_LOG_TAIL_LINES = 40;
+    // Lines of the build output kept to find the logs named by its error message
+    static constexpr size_t BUILD_OUTPUT_TAIL_LINES = 20;
+    // Longer lines are split, so that output without line breaks is bounded as well
+    static constexpr size_t MAX_OUTPUT_LINE_LENGTH = 4096;
+
+    // Builds of several packages print concurrently; each line reaches the console whole
+    static std::mutex g_build_output_mutex;
+
+    /// <summary>
+    /// Splits the output of a build into lines as it arrives and keeps only the last few of them, so memory stays
+    /// bounded however much the build prints.
+    /// </summary>
+    struct OutputTail
+    {
+        explicit OutputTail(size_t max_lines) : m_lines(max_lines) {}
+
+        /// <summary>Calls on_line with every line that `data` completes, without its line break.</summary>
+        template<class F>
+        void append(std::string_view data, F on_line)
+        {
+            for (const char ch : data)
+            {
+                if (ch != '\n')
+                {
+                    m_partial.push_back(ch);
+                    if (m_partial.size() < MAX_OUTPUT_LINE_LENGTH) continue;
+                }
+                end_line(on_line);
+            }
+        }
+
+        /// <summary>Passes on the last line when the output did not end with a line break.</summary>
+        template<class F>
+        void finish(F on_line)
+        {
+            if (!m_partial.empty()) end_line(on_line);
+        }
+
+        /// <summary>The lines kept, oldest first.</summary>
+        std::vector<std::string> lines() const
+        {
+            std::vector<std::string> result;
+            for (size_t i = m_lines.size() - m_count; i < m_lines.size(); ++i)
+            {
+                result.push_back(m_lines[(m_next + i) % m_lines.size()]);
+            }
+            return result;
+        }
+
+    private:
+        template<class F>
+        void end_line(F on_line)
+        {
+            if (!m_partial.empty() && m_partial.back() == '\r') m_partial.pop_back();
+            on_line(m_partial);
+            m_lines[m_next].swap(m_partial);
+            m_partial.clear();
+            m_next = (m_next + 1) % m_lines.size();
+            m_count = std::min(m_count + 1, m_lines.size());
+        }
+
+        std::vector<std::string> m_lines;
+        size_t m_next = 0;
+        size_t m_count = 0;
+        std::string m_partial;
+    };
+
+    /// <summary>
+    /// Finds the logs listed after "See logs for more information:" by vcpkg_execute_required_process. When the
+    /// failure came from elsewhere, falls back to the newest log in the buildtrees directory.
+    /// </summary>
+    static std::vector<fs::path> find_failed_build_logs(const Files::Filesystem& fs,
+                                                        const std::vector<std::string>& output,
+                                                        const fs::path& buildtrees)
+    {
+        std::vector<fs::path> logs;
+        const auto marker = std::find_if(output.rbegin(), output.rend(), [](const std::string& line) {
+            return line.find("See logs for more information:") != std::string::npos;
+        });
+        for (auto it = marker.base(); marker != output.rend() && it != output.end(); ++it)
+        {
+            auto log = Strings::trim(std::string(*it));
+            if (!Strings::ends_with(log, ".log")) break;
+            if (fs.is_regular_file(fs::u8path(log))) logs.push_back(fs::u8path(log));
+        }
+        if (!logs.empty()) return logs;
+
+        Optional<fs::stdfs::file_time_type> newest_time;
+        for (auto&& file : fs.get_files_non_recursive(buildtrees))
+        {
+            if (file.extension() != ".log") continue;
+            std::error_code ec;
+            const auto time = fs::stdfs::last_write_time(file, ec);
+            if (ec || (newest_time.has_value() && time <= *newest_time.get())) continue;
+            newest_time = time;
+            logs.assign({file});
+        }
+        return logs;
+    }
+
+    /// <summary>
+    /// Prints the last lines of the logs of a failed build, read backwards from a mapping so that the size of the
+    /// logs does not matter.
+    /// </summary>
+    static void print_failed_build_logs(const Files::Filesystem& fs,
+                                        const std::string& output_prefix,
+                                        const std::vector<fs::path>& logs)
+    {
+        for (auto&& log : logs)
+        {
+            auto maybe_file = fs.map_contents(log);
+            auto p_file = maybe_file.get();
+            if (!p_file) continue;
+
+            const std::string_view contents = (*p_file)->contents();
+            size_t end = contents.size();
+            while (end != 0 && (contents[end - 1] == '\n' || contents[end - 1] == '\r'))
+                --end;
+            if (end == 0) continue;
+
+            size_t begin = end;
+            size_t line_count = 0;
+            while (begin != 0 && (contents[begin - 1] != '\n' || ++line_count < FAILED_LOG_TAIL_LINES))
+                --begin;
+
+            std::string text = Strings::format("%sLast lines of %s:\n", output_prefix, log.u8string());
+            for (auto&& line : Strings::split(std::string(contents.substr(begin, end - begin)), "\n"))
+            {
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                text.append(output_prefix).append("    ").append(line).push_back('\n');
+            }
+
+            std::lock_guard<std::mutex> lock(g_build_output_mutex);
+            System::print(System::Color::error, text);
+        }
+    }
+
     static ExtendedBuildResult do_build_package(const VcpkgPaths& paths,
                                                 const PreBuildInfo& pre_build_info,
                                                 const PackageSpec& spec,
                                                 const std::string& abi_tag,
-                                                const BuildPackageConfig& config)
+                                                const BuildPackageConfig& config,
+                                                BuildDirs& dirs,
+                                                PhaseTimings& timings,
+                                                uint64_t& peak_memory_kib)
     {
+        Trace::Scope trace("build", spec.to_string());
+
         auto& fs = paths.get_filesystem();
         const Triplet& triplet = spec.triplet();
 
@@ -358,104 +1091,499 @@ namespace vcpkg::Build
         std::string all_features;
         for (auto& feature : config.scf.feature_paragraphs)
         {
-            all_features.append(feature->name + ";");
+            all_features.append(feature->name + ";");
+        }
+
+        const Toolset& toolset = paths.get_toolset(pre_build_info);
+        std::vector<System::CMakeVariable> variables{
+            {"CMD", "BUILD"},
+            {"PORT", config.scf.core_paragraph->name},
+            {"CURRENT_PORT_DIR", config.port_dir},
+            {"CURRENT_BUILDTREES_DIR", dirs.buildtrees},
+            {"CURRENT_PACKAGES_DIR", dirs.packages},
+            {"TARGET_TRIPLET", spec.triplet().canonical_name()},
+            {"VCPKG_PLATFORM_TOOLSET", toolset.version.c_str()},
+            {"VCPKG_USE_HEAD_VERSION", Util::Enum::to_bool(config.build_package_options.use_head_version) ? "1" : "0"},
+            {"DOWNLOADS", paths.downloads},
+            {"_VCPKG_NO_DOWNLOADS", !Util::Enum::to_bool(config.build_package_options.allow_downloads) ? "1" : "0"},
+            {"_VCPKG_DOWNLOAD_TOOL", to_string(config.build_package_options.download_tool)},
+            {"GIT", git_exe_path},
+            {"FEATURES", Strings::join(";", config.feature_list)},
+            {"ALL_FEATURES", all_features},
+        };
+        if (auto p_concurrency = config.concurrency.get())
+        {
+            variables.emplace_back("VCPKG_CONCURRENCY", std::to_string(*p_concurrency));
+        }
+        if (GlobalState::g_release_only)
+        {
+            variables.emplace_back("_VCPKG_RELEASE_ONLY", "1");
+        }
+        if (System::get_environment_variable("VCPKG_PARALLEL_CONFIGURATIONS").has_value())
+        {
+            variables.emplace_back("_VCPKG_PARALLEL_CONFIGURATIONS", "1");
+        }
+        if (Util::Enum::to_bool(config.build_package_options.incremental))
+        {
+            variables.emplace_back("_VCPKG_INCREMENTAL", "1");
+        }
+        // The build environment is cleaned on Windows, so the asset sources reach vcpkg_download_distfile this way.
+        // The download index comes first; the script only reads it, since it cannot hard link files into it.
+        std::string asset_sources = Downloads::download_index().u8string();
+        const auto maybe_asset_sources = System::get_environment_variable("VCPKG_ASSET_SOURCES");
+        if (auto p_asset_sources = maybe_asset_sources.get())
+        {
+            if (!asset_sources.empty()) asset_sources.push_back(';');
+            asset_sources += *p_asset_sources;
+        }
+        if (!asset_sources.empty())
+        {
+            variables.emplace_back("_VCPKG_ASSET_SOURCES", asset_sources);
+        }
+        const auto maybe_source_cache = System::get_environment_variable("VCPKG_SOURCE_CACHE");
+        const auto maybe_shared_sources = get_shared_sources_dir(spec.name());
+        if (auto p_source_cache = maybe_source_cache.get())
+        {
+            variables.emplace_back("_VCPKG_SOURCE_CACHE", *p_source_cache);
+        }
+        else if (auto p_shared_sources = maybe_shared_sources.get())
+        {
+            variables.emplace_back("_VCPKG_SOURCE_CACHE", p_shared_sources->u8string());
+        }
+
+        // Object files only carry over between builds of the same triplet ABI, so each one gets its own cache
+        const auto maybe_compiler_launcher = System::get_environment_variable("VCPKG_COMPILER_CACHE");
+        if (auto p_compiler_launcher = maybe_compiler_launcher.get())
+        {
+            variables.emplace_back("_VCPKG_COMPILER_LAUNCHER", *p_compiler_launcher);
+
+            const auto maybe_cache_dir = System::get_environment_variable("VCPKG_COMPILER_CACHE_DIR");
+            if (auto p_cache_dir = maybe_cache_dir.get())
+            {
+                const std::string triplet_key = Strings::format(
+                    "%s-%s",
+                    triplet.canonical_name(),
+                    Hash::get_string_hash(pre_build_info.triplet_abi_tag, "SHA1").substr(0, 16));
+                variables.emplace_back("_VCPKG_COMPILER_CACHE_DIR", fs::u8path(*p_cache_dir) / triplet_key);
+            }
+
+            std::error_code ec;
+            const fs::path compiler_cache_log = get_compiler_cache_log_path(dirs, triplet);
+            fs.remove(compiler_cache_log, ec);
+            variables.emplace_back("_VCPKG_COMPILER_CACHE_LOG", compiler_cache_log);
+        }
+
+        // vcpkg_download_distfile lists the files the port asks for, so that x-downloads-gc knows they are in use
+        const fs::path used_downloads_log = DownloadReferences::get_used_downloads_log(dirs.buildtrees, spec);
+        {
+            std::error_code ec;
+            fs.remove(used_downloads_log, ec);
+            variables.emplace_back("_VCPKG_DOWNLOADS_USED", used_downloads_log);
+        }
+
+        const std::string cmd_launch_cmake = System::make_cmake_cmd(cmake_exe_path, paths.ports_cmake, variables);
+
+        // vcvarsall is run once and its environment reused; only when that fails does each build run it again
+        auto maybe_build_env = get_build_env(paths, pre_build_info, toolset);
+        std::string command;
+        if (!maybe_build_env.has_value())
+        {
+            command = make_build_env_cmd(pre_build_info, toolset);
+#ifdef _WIN32
+            command.append(" & ");
+#else
+            command.append(" && ");
+#endif
+        }
+        command.append(cmd_launch_cmake);
+        const auto timer = Chrono::ElapsedTimer::create_started();
+
+        // Only the last lines are kept; the full output is in the logs in buildtrees
+        const std::string output_prefix = config.prefix_output ? spec.to_string() + ": " : std::string();
+        OutputTail output_tail(BUILD_OUTPUT_TAIL_LINES);
+        const auto print_line = [&](const std::string& line) {
+            std::lock_guard<std::mutex> lock(g_build_output_mutex);
+            System::println(output_prefix + line);
+        };
+        const auto timeout = get_build_timeout(paths, spec);
+        std::promise<System::ProcessExit> exited;
+        auto build_exit = exited.get_future();
+        System::cmd_execute_clean_async(command,
+                                        maybe_build_env.value_or(std::unordered_map<std::string, std::string>()),
+                                        [&](std::string_view data) { output_tail.append(data, print_line); },
+                                        [&](const System::ProcessExit& exit) { exited.set_value(exit); },
+                                        timeout);
+        const System::ProcessExit build_result = build_exit.get();
+        const int return_code = build_result.exit_code;
+        peak_memory_kib = build_result.peak_memory_kib;
+        output_tail.finish(print_line);
+        const auto buildtimeus = timer.microseconds();
+        timings.add(BuildPhase::BUILD, timer.elapsed());
+        const auto spec_string = spec.to_string();
+
+        // Even a failed build has downloaded what it asked for
+        DownloadReferences::record(paths, spec, config.port_dir, abi_tag, used_downloads_log);
+
+        if (return_code != 0)
+        {
+            print_failed_build_logs(fs, output_prefix, find_failed_build_logs(fs, output_tail.lines(), dirs.buildtrees));
+        }
+
+        {
+            auto locked_metrics = Metrics::g_metrics.lock();
+            locked_metrics->track_buildtime(spec.to_string() + ":[" + Strings::join(",", config.feature_list) + "]",
+                                            buildtimeus);
+            if (build_result.timed_out)
+            {
+                locked_metrics->track_property("error", "build timed out");
+                locked_metrics->track_property("build_error", spec_string);
+            }
+            else if (return_code != 0)
+            {
+                locked_metrics->track_property("error", "build failed");
+                locked_metrics->track_property("build_error", spec_string);
+            }
+        }
+
+        if (build_result.timed_out)
+        {
+            // Only stopped, not failed: no tombstone is stored, so the next run builds it again
+            System::println(System::Color::error,
+                            "Error: Building %s did not finish within %g minutes and was stopped with its processes",
+                            spec_string,
+                            timeout.value_or_exit(VCPKG_LINE_INFO).count() / 60000.0);
+            dirs.discard(paths);
+            return BuildResult::TIMED_OUT;
+        }
+        if (return_code != 0)
+        {
+            dirs.discard(paths);
+            return BuildResult::BUILD_FAILED;
+        }
+
+        dirs.publish(paths, spec);
+
+        const BuildInfo build_info = read_build_info(fs, paths.build_info_file_path(spec));
+        const auto lint_timer = Chrono::ElapsedTimer::create_started();
+        const size_t error_count = PostBuildLint::perform_all_checks(spec, paths, pre_build_info, build_info);
+        timings.add(BuildPhase::POST_BUILD_CHECKS, lint_timer.elapsed());
+
+        auto bcf = create_binary_control_file(*config.scf.core_paragraph, triplet, build_info, abi_tag);
+
+        if (error_count != 0)
+        {
+            return BuildResult::POST_BUILD_CHECKS_FAILED;
+        }
+        for (auto&& feature : config.feature_list)
+        {
+            for (auto&& f_pgh : config.scf.feature_paragraphs)
+            {
+                if (f_pgh->name == feature)
+                    bcf->features.push_back(
+                        create_binary_feature_control_file(*config.scf.core_paragraph, *f_pgh, triplet));
+            }
+        }
+
+        write_binary_control_file(paths, *bcf);
+        return {BuildResult::SUCCEEDED, std::move(bcf)};
+    }
+
+    static ExtendedBuildResult do_build_package_and_clean_buildtrees(const VcpkgPaths& paths,
+                                                                     const PreBuildInfo& pre_build_info,
+                                                                     const PackageSpec& spec,
+                                                                     const std::string& abi_tag,
+                                                                     const BuildPackageConfig& config,
+                                                                     PhaseTimings& timings)
+    {
+        BuildDirs dirs = BuildDirs::acquire(paths, spec, abi_tag);
+        uint64_t peak_memory_kib = 0;
+        auto result = do_build_package(paths, pre_build_info, spec, abi_tag, config, dirs, timings, peak_memory_kib);
+        if (record_large_buildtree(paths, spec, dirs.buildtrees) && result.code == BuildResult::BUILD_FAILED)
+        {
+            // The build may have failed only because it filled the override, so it gets one more try in the root
+            Files::remove_all_in_background(paths.get_filesystem(), dirs.buildtrees, dirs.buildtrees.parent_path());
+            dirs = BuildDirs();
+            dirs = BuildDirs::acquire(paths, spec, abi_tag);
+            System::println("Building %s again in %s", spec.to_string(), dirs.buildtrees.u8string());
+            result = do_build_package(paths, pre_build_info, spec, abi_tag, config, dirs, timings, peak_memory_kib);
+        }
+        result.package_dir_lock = std::move(dirs.packages_lock);
+        result.peak_memory_kib = peak_memory_kib;
+        if (System::get_environment_variable("VCPKG_COMPILER_CACHE").has_value())
+        {
+            result.compiler_cache =
+                read_compiler_cache_log(paths.get_filesystem(), get_compiler_cache_log_path(dirs, spec.triplet()));
+        }
+
+        if (config.build_package_options.clean_buildtrees == CleanBuildtrees::YES)
+        {
+            auto& fs = paths.get_filesystem();
+            auto buildtree_files = fs.get_files_non_recursive(dirs.buildtrees);
+            for (auto&& file : buildtree_files)
+            {
+                if (fs.is_directory(file)) // Will only keep the logs
+                {
+                    Files::remove_all_in_background(fs, file, dirs.buildtrees.parent_path());
+                }
+            }
+        }
+
+        return result;
+    }
+
+    /// <summary>
+    /// Hashes `files` across several threads. Unchanged files are answered by the file hash cache, and files of the
+    /// vcpkg checkout by git when hashed as git blobs, so threads only pay off for ports with many files.
+    /// </summary>
+    static std::vector<std::string> hash_files_in_parallel(const Files::Filesystem& fs,
+                                                           const std::vector<fs::path>& files,
+                                                           const char* hash_type)
+    {
+        std::vector<std::string> hashes(files.size());
+        const size_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+        ThreadPool::parallel_for(files.size(), std::min(hardware_threads, files.size() / 8 + 1), [&](size_t i) {
+            hashes[i] = Hash::get_file_hash(fs, files[i], hash_type);
+        });
+        return hashes;
+    }
+
+    /// <summary>
+    /// The SHA1 of a `<path relative to root> <hash>` line for every file, in the given (sorted) order.
+    /// </summary>
+    static std::string hash_file_tree(const std::vector<std::string>& hashes,
+                                      const fs::path& root,
+                                      const std::vector<fs::path>& files,
+                                      const char* debug_label)
+    {
+        const size_t root_size = root.generic_u8string().size() + 1;
+
+        auto hasher = Hash::get_hasher_for(Hash::Algorithm::SHA1);
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            const std::string line = files[i].generic_u8string().substr(root_size) + " " + hashes[i] + "\n";
+            hasher->add_bytes(line.data(), line.size());
+            if (GlobalState::debugging) System::print("[DEBUG] %s|%s", debug_label, line);
+        }
+        return hasher->get_hash();
+    }
+
+    static std::string hash_file_tree(const Files::Filesystem& fs,
+                                      const fs::path& root,
+                                      const std::vector<fs::path>& files,
+                                      const char* debug_label,
+                                      const char* hash_type)
+    {
+        return hash_file_tree(hash_files_in_parallel(fs, files, hash_type), root, files, debug_label);
+    }
+
+    /// <summary>
+    /// Lowercased names of the commands `cmake_text` invokes and, if `with_includes`, of the modules it includes.
+    /// </summary>
+    static std::vector<std::string> find_cmake_commands(const std::string& cmake_text, const bool with_includes)
+    {
+        auto is_identifier = [](char ch) { return std::isalnum(static_cast<unsigned char>(ch)) || ch == '_'; };
+        auto skip_blanks = [&](size_t i) {
+            while (i < cmake_text.size() && (cmake_text[i] == ' ' || cmake_text[i] == '\t'))
+                ++i;
+            return i;
+        };
+
+        std::vector<std::string> commands;
+        for (size_t i = 0; i < cmake_text.size();)
+        {
+            if (cmake_text[i] == '#')
+            {
+                i = cmake_text.find('\n', i);
+                continue;
+            }
+            if (!is_identifier(cmake_text[i]))
+            {
+                ++i;
+                continue;
+            }
+
+            const size_t start = i;
+            while (i < cmake_text.size() && is_identifier(cmake_text[i]))
+                ++i;
+            const size_t paren = skip_blanks(i);
+            if (paren >= cmake_text.size() || cmake_text[paren] != '(') continue;
+
+            std::string command = Strings::ascii_to_lowercase(cmake_text.substr(start, i - start));
+            if (with_includes && command == "include")
+            {
+                const size_t argument = skip_blanks(paren + 1);
+                size_t end = argument;
+                while (end < cmake_text.size() && is_identifier(cmake_text[end]))
+                    ++end;
+                commands.push_back(Strings::ascii_to_lowercase(cmake_text.substr(argument, end - argument)));
+            }
+            commands.push_back(std::move(command));
+        }
+
+        Util::sort_unique_erase(commands);
+        return commands;
+    }
+
+    struct CMakeHelper
+    {
+        fs::path path;
+        std::vector<std::string> commands;
+    };
+
+    /// <summary>
+    /// The helpers in scripts/cmake, by name, with the commands each one invokes. Only the commands a helper calls count
+    /// as its references; the include() lines of vcpkg_common_functions would otherwise make it refer to every helper.
+    /// </summary>
+    static const std::map<std::string, CMakeHelper>& get_cmake_helpers(const VcpkgPaths& paths)
+    {
+        // scripts/cmake does not change during a run, so it is read once; static initialization is thread-safe
+        static const std::map<std::string, CMakeHelper> HELPERS = [&]() {
+            auto& fs = paths.get_filesystem();
+            std::map<std::string, CMakeHelper> helpers;
+            for (auto&& path : fs.get_files_non_recursive(paths.scripts / "cmake"))
+            {
+                if (path.extension() != ".cmake") continue;
+                CMakeHelper helper{path, {}};
+                const auto maybe_contents = fs.read_contents(path);
+                if (auto contents = maybe_contents.get()) helper.commands = find_cmake_commands(*contents, false);
+                helpers.emplace(Strings::ascii_to_lowercase(path.stem().u8string()), std::move(helper));
+            }
+            return helpers;
+        }();
+        return HELPERS;
+    }
+
+    /// <summary>
+    /// The scripts/cmake helpers the port's cmake files use, directly or through other helpers, sorted by path.
+    /// </summary>
+    static std::vector<fs::path> find_referenced_cmake_helpers(const VcpkgPaths& paths,
+                                                               const std::vector<fs::path>& port_files)
+    {
+        auto& fs = paths.get_filesystem();
+        const auto& helpers = get_cmake_helpers(paths);
+
+        std::vector<std::string> pending;
+        for (auto&& path : port_files)
+        {
+            if (path.extension() != ".cmake") continue;
+            const auto maybe_contents = fs.read_contents(path);
+            if (auto contents = maybe_contents.get())
+            {
+                const auto commands = find_cmake_commands(*contents, true);
+                pending.insert(pending.end(), commands.begin(), commands.end());
+            }
         }
 
-        const Toolset& toolset = paths.get_toolset(pre_build_info);
-        const std::string cmd_launch_cmake = System::make_cmake_cmd(
-            cmake_exe_path,
-            paths.ports_cmake,
-            {
-                {"CMD", "BUILD"},
-                {"PORT", config.scf.core_paragraph->name},
-                {"CURRENT_PORT_DIR", config.port_dir},
-                {"TARGET_TRIPLET", spec.triplet().canonical_name()},
-                {"VCPKG_PLATFORM_TOOLSET", toolset.version.c_str()},
-                {"VCPKG_USE_HEAD_VERSION",
-                Util::Enum::to_bool(config.build_package_options.use_head_version) ? "1" : "0"},
-                {"DOWNLOADS", paths.downloads},
-                {"_VCPKG_NO_DOWNLOADS", !Util::Enum::to_bool(config.build_package_options.allow_downloads) ? "1" : "0"},
-                {"_VCPKG_DOWNLOAD_TOOL", to_string(config.build_package_options.download_tool)},
-                {"GIT", git_exe_path},
-                {"FEATURES", Strings::join(";", config.feature_list)},
-                {"ALL_FEATURES", all_features},
-            });
-
-        auto command = make_build_env_cmd(pre_build_info, toolset);
-        if (!command.empty())
+        std::set<std::string> referenced;
+        while (!pending.empty())
         {
-#ifdef _WIN32
-            command.append(" & ");
-#else
-            command.append(" && ");
-#endif
+            const std::string name = std::move(pending.back());
+            pending.pop_back();
+            const auto it = helpers.find(name);
+            if (it == helpers.end() || !referenced.insert(name).second) continue;
+            pending.insert(pending.end(), it->second.commands.begin(), it->second.commands.end());
         }
-        command.append(cmd_launch_cmake);
-        const auto timer = Chrono::ElapsedTimer::create_started();
 
-        const int return_code = System::cmd_execute_clean(command);
-        const auto buildtimeus = timer.microseconds();
-        const auto spec_string = spec.to_string();
+        std::vector<fs::path> referenced_paths =
+            Util::fmap(referenced, [&](const std::string& name) { return helpers.at(name).path; });
+        Util::sort(referenced_paths);
+        return referenced_paths;
+    }
 
+    /// <summary>The files of the port, sorted</summary>
+    static std::vector<fs::path> get_port_files(const Files::Filesystem& fs, const fs::path& port_dir)
+    {
+        std::vector<fs::path> port_files;
+        for (auto&& entry : fs.get_entries_recursive(port_dir))
         {
-            auto locked_metrics = Metrics::g_metrics.lock();
-            locked_metrics->track_buildtime(spec.to_string() + ":[" + Strings::join(",", config.feature_list) + "]",
-                                            buildtimeus);
-            if (return_code != 0)
+            // Only symlinks need another look, to find out whether they lead to a file
+            if (entry.type == fs::file_type::regular ||
+                (entry.type == fs::file_type::symlink && fs.is_regular_file(entry.path)))
             {
-                locked_metrics->track_property("error", "build failed");
-                locked_metrics->track_property("build_error", spec_string);
-                return BuildResult::BUILD_FAILED;
+                port_files.push_back(entry.path);
             }
         }
+        Util::sort(port_files);
+        return port_files;
+    }
 
-        const BuildInfo build_info = read_build_info(fs, paths.build_info_file_path(spec));
-        const size_t error_count = PostBuildLint::perform_all_checks(spec, paths, pre_build_info, build_info);
-
-        auto bcf = create_binary_control_file(*config.scf.core_paragraph, triplet, build_info, abi_tag);
+    /// <summary>
+    /// The fields of CONTROL that reach the built package: the version, the default features, and the dependencies of
+    /// the core and of every feature. Descriptions, the maintainer and Supports are left out, so that editing them
+    /// keeps the ABI tags of the port and its dependents.
+    /// </summary>
+    static std::string hash_control_fields(const SourceControlFile& scf)
+    {
+        std::string fields;
+        const auto append_depends = [&](const std::vector<Dependency>& depends) {
+            for (auto&& dependency : depends)
+            {
+                fields.append("Build-Depends: ").append(dependency.depend.name);
+                fields.append("[").append(Strings::join(",", dependency.depend.features)).append("]");
+                fields.append(" (").append(dependency.qualifier).append(")\n");
+            }
+        };
 
-        if (error_count != 0)
+        const SourceParagraph& core = *scf.core_paragraph;
+        fields.append("Source: ").append(core.name).push_back('\n');
+        fields.append("Version: ").append(core.version).push_back('\n');
+        fields.append("Default-Features: ").append(Strings::join(",", core.default_features)).push_back('\n');
+        append_depends(core.depends);
+        for (auto&& feature : scf.feature_paragraphs)
         {
-            return BuildResult::POST_BUILD_CHECKS_FAILED;
+            fields.append("Feature: ").append(feature->name).push_back('\n');
+            append_depends(feature->depends);
         }
-        for (auto&& feature : config.feature_list)
+
+        return Hash::get_string_hash(fields, "SHA1");
+    }
+
+    /// <summary>
+    /// hash_file_tree of the port's files, with CONTROL standing for hash_control_fields of `scf`.
+    /// </summary>
+    static std::string hash_port_tree(const Files::Filesystem& fs,
+                                      const fs::path& port_dir,
+                                      const std::vector<fs::path>& port_files,
+                                      const SourceControlFile& scf)
+    {
+        auto hashes = hash_files_in_parallel(fs, port_files, Hash::GIT_BLOB);
+        const fs::path control_file = port_dir / "CONTROL";
+        for (size_t i = 0; i < port_files.size(); ++i)
         {
-            for (auto&& f_pgh : config.scf.feature_paragraphs)
-            {
-                if (f_pgh->name == feature)
-                    bcf->features.push_back(
-                        create_binary_feature_control_file(*config.scf.core_paragraph, *f_pgh, triplet));
-            }
+            if (port_files[i] == control_file) hashes[i] = hash_control_fields(scf);
         }
+        return hash_file_tree(hashes, port_dir, port_files, "port");
+    }
 
-        write_binary_control_file(paths, *bcf);
-        return {BuildResult::SUCCEEDED, std::move(bcf)};
+    std::string hash_port_files(const Files::Filesystem& fs, const fs::path& port_dir)
+    {
+        const auto port_files = get_port_files(fs, port_dir);
+        // A CONTROL file that does not parse cannot be built either; its bytes stand in for its fields
+        const auto maybe_scf = Paragraphs::try_load_port(fs, port_dir);
+        if (auto scf = maybe_scf.get()) return hash_port_tree(fs, port_dir, port_files, **scf);
+        return hash_file_tree(fs, port_dir, port_files, "port", Hash::GIT_BLOB);
     }
 
-    static ExtendedBuildResult do_build_package_and_clean_buildtrees(const VcpkgPaths& paths,
-                                                                     const PreBuildInfo& pre_build_info,
-                                                                     const PackageSpec& spec,
-                                                                     const std::string& abi_tag,
-                                                                     const BuildPackageConfig& config)
+    /// <summary>
+    /// The hash of the files in the package directory of `spec`, except CONTROL and the abi info, which describe the
+    /// inputs of the build.
+    /// </summary>
+    static std::string hash_package_output(const VcpkgPaths& paths, const PackageSpec& spec)
     {
-        auto result = do_build_package(paths, pre_build_info, spec, abi_tag, config);
+        auto& fs = paths.get_filesystem();
+        const fs::path package_dir = paths.package_dir(spec);
+        const fs::path control_file = package_dir / "CONTROL";
+        const fs::path abi_file = package_dir / "share" / spec.name() / "vcpkg_abi_info.txt";
 
-        if (config.build_package_options.clean_buildtrees == CleanBuildtrees::YES)
-        {
-            auto& fs = paths.get_filesystem();
-            const fs::path buildtrees_dir = paths.buildtrees / config.scf.core_paragraph->name;
-            auto buildtree_files = fs.get_files_non_recursive(buildtrees_dir);
-            for (auto&& file : buildtree_files)
-            {
-                if (fs.is_directory(file)) // Will only keep the logs
-                {
-                    std::error_code ec;
-                    fs.remove_all(file, ec);
-                }
-            }
-        }
+        auto files = get_port_files(fs, package_dir);
+        Util::erase_remove_if(files, [&](const fs::path& path) { return path == control_file || path == abi_file; });
+        return hash_file_tree(fs, package_dir, files, "output", "SHA1");
+    }
 
-        return result;
+    const std::string& dependency_abi(const BinaryParagraph& package)
+    {
+        if (GlobalState::g_output_abi && !package.output_abi.empty()) return package.output_abi;
+        return package.abi;
     }
 
     Optional<AbiTagAndFile> compute_abi_tag(const VcpkgPaths& paths,
@@ -465,22 +1593,30 @@ namespace vcpkg::Build
     {
         if (config.build_package_options.binary_caching == BinaryCaching::NO) return nullopt;
 
+        Trace::Scope trace("abi", config.scf.core_paragraph->name + ":" + config.triplet.canonical_name());
+
         auto& fs = paths.get_filesystem();
-        const Triplet& triplet = config.triplet;
-        const std::string& name = config.scf.core_paragraph->name;
 
         std::vector<AbiEntry> abi_tag_entries(dependency_abis.begin(), dependency_abis.end());
 
         abi_tag_entries.emplace_back(AbiEntry{"cmake", paths.get_tool_version(Tools::CMAKE)});
 
+        // Every file of the port, such as patches and helper scripts, and the shared helpers it uses. They are hashed
+        // as git blobs, so that a git checkout of vcpkg answers them from its index instead of reading every file.
+        const auto port_files = get_port_files(fs, config.port_dir);
         abi_tag_entries.emplace_back(
-            AbiEntry{"portfile", vcpkg::Hash::get_file_hash(fs, config.port_dir / "portfile.cmake", "SHA1")});
+            AbiEntry{"port_files", hash_port_tree(fs, config.port_dir, port_files, config.scf)});
+
+        const auto cmake_helpers = find_referenced_cmake_helpers(paths, port_files);
         abi_tag_entries.emplace_back(
-            AbiEntry{"control", vcpkg::Hash::get_file_hash(fs, config.port_dir / "CONTROL", "SHA1")});
+            AbiEntry{"cmake_helpers",
+                     hash_file_tree(fs, paths.scripts / "cmake", cmake_helpers, "helper", Hash::GIT_BLOB)});
 
         abi_tag_entries.emplace_back(AbiEntry{"vcpkg_fixup_cmake_targets", "1"});
 
         abi_tag_entries.emplace_back(AbiEntry{"triplet", pre_build_info.triplet_abi_tag});
+        // Already part of the triplet's hash, but spelled out so that the ABI file shows it
+        if (pre_build_info.unity_build) abi_tag_entries.emplace_back(AbiEntry{"unity_build", "1"});
 
         const std::string features = Strings::join(";", config.feature_list);
         abi_tag_entries.emplace_back(AbiEntry{"features", features});
@@ -490,8 +1626,10 @@ namespace vcpkg::Build
 
         Util::sort(abi_tag_entries);
 
-        const std::string full_abi_info =
-            Strings::join("", abi_tag_entries, [](const AbiEntry& p) { return p.key + " " + p.value + "\n"; });
+        std::string full_abi_info;
+        Strings::join_to(full_abi_info, "", abi_tag_entries, [](std::string& out, const AbiEntry& p) {
+            out.append(p.key).append(" ").append(p.value).push_back('\n');
+        });
 
         if (GlobalState::debugging)
         {
@@ -508,12 +1646,9 @@ namespace vcpkg::Build
 
         if (abi_tag_entries_missing.empty())
         {
-            std::error_code ec;
-            fs.create_directories(paths.buildtrees / name, ec);
-            const auto abi_file_path = paths.buildtrees / name / (triplet.canonical_name() + ".vcpkg_abi_info.txt");
-            fs.write_contents(abi_file_path, full_abi_info);
-
-            return AbiTagAndFile{Hash::get_file_hash(fs, abi_file_path, "SHA1"), abi_file_path};
+            // Hashed in memory: planning tags every package, and only the packages that get built need the file
+            std::string tag = Hash::get_string_hash(full_abi_info, "SHA1");
+            return AbiTagAndFile{std::move(tag), std::move(full_abi_info)};
         }
 
         System::println(
@@ -523,30 +1658,79 @@ namespace vcpkg::Build
         return nullopt;
     }
 
-    static void decompress_archive(const VcpkgPaths& paths, const PackageSpec& spec, const fs::path& archive_path)
+    static void store_archive_metadata(const BinaryCache& binary_cache,
+                                       const std::string& abi_tag,
+                                       const PackageSpec& spec,
+                                       const BinaryControlFile& bcf)
+    {
+        ArchiveMetadata metadata;
+        metadata.abi_tag = abi_tag;
+        metadata.name = spec.name();
+        metadata.version = bcf.core_paragraph.version;
+        metadata.triplet = spec.triplet().canonical_name();
+        metadata.features = Util::fmap(bcf.features, [](const BinaryParagraph& feature) { return feature.feature; });
+        binary_cache.store_metadata(std::move(metadata));
+    }
+
+    static bool decompress_archive(const VcpkgPaths& paths, const PackageSpec& spec, const CachedArchive& archive)
     {
+        Trace::Scope trace("archive", "decompress " + spec.to_string());
+
         auto& fs = paths.get_filesystem();
 
         auto pkg_path = paths.package_dir(spec);
+        Files::remove_all_in_background(fs, pkg_path, paths.packages);
         std::error_code ec;
-        fs.remove_all(pkg_path, ec);
         fs.create_directories(pkg_path, ec);
         auto files = fs.get_files_non_recursive(pkg_path);
         Checks::check_exit(VCPKG_LINE_INFO, files.empty(), "unable to clear path: %s", pkg_path.u8string());
 
-#if defined(_WIN32)
-        auto&& seven_zip_exe = paths.get_tool_exe(Tools::SEVEN_ZIP);
+        // A package being reinstalled has its previous files in the installed tree, or below the replaced files
+        // directory once its remove moved them, which may happen meanwhile. Those the archive lists with the same hash
+        // are linked instead of extracted, and installing then moves them back into place untouched. Tarballs carry no
+        // hashes, so they are always extracted in full.
+        const std::vector<fs::path> reuse_dirs = {
+            paths.installed / spec.triplet().to_string(),
+            Remove::replaced_files_dir(paths, spec) / spec.triplet().to_string(),
+        };
 
-        System::cmd_execute_clean(Strings::format(
-            R"("%s" x "%s" -o"%s" -y >nul)", seven_zip_exe.u8string(), archive_path.u8string(), pkg_path.u8string()));
-#else
-        System::cmd_execute_clean(
-            Strings::format(R"(unzip -qq "%s" "-d%s")", archive_path.u8string(), pkg_path.u8string()));
-#endif
+        ExpectedT<size_t, std::string> maybe_extracted = size_t(0);
+        if (archive.format == ArchiveFormat::ZIP)
+        {
+            maybe_extracted = Zip::extract(archive.path, pkg_path, reuse_dirs);
+        }
+        else if (archive.format == ArchiveFormat::MANIFEST)
+        {
+            maybe_extracted = paths.get_binary_cache().restore_manifest(archive.path, pkg_path, reuse_dirs);
+        }
+        else
+        {
+            const fs::path tar_path = pkg_path.u8string() + ".tar";
+            const auto& zstd_exe = paths.get_tool_exe(Tools::ZSTD);
+            const auto rc = System::cmd_execute_and_capture_output(Strings::format(
+                R"("%s" -d -q -f "%s" -o "%s")", zstd_exe.u8string(), archive.path.u8string(), tar_path.u8string()));
+            if (rc.exit_code == 0)
+                maybe_extracted = Tar::extract(tar_path, pkg_path);
+            else
+                maybe_extracted = Strings::format("zstd failed to decompress %s:\n%s", archive.path.u8string(), rc.output);
+            fs.remove(tar_path, ec);
+        }
+
+        if (!maybe_extracted.has_value())
+        {
+            System::println(System::Color::warning, "Failed to extract cached binary package: %s", maybe_extracted.error());
+            return false;
+        }
+        return true;
     }
 
-    static void compress_archive(const VcpkgPaths& paths, const PackageSpec& spec, const fs::path& tmp_archive_path)
+    static bool compress_archive(const VcpkgPaths& paths,
+                                 const PackageSpec& spec,
+                                 const ArchiveEncoding& encoding,
+                                 const fs::path& tmp_archive_path)
     {
+        Trace::Scope trace("archive", "compress " + spec.to_string());
+
         auto& fs = paths.get_filesystem();
 
         std::error_code ec;
@@ -554,22 +1738,195 @@ namespace vcpkg::Build
         fs.remove(tmp_archive_path, ec);
         Checks::check_exit(
             VCPKG_LINE_INFO, !fs.exists(tmp_archive_path), "Could not remove file: %s", tmp_archive_path.u8string());
-#if defined(_WIN32)
-        auto&& seven_zip_exe = paths.get_tool_exe(Tools::SEVEN_ZIP);
 
-        System::cmd_execute_clean(Strings::format(R"("%s" a "%s" "%s\*" >nul)",
-                                                  seven_zip_exe.u8string(),
-                                                  tmp_archive_path.u8string(),
-                                                  paths.package_dir(spec).u8string()));
-#else
-        System::cmd_execute_clean(Strings::format(
-            R"(cd '%s' && zip --quiet -r '%s' *)", paths.package_dir(spec).u8string(), tmp_archive_path.u8string()));
-#endif
+        ExpectedT<size_t, std::string> maybe_compressed = size_t(0);
+        if (encoding.format == ArchiveFormat::ZIP)
+        {
+            maybe_compressed = Zip::compress_directory(paths.package_dir(spec), tmp_archive_path);
+        }
+        else if (encoding.format == ArchiveFormat::MANIFEST)
+        {
+            maybe_compressed = paths.get_binary_cache().write_manifest(paths.package_dir(spec), tmp_archive_path);
+        }
+        else
+        {
+            const fs::path tar_path = paths.package_dir(spec).u8string() + ".tar";
+            maybe_compressed = Tar::create_from_directory(paths.package_dir(spec), tar_path);
+            if (maybe_compressed.has_value())
+            {
+                // zstd compresses on all cores with -T0; levels above 19 need --ultra
+                const auto& zstd_exe = paths.get_tool_exe(Tools::ZSTD);
+                const std::string level_option =
+                    encoding.level == 0 ? "" : Strings::format(" -%d%s", encoding.level, encoding.level > 19 ? " --ultra" : "");
+                const auto rc = System::cmd_execute_and_capture_output(Strings::format(R"("%s" -q -f -T0%s "%s" -o "%s")",
+                                                                                       zstd_exe.u8string(),
+                                                                                       level_option,
+                                                                                       tar_path.u8string(),
+                                                                                       tmp_archive_path.u8string()));
+                if (rc.exit_code != 0)
+                    maybe_compressed = Strings::format("zstd failed to compress %s:\n%s", tar_path.u8string(), rc.output);
+            }
+            fs.remove(tar_path, ec);
+        }
+
+        if (!maybe_compressed.has_value())
+        {
+            System::println(System::Color::warning, "Failed to create binary package: %s", maybe_compressed.error());
+            fs.remove(tmp_archive_path, ec);
+            return false;
+        }
+        return true;
     }
 
-    ExtendedBuildResult build_package(const VcpkgPaths& paths,
-                                      const BuildPackageConfig& config,
-                                      const StatusParagraphs& status_db)
+    /// <summary>
+    /// Compresses and stores the archives of built packages on a thread of its own, so that the next build or install
+    /// does not wait for them. Each job holds the lock on its package directory, and the lease on its build, until its
+    /// archives are stored. The jobs must be drained before vcpkg exits, after a failure as well, or the archives of
+    /// the packages built before it are lost; an exit hook waits for them on every exit through Checks.
+    /// </summary>
+    struct BackgroundArchiver
+    {
+        struct Job
+        {
+            const VcpkgPaths* paths;
+            PackageSpec spec;
+            std::string abi_tag;
+            BinaryControlFile bcf;
+            std::shared_ptr<Files::FileLock> package_dir_lock;
+            std::shared_ptr<Files::FileLock> build_lease;
+            bool remove_package_dir = false;
+        };
+
+        static BackgroundArchiver& get()
+        {
+            // Never destroyed: vcpkg waits for the jobs on its way out, but may also exit from another thread
+            static BackgroundArchiver* archiver = new BackgroundArchiver();
+            return *archiver;
+        }
+
+        void add(Job job)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::make_unique<Job>(std::move(job)));
+            ++unfinished;
+            changed.notify_all();
+        }
+
+        bool remove_package_dir_when_done(const PackageSpec& spec)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto&& job : jobs)
+            {
+                if (job->spec == spec)
+                {
+                    job->remove_package_dir = true;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void wait_all()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (unfinished == 0) return;
+            System::println("Waiting for %zu archives to be stored", unfinished);
+            changed.wait(lock, [&]() { return unfinished == 0; });
+        }
+
+    private:
+        BackgroundArchiver()
+        {
+            std::thread worker([this]() { run(); });
+            worker_id = worker.get_id();
+            worker.detach();
+            // A job that exits itself cannot be waited for
+            Checks::register_exit_hook([this]() {
+                if (std::this_thread::get_id() != worker_id) wait_all();
+            });
+        }
+
+        static void store_archives(const Job& job)
+        {
+            const VcpkgPaths& paths = *job.paths;
+            const BinaryCache& binary_cache = paths.get_binary_cache();
+            for (auto&& encoding : binary_cache.store_encodings())
+            {
+                // Next to the package directory, which the lock keeps to this job
+                const fs::path tmp_archive_path =
+                    paths.package_dir(job.spec).u8string() + archive_extension(encoding.format);
+                if (compress_archive(paths, job.spec, encoding, tmp_archive_path))
+                    binary_cache.store_archive(job.abi_tag, encoding, tmp_archive_path);
+            }
+
+            store_archive_metadata(binary_cache, job.abi_tag, job.spec, job.bcf);
+        }
+
+        void run()
+        {
+            // Nothing waits for an upload, so every other transfer goes ahead of it
+            Transfers::PriorityScope priority(Transfers::BACKGROUND);
+            while (true)
+            {
+                // The job stays queued while it runs, so that removing its package directory can still be left to it
+                Job* job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [&]() { return !jobs.empty(); });
+                    job = jobs.front().get();
+                }
+
+                store_archives(*job);
+
+                std::unique_ptr<Job> done;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+
+                if (done->remove_package_dir)
+                {
+                    const VcpkgPaths& paths = *done->paths;
+                    Files::remove_all_in_background(
+                        paths.get_filesystem(), paths.package_dir(done->spec), paths.packages);
+                }
+                done.reset();
+
+                std::lock_guard<std::mutex> lock(mutex);
+                --unfinished;
+                changed.notify_all();
+            }
+        }
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<std::unique_ptr<Job>> jobs;
+        size_t unfinished = 0;
+        std::thread::id worker_id;
+    };
+
+    bool remove_package_dir_after_archive(const PackageSpec& spec)
+    {
+        return BackgroundArchiver::get().remove_package_dir_when_done(spec);
+    }
+
+    void wait_for_archives() { BackgroundArchiver::get().wait_all(); }
+
+    bool restore_from_binary_cache(const VcpkgPaths& paths, const PackageSpec& spec, const std::string& abi_tag)
+    {
+        const auto maybe_archive = paths.get_binary_cache().fetch_archive(abi_tag);
+        const auto p_archive = maybe_archive.get();
+        if (!p_archive) return false;
+
+        System::println("Using cached binary package: %s", p_archive->path.u8string());
+        return decompress_archive(paths, spec, *p_archive);
+    }
+
+    static ExtendedBuildResult build_package_timed(const VcpkgPaths& paths,
+                                                   const BuildPackageConfig& config,
+                                                   const StatusParagraphs& status_db,
+                                                   PhaseTimings& timings)
     {
         auto& fs = paths.get_filesystem();
         const Triplet& triplet = config.triplet;
@@ -594,99 +1951,137 @@ namespace vcpkg::Build
         const PackageSpec spec =
             PackageSpec::from_name_and_triplet(config.scf.core_paragraph->name, triplet).value_or_exit(VCPKG_LINE_INFO);
 
-        std::vector<AbiEntry> dependency_abis;
+        const auto pre_build_info = PreBuildInfo::from_triplet_file(paths, triplet);
 
-        // dep_pspecs was not destroyed
-        for (auto&& pspec : dep_pspecs)
+        auto lookup_timer = Chrono::ElapsedTimer::create_started();
+        auto maybe_abi_tag_and_file = config.planned_abi;
+        if (!maybe_abi_tag_and_file.has_value())
         {
-            if (pspec == spec) continue;
-            const auto status_it = status_db.find_installed(pspec);
-            Checks::check_exit(VCPKG_LINE_INFO, status_it != status_db.end());
-            dependency_abis.emplace_back(
-                AbiEntry{status_it->get()->package.spec.name(), status_it->get()->package.abi});
-        }
+            std::vector<AbiEntry> dependency_abis;
 
-        const auto pre_build_info = PreBuildInfo::from_triplet_file(paths, triplet);
+            // dep_pspecs was not destroyed
+            for (auto&& pspec : dep_pspecs)
+            {
+                if (pspec == spec) continue;
+                const auto status_it = status_db.find_installed(pspec);
+                Checks::check_exit(VCPKG_LINE_INFO, status_it != status_db.end());
+                dependency_abis.emplace_back(
+                    AbiEntry{status_it->get()->package.spec.name(), dependency_abi(status_it->get()->package)});
+            }
 
-        auto maybe_abi_tag_and_file = compute_abi_tag(paths, config, pre_build_info, dependency_abis);
+            maybe_abi_tag_and_file = compute_abi_tag(paths, config, pre_build_info, dependency_abis);
+        }
 
         const auto abi_tag_and_file = maybe_abi_tag_and_file.get();
 
         if (config.build_package_options.binary_caching == BinaryCaching::YES && abi_tag_and_file)
         {
-            const fs::path archives_root_dir = paths.root / "archives";
-            const std::string archive_name = abi_tag_and_file->tag + ".zip";
-            const fs::path archive_subpath = fs::u8path(abi_tag_and_file->tag.substr(0, 2)) / archive_name;
-            const fs::path archive_path = archives_root_dir / archive_subpath;
-            const fs::path archive_tombstone_path = archives_root_dir / "fail" / archive_subpath;
-
-            if (fs.exists(archive_path))
+            const BinaryCache& binary_cache = paths.get_binary_cache();
+            const std::string& abi_tag = abi_tag_and_file->tag;
+
+            const auto p_prefetched_abi_tag = config.prefetched_abi_tag.get();
+            const bool was_prefetched = p_prefetched_abi_tag && *p_prefetched_abi_tag == abi_tag;
+            timings.add(BuildPhase::CACHE_LOOKUP, lookup_timer.elapsed());
+
+            // A fetch that finds nothing counts as part of the lookup
+            const auto restore_timer = Chrono::ElapsedTimer::create_started();
+            auto package_dir_lock = lock_package_dir(paths, spec);
+            bool restored = was_prefetched || restore_from_binary_cache(paths, spec, abi_tag);
+            // A process building the same package stores its archive before giving up the lease, so the package is
+            // restored from that instead of being built twice
+            std::shared_ptr<Files::FileLock> build_lease;
+            while (!restored && !(build_lease = binary_cache.try_lease_build(abi_tag)))
+            {
+                // The other build may need packages/`spec` to finish
+                package_dir_lock.reset();
+                System::println("Waiting for another vcpkg process to finish building %s", spec.to_string());
+                binary_cache.wait_for_lease(abi_tag);
+                package_dir_lock = lock_package_dir(paths, spec);
+                restored = restore_from_binary_cache(paths, spec, abi_tag);
+            }
+            timings.add(restored ? BuildPhase::RESTORE : BuildPhase::CACHE_LOOKUP, restore_timer.elapsed());
+            if (restored)
             {
-                System::println("Using cached binary package: %s", archive_path.u8string());
-
-                decompress_archive(paths, spec, archive_path);
-
                 auto maybe_bcf = Paragraphs::try_load_cached_package(paths, spec);
                 std::unique_ptr<BinaryControlFile> bcf =
                     std::make_unique<BinaryControlFile>(std::move(maybe_bcf).value_or_exit(VCPKG_LINE_INFO));
-                return {BuildResult::SUCCEEDED, std::move(bcf)};
+                // Archives downloaded from a remote arrive without metadata
+                if (!binary_cache.has_metadata(abi_tag)) store_archive_metadata(binary_cache, abi_tag, spec, *bcf);
+                ExtendedBuildResult result{BuildResult::SUCCEEDED, std::move(bcf)};
+                result.package_dir_lock = std::move(package_dir_lock);
+                result.restored = true;
+                return result;
             }
+            // The build takes the lock again, or builds elsewhere while another build holds it
+            package_dir_lock.reset();
 
-            if (fs.exists(archive_tombstone_path))
+            lookup_timer = Chrono::ElapsedTimer::create_started();
+            const auto maybe_tombstone_location = binary_cache.find_tombstone(abi_tag);
+            timings.add(BuildPhase::CACHE_LOOKUP, lookup_timer.elapsed());
+            if (auto p_tombstone_location = maybe_tombstone_location.get())
             {
                 if (config.build_package_options.fail_on_tombstone == FailOnTombstone::YES)
                 {
-                    System::println("Found failure tombstone: %s", archive_tombstone_path.u8string());
+                    System::println("Found failure tombstone for %s in %s", abi_tag, *p_tombstone_location);
                     return BuildResult::BUILD_FAILED;
                 }
                 else
                 {
-                    System::println(
-                        System::Color::warning, "Found failure tombstone: %s", archive_tombstone_path.u8string());
+                    System::println(System::Color::warning,
+                                    "Found failure tombstone for %s in %s",
+                                    abi_tag,
+                                    *p_tombstone_location);
                 }
             }
 
-            System::println("Could not locate cached archive: %s", archive_path.u8string());
+            System::println("Could not locate cached archive: %s", binary_cache.local_archive_path(abi_tag).u8string());
 
             ExtendedBuildResult result = do_build_package_and_clean_buildtrees(
-                paths, pre_build_info, spec, maybe_abi_tag_and_file.value_or(AbiTagAndFile{}).tag, config);
+                paths, pre_build_info, spec, maybe_abi_tag_and_file.value_or(AbiTagAndFile{}).tag, config, timings);
 
             std::error_code ec;
             fs.create_directories(paths.package_dir(spec) / "share" / spec.name(), ec);
             auto abi_file_in_package = paths.package_dir(spec) / "share" / spec.name() / "vcpkg_abi_info.txt";
-            fs.copy_file(abi_tag_and_file->tag_file, abi_file_in_package, fs::stdfs::copy_options::none, ec);
-            Checks::check_exit(VCPKG_LINE_INFO, !ec, "Could not copy into file: %s", abi_file_in_package.u8string());
+            fs.write_contents(abi_file_in_package, abi_tag_and_file->abi_info, ec);
+            Checks::check_exit(VCPKG_LINE_INFO, !ec, "Could not write file: %s", abi_file_in_package.u8string());
 
+            const auto archive_timer = Chrono::ElapsedTimer::create_started();
             if (result.code == BuildResult::SUCCEEDED)
             {
-                const auto tmp_archive_path = paths.buildtrees / spec.name() / (spec.triplet().to_string() + ".zip");
-
-                compress_archive(paths, spec, tmp_archive_path);
-
-                fs.create_directories(archive_path.parent_path(), ec);
-                fs.rename_or_copy(tmp_archive_path, archive_path, ".tmp", ec);
-                if (ec)
+                // Recorded in CONTROL before archiving, so that restoring the package brings it along
+                auto bcf = result.binary_control_file.get();
+                if (GlobalState::g_output_abi && bcf)
                 {
-                    System::println(System::Color::warning,
-                                    "Failed to store binary cache %s: %s",
-                                    archive_path.u8string(),
-                                    ec.message());
+                    bcf->core_paragraph.output_abi = hash_package_output(paths, spec);
+                    write_binary_control_file(paths, *bcf);
                 }
-                else
-                    System::println("Stored binary cache: %s", archive_path.u8string());
+
+                if (bcf)
+                    BackgroundArchiver::get().add({&paths, spec, abi_tag, *bcf, result.package_dir_lock, build_lease});
             }
             else if (result.code == BuildResult::BUILD_FAILED || result.code == BuildResult::POST_BUILD_CHECKS_FAILED)
             {
                 // Build failed, so store tombstone archive
-                fs.create_directories(archive_tombstone_path.parent_path(), ec);
-                fs.write_contents(archive_tombstone_path, "", ec);
+                binary_cache.store_tombstone(abi_tag);
             }
+            timings.add(BuildPhase::ARCHIVE, archive_timer.elapsed());
 
             return result;
         }
 
+        timings.add(BuildPhase::CACHE_LOOKUP, lookup_timer.elapsed());
         return do_build_package_and_clean_buildtrees(
-            paths, pre_build_info, spec, maybe_abi_tag_and_file.value_or(AbiTagAndFile{}).tag, config);
+            paths, pre_build_info, spec, maybe_abi_tag_and_file.value_or(AbiTagAndFile{}).tag, config, timings);
+    }
+
+    ExtendedBuildResult build_package(const VcpkgPaths& paths,
+                                      const BuildPackageConfig& config,
+                                      const StatusParagraphs& status_db)
+    {
+        PhaseTimings timings;
+        auto result = build_package_timed(paths, config, status_db, timings);
+        result.timings = timings;
+        return result;
     }
 
     const std::string& to_string(const BuildResult build_result)
@@ -698,6 +2093,7 @@ namespace vcpkg::Build
         static const std::string POST_BUILD_CHECKS_FAILED_STRING = "POST_BUILD_CHECKS_FAILED";
         static const std::string CASCADED_DUE_TO_MISSING_DEPENDENCIES_STRING = "CASCADED_DUE_TO_MISSING_DEPENDENCIES";
         static const std::string EXCLUDED_STRING = "EXCLUDED";
+        static const std::string TIMED_OUT_STRING = "TIMED_OUT";
 
         switch (build_result)
         {
@@ -708,10 +2104,65 @@ namespace vcpkg::Build
             case BuildResult::FILE_CONFLICTS: return FILE_CONFLICTS_STRING;
             case BuildResult::CASCADED_DUE_TO_MISSING_DEPENDENCIES: return CASCADED_DUE_TO_MISSING_DEPENDENCIES_STRING;
             case BuildResult::EXCLUDED: return EXCLUDED_STRING;
+            case BuildResult::TIMED_OUT: return TIMED_OUT_STRING;
+            default: Checks::unreachable(VCPKG_LINE_INFO);
+        }
+    }
+
+    const std::string& to_string(const BuildPhase phase)
+    {
+        static const std::string CACHE_LOOKUP_STRING = "cache lookup";
+        static const std::string RESTORE_STRING = "restore";
+        static const std::string DOWNLOAD_STRING = "download";
+        static const std::string BUILD_STRING = "build";
+        static const std::string POST_BUILD_CHECKS_STRING = "post-build checks";
+        static const std::string INSTALL_STRING = "install";
+        static const std::string ARCHIVE_STRING = "archive";
+
+        switch (phase)
+        {
+            case BuildPhase::CACHE_LOOKUP: return CACHE_LOOKUP_STRING;
+            case BuildPhase::RESTORE: return RESTORE_STRING;
+            case BuildPhase::DOWNLOAD: return DOWNLOAD_STRING;
+            case BuildPhase::BUILD: return BUILD_STRING;
+            case BuildPhase::POST_BUILD_CHECKS: return POST_BUILD_CHECKS_STRING;
+            case BuildPhase::INSTALL: return INSTALL_STRING;
+            case BuildPhase::ARCHIVE: return ARCHIVE_STRING;
             default: Checks::unreachable(VCPKG_LINE_INFO);
         }
     }
 
+    void PhaseTimings::add(const BuildPhase phase, const Chrono::ElapsedTime& time)
+    {
+        m_durations[static_cast<size_t>(phase)] += time.as<std::chrono::microseconds>();
+    }
+
+    void PhaseTimings::add(const PhaseTimings& other)
+    {
+        for (size_t i = 0; i < m_durations.size(); ++i)
+        {
+            m_durations[i] += other.m_durations[i];
+        }
+    }
+
+    std::chrono::microseconds PhaseTimings::get(const BuildPhase phase) const
+    {
+        return m_durations[static_cast<size_t>(phase)];
+    }
+
+    std::string PhaseTimings::to_string() const
+    {
+        std::vector<std::string> parts;
+        for (const BuildPhase phase : BUILD_PHASE_VALUES)
+        {
+            const auto duration = get(phase);
+            if (duration.count() == 0) continue;
+            parts.push_back(
+                Strings::format("%s: %s", Build::to_string(phase), Chrono::ElapsedTime(duration).to_string()));
+        }
+        return Strings::join(", ", parts);
+    }
+
     std::string create_error_message(const BuildResult build_result, const PackageSpec& spec)
     {
         return Strings::format("Error: Building package %s failed with: %s", spec, Build::to_string(build_result));
@@ -729,15 +2180,15 @@ namespace vcpkg::Build
                                Commands::Version::version());
     }
 
-    static BuildInfo inner_create_buildinfo(std::unordered_map<std::string, std::string> pgh)
+    static BuildInfo inner_create_buildinfo(const std::unordered_map<std::string, std::string>& pgh)
     {
-        Parse::ParagraphParser parser(std::move(pgh));
+        Parse::ParagraphParser parser(Parse::RawParagraphView::from_raw_paragraph(pgh), BuildInfoFields::TABLE);
 
         BuildInfo build_info;
 
         {
             std::string crt_linkage_as_string;
-            parser.required_field(BuildInfoRequiredField::CRT_LINKAGE, crt_linkage_as_string);
+            parser.required_field(BuildInfoFields::CRT_LINKAGE, crt_linkage_as_string);
 
             auto crtlinkage = to_linkage_type(crt_linkage_as_string);
             if (const auto p = crtlinkage.get())
@@ -748,7 +2199,7 @@ namespace vcpkg::Build
 
         {
             std::string library_linkage_as_string;
-            parser.required_field(BuildInfoRequiredField::LIBRARY_LINKAGE, library_linkage_as_string);
+            parser.required_field(BuildInfoFields::LIBRARY_LINKAGE, library_linkage_as_string);
             auto liblinkage = to_linkage_type(library_linkage_as_string);
             if (const auto p = liblinkage.get())
                 build_info.library_linkage = *p;
@@ -756,13 +2207,15 @@ namespace vcpkg::Build
                 Checks::exit_with_message(
                     VCPKG_LINE_INFO, "Invalid library linkage type: [%s]", library_linkage_as_string);
         }
-        std::string version = parser.optional_field("Version");
+        std::string version = parser.optional_field(BuildInfoFields::VERSION);
         if (!version.empty()) build_info.version = std::move(version);
 
         std::map<BuildPolicy, bool> policies;
         for (auto policy : G_ALL_POLICIES)
         {
-            const auto setting = parser.optional_field(to_string(policy));
+            const size_t field = BuildInfoFields::TABLE.index_of(to_string(policy));
+            Checks::check_exit(VCPKG_LINE_INFO, field != Parse::FieldTable::npos);
+            const auto setting = parser.optional_field(field);
             if (setting.empty()) continue;
             if (setting == "enabled")
                 policies.emplace(policy, true);
@@ -792,33 +2245,97 @@ namespace vcpkg::Build
         return inner_create_buildinfo(*pghs.get());
     }
 
-    PreBuildInfo PreBuildInfo::from_triplet_file(const VcpkgPaths& paths, const Triplet& triplet)
+    /// <summary>
+    /// Runs get_triplet_environment.cmake on the triplet file and returns the VARIABLE=VALUE lines it prints. Simple
+    /// triplets are evaluated in-process; CMake is started only for those that use more of the language.
+    /// </summary>
+    static std::vector<std::string> capture_triplet_environment(const VcpkgPaths& paths,
+                                                                const fs::path& triplet_file_path)
     {
         static constexpr CStringView FLAG_GUID = "c35112b6-d1ba-415b-aa5d-81de856ef8eb";
 
-        const fs::path& cmake_exe_path = paths.get_tool_exe(Tools::CMAKE);
+        auto& fs = paths.get_filesystem();
         const fs::path ports_cmake_script_path = paths.scripts / "get_triplet_environment.cmake";
-        const fs::path triplet_file_path = paths.triplets / (triplet.canonical_name() + ".cmake");
 
-        const auto cmd_launch_cmake = System::make_cmake_cmd(cmake_exe_path,
-                                                             ports_cmake_script_path,
-                                                             {
-                                                                 {"CMAKE_TRIPLET_FILE", triplet_file_path},
-                                                             });
-        const auto ec_data = System::cmd_execute_and_capture_output(cmd_launch_cmake);
-        Checks::check_exit(VCPKG_LINE_INFO, ec_data.exit_code == 0, ec_data.output);
+        std::vector<std::string> lines;
+        const auto maybe_script = fs.read_contents(ports_cmake_script_path);
+        const auto maybe_triplet = fs.read_contents(triplet_file_path);
+        const auto p_script = maybe_script.get();
+        const auto p_triplet = maybe_triplet.get();
+        Optional<std::vector<std::string>> maybe_lines;
+        if (p_script && p_triplet)
+        {
+            maybe_lines =
+                TripletEnvironment::try_evaluate(ports_cmake_script_path, *p_script, triplet_file_path, *p_triplet);
+        }
+
+        if (auto p_lines = maybe_lines.get())
+        {
+            lines = std::move(*p_lines);
+        }
+        else
+        {
+            Debug::println("Evaluating %s with CMake", triplet_file_path.u8string());
+            const fs::path& cmake_exe_path = paths.get_tool_exe(Tools::CMAKE);
+            const auto cmd_launch_cmake = System::make_cmake_cmd(cmake_exe_path,
+                                                                 ports_cmake_script_path,
+                                                                 {
+                                                                     {"CMAKE_TRIPLET_FILE", triplet_file_path},
+                                                                 });
+            const auto ec_data = System::cmd_execute_and_capture_output(cmd_launch_cmake);
+            Checks::check_exit(VCPKG_LINE_INFO, ec_data.exit_code == 0, ec_data.output);
+            lines = Strings::split(ec_data.output, "\n");
+        }
 
-        const std::vector<std::string> lines = Strings::split(ec_data.output, "\n");
+        const auto cur = std::find(lines.cbegin(), lines.cend(), FLAG_GUID);
+        if (cur != lines.cend()) lines.erase(lines.cbegin(), cur + 1);
+        return lines;
+    }
 
-        PreBuildInfo pre_build_info;
+    /// <summary>
+    /// Like capture_triplet_environment, but the result is kept in installed/vcpkg/triplets/ and reused for as long as
+    /// the triplet file and the capture script are unchanged.
+    /// </summary>
+    static std::vector<std::string> load_triplet_environment(const VcpkgPaths& paths,
+                                                             const Triplet& triplet,
+                                                             const fs::path& triplet_file_path)
+    {
+        auto& fs = paths.get_filesystem();
+        const fs::path cache_file = paths.vcpkg_dir / "triplets" / (triplet.canonical_name() + ".txt");
+        const std::string key =
+            Strings::format("%s %s",
+                            Hash::get_file_hash(fs, triplet_file_path, "SHA1"),
+                            Hash::get_file_hash(fs, paths.scripts / "get_triplet_environment.cmake", "SHA1"));
+
+        const auto maybe_cached = fs.read_lines(cache_file);
+        if (const auto cached = maybe_cached.get())
+        {
+            if (!cached->empty() && cached->front() == key)
+            {
+                return std::vector<std::string>(std::next(cached->begin()), cached->end());
+            }
+        }
+
+        auto lines = capture_triplet_environment(paths, triplet_file_path);
+
+        std::error_code ec;
+        fs.create_directories(cache_file.parent_path(), ec);
+        const fs::path tmp_file = fs::path(cache_file).replace_extension(".tmp");
+        fs.write_contents(tmp_file, key + '\n' + Strings::join("\n", lines) + '\n', ec);
+        if (!ec) fs.rename(tmp_file, cache_file, ec);
+
+        return lines;
+    }
 
-        const auto e = lines.cend();
-        auto cur = std::find(lines.cbegin(), e, FLAG_GUID);
-        if (cur != e) ++cur;
+    static PreBuildInfo parse_triplet_environment(const VcpkgPaths& paths,
+                                                  const fs::path& triplet_file_path,
+                                                  const std::vector<std::string>& lines)
+    {
+        PreBuildInfo pre_build_info;
 
-        for (; cur != e; ++cur)
+        for (auto&& line : lines)
         {
-            auto&& line = *cur;
+            if (line.empty()) continue;
 
             const std::vector<std::string> s = Strings::split(line, "=");
             Checks::check_exit(VCPKG_LINE_INFO,
@@ -883,18 +2400,28 @@ namespace vcpkg::Build
                 continue;
             }
 
+            if (variable_name == "VCPKG_UNITY_BUILD")
+            {
+                static constexpr StringLiteral TRUE_VALUES[] = {"1", "ON", "TRUE", "YES", "Y"};
+                static constexpr StringLiteral FALSE_VALUES[] = {"", "0", "OFF", "FALSE", "NO", "N"};
+                const auto is_one_of = [&](const auto& values) {
+                    return std::any_of(std::begin(values), std::end(values), [&](const StringLiteral& value) {
+                        return Strings::case_insensitive_ascii_equals(variable_value, value);
+                    });
+                };
+                if (is_one_of(TRUE_VALUES))
+                    pre_build_info.unity_build = true;
+                else if (!is_one_of(FALSE_VALUES))
+                    Checks::exit_with_message(
+                        VCPKG_LINE_INFO, "Unknown setting for VCPKG_UNITY_BUILD: %s", variable_value);
+                continue;
+            }
+
             Checks::exit_with_message(VCPKG_LINE_INFO, "Unknown variable name %s", line);
         }
 
         pre_build_info.triplet_abi_tag = [&]() {
             const auto& fs = paths.get_filesystem();
-            static std::map<fs::path, std::string> s_hash_cache;
-
-            auto it_hash = s_hash_cache.find(triplet_file_path);
-            if (it_hash != s_hash_cache.end())
-            {
-                return it_hash->second;
-            }
             auto hash = Hash::get_file_hash(fs, triplet_file_path, "SHA1");
 
             if (auto p = pre_build_info.external_toolchain_file.get())
@@ -923,12 +2450,37 @@ namespace vcpkg::Build
                 hash += Hash::get_file_hash(fs, paths.scripts / "toolchains" / "android.cmake", "SHA1");
             }
 
-            s_hash_cache.emplace(triplet_file_path, hash);
             return hash;
         }();
 
+        // The triplet file cannot tell these builds apart from full ones, so their tag says it instead
+        if (GlobalState::g_release_only && pre_build_info.build_type != ConfigurationType::RELEASE)
+        {
+            pre_build_info.build_type = ConfigurationType::RELEASE;
+            pre_build_info.triplet_abi_tag += "-release";
+        }
+
+        return pre_build_info;
+    }
+
+    PreBuildInfo PreBuildInfo::from_triplet_file(const VcpkgPaths& paths, const Triplet& triplet)
+    {
+        // Evaluated once per triplet and process; concurrent builds wait for the first one instead of running cmake
+        static Util::LockGuarded<std::map<std::string, PreBuildInfo>> s_pre_build_infos;
+
+        auto pre_build_infos = s_pre_build_infos.lock();
+        const auto it = pre_build_infos->find(triplet.canonical_name());
+        if (it != pre_build_infos->end()) return it->second;
+
+        Trace::Scope trace("triplet", triplet.canonical_name());
+
+        const fs::path triplet_file_path = paths.triplets / (triplet.canonical_name() + ".cmake");
+        auto pre_build_info =
+            parse_triplet_environment(paths, triplet_file_path, load_triplet_environment(paths, triplet, triplet_file_path));
+        pre_build_infos->emplace(triplet.canonical_name(), pre_build_info);
         return pre_build_info;
     }
+
     ExtendedBuildResult::ExtendedBuildResult(BuildResult code) : code(code) {}
     ExtendedBuildResult::ExtendedBuildResult(BuildResult code, std::unique_ptr<BinaryControlFile>&& bcf)
         : code(code), binary_control_file(std::move(bcf))
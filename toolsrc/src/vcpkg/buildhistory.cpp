@@ -0,0 +1,232 @@
+#include "pch.h"
+
+#include <vcpkg/base/files.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/base/util.h>
+#include <vcpkg/buildhistory.h>
+
+namespace vcpkg::BuildHistory
+{
+    // Rewritten with only the newest records once it grows past this
+    static constexpr std::uintmax_t COMPACTION_THRESHOLD = 1024 * 1024;
+
+    static fs::path get_history_path(const VcpkgPaths& paths) { return paths.vcpkg_dir / "buildhistory"; }
+
+    // Written by earlier versions, which kept only the build times
+    static fs::path get_legacy_durations_path(const VcpkgPaths& paths) { return paths.vcpkg_dir / "buildtimes"; }
+
+    static Optional<long long> parse_count(const std::string& field)
+    {
+        char* end = nullptr;
+        const long long count = std::strtoll(field.c_str(), &end, 10);
+        if (field.empty() || *end != '\0' || count < 0) return nullopt;
+        return count;
+    }
+
+    static Optional<Record> parse_record(const std::string& line)
+    {
+        // "<port> <triplet> <abi tag or -> <hit|miss> <total> <phase>,<phase>,... [<peak memory>]", with durations in
+        // microseconds, phases in the order of BUILD_PHASE_VALUES and memory in KiB. The old format is just
+        // "<port> <triplet> <total>".
+        const auto fields = Strings::split(line, " ");
+        const bool is_legacy = fields.size() == 3;
+        if (!is_legacy && fields.size() != 6 && fields.size() != 7) return nullopt;
+
+        auto maybe_spec = PackageSpec::from_name_and_triplet(fields[0], Triplet::from_canonical_name(fields[1]));
+        auto p_spec = maybe_spec.get();
+        if (!p_spec) return nullopt;
+
+        const auto maybe_total = parse_count(is_legacy ? fields[2] : fields[4]);
+        const auto p_total = maybe_total.get();
+        if (!p_total) return nullopt;
+
+        Record record{*p_spec, "", false, std::chrono::microseconds(*p_total), {}};
+        if (is_legacy) return record;
+
+        if (fields[2] != "-") record.abi_tag = fields[2];
+        if (fields[3] != "hit" && fields[3] != "miss") return nullopt;
+        record.cache_hit = fields[3] == "hit";
+
+        // Phases added later are missing from older records, and unknown ones are ignored
+        const auto phases = Strings::split(fields[5], ",");
+        for (size_t i = 0; i < phases.size() && i < Build::BUILD_PHASE_VALUES.size(); ++i)
+        {
+            const auto maybe_phase = parse_count(phases[i]);
+            const auto p_phase = maybe_phase.get();
+            if (!p_phase) return nullopt;
+            record.phases.add(Build::BUILD_PHASE_VALUES[i], Chrono::ElapsedTime(std::chrono::microseconds(*p_phase)));
+        }
+
+        if (fields.size() == 7)
+        {
+            const auto maybe_peak_memory = parse_count(fields[6]);
+            const auto p_peak_memory = maybe_peak_memory.get();
+            if (!p_peak_memory) return nullopt;
+            record.peak_memory_kib = static_cast<uint64_t>(*p_peak_memory);
+        }
+
+        return record;
+    }
+
+    static std::string format_record(const Record& record)
+    {
+        const auto phases = Strings::join(",", Build::BUILD_PHASE_VALUES, [&](const Build::BuildPhase phase) {
+            return std::to_string(record.phases.get(phase).count());
+        });
+        return Strings::format("%s %s %s %s %lld %s %llu\n",
+                               record.spec.name(),
+                               record.spec.triplet().canonical_name(),
+                               record.abi_tag.empty() ? "-" : record.abi_tag,
+                               record.cache_hit ? "hit" : "miss",
+                               static_cast<long long>(record.total.count()),
+                               phases,
+                               static_cast<unsigned long long>(record.peak_memory_kib));
+    }
+
+    std::vector<Record> load_records(const Files::Filesystem& fs, const fs::path& path)
+    {
+        std::vector<Record> records;
+
+        auto maybe_lines = fs.read_lines(path);
+        auto p_lines = maybe_lines.get();
+        if (!p_lines) return records;
+
+        for (auto&& line : *p_lines)
+        {
+            auto maybe_record = parse_record(line);
+            if (auto p_record = maybe_record.get()) records.push_back(std::move(*p_record));
+        }
+
+        return records;
+    }
+
+    static void add_durations(Durations& durations, const std::vector<Record>& records)
+    {
+        // Restores say nothing about how long a build takes
+        for (auto&& record : records)
+        {
+            if (!record.cache_hit) durations[record.spec] = record.total;
+        }
+    }
+
+    Durations load_durations(const VcpkgPaths& paths)
+    {
+        auto& fs = paths.get_filesystem();
+
+        Durations durations;
+        add_durations(durations, load_records(fs, get_legacy_durations_path(paths)));
+        add_durations(durations, load_records(fs, get_history_path(paths)));
+        return durations;
+    }
+
+    Durations load_durations(const Files::Filesystem& fs, const fs::path& path)
+    {
+        Durations durations;
+        add_durations(durations, load_records(fs, path));
+        return durations;
+    }
+
+    static void add_summaries(Summaries& summaries, const std::vector<Record>& records)
+    {
+        for (auto&& record : records)
+        {
+            Summary& summary = summaries[record.spec];
+            ++summary.installs;
+            if (record.cache_hit)
+                ++summary.cache_hits;
+            else
+                summary.build_time = record.total;
+        }
+    }
+
+    Summaries load_summaries(const VcpkgPaths& paths)
+    {
+        auto& fs = paths.get_filesystem();
+
+        Summaries summaries;
+        add_summaries(summaries, load_records(fs, get_legacy_durations_path(paths)));
+        add_summaries(summaries, load_records(fs, get_history_path(paths)));
+        return summaries;
+    }
+
+    Summaries load_summaries(const Files::Filesystem& fs, const fs::path& path)
+    {
+        Summaries summaries;
+        add_summaries(summaries, load_records(fs, path));
+        return summaries;
+    }
+
+    PeakMemory load_peak_memory(const VcpkgPaths& paths)
+    {
+        PeakMemory peak_memory;
+        for (auto&& record : load_records(paths.get_filesystem(), get_history_path(paths)))
+        {
+            if (!record.cache_hit && record.peak_memory_kib != 0) peak_memory[record.spec] = record.peak_memory_kib;
+        }
+        return peak_memory;
+    }
+
+    static void compact(Files::Filesystem& fs, const fs::path& path)
+    {
+        // Keeps the newest build and the newest restore of each package
+        auto records = load_records(fs, path);
+        std::unordered_set<PackageSpec> seen[2];
+        std::vector<const Record*> kept;
+        for (auto it = records.rbegin(); it != records.rend(); ++it)
+        {
+            if (seen[it->cache_hit].insert(it->spec).second) kept.push_back(&*it);
+        }
+        std::reverse(kept.begin(), kept.end());
+
+        std::string contents;
+        for (auto&& p_record : kept)
+        {
+            contents += format_record(*p_record);
+        }
+
+        const fs::path tmp_path = path.u8string() + ".tmp";
+        std::error_code ec;
+        fs.write_contents(tmp_path, contents, ec);
+        if (!ec) fs.rename(tmp_path, path, ec);
+        if (ec) System::println(System::Color::warning, "Failed to compact the build history: %s", ec.message());
+    }
+
+    void store_records(const VcpkgPaths& paths, const std::vector<Record>& records)
+    {
+        if (records.empty()) return;
+
+        std::string contents;
+        for (auto&& record : records)
+        {
+            contents += format_record(record);
+        }
+
+        auto& fs = paths.get_filesystem();
+        const fs::path history_path = get_history_path(paths);
+
+        std::error_code ec;
+        fs.append_contents(history_path, contents, ec);
+        if (ec)
+        {
+            System::println(System::Color::warning, "Failed to record the build history: %s", ec.message());
+            return;
+        }
+
+        const auto maybe_shared_path = System::get_environment_variable("VCPKG_BUILD_HISTORY");
+        if (auto p_shared_path = maybe_shared_path.get())
+        {
+            fs.append_contents(fs::u8path(*p_shared_path), contents, ec);
+            if (ec)
+            {
+                System::println(System::Color::warning,
+                                "Failed to record the build history in %s: %s",
+                                *p_shared_path,
+                                ec.message());
+            }
+        }
+
+        const auto size = fs::stdfs::file_size(history_path, ec);
+        if (!ec && size > COMPACTION_THRESHOLD) compact(fs, history_path);
+    }
+}
@@ -0,0 +1,199 @@
+#include "pch.h"
+
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/base/util.h>
+#include <vcpkg/cmakeindex.h>
+
+namespace vcpkg::CMakeIndex
+{
+    static fs::path get_index_dir(const VcpkgPaths& paths) { return paths.vcpkg_dir / "cmake"; }
+
+    static fs::path get_port_path(const VcpkgPaths& paths, const PackageSpec& spec)
+    {
+        return get_index_dir(paths) / spec.triplet().canonical_name() / (spec.name() + ".txt");
+    }
+
+    static constexpr StringLiteral CONFIG_SUFFIX = "Config.cmake";
+    static constexpr StringLiteral LOWERCASE_CONFIG_SUFFIX = "-config.cmake";
+
+    std::string Package::config_name() const
+    {
+        const auto filename = fs::u8path(config_file).filename().u8string();
+        if (Strings::ends_with(filename, LOWERCASE_CONFIG_SUFFIX))
+            return filename.substr(0, filename.size() - LOWERCASE_CONFIG_SUFFIX.size());
+        if (Strings::ends_with(filename, CONFIG_SUFFIX))
+            return filename.substr(0, filename.size() - CONFIG_SUFFIX.size());
+        return std::string();
+    }
+
+    std::vector<std::string> find_library_targets(const std::string& contents)
+    {
+        static constexpr Strings::AsciiSet WORD_CHARS =
+            "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+        static constexpr Strings::AsciiSet WHITESPACE = " \t\n\v\f\r";
+        static const std::string ADD_LIBRARY = "add_library(";
+
+        std::vector<std::string> targets;
+        size_t pos = 0;
+        while ((pos = contents.find(ADD_LIBRARY, pos)) != std::string::npos)
+        {
+            const bool starts_word = pos == 0 || !WORD_CHARS.contains(contents[pos - 1]);
+            const size_t name_start = pos + ADD_LIBRARY.size();
+            pos = name_start;
+            if (!starts_word) continue;
+
+            size_t name_end = name_start;
+            while (name_end < contents.size() && contents[name_end] != ')' && !WHITESPACE.contains(contents[name_end]))
+                ++name_end;
+
+            // The name has to be followed by more arguments, as in add_library(name IMPORTED)
+            if (name_end != name_start && name_end != contents.size() && WHITESPACE.contains(contents[name_end]))
+            {
+                targets.push_back(contents.substr(name_start, name_end - name_start));
+                pos = name_end;
+            }
+        }
+
+        return targets;
+    }
+
+    std::vector<Package> scan(const Files::Filesystem& fs,
+                              const fs::path& triplet_dir,
+                              const std::vector<std::string>& files)
+    {
+        std::map<std::string, Package> packages;
+        for (auto&& file : files)
+        {
+            if (!Strings::ends_with(file, ".cmake") || !Strings::case_insensitive_ascii_contains("/" + file, "/share/"))
+                continue;
+
+            const auto path = triplet_dir / fs::u8path(file);
+            const auto name = path.parent_path().filename().u8string();
+            Package& package = packages[name];
+            package.name = name;
+
+            auto maybe_contents = fs.read_contents(path);
+            if (auto p_contents = maybe_contents.get())
+            {
+                auto targets = find_library_targets(*p_contents);
+                package.targets.insert(package.targets.end(), targets.begin(), targets.end());
+            }
+
+            // Only a config file named after its directory is the one find_package(<directory name>) loads
+            Package candidate{name, file, {}};
+            if (Strings::case_insensitive_ascii_equals(candidate.config_name(), name)) package.config_file = file;
+        }
+
+        return Util::fmap(packages, [](auto&& entry) { return std::move(entry.second); });
+    }
+
+    // One line per package: "<name>\t<config file or ->\t<target> <target> ... or -"
+    static std::string serialize(const std::vector<Package>& packages)
+    {
+        std::string out;
+        for (auto&& package : packages)
+        {
+            Strings::append_to(out,
+                               "%s\t%s\t%s\n",
+                               package.name,
+                               package.config_file.empty() ? "-" : package.config_file,
+                               package.targets.empty() ? "-" : Strings::join(" ", package.targets));
+        }
+        return out;
+    }
+
+    static Optional<std::vector<Package>> deserialize(const std::vector<std::string>& lines)
+    {
+        std::vector<Package> packages;
+        for (auto&& line : lines)
+        {
+            if (line.empty()) continue;
+            const auto fields = Strings::split(line, "\t");
+            if (fields.size() != 3) return nullopt;
+
+            Package package{fields[0], fields[1] == "-" ? std::string() : fields[1], {}};
+            if (fields[2] != "-") package.targets = Strings::split(fields[2], " ");
+            packages.push_back(std::move(package));
+        }
+        return packages;
+    }
+
+    Optional<std::vector<Package>> load(const VcpkgPaths& paths, const PackageSpec& spec)
+    {
+        auto maybe_lines = paths.get_filesystem().read_lines(get_port_path(paths, spec));
+        if (auto p_lines = maybe_lines.get()) return deserialize(*p_lines);
+        return nullopt;
+    }
+
+    // The characters CMake accepts in a variable name referenced with ${}
+    static bool is_variable_name(const std::string& name)
+    {
+        static constexpr Strings::AsciiSet VARIABLE_CHARS =
+            "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_/.+-";
+        return !name.empty() &&
+               std::all_of(name.begin(), name.end(), [](char c) { return VARIABLE_CHARS.contains(c); });
+    }
+
+    static void write_triplet_index(const VcpkgPaths& paths, const Triplet& triplet)
+    {
+        auto& fs = paths.get_filesystem();
+        const fs::path port_dir = get_index_dir(paths) / triplet.canonical_name();
+
+        // find_package(<name>) loads <name>Config.cmake, or <lowercase name>-config.cmake whatever the case of <name>
+        std::string contents =
+            Strings::format("# Generated by vcpkg from the packages installed for %s\n", triplet.canonical_name());
+        std::vector<fs::path> port_files = fs.get_files_non_recursive(port_dir);
+        Util::sort(port_files);
+        for (auto&& port_file : port_files)
+        {
+            if (port_file.extension() != ".txt") continue;
+            auto maybe_lines = fs.read_lines(port_file);
+            auto p_lines = maybe_lines.get();
+            if (!p_lines) continue;
+            auto maybe_packages = deserialize(*p_lines);
+            auto p_packages = maybe_packages.get();
+            if (!p_packages) continue;
+
+            for (auto&& package : *p_packages)
+            {
+                const std::string config_name = package.config_name();
+                if (!is_variable_name(config_name)) continue;
+
+                const bool is_lowercase_form = Strings::ends_with(package.config_file, LOWERCASE_CONFIG_SUFFIX);
+                Strings::append_to(contents,
+                                   "set(_VCPKG_%sCONFIG_DIR_%s \"%s\")\n",
+                                   is_lowercase_form ? "LOWERCASE_" : "",
+                                   config_name,
+                                   fs::u8path(package.config_file).parent_path().generic_u8string());
+            }
+        }
+
+        const fs::path index_path = get_index_dir(paths) / (triplet.canonical_name() + ".cmake");
+        const fs::path tmp_path = get_index_dir(paths) / (triplet.canonical_name() + ".cmake.tmp");
+        fs.write_contents(tmp_path, contents);
+        fs.rename(tmp_path, index_path);
+    }
+
+    void store(const VcpkgPaths& paths, const PackageSpec& spec, const std::vector<Package>& packages)
+    {
+        auto& fs = paths.get_filesystem();
+        const fs::path port_path = get_port_path(paths, spec);
+
+        std::error_code ec;
+        fs.create_directories(port_path.parent_path(), ec);
+        fs.write_contents(port_path, serialize(packages));
+        write_triplet_index(paths, spec.triplet());
+    }
+
+    void forget(const VcpkgPaths& paths, const PackageSpec& spec)
+    {
+        auto& fs = paths.get_filesystem();
+        const fs::path port_path = get_port_path(paths, spec);
+        if (!fs.exists(port_path)) return;
+
+        std::error_code ec;
+        fs.remove(port_path, ec);
+        write_triplet_index(paths, spec.triplet());
+    }
+}
@@ -0,0 +1,243 @@
+#include "pch.h"
+
+#include <vcpkg/base/hash.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/util.h>
+#include <vcpkg/coffinfocache.h>
+
+namespace vcpkg::CoffInfoCache
+{
+    // Changed whenever CoffFileReader finds more or other things, which leaves the older records unused
+    static constexpr StringLiteral FORMAT_VERSION = "1";
+
+    namespace
+    {
+        struct State
+        {
+            fs::path cache_file;
+            bool loaded = false;
+            size_t record_count = 0;
+            /// <summary>The fields after the hash, keyed by `<dll|lib> <sha1>`</summary>
+            std::unordered_map<std::string, std::vector<std::string>> records;
+        };
+    }
+
+    static Util::LockGuarded<State> g_state;
+
+    // Records are lines of tab separated fields, `<format version> <dll|lib> <sha1> <fields of the kind>...`; a later
+    // record for a key replaces earlier ones
+    static void load(const Files::Filesystem& fs, State& state)
+    {
+        state.loaded = true;
+        auto maybe_lines = fs.read_lines(state.cache_file);
+        auto lines = maybe_lines.get();
+        if (!lines) return;
+
+        for (auto&& line : *lines)
+        {
+            auto fields = Strings::split(line, "\t");
+            if (fields.size() < 3 || fields[0] != FORMAT_VERSION.c_str()) continue;
+
+            ++state.record_count;
+            state.records[fields[1] + " " + fields[2]] = std::vector<std::string>(fields.begin() + 3, fields.end());
+        }
+
+        // Binaries rebuilt with other contents leave their old records behind; compact once they dominate
+        if (state.record_count > 1000 && state.record_count > 2 * state.records.size())
+        {
+            std::string contents;
+            for (auto&& record : state.records)
+            {
+                const auto space = record.first.find(' ');
+                Strings::append_to(contents,
+                                   "%s\t%s\t%s",
+                                   FORMAT_VERSION,
+                                   record.first.substr(0, space),
+                                   record.first.substr(space + 1));
+                for (auto&& field : record.second)
+                {
+                    contents.push_back('\t');
+                    contents.append(field);
+                }
+                contents.push_back('\n');
+            }
+
+            const fs::path tmp_file = state.cache_file.u8string() + ".tmp";
+            std::ofstream(tmp_file.native(), std::ios::binary | std::ios::trunc) << contents;
+            std::error_code ec;
+            fs::stdfs::rename(tmp_file, state.cache_file, ec);
+            state.record_count = state.records.size();
+        }
+    }
+
+    static Optional<std::vector<std::string>> find(const VcpkgPaths& paths, const std::string& key)
+    {
+        auto state = g_state.lock();
+        const fs::path cache_file = paths.vcpkg_dir / "coffinfo";
+        if (state->cache_file != cache_file)
+        {
+            state->cache_file = cache_file;
+            state->loaded = false;
+            state->record_count = 0;
+            state->records.clear();
+        }
+        if (!state->loaded) load(paths.get_filesystem(), *state);
+
+        const auto it = state->records.find(key);
+        if (it == state->records.end()) return nullopt;
+        return it->second;
+    }
+
+    static void store(const std::string& key, std::vector<std::string> fields)
+    {
+        // Tabs and line breaks would split the record; such names do not occur in practice, so they are just not kept
+        for (auto&& field : fields)
+        {
+            if (field.find_first_of("\t\r\n") != std::string::npos) return;
+        }
+
+        const auto space = key.find(' ');
+        std::string line = Strings::format("%s\t%s\t%s", FORMAT_VERSION, key.substr(0, space), key.substr(space + 1));
+        for (auto&& field : fields)
+        {
+            line.push_back('\t');
+            line.append(field);
+        }
+        line.push_back('\n');
+
+        auto state = g_state.lock();
+        ++state->record_count;
+        state->records[key] = std::move(fields);
+        std::ofstream(state->cache_file.native(), std::ios::binary | std::ios::app) << line;
+    }
+
+    static Optional<unsigned long> parse_number(const std::string& field)
+    {
+        char* end = nullptr;
+        const unsigned long value = std::strtoul(field.c_str(), &end, 10);
+        if (field.empty() || *end != '\0') return nullopt;
+        return value;
+    }
+
+    /// <summary>A counted list of fields starting at `index`, which is moved past it.</summary>
+    static Optional<std::vector<std::string>> parse_list(const std::vector<std::string>& fields, size_t& index)
+    {
+        if (index >= fields.size()) return nullopt;
+        const auto maybe_count = parse_number(fields[index]);
+        const auto p_count = maybe_count.get();
+        if (!p_count || *p_count > fields.size() - index - 1) return nullopt;
+
+        std::vector<std::string> list(fields.begin() + index + 1, fields.begin() + index + 1 + *p_count);
+        index += 1 + *p_count;
+        return list;
+    }
+
+    static void append_list(std::vector<std::string>& fields, const std::vector<std::string>& list)
+    {
+        fields.push_back(std::to_string(list.size()));
+        fields.insert(fields.end(), list.begin(), list.end());
+    }
+
+    // `<machine type> <characteristics> <dll characteristics> <app container> <export count> <dependencies>
+    // <pdb path>`, numbers in decimal and the dependencies as a counted list; an empty pdb path is left out
+    static Optional<CoffFileReader::DllInfo> parse_dll_info(const std::vector<std::string>& fields)
+    {
+        if (fields.size() < 6) return nullopt;
+
+        std::array<unsigned long, 5> numbers;
+        for (size_t i = 0; i < numbers.size(); ++i)
+        {
+            const auto maybe_number = parse_number(fields[i]);
+            const auto p_number = maybe_number.get();
+            if (!p_number) return nullopt;
+            numbers[i] = *p_number;
+        }
+
+        size_t index = numbers.size();
+        auto maybe_dependencies = parse_list(fields, index);
+        auto p_dependencies = maybe_dependencies.get();
+        if (!p_dependencies || fields.size() > index + 1) return nullopt;
+
+        CoffFileReader::DllInfo info;
+        info.machine_type = to_machine_type(static_cast<uint16_t>(numbers[0]));
+        info.characteristics = static_cast<uint16_t>(numbers[1]);
+        info.dll_characteristics = static_cast<uint16_t>(numbers[2]);
+        info.is_app_container = numbers[3] != 0;
+        info.export_count = static_cast<uint32_t>(numbers[4]);
+        info.dependencies = std::move(*p_dependencies);
+        if (index < fields.size()) info.pdb_path = fields[index];
+        return info;
+    }
+
+    // `<machine types> <linker directives>`, both counted lists with the machine types in decimal
+    static Optional<CoffFileReader::LibInfo> parse_lib_info(const std::vector<std::string>& fields)
+    {
+        size_t index = 0;
+        auto maybe_machine_types = parse_list(fields, index);
+        auto p_machine_types = maybe_machine_types.get();
+        if (!p_machine_types) return nullopt;
+        auto maybe_directives = parse_list(fields, index);
+        auto p_directives = maybe_directives.get();
+        if (!p_directives || index != fields.size()) return nullopt;
+
+        CoffFileReader::LibInfo info;
+        for (auto&& machine_type : *p_machine_types)
+        {
+            const auto maybe_number = parse_number(machine_type);
+            const auto p_number = maybe_number.get();
+            if (!p_number) return nullopt;
+            info.machine_types.push_back(to_machine_type(static_cast<uint16_t>(*p_number)));
+        }
+        info.linker_directives = std::move(*p_directives);
+        return info;
+    }
+
+    CoffFileReader::DllInfo read_dll(const VcpkgPaths& paths, const fs::path& path)
+    {
+        auto& fs = paths.get_filesystem();
+        const std::string key = "dll " + Hash::get_file_hash(fs, path, "SHA1");
+
+        auto maybe_fields = find(paths, key);
+        if (auto p_fields = maybe_fields.get())
+        {
+            auto maybe_info = parse_dll_info(*p_fields);
+            if (auto p_info = maybe_info.get()) return std::move(*p_info);
+        }
+
+        CoffFileReader::DllInfo info = CoffFileReader::read_dll(fs, path);
+        info.export_names.clear();
+
+        std::vector<std::string> fields{std::to_string(static_cast<uint16_t>(info.machine_type)),
+                                        std::to_string(info.characteristics),
+                                        std::to_string(info.dll_characteristics),
+                                        info.is_app_container ? "1" : "0",
+                                        std::to_string(info.export_count)};
+        append_list(fields, info.dependencies);
+        if (!info.pdb_path.empty()) fields.push_back(info.pdb_path);
+        store(key, std::move(fields));
+        return info;
+    }
+
+    CoffFileReader::LibInfo read_lib(const VcpkgPaths& paths, const fs::path& path)
+    {
+        auto& fs = paths.get_filesystem();
+        const std::string key = "lib " + Hash::get_file_hash(fs, path, "SHA1");
+
+        auto maybe_fields = find(paths, key);
+        if (auto p_fields = maybe_fields.get())
+        {
+            auto maybe_info = parse_lib_info(*p_fields);
+            if (auto p_info = maybe_info.get()) return std::move(*p_info);
+        }
+
+        CoffFileReader::LibInfo info = CoffFileReader::read_lib(fs, path);
+
+        std::vector<std::string> fields;
+        append_list(fields, Util::fmap(info.machine_types, [](MachineType machine_type) {
+                        return std::to_string(static_cast<uint16_t>(machine_type));
+                    }));
+        append_list(fields, info.linker_directives);
+        store(key, std::move(fields));
+        return info;
+    }
+}
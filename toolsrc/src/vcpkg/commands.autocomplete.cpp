@@ -4,7 +4,6 @@
 #include <vcpkg/commands.h>
 #include <vcpkg/install.h>
 #include <vcpkg/metrics.h>
-#include <vcpkg/paragraphs.h>
 #include <vcpkg/remove.h>
 #include <vcpkg/vcpkglib.h>
 
@@ -26,18 +25,46 @@ namespace vcpkg::Commands::Autocomplete
                           [&](const std::string& triplet) { return Strings::format("%s:%s", port, triplet); });
     }
 
+    static bool is_space(const char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+    /// <summary>
+    /// The line being completed, split at its first and its last run of whitespace. Completion runs on every keypress,
+    /// so the line is taken apart by hand instead of by regexes.
+    /// </summary>
+    struct CompletionLine
+    {
+        explicit CompletionLine(const std::string& line)
+        {
+            const auto first_space = std::find_if(line.begin(), line.end(), is_space);
+            has_arguments = first_space != line.end();
+            command.assign(line.begin(), first_space);
+
+            const auto last_space = std::find_if(line.rbegin(), line.rend(), is_space).base();
+            last_token.assign(last_space, line.end());
+
+            const auto second_token = std::find_if_not(first_space, line.end(), is_space);
+            has_one_argument = has_arguments && second_token == last_space;
+        }
+
+        std::string command;
+        /// <summary>Whether the line goes on after the command, if only with whitespace.</summary>
+        bool has_arguments;
+        /// <summary>Whether the line is the command, whitespace, and at most one more token.</summary>
+        bool has_one_argument;
+        /// <summary>The token being typed, empty after trailing whitespace.</summary>
+        std::string last_token;
+    };
+
     void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths)
     {
         Metrics::g_metrics.lock()->set_send_metrics(false);
         const std::string to_autocomplete = Strings::join(" ", args.command_arguments);
-        const std::vector<std::string> tokens = Strings::split(to_autocomplete, " ");
-
-        std::smatch match;
+        const CompletionLine line(to_autocomplete);
 
         // Handles vcpkg <command>
-        if (std::regex_match(to_autocomplete, match, std::regex{R"###(^(\S*)$)###"}))
+        if (!line.has_arguments)
         {
-            const std::string requested_command = match[1].str();
+            const std::string& requested_command = line.command;
 
             // First try public commands
             std::vector<std::string> public_commands = {"install",
@@ -85,13 +112,13 @@ namespace vcpkg::Commands::Autocomplete
         }
 
         // Handles vcpkg install package:<triplet>
-        if (std::regex_match(to_autocomplete, match, std::regex{R"###(^install(.*|)\s([^:]+):(\S*)$)###"}))
+        const auto colon = line.last_token.find(':');
+        if (line.command == "install" && colon != std::string::npos && colon != 0)
         {
-            const auto port_name = match[2].str();
-            const auto triplet_prefix = match[3].str();
+            const auto port_name = line.last_token.substr(0, colon);
+            const auto triplet_prefix = line.last_token.substr(colon + 1);
 
-            auto maybe_port = Paragraphs::try_load_port(paths.get_filesystem(), paths.port_dir(port_name));
-            if (maybe_port.error())
+            if (!paths.get_filesystem().exists(paths.port_dir(port_name) / "CONTROL"))
             {
                 Checks::exit_success(VCPKG_LINE_INFO);
             }
@@ -108,29 +135,30 @@ namespace vcpkg::Commands::Autocomplete
 
         struct CommandEntry
         {
-            constexpr CommandEntry(const CStringView& name, const CStringView& regex, const CommandStructure& structure)
-                : name(name), regex(regex), structure(structure)
+            constexpr CommandEntry(const CStringView& name, bool takes_many, const CommandStructure& structure)
+                : name(name), takes_many(takes_many), structure(structure)
             {
             }
 
             CStringView name;
-            CStringView regex;
+            /// <summary>Whether every argument is completed, and not only the first one.</summary>
+            bool takes_many;
             const CommandStructure& structure;
         };
 
         static constexpr CommandEntry COMMANDS[] = {
-            CommandEntry{"install", R"###(^install\s(.*\s|)(\S*)$)###", Install::COMMAND_STRUCTURE},
-            CommandEntry{"edit", R"###(^edit\s(.*\s|)(\S*)$)###", Edit::COMMAND_STRUCTURE},
-            CommandEntry{"remove", R"###(^remove\s(.*\s|)(\S*)$)###", Remove::COMMAND_STRUCTURE},
-            CommandEntry{"integrate", R"###(^integrate(\s+)(\S*)$)###", Integrate::COMMAND_STRUCTURE},
-            CommandEntry{"upgrade", R"###(^upgrade(\s+)(\S*)$)###", Upgrade::COMMAND_STRUCTURE},
+            CommandEntry{"install", true, Install::COMMAND_STRUCTURE},
+            CommandEntry{"edit", true, Edit::COMMAND_STRUCTURE},
+            CommandEntry{"remove", true, Remove::COMMAND_STRUCTURE},
+            CommandEntry{"integrate", false, Integrate::COMMAND_STRUCTURE},
+            CommandEntry{"upgrade", false, Upgrade::COMMAND_STRUCTURE},
         };
 
         for (auto&& command : COMMANDS)
         {
-            if (std::regex_match(to_autocomplete, match, std::regex{command.regex.c_str()}))
+            if (line.command == command.name.c_str() && (command.takes_many || line.has_one_argument))
             {
-                const auto prefix = match[2].str();
+                const auto& prefix = line.last_token;
                 std::vector<std::string> results;
 
                 const bool is_option = Strings::case_insensitive_ascii_starts_with(prefix, "-");
@@ -2,28 +2,16 @@
 
 #include <vcpkg/base/files.h>
 #include <vcpkg/base/system.h>
-#include <vcpkg/binaryparagraph.h>
+#include <vcpkg/binarycaching.h>
 #include <vcpkg/commands.h>
 #include <vcpkg/help.h>
-#include <vcpkg/paragraphs.h>
 
 namespace vcpkg::Commands::Cache
 {
-    static std::vector<BinaryParagraph> read_all_binary_paragraphs(const VcpkgPaths& paths)
+    static std::string displayname(const ArchiveMetadata& metadata)
     {
-        std::vector<BinaryParagraph> output;
-        for (auto&& path : paths.get_filesystem().get_files_non_recursive(paths.packages))
-        {
-            const Expected<std::unordered_map<std::string, std::string>> pghs =
-                Paragraphs::get_single_paragraph(paths.get_filesystem(), path / "CONTROL");
-            if (const auto p = pghs.get())
-            {
-                const BinaryParagraph binary_paragraph = BinaryParagraph(*p);
-                output.push_back(binary_paragraph);
-            }
-        }
-
-        return output;
+        if (metadata.features.empty()) return Strings::format("%s:%s", metadata.name, metadata.triplet);
+        return Strings::format("%s[%s]:%s", metadata.name, Strings::join(",", metadata.features), metadata.triplet);
     }
 
     const CommandStructure COMMAND_STRUCTURE = {
@@ -40,36 +28,39 @@ namespace vcpkg::Commands::Cache
     {
         Util::unused(args.parse_arguments(COMMAND_STRUCTURE));
 
-        const std::vector<BinaryParagraph> binary_paragraphs = read_all_binary_paragraphs(paths);
-        if (binary_paragraphs.empty())
-        {
-            System::println("No packages are cached.");
-            Checks::exit_success(VCPKG_LINE_INFO);
-        }
-
-        if (args.command_arguments.empty())
+        // Read from the metadata next to the archives, so no archive is opened and concurrent builds may keep
+        // storing new ones
+        std::vector<ArchiveMetadata> all_metadata = paths.get_binary_cache().load_all_metadata();
+        std::vector<std::pair<std::string, const ArchiveMetadata*>> entries;
+        for (const ArchiveMetadata& metadata : all_metadata)
         {
-            for (const BinaryParagraph& binary_paragraph : binary_paragraphs)
+            std::string name = displayname(metadata);
+            // At this point there is at most 1 argument
+            if (!args.command_arguments.empty() &&
+                !Strings::case_insensitive_ascii_contains(name, args.command_arguments[0]))
             {
-                const std::string displayname = binary_paragraph.displayname();
-                System::println(displayname);
+                continue;
             }
+            entries.emplace_back(std::move(name), &metadata);
         }
-        else
+
+        if (entries.empty())
         {
-            // At this point there is 1 argument
-            for (const BinaryParagraph& binary_paragraph : binary_paragraphs)
-            {
-                const std::string displayname = binary_paragraph.displayname();
-                if (!Strings::case_insensitive_ascii_contains(displayname, args.command_arguments[0]))
-                {
-                    continue;
-                }
+            System::println("No packages are cached.");
+            Checks::exit_success(VCPKG_LINE_INFO);
+        }
 
-                System::println(displayname);
-            }
+        Util::sort(entries);
+
+        uint64_t total_size = 0;
+        for (auto&& entry : entries)
+        {
+            const ArchiveMetadata& metadata = *entry.second;
+            total_size += metadata.size;
+            System::println("%-50s %-16s %10s KiB", entry.first, metadata.version, std::to_string(metadata.size >> 10));
         }
 
+        System::println("%zd archives, %s MiB", entries.size(), std::to_string(total_size >> 20));
         Checks::exit_success(VCPKG_LINE_INFO);
     }
 }
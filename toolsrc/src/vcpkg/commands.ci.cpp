@@ -1,11 +1,14 @@
 #include "pch.h"
 
-#include <vcpkg/base/cache.h>
 #include <vcpkg/base/files.h>
+#include <vcpkg/base/json.h>
 #include <vcpkg/base/stringliteral.h>
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/threadpool.h>
+#include <vcpkg/base/trace.h>
 #include <vcpkg/base/util.h>
 #include <vcpkg/build.h>
+#include <vcpkg/buildhistory.h>
 #include <vcpkg/commands.h>
 #include <vcpkg/dependencies.h>
 #include <vcpkg/globalstate.h>
@@ -30,10 +33,20 @@ namespace vcpkg::Commands::CI
     static constexpr StringLiteral OPTION_EXCLUDE = "--exclude";
     static constexpr StringLiteral OPTION_PURGE_TOMBSTONES = "--purge-tombstones";
     static constexpr StringLiteral OPTION_XUNIT = "--x-xunit";
+    static constexpr StringLiteral OPTION_JOBS = "--x-jobs";
+    static constexpr StringLiteral OPTION_SHARD = "--x-shard";
+    static constexpr StringLiteral OPTION_SHARD_BUILD_TIMES = "--x-shard-build-times";
+    static constexpr StringLiteral OPTION_CHANGED_SINCE = "--x-changed-since";
+    static constexpr StringLiteral OPTION_JSON_SUMMARY = "--x-json-summary";
 
-    static constexpr std::array<CommandSetting, 2> CI_SETTINGS = {{
+    static constexpr std::array<CommandSetting, 7> CI_SETTINGS = {{
         {OPTION_EXCLUDE, "Comma separated list of ports to skip"},
         {OPTION_XUNIT, "File to output results in XUnit format (internal)"},
+        {OPTION_JOBS, "Number of packages to build concurrently, 0 for one per processor (experimental)"},
+        {OPTION_SHARD, "Build only part i of N of the ports, given as i/N (experimental)"},
+        {OPTION_SHARD_BUILD_TIMES, "Build times file shared by all shards to balance them (experimental)"},
+        {OPTION_CHANGED_SINCE, "Only test the ports affected by changes since this git revision (experimental)"},
+        {OPTION_JSON_SUMMARY, "File to write the results to as JSON (experimental)"},
     }};
 
     static constexpr std::array<CommandSwitch, 2> CI_SWITCHES = {{
@@ -49,24 +62,236 @@ namespace vcpkg::Commands::CI
         nullptr,
     };
 
+    struct Shard
+    {
+        size_t index;
+        size_t count;
+        BuildHistory::Durations durations;
+    };
+
+    static Optional<Shard> parse_shard(const ParsedArguments& options, const VcpkgPaths& paths)
+    {
+        const auto it = options.settings.find(OPTION_SHARD);
+        if (it == options.settings.end()) return nullopt;
+
+        const std::string& value = it->second;
+        const auto parts = Strings::split(value, "/");
+        unsigned long numbers[2] = {};
+        bool valid = parts.size() == 2;
+        for (size_t i = 0; valid && i < 2; ++i)
+        {
+            char* end = nullptr;
+            numbers[i] = std::strtoul(parts[i].c_str(), &end, 10);
+            valid = !parts[i].empty() && *end == '\0' && parts[i][0] != '-';
+        }
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           valid && numbers[0] >= 1 && numbers[0] <= numbers[1],
+                           "Invalid value for %s: %s. Expected i/N with 1 <= i <= N.",
+                           OPTION_SHARD,
+                           value);
+
+        // Every shard has to compute the same partition, so they should all be given the same build times
+        const auto it_times = options.settings.find(OPTION_SHARD_BUILD_TIMES);
+        auto durations = it_times == options.settings.end()
+                             ? BuildHistory::load_durations(paths)
+                             : BuildHistory::load_durations(paths.get_filesystem(), fs::u8path(it_times->second));
+
+        return Shard{numbers[0] - 1, numbers[1], std::move(durations)};
+    }
+
+    /// <summary>
+    /// Assigns every package in the plan to one of the shards, balancing their predicted build time. Packages are
+    /// taken in plan order, so dependencies come first, and each joins the shard that already builds the largest share
+    /// of its dependencies unless that shard would grow well past an even split; then it goes to the least loaded
+    /// shard. The result only depends on the plan and the build times, so every shard computes the same partition.
+    /// </summary>
+    static std::unordered_map<PackageSpec, size_t> assign_shards(
+        const std::vector<Dependencies::AnyAction>& action_plan, const Shard& shard)
+    {
+        // Packages without a recorded build are assumed to take as long as an average known package
+        std::chrono::microseconds fallback = std::chrono::seconds(1);
+        if (!shard.durations.empty())
+        {
+            std::chrono::microseconds total{};
+            for (auto&& entry : shard.durations)
+                total += entry.second;
+            fallback = total / shard.durations.size();
+        }
+
+        std::unordered_map<PackageSpec, std::chrono::microseconds> weights;
+        std::chrono::microseconds total{};
+        for (auto&& action : action_plan)
+        {
+            if (auto p = action.install_action.get())
+            {
+                const auto it = shard.durations.find(p->spec);
+                const auto weight = it == shard.durations.end() ? fallback : it->second;
+                weights.emplace(p->spec, weight);
+                total += weight;
+            }
+        }
+        const auto limit = total / shard.count + total / (10 * shard.count);
+
+        std::unordered_map<PackageSpec, size_t> ret;
+        std::vector<std::chrono::microseconds> loads(shard.count);
+        for (auto&& action : action_plan)
+        {
+            const auto p = action.install_action.get();
+            if (!p) continue;
+            const auto weight = weights[p->spec];
+
+            std::vector<std::chrono::microseconds> dependency_weights(shard.count);
+            for (auto&& dependency : p->computed_dependencies)
+            {
+                const auto it = ret.find(dependency);
+                if (it != ret.end()) dependency_weights[it->second] += weights[dependency];
+            }
+
+            size_t chosen = 0;
+            for (size_t i = 1; i < shard.count; ++i)
+                if (loads[i] < loads[chosen]) chosen = i;
+            std::chrono::microseconds best{};
+            for (size_t i = 0; i < shard.count; ++i)
+            {
+                if (dependency_weights[i] > best && loads[i] + weight <= limit)
+                {
+                    best = dependency_weights[i];
+                    chosen = i;
+                }
+            }
+
+            loads[chosen] += weight;
+            ret.emplace(p->spec, chosen);
+        }
+
+        System::println("Shard %d/%d: %.1f%% of the predicted build time",
+                        shard.index + 1,
+                        shard.count,
+                        total.count() == 0 ? 100.0 : 100.0 * loads[shard.index].count() / total.count());
+        return ret;
+    }
+
+    struct Changes
+    {
+        std::set<std::string> ports;
+        std::set<std::string> triplets;
+        /// <summary>Whether anything every build uses, such as scripts/, changed.</summary>
+        bool everything = false;
+    };
+
+    /// <summary>
+    /// Lists what changed in the port tree between `revision` and the working tree. Changes outside ports/, scripts/
+    /// and triplets/ do not affect any build.
+    /// </summary>
+    static Changes find_changes(const VcpkgPaths& paths, const std::string& revision)
+    {
+        const fs::path& git_exe = paths.get_tool_exe(Tools::GIT);
+        const auto cmd = Strings::format(R"("%s" --git-dir="%s" --work-tree="%s" diff --name-only %s --)",
+                                         git_exe.u8string(),
+                                         (paths.root / ".git").u8string(),
+                                         paths.root.u8string(),
+                                         revision);
+        const System::ExitCodeAndOutput output = System::cmd_execute_and_capture_output(cmd);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           output.exit_code == 0,
+                           "Failed to list the files changed since %s:\n%s",
+                           revision,
+                           output.output);
+
+        Changes ret;
+        for (auto&& file : Strings::split(output.output, "\n"))
+        {
+            const auto parts = Strings::split(file, "/");
+            if (parts.size() >= 3 && parts[0] == "ports")
+                ret.ports.insert(parts[1]);
+            else if (parts.size() >= 2 && parts[0] == "triplets")
+                ret.triplets.insert(fs::u8path(parts.back()).stem().u8string());
+            else if (parts.size() >= 2 && parts[0] == "scripts")
+                ret.everything = true;
+        }
+        return ret;
+    }
+
+    /// <summary>Keeps the specs whose port changed or that depend, directly or not, on a port that changed.</summary>
+    static std::vector<FeatureSpec> filter_affected(const Dependencies::PortFileProvider& provider,
+                                                    std::vector<FeatureSpec> fspecs,
+                                                    const std::set<std::string>& changed_ports)
+    {
+        const auto action_plan = Dependencies::create_feature_install_plan(provider, fspecs, StatusParagraphs {});
+
+        // The plan orders every package after its dependencies
+        std::set<PackageSpec> affected;
+        for (auto&& action : action_plan)
+        {
+            if (auto p = action.install_action.get())
+            {
+                if (Util::Sets::contains(changed_ports, p->spec.name()) ||
+                    std::any_of(p->computed_dependencies.begin(),
+                                p->computed_dependencies.end(),
+                                [&](const PackageSpec& spec) { return Util::Sets::contains(affected, spec); }))
+                {
+                    affected.insert(p->spec);
+                }
+            }
+        }
+
+        Util::erase_remove_if(fspecs,
+                              [&](const FeatureSpec& fspec) { return !Util::Sets::contains(affected, fspec.spec()); });
+        return fspecs;
+    }
+
+    /// <summary>
+    /// The properties of `triplet` that Supports clauses test. The CRT linkage is not captured from the triplet file,
+    /// so it matches any clause.
+    /// </summary>
+    static Supports::Target get_supports_target(const VcpkgPaths& paths, const Triplet& triplet)
+    {
+        const auto pre_build_info = Build::PreBuildInfo::from_triplet_file(paths, triplet);
+
+        Supports::Target target;
+        if (auto p_arch = System::to_cpu_architecture(pre_build_info.target_architecture).get())
+            target.architectures = Supports::bit(*p_arch);
+
+        const std::string& system_name = pre_build_info.cmake_system_name;
+        if (system_name.empty() || system_name == "Windows")
+            target.platforms = Supports::bit(Supports::Platform::WINDOWS);
+        else if (system_name == "WindowsStore")
+            target.platforms = Supports::bit(Supports::Platform::UWP);
+        else
+            target.platforms = Supports::OTHER;
+
+        if (auto p_toolset = pre_build_info.platform_toolset.get())
+        {
+            if (*p_toolset == "v140")
+                target.toolsets = Supports::bit(Supports::ToolsetVersion::V140);
+            else if (*p_toolset == "v141")
+                target.toolsets = Supports::bit(Supports::ToolsetVersion::V141);
+            else
+                target.toolsets = Supports::OTHER;
+        }
+        return target;
+    }
+
     struct UnknownCIPortsResults
     {
         std::vector<FullPackageSpec> unknown;
         std::map<PackageSpec, Build::BuildResult> known;
         std::map<PackageSpec, std::vector<std::string>> features;
+        /// <summary>Packages another shard is responsible for; empty when not sharding.</summary>
+        std::unordered_set<PackageSpec> other_shards;
     };
 
     static UnknownCIPortsResults find_unknown_ports_for_ci(const VcpkgPaths& paths,
                                                            const std::set<std::string>& exclusions,
                                                            const Dependencies::PortFileProvider& provider,
                                                            const std::vector<FeatureSpec>& fspecs,
-                                                           const bool purge_tombstones)
+                                                           const bool purge_tombstones,
+                                                           const Optional<Shard>& shard)
     {
-        UnknownCIPortsResults ret;
+        Trace::Scope trace("plan", "ci plan");
 
-        auto& fs = paths.get_filesystem();
+        UnknownCIPortsResults ret;
 
-        std::map<PackageSpec, std::string> abi_tag_map;
         std::set<PackageSpec> will_fail;
 
         const Build::BuildPackageOptions install_plan_options = {
@@ -77,93 +302,100 @@ namespace vcpkg::Commands::CI
             Build::DownloadTool::BUILT_IN,
             GlobalState::g_binary_caching ? Build::BinaryCaching::YES : Build::BinaryCaching::NO,
             Build::FailOnTombstone::YES,
+            Build::Incremental::NO,
         };
 
-        vcpkg::Cache<Triplet, Build::PreBuildInfo> pre_build_info_cache;
-
         auto action_plan = Dependencies::create_feature_install_plan(provider, fspecs, StatusParagraphs {});
+        for (auto&& action : action_plan)
+        {
+            if (auto p = action.install_action.get()) p->build_options = install_plan_options;
+        }
+
+        if (auto p_shard = shard.get())
+        {
+            for (auto&& entry : assign_shards(action_plan, *p_shard))
+                if (entry.second != p_shard->index) ret.other_shards.insert(entry.first);
+        }
+
+        Install::plan_abi_tags(paths, action_plan);
+        const auto abi_tag_map = Install::get_abi_tags(action_plan);
+        const BinaryCache& binary_cache = paths.get_binary_cache();
+
+        // Query the cache for the whole plan at once instead of one round trip per package
+        std::vector<std::string> abi_tags;
+        for (auto&& entry : abi_tag_map)
+            abi_tags.push_back(entry.second);
+        const auto found = binary_cache.has_archives(abi_tags);
+        std::set<std::string> cached_abis;
+        std::vector<std::string> uncached_abis;
+        for (size_t i = 0; i < abi_tags.size(); ++i)
+        {
+            if (found[i])
+                cached_abis.insert(abi_tags[i]);
+            else
+                uncached_abis.push_back(abi_tags[i]);
+        }
+
+        // Tombstones only matter for packages without an archive; each one is a file or share lookup, done in parallel
+        std::set<std::string> failed_abis;
+        if (purge_tombstones)
+        {
+            ThreadPool::parallel_for(abi_tags.size(), [&](size_t i) { binary_cache.purge_tombstone(abi_tags[i]); });
+        }
+        else
+        {
+            const auto tombstones = ThreadPool::parallel_transform(
+                uncached_abis, [&](const std::string& abi) { return binary_cache.find_tombstone(abi).has_value(); });
+            for (size_t i = 0; i < uncached_abis.size(); ++i)
+                if (tombstones[i]) failed_abis.insert(uncached_abis[i]);
+        }
 
         for (auto&& action : action_plan)
         {
             if (auto p = action.install_action.get())
             {
-                // determine abi tag
-                std::string abi;
-                if (auto scf = p->source_control_file.get())
-                {
-                    auto triplet = p->spec.triplet();
-
-                    const Build::BuildPackageConfig build_config {
-                        *scf, triplet, paths.port_dir(p->spec), install_plan_options, p->feature_list};
-
-                    auto dependency_abis =
-                        Util::fmap(p->computed_dependencies, [&](const PackageSpec& spec) -> Build::AbiEntry {
-                            auto it = abi_tag_map.find(spec);
-
-                            if (it == abi_tag_map.end())
-                                return {spec.name(), ""};
-                            else
-                                return {spec.name(), it->second};
-                        });
-                    const auto& pre_build_info = pre_build_info_cache.get_lazy(
-                        triplet, [&]() { return Build::PreBuildInfo::from_triplet_file(paths, triplet); });
-
-                    auto maybe_tag_and_file =
-                        Build::compute_abi_tag(paths, build_config, pre_build_info, dependency_abis);
-                    if (auto tag_and_file = maybe_tag_and_file.get())
-                    {
-                        abi = tag_and_file->tag;
-                        abi_tag_map.emplace(p->spec, abi);
-                    }
-                }
-                else if (auto ipv = p->installed_package.get())
-                {
-                    abi = ipv->core->package.abi;
-                    if (!abi.empty()) abi_tag_map.emplace(p->spec, abi);
-                }
+                const auto it_abi = abi_tag_map.find(p->spec);
+                const std::string abi = it_abi == abi_tag_map.end() ? "" : it_abi->second;
 
                 std::string state;
 
-                auto archives_root_dir = paths.root / "archives";
-                auto archive_name = abi + ".zip";
-                auto archive_subpath = fs::u8path(abi.substr(0, 2)) / archive_name;
-                auto archive_path = archives_root_dir / archive_subpath;
-                auto archive_tombstone_path = archives_root_dir / "fail" / archive_subpath;
-
-                if (purge_tombstones)
-                {
-                    std::error_code ec;
-                    fs.remove(archive_tombstone_path, ec); // Ignore error
-                }
-
                 bool b_will_build = false;
+                // Another shard's packages still fail their dependents here, but are reported by that shard
+                const bool is_own = !Util::Sets::contains(ret.other_shards, p->spec);
+                auto known = [&](BuildResult result) {
+                    if (is_own) ret.known.emplace(p->spec, result);
+                };
 
                 ret.features.emplace(p->spec,
                                      std::vector<std::string> {p->feature_list.begin(), p->feature_list.end()});
 
                 if (Util::Sets::contains(exclusions, p->spec.name()))
                 {
-                    ret.known.emplace(p->spec, BuildResult::EXCLUDED);
+                    known(BuildResult::EXCLUDED);
                     will_fail.emplace(p->spec);
                 }
                 else if (std::any_of(p->computed_dependencies.begin(),
                                      p->computed_dependencies.end(),
                                      [&](const PackageSpec& spec) { return Util::Sets::contains(will_fail, spec); }))
                 {
-                    ret.known.emplace(p->spec, BuildResult::CASCADED_DUE_TO_MISSING_DEPENDENCIES);
+                    known(BuildResult::CASCADED_DUE_TO_MISSING_DEPENDENCIES);
                     will_fail.emplace(p->spec);
                 }
-                else if (fs.exists(archive_path))
+                else if (Util::Sets::contains(cached_abis, abi))
                 {
                     state += "pass";
-                    ret.known.emplace(p->spec, BuildResult::SUCCEEDED);
+                    known(BuildResult::SUCCEEDED);
                 }
-                else if (fs.exists(archive_tombstone_path))
+                else if (Util::Sets::contains(failed_abis, abi))
                 {
                     state += "fail";
-                    ret.known.emplace(p->spec, BuildResult::BUILD_FAILED);
+                    known(BuildResult::BUILD_FAILED);
                     will_fail.emplace(p->spec);
                 }
+                else if (!is_own)
+                {
+                    state += "shard";
+                }
                 else
                 {
                     ret.unknown.push_back({p->spec, {p->feature_list.begin(), p->feature_list.end()}});
@@ -177,6 +409,64 @@ namespace vcpkg::Commands::CI
         return ret;
     }
 
+    /// <summary>
+    /// Writes the results per triplet, each with the time of every phase in microseconds, followed by the results that
+    /// were known from the binary cache without running anything.
+    /// </summary>
+    static void write_json_summary(Files::Filesystem& fs,
+                                   const fs::path& path,
+                                   const std::vector<TripletAndSummary>& results,
+                                   const std::map<PackageSpec, BuildResult>& known)
+    {
+        std::error_code ec;
+        const auto file = fs.open_for_write(path, ec);
+        Checks::check_exit(VCPKG_LINE_INFO, !ec, "error while writing file: %s: %s", path.u8string(), ec.message());
+
+        {
+            Json::Writer json([&](std::string_view chunk) { file->write(chunk); });
+            json.start_object();
+            json.key("triplets").start_array();
+            for (auto&& result : results)
+            {
+                json.start_object();
+                json.key("triplet").string(result.triplet.canonical_name());
+                json.key("results").start_array();
+                for (auto&& spec_summary : result.summary.results)
+                {
+                    json.start_object();
+                    json.key("spec").string(spec_summary.spec.to_string());
+                    json.key("result").string(Build::to_string(spec_summary.build_result.code));
+                    json.key("time_us").number(spec_summary.timing.as<std::chrono::microseconds>().count());
+                    json.key("phases_us").start_object();
+                    for (const Build::BuildPhase phase : Build::BUILD_PHASE_VALUES)
+                    {
+                        const auto duration = spec_summary.build_result.timings.get(phase);
+                        if (duration.count() != 0) json.key(Build::to_string(phase)).number(duration.count());
+                    }
+                    json.end_object();
+                    json.end_object();
+                }
+                json.end_array();
+                json.end_object();
+            }
+            json.end_array();
+
+            json.key("known").start_array();
+            for (auto&& result : known)
+            {
+                json.start_object();
+                json.key("spec").string(result.first.to_string());
+                json.key("result").string(Build::to_string(result.second));
+                json.end_object();
+            }
+            json.end_array();
+            json.end_object();
+        }
+
+        file->close(ec);
+        Checks::check_exit(VCPKG_LINE_INFO, !ec, "error while writing file: %s: %s", path.u8string(), ec.message());
+    }
+
     void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet)
     {
         if (!GlobalState::g_binary_caching)
@@ -196,6 +486,13 @@ namespace vcpkg::Commands::CI
 
         const auto is_dry_run = Util::Sets::contains(options.switches, OPTION_DRY_RUN);
         const auto purge_tombstones = Util::Sets::contains(options.switches, OPTION_PURGE_TOMBSTONES);
+        const size_t jobs = Install::get_job_count(options, OPTION_JOBS);
+        const auto shard = parse_shard(options, paths);
+        if (!is_dry_run) Build::prefetch_build_tools(paths);
+
+        Optional<Changes> changes;
+        const auto it_changed_since = options.settings.find(OPTION_CHANGED_SINCE);
+        if (it_changed_since != options.settings.end()) changes = find_changes(paths, it_changed_since->second);
 
         std::vector<Triplet> triplets;
         for (const std::string& triplet : args.command_arguments)
@@ -208,8 +505,9 @@ namespace vcpkg::Commands::CI
             triplets.push_back(default_triplet);
         }
 
-        StatusParagraphs status_db = database_load_check(paths);
-        const auto& paths_port_file = Dependencies::PathsPortFileProvider(paths);
+        StatusParagraphs status_db = database_load_check(paths, InstalledBase::IMPORT);
+        // Every triplet plans against the same ports, so the port tree is loaded and parsed only once
+        const Dependencies::PreloadedPortFileProvider paths_port_file(paths);
 
         const Build::BuildPackageOptions install_plan_options = {
             Build::UseHeadVersion::NO,
@@ -219,98 +517,150 @@ namespace vcpkg::Commands::CI
             Build::DownloadTool::BUILT_IN,
             GlobalState::g_binary_caching ? Build::BinaryCaching::YES : Build::BinaryCaching::NO,
             Build::FailOnTombstone::YES,
+            Build::Incremental::NO,
         };
 
-        std::vector<std::map<PackageSpec, BuildResult>> all_known_results;
+        const std::vector<std::string>& all_ports = paths_port_file.port_names();
+        const auto port_supports = Util::fmap(all_ports, [&](const std::string& name) {
+            const auto& scf = paths_port_file.get_control_file(name).value_or_exit(VCPKG_LINE_INFO);
+            return scf.core_paragraph->parsed_supports;
+        });
+        const bool any_restricted = std::any_of(
+            port_supports.begin(), port_supports.end(), [](const Supports& s) { return !s.is_unrestricted(); });
 
-        std::vector<std::string> all_ports = Install::get_all_port_names(paths);
-        std::vector<TripletAndSummary> results;
+        std::vector<FeatureSpec> all_fspecs;
         for (const Triplet& triplet : triplets)
         {
             Input::check_triplet(triplet, paths);
 
-            Dependencies::PackageGraph pgraph(paths_port_file, status_db);
+            // The Supports clauses were lowered to masks when the ports were loaded, so the tree is filtered before
+            // any graph work with one mask test per port
+            std::vector<std::string> supported_ports;
+            if (any_restricted)
+            {
+                const auto target = get_supports_target(paths, triplet);
+                for (size_t i = 0; i < all_ports.size(); ++i)
+                {
+                    if (port_supports[i].is_supported(target)) supported_ports.push_back(all_ports[i]);
+                }
+                if (supported_ports.size() != all_ports.size())
+                {
+                    System::println("Skipping %zd ports that do not support %s",
+                                    all_ports.size() - supported_ports.size(),
+                                    triplet);
+                }
+            }
+            const auto& triplet_ports = any_restricted ? supported_ports : all_ports;
 
-            std::vector<PackageSpec> specs = PackageSpec::to_package_specs(all_ports, triplet);
+            std::vector<PackageSpec> specs = PackageSpec::to_package_specs(triplet_ports, triplet);
             // Install the default features for every package
-            auto all_fspecs = Util::fmap(specs, [](auto& spec) { return FeatureSpec(spec, ""); });
-            auto split_specs =
-                find_unknown_ports_for_ci(paths, exclusions_set, paths_port_file, all_fspecs, purge_tombstones);
-            auto fspecs = FullPackageSpec::to_feature_specs(split_specs.unknown);
-
-            for (auto&& fspec : fspecs)
-                pgraph.install(fspec);
-
-            auto action_plan = [&]() {
-                int iterations = 0;
-                do
+            auto triplet_fspecs = Util::fmap(specs, [](auto& spec) { return FeatureSpec(spec, ""); });
+            if (auto p_changes = changes.get())
+            {
+                if (!p_changes->everything && !Util::Sets::contains(p_changes->triplets, triplet.canonical_name()))
                 {
-                    bool inconsistent = false;
-                    auto action_plan = pgraph.serialize();
+                    triplet_fspecs = filter_affected(paths_port_file, std::move(triplet_fspecs), p_changes->ports);
+                }
+                System::println("Testing %d ports affected by changes since %s for %s",
+                                triplet_fspecs.size(),
+                                it_changed_since->second,
+                                triplet);
+            }
+            all_fspecs.insert(all_fspecs.end(), triplet_fspecs.begin(), triplet_fspecs.end());
+        }
 
-                    for (auto&& action : action_plan)
-                    {
-                        if (auto p = action.install_action.get())
-                        {
-                            p->build_options = install_plan_options;
-                            if (Util::Sets::contains(exclusions_set, p->spec.name()))
-                            {
-                                p->plan_type = InstallPlanType::EXCLUDED;
-                            }
-
-                            for (auto&& feature : split_specs.features[p->spec])
-                                if (p->feature_list.find(feature) == p->feature_list.end())
-                                {
-                                    pgraph.install({p->spec, feature});
-                                    inconsistent = true;
-                                }
-                        }
-                    }
+        // The triplets are planned together, so the feature expansion below runs once for all of them and the
+        // executor can interleave their builds
+        auto split_specs =
+            find_unknown_ports_for_ci(paths, exclusions_set, paths_port_file, all_fspecs, purge_tombstones, shard);
+        auto fspecs = FullPackageSpec::to_feature_specs(split_specs.unknown);
 
-                    if (!inconsistent) return action_plan;
-                    Checks::check_exit(VCPKG_LINE_INFO, ++iterations < 100);
-                } while (true);
-            }();
+        // Every package keeps the features it has in the full plan, so that its ABI matches the one checked above
+        Dependencies::PackageGraph pgraph(paths_port_file, status_db);
+        for (auto&& entry : split_specs.features)
+            pgraph.require_features(entry.first, entry.second);
+        for (auto&& fspec : fspecs)
+            pgraph.install(fspec);
 
-            if (is_dry_run)
-            {
-                Dependencies::print_plan(action_plan);
-            }
-            else
+        auto action_plan = pgraph.serialize();
+        for (auto&& action : action_plan)
+        {
+            if (auto p = action.install_action.get())
             {
-                auto summary = Install::perform(action_plan, Install::KeepGoing::YES, paths, status_db);
-                for (auto&& result : summary.results)
-                    split_specs.known.erase(result.spec);
-                results.push_back({triplet, std::move(summary)});
-                all_known_results.emplace_back(std::move(split_specs.known));
+                p->build_options = install_plan_options;
+                if (Util::Sets::contains(exclusions_set, p->spec.name()))
+                {
+                    p->plan_type = InstallPlanType::EXCLUDED;
+                }
             }
         }
 
-        for (auto&& result : results)
+        // Each result is written as soon as its package has finished
+        std::unique_ptr<Install::XunitWriter> xunit;
+        auto it_xunit = options.settings.find(OPTION_XUNIT);
+        if (it_xunit != options.settings.end())
         {
-            System::println("\nTriplet: %s", result.triplet);
-            System::println("Total elapsed time: %s", result.summary.total_elapsed_time);
-            result.summary.print();
+            xunit = std::make_unique<Install::XunitWriter>(paths.get_filesystem(), fs::u8path(it_xunit->second));
         }
 
-        auto it_xunit = options.settings.find(OPTION_XUNIT);
-        if (it_xunit != options.settings.end())
+        std::vector<TripletAndSummary> results;
+        if (is_dry_run)
         {
-            std::string xunit_doc = "<assemblies><assembly><collection>\n";
+            Dependencies::print_plan(action_plan);
+        }
+        else
+        {
+            Install::plan_abi_tags(paths, action_plan);
+            auto summary = Install::perform(action_plan,
+                                            Install::KeepGoing::YES,
+                                            paths,
+                                            status_db,
+                                            jobs,
+                                            split_specs.other_shards,
+                                            Install::Resume::NO,
+                                            [&](const Install::SpecSummary& result) {
+                                                if (!xunit) return;
+                                                if (Util::Sets::contains(split_specs.other_shards, result.spec)) return;
+                                                xunit->add(result);
+                                            });
+            Util::erase_remove_if(summary.results, [&](const Install::SpecSummary& result) {
+                return Util::Sets::contains(split_specs.other_shards, result.spec);
+            });
+            for (auto&& result : summary.results)
+                split_specs.known.erase(result.spec);
+
+            for (const Triplet& triplet : triplets)
+            {
+                Install::InstallSummary triplet_summary;
+                for (auto&& result : summary.results)
+                    if (result.spec.triplet() == triplet) triplet_summary.results.push_back(std::move(result));
+                results.push_back({triplet, std::move(triplet_summary)});
+            }
 
             for (auto&& result : results)
-                xunit_doc += result.summary.xunit_results();
-            for (auto&& known_result : all_known_results)
             {
-                for (auto&& result : known_result)
-                {
-                    xunit_doc +=
-                        Install::InstallSummary::xunit_result(result.first, Chrono::ElapsedTime {}, result.second);
-                }
+                System::println("\nTriplet: %s", result.triplet);
+                result.summary.print();
             }
+            System::println("\nTotal elapsed time: %s", summary.total_elapsed_time);
+            if (auto p_estimate = summary.schedule_estimate.get()) p_estimate->print();
+        }
 
-            xunit_doc += "</collection></assembly></assemblies>\n";
-            paths.get_filesystem().write_contents(fs::u8path(it_xunit->second), xunit_doc);
+        if (xunit)
+        {
+            // What the plan did not execute is known from the binary cache
+            for (auto&& result : split_specs.known)
+            {
+                xunit->add(result.first, Chrono::ElapsedTime{}, result.second, Build::PhaseTimings{});
+            }
+            xunit->close();
+        }
+
+        auto it_json_summary = options.settings.find(OPTION_JSON_SUMMARY);
+        if (it_json_summary != options.settings.end())
+        {
+            write_json_summary(
+                paths.get_filesystem(), fs::u8path(it_json_summary->second), results, split_specs.known);
         }
 
         Checks::exit_success(VCPKG_LINE_INFO);
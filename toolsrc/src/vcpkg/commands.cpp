@@ -1,6 +1,8 @@
 #include "pch.h"
 
 #include <vcpkg/base/hash.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/base/threadpool.h>
 
 #include <vcpkg/build.h>
 #include <vcpkg/commands.h>
@@ -23,6 +25,7 @@ namespace vcpkg::Commands
             {"env", &Env::perform_and_exit},
             {"build-external", &BuildExternal::perform_and_exit},
             {"export", &Export::perform_and_exit},
+            {"depend-info", &DependInfo::perform_and_exit},
         };
         return t;
     }
@@ -37,16 +40,17 @@ namespace vcpkg::Commands
             {"integrate", &Integrate::perform_and_exit},
             {"owns", &Owns::perform_and_exit},
             {"update", &Update::perform_and_exit},
-            {"depend-info", &DependInfo::perform_and_exit},
             {"edit", &Edit::perform_and_exit},
             {"create", &Create::perform_and_exit},
             {"import", &Import::perform_and_exit},
             {"cache", &Cache::perform_and_exit},
             {"portsdiff", &PortsDiff::perform_and_exit},
             {"autocomplete", &Autocomplete::perform_and_exit},
-            {"hash", &Hash::perform_and_exit},
             {"fetch", &Fetch::perform_and_exit},
             {"x-vsinstances", &X_VSInstances::perform_and_exit},
+            {"x-cache-gc", &X_CacheGc::perform_and_exit},
+            {"x-downloads-gc", &X_DownloadsGc::perform_and_exit},
+            {"x-compact", &X_Compact::perform_and_exit},
         };
         return t;
     }
@@ -56,6 +60,8 @@ namespace vcpkg::Commands
         static std::vector<PackageNameAndFunction<CommandTypeC>> t = {
             {"version", &Version::perform_and_exit},
             {"contact", &Contact::perform_and_exit},
+            {"hash", &Hash::perform_and_exit},
+            {"x-applocal", &X_AppLocal::perform_and_exit},
         };
         return t;
     }
@@ -84,23 +90,155 @@ namespace vcpkg::Commands::Fetch
 
 namespace vcpkg::Commands::Hash
 {
+    static constexpr StringLiteral OPTION_ALGORITHM = "--algorithm";
+
+    static constexpr std::array<CommandSetting, 1> HASH_SETTINGS = {{
+        {OPTION_ALGORITHM, "SHA1, SHA256 or SHA512 (default: SHA512)"},
+    }};
+
     const CommandStructure COMMAND_STRUCTURE = {
-        Strings::format("The argument should be a file path\n%s",
-                        Help::create_example_string("hash boost_1_62_0.tar.bz2")),
+        Strings::format("The arguments should be files, directories, whose files are all hashed, or file name patterns "
+                        "with * and ?\n%s\n%s",
+                        Help::create_example_string("hash boost_1_62_0.tar.bz2"),
+                        Help::create_example_string("hash --algorithm=SHA256 downloads/*.zip")),
         1,
-        2,
-        {},
+        SIZE_MAX,
+        {{}, HASH_SETTINGS},
         nullptr,
     };
 
-    void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths)
+    static bool matches_pattern(const std::string& name, const std::string& pattern)
     {
-        Util::unused(args.parse_arguments(COMMAND_STRUCTURE));
+        // Backtracks only to the last *, which is enough since a later * can match everything an earlier one can
+        size_t n = 0, p = 0, star = std::string::npos, star_n = 0;
+        while (n < name.size())
+        {
+            if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n]))
+            {
+                ++n;
+                ++p;
+            }
+            else if (p < pattern.size() && pattern[p] == '*')
+            {
+                star = p++;
+                star_n = n;
+            }
+            else if (star != std::string::npos)
+            {
+                p = star + 1;
+                n = ++star_n;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        while (p < pattern.size() && pattern[p] == '*')
+            ++p;
+        return p == pattern.size();
+    }
+
+    /// <summary>The files an argument names, in a stable order; exits if it names none.</summary>
+    static std::vector<fs::path> expand_argument(const Files::Filesystem& fs, const std::string& argument)
+    {
+        const fs::path path = fs::u8path(argument);
+        const std::string pattern = path.filename().u8string();
+        std::vector<fs::path> files;
+        if (pattern.find_first_of("*?") != std::string::npos)
+        {
+            const fs::path dir = path.has_parent_path() ? path.parent_path() : fs::path(".");
+            for (auto&& entry : fs.get_entries_non_recursive(dir))
+            {
+                if (entry.type == fs::file_type::regular && matches_pattern(entry.path.filename().u8string(), pattern))
+                    files.push_back(path.has_parent_path() ? dir / entry.path.filename() : entry.path.filename());
+            }
+        }
+        else if (fs.is_directory(path))
+        {
+            for (auto&& entry : fs.get_entries_recursive(path))
+            {
+                if (entry.type == fs::file_type::regular) files.push_back(entry.path);
+            }
+        }
+        else
+        {
+            Checks::check_exit(VCPKG_LINE_INFO, fs.is_regular_file(path), "Error: %s is not a file", argument);
+            files.push_back(path);
+        }
+
+        Checks::check_exit(VCPKG_LINE_INFO, !files.empty(), "Error: no files match %s", argument);
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+
+    /// <summary>
+    /// Hash runs without a vcpkg root, but uses the hash cache of the one it was given or it is part of, when there is
+    /// one, so that files hashed before by this command or by a build are not read again.
+    /// </summary>
+    static void enable_hash_cache(const VcpkgCmdArguments& args, const Files::Filesystem& fs)
+    {
+        fs::path root;
+        if (args.vcpkg_root_dir != nullptr)
+            root = fs::u8path(*args.vcpkg_root_dir);
+        else if (const auto p_root = System::get_environment_variable("VCPKG_ROOT").get())
+            root = fs::u8path(*p_root);
+        else
+            root = fs.find_file_recursively_up(fs::stdfs::absolute(System::get_exe_path_of_current_process()),
+                                               ".vcpkg-root");
+
+        const fs::path vcpkg_dir = root / "installed" / "vcpkg";
+        if (!root.empty() && fs.is_directory(vcpkg_dir)) vcpkg::Hash::enable_file_hash_cache(vcpkg_dir / "hashcache");
+    }
+
+    void perform_and_exit(const VcpkgCmdArguments& args)
+    {
+        const ParsedArguments options = args.parse_arguments(COMMAND_STRUCTURE);
+        auto& fs = Files::get_real_filesystem();
+
+        std::vector<std::string> arguments = args.command_arguments;
+        std::string algorithm = "SHA512";
+        const auto it_algorithm = options.settings.find(OPTION_ALGORITHM);
+        if (it_algorithm != options.settings.end())
+        {
+            algorithm = it_algorithm->second;
+        }
+        else if (arguments.size() == 2 && vcpkg::Hash::algorithm_from_string(arguments[1]).has_value() &&
+                 !fs.exists(fs::u8path(arguments[1])))
+        {
+            // The original form, `hash <file> <algorithm>`
+            algorithm = arguments[1];
+            arguments.pop_back();
+        }
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           vcpkg::Hash::algorithm_from_string(algorithm).has_value(),
+                           "Error: unknown hash algorithm %s",
+                           algorithm);
+
+        std::vector<fs::path> files;
+        for (auto&& argument : arguments)
+        {
+            auto expanded = expand_argument(fs, argument);
+            files.insert(files.end(), expanded.begin(), expanded.end());
+        }
+
+        enable_hash_cache(args, fs);
+        const auto hashes = ThreadPool::parallel_transform(files, [&](const fs::path& file) {
+            return vcpkg::Hash::get_file_hash(fs, fs::stdfs::absolute(file), algorithm);
+        });
+
+        // A single file keeps the bare output scripts parse; everything else is listed like sha512sum does
+        if (arguments.size() == 1 && files.size() == 1 && files[0] == fs::u8path(arguments[0]))
+        {
+            System::println(hashes[0]);
+        }
+        else
+        {
+            std::string output;
+            for (size_t i = 0; i < files.size(); ++i)
+                Strings::append_to(output, "%s  %s\n", hashes[i], files[i].generic_u8string());
+            System::print(output);
+        }
 
-        const fs::path file_to_hash = args.command_arguments[0];
-        const std::string algorithm = args.command_arguments.size() == 2 ? args.command_arguments[1] : "SHA512";
-        const std::string hash = vcpkg::Hash::get_file_hash(paths.get_filesystem(), file_to_hash, algorithm);
-        System::println(hash);
         Checks::exit_success(VCPKG_LINE_INFO);
     }
 }
@@ -1,9 +1,13 @@
 #include "pch.h"
 
+#include <vcpkg/base/json.h>
 #include <vcpkg/base/strings.h>
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/threadpool.h>
 #include <vcpkg/base/util.h>
+#include <vcpkg/buildhistory.h>
 #include <vcpkg/commands.h>
+#include <vcpkg/dependencies.h>
 #include <vcpkg/help.h>
 #include <vcpkg/paragraphs.h>
 
@@ -11,17 +15,37 @@ namespace vcpkg::Commands::DependInfo
 {
     constexpr StringLiteral OPTION_DOT = "--dot";
     constexpr StringLiteral OPTION_DGML = "--dgml";
+    constexpr StringLiteral OPTION_RECURSE = "--x-recurse";
+    constexpr StringLiteral OPTION_REVERSE = "--x-reverse";
+    constexpr StringLiteral OPTION_MAX_DEPTH = "--x-max-depth";
+    constexpr StringLiteral OPTION_JSON = "--x-json";
+    constexpr StringLiteral OPTION_BUILD_TIMES = "--x-build-times";
+    constexpr StringLiteral OPTION_BUILD_HISTORY = "--x-build-history";
 
-    constexpr std::array<CommandSwitch, 2> DEPEND_SWITCHES = { {
-        { OPTION_DOT, "Creates graph on basis of dot" },
-        { OPTION_DGML, "Creates graph on basis of dgml" },
-        } };
+    constexpr std::array<CommandSwitch, 6> DEPEND_SWITCHES = {{
+        {OPTION_DOT, "Creates graph on basis of dot"},
+        {OPTION_DGML, "Creates graph on basis of dgml"},
+        {OPTION_RECURSE, "Show the named ports and what they depend on, loading only those ports (experimental)"},
+        {OPTION_REVERSE, "Show the named ports and the ports that depend on them (experimental)"},
+        {OPTION_JSON, "Print the ports and their dependencies as a JSON array (experimental)"},
+        {OPTION_BUILD_TIMES,
+         "Show the recorded build time and cache hit ratio of each port and mark the critical path (experimental)"},
+    }};
+
+    constexpr std::array<CommandSetting, 2> DEPEND_SETTINGS = {{
+        {OPTION_MAX_DEPTH, "Follow at most this many levels of dependencies; implies --x-recurse (experimental)"},
+        {OPTION_BUILD_HISTORY,
+         "Build history file to read, such as VCPKG_BUILD_HISTORY; implies --x-build-times (experimental)"},
+    }};
 
     const CommandStructure COMMAND_STRUCTURE = {
-        Help::create_example_string(R"###(depend-info [pat])###"),
+        Strings::format("%s\n%s\n%s",
+                        Help::create_example_string(R"###(depend-info [pat])###"),
+                        Help::create_example_string(R"###(depend-info --x-recurse --x-max-depth=2 zlib)###"),
+                        Help::create_example_string(R"###(depend-info --x-recurse --x-build-times --dot qt5)###")),
         0,
-        1,
-        { DEPEND_SWITCHES,{} },
+        SIZE_MAX,
+        {DEPEND_SWITCHES, DEPEND_SETTINGS},
         nullptr,
     };
 
@@ -32,133 +56,507 @@ namespace vcpkg::Commands::DependInfo
         return output;
     }
 
-    std::string create_dot_as_string(
-        const std::vector<std::unique_ptr<SourceControlFile>>& source_control_files)
+    static std::vector<std::string> dependency_names(const SourceControlFile& scf)
+    {
+        return Util::fmap(scf.core_paragraph->depends, [](const Dependency& d) { return d.depend.name; });
+    }
+
+    /// <summary>What the build history says about the ports shown, for --x-build-times</summary>
+    struct BuildTimes
+    {
+        std::unordered_map<std::string, BuildHistory::Summary> ports;
+        /// <summary>The chain of dependencies with the longest total build time, from the dependent down.</summary>
+        std::vector<std::string> critical_path;
+        std::chrono::microseconds critical_path_time{0};
+
+        const BuildHistory::Summary* find(const std::string& name) const
+        {
+            const auto it = ports.find(name);
+            return it == ports.end() ? nullptr : &it->second;
+        }
+
+        bool is_critical(const std::string& name) const
+        {
+            return Util::find(critical_path, name) != critical_path.end();
+        }
+
+        bool is_critical(const std::string& from, const std::string& to) const
+        {
+            const auto it = Util::find(critical_path, from);
+            return it != critical_path.end() && it + 1 != critical_path.end() && *(it + 1) == to;
+        }
+    };
+
+    static std::chrono::microseconds get_build_time(const BuildTimes& build_times, const std::string& name)
+    {
+        const auto p_summary = build_times.find(name);
+        return p_summary ? p_summary->build_time.value_or(std::chrono::microseconds(0)) : std::chrono::microseconds(0);
+    }
+
+    static std::string format_seconds(std::chrono::microseconds duration)
+    {
+        return Strings::format("%.1f s", duration.count() / 1e6);
+    }
+
+    static std::string describe(const BuildTimes& build_times, const std::string& name)
+    {
+        const auto p_summary = build_times.find(name);
+        if (!p_summary) return "no installs recorded";
+
+        const auto p_build_time = p_summary->build_time.get();
+        return Strings::format("%s, %zu%% cache hits",
+                               p_build_time ? format_seconds(*p_build_time) : "never built",
+                               p_summary->cache_hits * 100 / p_summary->installs);
+    }
+
+    /// <summary>
+    /// Looks up the ports for `triplet` in the build history and finds the chain of dependencies among them whose
+    /// recorded build times add up to the most. Ports never built count as taking no time, so the path is empty
+    /// without any history, and only dependencies that are shown themselves are followed.
+    /// </summary>
+    static BuildTimes load_build_times(const BuildHistory::Summaries& summaries,
+                                       const Triplet& triplet,
+                                       const std::vector<const SourceControlFile*>& source_control_files)
+    {
+        BuildTimes build_times;
+        std::unordered_map<std::string, const SourceControlFile*> ports_by_name;
+        for (const SourceControlFile* scf : source_control_files)
+        {
+            const std::string& name = scf->core_paragraph->name;
+            ports_by_name.emplace(name, scf);
+
+            auto maybe_spec = PackageSpec::from_name_and_triplet(name, triplet);
+            if (auto p_spec = maybe_spec.get())
+            {
+                const auto it = summaries.find(*p_spec);
+                if (it != summaries.end()) build_times.ports.emplace(name, it->second);
+            }
+        }
+
+        // Longest path through the dependency graph, memoized per port; ports still on the stack are cycles and count
+        // as nothing
+        struct Longest
+        {
+            std::chrono::microseconds time{0};
+            const std::string* next = nullptr;
+            bool done = false;
+        };
+        std::unordered_map<std::string, Longest> longest;
+
+        std::function<std::chrono::microseconds(const std::string&)> visit = [&](const std::string& name) {
+            Longest& entry = longest[name];
+            if (entry.done) return entry.time;
+            entry.done = true;
+
+            std::chrono::microseconds deepest{0};
+            const std::string* next = nullptr;
+            for (const std::string& dependency : dependency_names(*ports_by_name.at(name)))
+            {
+                const auto it = ports_by_name.find(dependency);
+                if (it == ports_by_name.end()) continue;
+
+                const auto time = visit(it->first);
+                if (time > deepest)
+                {
+                    deepest = time;
+                    next = &it->first;
+                }
+            }
+
+            Longest& result = longest[name];
+            result.time = get_build_time(build_times, name) + deepest;
+            result.next = next;
+            return result.time;
+        };
+
+        const std::string* start = nullptr;
+        for (auto&& port : ports_by_name)
+        {
+            const auto time = visit(port.first);
+            // Ties go to the first name, so that the output does not depend on the order of the hash map
+            if (time > build_times.critical_path_time ||
+                (start && time == build_times.critical_path_time && port.first < *start))
+            {
+                build_times.critical_path_time = time;
+                start = &port.first;
+            }
+        }
+
+        for (const std::string* name = start; name; name = longest.at(*name).next)
+        {
+            build_times.critical_path.push_back(*name);
+        }
+
+        return build_times;
+    }
+
+    /// <summary>The graphs are printed a port at a time rather than built up as one string first</summary>
+    static void print_dot(const std::vector<const SourceControlFile*>& source_control_files,
+                          const BuildTimes* build_times)
     {
         int empty_node_count = 0;
 
-        std::string s;
-        s.append("digraph G{ rankdir=LR; edge [minlen=3]; overlap=false;");
+        System::print("digraph G{ rankdir=LR; edge [minlen=3]; overlap=false;");
+        if (build_times)
+        {
+            System::print("label=\"critical path %s\";", format_seconds(build_times->critical_path_time));
+        }
 
-        for (const auto& source_control_file : source_control_files)
+        for (const SourceControlFile* source_control_file : source_control_files)
         {
             const SourceParagraph& source_paragraph = *source_control_file->core_paragraph;
-            if (source_paragraph.depends.empty())
+            const std::string name = replace_dashes_with_underscore(source_paragraph.name);
+
+            // Annotated ports are all drawn, since the ones without dependencies can still take the longest
+            std::string s;
+            if (build_times)
+            {
+                s = Strings::format("%s [label=\"%s\\n%s\"%s];",
+                                    name,
+                                    source_paragraph.name,
+                                    describe(*build_times, source_paragraph.name),
+                                    build_times->is_critical(source_paragraph.name) ? " color=red" : "");
+            }
+            else if (source_paragraph.depends.empty())
             {
                 empty_node_count++;
                 continue;
             }
+            else
+            {
+                s = Strings::format("%s;", name);
+            }
 
-            const std::string name = replace_dashes_with_underscore(source_paragraph.name);
-            s.append(Strings::format("%s;", name));
             for (const Dependency& d : source_paragraph.depends)
             {
                 const std::string dependency_name = replace_dashes_with_underscore(d.name());
-                s.append(Strings::format("%s -> %s;", name, dependency_name));
+                const bool is_critical = build_times && build_times->is_critical(source_paragraph.name, d.name());
+                Strings::append_to(s, "%s -> %s%s;", name, dependency_name, is_critical ? " [color=red]" : "");
             }
+            System::print(s);
         }
 
-        s.append(Strings::format("empty [label=\"%d singletons...\"]; }", empty_node_count));
-        return s;
+        if (build_times)
+            System::println("}");
+        else
+            System::println("empty [label=\"%d singletons...\"]; }", empty_node_count);
     }
 
-    std::string create_dgml_as_string(
-        const std::vector<std::unique_ptr<SourceControlFile>>& source_control_files)
+    static void print_dgml(const std::vector<const SourceControlFile*>& source_control_files,
+                           const BuildTimes* build_times)
     {
-        std::string s;
-        s.append("<?xml version=\"1.0\" encoding=\"utf-8\"?>");
-        s.append("<DirectedGraph xmlns=\"http://schemas.microsoft.com/vs/2009/dgml\">");
+        System::print("<?xml version=\"1.0\" encoding=\"utf-8\"?>");
+        if (build_times)
+        {
+            System::print(
+                "<DirectedGraph xmlns=\"http://schemas.microsoft.com/vs/2009/dgml\" Title=\"critical path %s\">",
+                format_seconds(build_times->critical_path_time));
+        }
+        else
+        {
+            System::print("<DirectedGraph xmlns=\"http://schemas.microsoft.com/vs/2009/dgml\">");
+        }
 
-        std::string nodes, links;
-        for (const auto& source_control_file : source_control_files)
+        System::print("<Nodes>");
+        for (const SourceControlFile* source_control_file : source_control_files)
         {
-            const SourceParagraph& source_paragraph = *source_control_file->core_paragraph;
-            const std::string name = source_paragraph.name;
-            nodes.append(Strings::format("<Node Id=\"%s\" />", name));
+            const std::string& name = source_control_file->core_paragraph->name;
+            if (build_times)
+            {
+                System::print("<Node Id=\"%s\" Label=\"%s (%s)\"%s />",
+                              name,
+                              name,
+                              describe(*build_times, name),
+                              build_times->is_critical(name) ? " Background=\"#FFFF8080\"" : "");
+            }
+            else
+            {
+                System::print("<Node Id=\"%s\" />", name);
+            }
+        }
+        System::print("</Nodes>");
+
+        System::print("<Links>");
+        for (const SourceControlFile* source_control_file : source_control_files)
+        {
+            const std::string& name = source_control_file->core_paragraph->name;
+            std::string links;
 
             // Iterate over dependencies.
-            for (const Dependency& d : source_paragraph.depends)
+            for (const Dependency& d : source_control_file->core_paragraph->depends)
             {
-                links.append(Strings::format("<Link Source=\"%s\" Target=\"%s\" />", name, d.name()));
+                const bool is_critical = build_times && build_times->is_critical(name, d.name());
+                Strings::append_to(links,
+                                   "<Link Source=\"%s\" Target=\"%s\"%s />",
+                                   name,
+                                   d.name(),
+                                   is_critical ? " Stroke=\"#FFFF0000\"" : "");
             }
 
             // Iterate over feature dependencies.
-            const std::vector<std::unique_ptr<FeatureParagraph>>& feature_paragraphs = source_control_file->feature_paragraphs;
-            for (const auto& feature_paragraph : feature_paragraphs)
+            for (const auto& feature_paragraph : source_control_file->feature_paragraphs)
             {
                 for (const Dependency& d : feature_paragraph->depends)
                 {
-                    links.append(Strings::format("<Link Source=\"%s\" Target=\"%s\" />", name, d.name()));
+                    Strings::append_to(links, "<Link Source=\"%s\" Target=\"%s\" />", name, d.name());
                 }
             }
-        }
 
-        s.append(Strings::format("<Nodes>%s</Nodes>", nodes));
-
-        s.append(Strings::format("<Links>%s</Links>", links));
+            System::print(links);
+        }
+        System::print("</Links>");
 
-        s.append("</DirectedGraph>");
-        return s;
+        System::println("</DirectedGraph>");
     }
 
-    std::string create_graph_as_string(
-        const std::unordered_set<std::string>& switches,
-        const std::vector<std::unique_ptr<SourceControlFile>>& source_control_files)
+    static void print_json(const std::vector<const SourceControlFile*>& source_control_files,
+                           const BuildTimes* build_times)
     {
-        if (Util::Sets::contains(switches, OPTION_DOT))
+        Json::Writer json;
+        json.start_array();
+        for (const SourceControlFile* source_control_file : source_control_files)
         {
-            return create_dot_as_string(source_control_files);
+            const SourceParagraph& source_paragraph = *source_control_file->core_paragraph;
+            json.start_object();
+            json.key("name").string(source_paragraph.name);
+            json.key("dependencies").start_array();
+            for (const Dependency& d : source_paragraph.depends)
+                json.string(d.name());
+            json.end_array();
+            if (build_times)
+            {
+                const auto p_summary = build_times->find(source_paragraph.name);
+                const auto p_build_time = p_summary ? p_summary->build_time.get() : nullptr;
+                if (p_build_time)
+                    json.key("buildMilliseconds").number(p_build_time->count() / 1000);
+                else
+                    json.key("buildMilliseconds").null();
+                json.key("installs").number(static_cast<int64_t>(p_summary ? p_summary->installs : 0));
+                json.key("cacheHits").number(static_cast<int64_t>(p_summary ? p_summary->cache_hits : 0));
+                json.key("critical").boolean(build_times->is_critical(source_paragraph.name));
+            }
+            json.end_object();
         }
-        else if (Util::Sets::contains(switches, OPTION_DGML))
+        json.end_array();
+    }
+
+    static size_t get_max_depth(const ParsedArguments& options)
+    {
+        const auto it = options.settings.find(OPTION_MAX_DEPTH);
+        if (it == options.settings.end()) return SIZE_MAX;
+
+        const std::string& value = it->second;
+        char* end = nullptr;
+        const unsigned long max_depth = std::strtoul(value.c_str(), &end, 10);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           !value.empty() && *end == '\0' && value[0] != '-',
+                           "Invalid value for %s: %s. Expected a non-negative integer.",
+                           OPTION_MAX_DEPTH,
+                           value);
+        return max_depth;
+    }
+
+    /// <summary>
+    /// Walks the dependencies of `roots` breadth first, at most max_depth levels deep, and returns the ports it reached
+    /// sorted by name. `next_names` gives the names one level further from a port. Ports that cannot be loaded are
+    /// left out; the roots among them are reported.
+    /// </summary>
+    template<class LoadPort, class NextNames>
+    static std::vector<const SourceControlFile*> walk_ports(const std::vector<std::string>& roots,
+                                                            const size_t max_depth,
+                                                            LoadPort load_port,
+                                                            NextNames next_names)
+    {
+        std::set<std::string> seen(roots.begin(), roots.end());
+        std::vector<std::string> level(seen.begin(), seen.end());
+        std::vector<const SourceControlFile*> reached;
+
+        for (size_t depth = 0; !level.empty(); ++depth)
         {
-            return create_dgml_as_string(source_control_files);
+            // The ports of one level are independent of each other, so they are loaded in parallel
+            const auto loaded = ThreadPool::parallel_transform(level, load_port);
+
+            std::vector<std::string> next_level;
+            for (size_t i = 0; i < level.size(); ++i)
+            {
+                const SourceControlFile* scf = loaded[i];
+                if (!scf)
+                {
+                    if (depth == 0) System::println(System::Color::warning, "Warning: port %s not found", level[i]);
+                    continue;
+                }
+
+                reached.push_back(scf);
+                if (depth == max_depth) continue;
+
+                for (const std::string& name : next_names(*scf))
+                {
+                    if (seen.insert(name).second) next_level.push_back(name);
+                }
+            }
+            level = std::move(next_level);
         }
-        return "";
+
+        std::sort(reached.begin(), reached.end(), [](const SourceControlFile* lhs, const SourceControlFile* rhs) {
+            return lhs->core_paragraph->name < rhs->core_paragraph->name;
+        });
+        return reached;
     }
 
-    void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths)
+    void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet)
     {
         const ParsedArguments options = args.parse_arguments(COMMAND_STRUCTURE);
+        paths.cache_file_statuses();
+
+        const bool reverse = Util::Sets::contains(options.switches, OPTION_REVERSE);
+        const bool recurse = reverse || Util::Sets::contains(options.switches, OPTION_RECURSE) ||
+                             Util::Sets::contains(options.settings, OPTION_MAX_DEPTH);
+        const size_t max_depth = get_max_depth(options);
+
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           recurse || args.command_arguments.size() <= 1,
+                           "Error: depend-info takes at most one pattern unless it follows the dependencies of ports");
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           !recurse || !args.command_arguments.empty(),
+                           "Error: %s, %s and %s need the names of the ports to start from",
+                           OPTION_RECURSE,
+                           OPTION_REVERSE,
+                           OPTION_MAX_DEPTH);
+
+        Dependencies::PathsPortFileProvider provider(paths);
+        std::vector<std::unique_ptr<SourceControlFile>> all_ports;
+        std::vector<const SourceControlFile*> source_control_files;
 
-        auto source_control_files = Paragraphs::load_all_ports(paths.get_filesystem(), paths.ports);
+        if (reverse)
+        {
+            // Every port may depend on the named ones, so all are loaded; the port index makes that cheap
+            all_ports = Paragraphs::load_all_ports(paths.get_filesystem(), paths.ports);
 
-        if (args.command_arguments.size() == 1)
+            std::unordered_map<std::string, const SourceControlFile*> ports_by_name;
+            std::unordered_map<std::string, std::vector<std::string>> dependents;
+            for (auto&& port : all_ports)
+            {
+                ports_by_name.emplace(port->core_paragraph->name, port.get());
+                for (auto&& name : dependency_names(*port))
+                {
+                    dependents[name].push_back(port->core_paragraph->name);
+                }
+            }
+
+            source_control_files = walk_ports(
+                args.command_arguments,
+                max_depth,
+                [&](const std::string& name) -> const SourceControlFile* {
+                    const auto it = ports_by_name.find(name);
+                    return it == ports_by_name.end() ? nullptr : it->second;
+                },
+                [&](const SourceControlFile& scf) {
+                    const auto it = dependents.find(scf.core_paragraph->name);
+                    return it == dependents.end() ? std::vector<std::string>() : it->second;
+                });
+        }
+        else if (recurse)
+        {
+            source_control_files = walk_ports(
+                args.command_arguments,
+                max_depth,
+                [&](const std::string& name) -> const SourceControlFile* {
+                    return provider.get_control_file(name).get();
+                },
+                dependency_names);
+        }
+        else
         {
-            const std::string filter = args.command_arguments.at(0);
+            all_ports = Paragraphs::load_all_ports(paths.get_filesystem(), paths.ports);
+            source_control_files = Util::fmap(all_ports, [](auto&& port) -> const SourceControlFile* {
+                return port.get();
+            });
 
-            Util::erase_remove_if(source_control_files,
-                                  [&](const std::unique_ptr<SourceControlFile>& source_control_file) {
-                                      const SourceParagraph& source_paragraph = *source_control_file->core_paragraph;
+            if (args.command_arguments.size() == 1)
+            {
+                const std::string filter = args.command_arguments.at(0);
+
+                Util::erase_remove_if(source_control_files, [&](const SourceControlFile* source_control_file) {
+                    const SourceParagraph& source_paragraph = *source_control_file->core_paragraph;
+
+                    if (Strings::case_insensitive_ascii_contains(source_paragraph.name, filter))
+                    {
+                        return false;
+                    }
+
+                    for (const Dependency& dependency : source_paragraph.depends)
+                    {
+                        if (Strings::case_insensitive_ascii_contains(dependency.name(), filter))
+                        {
+                            return false;
+                        }
+                    }
 
-                                      if (Strings::case_insensitive_ascii_contains(source_paragraph.name, filter))
-                                      {
-                                          return false;
-                                      }
+                    return true;
+                });
+            }
+        }
+
+        Optional<BuildTimes> maybe_build_times;
+        const auto it_history = options.settings.find(OPTION_BUILD_HISTORY);
+        if (it_history != options.settings.end())
+        {
+            const auto summaries = BuildHistory::load_summaries(paths.get_filesystem(), fs::u8path(it_history->second));
+            maybe_build_times = load_build_times(summaries, default_triplet, source_control_files);
+        }
+        else if (Util::Sets::contains(options.switches, OPTION_BUILD_TIMES))
+        {
+            maybe_build_times =
+                load_build_times(BuildHistory::load_summaries(paths), default_triplet, source_control_files);
+        }
+        const BuildTimes* build_times = maybe_build_times.get();
 
-                                      for (const Dependency& dependency : source_paragraph.depends)
-                                      {
-                                          if (Strings::case_insensitive_ascii_contains(dependency.name(), filter))
-                                          {
-                                              return false;
-                                          }
-                                      }
+        if (Util::Sets::contains(options.switches, OPTION_DOT))
+        {
+            print_dot(source_control_files, build_times);
+            Checks::exit_success(VCPKG_LINE_INFO);
+        }
 
-                                      return true;
-                                  });
+        if (Util::Sets::contains(options.switches, OPTION_DGML))
+        {
+            print_dgml(source_control_files, build_times);
+            Checks::exit_success(VCPKG_LINE_INFO);
         }
 
-        if (!options.switches.empty())
+        if (Util::Sets::contains(options.switches, OPTION_JSON))
         {
-            const std::string graph_as_string = create_graph_as_string(options.switches, source_control_files);
-            System::println(graph_as_string);
+            print_json(source_control_files, build_times);
             Checks::exit_success(VCPKG_LINE_INFO);
         }
 
-        for (auto&& source_control_file : source_control_files)
+        for (const SourceControlFile* source_control_file : source_control_files)
         {
             const SourceParagraph& source_paragraph = *source_control_file->core_paragraph;
             const auto s = Strings::join(", ", source_paragraph.depends, [](const Dependency& d) { return d.name(); });
-            System::println("%s: %s", source_paragraph.name, s);
+            if (build_times)
+            {
+                System::println("%s%s: %s [%s]",
+                                build_times->is_critical(source_paragraph.name) ? "* " : "  ",
+                                source_paragraph.name,
+                                s,
+                                describe(*build_times, source_paragraph.name));
+            }
+            else
+            {
+                System::println("%s: %s", source_paragraph.name, s);
+            }
+        }
+
+        if (build_times && build_times->critical_path.empty())
+        {
+            System::println("\nNo builds of these ports for %s are recorded", default_triplet);
+        }
+        else if (build_times)
+        {
+            System::println("\nCritical path for %s (%s): %s",
+                            default_triplet,
+                            format_seconds(build_times->critical_path_time),
+                            Strings::join(" -> ", build_times->critical_path));
         }
 
         Checks::exit_success(VCPKG_LINE_INFO);
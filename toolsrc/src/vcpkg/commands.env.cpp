@@ -1,5 +1,6 @@
 #include "pch.h"
 
+#include <vcpkg/base/hash.h>
 #include <vcpkg/base/strings.h>
 #include <vcpkg/base/system.h>
 #include <vcpkg/build.h>
@@ -13,6 +14,7 @@ namespace vcpkg::Commands::Env
     static constexpr StringLiteral OPTION_DEBUG_BIN = "--debug-bin";
     static constexpr StringLiteral OPTION_TOOLS = "--tools";
     static constexpr StringLiteral OPTION_PYTHON = "--python";
+    static constexpr StringLiteral OPTION_PRINT = "--x-print";
 
     static constexpr std::array<CommandSwitch, 5> SWITCHES = {{
         {OPTION_BIN, "Add installed bin/ to PATH"},
@@ -22,25 +24,135 @@ namespace vcpkg::Commands::Env
         {OPTION_PYTHON, "Add installed python/ to PYTHONPATH"},
     }};
 
+    static constexpr std::array<CommandSetting, 1> SETTINGS = {{
+        {OPTION_PRINT, "Print the environment as 'cmd' or 'powershell' commands, or 'dump' it as NAME=VALUE lines"},
+    }};
+
     const CommandStructure COMMAND_STRUCTURE = {
         Help::create_example_string("env <optional command> --triplet x64-windows"),
         0,
         1,
-        {SWITCHES, {}},
+        {SWITCHES, SETTINGS},
         nullptr,
     };
 
-    void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& triplet)
+    /// <summary>
+    /// The variables of an environment, which go on top of the clean environment with PATH in front of the clean PATH,
+    /// and the files whose changes make it stale.
+    /// </summary>
+    struct Snapshot
     {
-        const auto& fs = paths.get_filesystem();
+        std::vector<fs::path> stamp_paths;
+        std::unordered_map<std::string, std::string> variables;
+    };
 
-        const ParsedArguments options = args.parse_arguments(COMMAND_STRUCTURE);
+    // "<path>\t<stamp>" for each stamp path, an empty line, then "NAME=VALUE" for each variable
+    static std::string serialize(const Snapshot& snapshot)
+    {
+        std::string out;
+        for (auto&& path : snapshot.stamp_paths)
+        {
+            Strings::append_to(out, "%s\t%s", path.u8string(), Build::describe_install_stamp(path));
+        }
+        out.push_back('\n');
+        const std::map<std::string, std::string> sorted(snapshot.variables.begin(), snapshot.variables.end());
+        for (auto&& variable : sorted)
+        {
+            Strings::append_to(out, "%s=%s\n", variable.first, variable.second);
+        }
+        return out;
+    }
+
+    /// <summary>The snapshot in `file`, unless one of its stamp paths changed since it was written.</summary>
+    static Optional<Snapshot> load_snapshot(const Files::Filesystem& fs, const fs::path& file)
+    {
+        auto maybe_lines = fs.read_lines(file);
+        auto lines = maybe_lines.get();
+        if (!lines) return nullopt;
+
+        Snapshot snapshot;
+        auto it = lines->begin();
+        for (; it != lines->end() && !it->empty(); ++it)
+        {
+            const auto tab = it->find('\t');
+            if (tab == std::string::npos) return nullopt;
+            const fs::path path = fs::u8path(it->substr(0, tab));
+            if (it->substr(tab + 1) + '\n' != Build::describe_install_stamp(path)) return nullopt;
+            snapshot.stamp_paths.push_back(path);
+        }
+        if (it == lines->end()) return nullopt;
+
+        for (++it; it != lines->end(); ++it)
+        {
+            const auto equals = it->find('=', 1);
+            if (equals == std::string::npos) continue;
+            snapshot.variables.emplace(it->substr(0, equals), it->substr(equals + 1));
+        }
+        return snapshot;
+    }
+
+    static void print_environment(const Snapshot& snapshot, const std::string& format, const std::string& stamp)
+    {
+        std::map<std::string, std::string> variables(snapshot.variables.begin(), snapshot.variables.end());
+        variables["VCPKG_ENV_STAMP"] = stamp;
+        const auto it_path = variables.find("PATH");
+
+        if (format == "dump")
+        {
+            if (it_path != variables.end())
+            {
+                const auto current_path = System::get_environment_variable("PATH").value_or("");
+                if (!current_path.empty()) it_path->second += ";" + current_path;
+            }
+            for (auto&& variable : variables)
+            {
+                System::println("%s=%s", variable.first, variable.second);
+            }
+        }
+        else if (format == "cmd")
+        {
+            if (it_path != variables.end()) it_path->second += ";%PATH%";
+            for (auto&& variable : variables)
+            {
+                System::println("set \"%s=%s\"", variable.first, variable.second);
+            }
+        }
+        else if (format == "powershell")
+        {
+            for (auto&& variable : variables)
+            {
+                const std::string value = Strings::replace_all(std::string(variable.second), "'", "''");
+                if (variable.first == "PATH")
+                    System::println("$env:PATH = '%s;' + $env:PATH", value);
+                else
+                    System::println("$env:%s = '%s'", variable.first, value);
+            }
+        }
+        else
+        {
+            Checks::exit_with_message(
+                VCPKG_LINE_INFO, "Error: %s must be cmd, powershell or dump, not '%s'", OPTION_PRINT, format);
+        }
+    }
+
+    static Snapshot create_snapshot(const VcpkgPaths& paths,
+                                    const Triplet& triplet,
+                                    const ParsedArguments& options,
+                                    std::string& env_cmd)
+    {
+        const auto& fs = paths.get_filesystem();
 
         const auto pre_build_info = Build::PreBuildInfo::from_triplet_file(paths, triplet);
         const Toolset& toolset = paths.get_toolset(pre_build_info);
-        auto env_cmd = Build::make_build_env_cmd(pre_build_info, toolset);
+        auto maybe_build_env = Build::get_build_env(paths, pre_build_info, toolset);
+        env_cmd = maybe_build_env.has_value() ? "" : Build::make_build_env_cmd(pre_build_info, toolset);
+
+        Snapshot snapshot;
+        if (!toolset.vcvarsall.empty()) snapshot.stamp_paths = Build::get_build_env_stamp_paths(toolset);
+        snapshot.stamp_paths.push_back(paths.triplets / (triplet.canonical_name() + ".cmake"));
 
-        std::unordered_map<std::string, std::string> extra_env = {};
+        std::unordered_map<std::string, std::string>& extra_env = snapshot.variables;
+        extra_env = maybe_build_env.value_or(std::unordered_map<std::string, std::string>());
         const bool add_bin = Util::Sets::contains(options.switches, OPTION_BIN);
         const bool add_include = Util::Sets::contains(options.switches, OPTION_INCLUDE);
         const bool add_debug_bin = Util::Sets::contains(options.switches, OPTION_DEBUG_BIN);
@@ -50,10 +162,18 @@ namespace vcpkg::Commands::Env
         std::vector<std::string> path_vars;
         if (add_bin) path_vars.push_back((paths.installed / triplet.to_string() / "bin").u8string());
         if (add_debug_bin) path_vars.push_back((paths.installed / triplet.to_string() / "debug" / "bin").u8string());
-        if (add_include) extra_env.emplace("INCLUDE", (paths.installed / triplet.to_string() / "include").u8string());
+        if (add_include)
+        {
+            // Ahead of the compiler's own includes, as the installed headers are what --include asks for
+            auto& include = extra_env["INCLUDE"];
+            const auto installed_include = (paths.installed / triplet.to_string() / "include").u8string();
+            include = include.empty() ? installed_include : installed_include + ";" + include;
+        }
         if (add_tools)
         {
+            // A port that adds or removes a tool directory changes the write time of tools/
             auto tools_dir = paths.installed / triplet.to_string() / "tools";
+            snapshot.stamp_paths.push_back(tools_dir);
             auto tool_files = fs.get_files_non_recursive(tools_dir);
             path_vars.push_back(tools_dir.u8string());
             for (auto&& tool_dir : tool_files)
@@ -62,14 +182,68 @@ namespace vcpkg::Commands::Env
             }
         }
         if (add_python) extra_env.emplace("PYTHONPATH", (paths.installed / triplet.to_string() / "python").u8string());
-        if (path_vars.size() > 0) extra_env.emplace("PATH", Strings::join(";", path_vars));
+        if (path_vars.size() > 0)
+        {
+            auto& path = extra_env["PATH"];
+            path_vars.push_back(path);
+            Util::erase_remove_if(path_vars, [](const std::string& dir) { return dir.empty(); });
+            path = Strings::join(";", path_vars);
+        }
+
+        return snapshot;
+    }
+
+    void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& triplet)
+    {
+        auto& fs = paths.get_filesystem();
+
+        const ParsedArguments options = args.parse_arguments(COMMAND_STRUCTURE);
+
+        // Snapshots are kept per triplet and set of switches, so entering an environment again costs a few stats
+        // instead of the triplet, Visual Studio and vcvarsall lookups
+        std::string key = Strings::format("%s\n%s\n", Commands::Version::version(), triplet.canonical_name());
+        for (auto&& option : std::set<std::string>(options.switches.begin(), options.switches.end()))
+        {
+            Strings::append_to(key, "%s\n", option);
+        }
+        const std::string key_hash = vcpkg::Hash::get_string_hash(key, "SHA1");
+        const fs::path snapshot_file = paths.vcpkg_dir / "env" / (key_hash + ".txt");
+
+        std::string env_cmd;
+        auto maybe_snapshot = load_snapshot(fs, snapshot_file);
+        if (!maybe_snapshot.has_value())
+        {
+            maybe_snapshot = create_snapshot(paths, triplet, options, env_cmd);
+            // Without the variables of vcvarsall the environment is only complete once env_cmd has run
+            if (env_cmd.empty())
+            {
+                std::error_code ec;
+                fs.create_directories(snapshot_file.parent_path(), ec);
+                const fs::path tmp_file = fs::path(snapshot_file).replace_extension(".tmp");
+                fs.write_contents(tmp_file, serialize(*maybe_snapshot.get()), ec);
+                if (!ec) fs.rename(tmp_file, snapshot_file, ec);
+            }
+        }
+        const Snapshot& snapshot = *maybe_snapshot.get();
+
+        const auto it_print = options.settings.find(OPTION_PRINT);
+        if (it_print != options.settings.end())
+        {
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               env_cmd.empty(),
+                               "Error: the environment of '%s' could not be captured to print it",
+                               env_cmd);
+            const std::string stamp = vcpkg::Hash::get_string_hash(serialize(snapshot), "SHA1");
+            print_environment(snapshot, it_print->second, stamp);
+            Checks::exit_success(VCPKG_LINE_INFO);
+        }
 
         std::string env_cmd_prefix = env_cmd.empty() ? "" : Strings::format("%s && ", env_cmd);
         std::string env_cmd_suffix =
             args.command_arguments.empty() ? "cmd" : Strings::format("cmd /c %s", args.command_arguments.at(0));
 
         const std::string cmd = Strings::format("%s%s", env_cmd_prefix, env_cmd_suffix);
-        System::cmd_execute_clean(cmd, extra_env);
+        System::cmd_execute_clean(cmd, snapshot.variables);
         Checks::exit_success(VCPKG_LINE_INFO);
     }
 }
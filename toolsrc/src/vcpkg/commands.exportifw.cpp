@@ -1,5 +1,6 @@
 #include "pch.h"
 
+#include <vcpkg/base/hash.h>
 #include <vcpkg/commands.h>
 #include <vcpkg/export.h>
 #include <vcpkg/export.ifw.h>
@@ -63,34 +64,137 @@ namespace vcpkg::Export::IFW
                    : paths.root / (export_id + "-ifw-installer.exe");
     }
 
-    fs::path export_real_package(const fs::path& ifw_packages_dir_path,
-                                 const ExportPlanAction& action,
+    static constexpr StringLiteral STATE_FILE_NAME = ".vcpkg-ifw-state";
+    static constexpr StringLiteral RELEASE_DATE = "@RELEASE_DATE@";
+
+    /// <summary>
+    /// The components of an IFW packages directory, each with a key that changes whenever the component would be
+    /// exported differently: the hash of its package.xml without the release date and of a description of its data,
+    /// such as the ABI of a package. Exporting into the same directory again rewrites only the components whose key
+    /// changed, and the others keep their release dates.
+    /// </summary>
+    struct ExportState
+    {
+        static ExportState load(const Files::Filesystem& fs, const fs::path& packages_dir)
+        {
+            ExportState state;
+            state.packages_dir = packages_dir;
+            auto maybe_lines = fs.read_lines(packages_dir / STATE_FILE_NAME.c_str());
+            if (auto lines = maybe_lines.get())
+            {
+                state.is_incremental = true;
+                for (auto&& line : *lines)
+                {
+                    const auto space = line.find(' ');
+                    if (space == std::string::npos) continue;
+                    state.previous.emplace(line.substr(0, space), line.substr(space + 1));
+                }
+            }
+            return state;
+        }
+
+        fs::path packages_dir;
+        /// <summary>Whether the directory holds an earlier export, instead of something to be replaced.</summary>
+        bool is_incremental = false;
+        std::map<std::string, std::string> previous;
+        std::map<std::string, std::string> current;
+        /// <summary>The components written by this export, both new and changed ones.</summary>
+        std::vector<std::string> changed;
+
+        std::vector<std::string> removed() const
+        {
+            std::vector<std::string> removed;
+            for (auto&& component : previous)
+            {
+                if (!Util::Sets::contains(current, component.first)) removed.push_back(component.first);
+            }
+            return removed;
+        }
+
+        void save(Files::Filesystem& fs) const
+        {
+            std::vector<std::string> lines;
+            for (auto&& component : current)
+            {
+                lines.push_back(component.first + " " + component.second);
+            }
+            fs.write_lines(packages_dir / STATE_FILE_NAME.c_str(), lines);
+        }
+    };
+
+    /// <summary>
+    /// Writes meta/package.xml of `component` unless the component is unchanged since the previous export, and returns
+    /// whether it was written; the caller then writes the component's data. A changed component's directory is
+    /// emptied first. `package_xml` has RELEASE_DATE where the date goes. Components whose `data_key` is nullopt are
+    /// always written.
+    /// </summary>
+    static bool export_component(ExportState& state,
+                                 const std::string& component,
+                                 const std::string& package_xml,
+                                 const Optional<std::string>& data_key,
                                  Files::Filesystem& fs)
     {
-        std::error_code ec;
+        const fs::path component_dir = state.packages_dir / component;
+        const std::string key = Hash::get_string_hash(package_xml + "\n" + data_key.value_or(""), "SHA1");
+        state.current[component] = key;
 
-        const BinaryParagraph& binary_paragraph = action.core_paragraph().value_or_exit(VCPKG_LINE_INFO);
+        const auto it = state.previous.find(component);
+        if (data_key.has_value() && it != state.previous.end() && it->second == key && fs.exists(component_dir))
+        {
+            return false;
+        }
+        state.changed.push_back(component);
 
-        // Prepare meta dir
-        const fs::path package_xml_file_path =
-            ifw_packages_dir_path /
-            Strings::format("packages.%s.%s", action.spec.name(), action.spec.triplet().canonical_name()) / "meta" /
-            "package.xml";
-        const fs::path package_xml_dir_path = package_xml_file_path.parent_path();
-        fs.create_directories(package_xml_dir_path, ec);
+        std::error_code ec;
+        fs.remove_all(component_dir, ec);
+        Checks::check_exit(
+            VCPKG_LINE_INFO, !ec, "Could not remove outdated component directory %s", component_dir.generic_string());
+
+        const fs::path package_xml_file_path = component_dir / "meta" / "package.xml";
+        fs.create_directories(package_xml_file_path.parent_path(), ec);
         Checks::check_exit(VCPKG_LINE_INFO,
                            !ec,
                            "Could not create directory for package file %s",
                            package_xml_file_path.generic_string());
+        fs.write_contents(package_xml_file_path,
+                          Strings::replace_all(std::string(package_xml), RELEASE_DATE.c_str(), create_release_date()));
+        return true;
+    }
+
+    /// <summary>Describes files by their sizes and write times, to notice when they change.</summary>
+    static std::string describe_files(const std::vector<fs::path>& files)
+    {
+        std::string description;
+        for (auto&& file : files)
+        {
+            std::error_code ec;
+            const auto size = fs::stdfs::file_size(file, ec);
+            const auto write_time = fs::stdfs::last_write_time(file, ec).time_since_epoch().count();
+            description += Strings::format("%s %llu %lld\n",
+                                           file.u8string(),
+                                           static_cast<unsigned long long>(size),
+                                           static_cast<long long>(write_time));
+        }
+        return description;
+    }
+
+    /// <summary>
+    /// Exports the component of one package, and returns the directory its files go to, or nullopt when the package
+    /// is unchanged since the previous export. Packages without an ABI are always exported again.
+    /// </summary>
+    Optional<fs::path> export_real_package(ExportState& state, const ExportPlanAction& action, Files::Filesystem& fs)
+    {
+        const BinaryParagraph& binary_paragraph = action.core_paragraph().value_or_exit(VCPKG_LINE_INFO);
+        const std::string component =
+            Strings::format("packages.%s.%s", action.spec.name(), action.spec.triplet().canonical_name());
 
         auto deps = Strings::join(
             ",", binary_paragraph.depends, [](const std::string& dep) { return "packages." + dep + ":"; });
 
         if (!deps.empty()) deps = "\n    <Dependencies>" + deps + "</Dependencies>";
 
-        fs.write_contents(package_xml_file_path,
-                          Strings::format(
-                              R"###(<?xml version="1.0"?>
+        const std::string package_xml = Strings::format(
+            R"###(<?xml version="1.0"?>
 <Package>
     <DisplayName>%s</DisplayName>
     <Version>%s</Version>
@@ -99,62 +203,49 @@ namespace vcpkg::Export::IFW
     <Virtual>true</Virtual>
 </Package>
 )###",
-                              action.spec.to_string(),
-                              binary_paragraph.version,
-                              create_release_date(),
-                              action.spec.name(),
-                              action.spec.triplet().canonical_name(),
-                              deps));
+            action.spec.to_string(),
+            binary_paragraph.version,
+            RELEASE_DATE,
+            action.spec.name(),
+            action.spec.triplet().canonical_name(),
+            deps);
+
+        const Optional<std::string> data_key =
+            binary_paragraph.abi.empty() ? Optional<std::string>() : Optional<std::string>(binary_paragraph.abi);
+        if (!export_component(state, component, package_xml, data_key, fs)) return nullopt;
 
         // Return dir path for export package data
-        return ifw_packages_dir_path /
-               Strings::format("packages.%s.%s", action.spec.name(), action.spec.triplet().canonical_name()) / "data" /
-               "installed";
+        return state.packages_dir / component / "data" / "installed";
     }
 
-    void export_unique_packages(const fs::path& raw_exported_dir_path,
+    void export_unique_packages(ExportState& state,
                                 std::map<std::string, const ExportPlanAction*> unique_packages,
                                 Files::Filesystem& fs)
     {
-        std::error_code ec;
-
         // packages
-
-        fs::path package_xml_file_path = raw_exported_dir_path / "packages" / "meta" / "package.xml";
-        fs::path package_xml_dir_path = package_xml_file_path.parent_path();
-        fs.create_directories(package_xml_dir_path, ec);
-        Checks::check_exit(VCPKG_LINE_INFO,
-                           !ec,
-                           "Could not create directory for package file %s",
-                           package_xml_file_path.generic_string());
-        fs.write_contents(package_xml_file_path,
-                          Strings::format(
-                              R"###(<?xml version="1.0"?>
+        export_component(state,
+                         "packages",
+                         Strings::format(
+                             R"###(<?xml version="1.0"?>
 <Package>
     <DisplayName>Packages</DisplayName>
     <Version>1.0.0</Version>
     <ReleaseDate>%s</ReleaseDate>
 </Package>
 )###",
-                              create_release_date()));
+                             RELEASE_DATE),
+                         std::string(),
+                         fs);
 
         for (const auto& unique_package : unique_packages)
         {
             const ExportPlanAction& action = *(unique_package.second);
             const BinaryParagraph& binary_paragraph = action.core_paragraph().value_or_exit(VCPKG_LINE_INFO);
 
-            package_xml_file_path =
-                raw_exported_dir_path / Strings::format("packages.%s", unique_package.first) / "meta" / "package.xml";
-            package_xml_dir_path = package_xml_file_path.parent_path();
-            fs.create_directories(package_xml_dir_path, ec);
-            Checks::check_exit(VCPKG_LINE_INFO,
-                               !ec,
-                               "Could not create directory for package file %s",
-                               package_xml_file_path.generic_string());
-
-            fs.write_contents(package_xml_file_path,
-                              Strings::format(
-                                  R"###(<?xml version="1.0"?>
+            export_component(state,
+                             Strings::format("packages.%s", unique_package.first),
+                             Strings::format(
+                                 R"###(<?xml version="1.0"?>
 <Package>
     <DisplayName>%s</DisplayName>
     <Description>%s</Description>
@@ -162,86 +253,72 @@ namespace vcpkg::Export::IFW
     <ReleaseDate>%s</ReleaseDate>
 </Package>
 )###",
-                                  action.spec.name(),
-                                  safe_rich_from_plain_text(binary_paragraph.description),
-                                  binary_paragraph.version,
-                                  create_release_date()));
+                                 action.spec.name(),
+                                 safe_rich_from_plain_text(binary_paragraph.description),
+                                 binary_paragraph.version,
+                                 RELEASE_DATE),
+                             std::string(),
+                             fs);
         }
     }
 
-    void export_unique_triplets(const fs::path& raw_exported_dir_path,
-                                std::set<std::string> unique_triplets,
-                                Files::Filesystem& fs)
+    void export_unique_triplets(ExportState& state, std::set<std::string> unique_triplets, Files::Filesystem& fs)
     {
-        std::error_code ec;
-
         // triplets
-
-        fs::path package_xml_file_path = raw_exported_dir_path / "triplets" / "meta" / "package.xml";
-        fs::path package_xml_dir_path = package_xml_file_path.parent_path();
-        fs.create_directories(package_xml_dir_path, ec);
-        Checks::check_exit(VCPKG_LINE_INFO,
-                           !ec,
-                           "Could not create directory for package file %s",
-                           package_xml_file_path.generic_string());
-        fs.write_contents(package_xml_file_path,
-                          Strings::format(
-                              R"###(<?xml version="1.0"?>
+        export_component(state,
+                         "triplets",
+                         Strings::format(
+                             R"###(<?xml version="1.0"?>
 <Package>
     <DisplayName>Triplets</DisplayName>
     <Version>1.0.0</Version>
     <ReleaseDate>%s</ReleaseDate>
 </Package>
 )###",
-                              create_release_date()));
+                             RELEASE_DATE),
+                         std::string(),
+                         fs);
 
         for (const std::string& triplet : unique_triplets)
         {
-            package_xml_file_path =
-                raw_exported_dir_path / Strings::format("triplets.%s", triplet) / "meta" / "package.xml";
-            package_xml_dir_path = package_xml_file_path.parent_path();
-            fs.create_directories(package_xml_dir_path, ec);
-            Checks::check_exit(VCPKG_LINE_INFO,
-                               !ec,
-                               "Could not create directory for package file %s",
-                               package_xml_file_path.generic_string());
-            fs.write_contents(package_xml_file_path,
-                              Strings::format(
-                                  R"###(<?xml version="1.0"?>
+            export_component(state,
+                             Strings::format("triplets.%s", triplet),
+                             Strings::format(
+                                 R"###(<?xml version="1.0"?>
 <Package>
     <DisplayName>%s</DisplayName>
     <Version>1.0.0</Version>
     <ReleaseDate>%s</ReleaseDate>
 </Package>
 )###",
-                                  triplet,
-                                  create_release_date()));
+                                 triplet,
+                                 RELEASE_DATE),
+                             std::string(),
+                             fs);
         }
     }
 
-    void export_integration(const fs::path& raw_exported_dir_path, Files::Filesystem& fs)
+    void export_integration(ExportState& state, const VcpkgPaths& paths)
     {
-        std::error_code ec;
-
         // integration
-        fs::path package_xml_file_path = raw_exported_dir_path / "integration" / "meta" / "package.xml";
-        fs::path package_xml_dir_path = package_xml_file_path.parent_path();
-        fs.create_directories(package_xml_dir_path, ec);
-        Checks::check_exit(VCPKG_LINE_INFO,
-                           !ec,
-                           "Could not create directory for package file %s",
-                           package_xml_file_path.generic_string());
-
-        fs.write_contents(package_xml_file_path,
-                          Strings::format(
-                              R"###(<?xml version="1.0"?>
+        const std::vector<fs::path> integration_files = Util::fmap(
+            get_integration_files_relative_to_root(), [&](const fs::path& file) { return paths.root / file; });
+        const bool is_changed = export_component(state,
+                                                 "integration",
+                                                 Strings::format(
+                                                     R"###(<?xml version="1.0"?>
 <Package>
     <DisplayName>Integration</DisplayName>
     <Version>1.0.0</Version>
     <ReleaseDate>%s</ReleaseDate>
 </Package>
 )###",
-                              create_release_date()));
+                                                     RELEASE_DATE),
+                                                 describe_files(integration_files),
+                                                 paths.get_filesystem());
+
+        // Copy files needed for integration
+        if (is_changed) export_integration_files(state.packages_dir / "integration" / "data", paths);
     }
 
     void export_config(const std::string& export_id, const Options& ifw_options, const VcpkgPaths& paths)
@@ -284,7 +361,7 @@ namespace vcpkg::Export::IFW
                               formatted_repo_url));
     }
 
-    void export_maintenance_tool(const fs::path& ifw_packages_dir_path, const VcpkgPaths& paths)
+    void export_maintenance_tool(ExportState& state, const VcpkgPaths& paths)
     {
         System::println("Exporting maintenance tool... ");
 
@@ -292,26 +369,11 @@ namespace vcpkg::Export::IFW
         Files::Filesystem& fs = paths.get_filesystem();
 
         const fs::path& installerbase_exe = paths.get_tool_exe(Tools::IFW_INSTALLER_BASE);
-        fs::path tempmaintenancetool = ifw_packages_dir_path / "maintenance" / "data" / "tempmaintenancetool.exe";
-        fs.create_directories(tempmaintenancetool.parent_path(), ec);
-        Checks::check_exit(VCPKG_LINE_INFO,
-                           !ec,
-                           "Could not create directory for package file %s",
-                           tempmaintenancetool.generic_string());
-        fs.copy_file(installerbase_exe, tempmaintenancetool, fs::copy_options::overwrite_existing, ec);
-        Checks::check_exit(
-            VCPKG_LINE_INFO, !ec, "Could not write package file %s", tempmaintenancetool.generic_string());
-
-        fs::path package_xml_file_path = ifw_packages_dir_path / "maintenance" / "meta" / "package.xml";
-        fs::path package_xml_dir_path = package_xml_file_path.parent_path();
-        fs.create_directories(package_xml_dir_path, ec);
-        Checks::check_exit(VCPKG_LINE_INFO,
-                           !ec,
-                           "Could not create directory for package file %s",
-                           package_xml_file_path.generic_string());
-        fs.write_contents(package_xml_file_path,
-                          Strings::format(
-                              R"###(<?xml version="1.0"?>
+        const fs::path script_source = paths.root / "scripts" / "ifw" / "maintenance.qs";
+        const bool is_changed = export_component(state,
+                                                 "maintenance",
+                                                 Strings::format(
+                                                     R"###(<?xml version="1.0"?>
 <Package>
     <DisplayName>Maintenance Tool</DisplayName>
     <Description>Maintenance Tool</Description>
@@ -323,9 +385,26 @@ namespace vcpkg::Export::IFW
     <ForcedInstallation>true</ForcedInstallation>
 </Package>
 )###",
-                              create_release_date()));
-        const fs::path script_source = paths.root / "scripts" / "ifw" / "maintenance.qs";
-        const fs::path script_destination = ifw_packages_dir_path / "maintenance" / "meta" / "maintenance.qs";
+                                                     RELEASE_DATE),
+                                                 describe_files({installerbase_exe, script_source}),
+                                                 fs);
+        if (!is_changed)
+        {
+            System::println("Exporting maintenance tool... unchanged");
+            return;
+        }
+
+        fs::path tempmaintenancetool = state.packages_dir / "maintenance" / "data" / "tempmaintenancetool.exe";
+        fs.create_directories(tempmaintenancetool.parent_path(), ec);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           !ec,
+                           "Could not create directory for package file %s",
+                           tempmaintenancetool.generic_string());
+        fs.copy_file(installerbase_exe, tempmaintenancetool, fs::copy_options::overwrite_existing, ec);
+        Checks::check_exit(
+            VCPKG_LINE_INFO, !ec, "Could not write package file %s", tempmaintenancetool.generic_string());
+
+        const fs::path script_destination = state.packages_dir / "maintenance" / "meta" / "maintenance.qs";
         fs.copy_file(script_source, script_destination, fs::copy_options::overwrite_existing, ec);
         Checks::check_exit(
             VCPKG_LINE_INFO, !ec, "Could not write package file %s", script_destination.generic_string());
@@ -333,10 +412,17 @@ namespace vcpkg::Export::IFW
         System::println("Exporting maintenance tool... done");
     }
 
-    void do_repository(const std::string& export_id, const Options& ifw_options, const VcpkgPaths& paths)
+    /// <summary>
+    /// Generates the repository from the packages directory. After an incremental export only the changed components
+    /// are passed to `repogen --update`, which replaces them and keeps the rest of the existing repository.
+    /// </summary>
+    void do_repository(const std::string& export_id,
+                       const Options& ifw_options,
+                       const ExportState& state,
+                       const VcpkgPaths& paths)
     {
         const fs::path& repogen_exe = paths.get_tool_exe(Tools::IFW_REPOGEN);
-        const fs::path packages_dir = get_packages_dir_path(export_id, ifw_options, paths);
+        const fs::path& packages_dir = state.packages_dir;
         const fs::path repository_dir = get_repository_dir_path(export_id, ifw_options, paths);
 
         System::println("Generating repository %s...", repository_dir.generic_string());
@@ -344,14 +430,38 @@ namespace vcpkg::Export::IFW
         std::error_code ec;
         Files::Filesystem& fs = paths.get_filesystem();
 
-        fs.remove_all(repository_dir, ec);
-        Checks::check_exit(
-            VCPKG_LINE_INFO, !ec, "Could not remove outdated repository directory %s", repository_dir.generic_string());
+        // repogen --update cannot take components out of a repository
+        const bool is_update = state.is_incremental && state.removed().empty() &&
+                               fs.exists(repository_dir / "Updates.xml");
+        if (is_update && state.changed.empty())
+        {
+            System::println(
+                System::Color::success, "Generating repository %s... up to date.", repository_dir.generic_string());
+            return;
+        }
+
+        std::string cmd_line;
+        if (is_update)
+        {
+            cmd_line = Strings::format(R"("%s" --update --include %s --packages "%s" "%s" > nul)",
+                                       repogen_exe.u8string(),
+                                       Strings::join(",", state.changed),
+                                       packages_dir.u8string(),
+                                       repository_dir.u8string());
+        }
+        else
+        {
+            fs.remove_all(repository_dir, ec);
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               !ec,
+                               "Could not remove outdated repository directory %s",
+                               repository_dir.generic_string());
 
-        const auto cmd_line = Strings::format(R"("%s" --packages "%s" "%s" > nul)",
-                                              repogen_exe.u8string(),
-                                              packages_dir.u8string(),
-                                              repository_dir.u8string());
+            cmd_line = Strings::format(R"("%s" --packages "%s" "%s" > nul)",
+                                       repogen_exe.u8string(),
+                                       packages_dir.u8string(),
+                                       repository_dir.u8string());
+        }
 
         const int exit_code = System::cmd_execute_clean(cmd_line);
         Checks::check_exit(VCPKG_LINE_INFO, exit_code == 0, "Error: IFW repository generating failed");
@@ -403,21 +513,27 @@ namespace vcpkg::Export::IFW
         std::error_code ec;
         Files::Filesystem& fs = paths.get_filesystem();
 
-        // Prepare packages directory
+        // Prepare packages directory, keeping an earlier export to update
         const fs::path ifw_packages_dir_path = get_packages_dir_path(export_id, ifw_options, paths);
+        ExportState state = ExportState::load(fs, ifw_packages_dir_path);
+        // Until this export completes, the directory matches neither the earlier state nor the new one
+        fs.remove(ifw_packages_dir_path / STATE_FILE_NAME.c_str(), ec);
 
-        fs.remove_all(ifw_packages_dir_path, ec);
-        Checks::check_exit(VCPKG_LINE_INFO,
-                           !ec,
-                           "Could not remove outdated packages directory %s",
-                           ifw_packages_dir_path.generic_string());
+        if (!state.is_incremental)
+        {
+            fs.remove_all(ifw_packages_dir_path, ec);
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               !ec,
+                               "Could not remove outdated packages directory %s",
+                               ifw_packages_dir_path.generic_string());
+        }
 
-        fs.create_directory(ifw_packages_dir_path, ec);
+        fs.create_directories(ifw_packages_dir_path, ec);
         Checks::check_exit(
             VCPKG_LINE_INFO, !ec, "Could not create packages directory %s", ifw_packages_dir_path.generic_string());
 
         // Export maintenance tool
-        export_maintenance_tool(ifw_packages_dir_path, paths);
+        export_maintenance_tool(state, paths);
 
         System::println("Exporting packages %s... ", ifw_packages_dir_path.generic_string());
 
@@ -440,9 +556,16 @@ namespace vcpkg::Export::IFW
             unique_triplets.insert(action.spec.triplet().canonical_name());
 
             // Export real package and return data dir for installation
-            fs::path ifw_package_dir_path = export_real_package(ifw_packages_dir_path, action, fs);
+            const auto maybe_package_dir_path = export_real_package(state, action, fs);
+            const auto p_package_dir_path = maybe_package_dir_path.get();
+            if (!p_package_dir_path)
+            {
+                System::println("Exporting package %s... unchanged", display_name);
+                continue;
+            }
 
             // Copy package data
+            const fs::path& ifw_package_dir_path = *p_package_dir_path;
             const InstallDir dirs = InstallDir::from_destination_root(ifw_package_dir_path,
                                                                       action.spec.triplet().to_string(),
                                                                       ifw_package_dir_path / "vcpkg" / "info" /
@@ -459,15 +582,23 @@ namespace vcpkg::Export::IFW
         System::println("Generating configuration %s...", config_file.generic_string());
 
         // Unique packages
-        export_unique_packages(ifw_packages_dir_path, unique_packages, fs);
+        export_unique_packages(state, unique_packages, fs);
 
         // Unique triplets
-        export_unique_triplets(ifw_packages_dir_path, unique_triplets, fs);
+        export_unique_triplets(state, unique_triplets, fs);
 
-        // Copy files needed for integration
-        export_integration_files(ifw_packages_dir_path / "integration" / "data", paths);
         // Integration
-        export_integration(ifw_packages_dir_path, fs);
+        export_integration(state, paths);
+
+        // Components of the previous export that are no longer part of it
+        for (auto&& component : state.removed())
+        {
+            fs.remove_all(ifw_packages_dir_path / component, ec);
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               !ec,
+                               "Could not remove outdated component directory %s",
+                               (ifw_packages_dir_path / component).generic_string());
+        }
 
         // Configuration
         export_config(export_id, ifw_options, paths);
@@ -478,10 +609,13 @@ namespace vcpkg::Export::IFW
         std::string ifw_repo_url = ifw_options.maybe_repository_url.value_or("");
         if (!ifw_repo_url.empty())
         {
-            do_repository(export_id, ifw_options, paths);
+            do_repository(export_id, ifw_options, state, paths);
         }
 
         // Do installer
         do_installer(export_id, ifw_options, paths);
+
+        // Only a complete export can be updated the next time
+        state.save(fs);
     }
 }
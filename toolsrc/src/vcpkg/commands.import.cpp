@@ -21,19 +21,19 @@ namespace vcpkg::Commands::Import
 
     static Binaries find_binaries_in_dir(const Files::Filesystem& fs, const fs::path& path)
     {
-        auto files = fs.get_files_recursive(path);
+        auto entries = fs.get_entries_recursive(path);
 
         check_is_directory(VCPKG_LINE_INFO, fs, path);
 
         Binaries binaries;
-        for (auto&& file : files)
+        for (auto&& entry : entries)
         {
-            if (fs.is_directory(file)) continue;
-            const auto ext = file.extension();
+            if (entry.type == fs::file_type::directory) continue;
+            const auto ext = entry.path.extension();
             if (ext == ".dll")
-                binaries.dlls.push_back(std::move(file));
+                binaries.dlls.push_back(std::move(entry.path));
             else if (ext == ".lib")
-                binaries.libs.push_back(std::move(file));
+                binaries.libs.push_back(std::move(entry.path));
         }
         return binaries;
     }
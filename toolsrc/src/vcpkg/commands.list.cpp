@@ -1,5 +1,6 @@
 #include "pch.h"
 
+#include <vcpkg/base/json.h>
 #include <vcpkg/base/system.h>
 #include <vcpkg/commands.h>
 #include <vcpkg/help.h>
@@ -9,24 +10,61 @@ namespace vcpkg::Commands::List
 {
     static constexpr StringLiteral OPTION_FULLDESC =
         "--x-full-desc"; // TODO: This should find a better home, eventually
+    static constexpr StringLiteral OPTION_JSON = "--x-json";
 
-    static void do_print(const StatusParagraph& pgh, const bool full_desc)
+    static void do_print(const InstalledSummaryEntry& entry, const bool full_desc)
     {
         if (full_desc)
         {
-            System::println("%-50s %-16s %s", pgh.package.displayname(), pgh.package.version, pgh.package.description);
+            System::println("%-50s %-16s %s", entry.displayname, entry.version, entry.description);
         }
         else
         {
             System::println("%-50s %-16s %s",
-                            vcpkg::shorten_text(pgh.package.displayname(), 50),
-                            vcpkg::shorten_text(pgh.package.version, 16),
-                            vcpkg::shorten_text(pgh.package.description, 51));
+                            vcpkg::shorten_text(entry.displayname, 50),
+                            vcpkg::shorten_text(entry.version, 16),
+                            vcpkg::shorten_text(entry.description, 51));
         }
     }
 
-    static constexpr std::array<CommandSwitch, 1> LIST_SWITCHES = {{
+    /// <summary>
+    /// The installed summary, or the same entries from the status database when the summary is stale or leaves out the
+    /// packages of VCPKG_INSTALLED_BASE
+    /// </summary>
+    static std::vector<InstalledSummaryEntry> load_installed_entries(const VcpkgPaths& paths)
+    {
+        auto maybe_summary = paths.installed_base.empty() ? try_load_installed_summary(paths) : nullopt;
+        if (auto summary = maybe_summary.get())
+        {
+            return std::move(*summary);
+        }
+
+        const StatusParagraphs status_paragraphs = database_load_check(paths);
+
+        std::vector<InstalledSummaryEntry> entries;
+        const auto add_entry = [&](const StatusParagraph& pgh) {
+            entries.push_back({pgh.package.displayname(), pgh.package.version, pgh.package.description});
+        };
+        for (auto&& ipv : get_installed_ports(status_paragraphs))
+        {
+            add_entry(*ipv.core);
+            for (const StatusParagraph* feature : ipv.features)
+            {
+                add_entry(*feature);
+            }
+        }
+
+        std::sort(entries.begin(),
+                  entries.end(),
+                  [](const InstalledSummaryEntry& lhs, const InstalledSummaryEntry& rhs) -> bool {
+                      return lhs.displayname < rhs.displayname;
+                  });
+        return entries;
+    }
+
+    static constexpr std::array<CommandSwitch, 2> LIST_SWITCHES = {{
         {OPTION_FULLDESC, "Do not truncate long text"},
+        {OPTION_JSON, "Print the packages as a JSON array (experimental)"},
     }};
 
     const CommandStructure COMMAND_STRUCTURE = {
@@ -43,46 +81,42 @@ namespace vcpkg::Commands::List
     {
         const ParsedArguments options = args.parse_arguments(COMMAND_STRUCTURE);
 
-        const StatusParagraphs status_paragraphs = database_load_check(paths);
-        auto installed_ipv = get_installed_ports(status_paragraphs);
+        const auto installed_entries = load_installed_entries(paths);
 
-        if (installed_ipv.empty())
-        {
-            System::println("No packages are installed. Did you mean `search`?");
-            Checks::exit_success(VCPKG_LINE_INFO);
-        }
-
-        auto installed_packages = Util::fmap(installed_ipv, [](const InstalledPackageView& ipv) { return ipv.core; });
-        auto installed_features =
-            Util::fmap_flatten(installed_ipv, [](const InstalledPackageView& ipv) { return ipv.features; });
-        installed_packages.insert(installed_packages.end(), installed_features.begin(), installed_features.end());
+        // At this point there is at most 1 argument
+        const auto is_filtered_out = [&](const InstalledSummaryEntry& entry) {
+            return !args.command_arguments.empty() &&
+                   !Strings::case_insensitive_ascii_contains(entry.displayname, args.command_arguments[0]);
+        };
 
-        std::sort(installed_packages.begin(),
-                  installed_packages.end(),
-                  [](const StatusParagraph* lhs, const StatusParagraph* rhs) -> bool {
-                      return lhs->package.displayname() < rhs->package.displayname();
-                  });
-
-        if (args.command_arguments.empty())
+        if (Util::Sets::contains(options.switches, OPTION_JSON))
         {
-            for (const StatusParagraph* status_paragraph : installed_packages)
+            Json::Writer json;
+            json.start_array();
+            for (const InstalledSummaryEntry& entry : installed_entries)
             {
-                do_print(*status_paragraph, Util::Sets::contains(options.switches, OPTION_FULLDESC));
+                if (is_filtered_out(entry)) continue;
+                json.start_object();
+                json.key("package").string(entry.displayname);
+                json.key("version").string(entry.version);
+                json.key("description").string(entry.description);
+                json.end_object();
             }
+            json.end_array();
+            Checks::exit_success(VCPKG_LINE_INFO);
         }
-        else
+
+        if (installed_entries.empty())
         {
-            // At this point there is 1 argument
-            for (const StatusParagraph* status_paragraph : installed_packages)
-            {
-                const std::string displayname = status_paragraph->package.displayname();
-                if (!Strings::case_insensitive_ascii_contains(displayname, args.command_arguments[0]))
-                {
-                    continue;
-                }
+            System::println("No packages are installed. Did you mean `search`?");
+            Checks::exit_success(VCPKG_LINE_INFO);
+        }
 
-                do_print(*status_paragraph, Util::Sets::contains(options.switches, OPTION_FULLDESC));
-            }
+        const bool full_desc = Util::Sets::contains(options.switches, OPTION_FULLDESC);
+        for (const InstalledSummaryEntry& entry : installed_entries)
+        {
+            if (is_filtered_out(entry)) continue;
+            do_print(entry, full_desc);
         }
 
         Checks::exit_success(VCPKG_LINE_INFO);
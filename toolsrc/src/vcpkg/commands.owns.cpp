@@ -1,28 +1,170 @@
 #include "pch.h"
 
+#include <vcpkg/base/files.h>
 #include <vcpkg/base/system.h>
 #include <vcpkg/commands.h>
 #include <vcpkg/help.h>
 #include <vcpkg/vcpkglib.h>
 
+#include <list>
+
 namespace vcpkg::Commands::Owns
 {
+    static constexpr StringLiteral OWNS_INDEX_HEADER = "vcpkg-owns-index 1\n";
+
+    struct IndexedListfile
+    {
+        uintmax_t size;
+        long long write_time;
+        std::string_view files;
+    };
+
+    /// <summary>
+    /// The index starts with OWNS_INDEX_HEADER, followed by one record per installed package:
+    ///   <listfile name>\t<listfile size>\t<listfile write time>\t<length>\n<length bytes of files, one per line>
+    /// A malformed record ends the index; the listfiles after it are read again.
+    /// </summary>
+    static std::unordered_map<std::string, IndexedListfile> parse_owns_index(const std::string_view text)
+    {
+        std::unordered_map<std::string, IndexedListfile> entries;
+        if (text.compare(0, OWNS_INDEX_HEADER.size(), OWNS_INDEX_HEADER.c_str()) != 0) return entries;
+
+        for (size_t pos = OWNS_INDEX_HEADER.size(); pos < text.size();)
+        {
+            const auto header_end = text.find('\n', pos);
+            if (header_end == std::string_view::npos) break;
+            const auto fields = Strings::split_view(text.substr(pos, header_end - pos), "\t").to_vector();
+            if (fields.size() != 4) break;
+
+            // The numbers end at the tab or newline after them, where strtoull stops
+            IndexedListfile entry;
+            entry.size = std::strtoull(fields[1].data(), nullptr, 10);
+            entry.write_time = std::strtoll(fields[2].data(), nullptr, 10);
+            const size_t length = std::strtoull(fields[3].data(), nullptr, 10);
+
+            const size_t files_begin = header_end + 1;
+            if (length > text.size() - files_begin) break;
+
+            entry.files = text.substr(files_begin, length);
+            entries.emplace(std::string(fields[0]), entry);
+            pos = files_begin + length;
+        }
+
+        return entries;
+    }
+
+    static Optional<IndexedListfile> stat_listfile(const fs::path& listfile_path)
+    {
+        std::error_code ec;
+        IndexedListfile entry;
+        entry.size = fs::stdfs::file_size(listfile_path, ec);
+        if (ec) return nullopt;
+        entry.write_time = fs::stdfs::last_write_time(listfile_path, ec).time_since_epoch().count();
+        if (ec) return nullopt;
+        return entry;
+    }
+
     static void search_file(const VcpkgPaths& paths, const std::string& file_substr, const StatusParagraphs& status_db)
     {
-        const std::vector<StatusParagraphAndAssociatedFiles> installed_files = get_installed_files(paths, status_db);
-        for (const StatusParagraphAndAssociatedFiles& pgh_and_file : installed_files)
+        auto& fs = paths.get_filesystem();
+        const fs::path index_path = paths.vcpkg_dir / "ownsindex";
+
+        // All listfiles are kept together in one index, so a query reads a single file instead of one listfile per
+        // installed package. Only listfiles with a different size or write time than recorded are read again.
+        std::unordered_map<std::string, IndexedListfile> index;
+        auto maybe_index_file = fs.map_contents(index_path);
+        if (auto index_file = maybe_index_file.get())
+        {
+            index = parse_owns_index((*index_file)->contents());
+        }
+
+        // One listing of the info directory gives the size and write time of every listfile at once
+        std::unordered_map<std::string, IndexedListfile> current_listfiles;
+        for (auto&& entry : fs.get_entries_non_recursive(paths.vcpkg_dir_info))
+        {
+            if (entry.type != fs::file_type::regular) continue;
+            const long long write_time = entry.last_write_time.time_since_epoch().count();
+            current_listfiles.emplace(entry.path.filename().u8string(), IndexedListfile{entry.size, write_time, {}});
+        }
+
+        std::vector<const StatusParagraph*> installed;
+        std::vector<IndexedListfile> listfiles;
+        std::list<std::string> reloaded;
+        bool index_is_stale = false;
+        for (const std::unique_ptr<StatusParagraph>& pgh : status_db)
         {
-            const StatusParagraph& pgh = pgh_and_file.pgh;
+            if (!pgh->is_installed() || !pgh->package.feature.empty()) continue;
 
-            for (const std::string& file : pgh_and_file.files)
+            const fs::path listfile_path = paths.listfile_path(pgh->package);
+            const std::string listfile_name = listfile_path.filename().u8string();
+            const auto current = current_listfiles.find(listfile_name);
+            const auto it = index.find(listfile_name);
+            if (current != current_listfiles.end())
             {
-                if (file.find(file_substr) != std::string::npos)
+                if (it != index.end() && it->second.size == current->second.size &&
+                    it->second.write_time == current->second.write_time)
                 {
-                    System::println("%s: %s", pgh.package.displayname(), file);
+                    installed.push_back(pgh.get());
+                    listfiles.push_back(it->second);
+                    continue;
                 }
             }
+
+            std::string files;
+            for (const std::string& file : get_installed_files(paths, *pgh))
+            {
+                files.append(file).push_back('\n');
+            }
+            reloaded.push_back(std::move(files));
+
+            // Reading can rewrite a listfile in the current format, so look at it again afterwards
+            const auto maybe_rewritten = stat_listfile(listfile_path);
+            IndexedListfile entry = maybe_rewritten.has_value() ? *maybe_rewritten.get() : IndexedListfile{0, 0, {}};
+            entry.files = reloaded.back();
+            installed.push_back(pgh.get());
+            listfiles.push_back(entry);
+            index_is_stale = true;
+        }
+
+        if (index_is_stale || index.size() != installed.size())
+        {
+            std::string text = OWNS_INDEX_HEADER.c_str();
+            for (size_t i = 0; i < installed.size(); ++i)
+            {
+                text += Strings::format("%s\t%llu\t%lld\t%zu\n",
+                                        paths.listfile_path(installed[i]->package).filename().u8string(),
+                                        static_cast<unsigned long long>(listfiles[i].size),
+                                        listfiles[i].write_time,
+                                        listfiles[i].files.size());
+                text.append(listfiles[i].files.data(), listfiles[i].files.size());
+            }
+
+            const fs::path tmp_path = fs::path(index_path).concat(".tmp");
+            std::error_code ec;
+            fs.write_contents(tmp_path, text, ec);
+            if (!ec) fs.rename(tmp_path, index_path, ec);
+        }
+
+        // File names never contain a newline, so neither can anything that matches
+        if (file_substr.find('\n') != std::string::npos) return;
+
+        for (size_t i = 0; i < installed.size(); ++i)
+        {
+            const std::string_view files = listfiles[i].files;
+            size_t pos = 0;
+            while (pos < files.size() && (pos = files.find(file_substr, pos)) != std::string_view::npos)
+            {
+                // Every file is followed by a newline; npos + 1 wraps around to the start of the first line
+                const size_t line_begin = files.substr(0, pos).rfind('\n') + 1;
+                const size_t line_end = files.find('\n', pos);
+                System::println("%s: %s",
+                                installed[i]->package.displayname(),
+                                std::string(files.substr(line_begin, line_end - line_begin)));
+                pos = line_end + 1;
+            }
         }
     }
+
     const CommandStructure COMMAND_STRUCTURE = {
         Strings::format("The argument should be a pattern to search for. %s",
                         Help::create_example_string("owns zlib.dll")),
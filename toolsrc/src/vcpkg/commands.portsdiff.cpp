@@ -75,36 +75,145 @@ namespace vcpkg::Commands::PortsDiff
         }
     }
 
-    static std::map<std::string, VersionT> read_ports_from_commit(const VcpkgPaths& paths,
-                                                                  const std::string& git_commit_id)
+    static std::string git_output(const VcpkgPaths& paths, std::vector<std::string> arguments)
     {
-        std::error_code ec;
-        auto& fs = paths.get_filesystem();
         const fs::path& git_exe = paths.get_tool_exe(Tools::GIT);
-        const fs::path dot_git_dir = paths.root / ".git";
-        const std::string ports_dir_name_as_string = paths.ports.filename().u8string();
-        const fs::path temp_checkout_path =
-            paths.root / Strings::format("%s-%s", ports_dir_name_as_string, git_commit_id);
-        fs.create_directory(temp_checkout_path, ec);
-        const auto checkout_this_dir =
-            Strings::format(R"(.\%s)", ports_dir_name_as_string); // Must be relative to the root of the repository
-
-        const std::string cmd =
-            Strings::format(R"("%s" --git-dir="%s" --work-tree="%s" checkout %s -f -q -- %s %s & "%s" reset >NUL)",
-                            git_exe.u8string(),
-                            dot_git_dir.u8string(),
-                            temp_checkout_path.u8string(),
-                            git_commit_id,
-                            checkout_this_dir,
-                            ".vcpkg-root",
-                            git_exe.u8string());
-        System::cmd_execute_clean(cmd);
-        const auto all_ports =
-            Paragraphs::load_all_ports(paths.get_filesystem(), temp_checkout_path / ports_dir_name_as_string);
+        arguments.insert(arguments.begin(), "--git-dir=" + (paths.root / ".git").u8string());
+
+        std::string output;
+        std::string errors;
+        const auto exit = System::process_execute(
+            git_exe,
+            arguments,
+            [&](std::string_view data) { output.append(data.data(), data.size()); },
+            [&](std::string_view data) { errors.append(data.data(), data.size()); },
+            nullopt);
+        Checks::check_exit(VCPKG_LINE_INFO, exit.exit_code == 0, "Error: git %s failed:\n%s", arguments[1], errors);
+        return output;
+    }
+
+    struct ControlBlob
+    {
+        std::string port;
+        std::string object;
+        size_t size;
+    };
+
+    /// <summary>
+    /// The CONTROL file of every port directory in `tree`, listed by "git ls-tree -r -l -z", which prints entries
+    /// of the form "<mode> <type> <object> <size>\t<path>\0".
+    /// </summary>
+    static std::vector<ControlBlob> list_control_blobs(const VcpkgPaths& paths, const std::string& tree)
+    {
+        const std::string listing = git_output(paths, {"ls-tree", "-r", "-l", "-z", tree});
+
+        std::vector<ControlBlob> blobs;
+        size_t entry_begin = 0;
+        while (entry_begin < listing.size())
+        {
+            size_t entry_end = listing.find('\0', entry_begin);
+            if (entry_end == std::string::npos) entry_end = listing.size();
+            const std::string entry = listing.substr(entry_begin, entry_end - entry_begin);
+            entry_begin = entry_end + 1;
+
+            const auto tab = entry.find('\t');
+            if (tab == std::string::npos) continue;
+            const std::string path = entry.substr(tab + 1);
+            const auto slash = path.find('/');
+            if (slash == std::string::npos || path.compare(slash, std::string::npos, "/CONTROL") != 0) continue;
+
+            // The size is padded with spaces
+            auto fields = Strings::split(entry.substr(0, tab), " ");
+            Util::erase_remove_if(fields, [](const std::string& field) { return field.empty(); });
+            if (fields.size() != 4 || fields[1] != "blob") continue;
+
+            char* size_end = nullptr;
+            const auto size = std::strtoull(fields[3].c_str(), &size_end, 10);
+            if (*size_end != '\0') continue;
+            blobs.push_back({path.substr(0, slash), std::move(fields[2]), static_cast<size_t>(size)});
+        }
+        return blobs;
+    }
+
+    static std::vector<ControlBlob> list_control_blobs_of_commit(const VcpkgPaths& paths,
+                                                                 const std::string& git_commit_id)
+    {
+        return list_control_blobs(paths, Strings::format("%s:%s", git_commit_id, paths.ports.filename().u8string()));
+    }
+
+    /// <summary>
+    /// Drops the ports whose CONTROL file is the same object in both commits. Their versions are equal, so they need
+    /// not be read at all.
+    /// </summary>
+    static void remove_unchanged_ports(std::vector<ControlBlob>& left, std::vector<ControlBlob>& right)
+    {
+        const auto ids_of = [](const std::vector<ControlBlob>& blobs) {
+            std::set<std::pair<std::string, std::string>> ids;
+            for (auto&& blob : blobs)
+            {
+                ids.emplace(blob.port, blob.object);
+            }
+            return ids;
+        };
+        const auto left_ids = ids_of(left);
+        const auto right_ids = ids_of(right);
+
+        Util::erase_remove_if(left, [&](const ControlBlob& blob) {
+            return Util::Sets::contains(right_ids, std::make_pair(blob.port, blob.object));
+        });
+        Util::erase_remove_if(right, [&](const ControlBlob& blob) {
+            return Util::Sets::contains(left_ids, std::make_pair(blob.port, blob.object));
+        });
+    }
+
+    /// <summary>
+    /// Reads the versions of `blobs` straight from the git object store, so nothing is checked out.
+    /// </summary>
+    static std::map<std::string, VersionT> read_ports_from_commit(const VcpkgPaths& paths,
+                                                                  const std::string& git_commit_id,
+                                                                  const std::vector<ControlBlob>& blobs)
+    {
+        // git show prints the blobs back to back, and their sizes split them up again. They are passed in batches to
+        // stay well inside the command line length limit of Windows.
+        static constexpr size_t BATCH_SIZE = 512;
         std::map<std::string, VersionT> names_and_versions;
-        for (auto&& port : all_ports)
-            names_and_versions.emplace(port->core_paragraph->name, port->core_paragraph->version);
-        fs.remove_all(temp_checkout_path, ec);
+        for (size_t batch_begin = 0; batch_begin < blobs.size(); batch_begin += BATCH_SIZE)
+        {
+            const size_t batch_end = std::min(blobs.size(), batch_begin + BATCH_SIZE);
+            std::vector<std::string> arguments{"show"};
+            size_t expected_size = 0;
+            for (size_t i = batch_begin; i < batch_end; ++i)
+            {
+                arguments.push_back(blobs[i].object);
+                expected_size += blobs[i].size;
+            }
+
+            const std::string contents = git_output(paths, std::move(arguments));
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               contents.size() == expected_size,
+                               "Error: git show printed %zd bytes instead of %zd",
+                               contents.size(),
+                               expected_size);
+
+            size_t offset = 0;
+            for (size_t i = batch_begin; i < batch_end; ++i)
+            {
+                auto maybe_port = Paragraphs::parse_port(std::string_view(contents).substr(offset, blobs[i].size));
+                offset += blobs[i].size;
+                if (auto port = maybe_port.get())
+                {
+                    auto&& core = *(*port)->core_paragraph;
+                    names_and_versions.emplace(core.name, core.version);
+                }
+                else
+                {
+                    System::println(System::Color::warning,
+                                    "Warning: an error occurred while parsing '%s' at %s",
+                                    blobs[i].port,
+                                    git_commit_id);
+                }
+            }
+        }
         return names_and_versions;
     }
 
@@ -140,10 +249,14 @@ namespace vcpkg::Commands::PortsDiff
         check_commit_exists(git_exe, git_commit_id_for_current_snapshot);
         check_commit_exists(git_exe, git_commit_id_for_previous_snapshot);
 
+        auto current_blobs = list_control_blobs_of_commit(paths, git_commit_id_for_current_snapshot);
+        auto previous_blobs = list_control_blobs_of_commit(paths, git_commit_id_for_previous_snapshot);
+        remove_unchanged_ports(current_blobs, previous_blobs);
+
         const std::map<std::string, VersionT> current_names_and_versions =
-            read_ports_from_commit(paths, git_commit_id_for_current_snapshot);
+            read_ports_from_commit(paths, git_commit_id_for_current_snapshot, current_blobs);
         const std::map<std::string, VersionT> previous_names_and_versions =
-            read_ports_from_commit(paths, git_commit_id_for_previous_snapshot);
+            read_ports_from_commit(paths, git_commit_id_for_previous_snapshot, previous_blobs);
 
         // Already sorted, so set_difference can work on std::vector too
         const std::vector<std::string> current_ports = Util::extract_keys(current_names_and_versions);
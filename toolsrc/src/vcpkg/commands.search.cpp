@@ -1,5 +1,6 @@
 #include "pch.h"
 
+#include <vcpkg/base/json.h>
 #include <vcpkg/base/system.h>
 #include <vcpkg/commands.h>
 #include <vcpkg/globalstate.h>
@@ -12,7 +13,8 @@ namespace vcpkg::Commands::Search
 {
     static constexpr StringLiteral OPTION_FULLDESC =
         "--x-full-desc"; // TODO: This should find a better home, eventually
-    
+    static constexpr StringLiteral OPTION_JSON = "--x-json";
+
     static void do_print(const SourceParagraph& source_paragraph, bool full_desc)
     {
         if (full_desc)
@@ -43,16 +45,117 @@ namespace vcpkg::Commands::Search
         }
     }
 
-    static constexpr std::array<CommandSwitch, 1> SEARCH_SWITCHES = {{
+    /// <summary>
+    /// How well `term` matches one line of the results; 0 when it does not appear at all. Matching the whole name beats
+    /// a prefix of it, which beats anywhere in it, which beats the description.
+    /// </summary>
+    static int score_term(const std::string& name, const std::string& description, const std::string& term)
+    {
+        if (Strings::case_insensitive_ascii_equals(name, term)) return 8;
+        if (Strings::case_insensitive_ascii_starts_with(name, term)) return 4;
+        if (Strings::case_insensitive_ascii_contains(name, term)) return 2;
+        if (Strings::case_insensitive_ascii_contains(description, term)) return 1;
+        return 0;
+    }
+
+    /// <summary>
+    /// The sum of the scores of all terms, or 0 unless every one of them matches.
+    /// </summary>
+    template<class Score>
+    static int score_terms(const std::vector<std::string>& terms, Score score)
+    {
+        int total = 0;
+        for (auto&& term : terms)
+        {
+            const int term_score = score(term);
+            if (term_score == 0) return 0;
+            total += term_score;
+        }
+        return total;
+    }
+
+    struct Match
+    {
+        const SourceControlFile* port;
+        bool core;
+        std::vector<const FeatureParagraph*> features;
+        /// <summary>The best score of the port and its matching features.</summary>
+        int score;
+    };
+
+    static void write_json(Json::Writer& json,
+                           const SourceParagraph& source_paragraph,
+                           const std::vector<const FeatureParagraph*>& features)
+    {
+        json.start_object();
+        json.key("name").string(source_paragraph.name);
+        json.key("version").string(source_paragraph.version);
+        json.key("description").string(source_paragraph.description);
+        json.key("features").start_array();
+        for (auto&& feature_paragraph : features)
+        {
+            json.start_object();
+            json.key("name").string(feature_paragraph->name);
+            json.key("description").string(feature_paragraph->description);
+            json.end_object();
+        }
+        json.end_array();
+        json.end_object();
+    }
+
+    static std::vector<Match> find_matches(const std::vector<std::unique_ptr<SourceControlFile>>& ports,
+                                           const std::vector<std::string>& terms)
+    {
+        std::vector<Match> matches;
+        for (const auto& source_control_file : ports)
+        {
+            auto&& sp = *source_control_file->core_paragraph;
+            Match match{source_control_file.get(), false, {}, 0};
+
+            const int core_score =
+                score_terms(terms, [&](const std::string& term) { return score_term(sp.name, sp.description, term); });
+            if (core_score != 0)
+            {
+                match.core = true;
+                match.score = core_score;
+            }
+
+            // Features are listed along with their port when the port's name matches. A port found only through its
+            // features ranks with the ports found through their descriptions.
+            for (auto&& feature_paragraph : source_control_file->feature_paragraphs)
+            {
+                const bool is_match = std::all_of(terms.begin(), terms.end(), [&](const std::string& term) {
+                    return Strings::case_insensitive_ascii_contains(sp.name, term) ||
+                           score_term(feature_paragraph->name, feature_paragraph->description, term) != 0;
+                });
+                if (is_match)
+                {
+                    match.features.push_back(feature_paragraph.get());
+                    match.score = std::max(match.score, static_cast<int>(terms.size()));
+                }
+            }
+
+            if (match.score != 0) matches.push_back(std::move(match));
+        }
+
+        // Ports that score the same stay in alphabetical order
+        std::stable_sort(
+            matches.begin(), matches.end(), [](const Match& lhs, const Match& rhs) { return lhs.score > rhs.score; });
+        return matches;
+    }
+
+    static constexpr std::array<CommandSwitch, 2> SEARCH_SWITCHES = {{
         {OPTION_FULLDESC, "Do not truncate long text"},
+        {OPTION_JSON, "Print the libraries as a JSON array, best match first (experimental)"},
     }};
 
     const CommandStructure COMMAND_STRUCTURE = {
         Strings::format(
-            "The argument should be a substring to search for, or no argument to display all libraries.\n%s",
+            "The arguments should be substrings to search for, or no argument to display all libraries. Libraries "
+            "matching all of them are listed, best match first.\n%s",
             Help::create_example_string("search png")),
         0,
-        1,
+        SIZE_MAX,
         {SEARCH_SWITCHES, {}},
         nullptr,
     };
@@ -60,10 +163,39 @@ namespace vcpkg::Commands::Search
     void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths)
     {
         const ParsedArguments options = args.parse_arguments(COMMAND_STRUCTURE);
+        paths.cache_file_statuses();
         const bool full_description = Util::Sets::contains(options.switches, OPTION_FULLDESC);
 
         auto source_paragraphs = Paragraphs::load_all_ports(paths.get_filesystem(), paths.ports);
 
+        if (Util::Sets::contains(options.switches, OPTION_JSON))
+        {
+            // Each port is listed with its matching features, which are all of them when there are no terms
+            Json::Writer json;
+            json.start_array();
+            if (args.command_arguments.empty())
+            {
+                for (const auto& source_control_file : source_paragraphs)
+                {
+                    write_json(json,
+                               *source_control_file->core_paragraph,
+                               Util::fmap(source_control_file->feature_paragraphs,
+                                          [](auto&& feature_paragraph) -> const FeatureParagraph* {
+                                              return feature_paragraph.get();
+                                          }));
+                }
+            }
+            else
+            {
+                for (auto&& match : find_matches(source_paragraphs, args.command_arguments))
+                {
+                    write_json(json, *match.port->core_paragraph, match.features);
+                }
+            }
+            json.end_array();
+            Checks::exit_success(VCPKG_LINE_INFO);
+        }
+
         if (args.command_arguments.empty())
         {
             for (const auto& source_control_file : source_paragraphs)
@@ -77,27 +209,13 @@ namespace vcpkg::Commands::Search
         }
         else
         {
-            const auto& icontains = Strings::case_insensitive_ascii_contains;
-
-            // At this point there is 1 argument
-            auto&& args_zero = args.command_arguments[0];
-            for (const auto& source_control_file : source_paragraphs)
+            for (auto&& match : find_matches(source_paragraphs, args.command_arguments))
             {
-                auto&& sp = *source_control_file->core_paragraph;
-
-                const bool contains_name = icontains(sp.name, args_zero);
-                if (contains_name || icontains(sp.description, args_zero))
-                {
-                    do_print(sp, full_description);
-                }
-
-                for (auto&& feature_paragraph : source_control_file->feature_paragraphs)
+                auto&& sp = *match.port->core_paragraph;
+                if (match.core) do_print(sp, full_description);
+                for (auto&& feature_paragraph : match.features)
                 {
-                    if (contains_name || icontains(feature_paragraph->name, args_zero) ||
-                        icontains(feature_paragraph->description, args_zero))
-                    {
-                        do_print(sp.name, *feature_paragraph, full_description);
-                    }
+                    do_print(sp.name, *feature_paragraph, full_description);
                 }
             }
         }
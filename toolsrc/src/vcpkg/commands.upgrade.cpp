@@ -19,17 +19,21 @@ namespace vcpkg::Commands::Upgrade
 
     static constexpr StringLiteral OPTION_NO_DRY_RUN = "--no-dry-run";
     static constexpr StringLiteral OPTION_KEEP_GOING = "--keep-going";
+    static constexpr StringLiteral OPTION_JOBS = "--x-jobs";
 
     static constexpr std::array<CommandSwitch, 2> INSTALL_SWITCHES = {{
         {OPTION_NO_DRY_RUN, "Actually upgrade"},
         {OPTION_KEEP_GOING, "Continue installing packages on failure"},
     }};
+    static constexpr std::array<CommandSetting, 1> INSTALL_SETTINGS = {{
+        {OPTION_JOBS, "Number of packages to build concurrently, 0 for one per processor (experimental)"},
+    }};
 
     const CommandStructure COMMAND_STRUCTURE = {
         Help::create_example_string("upgrade --no-dry-run"),
         0,
         SIZE_MAX,
-        {INSTALL_SWITCHES, {}},
+        {INSTALL_SWITCHES, INSTALL_SETTINGS},
         nullptr,
     };
 
@@ -39,26 +43,22 @@ namespace vcpkg::Commands::Upgrade
 
         const bool no_dry_run = Util::Sets::contains(options.switches, OPTION_NO_DRY_RUN);
         const KeepGoing keep_going = to_keep_going(Util::Sets::contains(options.switches, OPTION_KEEP_GOING));
+        const size_t jobs = Install::get_job_count(options, OPTION_JOBS);
 
-        StatusParagraphs status_db = database_load_check(paths);
+        StatusParagraphs status_db =
+            database_load_check(paths, no_dry_run ? InstalledBase::IMPORT : InstalledBase::MERGE);
 
         Dependencies::PathsPortFileProvider provider(paths);
         Dependencies::PackageGraph graph(provider, status_db);
 
         // input sanitization
-        const std::vector<PackageSpec> specs = Util::fmap(args.command_arguments, [&](auto&& arg) {
-            return Input::check_and_get_package_spec(arg, default_triplet, COMMAND_STRUCTURE.example_text);
-        });
-
-        for (auto&& spec : specs)
-        {
-            Input::check_triplet(spec.triplet(), paths);
-        }
+        const std::vector<PackageSpec> specs = Input::check_and_get_package_specs(
+            args.command_arguments, default_triplet, COMMAND_STRUCTURE.example_text, paths);
 
         if (specs.empty())
         {
             // If no packages specified, upgrade all outdated packages.
-            auto outdated_packages = Update::find_outdated_packages(provider, status_db);
+            auto outdated_packages = Update::find_outdated_packages(paths, status_db);
 
             if (outdated_packages.empty())
             {
@@ -151,6 +151,7 @@ namespace vcpkg::Commands::Upgrade
             Build::DownloadTool::BUILT_IN,
             GlobalState::g_binary_caching ? Build::BinaryCaching::YES : Build::BinaryCaching::NO,
             Build::FailOnTombstone::NO,
+            Build::Incremental::NO,
         };
 
         // Set build settings for all install actions
@@ -172,7 +173,8 @@ namespace vcpkg::Commands::Upgrade
             Checks::exit_fail(VCPKG_LINE_INFO);
         }
 
-        const Install::InstallSummary summary = Install::perform(plan, keep_going, paths, status_db);
+        Install::plan_abi_tags(paths, plan);
+        const Install::InstallSummary summary = Install::perform(plan, keep_going, paths, status_db, jobs);
 
         System::println("\nTotal elapsed time: %s\n", summary.total_elapsed_time);
 
@@ -0,0 +1,302 @@
+#include "pch.h"
+
+#include <vcpkg/base/cofffilereader.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/commands.h>
+#include <vcpkg/help.h>
+
+namespace vcpkg::Commands::X_AppLocal
+{
+    static constexpr StringLiteral OPTION_TARGET_BINARY = "--target-binary";
+    static constexpr StringLiteral OPTION_INSTALLED_DIR = "--installed-dir";
+    static constexpr StringLiteral OPTION_TLOG_FILE = "--tlog-file";
+    static constexpr StringLiteral OPTION_COPIED_FILES_LOG = "--copied-files-log";
+
+    static constexpr std::array<CommandSetting, 4> APPLOCAL_SETTINGS = {{
+        {OPTION_TARGET_BINARY, "Executable or DLL to deploy the dependencies of"},
+        {OPTION_INSTALLED_DIR, "bin directory of the installed triplet to deploy DLLs from"},
+        {OPTION_TLOG_FILE, "MSBuild tracking log to append the deployed files to"},
+        {OPTION_COPIED_FILES_LOG, "File to write the deployed files to, one per line"},
+    }};
+
+    const CommandStructure COMMAND_STRUCTURE = {
+        Help::create_example_string(
+            R"(x-applocal --target-binary=out\app.exe --installed-dir=installed\x64-windows\bin)"),
+        0,
+        0,
+        {{}, APPLOCAL_SETTINGS},
+        nullptr,
+    };
+
+#if defined(_WIN32)
+    // Installed trees that contain these also deploy plugins, which only applocal.ps1 knows how to do
+    static constexpr std::array<StringLiteral, 4> DEPLOY_SCRIPTS = {{
+        "plugins/qtdeploy.ps1",
+        "bin/OpenNI2/openni2deploy.ps1",
+        "bin/magnum/magnumdeploy.ps1",
+        "bin/magnum-d/magnumdeploy.ps1",
+    }};
+
+    static std::string to_lower(std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(), [](char c) { return static_cast<char>(::tolower(c)); });
+        return s;
+    }
+
+    /// <summary>
+    /// The imports of the DLLs in an installed bin directory, kept in a file in that directory so that a link does
+    /// not read installed DLLs that an earlier link has read already. Entries are keyed by size and write time.
+    /// </summary>
+    struct ImportCache
+    {
+        ImportCache(Files::Filesystem& fs, const fs::path& bin_dir)
+            : m_fs(fs), m_bin_dir(bin_dir), m_cache_file(bin_dir / "vcpkg-applocal.cache")
+        {
+            auto maybe_lines = m_fs.read_lines(m_cache_file);
+            const auto p_lines = maybe_lines.get();
+            if (!p_lines) return;
+
+            // Each line is name|size|write time|import|import...; '|' cannot appear in a file name
+            for (auto&& line : *p_lines)
+            {
+                auto fields = Strings::split(line, "|");
+                if (fields.size() < 3) continue;
+
+                Entry entry;
+                entry.size = std::strtoull(fields[1].c_str(), nullptr, 10);
+                entry.write_time = std::strtoll(fields[2].c_str(), nullptr, 10);
+                entry.imports.assign(std::make_move_iterator(fields.begin() + 3),
+                                     std::make_move_iterator(fields.end()));
+                m_entries.emplace(to_lower(fields[0]), std::move(entry));
+            }
+        }
+
+        const std::vector<std::string>& imports_of(const std::string& dll)
+        {
+            const fs::path path = m_bin_dir / fs::u8path(dll);
+            std::error_code size_ec;
+            std::error_code time_ec;
+            const uintmax_t size = fs::stdfs::file_size(path, size_ec);
+            const long long write_time = fs::stdfs::last_write_time(path, time_ec).time_since_epoch().count();
+
+            Entry& entry = m_entries[to_lower(dll)];
+            if (size_ec || time_ec || entry.size != size || entry.write_time != write_time)
+            {
+                entry.size = size;
+                entry.write_time = write_time;
+                entry.imports = CoffFileReader::read_dll(m_fs, path).dependencies;
+                m_dirty = true;
+            }
+            return entry.imports;
+        }
+
+        void save()
+        {
+            if (!m_dirty) return;
+
+            std::string contents;
+            for (auto&& entry : m_entries)
+            {
+                contents += Strings::format("%s|%llu|%lld", entry.first, entry.second.size, entry.second.write_time);
+                for (auto&& import : entry.second.imports)
+                {
+                    contents.append("|").append(import);
+                }
+                contents.push_back('\n');
+            }
+
+            // Links of other targets may save the cache at the same time; the last one to finish wins
+            const fs::path temp_file =
+                m_cache_file.parent_path() / Strings::format("vcpkg-applocal.cache.%lu.tmp", GetCurrentProcessId());
+            std::error_code ec;
+            m_fs.write_contents(temp_file, contents, ec);
+            if (!ec) m_fs.rename(temp_file, m_cache_file, ec);
+            if (ec) m_fs.remove(temp_file, ec);
+        }
+
+    private:
+        struct Entry
+        {
+            uintmax_t size = 0;
+            long long write_time = 0;
+            std::vector<std::string> imports;
+        };
+
+        Files::Filesystem& m_fs;
+        fs::path m_bin_dir;
+        fs::path m_cache_file;
+        std::map<std::string, Entry> m_entries;
+        bool m_dirty = false;
+    };
+
+    /// <summary>
+    /// Copies the installed DLLs that a binary imports, directly or through other DLLs, next to it. Follows the
+    /// imports the same way applocal.ps1 does.
+    /// </summary>
+    struct AppLocalDeployer
+    {
+        AppLocalDeployer(Files::Filesystem& fs, const fs::path& installed_bin, const fs::path& target_dir)
+            : m_fs(fs), m_installed_bin(installed_bin), m_target_dir(target_dir), m_cache(fs, installed_bin)
+        {
+        }
+
+        void resolve(const std::vector<std::string>& imports, const fs::path& local_dir)
+        {
+            for (auto&& dll : imports)
+            {
+                if (!m_searched.insert(to_lower(dll)).second) continue;
+
+                if (m_fs.exists(m_installed_bin / fs::u8path(dll)))
+                {
+                    deploy(dll);
+                    resolve(m_cache.imports_of(dll), m_target_dir);
+                }
+                else if (m_fs.exists(local_dir / fs::u8path(dll)))
+                {
+                    Debug::println("%s: not found in vcpkg; locally deployed", dll);
+                    resolve(CoffFileReader::read_dll(m_fs, local_dir / fs::u8path(dll)).dependencies, local_dir);
+                }
+            }
+        }
+
+        ImportCache& cache() { return m_cache; }
+
+        const std::vector<fs::path>& deployed() const { return m_deployed; }
+
+    private:
+        void deploy(const std::string& dll)
+        {
+            const fs::path source = m_installed_bin / fs::u8path(dll);
+            const fs::path destination = m_target_dir / fs::u8path(dll);
+            if (!m_fs.exists(destination))
+            {
+                // A hard link costs nothing, but only works on the volume of the installed tree
+                std::error_code ec;
+                m_fs.create_hard_link(source, destination, ec);
+                if (ec)
+                {
+                    m_fs.copy_file(source, destination, fs::copy_options::none, ec);
+                    Checks::check_exit(VCPKG_LINE_INFO,
+                                       !ec,
+                                       "Failed to copy %s to %s: %s",
+                                       source.u8string(),
+                                       destination.u8string(),
+                                       ec.message());
+                }
+                Debug::println("%s: deployed from %s", dll, source.u8string());
+            }
+            m_deployed.push_back(destination);
+        }
+
+        Files::Filesystem& m_fs;
+        fs::path m_installed_bin;
+        fs::path m_target_dir;
+        ImportCache m_cache;
+        std::set<std::string> m_searched;
+        std::vector<fs::path> m_deployed;
+    };
+
+    /// <summary>Appends lines to an MSBuild tracking log, in UTF-16 if the log was created that way.</summary>
+    static void append_to_tlog(Files::Filesystem& fs, const fs::path& tlog, const std::vector<fs::path>& files)
+    {
+        if (files.empty()) return;
+
+        auto maybe_existing = fs.read_contents(tlog);
+        const auto p_existing = maybe_existing.get();
+        const bool is_utf16 = p_existing && p_existing->compare(0, 2, "\xFF\xFE") == 0;
+
+        std::string lines;
+        for (auto&& file : files)
+        {
+            lines.append(file.u8string()).append("\r\n");
+        }
+        if (is_utf16)
+        {
+            const std::wstring wide = Strings::to_utf16(lines);
+            lines.assign(reinterpret_cast<const char*>(wide.data()), wide.size() * sizeof(wchar_t));
+        }
+
+        std::error_code ec;
+        fs.append_contents(tlog, lines, ec);
+        Checks::check_exit(VCPKG_LINE_INFO, !ec, "Failed to write %s: %s", tlog.u8string(), ec.message());
+    }
+
+    /// <summary>Runs applocal.ps1 with the same arguments, for installed trees that have deploy scripts.</summary>
+    [[noreturn]] static void run_applocal_ps1(Files::Filesystem& fs, const ParsedArguments& options)
+    {
+        const fs::path root =
+            fs.find_file_recursively_up(System::get_exe_path_of_current_process().parent_path(), ".vcpkg-root");
+        Checks::check_exit(VCPKG_LINE_INFO, !root.empty(), "Error: Could not detect vcpkg-root.");
+
+        std::string cmd_line = Strings::format(R"(powershell -noprofile -executionpolicy Bypass -file "%s")",
+                                               (root / "scripts/buildsystems/msbuild/applocal.ps1").u8string());
+        const auto append_argument = [&](const StringLiteral& option, const char* parameter) {
+            const auto it = options.settings.find(option);
+            if (it != options.settings.end()) cmd_line += Strings::format(R"( %s "%s")", parameter, it->second);
+        };
+        append_argument(OPTION_TARGET_BINARY, "-targetBinary");
+        append_argument(OPTION_INSTALLED_DIR, "-installedDir");
+        append_argument(OPTION_TLOG_FILE, "-tlogFile");
+        append_argument(OPTION_COPIED_FILES_LOG, "-copiedFilesLog");
+
+        const int exit_code = System::cmd_execute(cmd_line);
+        Checks::exit_with_code(VCPKG_LINE_INFO, exit_code);
+    }
+#endif
+
+    void perform_and_exit(const VcpkgCmdArguments& args)
+    {
+#if defined(_WIN32)
+        const ParsedArguments options = args.parse_arguments(COMMAND_STRUCTURE);
+
+        const auto get_setting = [&](const StringLiteral& option) -> Optional<fs::path> {
+            const auto it = options.settings.find(option);
+            if (it == options.settings.end()) return nullopt;
+            return fs::stdfs::absolute(fs::u8path(it->second));
+        };
+        const auto target_binary = get_setting(OPTION_TARGET_BINARY);
+        const auto installed_bin = get_setting(OPTION_INSTALLED_DIR);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           target_binary.has_value() && installed_bin.has_value(),
+                           "Error: %s and %s are required.\n%s",
+                           OPTION_TARGET_BINARY,
+                           OPTION_INSTALLED_DIR,
+                           COMMAND_STRUCTURE.example_text);
+
+        auto& fs = Files::get_real_filesystem();
+
+        const fs::path install_root = installed_bin.value_or_exit(VCPKG_LINE_INFO).parent_path();
+        if (std::any_of(DEPLOY_SCRIPTS.begin(), DEPLOY_SCRIPTS.end(), [&](const StringLiteral& script) {
+                return fs.exists(install_root / fs::u8path(script.c_str()));
+            }))
+        {
+            run_applocal_ps1(fs, options);
+        }
+
+        // The copied files log is expected even when nothing is deployed
+        const auto copied_files_log = get_setting(OPTION_COPIED_FILES_LOG);
+        if (const auto p_log = copied_files_log.get()) fs.write_contents(*p_log, "");
+
+        const fs::path& target = target_binary.value_or_exit(VCPKG_LINE_INFO);
+        if (!fs.is_regular_file(target)) Checks::exit_success(VCPKG_LINE_INFO);
+
+        AppLocalDeployer deployer(fs, installed_bin.value_or_exit(VCPKG_LINE_INFO), target.parent_path());
+        deployer.resolve(CoffFileReader::read_dll(fs, target).dependencies, target.parent_path());
+        deployer.cache().save();
+
+        if (const auto p_log = copied_files_log.get())
+        {
+            fs.write_lines(*p_log, Util::fmap(deployer.deployed(), [](const fs::path& p) { return p.u8string(); }));
+        }
+        if (const auto p_tlog = get_setting(OPTION_TLOG_FILE).get())
+        {
+            append_to_tlog(fs, *p_tlog, deployer.deployed());
+        }
+
+        Checks::exit_success(VCPKG_LINE_INFO);
+#else
+        Util::unused(args);
+        Checks::exit_with_message(VCPKG_LINE_INFO, "This command is not supported on non-windows platforms.");
+#endif
+    }
+}
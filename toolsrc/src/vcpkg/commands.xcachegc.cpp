@@ -0,0 +1,56 @@
+#include "pch.h"
+
+#include <vcpkg/base/system.h>
+#include <vcpkg/binarycaching.h>
+#include <vcpkg/commands.h>
+#include <vcpkg/help.h>
+#include <vcpkg/vcpkgpaths.h>
+
+namespace vcpkg::Commands::X_CacheGc
+{
+    static constexpr StringLiteral OPTION_MAX_SIZE = "--max-size";
+
+    static constexpr std::array<CommandSetting, 1> CACHE_GC_SETTINGS = {{
+        {OPTION_MAX_SIZE, "Size to shrink the archives directory to, e.g. 200G (default: VCPKG_BINARY_CACHE_MAX_SIZE)"},
+    }};
+
+    const CommandStructure COMMAND_STRUCTURE = {
+        Help::create_example_string("x-cache-gc --max-size=200G"),
+        0,
+        0,
+        {{}, CACHE_GC_SETTINGS},
+        nullptr,
+    };
+
+    void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths)
+    {
+        const ParsedArguments options = args.parse_arguments(COMMAND_STRUCTURE);
+
+        Optional<std::string> maybe_max_size;
+        const auto it_max_size = options.settings.find(OPTION_MAX_SIZE);
+        if (it_max_size != options.settings.end())
+            maybe_max_size = it_max_size->second;
+        else
+            maybe_max_size = System::get_environment_variable("VCPKG_BINARY_CACHE_MAX_SIZE");
+
+        const auto p_max_size = maybe_max_size.get();
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           p_max_size != nullptr,
+                           "Error: %s or VCPKG_BINARY_CACHE_MAX_SIZE is required.\n%s",
+                           OPTION_MAX_SIZE,
+                           COMMAND_STRUCTURE.example_text);
+
+        const auto maybe_size = parse_cache_size(*p_max_size);
+        const auto p_size = maybe_size.get();
+        Checks::check_exit(VCPKG_LINE_INFO, p_size != nullptr, "Error: %s", maybe_size.error());
+
+        const auto result = paths.get_binary_cache().collect_garbage(*p_size);
+        System::println("Removed %zd files (%s MiB); %s MiB remain in %s",
+                        result.removed_files,
+                        std::to_string(result.removed_bytes >> 20),
+                        std::to_string(result.remaining_bytes >> 20),
+                        (paths.root / "archives").u8string());
+
+        Checks::exit_success(VCPKG_LINE_INFO);
+    }
+}
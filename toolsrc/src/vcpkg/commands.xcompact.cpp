@@ -0,0 +1,27 @@
+#include "pch.h"
+
+#include <vcpkg/base/system.h>
+#include <vcpkg/commands.h>
+#include <vcpkg/help.h>
+#include <vcpkg/vcpkglib.h>
+
+namespace vcpkg::Commands::X_Compact
+{
+    const CommandStructure COMMAND_STRUCTURE = {
+        Help::create_example_string("x-compact"),
+        0,
+        0,
+        {{}, {}},
+        nullptr,
+    };
+
+    void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths)
+    {
+        args.parse_arguments(COMMAND_STRUCTURE);
+
+        database_compact(paths);
+        System::println("Compacted %s", paths.vcpkg_dir_status_file.u8string());
+
+        Checks::exit_success(VCPKG_LINE_INFO);
+    }
+}
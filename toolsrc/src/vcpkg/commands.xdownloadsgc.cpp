@@ -0,0 +1,64 @@
+#include "pch.h"
+
+#include <vcpkg/base/system.h>
+#include <vcpkg/binarycaching.h>
+#include <vcpkg/commands.h>
+#include <vcpkg/downloadreferences.h>
+#include <vcpkg/help.h>
+#include <vcpkg/vcpkgpaths.h>
+
+namespace vcpkg::Commands::X_DownloadsGc
+{
+    static constexpr StringLiteral OPTION_KEEP_UNREFERENCED = "--keep-unreferenced";
+    static constexpr StringLiteral OPTION_DRY_RUN = "--dry-run";
+
+    static constexpr StringLiteral DEFAULT_KEEP_UNREFERENCED = "4G";
+
+    static constexpr std::array<CommandSwitch, 1> DOWNLOADS_GC_SWITCHES = {{
+        {OPTION_DRY_RUN, "List the files to remove without removing them"},
+    }};
+
+    static constexpr std::array<CommandSetting, 1> DOWNLOADS_GC_SETTINGS = {{
+        {OPTION_KEEP_UNREFERENCED,
+         "Size of the most recently used downloads no current port uses to keep, e.g. 10G (default: "
+         "VCPKG_DOWNLOADS_MAX_SIZE, or 4G)"},
+    }};
+
+    const CommandStructure COMMAND_STRUCTURE = {
+        Help::create_example_string("x-downloads-gc --keep-unreferenced=10G"),
+        0,
+        0,
+        {DOWNLOADS_GC_SWITCHES, DOWNLOADS_GC_SETTINGS},
+        nullptr,
+    };
+
+    void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths)
+    {
+        const ParsedArguments options = args.parse_arguments(COMMAND_STRUCTURE);
+        const bool dry_run = Util::Sets::contains(options.switches, OPTION_DRY_RUN);
+
+        std::string keep_unreferenced;
+        const auto it_keep_unreferenced = options.settings.find(OPTION_KEEP_UNREFERENCED);
+        if (it_keep_unreferenced != options.settings.end())
+            keep_unreferenced = it_keep_unreferenced->second;
+        else
+            keep_unreferenced = System::get_environment_variable("VCPKG_DOWNLOADS_MAX_SIZE")
+                                    .value_or(DEFAULT_KEEP_UNREFERENCED.c_str());
+
+        const auto maybe_size = parse_cache_size(keep_unreferenced);
+        const auto p_size = maybe_size.get();
+        Checks::check_exit(VCPKG_LINE_INFO, p_size != nullptr, "Error: %s", maybe_size.error());
+
+        const auto result = DownloadReferences::collect_garbage(paths, *p_size, dry_run);
+        System::println("%s %zd files (%s MiB); %s MiB used by the current ports and %s MiB of other recent downloads "
+                        "remain in %s",
+                        dry_run ? "Would remove" : "Removed",
+                        result.removed_files,
+                        std::to_string(result.removed_bytes >> 20),
+                        std::to_string(result.referenced_bytes >> 20),
+                        std::to_string(result.unreferenced_bytes >> 20),
+                        paths.downloads.u8string());
+
+        Checks::exit_success(VCPKG_LINE_INFO);
+    }
+}
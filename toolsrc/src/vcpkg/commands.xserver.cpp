@@ -0,0 +1,576 @@
+#include "pch.h"
+
+#include <vcpkg/base/files.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/commands.h>
+#include <vcpkg/help.h>
+#include <vcpkg/paragraphs.h>
+#include <vcpkg/vcpkglib.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+namespace vcpkg::Commands::X_Server
+{
+    static constexpr StringLiteral OPTION_SOCKET = "--socket";
+
+    static constexpr std::array<CommandSetting, 1> SERVER_SETTINGS = {{
+        {OPTION_SOCKET, "Path of the socket to listen on (default: installed/vcpkg/server.sock)"},
+    }};
+
+    const CommandStructure COMMAND_STRUCTURE = {
+        Help::create_example_string("x-server --socket=/tmp/vcpkg.sock"),
+        0,
+        0,
+        {{}, SERVER_SETTINGS},
+        nullptr,
+    };
+
+    // Only set in the processes forked for requests
+    static const VcpkgPaths* g_warm_paths = nullptr;
+
+    /// <summary>
+    /// The commands the server runs: they only read the tree, which is what the warm state is for. Everything else,
+    /// and above all anything that changes installed/, runs in the client as it always did.
+    /// </summary>
+    static constexpr StringLiteral SERVED_COMMANDS[] = {"list", "search", "owns", "depend-info"};
+
+    bool is_served(const std::string& command, const std::vector<std::string>& args)
+    {
+        const auto is_command = [&](const StringLiteral& name) {
+            return Strings::case_insensitive_ascii_equals(command, name);
+        };
+        if (std::any_of(std::begin(SERVED_COMMANDS), std::end(SERVED_COMMANDS), is_command)) return true;
+        // Planning an install reads as much as the commands above, and changes nothing with --dry-run
+        return is_command("install") && std::find(args.begin(), args.end(), "--dry-run") != args.end();
+    }
+
+    const VcpkgPaths* find_warm_paths(const fs::path& root)
+    {
+        std::error_code ec;
+        if (g_warm_paths && fs::stdfs::equivalent(g_warm_paths->root, root, ec)) return g_warm_paths;
+        return nullptr;
+    }
+
+#if !defined(_WIN32)
+    namespace
+    {
+        struct WarmState
+        {
+            std::unique_ptr<VcpkgPaths> paths;
+            std::string fingerprint;
+        };
+
+        /// <summary>
+        /// The client's working directory, environment and arguments, and its stdin, stdout and stderr.
+        /// </summary>
+        struct Request
+        {
+            std::string cwd;
+            std::vector<std::string> environment;
+            std::vector<std::string> args;
+            int fds[3] = {-1, -1, -1};
+
+            void close_fds()
+            {
+                for (int& fd : fds)
+                {
+                    if (fd >= 0) close(fd);
+                    fd = -1;
+                }
+            }
+        };
+
+        union FdsControl
+        {
+            cmsghdr header;
+            char buffer[CMSG_SPACE(sizeof(int) * 3)];
+        };
+    }
+
+#if defined(MSG_NOSIGNAL)
+    static constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    static constexpr int SEND_FLAGS = 0;
+#endif
+
+    /// <summary>Requests larger than this are refused; real command lines and environments are far smaller.</summary>
+    static constexpr uint32_t MAX_REQUEST_SIZE = 4 * 1024 * 1024;
+
+    /// <summary>How long a client may take to send its request once it has connected.</summary>
+    static constexpr int REQUEST_TIMEOUT_SECONDS = 10;
+
+    static void add_to_fingerprint(std::string& fingerprint, const fs::path& path)
+    {
+        std::error_code ec;
+        const auto write_time = fs::stdfs::last_write_time(path, ec).time_since_epoch().count();
+        if (ec)
+        {
+            fingerprint.append("-\n");
+            return;
+        }
+
+        auto size = fs::stdfs::file_size(path, ec);
+        if (ec) size = 0;
+        Strings::append_to(fingerprint,
+                           "%s %lld %llu\n",
+                           path.u8string(),
+                           static_cast<long long>(write_time),
+                           static_cast<unsigned long long>(size));
+    }
+
+    /// <summary>
+    /// The write times and sizes of everything the warm state was read from. Taking it costs a stat per port, which
+    /// is far cheaper than loading the ports, and unlike change notifications it cannot miss an event.
+    /// </summary>
+    static std::string take_fingerprint(const VcpkgPaths& paths)
+    {
+        std::string fingerprint;
+        add_to_fingerprint(fingerprint, paths.ports);
+        for (auto&& port_dir : paths.get_filesystem().get_files_non_recursive(paths.ports))
+        {
+            add_to_fingerprint(fingerprint, port_dir / "CONTROL");
+        }
+        add_to_fingerprint(fingerprint, paths.triplets);
+        add_to_fingerprint(fingerprint, paths.vcpkg_dir_status_file);
+        add_to_fingerprint(fingerprint, paths.vcpkg_dir_updates);
+        add_to_fingerprint(fingerprint, paths.downloads / "tools");
+        return fingerprint;
+    }
+
+    static void warm_up(WarmState& state, const fs::path& root)
+    {
+        state.paths.reset();
+
+        const auto default_vs_path = System::get_environment_variable("VCPKG_DEFAULT_VS_PATH").value_or("");
+        auto maybe_paths = VcpkgPaths::create(root, default_vs_path);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           !maybe_paths.error(),
+                           "Error: Invalid vcpkg root directory %s: %s",
+                           root.u8string(),
+                           maybe_paths.error().message());
+        state.paths = std::make_unique<VcpkgPaths>(std::move(maybe_paths).value_or_exit(VCPKG_LINE_INFO));
+
+        const VcpkgPaths& paths = *state.paths;
+        paths.get_available_triplets();
+        paths.get_tool_exe(Tools::CMAKE);
+        database_preload(paths);
+        Paragraphs::preload_all_ports(paths.get_filesystem(), paths.ports);
+
+        state.fingerprint = take_fingerprint(paths);
+    }
+
+    static bool write_all(const int fd, const char* data, size_t size)
+    {
+        while (size != 0)
+        {
+            const auto written = send(fd, data, size, SEND_FLAGS);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return false;
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    static bool read_all(const int fd, char* data, size_t size)
+    {
+        while (size != 0)
+        {
+            const auto count = read(fd, data, size);
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0) return false;
+            data += count;
+            size -= static_cast<size_t>(count);
+        }
+        return true;
+    }
+
+    static Optional<sockaddr_un> make_address(const std::string& socket_path)
+    {
+        sockaddr_un address{};
+        if (socket_path.size() >= sizeof(address.sun_path)) return nullopt;
+        address.sun_family = AF_UNIX;
+        std::copy(socket_path.begin(), socket_path.end(), address.sun_path);
+        return address;
+    }
+
+    static int connect_to(const std::string& socket_path)
+    {
+        const auto maybe_address = make_address(socket_path);
+        const auto p_address = maybe_address.get();
+        if (!p_address) return -1;
+
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (connect(fd, reinterpret_cast<const sockaddr*>(p_address), sizeof(*p_address)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    static int listen_on(const std::string& socket_path)
+    {
+        const auto maybe_address = make_address(socket_path);
+        const auto p_address = maybe_address.get();
+        Checks::check_exit(
+            VCPKG_LINE_INFO, p_address != nullptr, "Error: the socket path is too long: %s", socket_path);
+
+        // A socket left behind by a server that is gone is replaced; one that still answers is not
+        struct stat st;
+        if (lstat(socket_path.c_str(), &st) == 0)
+        {
+            Checks::check_exit(
+                VCPKG_LINE_INFO, S_ISSOCK(st.st_mode), "Error: %s exists and is not a socket", socket_path);
+            const int probe = connect_to(socket_path);
+            if (probe >= 0) close(probe);
+            Checks::check_exit(
+                VCPKG_LINE_INFO, probe < 0, "Error: a vcpkg server is already listening on %s", socket_path);
+            unlink(socket_path.c_str());
+        }
+
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        Checks::check_exit(VCPKG_LINE_INFO, fd >= 0, "Error: failed to create a socket: %s", strerror(errno));
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        // Requests run with the rights of the server, so only its user may connect
+        const mode_t old_mask = umask(0077);
+        const int bound = bind(fd, reinterpret_cast<const sockaddr*>(p_address), sizeof(*p_address));
+        umask(old_mask);
+        Checks::check_exit(
+            VCPKG_LINE_INFO, bound == 0, "Error: failed to listen on %s: %s", socket_path, strerror(errno));
+        Checks::check_exit(
+            VCPKG_LINE_INFO, listen(fd, 64) == 0, "Error: failed to listen on %s: %s", socket_path, strerror(errno));
+        return fd;
+    }
+
+    // A request is a 4 byte length and that many bytes of NUL terminated strings: the working directory, the
+    // NAME=VALUE entries of the environment, an empty string, and the arguments. The client's stdin, stdout and stderr
+    // travel with the length.
+
+    static bool send_request(const int fd, const std::vector<std::string>& args)
+    {
+        std::string payload = fs::stdfs::current_path().u8string();
+        payload.push_back('\0');
+        for (char** entry = environ; *entry; ++entry)
+        {
+            if (**entry == '\0') continue;
+            payload.append(*entry);
+            payload.push_back('\0');
+        }
+        payload.push_back('\0');
+        for (auto&& arg : args)
+        {
+            payload.append(arg);
+            payload.push_back('\0');
+        }
+
+        uint32_t size = static_cast<uint32_t>(payload.size());
+        iovec iov{&size, sizeof(size)};
+        FdsControl control{};
+        msghdr message{};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof(control.buffer);
+
+        const int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+        cmsghdr* header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(fds));
+        std::memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+        if (sendmsg(fd, &message, SEND_FLAGS) != static_cast<ssize_t>(sizeof(size))) return false;
+        return write_all(fd, payload.data(), payload.size());
+    }
+
+    static bool receive_request(const int fd, Request& request)
+    {
+        uint32_t size = 0;
+        iovec iov{&size, sizeof(size)};
+        FdsControl control{};
+        msghdr message{};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof(control.buffer);
+
+        const auto received = recvmsg(fd, &message, 0);
+
+        for (cmsghdr* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header))
+        {
+            if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) continue;
+            const size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            std::vector<int> fds(count);
+            std::memcpy(fds.data(), CMSG_DATA(header), count * sizeof(int));
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (i < 3 && request.fds[i] < 0)
+                    request.fds[i] = fds[i];
+                else
+                    close(fds[i]);
+            }
+        }
+
+        const bool has_fds = std::all_of(std::begin(request.fds), std::end(request.fds), [](int f) { return f >= 0; });
+        if (received != static_cast<ssize_t>(sizeof(size)) || !has_fds || size == 0 || size > MAX_REQUEST_SIZE)
+            return false;
+
+        std::string payload(size, '\0');
+        if (!read_all(fd, &payload[0], payload.size()) || payload.back() != '\0') return false;
+
+        std::vector<std::string> strings;
+        for (size_t pos = 0; pos < payload.size();)
+        {
+            const size_t end = payload.find('\0', pos);
+            strings.emplace_back(payload, pos, end - pos);
+            pos = end + 1;
+        }
+
+        const auto environment_end = std::find(strings.begin() + 1, strings.end(), std::string());
+        if (environment_end == strings.end()) return false;
+        request.cwd = std::move(strings.front());
+        request.environment.assign(std::make_move_iterator(strings.begin() + 1),
+                                   std::make_move_iterator(environment_end));
+        request.args.assign(std::make_move_iterator(environment_end + 1), std::make_move_iterator(strings.end()));
+        return true;
+    }
+
+    /// <summary>Replaces the environment of this process with the client's.</summary>
+    static void apply_environment(const std::vector<std::string>& environment)
+    {
+        std::vector<std::string> names;
+        for (char** entry = environ; *entry; ++entry)
+        {
+            const char* const equals = std::strchr(*entry, '=');
+            if (equals) names.emplace_back(static_cast<const char*>(*entry), equals);
+        }
+        for (auto&& name : names)
+        {
+            unsetenv(name.c_str());
+        }
+
+        for (auto&& entry : environment)
+        {
+            const auto equals = entry.find('=');
+            if (equals == 0 || equals == std::string::npos) continue;
+            setenv(entry.substr(0, equals).c_str(), entry.c_str() + equals + 1, 1);
+        }
+    }
+
+    static int g_worker_exited[2] = {-1, -1};
+
+    static void on_worker_exited(int)
+    {
+        const char c = 0;
+        (void)!write(g_worker_exited[1], &c, 1);
+    }
+
+    /// <summary>
+    /// Waits for the worker in the process between it and the server, sends its exit code to the client, and stops
+    /// the worker if the client hangs up first, e.g. on Ctrl+C.
+    /// </summary>
+    static int supervise(const int connection, const pid_t worker)
+    {
+        pollfd events[2] = {{g_worker_exited[0], POLLIN, 0}, {connection, POLLIN, 0}};
+        int status = 0;
+        while (true)
+        {
+            const pid_t waited = waitpid(worker, &status, WNOHANG);
+            if (waited == worker) break;
+            if (waited < 0 && errno != EINTR) return EXIT_FAILURE;
+
+            if (poll(events, 2, -1) < 0) continue;
+            if (events[1].revents != 0)
+            {
+                kill(worker, SIGTERM);
+                while (waitpid(worker, &status, 0) < 0 && errno == EINTR)
+                {
+                }
+                return EXIT_SUCCESS;
+            }
+            char drained[16];
+            if (events[0].revents != 0) (void)!read(g_worker_exited[0], drained, sizeof(drained));
+        }
+
+        int32_t exit_code = EXIT_FAILURE;
+        if (WIFEXITED(status)) exit_code = WEXITSTATUS(status);
+        if (WIFSIGNALED(status)) exit_code = 128 + WTERMSIG(status);
+        write_all(connection, reinterpret_cast<const char*>(&exit_code), sizeof(exit_code));
+        return EXIT_SUCCESS;
+    }
+
+    /// <summary>
+    /// Forks the supervisor, which reads the request, and from it the worker. Returns true in the worker, whose
+    /// standard streams, working directory and environment are the client's by then, and false in the server. The
+    /// supervisor does not return. Reading the request after the fork keeps a slow client from holding up the others.
+    /// </summary>
+    static bool fork_request(const int listener, const int connection, Request& request)
+    {
+        fflush(stdout);
+        fflush(stderr);
+
+        const pid_t supervisor = fork();
+        if (supervisor < 0) System::println(System::Color::error, "Error: fork failed: %s", strerror(errno));
+        if (supervisor != 0) return false;
+
+        close(listener);
+
+        timeval timeout{REQUEST_TIMEOUT_SECONDS, 0};
+        setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (!receive_request(connection, request)) _exit(EXIT_FAILURE);
+        timeout = timeval{0, 0};
+        setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        struct sigaction handler = {};
+        handler.sa_handler = on_worker_exited;
+        handler.sa_flags = SA_NOCLDSTOP;
+        if (pipe(g_worker_exited) != 0 || sigaction(SIGCHLD, &handler, nullptr) != 0) _exit(EXIT_FAILURE);
+
+        const pid_t worker = fork();
+        if (worker == 0)
+        {
+            signal(SIGCHLD, SIG_DFL);
+            close(g_worker_exited[0]);
+            close(g_worker_exited[1]);
+            close(connection);
+            for (int i = 0; i < 3; ++i)
+            {
+                dup2(request.fds[i], i);
+            }
+            request.close_fds();
+
+            if (chdir(request.cwd.c_str()) != 0)
+            {
+                Checks::exit_with_message(
+                    VCPKG_LINE_INFO, "Error: failed to change to %s: %s", request.cwd, strerror(errno));
+            }
+            apply_environment(request.environment);
+            return true;
+        }
+
+        request.close_fds();
+        // The server's cleanup, such as flushing its own metrics, is not the supervisor's to run
+        _exit(worker < 0 ? EXIT_FAILURE : supervise(connection, worker));
+    }
+
+    VcpkgCmdArguments serve(const VcpkgCmdArguments& args, const VcpkgPaths& paths)
+    {
+        const ParsedArguments options = args.parse_arguments(COMMAND_STRUCTURE);
+
+        // Each request runs with the global options it was given, so the server takes none it would pass on to them
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           !args.trace_file && !args.openmetrics_file && !args.process_log_file &&
+                               !args.max_threads.has_value() && !args.fs_stats.has_value() &&
+                               !args.alloc_stats.has_value() && !args.featurepackages.has_value() &&
+                               !args.binarycaching.has_value() && !args.sendmetrics.has_value() &&
+                               !args.printmetrics.has_value(),
+                           "Error: x-server takes no global options other than --vcpkg-root and --debug; pass them "
+                           "with each command instead");
+
+        const auto it_socket = options.settings.find(OPTION_SOCKET);
+        const fs::path socket_path = it_socket != options.settings.end()
+                                         ? fs::stdfs::absolute(fs::u8path(it_socket->second))
+                                         : paths.vcpkg_dir / "server.sock";
+        const int listener = listen_on(socket_path.u8string());
+
+        // Outlives serve(), which returns into the request with these paths
+        static WarmState state;
+        warm_up(state, paths.root);
+        System::println("Listening on %s\nSet VCPKG_SERVER=%s to send vcpkg commands to this server.",
+                        socket_path.u8string(),
+                        socket_path.u8string());
+
+        while (true)
+        {
+            // Supervisors that finished since the previous request
+            while (waitpid(-1, nullptr, WNOHANG) > 0)
+            {
+            }
+
+            const int connection = accept(listener, nullptr, nullptr);
+            if (connection < 0)
+            {
+                Checks::check_exit(VCPKG_LINE_INFO,
+                                   errno == EINTR || errno == ECONNABORTED,
+                                   "Error: failed to accept a connection: %s",
+                                   strerror(errno));
+                continue;
+            }
+
+            if (take_fingerprint(*state.paths) != state.fingerprint)
+            {
+                Debug::println("Reloading %s", paths.root.u8string());
+                warm_up(state, paths.root);
+            }
+
+            Request request;
+            if (fork_request(listener, connection, request))
+            {
+                g_warm_paths = state.paths.get();
+                auto request_args = VcpkgCmdArguments::create_from_arg_sequence(
+                    request.args.data(), request.args.data() + request.args.size());
+                Checks::check_exit(VCPKG_LINE_INFO,
+                                   is_served(request_args.command, request.args),
+                                   "Error: the vcpkg server does not run %s",
+                                   request_args.command);
+                return request_args;
+            }
+
+            close(connection);
+        }
+    }
+
+    Optional<int> forward(const std::string& socket_path,
+                          const std::string& command,
+                          const std::vector<std::string>& args)
+    {
+        if (!is_served(command, args)) return nullopt;
+
+        const int fd = connect_to(socket_path);
+        if (fd < 0)
+        {
+            Debug::println("No vcpkg server is listening on %s", socket_path);
+            return nullopt;
+        }
+
+        if (!send_request(fd, args))
+        {
+            close(fd);
+            Debug::println("The vcpkg server on %s did not take the request", socket_path);
+            return nullopt;
+        }
+
+        int32_t exit_code = EXIT_FAILURE;
+        if (!read_all(fd, reinterpret_cast<char*>(&exit_code), sizeof(exit_code)))
+        {
+            System::println(System::Color::error, "Error: the vcpkg server on %s closed the connection", socket_path);
+            exit_code = EXIT_FAILURE;
+        }
+        close(fd);
+        return exit_code;
+    }
+#else
+    VcpkgCmdArguments serve(const VcpkgCmdArguments& args, const VcpkgPaths&)
+    {
+        args.parse_arguments(COMMAND_STRUCTURE);
+        Checks::exit_with_message(VCPKG_LINE_INFO, "Error: x-server is not supported on Windows");
+    }
+
+    Optional<int> forward(const std::string&, const std::string&, const std::vector<std::string>&) { return nullopt; }
+#endif
+}
@@ -3,6 +3,8 @@
 #include <vcpkg/base/files.h>
 #include <vcpkg/base/graphs.h>
 #include <vcpkg/base/strings.h>
+#include <vcpkg/base/threadpool.h>
+#include <vcpkg/base/trace.h>
 #include <vcpkg/base/util.h>
 #include <vcpkg/dependencies.h>
 #include <vcpkg/packagespec.h>
@@ -17,13 +19,48 @@ namespace vcpkg::Dependencies
     {
         InstalledPackageView ipv;
         std::set<PackageSpec> remove_edges;
-        std::set<std::string> original_features;
+        FeatureList original_features;
     };
 
+    struct Cluster;
+
+    /// <summary>
+    /// A dependency of one feature on a feature of another package. The names point into the depending package's
+    /// SourceControlFile; the cluster is looked up on first use.
+    /// </summary>
+    struct ClusterEdge
+    {
+        const std::string* port;
+        /// <summary>Empty for a dependency on the default features.</summary>
+        const std::string* feature;
+        Cluster* cluster = nullptr;
+    };
+
+    /// <summary>
+    /// Features are numbered as in the control file: "core" is 0 and feature paragraph i is i + 1. The dependencies of
+    /// feature i are edges[edge_offsets[i]] up to edges[edge_offsets[i + 1]].
+    /// </summary>
     struct ClusterSource
     {
         const SourceControlFile* scf = nullptr;
-        std::unordered_map<std::string, std::vector<FeatureSpec>> build_edges;
+        std::vector<ClusterEdge> edges;
+        std::vector<size_t> edge_offsets;
+
+        size_t feature_count() const { return edge_offsets.size() - 1; }
+
+        Optional<size_t> feature_index(const std::string& feature) const
+        {
+            if (feature == "core") return size_t(0);
+            for (size_t i = 0; i < scf->feature_paragraphs.size(); ++i)
+                if (scf->feature_paragraphs[i]->name == feature) return i + 1;
+            return nullopt;
+        }
+
+        const std::string& feature_name(size_t index) const
+        {
+            static const std::string CORE = "core";
+            return index == 0 ? CORE : scf->feature_paragraphs[index - 1]->name;
+        }
     };
 
     /// <summary>
@@ -36,9 +73,13 @@ namespace vcpkg::Dependencies
         Optional<ClusterInstalled> installed;
         Optional<ClusterSource> source;
 
-        // Note: this map can contain "special" strings such as "" and "*"
-        std::unordered_map<std::string, bool> plus;
-        std::set<std::string> to_install_features;
+        // Indexed by feature number; the "special" features "" and "*" have their own flags
+        std::vector<bool> plus;
+        bool plus_default = false;
+        bool plus_all = false;
+        std::vector<bool> to_install_features;
+        // Features to add as soon as this package becomes part of the plan; see PackageGraph::require_features()
+        std::vector<std::string> required_features;
         bool minus = false;
         bool transient_uninstalled = true;
         RequestType request_type = RequestType::AUTO_SELECTED;
@@ -98,6 +139,9 @@ namespace vcpkg::Dependencies
                 if (auto p_scf = maybe_scf.get())
                 {
                     clust.source = cluster_from_scf(*p_scf, clust.spec.triplet());
+                    const size_t feature_count = clust.source.get()->feature_count();
+                    clust.plus.resize(feature_count);
+                    clust.to_install_features.resize(feature_count);
                 }
                 return clust;
             }
@@ -107,13 +151,27 @@ namespace vcpkg::Dependencies
     private:
         static ClusterSource cluster_from_scf(const SourceControlFile& scf, Triplet t)
         {
+            static const std::string DEFAULT_FEATURES;
+
             ClusterSource ret;
-            ret.build_edges.emplace("core", filter_dependencies_to_specs(scf.core_paragraph->depends, t));
+            ret.scf = &scf;
+            ret.edge_offsets.push_back(0);
+            const auto add_feature = [&](const std::vector<Dependency>& depends) {
+                for (auto&& dep : depends)
+                {
+                    if (!dep.applies_to(t)) continue;
+                    if (dep.depend.features.empty()) ret.edges.push_back({&dep.depend.name, &DEFAULT_FEATURES});
+                    for (auto&& feature : dep.depend.features)
+                        ret.edges.push_back({&dep.depend.name, &feature});
+                }
+                ret.edge_offsets.push_back(ret.edges.size());
+            };
 
+            add_feature(scf.core_paragraph->depends);
             for (const auto& feature : scf.feature_paragraphs)
-                ret.build_edges.emplace(feature->name, filter_dependencies_to_specs(feature->depends, t));
+                add_feature(feature->depends);
 
-            ret.scf = &scf;
+            ret.edges.shrink_to_fit();
             return ret;
         }
 
@@ -121,20 +179,30 @@ namespace vcpkg::Dependencies
         const PortFileProvider& m_provider;
     };
 
-    std::string to_output_string(RequestType request_type,
-                                 const CStringView s,
-                                 const Build::BuildPackageOptions& options)
+    static void append_output_string(std::string& out,
+                                     RequestType request_type,
+                                     const CStringView s,
+                                     const Build::BuildPackageOptions& options)
     {
         const char* const from_head = options.use_head_version == Build::UseHeadVersion::YES ? " (from HEAD)" : "";
 
         switch (request_type)
         {
-            case RequestType::AUTO_SELECTED: return Strings::format("  * %s%s", s, from_head);
-            case RequestType::USER_REQUESTED: return Strings::format("    %s%s", s, from_head);
+            case RequestType::AUTO_SELECTED: return Strings::append_to(out, "  * %s%s", s, from_head);
+            case RequestType::USER_REQUESTED: return Strings::append_to(out, "    %s%s", s, from_head);
             default: Checks::unreachable(VCPKG_LINE_INFO);
         }
     }
 
+    std::string to_output_string(RequestType request_type,
+                                 const CStringView s,
+                                 const Build::BuildPackageOptions& options)
+    {
+        std::string out;
+        append_output_string(out, request_type, s, options);
+        return out;
+    }
+
     std::string to_output_string(RequestType request_type, const CStringView s)
     {
         switch (request_type)
@@ -152,7 +220,7 @@ namespace vcpkg::Dependencies
 
     InstallPlanAction::InstallPlanAction(const PackageSpec& spec,
                                          const SourceControlFile& scf,
-                                         const std::set<std::string>& features,
+                                         FeatureList&& features,
                                          const RequestType& request_type,
                                          std::vector<PackageSpec>&& dependencies)
         : spec(spec)
@@ -160,20 +228,20 @@ namespace vcpkg::Dependencies
         , plan_type(InstallPlanType::BUILD_AND_INSTALL)
         , request_type(request_type)
         , build_options{}
-        , feature_list(features)
+        , feature_list(std::move(features))
         , computed_dependencies(std::move(dependencies))
     {
     }
 
     InstallPlanAction::InstallPlanAction(InstalledPackageView&& ipv,
-                                         const std::set<std::string>& features,
+                                         FeatureList&& features,
                                          const RequestType& request_type)
         : spec(ipv.spec())
         , installed_package(std::move(ipv))
         , plan_type(InstallPlanType::ALREADY_INSTALLED)
         , request_type(request_type)
         , build_options{}
-        , feature_list(features)
+        , feature_list(std::move(features))
         , computed_dependencies(installed_package.get()->dependencies())
     {
     }
@@ -283,20 +351,60 @@ namespace vcpkg::Dependencies
 
     Optional<const SourceControlFile&> PathsPortFileProvider::get_control_file(const std::string& spec) const
     {
-        auto cache_it = cache.find(spec);
-        if (cache_it != cache.end())
+        const auto& maybe_scf = cache.get_lazy(spec, [&]() -> std::unique_ptr<SourceControlFile> {
+            Parse::ParseExpected<SourceControlFile> source_control_file =
+                Paragraphs::try_load_port(ports.get_filesystem(), ports.port_dir(spec));
+            if (auto scf = source_control_file.get()) return std::move(*scf);
+            return nullptr;
+        });
+
+        if (maybe_scf) return *maybe_scf;
+        return nullopt;
+    }
+
+    PreloadedPortFileProvider::PreloadedPortFileProvider(const VcpkgPaths& paths)
+    {
+        auto all_ports = Paragraphs::load_all_ports(paths.get_filesystem(), paths.ports);
+        ports.reserve(all_ports.size());
+        names.reserve(all_ports.size());
+        for (auto&& port : all_ports)
         {
-            return cache_it->second;
+            const auto it = ports.emplace(port->core_paragraph->name, std::move(*port));
+            if (it.second) names.push_back(it.first->first);
         }
-        Parse::ParseExpected<SourceControlFile> source_control_file =
-            Paragraphs::try_load_port(ports.get_filesystem(), ports.port_dir(spec));
+    }
+
+    Optional<const SourceControlFile&> PreloadedPortFileProvider::get_control_file(const std::string& spec) const
+    {
+        auto scf = ports.find(spec);
+        if (scf == ports.end()) return nullopt;
+        return scf->second;
+    }
 
-        if (auto scf = source_control_file.get())
+    /// <summary>
+    /// Calls `plan` once for the specs of each triplet, in parallel, and joins the plans in the order the triplets
+    /// first appear in `specs`. Packages only depend on packages of their own triplet, so the graphs of different
+    /// triplets never share a vertex and each plan is the same as it would be on its own.
+    /// </summary>
+    template<class Planner>
+    static auto plan_per_triplet(const std::vector<PackageSpec>& specs, const Planner& plan)
+    {
+        std::vector<std::vector<PackageSpec>> partitions;
+        std::unordered_map<Triplet, size_t> partition_of;
+        for (auto&& spec : specs)
         {
-            auto it = cache.emplace(spec, std::move(*scf->get()));
-            return it.first->second;
+            const auto it = partition_of.emplace(spec.triplet(), partitions.size()).first;
+            if (it->second == partitions.size()) partitions.emplace_back();
+            partitions[it->second].push_back(spec);
         }
-        return nullopt;
+
+        if (partitions.size() <= 1) return plan(specs);
+
+        auto plans = ThreadPool::parallel_transform(partitions, plan);
+        auto merged = std::move(plans.front());
+        for (auto it = plans.begin() + 1; it != plans.end(); ++it)
+            merged.insert(merged.end(), std::make_move_iterator(it->begin()), std::make_move_iterator(it->end()));
+        return merged;
     }
 
     std::vector<RemovePlanAction> create_remove_plan(const std::vector<PackageSpec>& specs,
@@ -304,14 +412,16 @@ namespace vcpkg::Dependencies
     {
         struct RemoveAdjacencyProvider final : Graphs::AdjacencyProvider<PackageSpec, RemovePlanAction>
         {
+            using DependentsMap = std::unordered_map<PackageSpec, std::vector<PackageSpec>>;
+
             const StatusParagraphs& status_db;
-            const std::vector<InstalledPackageView>& installed_ports;
+            const DependentsMap& installed_dependents;
             const std::unordered_set<PackageSpec>& specs_as_set;
 
             RemoveAdjacencyProvider(const StatusParagraphs& status_db,
-                                    const std::vector<InstalledPackageView>& installed_ports,
+                                    const DependentsMap& installed_dependents,
                                     const std::unordered_set<PackageSpec>& specs_as_set)
-                : status_db(status_db), installed_ports(installed_ports), specs_as_set(specs_as_set)
+                : status_db(status_db), installed_dependents(installed_dependents), specs_as_set(specs_as_set)
             {
             }
 
@@ -322,18 +432,9 @@ namespace vcpkg::Dependencies
                     return {};
                 }
 
-                const PackageSpec& spec = plan.spec;
-                std::vector<PackageSpec> dependents;
-                for (auto&& ipv : installed_ports)
-                {
-                    auto deps = ipv.dependencies();
-
-                    if (std::find(deps.begin(), deps.end(), spec) == deps.end()) continue;
-
-                    dependents.push_back(ipv.spec());
-                }
-
-                return dependents;
+                const auto it = installed_dependents.find(plan.spec);
+                if (it == installed_dependents.end()) return {};
+                return it->second;
             }
 
             RemovePlanAction load_vertex_data(const PackageSpec& spec) const override
@@ -352,9 +453,12 @@ namespace vcpkg::Dependencies
             std::string to_string(const PackageSpec& spec) const override { return spec.to_string(); }
         };
 
-        auto installed_ports = get_installed_ports(status_db);
+        const auto installed_dependents = get_installed_dependents(get_installed_ports(status_db));
         const std::unordered_set<PackageSpec> specs_as_set(specs.cbegin(), specs.cend());
-        return Graphs::topological_sort(specs, RemoveAdjacencyProvider{status_db, installed_ports, specs_as_set});
+        return plan_per_triplet(specs, [&](const std::vector<PackageSpec>& partition) {
+            return Graphs::topological_sort(partition,
+                                            RemoveAdjacencyProvider{status_db, installed_dependents, specs_as_set});
+        });
     }
 
     std::vector<ExportPlanAction> create_export_plan(const std::vector<PackageSpec>& specs,
@@ -395,9 +499,9 @@ namespace vcpkg::Dependencies
         };
 
         const std::unordered_set<PackageSpec> specs_as_set(specs.cbegin(), specs.cend());
-        std::vector<ExportPlanAction> toposort =
-            Graphs::topological_sort(specs, ExportAdjacencyProvider{status_db, specs_as_set});
-        return toposort;
+        return plan_per_triplet(specs, [&](const std::vector<PackageSpec>& partition) {
+            return Graphs::topological_sort(partition, ExportAdjacencyProvider{status_db, specs_as_set});
+        });
     }
 
     enum class MarkPlusResult
@@ -417,6 +521,11 @@ namespace vcpkg::Dependencies
                            GraphPlan& graph_plan,
                            const std::unordered_set<std::string>& prevent_default_features);
 
+    static void mark_required_features(Cluster& cluster,
+                                       ClusterGraph& graph,
+                                       GraphPlan& graph_plan,
+                                       const std::unordered_set<std::string>& prevent_default_features);
+
     static MarkPlusResult follow_plus_dependencies(const std::string& feature,
                                                    Cluster& cluster,
                                                    ClusterGraph& graph,
@@ -425,14 +534,14 @@ namespace vcpkg::Dependencies
     {
         if (auto p_source = cluster.source.get())
         {
-            auto it_build_edges = p_source->build_edges.find(feature);
-            if (it_build_edges != p_source->build_edges.end())
+            const auto maybe_index = p_source->feature_index(feature);
+            if (auto p_index = maybe_index.get())
             {
                 // mark this package for rebuilding if needed
                 mark_minus(cluster, graph, graph_plan, prevent_default_features);
 
                 graph_plan.install_graph.add_vertex({&cluster});
-                cluster.to_install_features.insert(feature);
+                cluster.to_install_features[*p_index] = true;
 
                 if (feature != "core")
                 {
@@ -455,21 +564,28 @@ namespace vcpkg::Dependencies
                                        cluster.spec);
                 }
 
-                for (auto&& depend : it_build_edges->second)
+                for (size_t i = p_source->edge_offsets[*p_index]; i < p_source->edge_offsets[*p_index + 1]; ++i)
                 {
-                    auto& depend_cluster = graph.get(depend.spec());
-                    auto res = mark_plus(depend.feature(), depend_cluster, graph, graph_plan, prevent_default_features);
+                    auto& edge = p_source->edges[i];
+                    if (!edge.cluster)
+                    {
+                        edge.cluster = &graph.get(PackageSpec::from_name_and_triplet(*edge.port, cluster.spec.triplet())
+                                                      .value_or_exit(VCPKG_LINE_INFO));
+                    }
+                    auto& depend_cluster = *edge.cluster;
+                    auto res = mark_plus(*edge.feature, depend_cluster, graph, graph_plan, prevent_default_features);
 
                     Checks::check_exit(VCPKG_LINE_INFO,
                                        res == MarkPlusResult::SUCCESS,
                                        "Error: Unable to satisfy dependency %s of %s",
-                                       depend,
+                                       FeatureSpec(depend_cluster.spec, *edge.feature),
                                        FeatureSpec(cluster.spec, feature));
 
                     if (&depend_cluster == &cluster) continue;
                     graph_plan.install_graph.add_edge({&cluster}, {&depend_cluster});
                 }
 
+                mark_required_features(cluster, graph, graph_plan, prevent_default_features);
                 return MarkPlusResult::SUCCESS;
             }
         }
@@ -484,10 +600,6 @@ namespace vcpkg::Dependencies
                              GraphPlan& graph_plan,
                              const std::unordered_set<std::string>& prevent_default_features)
     {
-        auto& plus = cluster.plus[feature];
-        if (plus) return MarkPlusResult::SUCCESS;
-        plus = true;
-
         auto p_source = cluster.source.get();
         Checks::check_exit(VCPKG_LINE_INFO,
                            p_source != nullptr,
@@ -496,6 +608,9 @@ namespace vcpkg::Dependencies
 
         if (feature.empty())
         {
+            if (cluster.plus_default) return MarkPlusResult::SUCCESS;
+            cluster.plus_default = true;
+
             // Add default features for this package. This is an exact reference, so ignore prevent_default_features.
             for (auto&& default_feature : p_source->scf->core_paragraph.get()->default_features)
             {
@@ -512,6 +627,9 @@ namespace vcpkg::Dependencies
 
         if (feature == "*")
         {
+            if (cluster.plus_all) return MarkPlusResult::SUCCESS;
+            cluster.plus_all = true;
+
             for (auto&& fpgh : p_source->scf->feature_paragraphs)
             {
                 auto res = mark_plus(fpgh->name, cluster, graph, graph_plan, prevent_default_features);
@@ -529,9 +647,16 @@ namespace vcpkg::Dependencies
             return MarkPlusResult::SUCCESS;
         }
 
+        const auto maybe_index = p_source->feature_index(feature);
+        if (auto p_index = maybe_index.get())
+        {
+            if (cluster.plus[*p_index]) return MarkPlusResult::SUCCESS;
+            cluster.plus[*p_index] = true;
+        }
+
         if (auto p_installed = cluster.installed.get())
         {
-            if (p_installed->original_features.find(feature) != p_installed->original_features.end())
+            if (p_installed->original_features.contains(feature))
             {
                 return MarkPlusResult::SUCCESS;
             }
@@ -605,6 +730,27 @@ namespace vcpkg::Dependencies
         }
     }
 
+    void mark_required_features(Cluster& cluster,
+                                ClusterGraph& graph,
+                                GraphPlan& graph_plan,
+                                const std::unordered_set<std::string>& prevent_default_features)
+    {
+        // Taken out first so that reaching this package again while marking them does not recurse
+        const auto required_features = std::move(cluster.required_features);
+        cluster.required_features.clear();
+
+        for (auto&& feature : required_features)
+        {
+            auto res = mark_plus(feature, cluster, graph, graph_plan, prevent_default_features);
+
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               res == MarkPlusResult::SUCCESS,
+                               "Error: `%s` is not a feature of package `%s`",
+                               feature,
+                               cluster.spec.name());
+        }
+    }
+
     /// <summary>Figure out which actions are required to install features specifications in `specs`.</summary>
     /// <param name="provider">Contains the ports of the current environment.</param>
     /// <param name="specs">Feature specifications to resolve dependencies for.</param>
@@ -613,6 +759,8 @@ namespace vcpkg::Dependencies
                                                        const std::vector<FeatureSpec>& specs,
                                                        const StatusParagraphs& status_db)
     {
+        Trace::Scope trace("plan", "install plan");
+
         std::unordered_set<std::string> prevent_default_features;
         for (auto&& spec : specs)
         {
@@ -662,6 +810,13 @@ namespace vcpkg::Dependencies
                            spec.name());
 
         m_graph_plan->install_graph.add_vertex(ClusterPtr{&spec_cluster});
+        mark_required_features(spec_cluster, *m_graph, *m_graph_plan, prevent_default_features);
+    }
+
+    void PackageGraph::require_features(const PackageSpec& spec, const std::vector<std::string>& features) const
+    {
+        Cluster& spec_cluster = m_graph->get(spec);
+        spec_cluster.required_features.insert(spec_cluster.required_features.end(), features.begin(), features.end());
     }
 
     void PackageGraph::upgrade(const PackageSpec& spec) const
@@ -696,16 +851,21 @@ namespace vcpkg::Dependencies
             if (p_cluster->transient_uninstalled)
             {
                 // If it will be transiently uninstalled, we need to issue a full installation command
-                auto pscf = p_cluster->source.value_or_exit(VCPKG_LINE_INFO).scf;
+                const auto& source = p_cluster->source.value_or_exit(VCPKG_LINE_INFO);
+                auto pscf = source.scf;
 
                 auto dep_specs = Util::fmap(m_graph_plan->install_graph.adjacency_list(p_cluster),
                                             [](ClusterPtr const& p) { return p->spec; });
                 Util::sort_unique_erase(dep_specs);
 
+                FeatureList features;
+                for (size_t i = 0; i < source.feature_count(); ++i)
+                    if (p_cluster->to_install_features[i]) features.insert(source.feature_name(i));
+
                 plan.emplace_back(InstallPlanAction{
                     p_cluster->spec,
                     *pscf,
-                    p_cluster->to_install_features,
+                    std::move(features),
                     p_cluster->request_type,
                     std::move(dep_specs),
                 });
@@ -717,7 +877,7 @@ namespace vcpkg::Dependencies
                 auto&& installed = p_cluster->installed.value_or_exit(VCPKG_LINE_INFO);
                 plan.emplace_back(InstallPlanAction{
                     InstalledPackageView{installed.ipv},
-                    installed.original_features,
+                    FeatureList(installed.original_features),
                     p_cluster->request_type,
                 });
             }
@@ -742,28 +902,24 @@ namespace vcpkg::Dependencies
             cluster.installed = [](const InstalledPackageView& ipv) -> ClusterInstalled {
                 ClusterInstalled ret;
                 ret.ipv = ipv;
-                ret.original_features.emplace("core");
+                ret.original_features.insert("core");
                 for (auto&& feature : ipv.features)
-                    ret.original_features.emplace(feature->package.feature);
+                    ret.original_features.insert(feature->package.feature);
                 return ret;
             }(ipv);
         }
 
         // Populate the graph with "remove edges", which are the reverse of the Build-Depends edges.
-        for (auto&& ipv : installed_ports)
+        for (auto&& dependents : get_installed_dependents(installed_ports))
         {
-            auto deps = ipv.dependencies();
-
-            for (auto&& dep : deps)
-            {
-                auto p_installed = graph->get(dep).installed.get();
-                Checks::check_exit(VCPKG_LINE_INFO,
-                                   p_installed,
-                                   "Error: database corrupted. Package %s is installed but dependency %s is not.",
-                                   ipv.spec(),
-                                   dep);
-                p_installed->remove_edges.emplace(ipv.spec());
-            }
+            const PackageSpec& dep = dependents.first;
+            auto p_installed = graph->get(dep).installed.get();
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               p_installed,
+                               "Error: database corrupted. Package %s is installed but dependency %s is not.",
+                               dependents.second.front(),
+                               dep);
+            p_installed->remove_edges.insert(dependents.second.begin(), dependents.second.end());
         }
         return graph;
     }
@@ -831,9 +987,11 @@ namespace vcpkg::Dependencies
         std::sort(excluded.begin(), excluded.end(), &InstallPlanAction::compare_by_name);
 
         static auto actions_to_output_string = [](const std::vector<const InstallPlanAction*>& v) {
-            return Strings::join("\n", v, [](const InstallPlanAction* p) {
-                return to_output_string(p->request_type, p->displayname(), p->build_options);
+            std::string output;
+            Strings::join_to(output, "\n", v, [](std::string& out, const InstallPlanAction* p) {
+                append_output_string(out, p->request_type, p->displayname(), p->build_options);
             });
+            return output;
         };
 
         if (!excluded.empty())
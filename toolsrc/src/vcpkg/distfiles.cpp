@@ -0,0 +1,303 @@
+#include "pch.h"
+
+#include <vcpkg/base/downloads.h>
+#include <vcpkg/base/hash.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/util.h>
+#include <vcpkg/distfiles.h>
+
+namespace vcpkg::Distfiles
+{
+    namespace
+    {
+        struct Command
+        {
+            std::string name;
+            std::vector<std::string> args;
+        };
+
+        static constexpr Strings::AsciiSet WHITESPACE = " \t\r\n";
+        static constexpr Strings::AsciiSet IDENTIFIER_CHARS =
+            "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+
+        /// <summary>
+        /// Splits a cmake script into its commands. Only as much of the language as portfiles use is understood:
+        /// quoted and unquoted arguments and line comments. Anything else ends the command it occurs in.
+        /// </summary>
+        struct ScriptReader
+        {
+            explicit ScriptReader(const std::string& s) : s(s) {}
+
+            std::vector<Command> read_all()
+            {
+                std::vector<Command> commands;
+                while (skip_whitespace_and_comments(), pos < s.size())
+                {
+                    Command command;
+                    if (read_command(command))
+                        commands.push_back(std::move(command));
+                    else
+                        skip_line();
+                }
+                return commands;
+            }
+
+        private:
+            const std::string& s;
+            size_t pos = 0;
+
+            void skip_line()
+            {
+                const auto end = s.find('\n', pos);
+                pos = end == std::string::npos ? s.size() : end + 1;
+            }
+
+            void skip_whitespace_and_comments()
+            {
+                while (pos < s.size())
+                {
+                    if (WHITESPACE.contains(s[pos]))
+                        ++pos;
+                    else if (s[pos] == '#')
+                        skip_line();
+                    else
+                        return;
+                }
+            }
+
+            bool read_command(Command& command)
+            {
+                const size_t name_start = pos;
+                while (pos < s.size() && IDENTIFIER_CHARS.contains(s[pos]))
+                    ++pos;
+                if (pos == name_start) return false;
+                command.name = Strings::ascii_to_lowercase(s.substr(name_start, pos - name_start));
+
+                while (pos < s.size() && (s[pos] == ' ' || s[pos] == '\t'))
+                    ++pos;
+                if (pos == s.size() || s[pos] != '(') return false;
+                ++pos;
+
+                // Parentheses inside the arguments, as in if((A OR B) AND C), are kept as part of the arguments
+                int depth = 0;
+                while (skip_whitespace_and_comments(), pos < s.size())
+                {
+                    const char c = s[pos];
+                    if (c == ')' && depth == 0)
+                    {
+                        ++pos;
+                        return true;
+                    }
+
+                    if (c == '"')
+                    {
+                        std::string arg;
+                        if (!read_quoted(arg)) return false;
+                        command.args.push_back(std::move(arg));
+                        continue;
+                    }
+
+                    const size_t arg_start = pos;
+                    while (pos < s.size() && !WHITESPACE.contains(s[pos]) && s[pos] != '"' && s[pos] != '#')
+                    {
+                        if (s[pos] == '(')
+                            ++depth;
+                        else if (s[pos] == ')')
+                        {
+                            if (depth == 0) break;
+                            --depth;
+                        }
+                        ++pos;
+                    }
+                    if (pos != arg_start) command.args.push_back(s.substr(arg_start, pos - arg_start));
+                }
+                return false;
+            }
+
+            bool read_quoted(std::string& arg)
+            {
+                ++pos;
+                while (pos < s.size())
+                {
+                    const char c = s[pos++];
+                    if (c == '"') return true;
+                    if (c == '\\' && pos < s.size())
+                        arg.push_back(s[pos++]);
+                    else
+                        arg.push_back(c);
+                }
+                return false;
+            }
+        };
+
+        using Variables = std::map<std::string, std::string>;
+
+        /// <summary>Substitutes ${NAME} references, failing on any variable that is not known.</summary>
+        Optional<std::string> expand(const std::string& arg, const Variables& variables)
+        {
+            std::string ret;
+            size_t pos = 0;
+            while (true)
+            {
+                const auto start = arg.find("${", pos);
+                if (start == std::string::npos) break;
+                const auto end = arg.find('}', start);
+                if (end == std::string::npos) return nullopt;
+
+                const auto it = variables.find(arg.substr(start + 2, end - start - 2));
+                if (it == variables.end()) return nullopt;
+                ret.append(arg, pos, start - pos);
+                ret.append(it->second);
+                pos = end + 1;
+            }
+            if (arg.find_first_of("$;", pos) != std::string::npos) return nullopt;
+
+            ret.append(arg, pos, std::string::npos);
+            return ret;
+        }
+
+        using KeywordArguments = std::map<std::string, std::vector<std::string>>;
+
+        /// <summary>
+        /// The keyword arguments of a command, as cmake_parse_arguments sees them: every argument after a keyword up
+        /// to the next keyword belongs to it.
+        /// </summary>
+        KeywordArguments parse_keywords(const std::vector<std::string>& args, const std::vector<std::string>& keywords)
+        {
+            KeywordArguments ret;
+            std::vector<std::string>* current = nullptr;
+            for (auto&& arg : args)
+            {
+                if (Util::find(keywords, arg) != keywords.end())
+                    current = &ret[arg];
+                else if (current)
+                    current->push_back(arg);
+            }
+            return ret;
+        }
+
+        Optional<std::string> single_value(const KeywordArguments& keywords,
+                                           const std::string& keyword,
+                                           const Variables& variables)
+        {
+            const auto it = keywords.find(keyword);
+            if (it == keywords.end() || it->second.size() != 1) return nullopt;
+            return expand(it->second.front(), variables);
+        }
+
+        Optional<Distfile> from_download_distfile(const Command& command, const Variables& variables)
+        {
+            const auto keywords = parse_keywords(command.args, {"URLS", "FILENAME", "SHA512", "SKIP_SHA512"});
+            if (keywords.count("SKIP_SHA512") != 0) return nullopt;
+
+            const auto filename = single_value(keywords, "FILENAME", variables);
+            const auto sha512 = single_value(keywords, "SHA512", variables);
+            const auto it_urls = keywords.find("URLS");
+            if (!filename.has_value() || !sha512.has_value() || it_urls == keywords.end() || it_urls->second.empty())
+                return nullopt;
+
+            std::vector<std::string> urls;
+            for (auto&& url : it_urls->second)
+            {
+                auto maybe_url = expand(url, variables);
+                if (const auto p_url = maybe_url.get())
+                    urls.push_back(std::move(*p_url));
+                else
+                    return nullopt;
+            }
+
+            return Distfile{std::move(urls), *filename.get(), *sha512.get()};
+        }
+
+        /// <summary>Mirrors the download in scripts/cmake/vcpkg_from_github.cmake for builds without --head.</summary>
+        Optional<Distfile> from_github(const Command& command, const Variables& variables)
+        {
+            const auto keywords =
+                parse_keywords(command.args, {"OUT_SOURCE_PATH", "REPO", "REF", "SHA512", "HEAD_REF", "PATCHES"});
+
+            const auto maybe_repo = single_value(keywords, "REPO", variables);
+            const auto maybe_ref = single_value(keywords, "REF", variables);
+            const auto maybe_sha512 = single_value(keywords, "SHA512", variables);
+            const auto repo = maybe_repo.get();
+            const auto ref = maybe_ref.get();
+            if (!repo || !ref || !maybe_sha512.has_value()) return nullopt;
+
+            const auto slash = repo->find('/');
+            if (slash == std::string::npos) return nullopt;
+            const std::string org_name = repo->substr(0, slash);
+            const std::string repo_name = repo->substr(repo->rfind('/') + 1);
+            const std::string sanitized_ref = Strings::replace_all(std::string(*ref), "/", "-");
+
+            return Distfile{{Strings::format("https://github.com/%s/%s/archive/%s.tar.gz", org_name, repo_name, *ref)},
+                            Strings::format("%s-%s-%s.tar.gz", org_name, repo_name, sanitized_ref),
+                            *maybe_sha512.get()};
+        }
+    }
+
+    std::vector<Distfile> find_in_portfile(const std::string& contents, const std::string& port_name)
+    {
+        static const std::vector<std::string> BLOCK_STARTS = {"if", "foreach", "while", "function", "macro"};
+        static const std::vector<std::string> BLOCK_ENDS = {
+            "endif", "endforeach", "endwhile", "endfunction", "endmacro"};
+
+        Variables variables;
+        variables.emplace("PORT", port_name);
+
+        std::vector<Distfile> ret;
+        int depth = 0;
+        for (auto&& command : ScriptReader(contents).read_all())
+        {
+            if (Util::find(BLOCK_STARTS, command.name) != BLOCK_STARTS.end())
+                ++depth;
+            else if (Util::find(BLOCK_ENDS, command.name) != BLOCK_ENDS.end())
+                --depth;
+
+            if (depth != 0) continue;
+
+            if (command.name == "set" && !command.args.empty())
+            {
+                auto maybe_value = command.args.size() == 2 ? expand(command.args[1], variables) : nullopt;
+                if (const auto value = maybe_value.get())
+                    variables[command.args[0]] = std::move(*value);
+                else
+                    variables.erase(command.args[0]);
+            }
+            else if (command.name == "vcpkg_download_distfile")
+            {
+                auto maybe_distfile = from_download_distfile(command, variables);
+                if (const auto distfile = maybe_distfile.get()) ret.push_back(std::move(*distfile));
+            }
+            else if (command.name == "vcpkg_from_github")
+            {
+                auto maybe_distfile = from_github(command, variables);
+                if (const auto distfile = maybe_distfile.get()) ret.push_back(std::move(*distfile));
+            }
+        }
+
+        return ret;
+    }
+
+    bool prefetch(const VcpkgPaths& paths, const Distfile& distfile)
+    {
+        auto& fs = paths.get_filesystem();
+        const fs::path target = paths.downloads / fs::u8path(distfile.filename);
+        if (fs.exists(target)) return true;
+
+        // Not the name the build downloads to, so a build fetching the same file at the same time is not disturbed
+        const fs::path download_path = paths.downloads / fs::u8path(distfile.filename + ".prefetch");
+        bool downloaded = Downloads::try_download_from_asset_sources(fs, distfile.sha512, download_path);
+        for (auto it = distfile.urls.begin(); !downloaded && it != distfile.urls.end(); ++it)
+        {
+            downloaded = Downloads::try_download_file(fs, *it, download_path, Hash::Algorithm::SHA512, distfile.sha512);
+            if (downloaded) Downloads::store_in_asset_sources(fs, distfile.sha512, download_path);
+        }
+
+        if (downloaded)
+        {
+            std::error_code ec;
+            fs.rename(download_path, target, ec);
+            if (ec) fs.remove(download_path, ec);
+        }
+        return fs.exists(target);
+    }
+}
@@ -0,0 +1,266 @@
+#include "pch.h"
+
+#include <vcpkg/base/downloads.h>
+#include <vcpkg/base/files.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/base/util.h>
+#include <vcpkg/build.h>
+#include <vcpkg/downloadreferences.h>
+
+#include <ctime>
+
+namespace vcpkg::DownloadReferences
+{
+    // Files used or written this recently are kept, since a build may be about to read them
+    static constexpr long long GC_GRACE_PERIOD_SECONDS = 60 * 60;
+
+    static constexpr StringLiteral REFERENCES_FILENAME = "references";
+
+    static fs::path get_references_path(const VcpkgPaths& paths)
+    {
+        return paths.downloads / REFERENCES_FILENAME.c_str();
+    }
+
+    // Held while the references file is rewritten, so that no record is appended to the file being replaced
+    static fs::path get_lock_path(const VcpkgPaths& paths) { return paths.downloads / "references.lock"; }
+
+    struct Reference
+    {
+        std::string filename;
+        std::string port;
+        std::string port_hash;
+        long long time;
+    };
+
+    static Optional<Reference> parse_reference(const std::string& line)
+    {
+        // "<filename> <port> <port files hash> <abi tag or -> <unix time>"; download names never contain spaces
+        const auto fields = Strings::split(line, " ");
+        if (fields.size() != 5) return nullopt;
+
+        char* end = nullptr;
+        const long long time = std::strtoll(fields[4].c_str(), &end, 10);
+        if (fields[4].empty() || *end != '\0') return nullopt;
+
+        return Reference{fields[0], fields[1], fields[2], time};
+    }
+
+    static std::vector<Reference> load_references(const Files::Filesystem& fs, const fs::path& path)
+    {
+        std::vector<Reference> references;
+
+        auto maybe_lines = fs.read_lines(path);
+        auto p_lines = maybe_lines.get();
+        if (!p_lines) return references;
+
+        for (auto&& line : *p_lines)
+        {
+            auto maybe_reference = parse_reference(line);
+            if (auto p_reference = maybe_reference.get()) references.push_back(std::move(*p_reference));
+        }
+
+        return references;
+    }
+
+    fs::path get_used_downloads_log(const fs::path& buildtree, const PackageSpec& spec)
+    {
+        return buildtree / (spec.triplet().canonical_name() + ".used-downloads.log");
+    }
+
+    void record(const VcpkgPaths& paths,
+                const PackageSpec& spec,
+                const fs::path& port_dir,
+                const std::string& abi_tag,
+                const fs::path& used_downloads_log)
+    {
+        auto& fs = paths.get_filesystem();
+
+        auto maybe_lines = fs.read_lines(used_downloads_log);
+        auto p_lines = maybe_lines.get();
+        if (!p_lines) return;
+
+        const long long now = static_cast<long long>(std::time(nullptr));
+        std::vector<std::string> filenames = std::move(*p_lines);
+        Util::erase_remove_if(filenames, [](const std::string& filename) {
+            return filename.empty() || filename.find(' ') != std::string::npos;
+        });
+        Util::sort_unique_erase(filenames);
+
+        std::string text;
+        const std::string port_hash = filenames.empty() ? std::string() : Build::hash_port_files(fs, port_dir);
+        for (auto&& filename : filenames)
+        {
+            Strings::append_to(text,
+                               "%s %s %s %s %lld\n",
+                               filename,
+                               spec.name(),
+                               port_hash,
+                               abi_tag.empty() ? "-" : abi_tag,
+                               now);
+        }
+
+        std::error_code ec;
+        if (!text.empty())
+        {
+            auto lock = fs.lock_file(get_lock_path(paths), true, ec);
+            fs.append_contents(get_references_path(paths), text, ec);
+            if (ec)
+            {
+                System::println(System::Color::warning,
+                                "Warning: failed to record the downloads of %s: %s",
+                                spec.to_string(),
+                                ec.message());
+            }
+        }
+        fs.remove(used_downloads_log, ec);
+    }
+
+    struct DownloadedFile
+    {
+        fs::path path;
+        uint64_t size;
+        /// <summary>Seconds since the file was last used by a build or written, whichever is later</summary>
+        long long age;
+    };
+
+    GcResult collect_garbage(const VcpkgPaths& paths, const uint64_t max_unreferenced_size, const bool dry_run)
+    {
+        auto& fs = paths.get_filesystem();
+        const long long now = static_cast<long long>(std::time(nullptr));
+        const auto now_file_time = fs::stdfs::file_time_type::clock::now();
+
+        // A file is referenced when a build of its port, as the port is now, asked for it
+        std::map<std::string, std::string> current_port_hashes;
+        const auto is_current = [&](const Reference& reference) {
+            auto it = current_port_hashes.find(reference.port);
+            if (it == current_port_hashes.end())
+            {
+                const fs::path port_dir = paths.ports / reference.port;
+                std::string hash = fs.exists(port_dir) ? Build::hash_port_files(fs, port_dir) : std::string();
+                it = current_port_hashes.emplace(reference.port, std::move(hash)).first;
+            }
+            return !it->second.empty() && it->second == reference.port_hash;
+        };
+
+        std::set<std::string> referenced;
+        std::map<std::string, long long> last_used;
+        for (auto&& reference : load_references(fs, get_references_path(paths)))
+        {
+            long long& time = last_used[reference.filename];
+            time = std::max(time, reference.time);
+            if (!referenced.count(reference.filename) && is_current(reference)) referenced.insert(reference.filename);
+        }
+
+        GcResult result;
+        std::vector<DownloadedFile> unreferenced;
+        for (auto&& entry : fs.get_entries_non_recursive(paths.downloads))
+        {
+            if (entry.type != fs::file_type::regular) continue;
+
+            const std::string filename = entry.path.filename().u8string();
+            // The references file, its lock and a rewrite of it that was interrupted
+            if (filename.compare(0, REFERENCES_FILENAME.size(), REFERENCES_FILENAME.c_str()) == 0) continue;
+
+            if (referenced.count(filename))
+            {
+                result.referenced_bytes += entry.size;
+                continue;
+            }
+
+            long long age =
+                std::chrono::duration_cast<std::chrono::seconds>(now_file_time - entry.last_write_time).count();
+            const auto it_last_used = last_used.find(filename);
+            if (it_last_used != last_used.end()) age = std::min(age, now - it_last_used->second);
+            unreferenced.push_back({entry.path, entry.size, age});
+        }
+
+        // The most recently used are kept, so that switching back to an older port tree does not download again
+        std::sort(unreferenced.begin(), unreferenced.end(), [](const DownloadedFile& lhs, const DownloadedFile& rhs) {
+            return lhs.age < rhs.age;
+        });
+        std::set<std::string> removed;
+        for (auto&& file : unreferenced)
+        {
+            if (file.age < GC_GRACE_PERIOD_SECONDS || result.unreferenced_bytes + file.size <= max_unreferenced_size)
+            {
+                result.unreferenced_bytes += file.size;
+                continue;
+            }
+
+            std::error_code ec;
+            if (dry_run)
+                System::println("Would remove %s", file.path.u8string());
+            else
+                fs.remove(file.path, ec);
+            if (ec) continue;
+
+            ++result.removed_files;
+            result.removed_bytes += file.size;
+            removed.insert(file.path.filename().u8string());
+        }
+
+        // Entries of the download index are links to the downloads, and left as the only link they are unused. A dry
+        // run does not list the ones that removing the downloads above would leave so.
+        const fs::path& index_dir = Downloads::download_index();
+        if (!index_dir.empty() && fs.exists(index_dir))
+        {
+            for (auto&& entry : fs.get_entries_non_recursive(index_dir))
+            {
+                if (entry.type != fs::file_type::regular) continue;
+
+                std::error_code ec;
+                const auto link_count = fs::stdfs::hard_link_count(entry.path, ec);
+                if (ec) continue;
+
+                if (link_count != 1) continue;
+
+                const long long age =
+                    std::chrono::duration_cast<std::chrono::seconds>(now_file_time - entry.last_write_time).count();
+                if (age < GC_GRACE_PERIOD_SECONDS) continue;
+
+                if (dry_run)
+                    System::println("Would remove %s", entry.path.u8string());
+                else
+                    fs.remove(entry.path, ec);
+                if (ec) continue;
+
+                ++result.removed_files;
+                result.removed_bytes += entry.size;
+            }
+        }
+
+        if (dry_run || removed.empty()) return result;
+
+        // Records appended since the file was read above are kept, since only removed files are dropped
+        std::error_code ec;
+        auto lock = fs.lock_file(get_lock_path(paths), true, ec);
+        const fs::path references_path = get_references_path(paths);
+        auto maybe_lines = fs.read_lines(references_path);
+        if (auto p_lines = maybe_lines.get())
+        {
+            std::string text;
+            for (auto&& line : *p_lines)
+            {
+                const auto maybe_reference = parse_reference(line);
+                const auto p_reference = maybe_reference.get();
+                if (!p_reference || removed.count(p_reference->filename)) continue;
+                text.append(line);
+                text.push_back('\n');
+            }
+
+            const fs::path temp_path = references_path.u8string() + ".tmp";
+            fs.write_contents(temp_path, text, ec);
+            if (!ec) fs.rename(temp_path, references_path, ec);
+            if (ec)
+            {
+                System::println(System::Color::warning,
+                                "Warning: failed to rewrite %s: %s",
+                                references_path.u8string(),
+                                ec.message());
+            }
+        }
+
+        return result;
+    }
+}
@@ -10,9 +10,12 @@
 #include <vcpkg/paragraphs.h>
 #include <vcpkg/vcpkglib.h>
 
+#include <vcpkg/base/graphs.h>
 #include <vcpkg/base/stringliteral.h>
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/threadpool.h>
 #include <vcpkg/base/util.h>
+#include <vcpkg/base/zip.h>
 
 namespace vcpkg::Export
 {
@@ -21,13 +24,10 @@ namespace vcpkg::Export
     using Dependencies::RequestType;
     using Install::InstallDir;
 
-    static std::string create_nuspec_file_contents(const std::string& raw_exported_dir,
-                                                   const std::string& targets_redirect_path,
-                                                   const std::string& nuget_id,
-                                                   const std::string& nupkg_version)
+    static std::string create_nuspec_file_contents(const std::string& nuget_id, const std::string& nupkg_version)
     {
-        static constexpr auto CONTENT_TEMPLATE = R"(
-<package>
+        static constexpr auto CONTENT_TEMPLATE = R"(<?xml version="1.0" encoding="utf-8"?>
+<package xmlns="http://schemas.microsoft.com/packaging/2010/07/nuspec.xsd">
     <metadata>
         <id>@NUGET_ID@</id>
         <version>@VERSION@</version>
@@ -36,24 +36,99 @@ namespace vcpkg::Export
             Vcpkg NuGet export
         </description>
     </metadata>
-    <files>
-        <file src="@RAW_EXPORTED_DIR@\installed\**" target="installed" />
-        <file src="@RAW_EXPORTED_DIR@\scripts\**" target="scripts" />
-        <file src="@RAW_EXPORTED_DIR@\.vcpkg-root" target="" />
-        <file src="@TARGETS_REDIRECT_PATH@" target="build\native\@NUGET_ID@.targets" />
-    </files>
 </package>
 )";
 
         std::string nuspec_file_content = Strings::replace_all(CONTENT_TEMPLATE, "@NUGET_ID@", nuget_id);
         nuspec_file_content = Strings::replace_all(std::move(nuspec_file_content), "@VERSION@", nupkg_version);
-        nuspec_file_content =
-            Strings::replace_all(std::move(nuspec_file_content), "@RAW_EXPORTED_DIR@", raw_exported_dir);
-        nuspec_file_content =
-            Strings::replace_all(std::move(nuspec_file_content), "@TARGETS_REDIRECT_PATH@", targets_redirect_path);
         return nuspec_file_content;
     }
 
+    static std::string create_relationships(const std::string& nuspec_part_name)
+    {
+        return Strings::format(R"###(<?xml version="1.0" encoding="utf-8"?>
+<Relationships xmlns="http://schemas.openxmlformats.org/package/2006/relationships">
+  <Relationship Type="http://schemas.microsoft.com/packaging/2010/07/manifest" Target="/%s" Id="R1" />
+</Relationships>
+)###",
+                               nuspec_part_name);
+    }
+
+    /// <summary>
+    /// Lists a content type for every part of the package: one per file extension, and one per file without an
+    /// extension. Extensions are case insensitive.
+    /// </summary>
+    static std::string create_content_types(const std::vector<std::string>& part_names)
+    {
+        std::map<std::string, std::string> extensions;
+        std::string overrides;
+        for (auto&& part_name : part_names)
+        {
+            if (part_name.empty()) continue;
+
+            const auto last_slash = part_name.rfind('/');
+            const auto last_dot = part_name.rfind('.');
+            const bool has_extension = last_dot != std::string::npos &&
+                                       (last_slash == std::string::npos || last_dot > last_slash) &&
+                                       last_dot + 1 != part_name.size();
+            if (has_extension)
+            {
+                const std::string extension = part_name.substr(last_dot + 1);
+                extensions.emplace(Strings::ascii_to_lowercase(extension), extension);
+            }
+            else
+            {
+                overrides += Strings::format(R"(  <Override PartName="/%s" ContentType="application/octet" />)"
+                                             "\n",
+                                             part_name);
+            }
+        }
+
+        std::string content_types = R"(<?xml version="1.0" encoding="utf-8"?>)"
+                                    "\n"
+                                    R"(<Types xmlns="http://schemas.openxmlformats.org/package/2006/content-types">)"
+                                    "\n";
+        for (auto&& extension : extensions)
+        {
+            const char* const content_type = extension.first == "rels"
+                                                 ? "application/vnd.openxmlformats-package.relationships+xml"
+                                                 : "application/octet";
+            content_types += Strings::format(
+                R"(  <Default Extension="%s" ContentType="%s" />)"
+                "\n",
+                extension.second,
+                content_type);
+        }
+        content_types += overrides;
+        content_types += "</Types>\n";
+        return content_types;
+    }
+
+    /// <summary>
+    /// Percent-encodes everything in `name` but the unreserved characters of RFC 3986 and the slashes between its
+    /// segments, like `nuget pack` does for the names of package parts.
+    /// </summary>
+    static std::string escape_part_name(const std::string& name)
+    {
+        static constexpr char HEX_DIGITS[] = "0123456789ABCDEF";
+        std::string escaped;
+        for (const char c : name)
+        {
+            const auto byte = static_cast<unsigned char>(c);
+            if (std::isalnum(byte) != 0 || c == '-' || c == '.' || c == '_' || c == '~' || c == '/')
+            {
+                escaped.push_back(c);
+            }
+            else
+            {
+                escaped.push_back('%');
+                escaped.push_back(HEX_DIGITS[byte >> 4]);
+                escaped.push_back(HEX_DIGITS[byte & 0xF]);
+            }
+        }
+        return escaped;
+    }
+
     static std::string create_targets_redirect(const std::string& target_path) noexcept
     {
         return Strings::format(R"###(
@@ -77,6 +152,7 @@ namespace vcpkg::Export
             Build::DownloadTool::BUILT_IN,
             Build::BinaryCaching::NO,
             Build::FailOnTombstone::NO,
+            Build::Incremental::NO,
         };
 
         for (const ExportPlanType plan_type : ORDER)
@@ -122,49 +198,59 @@ namespace vcpkg::Export
         return ("vcpkg-export-" + date_time_as_string);
     }
 
-    static fs::path do_nuget_export(const VcpkgPaths& paths,
-                                    const std::string& nuget_id,
-                                    const std::string& nuget_version,
-                                    const fs::path& raw_exported_dir,
-                                    const fs::path& output_dir)
+    /// <summary>
+    /// Lays the export out as a nupkg: a zip archive in the Open Packaging Conventions layout of `nuget pack`, with
+    /// the manifest at the root, the relationships in _rels and the content types in [Content_Types].xml. Directories
+    /// get no entries. The parts that only the package has are appended to `sources`.
+    /// </summary>
+    static Zip::ArchiveLayout make_nuget_layout(std::vector<Zip::SourceEntry>& sources,
+                                                const std::string& nuget_id,
+                                                const std::string& nuget_version,
+                                                const fs::path& output_dir)
     {
-        Files::Filesystem& fs = paths.get_filesystem();
-        const fs::path& nuget_exe = paths.get_tool_exe(Tools::NUGET);
-
-        // This file will be placed in "build\native" in the nuget package. Therefore, go up two dirs.
-        const std::string targets_redirect_content =
-            create_targets_redirect("../../scripts/buildsystems/msbuild/vcpkg.targets");
-        const fs::path targets_redirect = paths.buildsystems / "tmp" / "vcpkg.export.nuget.targets";
-
-        std::error_code ec;
-        fs.create_directories(paths.buildsystems / "tmp", ec);
-
-        fs.write_contents(targets_redirect, targets_redirect_content);
-
-        const std::string nuspec_file_content =
-            create_nuspec_file_contents(raw_exported_dir.string(), targets_redirect.string(), nuget_id, nuget_version);
-        const fs::path nuspec_file_path = paths.buildsystems / "tmp" / "vcpkg.export.nuspec";
-        fs.write_contents(nuspec_file_path, nuspec_file_content);
+        Zip::ArchiveLayout layout{output_dir / (nuget_id + "." + nuget_version + ".nupkg"), {}};
+        for (auto&& source : sources)
+        {
+            layout.names.push_back(source.is_directory ? "" : escape_part_name(source.name));
+        }
 
-        // -NoDefaultExcludes is needed for ".vcpkg-root"
-        const auto cmd_line = Strings::format(R"("%s" pack -OutputDirectory "%s" "%s" -NoDefaultExcludes > nul)",
-                                              nuget_exe.u8string(),
-                                              output_dir.u8string(),
-                                              nuspec_file_path.u8string());
+        const auto add_part = [&](const std::string& name, std::string contents) {
+            layout.names.push_back(name);
+            sources.push_back({name, false, {}, std::move(contents)});
+        };
 
-        const int exit_code = System::cmd_execute_clean(cmd_line);
-        Checks::check_exit(VCPKG_LINE_INFO, exit_code == 0, "Error: NuGet package creation failed");
+        const std::string nuspec_part_name = escape_part_name(nuget_id + ".nuspec");
+        add_part("_rels/.rels", create_relationships(nuspec_part_name));
+        add_part(nuspec_part_name, create_nuspec_file_contents(nuget_id, nuget_version));
+        // This file will be placed in "build\native" in the nuget package. Therefore, go up two dirs.
+        add_part(escape_part_name("build/native/" + nuget_id + ".targets"),
+                 create_targets_redirect("../../scripts/buildsystems/msbuild/vcpkg.targets"));
+        add_part("[Content_Types].xml", create_content_types(layout.names));
+        return layout;
+    }
 
-        const fs::path output_path = output_dir / (nuget_id + "." + nuget_version + ".nupkg");
-        return output_path;
+    /// <summary>
+    /// Lays the first `tree_size` entries of `sources`, which are the exported tree, out as a zip archive with all of
+    /// them in a directory named after the export.
+    /// </summary>
+    static Zip::ArchiveLayout make_zip_layout(const std::vector<Zip::SourceEntry>& sources,
+                                              const size_t tree_size,
+                                              const std::string& export_id,
+                                              const fs::path& output_dir)
+    {
+        Zip::ArchiveLayout layout{output_dir / (export_id + ".zip"), {}};
+        for (size_t i = 0; i < tree_size; ++i)
+        {
+            layout.names.push_back(export_id + "/" + sources[i].name);
+        }
+        return layout;
     }
 
     struct ArchiveFormat final
     {
         enum class BackingEnum
         {
-            ZIP = 1,
-            SEVEN_ZIP,
+            SEVEN_ZIP = 1,
         };
 
         constexpr ArchiveFormat() = delete;
@@ -186,7 +272,6 @@ namespace vcpkg::Export
 
     namespace ArchiveFormatC
     {
-        constexpr const ArchiveFormat ZIP(ArchiveFormat::BackingEnum::ZIP, "zip", "zip");
         constexpr const ArchiveFormat SEVEN_ZIP(ArchiveFormat::BackingEnum::SEVEN_ZIP, "7z", "7zip");
     }
 
@@ -223,17 +308,20 @@ namespace vcpkg::Export
         return nullopt;
     }
 
-    void export_integration_files(const fs::path& raw_exported_dir_path, const VcpkgPaths& paths)
+    std::vector<fs::path> get_integration_files_relative_to_root()
     {
-        const std::vector<fs::path> integration_files_relative_to_root = {
+        return {
             {".vcpkg-root"},
             {fs::path {"scripts"} / "buildsystems" / "msbuild" / "applocal.ps1"},
             {fs::path {"scripts"} / "buildsystems" / "msbuild" / "vcpkg.targets"},
             {fs::path {"scripts"} / "buildsystems" / "vcpkg.cmake"},
             {fs::path {"scripts"} / "cmake" / "vcpkg_get_windows_sdk.cmake"},
         };
+    }
 
-        for (const fs::path& file : integration_files_relative_to_root)
+    void export_integration_files(const fs::path& raw_exported_dir_path, const VcpkgPaths& paths)
+    {
+        for (const fs::path& file : get_integration_files_relative_to_root())
         {
             const fs::path source = paths.root / file;
             fs::path destination = raw_exported_dir_path / file;
@@ -308,16 +396,16 @@ namespace vcpkg::Export
     };
 
     static ExportArguments handle_export_command_arguments(const VcpkgCmdArguments& args,
-                                                           const Triplet& default_triplet)
+                                                           const Triplet& default_triplet,
+                                                           const VcpkgPaths& paths)
     {
         ExportArguments ret;
 
         const auto options = args.parse_arguments(COMMAND_STRUCTURE);
 
         // input sanitization
-        ret.specs = Util::fmap(args.command_arguments, [&](auto&& arg) {
-            return Input::check_and_get_package_spec(arg, default_triplet, COMMAND_STRUCTURE.example_text);
-        });
+        ret.specs = Input::check_and_get_package_specs(
+            args.command_arguments, default_triplet, COMMAND_STRUCTURE.example_text, paths);
         ret.dry_run = options.switches.find(OPTION_DRY_RUN) != options.switches.cend();
         ret.raw = options.switches.find(OPTION_RAW) != options.switches.cend();
         ret.nuget = options.switches.find(OPTION_NUGET) != options.switches.cend();
@@ -390,42 +478,160 @@ namespace vcpkg::Export
                         cmake_variable.s);
     }
 
-    static void handle_raw_based_export(Span<const ExportPlanAction> export_plan,
-                                        const ExportArguments& opts,
-                                        const std::string& export_id,
-                                        const VcpkgPaths& paths)
+    /// <summary>The packages of an export plan and their dependencies, for Graphs::topological_levels().</summary>
+    struct ExportPlanGraph final : Graphs::AdjacencyProvider<PackageSpec, const ExportPlanAction*>
+    {
+        std::unordered_map<PackageSpec, const ExportPlanAction*> actions;
+
+        std::vector<PackageSpec> adjacency_list(const ExportPlanAction* const& action) const override
+        {
+            return action->dependencies(action->spec.triplet());
+        }
+
+        const ExportPlanAction* load_vertex_data(const PackageSpec& spec) const override { return actions.at(spec); }
+
+        std::string to_string(const PackageSpec& spec) const override { return spec.to_string(); }
+    };
+
+    /// <summary>
+    /// The tree that staging writes, listed with the sources of its files instead of copying them, so archives are
+    /// written without a staging copy. Names are relative to the root of the export, and every directory comes
+    /// before its contents.
+    /// </summary>
+    static std::vector<Zip::SourceEntry> list_export_tree(Span<const ExportPlanAction> export_plan,
+                                                          const VcpkgPaths& paths)
+    {
+        Files::Filesystem& fs = paths.get_filesystem();
+
+        std::map<std::string, Zip::SourceEntry> tree;
+        const auto add = [&](Zip::SourceEntry entry) {
+            for (auto slash = entry.name.find('/'); slash != std::string::npos && slash + 1 < entry.name.size();
+                 slash = entry.name.find('/', slash + 1))
+            {
+                const std::string parent = entry.name.substr(0, slash + 1);
+                tree.emplace(parent, Zip::SourceEntry{parent, true, {}, {}});
+            }
+            const std::string name = entry.name;
+            tree[name] = std::move(entry);
+        };
+
+        for (const ExportPlanAction& action : export_plan)
+        {
+            const BinaryParagraph& binary_paragraph = action.core_paragraph().value_or_exit(VCPKG_LINE_INFO);
+            const std::string triplet = action.spec.triplet().to_string();
+            const fs::path package_dir = paths.package_dir(action.spec);
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               fs.exists(package_dir),
+                               "Source directory %s does not exist",
+                               package_dir.generic_string());
+
+            // Mirrors Install::install_files_and_write_listfile()
+            std::vector<std::string> listfile_lines{triplet + "/"};
+            add({"installed/" + triplet + "/", true, {}, {}});
+            for (auto&& entry : PackageTreeSnapshot::create(fs, package_dir).entries)
+            {
+                if (Install::is_package_metadata(entry)) continue;
+
+                const std::string installed = triplet + "/" + entry.relative;
+                if (entry.is_directory())
+                {
+                    listfile_lines.push_back(installed + "/");
+                    add({"installed/" + installed + "/", true, entry.path, {}});
+                }
+                else if (entry.type == fs::file_type::regular || entry.type == fs::file_type::symlink)
+                {
+                    listfile_lines.push_back(installed);
+
+                    // Archives follow symlinks, and skip those that point to nothing
+                    std::error_code ec;
+                    if (entry.type == fs::file_type::symlink && !fs::stdfs::is_regular_file(entry.path, ec)) continue;
+                    add({"installed/" + installed, false, entry.path, {}});
+                }
+            }
+            Util::sort(listfile_lines);
+
+            std::string listfile;
+            for (auto&& line : listfile_lines)
+            {
+                listfile += line;
+                listfile += '\n';
+            }
+            add({"installed/vcpkg/info/" + binary_paragraph.fullstem() + ".list", false, {}, std::move(listfile)});
+        }
+
+        for (const fs::path& file : get_integration_files_relative_to_root())
+        {
+            add({file.generic_u8string(), false, paths.root / file, {}});
+        }
+
+        return Util::fmap(tree, [](auto&& name_and_entry) { return name_and_entry.second; });
+    }
+
+    static void stage_export(Span<const ExportPlanAction> export_plan,
+                             const fs::path& raw_exported_dir_path,
+                             const VcpkgPaths& paths)
     {
         Files::Filesystem& fs = paths.get_filesystem();
-        const fs::path export_to_path = paths.root;
-        const fs::path raw_exported_dir_path = export_to_path / export_id;
         std::error_code ec;
         fs.remove_all(raw_exported_dir_path, ec);
         fs.create_directory(raw_exported_dir_path, ec);
 
-        // execute the plan
+        ExportPlanGraph graph;
+        std::vector<PackageSpec> specs;
         for (const ExportPlanAction& action : export_plan)
         {
-            if (action.plan_type != ExportPlanType::ALREADY_BUILT)
-            {
-                Checks::unreachable(VCPKG_LINE_INFO);
-            }
+            graph.actions.emplace(action.spec, &action);
+            specs.push_back(action.spec);
+        }
 
-            const std::string display_name = action.spec.to_string();
-            System::println("Exporting package %s... ", display_name);
+        // execute the plan; installed packages never share files, so the packages of a level are exported together
+        for (auto&& level : Graphs::topological_levels(specs, graph))
+        {
+            ThreadPool::parallel_for(level.size(), [&](size_t i) {
+                const ExportPlanAction& action = *level[i];
+                const std::string display_name = action.spec.to_string();
+                System::println("Exporting package %s... ", display_name);
 
-            const BinaryParagraph& binary_paragraph = action.core_paragraph().value_or_exit(VCPKG_LINE_INFO);
+                const BinaryParagraph& binary_paragraph = action.core_paragraph().value_or_exit(VCPKG_LINE_INFO);
 
-            const InstallDir dirs = InstallDir::from_destination_root(
-                raw_exported_dir_path / "installed",
-                action.spec.triplet().to_string(),
-                raw_exported_dir_path / "installed" / "vcpkg" / "info" / (binary_paragraph.fullstem() + ".list"));
+                const InstallDir dirs = InstallDir::from_destination_root(
+                    raw_exported_dir_path / "installed",
+                    action.spec.triplet().to_string(),
+                    raw_exported_dir_path / "installed" / "vcpkg" / "info" / (binary_paragraph.fullstem() + ".list"));
 
-            Install::install_files_and_write_listfile(paths.get_filesystem(), paths.package_dir(action.spec), dirs);
-            System::println(System::Color::success, "Exporting package %s... done", display_name);
+                Install::install_files_and_write_listfile(fs, paths.package_dir(action.spec), dirs);
+                System::println(System::Color::success, "Exporting package %s... done", display_name);
+            });
         }
 
         // Copy files needed for integration
         export_integration_files(raw_exported_dir_path, paths);
+    }
+
+    static void handle_raw_based_export(Span<const ExportPlanAction> export_plan,
+                                        const ExportArguments& opts,
+                                        const std::string& export_id,
+                                        const VcpkgPaths& paths)
+    {
+        for (const ExportPlanAction& action : export_plan)
+        {
+            if (action.plan_type != ExportPlanType::ALREADY_BUILT)
+            {
+                Checks::unreachable(VCPKG_LINE_INFO);
+            }
+        }
+
+        Files::Filesystem& fs = paths.get_filesystem();
+        const fs::path export_to_path = paths.root;
+        const fs::path raw_exported_dir_path = export_to_path / export_id;
+
+        // Zip archives and NuGet packages are written straight from the packages; only the raw export itself and the
+        // 7zip archive, which is written by cmake, need the tree on disk
+        const bool stage = opts.raw || opts.seven_zip;
+        if (stage)
+        {
+            stage_export(export_plan, raw_exported_dir_path, paths);
+        }
 
         if (opts.raw)
         {
@@ -434,34 +640,56 @@ namespace vcpkg::Export
             print_next_step_info(raw_exported_dir_path);
         }
 
-        if (opts.nuget)
+        if (opts.nuget || opts.zip)
         {
-            System::println("Creating nuget package... ");
+            // Both are written in one pass, so each exported file is read and deflated once
+            std::vector<Zip::SourceEntry> sources = list_export_tree(export_plan, paths);
+            const size_t tree_size = sources.size();
 
             const std::string nuget_id = opts.maybe_nuget_id.value_or(raw_exported_dir_path.filename().string());
             const std::string nuget_version = opts.maybe_nuget_version.value_or("1.0.0");
-            const fs::path output_path =
-                do_nuget_export(paths, nuget_id, nuget_version, raw_exported_dir_path, export_to_path);
-            System::println(System::Color::success, "Creating nuget package... done");
-            System::println(System::Color::success, "NuGet package exported at: %s", output_path.generic_string());
+            std::vector<Zip::ArchiveLayout> layouts;
+            std::vector<std::string> descriptions;
+            if (opts.nuget)
+            {
+                layouts.push_back(make_nuget_layout(sources, nuget_id, nuget_version, export_to_path));
+                descriptions.push_back("nuget package");
+            }
+            if (opts.zip)
+            {
+                layouts.push_back(make_zip_layout(sources, tree_size, export_id, export_to_path));
+                descriptions.push_back("zip archive");
+            }
 
-            System::println(R"(
+            const std::string description = Strings::join(" and ", descriptions);
+            System::println("Creating %s... ", description);
+            const auto maybe_compressed = Zip::compress_entries(sources, layouts);
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               maybe_compressed.has_value(),
+                               "Error: %s creation failed: %s",
+                               description,
+                               maybe_compressed.error());
+            System::println(System::Color::success, "Creating %s... done", description);
+
+            if (opts.nuget)
+            {
+                const fs::path& output_path = layouts.front().path;
+                System::println(System::Color::success, "NuGet package exported at: %s", output_path.generic_string());
+                System::println(R"(
 With a project open, go to Tools->NuGet Package Manager->Package Manager Console and paste:
     Install-Package %s -Source "%s"
 )"
-                            "\n",
-                            nuget_id,
-                            output_path.parent_path().u8string());
-        }
+                                "\n",
+                                nuget_id,
+                                output_path.parent_path().u8string());
+            }
 
-        if (opts.zip)
-        {
-            System::println("Creating zip archive... ");
-            const fs::path output_path =
-                do_archive_export(paths, raw_exported_dir_path, export_to_path, ArchiveFormatC::ZIP);
-            System::println(System::Color::success, "Creating zip archive... done");
-            System::println(System::Color::success, "Zip archive exported at: %s", output_path.generic_string());
-            print_next_step_info("[...]");
+            if (opts.zip)
+            {
+                const fs::path& output_path = layouts.back().path;
+                System::println(System::Color::success, "Zip archive exported at: %s", output_path.generic_string());
+                print_next_step_info("[...]");
+            }
         }
 
         if (opts.seven_zip)
@@ -474,20 +702,21 @@ With a project open, go to Tools->NuGet Package Manager->Package Manager Console
             print_next_step_info("[...]");
         }
 
-        if (!opts.raw)
+        if (stage && !opts.raw)
         {
+            std::error_code ec;
             fs.remove_all(raw_exported_dir_path, ec);
         }
     }
 
     void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet)
     {
-        const auto opts = handle_export_command_arguments(args, default_triplet);
-        for (auto&& spec : opts.specs)
-            Input::check_triplet(spec.triplet(), paths);
+        const auto opts = handle_export_command_arguments(args, default_triplet, paths);
 
         // create the plan
-        const StatusParagraphs status_db = database_load_check(paths);
+        // The files are exported from this tree
+        const StatusParagraphs status_db =
+            database_load_check(paths, opts.dry_run ? InstalledBase::MERGE : InstalledBase::IMPORT);
         Dependencies::PathsPortFileProvider provider(paths);
         std::vector<ExportPlanAction> export_plan = Dependencies::create_export_plan(opts.specs, status_db);
         Checks::check_exit(VCPKG_LINE_INFO, !export_plan.empty(), "Export plan cannot be empty");
@@ -10,6 +10,9 @@ namespace vcpkg
     std::atomic<bool> GlobalState::debugging(false);
     std::atomic<bool> GlobalState::feature_packages(true);
     std::atomic<bool> GlobalState::g_binary_caching(false);
+    std::atomic<bool> GlobalState::g_link_installed_files(false);
+    std::atomic<bool> GlobalState::g_release_only(false);
+    std::atomic<bool> GlobalState::g_output_abi(false);
 
     std::atomic<int> GlobalState::g_init_console_cp(0);
     std::atomic<int> GlobalState::g_init_console_output_cp(0);
@@ -17,22 +20,27 @@ namespace vcpkg
 
     GlobalState::CtrlCStateMachine GlobalState::g_ctrl_c_state;
 
-    GlobalState::CtrlCStateMachine::CtrlCStateMachine() : m_state(CtrlCState::normal) {}
+    GlobalState::CtrlCStateMachine::CtrlCStateMachine() : m_state(CtrlCState::normal), m_children(0) {}
 
     void GlobalState::CtrlCStateMachine::transition_to_spawn_process() noexcept
     {
-        auto expected = CtrlCState::normal;
+        std::lock_guard<std::mutex> lock(m_children_mutex);
+        auto expected = m_children == 0 ? CtrlCState::normal : CtrlCState::blocked_on_child;
         auto transitioned = m_state.compare_exchange_strong(expected, CtrlCState::blocked_on_child);
         if (!transitioned)
         {
             // Ctrl-C was hit and is asynchronously executing on another thread
             Checks::exit_fail(VCPKG_LINE_INFO);
         }
+        ++m_children;
     }
     void GlobalState::CtrlCStateMachine::transition_from_spawn_process() noexcept
     {
+        std::lock_guard<std::mutex> lock(m_children_mutex);
+        --m_children;
         auto expected = CtrlCState::blocked_on_child;
-        auto transitioned = m_state.compare_exchange_strong(expected, CtrlCState::normal);
+        auto transitioned = m_state.compare_exchange_strong(
+            expected, m_children == 0 ? CtrlCState::normal : CtrlCState::blocked_on_child);
         if (!transitioned)
         {
             // Ctrl-C was hit while blocked on the child process
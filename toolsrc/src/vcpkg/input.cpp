@@ -8,15 +8,14 @@
 
 namespace vcpkg::Input
 {
-    PackageSpec check_and_get_package_spec(const std::string& package_spec_as_string,
-                                           const Triplet& default_triplet,
-                                           CStringView example_text)
+    static FullPackageSpec parse_or_exit(const std::string& as_lowercase,
+                                         const Triplet& default_triplet,
+                                         CStringView example_text)
     {
-        const std::string as_lowercase = Strings::ascii_to_lowercase(package_spec_as_string);
         auto expected_spec = FullPackageSpec::from_string(as_lowercase, default_triplet);
         if (const auto spec = expected_spec.get())
         {
-            return PackageSpec{spec->package_spec};
+            return std::move(*spec);
         }
 
         // Intentionally show the lowercased string
@@ -25,6 +24,25 @@ namespace vcpkg::Input
         Checks::exit_fail(VCPKG_LINE_INFO);
     }
 
+    /// <summary>
+    /// Checks `t` unless it is in `checked` already. Command lines seldom name more than a few triplets, so a
+    /// vector is the cheapest set to keep them in.
+    /// </summary>
+    static void check_triplet_once(std::vector<Triplet>& checked, const Triplet& t, const VcpkgPaths& paths)
+    {
+        if (Util::find(checked, t) != checked.end()) return;
+        check_triplet(t, paths);
+        checked.push_back(t);
+    }
+
+    PackageSpec check_and_get_package_spec(const std::string& package_spec_as_string,
+                                           const Triplet& default_triplet,
+                                           CStringView example_text)
+    {
+        const std::string as_lowercase = Strings::ascii_to_lowercase(package_spec_as_string);
+        return parse_or_exit(as_lowercase, default_triplet, example_text).package_spec;
+    }
+
     void check_triplet(const Triplet& t, const VcpkgPaths& paths)
     {
         if (!paths.is_valid_triplet(t))
@@ -41,15 +59,45 @@ namespace vcpkg::Input
                                                     CStringView example_text)
     {
         const std::string as_lowercase = Strings::ascii_to_lowercase(full_package_spec_as_string);
-        auto expected_spec = FullPackageSpec::from_string(as_lowercase, default_triplet);
-        if (const auto spec = expected_spec.get())
+        return parse_or_exit(as_lowercase, default_triplet, example_text);
+    }
+
+    std::vector<PackageSpec> check_and_get_package_specs(const std::vector<std::string>& package_specs_as_strings,
+                                                         const Triplet& default_triplet,
+                                                         CStringView example_text,
+                                                         const VcpkgPaths& paths)
+    {
+        std::vector<PackageSpec> specs;
+        specs.reserve(package_specs_as_strings.size());
+        std::vector<Triplet> checked;
+        std::string as_lowercase;
+        for (auto&& package_spec_as_string : package_specs_as_strings)
         {
-            return *spec;
+            as_lowercase.assign(package_spec_as_string);
+            as_lowercase = Strings::ascii_to_lowercase(std::move(as_lowercase));
+            specs.push_back(parse_or_exit(as_lowercase, default_triplet, example_text).package_spec);
+            check_triplet_once(checked, specs.back().triplet(), paths);
         }
+        return specs;
+    }
 
-        // Intentionally show the lowercased string
-        System::println(System::Color::error, "Error: %s: %s", vcpkg::to_string(expected_spec.error()), as_lowercase);
-        System::print(example_text);
-        Checks::exit_fail(VCPKG_LINE_INFO);
+    std::vector<FullPackageSpec> check_and_get_full_package_specs(
+        const std::vector<std::string>& full_package_specs_as_strings,
+        const Triplet& default_triplet,
+        CStringView example_text,
+        const VcpkgPaths& paths)
+    {
+        std::vector<FullPackageSpec> specs;
+        specs.reserve(full_package_specs_as_strings.size());
+        std::vector<Triplet> checked;
+        std::string as_lowercase;
+        for (auto&& full_package_spec_as_string : full_package_specs_as_strings)
+        {
+            as_lowercase.assign(full_package_spec_as_string);
+            as_lowercase = Strings::ascii_to_lowercase(std::move(as_lowercase));
+            specs.push_back(parse_or_exit(as_lowercase, default_triplet, example_text));
+            check_triplet_once(checked, specs.back().package_spec.triplet(), paths);
+        }
+        return specs;
     }
 }
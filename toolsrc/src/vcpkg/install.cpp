@@ -1,17 +1,27 @@
 #include "pch.h"
 
 #include <vcpkg/base/files.h>
+#include <vcpkg/base/json.h>
+#include <vcpkg/base/openmetrics.h>
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/threadpool.h>
+#include <vcpkg/base/trace.h>
+#include <vcpkg/base/transfers.h>
 #include <vcpkg/base/util.h>
 #include <vcpkg/build.h>
+#include <vcpkg/buildhistory.h>
+#include <vcpkg/cmakeindex.h>
 #include <vcpkg/commands.h>
 #include <vcpkg/dependencies.h>
+#include <vcpkg/distfiles.h>
 #include <vcpkg/globalstate.h>
 #include <vcpkg/help.h>
 #include <vcpkg/input.h>
 #include <vcpkg/install.h>
 #include <vcpkg/metrics.h>
+#include <vcpkg/msbuildprops.h>
 #include <vcpkg/paragraphs.h>
+#include <vcpkg/planfile.h>
 #include <vcpkg/remove.h>
 #include <vcpkg/vcpkglib.h>
 
@@ -36,20 +46,89 @@ namespace vcpkg::Install
 
     const fs::path& InstallDir::listfile() const { return this->m_listfile; }
 
+    /// <summary>
+    /// Makes target a copy-on-write clone or else a hard link of source when the file system allows it, and a copy
+    /// only otherwise.
+    /// </summary>
+    static void link_file(Files::Filesystem& fs, const fs::path& source, const fs::path& target, std::error_code& ec)
+    {
+        // Once cloning failed the installed tree is on a file system without it, so stop trying
+        static std::atomic<bool> s_can_clone{true};
+
+        fs.remove(target, ec);
+        if (s_can_clone)
+        {
+            fs.clone_file(source, target, ec);
+            if (!ec) return;
+            s_can_clone = false;
+        }
+
+        fs.create_hard_link(source, target, ec);
+        if (!ec) return;
+
+        fs.copy_file(source, target, fs::copy_options::overwrite_existing, ec);
+    }
+
+    /// <summary>Copies source to target, or links it with the linkinstall feature flag.</summary>
+    static void install_file(Files::Filesystem& fs, const fs::path& source, const fs::path& target, std::error_code& ec)
+    {
+        if (GlobalState::g_link_installed_files)
+            link_file(fs, source, target, ec);
+        else
+            fs.copy_file(source, target, fs::copy_options::overwrite_existing, ec);
+    }
+
+    bool is_package_metadata(const PackageTreeSnapshot::Entry& entry)
+    {
+        const std::string filename = entry.path.filename().u8string();
+        return entry.type == fs::file_type::regular && (Strings::case_insensitive_ascii_equals(filename, "CONTROL") ||
+                                                        Strings::case_insensitive_ascii_equals(filename, "BUILD_INFO"));
+    }
+
     void install_files_and_write_listfile(Files::Filesystem& fs,
                                           const fs::path& source_dir,
                                           const InstallDir& destination_dir)
     {
+        Checks::check_exit(
+            VCPKG_LINE_INFO, fs.exists(source_dir), "Source directory %s does not exist", source_dir.generic_string());
+        install_files_and_write_listfile(fs,
+                                         PackageTreeSnapshot::create(fs, source_dir),
+                                         destination_dir,
+                                         Build::CleanPackages::NO,
+                                         fs::path());
+    }
+
+    static bool files_are_equal(const Files::Filesystem& fs, const fs::path& a, const uintmax_t size_a, const fs::path& b)
+    {
+        // Restoring a package links the files it did not change, so those are not even read
+        std::error_code ec;
+        if (fs::stdfs::equivalent(a, b, ec)) return true;
+        ec.clear();
+
+        const auto size_b = fs::stdfs::file_size(b, ec);
+        if (ec || size_a != size_b) return false;
+
+        const auto maybe_a = fs.map_contents(a);
+        const auto maybe_b = fs.map_contents(b);
+        const auto contents_a = maybe_a.get();
+        const auto contents_b = maybe_b.get();
+        return contents_a && contents_b && (*contents_a)->contents() == (*contents_b)->contents();
+    }
+
+    void install_files_and_write_listfile(Files::Filesystem& fs,
+                                          const PackageTreeSnapshot& source,
+                                          const InstallDir& destination_dir,
+                                          const Build::CleanPackages clean_packages,
+                                          const fs::path& replaced_dir)
+    {
+        const bool move_files = clean_packages == Build::CleanPackages::YES;
         std::vector<std::string> output;
         std::error_code ec;
 
-        const size_t prefix_length = source_dir.native().size();
         const fs::path& destination = destination_dir.destination();
         const std::string& destination_subdirectory = destination_dir.destination_subdirectory();
         const fs::path& listfile = destination_dir.listfile();
 
-        Checks::check_exit(
-            VCPKG_LINE_INFO, fs.exists(source_dir), "Source directory %s does not exist", source_dir.generic_string());
         fs.create_directories(destination, ec);
         Checks::check_exit(
             VCPKG_LINE_INFO, !ec, "Could not create destination directory %s", destination.generic_string());
@@ -59,28 +138,37 @@ namespace vcpkg::Install
             VCPKG_LINE_INFO, !ec, "Could not create directory for listfile %s", listfile.generic_string());
 
         output.push_back(Strings::format(R"(%s/)", destination_subdirectory));
-        auto files = fs.get_files_recursive(source_dir);
-        for (auto&& file : files)
+
+        // Each copy is a round trip to the file system, which is slow on network drives and under virus scanners, so
+        // everything but creating the directories is spread over several threads.
+
+        // Directories come before their contents, so they are created first and in order
+        struct Copy
         {
-            const auto status = fs.symlink_status(file, ec);
-            if (ec)
+            size_t index;
+            fs::path target;
+        };
+        std::vector<Copy> copies;
+        for (size_t i = 0; i < source.entries.size(); ++i)
+        {
+            const PackageTreeSnapshot::Entry& entry = source.entries[i];
+            const fs::path& file = entry.path;
+            if (entry.type == fs::file_type::none)
             {
-                System::println(System::Color::error, "failed: %s: %s", file.u8string(), ec.message());
+                System::println(System::Color::error, "failed: %s: could not read status", file.u8string());
                 continue;
             }
 
-            const std::string filename = file.filename().u8string();
-            if (fs::is_regular_file(status) && (Strings::case_insensitive_ascii_equals(filename, "CONTROL") ||
-                                                Strings::case_insensitive_ascii_equals(filename, "BUILD_INFO")))
+            if (is_package_metadata(entry))
             {
                 // Do not copy the control file
                 continue;
             }
 
-            const std::string suffix = file.generic_u8string().substr(prefix_length + 1);
-            const fs::path target = destination / suffix;
+            const std::string& suffix = entry.relative;
+            fs::path target = destination / suffix;
 
-            switch (status.type())
+            switch (entry.type)
             {
                 case fs::file_type::directory:
                 {
@@ -95,37 +183,10 @@ namespace vcpkg::Install
                     break;
                 }
                 case fs::file_type::regular:
-                {
-                    if (fs.exists(target))
-                    {
-                        System::println(System::Color::warning,
-                                        "File %s was already present and will be overwritten",
-                                        target.u8string(),
-                                        ec.message());
-                    }
-                    fs.copy_file(file, target, fs::copy_options::overwrite_existing, ec);
-                    if (ec)
-                    {
-                        System::println(System::Color::error, "failed: %s: %s", target.u8string(), ec.message());
-                    }
-                    output.push_back(Strings::format(R"(%s/%s)", destination_subdirectory, suffix));
-                    break;
-                }
                 case fs::file_type::symlink:
                 {
-                    if (fs.exists(target))
-                    {
-                        System::println(System::Color::warning,
-                                        "File %s was already present and will be overwritten",
-                                        target.u8string(),
-                                        ec.message());
-                    }
-                    fs.copy_symlink(file, target, ec);
-                    if (ec)
-                    {
-                        System::println(System::Color::error, "failed: %s: %s", target.u8string(), ec.message());
-                    }
                     output.push_back(Strings::format(R"(%s/%s)", destination_subdirectory, suffix));
+                    copies.push_back({i, std::move(target)});
                     break;
                 }
                 default:
@@ -134,77 +195,137 @@ namespace vcpkg::Install
             }
         }
 
+        // Set once a move fails because packages is on another volume, such as a RAM disk, where every move would fail
+        std::atomic<bool> cross_volume{false};
+        ThreadPool::parallel_for(copies.size(), copies.size() / 8 + 1, [&](size_t i) {
+            const PackageTreeSnapshot::Entry& entry = source.entries[copies[i].index];
+            const fs::path& file = entry.path;
+            const fs::path& target = copies[i].target;
+            std::error_code copy_ec;
+            if (fs.exists(target))
+            {
+                System::println(System::Color::warning,
+                                "File %s was already present and will be overwritten",
+                                target.u8string());
+            }
+
+            if (!replaced_dir.empty() && entry.type == fs::file_type::regular)
+            {
+                const fs::path previous = replaced_dir / destination_subdirectory / entry.relative;
+                if (files_are_equal(fs, file, entry.size, previous))
+                {
+                    fs.rename(previous, target, copy_ec);
+                    if (!copy_ec) return;
+                    copy_ec.clear();
+                }
+            }
+
+            if (move_files && !cross_volume)
+            {
+                // Renaming fails across volumes, and only then is the file copied
+                fs.rename(file, target, copy_ec);
+                if (!copy_ec) return;
+                if (copy_ec == std::errc::cross_device_link) cross_volume = true;
+                copy_ec.clear();
+            }
+
+            if (entry.type == fs::file_type::symlink)
+                fs.copy_symlink(file, target, copy_ec);
+            else
+                install_file(fs, file, target, copy_ec);
+
+            if (copy_ec)
+            {
+                System::println(System::Color::error, "failed: %s: %s", target.u8string(), copy_ec.message());
+            }
+        });
+
         std::sort(output.begin(), output.end());
 
         fs.write_lines(listfile, output);
     }
 
-    static void remove_first_n_chars(std::vector<std::string>* strings, const size_t n)
+    /// <summary>
+    /// The files installed in one triplet, relative to the triplet's directory, grouped by the package that owns them.
+    /// </summary>
+    struct InstalledFilesIndex
     {
-        for (std::string& s : *strings)
+        std::unordered_map<std::string, std::vector<std::string>> files_of_package;
+        std::unordered_set<std::string> files;
+
+        /// <summary>
+        /// Brings the index in line with the packages that status_db lists as installed in triplet. Only the
+        /// listfiles of packages that were installed since the previous call are read.
+        /// </summary>
+        void update(const VcpkgPaths& paths, const StatusParagraphs& status_db, const Triplet& triplet)
         {
-            s.erase(0, n);
-        }
-    };
+            const size_t installed_remove_char_count = triplet.canonical_name().size() + 1; // +1 for the slash
 
-    static std::vector<std::string> extract_files_in_triplet(
-        const std::vector<StatusParagraphAndAssociatedFiles>& pgh_and_files, const Triplet& triplet)
-    {
-        std::vector<std::string> output;
-        for (const StatusParagraphAndAssociatedFiles& t : pgh_and_files)
-        {
-            if (t.pgh.package.spec.triplet() != triplet)
+            std::unordered_set<std::string> installed;
+            for (const std::unique_ptr<StatusParagraph>& pgh : status_db)
             {
-                continue;
-            }
-
-            Util::Vectors::concatenate(&output, t.files);
-        }
+                if (!pgh->is_installed() || !pgh->package.feature.empty() || pgh->package.spec.triplet() != triplet)
+                {
+                    continue;
+                }
 
-        std::sort(output.begin(), output.end());
-        return output;
-    }
+                const std::string& name = pgh->package.spec.name();
+                installed.insert(name);
+                if (files_of_package.find(name) != files_of_package.end()) continue;
 
-    static SortedVector<std::string> build_list_of_package_files(const Files::Filesystem& fs,
-                                                                 const fs::path& package_dir)
-    {
-        const std::vector<fs::path> package_file_paths = fs.get_files_recursive(package_dir);
-        const size_t package_remove_char_count = package_dir.generic_string().size() + 1; // +1 for the slash
-        auto package_files = Util::fmap(package_file_paths, [package_remove_char_count](const fs::path& path) {
-            std::string as_string = path.generic_string();
-            as_string.erase(0, package_remove_char_count);
-            return std::move(as_string);
-        });
+                auto& package_files = files_of_package[name];
+                for (const std::string& file : get_installed_files(paths, *pgh))
+                {
+                    package_files.push_back(file.substr(installed_remove_char_count));
+                    files.insert(package_files.back());
+                }
+            }
 
-        return SortedVector<std::string>(std::move(package_files));
-    }
+            for (auto it = files_of_package.begin(); it != files_of_package.end();)
+            {
+                if (installed.find(it->first) != installed.end())
+                {
+                    ++it;
+                    continue;
+                }
 
-    static SortedVector<std::string> build_list_of_installed_files(
-        const std::vector<StatusParagraphAndAssociatedFiles>& pgh_and_files, const Triplet& triplet)
-    {
-        std::vector<std::string> installed_files = extract_files_in_triplet(pgh_and_files, triplet);
-        const size_t installed_remove_char_count = triplet.canonical_name().size() + 1; // +1 for the slash
-        remove_first_n_chars(&installed_files, installed_remove_char_count);
+                for (const std::string& file : it->second)
+                    files.erase(file);
+                it = files_of_package.erase(it);
+            }
+        }
+    };
 
-        return SortedVector<std::string>(std::move(installed_files));
-    }
+    // Kept for the whole run, so each conflict check costs as much as the package it checks and not the whole tree
+    static Util::LockGuarded<std::map<std::string, InstalledFilesIndex>> s_installed_files;
 
-    InstallResult install_package(const VcpkgPaths& paths, const BinaryControlFile& bcf, StatusParagraphs* status_db)
+    InstallResult install_package(const VcpkgPaths& paths,
+                                  const BinaryControlFile& bcf,
+                                  StatusParagraphs* status_db,
+                                  const Build::CleanPackages clean_packages)
     {
+        Trace::Scope trace("install", bcf.core_paragraph.spec.to_string());
+
         const fs::path package_dir = paths.package_dir(bcf.core_paragraph.spec);
         const Triplet& triplet = bcf.core_paragraph.spec.triplet();
-        const std::vector<StatusParagraphAndAssociatedFiles> pgh_and_files = get_installed_files(paths, *status_db);
 
-        const SortedVector<std::string> package_files =
-            build_list_of_package_files(paths.get_filesystem(), package_dir);
-        const SortedVector<std::string> installed_files = build_list_of_installed_files(pgh_and_files, triplet);
+        auto& fs = paths.get_filesystem();
+
+        // The conflict check and the copy below both need the package's files, so the directory is walked only once
+        const PackageTreeSnapshot package_tree = PackageTreeSnapshot::create(fs, package_dir);
+        const SortedVector<std::string> package_files(
+            Util::fmap(package_tree.entries, [](const PackageTreeSnapshot::Entry& entry) { return entry.relative; }));
 
         std::vector<std::string> intersection;
-        std::set_intersection(package_files.begin(),
-                              package_files.end(),
-                              installed_files.begin(),
-                              installed_files.end(),
-                              std::back_inserter(intersection));
+        {
+            auto installed_files = s_installed_files.lock();
+            auto& index = (*installed_files)[triplet.canonical_name()];
+            index.update(paths, *status_db, triplet);
+            for (const std::string& file : package_files)
+            {
+                if (index.files.find(file) != index.files.end()) intersection.push_back(file);
+            }
+        }
 
         if (!intersection.empty())
         {
@@ -219,173 +340,2236 @@ namespace vcpkg::Install
             return InstallResult::FILE_CONFLICTS;
         }
 
-        StatusParagraph source_paragraph;
-        source_paragraph.package = bcf.core_paragraph;
-        source_paragraph.want = Want::INSTALL;
-        source_paragraph.state = InstallState::HALF_INSTALLED;
+        // The core paragraph comes first, followed by one paragraph per feature
+        std::vector<StatusParagraph> status_pghs(bcf.features.size() + 1);
+        status_pghs[0].package = bcf.core_paragraph;
+        for (size_t i = 0; i < bcf.features.size(); ++i)
+        {
+            status_pghs[i + 1].package = bcf.features[i];
+        }
+
+        for (auto&& pgh : status_pghs)
+        {
+            pgh.want = Want::INSTALL;
+            pgh.state = InstallState::HALF_INSTALLED;
+        }
+        write_update(paths, status_pghs);
+        for (auto&& pgh : status_pghs)
+        {
+            status_db->insert(std::make_unique<StatusParagraph>(pgh));
+        }
+
+        const InstallDir install_dir = InstallDir::from_destination_root(
+            paths.installed, triplet.to_string(), paths.listfile_path(bcf.core_paragraph));
+
+        const fs::path replaced_dir = Remove::replaced_files_dir(paths, bcf.core_paragraph.spec);
+        if (fs.exists(replaced_dir))
+        {
+            install_files_and_write_listfile(fs, package_tree, install_dir, clean_packages, replaced_dir);
+            std::error_code ec;
+            fs.remove_all(replaced_dir, ec);
+        }
+        else
+        {
+            install_files_and_write_listfile(fs, package_tree, install_dir, clean_packages, fs::path());
+        }
+
+        std::vector<std::string> installed_files;
+        for (auto&& entry : package_tree.entries)
+        {
+            if (!entry.is_directory() && !is_package_metadata(entry)) installed_files.push_back(entry.relative);
+        }
+        CMakeIndex::store(paths,
+                          bcf.core_paragraph.spec,
+                          CMakeIndex::scan(fs, paths.installed / triplet.canonical_name(), installed_files));
+        MSBuildProps::write_triplet_props(paths, triplet);
+
+        for (auto&& pgh : status_pghs)
+        {
+            pgh.state = InstallState::INSTALLED;
+        }
+        write_update(paths, status_pghs);
+        for (auto&& pgh : status_pghs)
+        {
+            status_db->insert(std::make_unique<StatusParagraph>(std::move(pgh)));
+        }
+
+        return InstallResult::SUCCESS;
+    }
+
+    struct BaseCandidate
+    {
+        const InstalledPackageView* package;
+        /// <summary>The listfile of the package in the shared tree</summary>
+        std::vector<std::string> lines;
+        /// <summary>Set when a file of the package is installed here already, with other contents</summary>
+        bool conflicts = false;
+    };
+
+    void import_installed_base(const VcpkgPaths& paths, StatusParagraphs& status_db)
+    {
+        if (paths.installed_base.empty()) return;
+
+        auto& fs = paths.get_filesystem();
+        const StatusParagraphs base_db = database_load_read_only(fs, paths.installed_base);
+        const std::vector<InstalledPackageView> base_packages = get_installed_ports(base_db);
+
+        // Anything this tree has a record of, even a removal, is its own
+        const StatusParagraphs& installed_db = status_db;
+        std::map<PackageSpec, BaseCandidate> candidates;
+        for (auto&& ipv : base_packages)
+        {
+            if (installed_db.find(ipv.spec()) == installed_db.end()) candidates[ipv.spec()].package = &ipv;
+        }
+        if (candidates.empty()) return;
+
+        Trace::Scope trace("install", "import installed base");
+
+        // Another process may be taking the same packages; a file it linked already is equal, and linked again
+        const auto lock = lock_vcpkg_dir(paths, "installed-base");
+
+        const fs::path base_info_dir = paths.installed_base / "vcpkg" / "info";
+        for (auto&& candidate : candidates)
+        {
+            BaseCandidate& c = candidate.second;
+            const fs::path listfile = base_info_dir / paths.listfile_path(c.package->core->package).filename();
+            auto maybe_lines = fs.read_lines(listfile);
+            auto p_lines = maybe_lines.get();
+            if (!p_lines)
+            {
+                c.conflicts = true;
+                continue;
+            }
+
+            c.lines = std::move(*p_lines);
+            Util::erase_remove_if(c.lines, [](const std::string& line) { return line.empty(); });
+            for (auto&& line : c.lines)
+            {
+                if (line.back() == '/') continue;
+
+                std::error_code ec;
+                const fs::path target = paths.installed / fs::u8path(line);
+                if (!fs::stdfs::exists(fs.symlink_status(target, ec))) continue;
+
+                const fs::path source = paths.installed_base / fs::u8path(line);
+                const auto size = fs::stdfs::file_size(source, ec);
+                if (ec || !files_are_equal(fs, source, size, target))
+                {
+                    System::println(System::Color::warning,
+                                    "Not taking %s from %s: %s is installed here already",
+                                    candidate.first,
+                                    paths.installed_base.u8string(),
+                                    target.u8string());
+                    c.conflicts = true;
+                    break;
+                }
+            }
+        }
+
+        // The packages built against other versions of their dependencies than the ones installed here are not usable
+        std::map<PackageSpec, bool> decisions;
+        const auto can_import = [&](const PackageSpec& spec, const auto& can_import_ref) -> bool {
+            const auto it = decisions.find(spec);
+            if (it != decisions.end()) return it->second;
+
+            // A cycle takes nothing
+            decisions[spec] = false;
+            const BaseCandidate& candidate = candidates.at(spec);
+            if (candidate.conflicts) return false;
+            for (auto&& dependency : candidate.package->dependencies())
+            {
+                if (candidates.count(dependency) != 0)
+                {
+                    if (!can_import_ref(dependency, can_import_ref)) return false;
+                    continue;
+                }
+
+                const auto installed = installed_db.find_installed(dependency);
+                const auto base = base_db.find_installed(dependency);
+                if (installed == installed_db.end() || base == base_db.end() || (*base)->package.abi.empty() ||
+                    (*installed)->package.abi != (*base)->package.abi)
+                {
+                    return false;
+                }
+            }
+
+            decisions[spec] = true;
+            return true;
+        };
+
+        struct Link
+        {
+            fs::path source;
+            fs::path target;
+        };
+        std::vector<Link> links;
+        std::vector<const BaseCandidate*> imports;
+        for (auto&& candidate : candidates)
+        {
+            if (!can_import(candidate.first, can_import)) continue;
+
+            imports.push_back(&candidate.second);
+            for (auto&& line : candidate.second.lines)
+            {
+                const fs::path target = paths.installed / fs::u8path(line);
+                if (line.back() == '/')
+                {
+                    // Directories come before their contents
+                    std::error_code ec;
+                    fs.create_directories(target, ec);
+                }
+                else
+                {
+                    links.push_back({paths.installed_base / fs::u8path(line), target});
+                }
+            }
+        }
+        if (imports.empty()) return;
+
+        std::atomic<bool> failed{false};
+        ThreadPool::parallel_for(links.size(), links.size() / 8 + 1, [&](size_t i) {
+            const Link& link = links[i];
+            std::error_code ec;
+            if (fs.symlink_status(link.source, ec).type() == fs::file_type::symlink)
+            {
+                fs.remove(link.target, ec);
+                fs.copy_symlink(link.source, link.target, ec);
+            }
+            else
+            {
+                link_file(fs, link.source, link.target, ec);
+            }
+
+            if (ec)
+            {
+                System::println(System::Color::error, "failed: %s: %s", link.target.u8string(), ec.message());
+                failed = true;
+            }
+        });
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           !failed,
+                           "Error: Could not take the packages of %s into %s",
+                           paths.installed_base.u8string(),
+                           paths.installed.u8string());
+
+        std::vector<StatusParagraph> status_pghs;
+        std::set<Triplet> triplets;
+        for (const BaseCandidate* candidate : imports)
+        {
+            const InstalledPackageView& ipv = *candidate->package;
+            const Triplet& triplet = ipv.spec().triplet();
+            triplets.insert(triplet);
+            fs.write_lines(paths.listfile_path(ipv.core->package), candidate->lines);
+
+            const size_t triplet_prefix = triplet.canonical_name().size() + 1;
+            std::vector<std::string> files;
+            for (auto&& line : candidate->lines)
+            {
+                if (line.back() != '/' && line.size() > triplet_prefix) files.push_back(line.substr(triplet_prefix));
+            }
+            const fs::path triplet_dir = paths.installed / triplet.canonical_name();
+            CMakeIndex::store(paths, ipv.spec(), CMakeIndex::scan(fs, triplet_dir, files));
+
+            status_pghs.push_back(*ipv.core);
+            for (const StatusParagraph* feature : ipv.features)
+            {
+                status_pghs.push_back(*feature);
+            }
+        }
+        for (auto&& triplet : triplets)
+        {
+            MSBuildProps::write_triplet_props(paths, triplet);
+        }
+
+        write_update(paths, status_pghs);
+        for (auto&& pgh : status_pghs)
+        {
+            status_db.insert(std::make_unique<StatusParagraph>(std::move(pgh)));
+        }
+
+        System::println("Took %zd packages from %s", imports.size(), paths.installed_base.u8string());
+    }
+
+    void merge_installed_base(const VcpkgPaths& paths, StatusParagraphs& status_db)
+    {
+        if (paths.installed_base.empty()) return;
+
+        const StatusParagraphs base_db = database_load_read_only(paths.get_filesystem(), paths.installed_base);
+        std::vector<StatusParagraph> status_pghs;
+        for (auto&& ipv : get_installed_ports(base_db))
+        {
+            if (status_db.find(ipv.spec()) != status_db.end()) continue;
+
+            status_pghs.push_back(*ipv.core);
+            for (const StatusParagraph* feature : ipv.features)
+            {
+                status_pghs.push_back(*feature);
+            }
+        }
+        for (auto&& pgh : status_pghs)
+        {
+            status_db.insert(std::make_unique<StatusParagraph>(std::move(pgh)));
+        }
+    }
+
+    using Build::BuildResult;
+    using Build::ExtendedBuildResult;
+
+    static StatusParagraphs snapshot_status_db(const StatusParagraphs& status_db)
+    {
+        // StatusParagraphs iterates newest first; keep the original order so that find() still prefers newer entries
+        std::vector<std::unique_ptr<StatusParagraph>> paragraphs;
+        for (auto&& pgh : status_db)
+        {
+            paragraphs.push_back(std::make_unique<StatusParagraph>(*pgh));
+        }
+        std::reverse(paragraphs.begin(), paragraphs.end());
+        return StatusParagraphs(std::move(paragraphs));
+    }
+
+    static constexpr StringLiteral CHECKPOINT_HEADER = "vcpkg install checkpoint v1";
 
-        write_update(paths, source_paragraph);
-        status_db->insert(std::make_unique<StatusParagraph>(source_paragraph));
+    /// <summary>
+    /// Records in installed/vcpkg/checkpoint each package whose build finished, keyed by what it was built from. A
+    /// resumed run installs such a package from its packages directory instead of building it again. Packages the
+    /// interrupted run installed need nothing: the status database has them, so the new plan leaves them out.
+    /// </summary>
+    struct InstallCheckpoint
+    {
+        InstallCheckpoint(const VcpkgPaths& paths, const std::vector<AnyAction>& action_plan, const Resume resume)
+            : paths(paths)
+        {
+            auto& fs = paths.get_filesystem();
+            if (resume == Resume::NO)
+            {
+                std::error_code ec;
+                fs.remove(checkpoint_file(), ec);
+                return;
+            }
+
+            auto maybe_lines = fs.read_lines(checkpoint_file());
+            const auto p_lines = maybe_lines.get();
+            if (!p_lines || p_lines->empty() || p_lines->front() != CHECKPOINT_HEADER.c_str()) return;
+            for (auto it = p_lines->begin() + 1; it != p_lines->end(); ++it)
+            {
+                const auto tab = it->find('\t');
+                if (tab != std::string::npos) built.emplace(it->substr(0, tab), it->substr(tab + 1));
+            }
+
+            for (auto&& action : action_plan)
+            {
+                const auto p_install = action.install_action.get();
+                if (!p_install || p_install->plan_type != InstallPlanType::BUILD_AND_INSTALL) continue;
+
+                const auto it = built.find(p_install->spec.to_string());
+                if (it != built.end() && it->second == key_of(*p_install) &&
+                    fs.exists(paths.package_dir(p_install->spec) / "CONTROL"))
+                {
+                    resumed.insert(p_install->spec);
+                }
+            }
+        }
+
+        /// <summary>Whether the package is installed from what the interrupted run built, without a build</summary>
+        bool is_resumed(const PackageSpec& spec) const { return Util::Sets::contains(resumed, spec); }
+
+        size_t resumed_count() const { return resumed.size(); }
+
+        /// <summary>Forgets `spec` before its packages directory is rebuilt</summary>
+        void forget(const PackageSpec& spec)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (built.erase(spec.to_string()) != 0) write();
+        }
+
+        void record_built(const InstallPlanAction& action)
+        {
+            const std::string key = key_of(action);
+            std::lock_guard<std::mutex> lock(mutex);
+            built[action.spec.to_string()] = key;
+            write();
+        }
+
+        /// <summary>Called once the whole plan has succeeded: there is nothing left to resume</summary>
+        void clear()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            built.clear();
+            std::error_code ec;
+            paths.get_filesystem().remove(checkpoint_file(), ec);
+        }
+
+    private:
+        fs::path checkpoint_file() const { return paths.vcpkg_dir / "checkpoint"; }
 
-        std::vector<StatusParagraph> features_spghs;
-        for (auto&& feature : bcf.features)
+        /// <summary>
+        /// The ABI tag when there is one. Without binary caching there is none; the port files and the features stand
+        /// in for it.
+        /// </summary>
+        std::string key_of(const InstallPlanAction& action) const
         {
-            features_spghs.emplace_back();
+            if (auto p_abi = action.planned_abi.get()) return p_abi->tag;
+            return Strings::format("%s;%s",
+                                   Build::hash_port_files(paths.get_filesystem(), paths.port_dir(action.spec)),
+                                   Strings::join(",", action.feature_list));
+        }
+
+        /// <summary>Written to a temporary file and renamed, so an interrupted write keeps the last one</summary>
+        void write() const
+        {
+            auto& fs = paths.get_filesystem();
+            std::string contents = CHECKPOINT_HEADER.c_str();
+            contents.push_back('\n');
+            for (auto&& entry : built)
+            {
+                Strings::append_to(contents, "%s\t%s\n", entry.first, entry.second);
+            }
+
+            const fs::path checkpoint_file_new = paths.vcpkg_dir / "checkpoint-new";
+            std::error_code ec;
+            fs.write_contents(checkpoint_file_new, contents, ec);
+            if (!ec) fs.rename(checkpoint_file_new, checkpoint_file(), ec);
+            if (ec) Debug::println("Failed to write %s: %s", checkpoint_file().u8string(), ec.message());
+        }
+
+        const VcpkgPaths& paths;
+        std::unordered_set<PackageSpec> resumed;
+        std::mutex mutex;
+        std::map<std::string, std::string> built;
+    };
+
+    /// <param name="status_db_mutex">When non-null, guards every access to status_db.</param>
+    /// <param name="concurrency">Number of processors the port build may use, if it is limited.</param>
+    /// <param name="checkpoint">When non-null, records finished builds and supplies those of a past run.</param>
+    static ExtendedBuildResult perform_install_plan_action(const VcpkgPaths& paths,
+                                                           const InstallPlanAction& action,
+                                                           StatusParagraphs& status_db,
+                                                           std::mutex* status_db_mutex,
+                                                           const Optional<unsigned int>& concurrency,
+                                                           const Optional<std::string>& prefetched_abi_tag,
+                                                           InstallCheckpoint* checkpoint)
+    {
+        const InstallPlanType& plan_type = action.plan_type;
+        const std::string display_name = action.spec.to_string();
+        const std::string display_name_with_features =
+            GlobalState::feature_packages ? action.displayname() : display_name;
+
+        const bool is_user_requested = action.request_type == RequestType::USER_REQUESTED;
+        const bool use_head_version = Util::Enum::to_bool(action.build_options.use_head_version);
+
+        if (plan_type == InstallPlanType::ALREADY_INSTALLED)
+        {
+            if (use_head_version && is_user_requested)
+                System::println(
+                    System::Color::warning, "Package %s is already installed -- not building from HEAD", display_name);
+            else
+                System::println(System::Color::success, "Package %s is already installed", display_name);
+            return BuildResult::SUCCEEDED;
+        }
+
+        auto aux_install = [&](const std::string& name,
+                               const BinaryControlFile& bcf,
+                               const Build::CleanPackages clean_packages) -> BuildResult {
+            System::println("Installing package %s... ", name);
+            std::unique_lock<std::mutex> lock;
+            if (status_db_mutex) lock = std::unique_lock<std::mutex>(*status_db_mutex);
+            const auto install_result = install_package(paths, bcf, &status_db, clean_packages);
+            switch (install_result)
+            {
+                case InstallResult::SUCCESS:
+                    System::println(System::Color::success, "Installing package %s... done", name);
+                    return BuildResult::SUCCEEDED;
+                case InstallResult::FILE_CONFLICTS: return BuildResult::FILE_CONFLICTS;
+                default: Checks::unreachable(VCPKG_LINE_INFO);
+            }
+        };
+
+        if (plan_type == InstallPlanType::BUILD_AND_INSTALL && checkpoint && checkpoint->is_resumed(action.spec))
+        {
+            System::println("Package %s was built by the interrupted run", display_name_with_features);
+            auto package_dir_lock = Build::lock_package_dir(paths, action.spec);
+            auto bcf = std::make_unique<BinaryControlFile>(
+                Paragraphs::try_load_cached_package(paths, action.spec).value_or_exit(VCPKG_LINE_INFO));
+            const auto install_timer = Chrono::ElapsedTimer::create_started();
+            const auto code = aux_install(display_name_with_features, *bcf, action.build_options.clean_packages);
+
+            ExtendedBuildResult installed{code, std::move(bcf)};
+            installed.timings.add(Build::BuildPhase::INSTALL, install_timer.elapsed());
+            return installed;
+        }
+
+        if (plan_type == InstallPlanType::BUILD_AND_INSTALL)
+        {
+            if (use_head_version)
+                System::println("Building package %s from HEAD... ", display_name_with_features);
+            else
+                System::println("Building package %s... ", display_name_with_features);
+
+            if (checkpoint) checkpoint->forget(action.spec);
+            auto result = [&]() -> Build::ExtendedBuildResult {
+                Build::BuildPackageConfig build_config{action.source_control_file.value_or_exit(VCPKG_LINE_INFO),
+                                                       action.spec.triplet(),
+                                                       paths.port_dir(action.spec),
+                                                       action.build_options,
+                                                       action.feature_list};
+                build_config.concurrency = concurrency;
+                // Only the parallel executor limits the concurrency, and only its builds overlap
+                build_config.prefix_output = concurrency.has_value();
+                build_config.prefetched_abi_tag = prefetched_abi_tag;
+                build_config.planned_abi = action.planned_abi;
+                if (status_db_mutex)
+                {
+                    const StatusParagraphs status_db_snapshot = [&]() {
+                        std::lock_guard<std::mutex> lock(*status_db_mutex);
+                        return snapshot_status_db(status_db);
+                    }();
+                    return Build::build_package(paths, build_config, status_db_snapshot);
+                }
+                return Build::build_package(paths, build_config, status_db);
+            }();
+
+            if (result.code != Build::BuildResult::SUCCEEDED)
+            {
+                System::println(System::Color::error, Build::create_error_message(result.code, action.spec));
+                return result;
+            }
+
+            System::println("Building package %s... done", display_name_with_features);
+            if (checkpoint) checkpoint->record_built(action);
+            if (auto p_stats = result.compiler_cache.get())
+            {
+                System::println("Compiler cache hits: %zu of %zu", p_stats->hits, p_stats->hits + p_stats->misses);
+            }
+
+            auto bcf = std::make_unique<BinaryControlFile>(
+                Paragraphs::try_load_cached_package(paths, action.spec).value_or_exit(VCPKG_LINE_INFO));
+            // A package from the binary cache can be extracted again, so its files are moved into installed/ instead
+            // of copied, and its package directory goes away with them
+            const auto clean_packages =
+                result.restored ? Build::CleanPackages::YES : action.build_options.clean_packages;
+            // The archives of a new package are made from its package directory in the background; then its files
+            // are copied, and the directory is removed once the archives are stored
+            const bool removal_deferred = clean_packages == Build::CleanPackages::YES &&
+                                          Build::remove_package_dir_after_archive(action.spec);
+            const auto install_timer = Chrono::ElapsedTimer::create_started();
+            auto code = aux_install(
+                display_name_with_features, *bcf, removal_deferred ? Build::CleanPackages::NO : clean_packages);
+            result.timings.add(Build::BuildPhase::INSTALL, install_timer.elapsed());
+
+            if (clean_packages == Build::CleanPackages::YES && !removal_deferred)
+            {
+                Files::remove_all_in_background(paths.get_filesystem(), paths.package_dir(action.spec), paths.packages);
+            }
+
+            ExtendedBuildResult installed{code, std::move(bcf)};
+            installed.timings = result.timings;
+            installed.compiler_cache = result.compiler_cache;
+            installed.peak_memory_kib = result.peak_memory_kib;
+            return installed;
+        }
+
+        if (plan_type == InstallPlanType::EXCLUDED)
+        {
+            System::println(System::Color::warning, "Package %s is excluded", display_name);
+            return BuildResult::EXCLUDED;
+        }
+
+        Checks::unreachable(VCPKG_LINE_INFO);
+    }
+
+    ExtendedBuildResult perform_install_plan_action(const VcpkgPaths& paths,
+                                                    const InstallPlanAction& action,
+                                                    StatusParagraphs& status_db)
+    {
+        return perform_install_plan_action(paths, action, status_db, nullptr, nullopt, nullopt, nullptr);
+    }
+
+    void ScheduleEstimate::print() const
+    {
+        const auto plan_order_us = plan_order.as<std::chrono::microseconds>().count();
+        const auto critical_path_us = critical_path_first.as<std::chrono::microseconds>().count();
+        const double reduction =
+            plan_order_us > 0 ? 100.0 * static_cast<double>(plan_order_us - critical_path_us) / plan_order_us : 0.0;
+        System::println("Estimated makespan with %zd jobs: %s critical path first, %s in plan order (%.1f%% shorter)",
+                        jobs,
+                        critical_path_first.to_string(),
+                        plan_order.to_string(),
+                        reduction);
+    }
+
+    void InstallSummary::print() const
+    {
+        System::println("RESULTS");
+
+        for (const SpecSummary& result : this->results)
+        {
+            System::println("    %s: %s: %s", result.spec, Build::to_string(result.build_result.code), result.timing);
+            const std::string phases = result.build_result.timings.to_string();
+            if (!phases.empty()) System::println("        %s", phases);
+            if (auto p_stats = result.build_result.compiler_cache.get())
+            {
+                const size_t compilations = p_stats->hits + p_stats->misses;
+                if (compilations != 0)
+                {
+                    System::println("        compiler cache: %zu of %zu compilations hit (%zu%%)",
+                                    p_stats->hits,
+                                    compilations,
+                                    p_stats->hits * 100 / compilations);
+                }
+            }
+        }
+
+        std::map<BuildResult, int> summary;
+        for (const BuildResult& v : Build::BUILD_RESULT_VALUES)
+        {
+            summary[v] = 0;
+        }
+
+        for (const SpecSummary& r : this->results)
+        {
+            summary[r.build_result.code]++;
+        }
+
+        System::println("\nSUMMARY");
+        for (const std::pair<const BuildResult, int>& entry : summary)
+        {
+            System::println("    %s: %d", Build::to_string(entry.first), entry.second);
+        }
+
+        Build::CompilerCacheStats compiler_cache;
+        for (const SpecSummary& r : this->results)
+        {
+            if (auto p_stats = r.build_result.compiler_cache.get())
+            {
+                compiler_cache.hits += p_stats->hits;
+                compiler_cache.misses += p_stats->misses;
+            }
+        }
+        if (const size_t compilations = compiler_cache.hits + compiler_cache.misses)
+        {
+            System::println("    COMPILER_CACHE_HITS: %zu of %zu", compiler_cache.hits, compilations);
+        }
+
+        if (auto p_estimate = schedule_estimate.get())
+        {
+            p_estimate->print();
+        }
+    }
+
+    static void resolve_shared_build_state(const VcpkgPaths& paths,
+                                           const std::vector<AnyAction>& action_plan,
+                                           const InstallCheckpoint& checkpoint)
+    {
+        // The tool and toolset caches in VcpkgPaths are not synchronized, so everything a build looks up is resolved
+        // here, before any worker thread starts.
+        std::vector<Triplet> triplets;
+        bool uses_binary_caching = false;
+        for (auto&& action : action_plan)
+        {
+            if (auto p_install = action.install_action.get())
+            {
+                if (p_install->plan_type != InstallPlanType::BUILD_AND_INSTALL) continue;
+                if (checkpoint.is_resumed(p_install->spec)) continue;
+                triplets.push_back(p_install->spec.triplet());
+                if (p_install->build_options.binary_caching == Build::BinaryCaching::YES) uses_binary_caching = true;
+            }
+        }
+        if (triplets.empty()) return;
+
+        Util::sort_unique_erase(triplets);
+
+        vcpkg::Util::unused(paths.get_tool_exe(Tools::CMAKE));
+        vcpkg::Util::unused(paths.get_tool_version(Tools::CMAKE));
+        vcpkg::Util::unused(paths.get_tool_exe(Tools::GIT));
+        if (uses_binary_caching)
+        {
+            // Cached archives of any format may be restored, so zstd is resolved whenever it is available
+            if (paths.get_binary_cache().uses_format(ArchiveFormat::TAR_ZSTD) ||
+                !paths.get_filesystem().find_from_PATH(Tools::ZSTD).empty())
+                vcpkg::Util::unused(paths.get_tool_exe(Tools::ZSTD));
+        }
+#if !defined(_WIN32)
+        vcpkg::Util::unused(paths.get_tool_exe(Tools::NINJA));
+#endif
+
+        for (auto&& triplet : triplets)
+        {
+            const auto pre_build_info = Build::PreBuildInfo::from_triplet_file(paths, triplet);
+            vcpkg::Util::unused(paths.get_toolset(pre_build_info));
+        }
+    }
+
+    static std::vector<std::chrono::microseconds> estimate_durations(const VcpkgPaths& paths,
+                                                                     const std::vector<AnyAction>& action_plan)
+    {
+        const auto history = BuildHistory::load_durations(paths);
+
+        // Packages without a recorded build are assumed to take as long as an average known package
+        std::chrono::microseconds fallback = std::chrono::seconds(1);
+        if (!history.empty())
+        {
+            std::chrono::microseconds total{};
+            for (auto&& entry : history)
+            {
+                total += entry.second;
+            }
+            fallback = total / history.size();
+        }
+
+        return Util::fmap(action_plan, [&](const AnyAction& action) -> std::chrono::microseconds {
+            const auto p_install = action.install_action.get();
+            if (!p_install || p_install->plan_type != InstallPlanType::BUILD_AND_INSTALL) return {};
+            const auto it = history.find(p_install->spec);
+            return it != history.end() ? it->second : fallback;
+        });
+    }
+
+    template<class Compare>
+    static Chrono::ElapsedTime simulate_makespan(const std::vector<std::chrono::microseconds>& weights,
+                                                 const std::vector<std::vector<size_t>>& dependents,
+                                                 std::vector<size_t> remaining_dependencies,
+                                                 const size_t first_install,
+                                                 const size_t jobs,
+                                                 const Compare& compare)
+    {
+        using Event = std::pair<std::chrono::microseconds, size_t>;
+        std::priority_queue<Event, std::vector<Event>, std::greater<Event>> running;
+        std::set<size_t, Compare> ready(compare);
+        for (size_t i = first_install; i < weights.size(); ++i)
+        {
+            if (remaining_dependencies[i] == 0) ready.insert(i);
+        }
+
+        std::chrono::microseconds now{};
+        while (!ready.empty() || !running.empty())
+        {
+            while (running.size() < jobs && !ready.empty())
+            {
+                running.emplace(now + weights[*ready.begin()], *ready.begin());
+                ready.erase(ready.begin());
+            }
+
+            const Event finished = running.top();
+            running.pop();
+            now = finished.first;
+            for (auto&& dependent : dependents[finished.second])
+            {
+                if (--remaining_dependencies[dependent] == 0) ready.insert(dependent);
+            }
+        }
+
+        return std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(now);
+    }
+
+    struct PlanGraph
+    {
+        std::vector<size_t> remaining_dependencies;
+        std::vector<std::vector<size_t>> dependents;
+    };
+
+    static size_t count_leading_removes(const std::vector<AnyAction>& action_plan)
+    {
+        size_t count = 0;
+        while (count < action_plan.size() && action_plan[count].remove_action.has_value())
+            ++count;
+        return count;
+    }
+
+    static PlanGraph make_plan_graph(const std::vector<AnyAction>& action_plan, const size_t first_install)
+    {
+        const size_t package_count = action_plan.size();
+
+        // Edges only point to earlier actions in the plan, so the topological order guarantees progress
+        std::unordered_map<PackageSpec, size_t> index_of;
+        for (size_t i = first_install; i < package_count; ++i)
+        {
+            index_of.emplace(action_plan[i].spec(), i);
+        }
+
+        PlanGraph graph{std::vector<size_t>(package_count, 0), std::vector<std::vector<size_t>>(package_count)};
+        for (size_t i = first_install; i < package_count; ++i)
+        {
+            const auto p_install = action_plan[i].install_action.get();
+            Checks::check_exit(
+                VCPKG_LINE_INFO, p_install != nullptr, "Remove actions must precede install actions in the plan");
+
+            std::vector<size_t> dependency_indices;
+            for (auto&& dependency : p_install->computed_dependencies)
+            {
+                const auto it = index_of.find(dependency);
+                if (it != index_of.end() && it->second < i) dependency_indices.push_back(it->second);
+            }
+            Util::sort_unique_erase(dependency_indices);
+
+            graph.remaining_dependencies[i] = dependency_indices.size();
+            for (auto&& dependency_index : dependency_indices)
+            {
+                graph.dependents[dependency_index].push_back(i);
+            }
+        }
+        return graph;
+    }
+
+    /// <summary>
+    /// Decides when each action of a plan may start. An install waits for the installs of its dependencies, as in the
+    /// plan graph. A remove runs only once it is in the way: when the executor picks the install of the same package,
+    /// or before a package it depends on has to be removed. Until then the installed package stays usable, so an
+    /// upgrade removes and rebuilds the tree in waves instead of uninstalling everything up front.
+    /// </summary>
+    struct ActionScheduler
+    {
+        ActionScheduler(const std::vector<AnyAction>& action_plan,
+                        const size_t first_install,
+                        const PlanGraph& graph,
+                        const StatusParagraphs& status_db)
+            : m_first_install(first_install)
+            , m_remaining_dependencies(graph.remaining_dependencies)
+            , m_dependents(graph.dependents)
+            , m_remove_of(action_plan.size())
+            , m_install_of(first_install)
+            , m_removed_first(first_install)
+            , m_removes_waiting(first_install)
+            , m_remaining_removes(first_install, 0)
+            , m_demanded(first_install, false)
+            , m_removed(first_install, false)
+            , m_waiting_for_remove(action_plan.size(), false)
+        {
+            std::unordered_map<PackageSpec, size_t> remove_index_of;
+            for (size_t i = 0; i < first_install; ++i)
+            {
+                remove_index_of.emplace(action_plan[i].spec(), i);
+            }
+
+            for (size_t i = first_install; i < action_plan.size(); ++i)
+            {
+                const auto it = remove_index_of.find(action_plan[i].spec());
+                if (it == remove_index_of.end()) continue;
+                m_remove_of[i] = it->second;
+                m_install_of[it->second] = i;
+            }
+
+            // The installed packages that depend on a package are removed before it, so the database never records a
+            // package whose dependency is missing
+            for (size_t i = 0; i < first_install; ++i)
+            {
+                const auto maybe_ipv = status_db.find_all_installed(action_plan[i].spec());
+                const auto p_ipv = maybe_ipv.get();
+                if (!p_ipv) continue;
+                for (auto&& dependency : p_ipv->dependencies())
+                {
+                    const auto it = remove_index_of.find(dependency);
+                    if (it == remove_index_of.end()) continue;
+                    m_removed_first[it->second].push_back(i);
+                    m_removes_waiting[i].push_back(it->second);
+                    ++m_remaining_removes[it->second];
+                }
+            }
+
+            for (size_t i = 0; i < first_install; ++i)
+            {
+                // Nothing installs these again, so there is no reason to keep them
+                if (!m_install_of[i].has_value()) demand_remove(i);
+            }
+            for (size_t i = first_install; i < action_plan.size(); ++i)
+            {
+                if (m_remaining_dependencies[i] == 0) m_ready.push_back(i);
+            }
+        }
+
+        bool is_remove(const size_t index) const { return index < m_first_install; }
+
+        /// <summary>
+        /// The actions that became ready since the last call, in no particular order. An install among them may still
+        /// need the old package removed; see needs_remove.
+        /// </summary>
+        std::vector<size_t> take_ready() { return std::move(m_ready); }
+
+        bool needs_remove(const size_t index) const
+        {
+            const auto p_remove = m_remove_of[index].get();
+            return p_remove && !m_removed[*p_remove];
+        }
+
+        /// <summary>
+        /// Called instead of starting an install that needs_remove: schedules the removes it waits for. The install
+        /// becomes ready again once they are done.
+        /// </summary>
+        void demand_remove_for(const size_t index)
+        {
+            m_waiting_for_remove[index] = true;
+            demand_remove(*m_remove_of[index].get());
+        }
+
+        void finish(const size_t index)
+        {
+            if (is_remove(index))
+            {
+                m_removed[index] = true;
+                for (auto&& waiting : m_removes_waiting[index])
+                {
+                    if (--m_remaining_removes[waiting] == 0 && m_demanded[waiting]) m_ready.push_back(waiting);
+                }
+                const auto p_install = m_install_of[index].get();
+                if (p_install && m_waiting_for_remove[*p_install]) m_ready.push_back(*p_install);
+                return;
+            }
+
+            for (auto&& dependent : m_dependents[index])
+            {
+                if (--m_remaining_dependencies[dependent] == 0) m_ready.push_back(dependent);
+            }
+        }
+
+    private:
+        void demand_remove(const size_t index)
+        {
+            std::vector<size_t> pending{index};
+            while (!pending.empty())
+            {
+                const size_t remove = pending.back();
+                pending.pop_back();
+                if (m_demanded[remove]) continue;
+                m_demanded[remove] = true;
+                if (m_remaining_removes[remove] == 0) m_ready.push_back(remove);
+                pending.insert(pending.end(), m_removed_first[remove].begin(), m_removed_first[remove].end());
+            }
+        }
+
+        const size_t m_first_install;
+        std::vector<size_t> m_remaining_dependencies;
+        const std::vector<std::vector<size_t>>& m_dependents;
+
+        std::vector<Optional<size_t>> m_remove_of;
+        std::vector<Optional<size_t>> m_install_of;
+        std::vector<std::vector<size_t>> m_removed_first;
+        std::vector<std::vector<size_t>> m_removes_waiting;
+        std::vector<size_t> m_remaining_removes;
+        std::vector<bool> m_demanded;
+        std::vector<bool> m_removed;
+        std::vector<bool> m_waiting_for_remove;
+        std::vector<size_t> m_ready;
+    };
+
+    /// <summary>
+    /// Purging only clears packages/, not the installed tree, so it is done for every remove action up front: the
+    /// archive prefetcher restores into the same directories while the removes themselves are still deferred.
+    /// </summary>
+    static void purge_removed_package_dirs(const VcpkgPaths& paths,
+                                           const std::vector<AnyAction>& action_plan,
+                                           const size_t first_install)
+    {
+        auto& fs = paths.get_filesystem();
+        for (size_t i = 0; i < first_install; ++i)
+        {
+            Files::remove_all_in_background(fs, paths.packages / action_plan[i].spec().dir(), paths.packages);
+        }
+    }
+
+    /// <summary>
+    /// The bottom level of each action: its own weight plus the longest chain of weights among its dependents.
+    /// </summary>
+    static std::vector<std::chrono::microseconds> critical_path_priorities(
+        const std::vector<std::chrono::microseconds>& weights,
+        const std::vector<std::vector<size_t>>& dependents,
+        const size_t first_install)
+    {
+        std::vector<std::chrono::microseconds> priorities(weights.size());
+        for (size_t i = weights.size(); i-- > first_install;)
+        {
+            std::chrono::microseconds longest_dependent{};
+            for (auto&& dependent : dependents[i])
+            {
+                longest_dependent = std::max(longest_dependent, priorities[dependent]);
+            }
+            priorities[i] = weights[i] + longest_dependent;
+        }
+        return priorities;
+    }
+
+    void plan_abi_tags(const VcpkgPaths& paths, std::vector<AnyAction>& action_plan)
+    {
+        std::unordered_map<PackageSpec, std::string> abi_tags;
+        std::map<Triplet, Build::PreBuildInfo> pre_build_infos;
+
+        // A package's level is one more than the deepest of its dependencies in the plan. The tags of one level only
+        // depend on earlier levels, so each level is computed in parallel.
+        std::unordered_map<PackageSpec, size_t> levels_by_spec;
+        std::vector<std::vector<InstallPlanAction*>> levels;
+
+        for (auto&& action : action_plan)
+        {
+            const auto p_install = action.install_action.get();
+            if (!p_install) continue;
+
+            p_install->planned_abi = nullopt;
+            if (p_install->source_control_file.has_value())
+            {
+                if (p_install->build_options.binary_caching == Build::BinaryCaching::NO) continue;
+
+                // The files of a dependency built by this plan are not known yet, so the tag waits for the build
+                if (GlobalState::g_output_abi &&
+                    !std::all_of(p_install->computed_dependencies.begin(),
+                                 p_install->computed_dependencies.end(),
+                                 [&](const PackageSpec& spec) { return Util::Sets::contains(abi_tags, spec); }))
+                {
+                    continue;
+                }
+
+                size_t level = 0;
+                for (auto&& spec : p_install->computed_dependencies)
+                {
+                    const auto it = levels_by_spec.find(spec);
+                    if (it != levels_by_spec.end()) level = std::max(level, it->second + 1);
+                }
+                levels_by_spec.emplace(p_install->spec, level);
+                if (levels.size() <= level) levels.resize(level + 1);
+                levels[level].push_back(p_install);
+
+                const auto& triplet = p_install->spec.triplet();
+                if (!Util::Sets::contains(pre_build_infos, triplet))
+                    pre_build_infos.emplace(triplet, Build::PreBuildInfo::from_triplet_file(paths, triplet));
+            }
+            else if (auto ipv = p_install->installed_package.get())
+            {
+                const std::string& abi = Build::dependency_abi(ipv->core->package);
+                if (!abi.empty()) abi_tags.emplace(p_install->spec, abi);
+            }
+        }
+
+        if (levels.empty()) return;
+
+        // Finds cmake before the workers need its version; tool lookup is not thread-safe
+        Util::unused(paths.get_tool_version(Tools::CMAKE));
+
+        for (auto&& level : levels)
+        {
+            const auto planned_abis = ThreadPool::parallel_transform(level, [&](InstallPlanAction* p_install) {
+                const auto& triplet = p_install->spec.triplet();
+                const Build::BuildPackageConfig build_config{*p_install->source_control_file.get(),
+                                                             triplet,
+                                                             paths.port_dir(p_install->spec),
+                                                             p_install->build_options,
+                                                             p_install->feature_list};
+
+                const auto dependency_abis =
+                    Util::fmap(p_install->computed_dependencies, [&](const PackageSpec& spec) -> Build::AbiEntry {
+                        const auto it = abi_tags.find(spec);
+                        return {spec.name(), it == abi_tags.end() ? "" : it->second};
+                    });
+
+                return Build::compute_abi_tag(paths, build_config, pre_build_infos.at(triplet), dependency_abis);
+            });
+
+            for (size_t i = 0; i < level.size(); ++i)
+            {
+                level[i]->planned_abi = planned_abis[i];
+                if (auto tag_and_file = planned_abis[i].get())
+                {
+                    abi_tags.emplace(level[i]->spec, tag_and_file->tag);
+                }
+            }
+        }
+    }
+
+    std::unordered_map<PackageSpec, std::string> get_abi_tags(const std::vector<AnyAction>& action_plan)
+    {
+        std::unordered_map<PackageSpec, std::string> abi_tags;
+        for (auto&& action : action_plan)
+        {
+            const auto p_install = action.install_action.get();
+            if (!p_install) continue;
+
+            if (auto tag_and_file = p_install->planned_abi.get())
+            {
+                abi_tags.emplace(p_install->spec, tag_and_file->tag);
+            }
+            else if (auto ipv = p_install->installed_package.get())
+            {
+                const std::string& abi = ipv->core->package.abi;
+                if (!abi.empty()) abi_tags.emplace(p_install->spec, abi);
+            }
+        }
+        return abi_tags;
+    }
+
+    /// <summary>
+    /// What a plan is expected to cost. Per action, whether the binary cache has its package, which is only known
+    /// for builds while binary caching is on, and how long it should take; then the whole plan run with `jobs`.
+    /// </summary>
+    struct PlanForecast
+    {
+        std::vector<Optional<bool>> cached;
+        std::vector<std::chrono::microseconds> durations;
+        Chrono::ElapsedTime makespan;
+    };
+
+    static PlanForecast forecast_plan(const VcpkgPaths& paths, const std::vector<AnyAction>& action_plan, size_t jobs)
+    {
+        PlanForecast forecast;
+        forecast.cached.resize(action_plan.size());
+        forecast.durations = estimate_durations(paths, action_plan);
+
+        if (GlobalState::g_binary_caching)
+        {
+            const auto abi_tags = get_abi_tags(action_plan);
+
+            std::vector<size_t> build_indices;
+            std::vector<std::string> build_tags;
+            for (size_t i = 0; i < action_plan.size(); ++i)
+            {
+                const auto p_install = action_plan[i].install_action.get();
+                if (!p_install || p_install->plan_type != InstallPlanType::BUILD_AND_INSTALL) continue;
+                build_indices.push_back(i);
+                const auto it = abi_tags.find(p_install->spec);
+                build_tags.push_back(it == abi_tags.end() ? "" : it->second);
+            }
+
+            // Packages without a tag can never be restored; probe only the rest, all at once
+            std::vector<std::string> known_tags = build_tags;
+            Util::erase_remove_if(known_tags, [](const std::string& tag) { return tag.empty(); });
+            const auto known_found = paths.get_binary_cache().has_archives(known_tags);
+
+            for (size_t i = 0, known = 0; i < build_indices.size(); ++i)
+            {
+                const bool found = !build_tags[i].empty() && known_found[known++];
+                forecast.cached[build_indices[i]] = found;
+                if (found) forecast.durations[build_indices[i]] = {};
+            }
+        }
+
+        const size_t first_install = count_leading_removes(action_plan);
+        const PlanGraph graph = make_plan_graph(action_plan, first_install);
+        const auto priorities = critical_path_priorities(forecast.durations, graph.dependents, first_install);
+        forecast.makespan = simulate_makespan(forecast.durations,
+                                              graph.dependents,
+                                              graph.remaining_dependencies,
+                                              first_install,
+                                              jobs,
+                                              [&](size_t lhs, size_t rhs) {
+                                                  if (priorities[lhs] != priorities[rhs])
+                                                      return priorities[lhs] > priorities[rhs];
+                                                  return lhs < rhs;
+                                              });
+        return forecast;
+    }
+
+    static void print_binary_cache_forecast(const VcpkgPaths& paths,
+                                            const std::vector<AnyAction>& action_plan,
+                                            const size_t jobs)
+    {
+        const bool has_builds = std::any_of(action_plan.begin(), action_plan.end(), [](const AnyAction& action) {
+            const auto p_install = action.install_action.get();
+            return p_install && p_install->plan_type == InstallPlanType::BUILD_AND_INSTALL;
+        });
+        if (!has_builds) return;
+
+        const PlanForecast forecast = forecast_plan(paths, action_plan, jobs);
+
+        std::vector<const InstallPlanAction*> restored;
+        std::vector<const InstallPlanAction*> built;
+        for (size_t i = 0; i < action_plan.size(); ++i)
+        {
+            const auto p_cached = forecast.cached[i].get();
+            if (!p_cached) continue;
+            (*p_cached ? restored : built).push_back(action_plan[i].install_action.get());
+        }
+
+        static auto to_list = [](std::vector<const InstallPlanAction*>& v) {
+            std::sort(v.begin(), v.end(), &InstallPlanAction::compare_by_name);
+            return Strings::join("\n", v, [](const InstallPlanAction* p) { return "    " + p->displayname(); });
+        };
+
+        if (!restored.empty())
+        {
+            System::println("The following packages will be restored from the binary cache:\n%s", to_list(restored));
+        }
+        if (!built.empty())
+        {
+            System::println("The following packages are not in the binary cache and will be built:\n%s",
+                            to_list(built));
+        }
+
+        System::println("Estimated build time with %zd jobs: %s (%zd restored from cache, %zd built)",
+                        jobs,
+                        forecast.makespan.to_string(),
+                        restored.size(),
+                        built.size());
+    }
+
+    static const char* plan_type_name(const AnyAction& action)
+    {
+        const auto p_install = action.install_action.get();
+        if (!p_install) return "remove";
+        switch (p_install->plan_type)
+        {
+            case InstallPlanType::BUILD_AND_INSTALL: return "build";
+            case InstallPlanType::ALREADY_INSTALLED: return "already-installed";
+            case InstallPlanType::EXCLUDED: return "excluded";
+            default: Checks::unreachable(VCPKG_LINE_INFO);
+        }
+    }
+
+    static const char* request_type_name(const RequestType request_type)
+    {
+        switch (request_type)
+        {
+            case RequestType::USER_REQUESTED: return "user";
+            case RequestType::AUTO_SELECTED: return "auto";
+            default: return "unknown";
+        }
+    }
+
+    static void print_plan_json(const VcpkgPaths& paths, const std::vector<AnyAction>& action_plan, const size_t jobs)
+    {
+        const PlanForecast forecast = forecast_plan(paths, action_plan, jobs);
+        const auto abi_tags = get_abi_tags(action_plan);
+
+        Json::Writer json;
+        json.start_object();
+        json.key("jobs").number(static_cast<int64_t>(jobs));
+        json.key("estimated_us").number(forecast.makespan.as<std::chrono::microseconds>().count());
+        json.key("actions").start_array();
+        for (size_t i = 0; i < action_plan.size(); ++i)
+        {
+            const AnyAction& action = action_plan[i];
+            json.start_object();
+            json.key("spec").string(action.spec().to_string());
+            json.key("type").string(plan_type_name(action));
+            if (auto p_remove = action.remove_action.get())
+            {
+                json.key("request").string(request_type_name(p_remove->request_type));
+                json.end_object();
+                continue;
+            }
+
+            const InstallPlanAction& install = action.install_action.value_or_exit(VCPKG_LINE_INFO);
+            json.key("request").string(request_type_name(install.request_type));
+            if (auto p_scf = install.source_control_file.get())
+                json.key("version").string(p_scf->core_paragraph->version);
+            else if (auto p_ipv = install.installed_package.get())
+                json.key("version").string(p_ipv->core->package.version);
+
+            json.key("features").start_array();
+            for (auto&& feature : install.feature_list)
+                json.string(feature);
+            json.end_array();
+
+            const auto it_abi = abi_tags.find(install.spec);
+            if (it_abi != abi_tags.end())
+                json.key("abi").string(it_abi->second);
+            else
+                json.key("abi").null();
+
+            if (auto p_cached = forecast.cached[i].get())
+                json.key("cached").boolean(*p_cached);
+            else
+                json.key("cached").null();
+
+            json.key("estimated_us").number(forecast.durations[i].count());
+            json.end_object();
+        }
+        json.end_array();
+        json.end_object();
+    }
+
+    /// <summary>The priority the transfers for each install action run at; actions not in it get the default.</summary>
+    using TransferPriorities = std::unordered_map<PackageSpec, int64_t>;
+
+    static int64_t transfer_priority_of(const TransferPriorities& priorities, const PackageSpec& spec)
+    {
+        const auto it = priorities.find(spec);
+        return it == priorities.end() ? Transfers::FOREGROUND : it->second;
+    }
+
+    /// <summary>
+    /// Downloads and extracts predicted binary cache hits into packages/ on background threads while the executor is
+    /// still busy with earlier actions, staying at most `depth` hits ahead of the furthest one it has reached.
+    /// </summary>
+    struct ArchivePrefetcher
+    {
+        ArchivePrefetcher(const VcpkgPaths& paths,
+                          std::vector<std::pair<PackageSpec, std::string>>&& hits,
+                          const size_t depth,
+                          const TransferPriorities& transfer_priorities)
+            : m_paths(paths)
+            , m_hits(std::move(hits))
+            , m_transfer_priorities(transfer_priorities)
+            , m_states(m_hits.size(), State::PENDING)
+            , m_depth(depth)
+        {
+            for (size_t i = 0; i < m_hits.size(); ++i)
+            {
+                m_index_of.emplace(m_hits[i].first, i);
+            }
+            for (size_t i = 0; i < std::min(depth, m_hits.size()); ++i)
+            {
+                m_workers.emplace_back([this]() { work(); });
+            }
+        }
+
+        ArchivePrefetcher(const ArchivePrefetcher&) = delete;
+        ArchivePrefetcher& operator=(const ArchivePrefetcher&) = delete;
+
+        ~ArchivePrefetcher()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+            }
+            m_cv.notify_all();
+            for (auto&& worker : m_workers)
+            {
+                worker.join();
+            }
+        }
+
+        /// <summary>
+        /// Waits for the prefetch of `spec`, if there is one, and returns the ABI tag extracted into its package
+        /// directory. Also lets the workers move on past `spec`.
+        /// </summary>
+        Optional<std::string> take(const PackageSpec& spec)
+        {
+            const auto it = m_index_of.find(spec);
+            if (it == m_index_of.end()) return nullopt;
+            const size_t index = it->second;
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_consumed = std::max(m_consumed, index + 1);
+            m_cv.notify_all();
+            m_cv.wait(lock, [&]() { return m_states[index] != State::PENDING; });
+            if (m_states[index] == State::RESTORED) return m_hits[index].second;
+            return nullopt;
+        }
+
+        bool is_predicted_hit(const PackageSpec& spec) const { return m_index_of.find(spec) != m_index_of.end(); }
+
+    private:
+        enum class State
+        {
+            PENDING,
+            RESTORED,
+            MISSED,
+        };
+
+        void work()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (true)
+            {
+                m_cv.wait(lock, [&]() {
+                    return m_stopping || m_next == m_hits.size() || m_next < m_consumed + m_depth;
+                });
+                if (m_stopping || m_next == m_hits.size()) return;
+
+                const size_t index = m_next++;
+                lock.unlock();
+                const bool restored = [&]() {
+                    Transfers::PriorityScope priority(transfer_priority_of(m_transfer_priorities, m_hits[index].first));
+                    const auto package_lock = Build::lock_package_dir(m_paths, m_hits[index].first);
+                    return Build::restore_from_binary_cache(m_paths, m_hits[index].first, m_hits[index].second);
+                }();
+                lock.lock();
+
+                m_states[index] = restored ? State::RESTORED : State::MISSED;
+                m_cv.notify_all();
+            }
+        }
+
+        const VcpkgPaths& m_paths;
+        std::vector<std::pair<PackageSpec, std::string>> m_hits;
+        std::unordered_map<PackageSpec, size_t> m_index_of;
+        TransferPriorities m_transfer_priorities;
+
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::vector<State> m_states;
+        size_t m_next = 0;
+        size_t m_consumed = 0;
+        size_t m_depth;
+        bool m_stopping = false;
+        std::vector<std::thread> m_workers;
+    };
+
+    /// <summary>Minimum number of cache hits restored ahead of the packages being installed.</summary>
+    static constexpr size_t PREFETCH_DEPTH = 4;
+
+    static std::unique_ptr<ArchivePrefetcher> make_archive_prefetcher(const VcpkgPaths& paths,
+                                                                      const std::vector<AnyAction>& action_plan,
+                                                                      const size_t jobs,
+                                                                      const TransferPriorities& transfer_priorities,
+                                                                      const InstallCheckpoint& checkpoint)
+    {
+        std::vector<PackageSpec> candidates;
+        for (auto&& action : action_plan)
+        {
+            const auto p_install = action.install_action.get();
+            if (p_install && p_install->plan_type == InstallPlanType::BUILD_AND_INSTALL &&
+                p_install->build_options.binary_caching == Build::BinaryCaching::YES &&
+                !checkpoint.is_resumed(p_install->spec))
+                candidates.push_back(p_install->spec);
+        }
+
+        std::vector<std::pair<PackageSpec, std::string>> hits;
+        if (!candidates.empty())
+        {
+            // The workers reach tools and binary cache state that is resolved lazily
+            resolve_shared_build_state(paths, action_plan, checkpoint);
+
+            const auto abi_tags = get_abi_tags(action_plan);
+            std::vector<std::pair<PackageSpec, std::string>> tagged;
+            for (auto&& spec : candidates)
+            {
+                const auto it = abi_tags.find(spec);
+                if (it != abi_tags.end()) tagged.emplace_back(spec, it->second);
+            }
+
+            const auto found = paths.get_binary_cache().has_archives(
+                Util::fmap(tagged, [](const std::pair<PackageSpec, std::string>& p) { return p.second; }));
+            for (size_t i = 0; i < tagged.size(); ++i)
+            {
+                if (found[i]) hits.push_back(std::move(tagged[i]));
+            }
+        }
+
+        return std::make_unique<ArchivePrefetcher>(
+            paths, std::move(hits), std::max(jobs, PREFETCH_DEPTH), transfer_priorities);
+    }
+
+    /// <summary>
+    /// Downloads the source files of the packages that will be built into downloads/ on background threads, in plan
+    /// order, so builds find them there instead of each waiting on the network in turn. A build that starts before its
+    /// downloads did goes ahead and downloads them itself.
+    /// </summary>
+    struct DistfilePrefetcher
+    {
+        DistfilePrefetcher(const VcpkgPaths& paths,
+                           std::vector<std::pair<PackageSpec, std::vector<Distfiles::Distfile>>>&& ports,
+                           const size_t thread_count,
+                           const TransferPriorities& transfer_priorities)
+            : m_paths(paths)
+            , m_ports(std::move(ports))
+            , m_transfer_priorities(transfer_priorities)
+            , m_states(m_ports.size(), State::PENDING)
+        {
+            for (size_t i = 0; i < m_ports.size(); ++i)
+            {
+                m_index_of.emplace(m_ports[i].first, i);
+            }
+            for (size_t i = 0; i < std::min(thread_count, m_ports.size()); ++i)
+            {
+                m_workers.emplace_back([this]() { work(); });
+            }
+        }
+
+        DistfilePrefetcher(const DistfilePrefetcher&) = delete;
+        DistfilePrefetcher& operator=(const DistfilePrefetcher&) = delete;
+
+        ~DistfilePrefetcher()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+            }
+            m_cv.notify_all();
+            for (auto&& worker : m_workers)
+            {
+                worker.join();
+            }
+        }
+
+        /// <summary>
+        /// Called before `spec` is built: waits for its downloads if they are under way, and cancels them if they
+        /// have not started yet.
+        /// </summary>
+        void wait_for(const PackageSpec& spec)
+        {
+            const auto it = m_index_of.find(spec);
+            if (it == m_index_of.end()) return;
+            const size_t index = it->second;
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_states[index] == State::PENDING) m_states[index] = State::DONE;
+            m_cv.wait(lock, [&]() { return m_states[index] == State::DONE; });
+        }
+
+    private:
+        enum class State
+        {
+            PENDING,
+            DOWNLOADING,
+            DONE,
+        };
+
+        void work()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (true)
+            {
+                while (m_next < m_ports.size() && m_states[m_next] != State::PENDING)
+                    ++m_next;
+                if (m_stopping || m_next == m_ports.size()) return;
+
+                const size_t index = m_next++;
+                m_states[index] = State::DOWNLOADING;
+                lock.unlock();
+                {
+                    const auto& spec = m_ports[index].first;
+                    Transfers::PriorityScope priority(transfer_priority_of(m_transfer_priorities, spec));
+                    for (auto&& distfile : m_ports[index].second)
+                    {
+                        Distfiles::prefetch(m_paths, distfile);
+                    }
+                }
+                lock.lock();
+
+                m_states[index] = State::DONE;
+                m_cv.notify_all();
+            }
+        }
+
+        const VcpkgPaths& m_paths;
+        std::vector<std::pair<PackageSpec, std::vector<Distfiles::Distfile>>> m_ports;
+        std::unordered_map<PackageSpec, size_t> m_index_of;
+        TransferPriorities m_transfer_priorities;
+
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::vector<State> m_states;
+        size_t m_next = 0;
+        bool m_stopping = false;
+        std::vector<std::thread> m_workers;
+    };
+
+    /// <summary>Number of source files downloaded at the same time ahead of the builds.</summary>
+    static constexpr size_t DISTFILE_DOWNLOAD_THREADS = 4;
+
+    static std::unique_ptr<DistfilePrefetcher> make_distfile_prefetcher(const VcpkgPaths& paths,
+                                                                        const std::vector<AnyAction>& action_plan,
+                                                                        const ArchivePrefetcher& archive_prefetcher,
+                                                                        const TransferPriorities& transfer_priorities,
+                                                                        const InstallCheckpoint& checkpoint)
+    {
+        auto& fs = paths.get_filesystem();
+        std::vector<std::pair<PackageSpec, std::vector<Distfiles::Distfile>>> ports;
+        for (auto&& action : action_plan)
+        {
+            const auto p_install = action.install_action.get();
+            if (!p_install || p_install->plan_type != InstallPlanType::BUILD_AND_INSTALL) continue;
+            if (p_install->build_options.allow_downloads == Build::AllowDownloads::NO ||
+                p_install->build_options.use_head_version == Build::UseHeadVersion::YES)
+                continue;
+            if (archive_prefetcher.is_predicted_hit(p_install->spec)) continue;
+            if (checkpoint.is_resumed(p_install->spec)) continue;
+
+            const auto maybe_portfile = fs.read_contents(paths.port_dir(p_install->spec) / "portfile.cmake");
+            const auto portfile = maybe_portfile.get();
+            if (!portfile) continue;
+
+            auto distfiles = Distfiles::find_in_portfile(*portfile, p_install->spec.name());
+            if (!distfiles.empty()) ports.emplace_back(p_install->spec, std::move(distfiles));
+        }
+
+        return std::make_unique<DistfilePrefetcher>(
+            paths, std::move(ports), DISTFILE_DOWNLOAD_THREADS, transfer_priorities);
+    }
+
+    /// <summary>
+    /// A package that is removed only to be installed again by the same plan keeps its files aside; installing then
+    /// reuses every file that did not change instead of touching it.
+    /// </summary>
+    static Remove::KeepFiles keep_files_for(const std::vector<AnyAction>& action_plan, const PackageSpec& spec)
+    {
+        const bool reinstalled = std::any_of(action_plan.begin(), action_plan.end(), [&](const AnyAction& action) {
+            return action.install_action.has_value() && action.spec() == spec;
+        });
+        return reinstalled ? Remove::KeepFiles::YES : Remove::KeepFiles::NO;
+    }
+
+    static void discard_replaced_files(const VcpkgPaths& paths, const std::vector<AnyAction>& action_plan)
+    {
+        auto& fs = paths.get_filesystem();
+        for (auto&& action : action_plan)
+        {
+            if (!action.remove_action.has_value()) continue;
+            std::error_code ec;
+            fs.remove_all(Remove::replaced_files_dir(paths, action.spec()), ec);
+        }
+    }
+
+    /// <summary>How long to wait for a package another machine is building before building it here.</summary>
+    static constexpr std::chrono::hours REMOTE_BUILD_TIMEOUT{4};
+    static constexpr std::chrono::seconds REMOTE_BUILD_POLL_INTERVAL{20};
+
+    /// <summary>
+    /// The packages another machine is building. The executors start other packages first, and each of these only
+    /// once the binary cache has its archive or failure tombstone, so that installing it restores the archive or fails
+    /// on the tombstone instead of building it again. A package still missing REMOTE_BUILD_TIMEOUT after it was first
+    /// deferred is built here instead. Callers serialize access, except to `is_finished_remotely`.
+    /// </summary>
+    class RemoteBuilds
+    {
+    public:
+        RemoteBuilds(const VcpkgPaths& paths,
+                     const std::vector<AnyAction>& action_plan,
+                     const std::unordered_set<PackageSpec>& built_elsewhere,
+                     const ArchivePrefetcher& prefetcher)
+            : m_paths(paths)
+            , m_action_plan(action_plan)
+            , m_awaited(action_plan.size(), false)
+            , m_gave_up(action_plan.size(), false)
+            , m_deferred(action_plan.size())
+        {
+            for (size_t index = 0; index < action_plan.size(); ++index)
+            {
+                const auto p_install = action_plan[index].install_action.get();
+                if (!p_install || !p_install->planned_abi.has_value() ||
+                    p_install->build_options.binary_caching != Build::BinaryCaching::YES ||
+                    !Util::Sets::contains(built_elsewhere, p_install->spec) ||
+                    prefetcher.is_predicted_hit(p_install->spec))
+                {
+                    continue;
+                }
+                m_awaited[index] = true;
+            }
+        }
+
+        bool is_awaited(size_t index) const { return m_awaited[index]; }
+
+        /// <summary>Whether `index` was awaited in vain, so that it is built here.</summary>
+        bool gave_up(size_t index) const { return m_gave_up[index]; }
+
+        std::vector<size_t> awaited() const
+        {
+            std::vector<size_t> indices;
+            for (size_t index = 0; index < m_awaited.size(); ++index)
+            {
+                if (m_awaited[index]) indices.push_back(index);
+            }
+            return indices;
+        }
+
+        /// <summary>Notes that `index` is ready but still awaited; its timeout starts the first time.</summary>
+        void defer(size_t index)
+        {
+            if (m_deferred[index].has_value()) return;
+            m_deferred[index] = Chrono::ElapsedTimer::create_started();
+            System::println("Waiting for %s to be built elsewhere...", m_action_plan[index].spec());
+        }
+
+        bool is_finished_remotely(size_t index) const
+        {
+            const auto& install_action = *m_action_plan[index].install_action.get();
+            const auto& tag = install_action.planned_abi.value_or_exit(VCPKG_LINE_INFO).tag;
+            const BinaryCache& binary_cache = m_paths.get_binary_cache();
+            return binary_cache.has_archive(tag) || binary_cache.find_tombstone(tag).has_value();
+        }
+
+        /// <summary>
+        /// Stops awaiting the packages in `finished_remotely` and those deferred for longer than REMOTE_BUILD_TIMEOUT;
+        /// returns whether any package was released.
+        /// </summary>
+        bool release(const std::vector<size_t>& finished_remotely)
+        {
+            bool released = false;
+            for (auto&& index : finished_remotely)
+            {
+                released = released || m_awaited[index];
+                m_awaited[index] = false;
+            }
+            for (size_t index = 0; index < m_awaited.size(); ++index)
+            {
+                const auto p_timer = m_deferred[index].get();
+                if (!m_awaited[index] || !p_timer ||
+                    p_timer->elapsed().as<std::chrono::seconds>() < REMOTE_BUILD_TIMEOUT)
+                {
+                    continue;
+                }
+                System::println(System::Color::warning,
+                                "Gave up waiting for %s to be built elsewhere; building it here",
+                                m_action_plan[index].spec());
+                m_awaited[index] = false;
+                m_gave_up[index] = true;
+                released = true;
+            }
+            return released;
+        }
+
+    private:
+        const VcpkgPaths& m_paths;
+        const std::vector<AnyAction>& m_action_plan;
+        std::vector<bool> m_awaited;
+        std::vector<bool> m_gave_up;
+        std::vector<Optional<Chrono::ElapsedTimer>> m_deferred;
+    };
+
+    /// <summary>The command in VCPKG_REMOTE_BUILD_COMMAND, which builds a package on another machine.</summary>
+    static Optional<std::string> get_remote_build_command()
+    {
+        auto maybe_command = System::get_environment_variable("VCPKG_REMOTE_BUILD_COMMAND");
+        if (auto command = maybe_command.get())
+        {
+            if (!command->empty()) return std::move(*command);
+        }
+        return nullopt;
+    }
+
+    /// <summary>Only a package with an ABI tag can be built elsewhere, since it comes back through the cache.</summary>
+    static bool can_build_remotely(const InstallPlanAction& action)
+    {
+        return action.plan_type == InstallPlanType::BUILD_AND_INSTALL && action.planned_abi.has_value() &&
+               action.build_options.binary_caching == Build::BinaryCaching::YES;
+    }
+
+    /// <summary>
+    /// Runs `command` with `{spec}` replaced by the package and its features and `{abi}` by its ABI tag. The command
+    /// builds the package on another machine, which stores the archive in a binary cache shared with this one, so
+    /// installing the package then restores it. Returns false if the command fails or stores no archive; the package
+    /// is then built here.
+    /// </summary>
+    static bool build_remotely(const VcpkgPaths& paths, const InstallPlanAction& action, const std::string& command)
+    {
+        std::vector<std::string> features;
+        for (auto&& feature : action.feature_list)
+        {
+            if (feature != "core") features.push_back(feature);
+        }
+        const std::string spec = features.empty() ? action.spec.to_string()
+                                                  : Strings::format("%s[%s]:%s",
+                                                                    action.spec.name(),
+                                                                    Strings::join(",", features),
+                                                                    action.spec.triplet().to_string());
+        const std::string& abi_tag = action.planned_abi.value_or_exit(VCPKG_LINE_INFO).tag;
+
+        System::println("Building package %s remotely...", spec);
+        const auto rc = System::cmd_execute_and_capture_output(
+            Strings::replace_all(Strings::replace_all(std::string(command), "{spec}", spec), "{abi}", abi_tag));
+        if (rc.exit_code == 0 && paths.get_binary_cache().has_archive(abi_tag)) return true;
+
+        System::println(System::Color::warning,
+                        "Remote build of %s failed with exit code %d; building it here:\n%s",
+                        spec,
+                        rc.exit_code,
+                        rc.output);
+        return false;
+    }
+
+    /// <summary>Waiting for a prefetched archive to be extracted counts as restoring it.</summary>
+    static Optional<std::string> take_prefetched(ArchivePrefetcher& prefetcher,
+                                                 const PackageSpec& spec,
+                                                 Build::PhaseTimings& waits)
+    {
+        const auto timer = Chrono::ElapsedTimer::create_started();
+        auto restored_abi_tag = prefetcher.take(spec);
+        waits.add(Build::BuildPhase::RESTORE, timer.elapsed());
+        return restored_abi_tag;
+    }
+
+    static void wait_for_distfiles(DistfilePrefetcher& prefetcher, const PackageSpec& spec, Build::PhaseTimings& waits)
+    {
+        const auto timer = Chrono::ElapsedTimer::create_started();
+        prefetcher.wait_for(spec);
+        waits.add(Build::BuildPhase::DOWNLOAD, timer.elapsed());
+    }
+
+    /// <summary>Executor threads that restore, install and remove, besides the `jobs` threads that build.</summary>
+    static constexpr size_t IO_LANE_THREADS = 2;
+
+    static void perform_parallel(std::vector<SpecSummary>& results,
+                                 Optional<ScheduleEstimate>& estimate,
+                                 const std::vector<AnyAction>& action_plan,
+                                 const KeepGoing keep_going,
+                                 const VcpkgPaths& paths,
+                                 StatusParagraphs& status_db,
+                                 const size_t jobs,
+                                 const std::unordered_set<PackageSpec>& built_elsewhere,
+                                 InstallCheckpoint& checkpoint,
+                                 const std::function<void(const SpecSummary&)>& on_installed)
+    {
+        const size_t package_count = action_plan.size();
+
+        // Remove actions precede the install actions in a serialized plan; the scheduler defers each until needed
+        const size_t first_install = count_leading_removes(action_plan);
+        purge_removed_package_dirs(paths, action_plan, first_install);
 
-            StatusParagraph& feature_paragraph = features_spghs.back();
-            feature_paragraph.package = feature;
-            feature_paragraph.want = Want::INSTALL;
-            feature_paragraph.state = InstallState::HALF_INSTALLED;
+        resolve_shared_build_state(paths, action_plan, checkpoint);
 
-            write_update(paths, feature_paragraph);
-            status_db->insert(std::make_unique<StatusParagraph>(feature_paragraph));
-        }
+        const auto remote_build_command = get_remote_build_command();
 
-        const InstallDir install_dir = InstallDir::from_destination_root(
-            paths.installed, triplet.to_string(), paths.listfile_path(bcf.core_paragraph));
+        const PlanGraph graph = make_plan_graph(action_plan, first_install);
+        const auto& dependents = graph.dependents;
+        const auto& remaining_dependencies = graph.remaining_dependencies;
 
-        install_files_and_write_listfile(paths.get_filesystem(), package_dir, install_dir);
+        // Critical path first: each action is weighted by its last recorded build time, and the ready action with the
+        // longest remaining chain of work below it is started first.
+        const auto weights = estimate_durations(paths, action_plan);
+        const auto priorities = critical_path_priorities(weights, dependents, first_install);
 
-        source_paragraph.state = InstallState::INSTALLED;
-        write_update(paths, source_paragraph);
-        status_db->insert(std::make_unique<StatusParagraph>(source_paragraph));
+        // Removes come first among the ready actions: they are quick, and each one unblocks an install
+        auto critical_path_first = [&](size_t lhs, size_t rhs) {
+            if ((lhs < first_install) != (rhs < first_install)) return lhs < first_install;
+            if (priorities[lhs] != priorities[rhs]) return priorities[lhs] > priorities[rhs];
+            return lhs < rhs;
+        };
 
-        for (auto&& feature_paragraph : features_spghs)
+        // Transfers for the actions on the critical path go first as well
+        TransferPriorities transfer_priorities;
+        for (size_t index = first_install; index < package_count; ++index)
         {
-            feature_paragraph.state = InstallState::INSTALLED;
-            write_update(paths, feature_paragraph);
-            status_db->insert(std::make_unique<StatusParagraph>(feature_paragraph));
+            transfer_priorities.emplace(action_plan[index].spec(), priorities[index].count());
         }
 
-        return InstallResult::SUCCESS;
-    }
-
-    using Build::BuildResult;
-    using Build::ExtendedBuildResult;
-
-    ExtendedBuildResult perform_install_plan_action(const VcpkgPaths& paths,
-                                                    const InstallPlanAction& action,
-                                                    StatusParagraphs& status_db)
-    {
-        const InstallPlanType& plan_type = action.plan_type;
-        const std::string display_name = action.spec.to_string();
-        const std::string display_name_with_features =
-            GlobalState::feature_packages ? action.displayname() : display_name;
+        // Every ABI tag is already known, so cache hits are restored without waiting for their dependencies
+        auto prefetcher = make_archive_prefetcher(paths, action_plan, jobs, transfer_priorities, checkpoint);
+        auto distfile_prefetcher =
+            make_distfile_prefetcher(paths, action_plan, *prefetcher, transfer_priorities, checkpoint);
 
-        const bool is_user_requested = action.request_type == RequestType::USER_REQUESTED;
-        const bool use_head_version = Util::Enum::to_bool(action.build_options.use_head_version);
+        const ScheduleEstimate schedule_estimate{
+            jobs,
+            simulate_makespan(weights, dependents, remaining_dependencies, first_install, jobs, std::less<size_t>()),
+            simulate_makespan(weights, dependents, remaining_dependencies, first_install, jobs, critical_path_first),
+        };
+        schedule_estimate.print();
+        estimate = schedule_estimate;
+
+        std::mutex mutex;
+        std::mutex status_db_mutex;
+        std::condition_variable cv;
+        std::set<size_t, decltype(critical_path_first)> ready(critical_path_first);
+        size_t building = 0;
+        size_t started = 0;
+        size_t finished = 0;
+        Optional<PackageSpec> first_failure;
+
+        ActionScheduler scheduler(action_plan, first_install, graph, status_db);
+        std::vector<Chrono::ElapsedTimer> ready_timers(package_count);
+        auto update_ready = [&]() {
+            for (auto&& index : scheduler.take_ready())
+            {
+                ready.insert(index);
+                ready_timers[index] = Chrono::ElapsedTimer::create_started();
+            }
+        };
+        update_ready();
+
+        // Like a make jobserver, the executor owns every processor of the machine and lends a share to each port build
+        // for its duration, so concurrent builds split the cores instead of each one running a full -j.
+        // Every build is granted at least one processor; only the part that was actually free is returned afterwards.
+        unsigned int free_processors = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<unsigned int> borrowed_processors(package_count, 0);
+        auto acquire_processors = [&](size_t index) -> unsigned int {
+            // Workers that will pick up a ready action soon should get a share as well
+            const size_t claimants = std::max<size_t>(1, std::min(jobs - building, ready.size() + 1));
+            const unsigned int share = std::max(1u, static_cast<unsigned int>(free_processors / claimants));
+            borrowed_processors[index] = std::min(free_processors, share);
+            free_processors -= borrowed_processors[index];
+            return share;
+        };
 
-        if (plan_type == InstallPlanType::ALREADY_INSTALLED)
+        // A build starts only while the peak memory its last build recorded fits in what the running builds leave of
+        // the machine, so that big links do not run out of memory next to each other. One build always runs, whatever
+        // it needs, and builds never measured are assumed to need nothing.
+        const uint64_t physical_memory = System::get_physical_memory_kib();
+        const auto peak_memory = BuildHistory::load_peak_memory(paths);
+        std::vector<uint64_t> predicted_memory(package_count, 0);
+        for (size_t index = first_install; index < package_count; ++index)
         {
-            if (use_head_version && is_user_requested)
-                System::println(
-                    System::Color::warning, "Package %s is already installed -- not building from HEAD", display_name);
-            else
-                System::println(System::Color::success, "Package %s is already installed", display_name);
-            return BuildResult::SUCCEEDED;
+            const auto p_install = action_plan[index].install_action.get();
+            if (!p_install || p_install->plan_type != InstallPlanType::BUILD_AND_INSTALL ||
+                Util::Sets::contains(built_elsewhere, p_install->spec) ||
+                (remote_build_command.has_value() && can_build_remotely(*p_install)))
+            {
+                continue;
+            }
+            const auto it = peak_memory.find(p_install->spec);
+            if (it != peak_memory.end()) predicted_memory[index] = it->second;
         }
-
-        auto aux_install = [&](const std::string& name, const BinaryControlFile& bcf) -> BuildResult {
-            System::println("Installing package %s... ", name);
-            const auto install_result = install_package(paths, bcf, &status_db);
-            switch (install_result)
+        uint64_t reserved_memory = 0;
+        std::vector<bool> announced_memory_wait(package_count, false);
+        auto fits_in_memory = [&](size_t index) {
+            if (building == 0 || physical_memory == 0 || reserved_memory + predicted_memory[index] <= physical_memory)
+                return true;
+            if (!announced_memory_wait[index])
             {
-                case InstallResult::SUCCESS:
-                    System::println(System::Color::success, "Installing package %s... done", name);
-                    return BuildResult::SUCCEEDED;
-                case InstallResult::FILE_CONFLICTS: return BuildResult::FILE_CONFLICTS;
-                default: Checks::unreachable(VCPKG_LINE_INFO);
+                announced_memory_wait[index] = true;
+                System::println("Waiting for memory to build %s, which needed %s MiB last time",
+                                action_plan[index].spec(),
+                                std::to_string(predicted_memory[index] >> 10));
             }
+            return false;
         };
 
-        if (plan_type == InstallPlanType::BUILD_AND_INSTALL)
+        // Removes, cache hits and packages that need no build only move files, so they have threads of their own
+        // instead of holding back a build, and the next restore overlaps the current build. A predicted hit that misses
+        // is built in that lane after all. Packages built elsewhere stay in the build lane, as they may be built here.
+        std::vector<bool> is_io_lane(package_count, true);
+        for (size_t index = first_install; index < package_count; ++index)
         {
-            if (use_head_version)
-                System::println("Building package %s from HEAD... ", display_name_with_features);
-            else
-                System::println("Building package %s... ", display_name_with_features);
+            const auto p_install = action_plan[index].install_action.get();
+            if (p_install && p_install->plan_type == InstallPlanType::BUILD_AND_INSTALL &&
+                !prefetcher->is_predicted_hit(p_install->spec))
+            {
+                is_io_lane[index] = false;
+            }
+        }
 
-            auto result = [&]() -> Build::ExtendedBuildResult {
-                const Build::BuildPackageConfig build_config{action.source_control_file.value_or_exit(VCPKG_LINE_INFO),
-                                                             action.spec.triplet(),
-                                                             paths.port_dir(action.spec),
-                                                             action.build_options,
-                                                             action.feature_list};
-                return Build::build_package(paths, build_config, status_db);
-            }();
+        RemoteBuilds remote_builds(paths, action_plan, built_elsewhere, *prefetcher);
 
-            if (result.code != Build::BuildResult::SUCCEEDED)
+        // Builds of one port for several triplets may overlap; the later ones get buildtrees of their own
+        auto pop_ready = [&](const bool io_lane) -> Optional<size_t> {
+            for (auto it = ready.begin(); it != ready.end();)
             {
-                System::println(System::Color::error, Build::create_error_message(result.code, action.spec));
-                return result;
+                const size_t index = *it;
+                if (is_io_lane[index] != io_lane || !fits_in_memory(index))
+                {
+                    ++it;
+                    continue;
+                }
+                if (remote_builds.is_awaited(index))
+                {
+                    remote_builds.defer(index);
+                    ++it;
+                    continue;
+                }
+                ready.erase(it);
+                if (!scheduler.needs_remove(index)) return index;
+                scheduler.demand_remove_for(index);
+                update_ready();
+                it = ready.begin();
             }
+            return nullopt;
+        };
 
-            System::println("Building package %s... done", display_name_with_features);
+        auto worker = [&](const bool io_lane) {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true)
+            {
+                Optional<size_t> maybe_index;
+                cv.wait(lock, [&]() {
+                    if (finished == package_count || first_failure.has_value()) return true;
+                    maybe_index = pop_ready(io_lane);
+                    return maybe_index.has_value();
+                });
+                const auto p_index = maybe_index.get();
+                if (!p_index) return;
+
+                const size_t index = *p_index;
+                results[index].queue_wait = ready_timers[index].elapsed();
+                if (scheduler.is_remove(index))
+                {
+                    const auto& remove_action = *action_plan[index].remove_action.get();
+                    System::println("Starting package %zd/%zd: %s", ++started, package_count, remove_action.spec);
+                    lock.unlock();
 
-            auto bcf = std::make_unique<BinaryControlFile>(
-                Paragraphs::try_load_cached_package(paths, action.spec).value_or_exit(VCPKG_LINE_INFO));
-            auto code = aux_install(display_name_with_features, *bcf);
+                    const auto remove_timer = Chrono::ElapsedTimer::create_started();
+                    {
+                        std::lock_guard<std::mutex> status_db_lock(status_db_mutex);
+                        Remove::perform_remove_plan_action(paths,
+                                                           remove_action,
+                                                           Remove::Purge::NO,
+                                                           &status_db,
+                                                           keep_files_for(action_plan, remove_action.spec));
+                    }
+                    const auto timing = remove_timer.elapsed();
+
+                    lock.lock();
+                    results[index].timing = timing;
+                    ++finished;
+                    scheduler.finish(index);
+                    update_ready();
+                    cv.notify_all();
+                    continue;
+                }
+
+                const auto& install_action = *action_plan[index].install_action.get();
+                const bool is_built_elsewhere = Util::Sets::contains(built_elsewhere, install_action.spec);
+                // A remote build needs no processors here
+                const bool is_dispatched =
+                    remote_build_command.has_value() && !is_built_elsewhere && can_build_remotely(install_action);
+                Optional<unsigned int> concurrency;
+                if (install_action.plan_type == InstallPlanType::BUILD_AND_INSTALL &&
+                    (!is_built_elsewhere || remote_builds.gave_up(index)) && !is_dispatched && !is_io_lane[index])
+                {
+                    concurrency = acquire_processors(index);
+                    reserved_memory += predicted_memory[index];
+                    ++building;
+                }
+                System::println("Starting package %zd/%zd: %s", ++started, package_count, install_action.spec);
+                lock.unlock();
+
+                Transfers::PriorityScope transfer_priority(priorities[index].count());
+                const auto build_timer = Chrono::ElapsedTimer::create_started();
+                Build::PhaseTimings waits;
+                const auto restored_abi_tag = take_prefetched(*prefetcher, install_action.spec, waits);
+                const bool is_missed_hit = is_io_lane[index] && !restored_abi_tag.has_value() &&
+                                           install_action.plan_type == InstallPlanType::BUILD_AND_INSTALL;
+                if (is_missed_hit || (!restored_abi_tag.has_value() && is_dispatched &&
+                                      !build_remotely(paths, install_action, *remote_build_command.get())))
+                {
+                    lock.lock();
+                    concurrency = acquire_processors(index);
+                    ++building;
+                    lock.unlock();
+                }
+                if (!restored_abi_tag.has_value()) wait_for_distfiles(*distfile_prefetcher, install_action.spec, waits);
+                auto result = perform_install_plan_action(
+                    paths, install_action, status_db, &status_db_mutex, concurrency, restored_abi_tag, &checkpoint);
+                result.timings.add(waits);
+                const auto timing = build_timer.elapsed();
+                System::println("Elapsed time for package %s: %s", install_action.spec, timing.to_string());
+
+                lock.lock();
+                if (concurrency.has_value())
+                {
+                    free_processors += borrowed_processors[index];
+                    reserved_memory -= predicted_memory[index];
+                    --building;
+                }
+                if (result.code != BuildResult::SUCCEEDED && keep_going == KeepGoing::NO && !first_failure)
+                {
+                    first_failure = install_action.spec;
+                }
+                results[index].build_result = std::move(result);
+                results[index].timing = timing;
+                if (on_installed) on_installed(results[index]);
+                ++finished;
+                scheduler.finish(index);
+                update_ready();
+                cv.notify_all();
+            }
+        };
 
-            if (action.build_options.clean_packages == Build::CleanPackages::YES)
+        // Polls the binary cache for the packages built elsewhere and releases each one to the workers once its result
+        // is there or its wait timed out; the workers build other packages meanwhile
+        auto remote_build_watcher = [&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (finished != package_count && !first_failure.has_value())
             {
-                auto& fs = paths.get_filesystem();
-                const fs::path package_dir = paths.package_dir(action.spec);
-                std::error_code ec;
-                fs.remove_all(package_dir, ec);
+                const auto awaited = remote_builds.awaited();
+                if (awaited.empty()) return;
+                lock.unlock();
+                std::vector<size_t> finished_remotely;
+                for (auto&& index : awaited)
+                {
+                    if (remote_builds.is_finished_remotely(index)) finished_remotely.push_back(index);
+                }
+                lock.lock();
+                if (remote_builds.release(finished_remotely)) cv.notify_all();
+                cv.wait_for(lock, REMOTE_BUILD_POLL_INTERVAL, [&]() {
+                    return finished == package_count || first_failure.has_value();
+                });
             }
+        };
 
-            return {code, std::move(bcf)};
+        std::vector<std::thread> threads;
+        threads.emplace_back(remote_build_watcher);
+        for (size_t i = 0; i < jobs; ++i)
+        {
+            threads.emplace_back(worker, false);
         }
-
-        if (plan_type == InstallPlanType::EXCLUDED)
+        for (size_t i = 0; i < IO_LANE_THREADS; ++i)
         {
-            System::println(System::Color::warning, "Package %s is excluded", display_name);
-            return BuildResult::EXCLUDED;
+            threads.emplace_back(worker, true);
         }
-
-        Checks::unreachable(VCPKG_LINE_INFO);
-    }
-
-    void InstallSummary::print() const
-    {
-        System::println("RESULTS");
-
-        for (const SpecSummary& result : this->results)
+        for (auto&& thread : threads)
         {
-            System::println("    %s: %s: %s", result.spec, Build::to_string(result.build_result.code), result.timing);
+            thread.join();
         }
 
-        std::map<BuildResult, int> summary;
-        for (const BuildResult& v : Build::BUILD_RESULT_VALUES)
+        distfile_prefetcher.reset();
+        prefetcher.reset();
+
+        if (auto p_failure = first_failure.get())
         {
-            summary[v] = 0;
+            // The packages built before the failure keep their archives
+            Build::wait_for_archives();
+            System::println(Build::create_user_troubleshooting_message(*p_failure));
+            Checks::exit_fail(VCPKG_LINE_INFO);
         }
+    }
 
-        for (const SpecSummary& r : this->results)
+    static void record_build_history(const VcpkgPaths& paths, const std::vector<SpecSummary>& results)
+    {
+        std::vector<BuildHistory::Record> records;
+        for (auto&& result : results)
         {
-            summary[r.build_result.code]++;
+            if (result.build_result.code != BuildResult::SUCCEEDED || !result.action) continue;
+            const auto p_install = result.action->install_action.get();
+            if (!p_install || p_install->plan_type != InstallPlanType::BUILD_AND_INSTALL) continue;
+
+            const auto& phases = result.build_result.timings;
+            const auto p_bpgh = result.get_binary_paragraph();
+            records.push_back({result.spec,
+                               p_bpgh ? p_bpgh->abi : std::string(),
+                               phases.get(Build::BuildPhase::BUILD).count() == 0,
+                               result.timing.as<std::chrono::microseconds>(),
+                               phases,
+                               result.build_result.peak_memory_kib});
         }
+        BuildHistory::store_records(paths, records);
+    }
 
-        System::println("\nSUMMARY");
-        for (const std::pair<const BuildResult, int>& entry : summary)
+    static void record_metrics(const std::vector<SpecSummary>& results)
+    {
+        for (auto&& result : results)
         {
-            System::println("    %s: %d", Build::to_string(entry.first), entry.second);
+            if (!result.action || !result.action->install_action) continue;
+
+            OpenMetrics::Labels labels = {{"port", result.spec.name()}, {"triplet", result.spec.triplet().to_string()}};
+            OpenMetrics::observe_seconds("vcpkg_queue_wait_seconds",
+                                         "Time a package waited to start after its dependencies were installed.",
+                                         labels,
+                                         result.queue_wait.as<std::chrono::microseconds>());
+
+            const auto& phases = result.build_result.timings;
+            const auto build_time = phases.get(Build::BuildPhase::BUILD);
+            if (build_time.count() == 0) continue;
+            OpenMetrics::observe_seconds(
+                "vcpkg_build_duration_seconds", "Time spent building a port from source.", labels, build_time);
+            OpenMetrics::observe_seconds("vcpkg_lint_duration_seconds",
+                                         "Time spent checking a built package.",
+                                         std::move(labels),
+                                         phases.get(Build::BuildPhase::POST_BUILD_CHECKS));
         }
     }
 
+    static void apply_binary_cache_size_policy(const VcpkgPaths& paths, const std::vector<AnyAction>& action_plan)
+    {
+        const bool uses_binary_caching = std::any_of(action_plan.begin(), action_plan.end(), [](const AnyAction& action) {
+            auto p_install = action.install_action.get();
+            return p_install && p_install->build_options.binary_caching == Build::BinaryCaching::YES;
+        });
+        if (uses_binary_caching) paths.get_binary_cache().collect_garbage_from_environment();
+    }
+
     InstallSummary perform(const std::vector<AnyAction>& action_plan,
                            const KeepGoing keep_going,
                            const VcpkgPaths& paths,
-                           StatusParagraphs& status_db)
+                           StatusParagraphs& status_db,
+                           const size_t jobs,
+                           const std::unordered_set<PackageSpec>& built_elsewhere,
+                           const Resume resume,
+                           const std::function<void(const SpecSummary&)>& on_installed)
     {
         std::vector<SpecSummary> results;
 
         const auto timer = Chrono::ElapsedTimer::create_started();
+
+        InstallCheckpoint checkpoint(paths, action_plan, resume);
+        if (resume == Resume::YES)
+        {
+            System::println("Resuming: %zd of the packages to build were built by the interrupted run",
+                            checkpoint.resumed_count());
+        }
+
+        // Whatever failed stays in the checkpoint for the next --x-resume
+        auto clear_checkpoint_if_succeeded = [&]() {
+            const bool succeeded = std::all_of(results.begin(), results.end(), [](const SpecSummary& result) {
+                return result.build_result.code == BuildResult::SUCCEEDED ||
+                       result.build_result.code == BuildResult::NULLVALUE;
+            });
+            if (succeeded) checkpoint.clear();
+        };
+
+        // A port built for several triplets extracts and patches its sources once for all of them
+        std::map<std::string, std::set<Triplet>> triplets_of_port;
+        for (auto&& action : action_plan)
+        {
+            const auto p_install = action.install_action.get();
+            if (p_install && p_install->plan_type == InstallPlanType::BUILD_AND_INSTALL)
+                triplets_of_port[p_install->spec.name()].insert(p_install->spec.triplet());
+        }
+        std::set<std::string> multi_triplet_ports;
+        for (auto&& entry : triplets_of_port)
+        {
+            if (entry.second.size() > 1) multi_triplet_ports.insert(entry.first);
+        }
+        const Build::SharedSources shared_sources(paths, std::move(multi_triplet_ports));
+
+        if (jobs > 1)
+        {
+            for (const auto& action : action_plan)
+            {
+                results.emplace_back(action.spec(), &action);
+            }
+            Optional<ScheduleEstimate> estimate;
+            perform_parallel(results,
+                             estimate,
+                             action_plan,
+                             keep_going,
+                             paths,
+                             status_db,
+                             jobs,
+                             built_elsewhere,
+                             checkpoint,
+                             on_installed);
+            clear_checkpoint_if_succeeded();
+            discard_replaced_files(paths, action_plan);
+            Build::wait_for_archives();
+            record_build_history(paths, results);
+            record_metrics(results);
+            apply_binary_cache_size_policy(paths, action_plan);
+            return InstallSummary{std::move(results), timer.to_string(), std::move(estimate)};
+        }
+
+        for (const auto& action : action_plan)
+        {
+            results.emplace_back(action.spec(), &action);
+        }
+
         size_t counter = 0;
         const size_t package_count = action_plan.size();
+        const size_t first_install = count_leading_removes(action_plan);
+        purge_removed_package_dirs(paths, action_plan, first_install);
+
+        auto prefetcher = make_archive_prefetcher(paths, action_plan, 1, {}, checkpoint);
+        auto distfile_prefetcher = make_distfile_prefetcher(paths, action_plan, *prefetcher, {}, checkpoint);
+        const auto remote_build_command = get_remote_build_command();
+        RemoteBuilds remote_builds(paths, action_plan, built_elsewhere, *prefetcher);
+
+        // One action at a time: the removes an install needs right before it, the installs in the order of the plan
+        // The scheduler keeps a reference to the graph
+        const PlanGraph graph = make_plan_graph(action_plan, first_install);
+        ActionScheduler scheduler(action_plan, first_install, graph, status_db);
+        std::set<size_t, std::function<bool(size_t, size_t)>> ready([&](size_t lhs, size_t rhs) {
+            if (scheduler.is_remove(lhs) != scheduler.is_remove(rhs)) return scheduler.is_remove(lhs);
+            return lhs < rhs;
+        });
 
-        for (const auto& action : action_plan)
+        std::vector<Chrono::ElapsedTimer> ready_timers(package_count);
+        while (true)
         {
+            for (auto&& index : scheduler.take_ready())
+            {
+                ready.insert(index);
+                ready_timers[index] = Chrono::ElapsedTimer::create_started();
+            }
+            if (ready.empty()) break;
+
+            // Packages other machines are building go last; once nothing else is ready, poll the binary cache for them
+            const auto it_next = std::find_if(
+                ready.begin(), ready.end(), [&](size_t index) { return !remote_builds.is_awaited(index); });
+            if (it_next == ready.end())
+            {
+                std::vector<size_t> finished_remotely;
+                for (auto&& index : ready)
+                {
+                    remote_builds.defer(index);
+                    if (remote_builds.is_finished_remotely(index)) finished_remotely.push_back(index);
+                }
+                if (!remote_builds.release(finished_remotely)) std::this_thread::sleep_for(REMOTE_BUILD_POLL_INTERVAL);
+                continue;
+            }
+
+            const size_t index = *it_next;
+            ready.erase(it_next);
+            if (scheduler.needs_remove(index))
+            {
+                scheduler.demand_remove_for(index);
+                continue;
+            }
+            const AnyAction& action = action_plan[index];
+            results[index].queue_wait = ready_timers[index].elapsed();
+
             const auto build_timer = Chrono::ElapsedTimer::create_started();
             counter++;
 
@@ -393,34 +2577,59 @@ namespace vcpkg::Install
             const std::string display_name = spec.to_string();
             System::println("Starting package %zd/%zd: %s", counter, package_count, display_name);
 
-            results.emplace_back(spec, &action);
-
             if (const auto install_action = action.install_action.get())
             {
-                auto result = perform_install_plan_action(paths, *install_action, status_db);
+                Build::PhaseTimings waits;
+                const auto restored_abi_tag = take_prefetched(*prefetcher, install_action->spec, waits);
+                if (!restored_abi_tag.has_value() && !Util::Sets::contains(built_elsewhere, install_action->spec) &&
+                    remote_build_command && can_build_remotely(*install_action))
+                    build_remotely(paths, *install_action, *remote_build_command.get());
+                if (!restored_abi_tag.has_value())
+                    wait_for_distfiles(*distfile_prefetcher, install_action->spec, waits);
+                auto result = perform_install_plan_action(
+                    paths, *install_action, status_db, nullptr, nullopt, restored_abi_tag, &checkpoint);
+                result.timings.add(waits);
 
                 if (result.code != BuildResult::SUCCEEDED && keep_going == KeepGoing::NO)
                 {
+                    distfile_prefetcher.reset();
+                    prefetcher.reset();
+                    Build::wait_for_archives();
                     System::println(Build::create_user_troubleshooting_message(install_action->spec));
                     Checks::exit_fail(VCPKG_LINE_INFO);
                 }
 
-                results.back().build_result = std::move(result);
+                results[index].build_result = std::move(result);
             }
             else if (const auto remove_action = action.remove_action.get())
             {
-                Remove::perform_remove_plan_action(paths, *remove_action, Remove::Purge::YES, &status_db);
+                Remove::perform_remove_plan_action(paths,
+                                                   *remove_action,
+                                                   Remove::Purge::NO,
+                                                   &status_db,
+                                                   keep_files_for(action_plan, remove_action->spec));
             }
             else
             {
                 Checks::unreachable(VCPKG_LINE_INFO);
             }
 
-            results.back().timing = build_timer.elapsed();
-            System::println("Elapsed time for package %s: %s", display_name, results.back().timing.to_string());
+            scheduler.finish(index);
+            results[index].timing = build_timer.elapsed();
+            System::println("Elapsed time for package %s: %s", display_name, results[index].timing.to_string());
+            if (on_installed && action.install_action.has_value()) on_installed(results[index]);
         }
 
-        return InstallSummary{std::move(results), timer.to_string()};
+        distfile_prefetcher.reset();
+        prefetcher.reset();
+
+        clear_checkpoint_if_succeeded();
+        discard_replaced_files(paths, action_plan);
+        Build::wait_for_archives();
+        record_build_history(paths, results);
+        record_metrics(results);
+        apply_binary_cache_size_policy(paths, action_plan);
+        return InstallSummary{std::move(results), timer.to_string(), nullopt};
     }
 
     static constexpr StringLiteral OPTION_DRY_RUN = "--dry-run";
@@ -430,30 +2639,58 @@ namespace vcpkg::Install
     static constexpr StringLiteral OPTION_KEEP_GOING = "--keep-going";
     static constexpr StringLiteral OPTION_XUNIT = "--x-xunit";
     static constexpr StringLiteral OPTION_USE_ARIA2 = "--x-use-aria2";
-
-    static constexpr std::array<CommandSwitch, 6> INSTALL_SWITCHES = {{
+    static constexpr StringLiteral OPTION_JOBS = "--x-jobs";
+    static constexpr StringLiteral OPTION_RESUME = "--x-resume";
+    static constexpr StringLiteral OPTION_JSON = "--x-json";
+    static constexpr StringLiteral OPTION_WRITE_PLAN = "--x-write-plan";
+    static constexpr StringLiteral OPTION_FROM_PLAN = "--x-from-plan";
+    static constexpr StringLiteral OPTION_INCREMENTAL = "--x-incremental";
+
+    static constexpr std::array<CommandSwitch, 9> INSTALL_SWITCHES = {{
         {OPTION_DRY_RUN, "Do not actually build or install"},
         {OPTION_USE_HEAD_VERSION, "Install the libraries on the command line using the latest upstream sources"},
         {OPTION_NO_DOWNLOADS, "Do not download new sources"},
         {OPTION_RECURSE, "Allow removal of packages as part of installation"},
         {OPTION_KEEP_GOING, "Continue installing packages on failure"},
         {OPTION_USE_ARIA2, "Use aria2 to perform download tasks"},
+        {OPTION_RESUME, "Install the packages an interrupted run built without building them again (experimental)"},
+        {OPTION_JSON, "With --dry-run, print the plan as JSON, with ABI tags and expected costs (experimental)"},
+        {OPTION_INCREMENTAL,
+         "Keep the CMake build directories of the previous build while sources, patches and options are unchanged "
+         "(experimental)"},
     }};
-    static constexpr std::array<CommandSetting, 1> INSTALL_SETTINGS = {{
+    static constexpr std::array<CommandSetting, 4> INSTALL_SETTINGS = {{
         {OPTION_XUNIT, "File to output results in XUnit format (Internal use)"},
+        {OPTION_JOBS, "Number of packages to build concurrently, 0 for one per processor (experimental)"},
+        {OPTION_WRITE_PLAN, "Write the plan with its ABI tags to this file instead of installing (experimental)"},
+        {OPTION_FROM_PLAN, "Install the plan in this file instead of the packages given (experimental)"},
     }};
 
-    std::vector<std::string> get_all_port_names(const VcpkgPaths& paths)
+    size_t get_job_count(const ParsedArguments& options, const std::string& option_name)
     {
-        auto sources_and_errors = Paragraphs::try_load_all_ports(paths.get_filesystem(), paths.ports);
+        const auto it = options.settings.find(option_name);
+        if (it == options.settings.end()) return 1;
+
+        const std::string& value = it->second;
+        char* end = nullptr;
+        const unsigned long jobs = std::strtoul(value.c_str(), &end, 10);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           !value.empty() && *end == '\0' && value[0] != '-',
+                           "Invalid value for %s: %s. Expected a non-negative integer.",
+                           option_name,
+                           value);
+        if (jobs == 0) return std::max(1u, std::thread::hardware_concurrency());
+        return jobs;
+    }
 
-        return Util::fmap(sources_and_errors.paragraphs,
-                          [](auto&& pgh) -> std::string { return pgh->core_paragraph->name; });
+    std::vector<std::string> get_all_port_names(const VcpkgPaths& paths)
+    {
+        return Paragraphs::get_all_port_names(paths.get_filesystem(), paths.ports);
     }
 
     const CommandStructure COMMAND_STRUCTURE = {
         Help::create_example_string("install zlib zlib:x64-windows curl boost"),
-        1,
+        0,
         SIZE_MAX,
         {INSTALL_SWITCHES, INSTALL_SETTINGS},
         &get_all_port_names,
@@ -461,8 +2698,6 @@ namespace vcpkg::Install
 
     static void print_cmake_information(const BinaryParagraph& bpgh, const VcpkgPaths& paths)
     {
-        static const std::regex cmake_library_regex(R"(\badd_library\(([^\s\)]+)\s)", std::regex_constants::ECMAScript);
-
         auto& fs = paths.get_filesystem();
 
         auto usage_file = paths.installed / bpgh.spec.triplet().canonical_name() / "share" / bpgh.spec.name() / "usage";
@@ -476,48 +2711,34 @@ namespace vcpkg::Install
             return;
         }
 
-        auto files = fs.read_lines(paths.listfile_path(bpgh));
-        if (auto p_lines = files.get())
+        // The index written at install has what the package's .cmake files say; packages installed before it existed
+        // are read again
+        auto maybe_packages = CMakeIndex::load(paths, bpgh.spec);
+        if (!maybe_packages.has_value())
         {
-            std::map<std::string, std::string> config_files;
-            std::map<std::string, std::vector<std::string>> library_targets;
-
-            for (auto&& suffix : *p_lines)
+            const std::string triplet_prefix = bpgh.spec.triplet().canonical_name() + "/";
+            auto files = fs.read_lines(paths.listfile_path(bpgh));
+            if (auto p_lines = files.get())
             {
-                if (Strings::case_insensitive_ascii_contains(suffix, "/share/") && Strings::ends_with(suffix, ".cmake"))
+                std::vector<std::string> triplet_files;
+                for (auto&& line : *p_lines)
                 {
-                    // CMake file is inside the share folder
-                    auto path = paths.installed / suffix;
-                    auto maybe_contents = fs.read_contents(path);
-                    auto find_package_name = path.parent_path().filename().u8string();
-                    if (auto p_contents = maybe_contents.get())
-                    {
-                        std::sregex_iterator next(p_contents->begin(), p_contents->end(), cmake_library_regex);
-                        std::sregex_iterator last;
-
-                        while (next != last)
-                        {
-                            auto match = *next;
-                            library_targets[find_package_name].push_back(match[1]);
-                            ++next;
-                        }
-                    }
-
-                    auto filename = fs::u8path(suffix).filename().u8string();
-
-                    if (Strings::ends_with(filename, "Config.cmake"))
-                    {
-                        auto root = filename.substr(0, filename.size() - 12);
-                        if (Strings::case_insensitive_ascii_equals(root, find_package_name))
-                            config_files[find_package_name] = root;
-                    }
-                    else if (Strings::ends_with(filename, "-config.cmake"))
-                    {
-                        auto root = filename.substr(0, filename.size() - 13);
-                        if (Strings::case_insensitive_ascii_equals(root, find_package_name))
-                            config_files[find_package_name] = root;
-                    }
+                    if (line.compare(0, triplet_prefix.size(), triplet_prefix) == 0)
+                        triplet_files.push_back(line.substr(triplet_prefix.size()));
                 }
+                maybe_packages =
+                    CMakeIndex::scan(fs, paths.installed / bpgh.spec.triplet().canonical_name(), triplet_files);
+            }
+        }
+
+        if (auto p_packages = maybe_packages.get())
+        {
+            std::map<std::string, std::string> config_files;
+            std::map<std::string, std::vector<std::string>> library_targets;
+            for (auto&& package : *p_packages)
+            {
+                library_targets[package.name] = package.targets;
+                if (!package.config_file.empty()) config_files[package.name] = package.config_name();
             }
 
             if (library_targets.empty())
@@ -563,6 +2784,49 @@ namespace vcpkg::Install
         }
     }
 
+    /// <summary>
+    /// Whether every feature `specs` asks for is installed already and none of their CONTROL files changed since, in
+    /// which case planning could only report that there is nothing to do. Decides from the status database and file
+    /// times alone, without parsing a single CONTROL file. The default features come from the installed package; a
+    /// CONTROL file written after the package was installed may have changed them, so it sends install the slow way.
+    /// </summary>
+    static bool is_already_installed(const VcpkgPaths& paths,
+                                     const StatusParagraphs& status_db,
+                                     const std::vector<FullPackageSpec>& specs)
+    {
+        for (auto&& spec : specs)
+        {
+            const auto maybe_ipv = status_db.find_all_installed(spec.package_spec);
+            const auto p_ipv = maybe_ipv.get();
+            if (!p_ipv) return false;
+
+            const BinaryParagraph& core = p_ipv->core->package;
+            std::vector<std::string> features = spec.features;
+            if (Util::find(features, "core") == features.end())
+            {
+                features.insert(features.end(), core.default_features.begin(), core.default_features.end());
+            }
+
+            for (auto&& feature : features)
+            {
+                if (feature == "core") continue;
+                const bool installed =
+                    std::any_of(p_ipv->features.begin(), p_ipv->features.end(), [&](const StatusParagraph* p) {
+                        return p->package.feature == feature;
+                    });
+                if (!installed) return false;
+            }
+
+            std::error_code ec;
+            const auto control_time =
+                fs::stdfs::last_write_time(paths.port_dir(spec.package_spec) / "CONTROL", ec);
+            if (ec) return false;
+            const auto installed_time = fs::stdfs::last_write_time(paths.listfile_path(core), ec);
+            if (ec || control_time >= installed_time) return false;
+        }
+        return true;
+    }
+
     ///
     /// <summary>
     /// Run "install" command.
@@ -573,13 +2837,11 @@ namespace vcpkg::Install
         // input sanitization
         const ParsedArguments options = args.parse_arguments(COMMAND_STRUCTURE);
 
-        const std::vector<FullPackageSpec> specs = Util::fmap(args.command_arguments, [&](auto&& arg) {
-            return Input::check_and_get_full_package_spec(arg, default_triplet, COMMAND_STRUCTURE.example_text);
-        });
+        const std::vector<FullPackageSpec> specs = Input::check_and_get_full_package_specs(
+            args.command_arguments, default_triplet, COMMAND_STRUCTURE.example_text, paths);
 
         for (auto&& spec : specs)
         {
-            Input::check_triplet(spec.package_spec.triplet(), paths);
             if (!spec.features.empty() && !GlobalState::feature_packages)
             {
                 Checks::exit_with_message(
@@ -593,9 +2855,67 @@ namespace vcpkg::Install
         const bool is_recursive = Util::Sets::contains(options.switches, (OPTION_RECURSE));
         const bool use_aria2 = Util::Sets::contains(options.switches, (OPTION_USE_ARIA2));
         const KeepGoing keep_going = to_keep_going(Util::Sets::contains(options.switches, OPTION_KEEP_GOING));
+        const size_t jobs = get_job_count(options, OPTION_JOBS);
+        const Resume resume = to_resume(Util::Sets::contains(options.switches, OPTION_RESUME));
+        const bool json = Util::Sets::contains(options.switches, OPTION_JSON);
+        const bool incremental = Util::Sets::contains(options.switches, OPTION_INCREMENTAL);
+        Checks::check_exit(VCPKG_LINE_INFO, !json || dry_run, "Error: %s requires %s", OPTION_JSON, OPTION_DRY_RUN);
+
+        const auto it_write_plan = options.settings.find(OPTION_WRITE_PLAN);
+        const auto it_from_plan = options.settings.find(OPTION_FROM_PLAN);
+        const bool write_plan = it_write_plan != options.settings.end();
+        const bool from_plan = it_from_plan != options.settings.end();
+        Checks::check_exit(
+            VCPKG_LINE_INFO, !json || !write_plan, "Error: %s cannot be used with %s", OPTION_JSON, OPTION_WRITE_PLAN);
+        if (from_plan)
+        {
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               specs.empty() && !write_plan,
+                               "Error: %s takes neither packages nor %s",
+                               OPTION_FROM_PLAN,
+                               OPTION_WRITE_PLAN);
+        }
+        else
+        {
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               !specs.empty(),
+                               "Error: 'install' requires at least 1 argument, or a plan given with %s\n%s",
+                               OPTION_FROM_PLAN,
+                               COMMAND_STRUCTURE.example_text);
+        }
 
         // create the plan
-        StatusParagraphs status_db = database_load_check(paths);
+        StatusParagraphs status_db =
+            database_load_check(paths, dry_run ? InstalledBase::MERGE : InstalledBase::IMPORT);
+
+        const bool has_xunit = options.settings.find(OPTION_XUNIT) != options.settings.end();
+        if (!from_plan && !write_plan && !json && !has_xunit && is_already_installed(paths, status_db, specs))
+        {
+            System::println("The following packages are already installed:");
+            for (auto&& spec : specs)
+            {
+                const InstalledPackageView ipv = status_db.find_all_installed(spec.package_spec).value_or_exit(
+                    VCPKG_LINE_INFO);
+                std::vector<std::string> features{"core"};
+                for (auto&& p : ipv.features)
+                    features.push_back(p->package.feature);
+                System::println(Dependencies::to_output_string(
+                    RequestType::USER_REQUESTED,
+                    Strings::format(
+                        "%s[%s]:%s", spec.package_spec.name(), Strings::join(",", features), ipv.spec().triplet())));
+            }
+            if (dry_run) Checks::exit_success(VCPKG_LINE_INFO);
+
+            for (auto&& spec : specs)
+            {
+                const auto it = status_db.find_installed(spec.package_spec);
+                print_cmake_information((*it)->package, paths);
+            }
+            Checks::exit_success(VCPKG_LINE_INFO);
+        }
+
+        // The tools download while the plan is made
+        if (!dry_run && !write_plan) Build::prefetch_build_tools(paths);
 
         Build::DownloadTool download_tool = Build::DownloadTool::BUILT_IN;
         if (use_aria2) download_tool = Build::DownloadTool::ARIA2;
@@ -608,17 +2928,22 @@ namespace vcpkg::Install
             download_tool,
             GlobalState::g_binary_caching ? Build::BinaryCaching::YES : Build::BinaryCaching::NO,
             Build::FailOnTombstone::NO,
+            Util::Enum::to_enum<Build::Incremental>(incremental),
         };
 
-        auto all_ports = Paragraphs::load_all_ports(paths.get_filesystem(), paths.ports);
-        std::unordered_map<std::string, SourceControlFile> scf_map;
-        for (auto&& port : all_ports)
-            scf_map[port->core_paragraph->name] = std::move(*port);
-        MapPortFileProvider provider(scf_map);
-
-        // Note: action_plan will hold raw pointers to SourceControlFiles from this map
-        std::vector<AnyAction> action_plan =
-            create_feature_install_plan(provider, FullPackageSpec::to_feature_specs(specs), status_db);
+        // Note: action_plan will hold raw pointers to SourceControlFiles from this provider. Ports are loaded as the
+        // planner reaches them, so only the requested specs and their dependencies are parsed; a plan file names the
+        // ports it builds, so only those are loaded.
+        PathsPortFileProvider provider(paths);
+        std::vector<AnyAction> action_plan;
+        if (from_plan)
+        {
+            action_plan = PlanFile::read(paths, status_db, provider, fs::u8path(it_from_plan->second));
+        }
+        else
+        {
+            action_plan = create_feature_install_plan(provider, FullPackageSpec::to_feature_specs(specs), status_db);
+        }
 
         if (!GlobalState::feature_packages)
         {
@@ -658,31 +2983,53 @@ namespace vcpkg::Install
 
         Metrics::g_metrics.lock()->track_property("installplan", specs_string);
 
+        if (json)
+        {
+            if (!from_plan && GlobalState::g_binary_caching) plan_abi_tags(paths, action_plan);
+            print_plan_json(paths, action_plan, jobs);
+            Checks::exit_success(VCPKG_LINE_INFO);
+        }
+
         Dependencies::print_plan(action_plan, is_recursive);
 
-        if (dry_run)
+        // The tags of a plan read from a file came with it
+        if (!from_plan && (GlobalState::g_binary_caching || !dry_run || write_plan)) plan_abi_tags(paths, action_plan);
+
+        if (write_plan)
         {
+            PlanFile::write(paths, status_db, action_plan, fs::u8path(it_write_plan->second));
+            System::println("Wrote the plan to %s", it_write_plan->second);
             Checks::exit_success(VCPKG_LINE_INFO);
         }
 
-        const InstallSummary summary = perform(action_plan, keep_going, paths, status_db);
-
-        System::println("\nTotal elapsed time: %s\n", summary.total_elapsed_time);
+        if (GlobalState::g_binary_caching)
+        {
+            print_binary_cache_forecast(paths, action_plan, jobs);
+        }
 
-        if (keep_going == KeepGoing::YES)
+        if (dry_run)
         {
-            summary.print();
+            Checks::exit_success(VCPKG_LINE_INFO);
         }
 
+        std::unique_ptr<XunitWriter> xunit;
         auto it_xunit = options.settings.find(OPTION_XUNIT);
         if (it_xunit != options.settings.end())
         {
-            std::string xunit_doc = "<assemblies><assembly><collection>\n";
+            xunit = std::make_unique<XunitWriter>(paths.get_filesystem(), fs::u8path(it_xunit->second));
+        }
 
-            xunit_doc += summary.xunit_results();
+        const InstallSummary summary =
+            perform(action_plan, keep_going, paths, status_db, jobs, {}, resume, [&](const SpecSummary& result) {
+                if (xunit) xunit->add(result);
+            });
+        if (xunit) xunit->close();
 
-            xunit_doc += "</collection></assembly></assemblies>\n";
-            paths.get_filesystem().write_contents(fs::u8path(it_xunit->second), xunit_doc);
+        System::println("\nTotal elapsed time: %s\n", summary.total_elapsed_time);
+
+        if (keep_going == KeepGoing::YES)
+        {
+            summary.print();
         }
 
         for (auto&& result : summary.results)
@@ -719,43 +3066,89 @@ namespace vcpkg::Install
         return nullptr;
     }
 
-    std::string InstallSummary::xunit_result(const PackageSpec& spec, Chrono::ElapsedTime time, BuildResult code)
+    void InstallSummary::xunit_result(std::string& out,
+                                      const PackageSpec& spec,
+                                      Chrono::ElapsedTime time,
+                                      BuildResult code,
+                                      const Build::PhaseTimings& timings)
     {
-        std::string inner_block;
         const char* result_string = "";
+        const char* inner_block_format = nullptr;
         switch (code)
         {
             case BuildResult::POST_BUILD_CHECKS_FAILED:
             case BuildResult::FILE_CONFLICTS:
             case BuildResult::BUILD_FAILED:
+            case BuildResult::TIMED_OUT:
                 result_string = "Fail";
-                inner_block = Strings::format("<failure><message><![CDATA[%s]]></message></failure>", to_string(code));
+                inner_block_format = "<failure><message><![CDATA[%s]]></message></failure>";
                 break;
             case BuildResult::EXCLUDED:
             case BuildResult::CASCADED_DUE_TO_MISSING_DEPENDENCIES:
                 result_string = "Skip";
-                inner_block = Strings::format("<reason><![CDATA[%s]]></reason>", to_string(code));
+                inner_block_format = "<reason><![CDATA[%s]]></reason>";
                 break;
             case BuildResult::SUCCEEDED: result_string = "Pass"; break;
             default: Checks::exit_fail(VCPKG_LINE_INFO);
         }
 
-        return Strings::format(R"(<test name="%s" method="%s" time="%lld" result="%s">%s</test>)"
-                               "\n",
-                               spec,
-                               spec,
-                               time.as<std::chrono::seconds>().count(),
-                               result_string,
-                               inner_block);
-    }
+        Strings::append_to(out,
+                           R"(<test name="%s" method="%s" time="%lld" result="%s">)",
+                           spec,
+                           spec,
+                           time.as<std::chrono::seconds>().count(),
+                           result_string);
 
-    std::string InstallSummary::xunit_results() const
-    {
-        std::string xunit_doc;
-        for (auto&& result : results)
+        // Traits are xunit's free-form key/value pairs; each phase that took any time is reported in seconds
+        bool has_traits = false;
+        for (const Build::BuildPhase phase : Build::BUILD_PHASE_VALUES)
         {
-            xunit_doc += xunit_result(result.spec, result.timing, result.build_result.code);
+            const auto duration = timings.get(phase);
+            if (duration.count() == 0) continue;
+            if (!has_traits) out.append("<traits>");
+            has_traits = true;
+            Strings::append_to(out,
+                               R"(<trait name="%s" value="%.3f"/>)",
+                               Build::to_string(phase),
+                               std::chrono::duration<double>(duration).count());
         }
-        return xunit_doc;
+        if (has_traits) out.append("</traits>");
+
+        if (inner_block_format) Strings::append_to(out, inner_block_format, to_string(code));
+
+        out.append("</test>\n");
+    }
+
+    XunitWriter::XunitWriter(Files::Filesystem& fs, const fs::path& path) : m_path(path)
+    {
+        std::error_code ec;
+        m_file = fs.open_for_write(path, ec);
+        Checks::check_exit(VCPKG_LINE_INFO, !ec, "error while writing file: %s: %s", path.u8string(), ec.message());
+        m_file->write("<assemblies><assembly><collection>\n");
+        m_file->flush();
+    }
+
+    void XunitWriter::add(const PackageSpec& spec,
+                          Chrono::ElapsedTime time,
+                          Build::BuildResult code,
+                          const Build::PhaseTimings& timings)
+    {
+        m_test.clear();
+        InstallSummary::xunit_result(m_test, spec, time, code, timings);
+        m_file->write(m_test);
+        m_file->flush();
+    }
+
+    void XunitWriter::add(const SpecSummary& result)
+    {
+        add(result.spec, result.timing, result.build_result.code, result.build_result.timings);
+    }
+
+    void XunitWriter::close()
+    {
+        m_file->write("</collection></assembly></assemblies>\n");
+        std::error_code ec;
+        m_file->close(ec);
+        Checks::check_exit(VCPKG_LINE_INFO, !ec, "error while writing file: %s: %s", m_path.u8string(), ec.message());
     }
 }
@@ -9,6 +9,11 @@
 #include <vcpkg/base/strings.h>
 #include <vcpkg/base/system.h>
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/file.h>
+#endif
+
 #pragma comment(lib, "version")
 #pragma comment(lib, "winhttp")
 
@@ -275,6 +280,37 @@ namespace vcpkg::Metrics
 #endif
     }
 
+    namespace
+    {
+        struct UserMacLookup
+        {
+            std::function<void(const std::string&)> on_ready;
+            std::mutex mutex;
+            std::condition_variable ready;
+            Optional<std::string> mac;
+        };
+
+        std::shared_ptr<UserMacLookup> g_user_mac_lookup;
+    }
+
+    /// <summary>How long flush() waits for a MAC address lookup that has not finished yet.</summary>
+    static constexpr std::chrono::milliseconds USER_MAC_BUDGET{100};
+
+    void Metrics::start_user_mac_lookup(std::function<void(const std::string&)> on_ready)
+    {
+        auto lookup = std::make_shared<UserMacLookup>();
+        lookup->on_ready = std::move(on_ready);
+        g_user_mac_lookup = lookup;
+
+        // Detached so that exiting never waits for getmac
+        std::thread([lookup]() {
+            std::string mac = get_MAC_user();
+            std::lock_guard<std::mutex> lock(lookup->mutex);
+            lookup->mac = std::move(mac);
+            lookup->ready.notify_all();
+        }).detach();
+    }
+
     void Metrics::set_user_information(const std::string& user_id, const std::string& first_use_time)
     {
         g_metricmessage.user_id = user_id;
@@ -389,8 +425,187 @@ namespace vcpkg::Metrics
 #endif
     }
 
+    /// <summary>
+    /// Every run appends its event to one spool file, and the spooled events are sent together, in one upload, once the
+    /// spool reaches SPOOL_SIZE_LIMIT or DRAIN_INTERVAL has passed since the previous upload.
+    /// </summary>
+    static constexpr std::uintmax_t SPOOL_SIZE_LIMIT = 256 * 1024;
+    static constexpr std::chrono::minutes DRAIN_INTERVAL{15};
+
+    namespace
+    {
+        /// <summary>
+        /// The spool file, opened and locked against the other vcpkg processes for as long as this object lives.
+        /// </summary>
+        struct LockedSpool
+        {
+            explicit LockedSpool(const fs::path& path)
+            {
+#if defined(_WIN32)
+                handle = CreateFileW(path.c_str(),
+                                     GENERIC_READ | GENERIC_WRITE,
+                                     FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                     nullptr,
+                                     OPEN_ALWAYS,
+                                     FILE_ATTRIBUTE_NORMAL,
+                                     nullptr);
+                OVERLAPPED whole_file{};
+                if (handle != INVALID_HANDLE_VALUE &&
+                    !LockFileEx(handle, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &whole_file))
+                {
+                    CloseHandle(handle);
+                    handle = INVALID_HANDLE_VALUE;
+                }
+#else
+                fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+                if (fd != -1 && flock(fd, LOCK_EX) != 0)
+                {
+                    ::close(fd);
+                    fd = -1;
+                }
+#endif
+            }
+
+            LockedSpool(const LockedSpool&) = delete;
+            LockedSpool& operator=(const LockedSpool&) = delete;
+
+            ~LockedSpool()
+            {
+                // Closing the file releases the lock
+#if defined(_WIN32)
+                if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+#else
+                if (fd != -1) ::close(fd);
+#endif
+            }
+
+            bool is_locked() const
+            {
+#if defined(_WIN32)
+                return handle != INVALID_HANDLE_VALUE;
+#else
+                return fd != -1;
+#endif
+            }
+
+            /// <summary>Appends `text`, and returns the size of the spool afterwards, or nullopt on failure.</summary>
+            Optional<std::uintmax_t> append(const std::string& text)
+            {
+#if defined(_WIN32)
+                LARGE_INTEGER end{};
+                if (!SetFilePointerEx(handle, LARGE_INTEGER{}, &end, FILE_END)) return nullopt;
+                DWORD written = 0;
+                if (!WriteFile(handle, text.data(), static_cast<DWORD>(text.size()), &written, nullptr) ||
+                    written != text.size())
+                    return nullopt;
+                return static_cast<std::uintmax_t>(end.QuadPart) + written;
+#else
+                const off_t end = lseek(fd, 0, SEEK_END);
+                if (end == -1) return nullopt;
+                for (size_t offset = 0; offset < text.size();)
+                {
+                    const ssize_t written = ::write(fd, text.data() + offset, text.size() - offset);
+                    if (written <= 0) return nullopt;
+                    offset += static_cast<size_t>(written);
+                }
+                return static_cast<std::uintmax_t>(end) + text.size();
+#endif
+            }
+
+            /// <summary>Returns the contents of the spool and empties it.</summary>
+            std::string take_contents()
+            {
+                std::string contents;
+                char buffer[16 * 1024];
+#if defined(_WIN32)
+                if (!SetFilePointerEx(handle, LARGE_INTEGER{}, nullptr, FILE_BEGIN)) return contents;
+                DWORD read = 0;
+                while (ReadFile(handle, buffer, sizeof(buffer), &read, nullptr) && read > 0)
+                {
+                    contents.append(buffer, read);
+                }
+                SetFilePointerEx(handle, LARGE_INTEGER{}, nullptr, FILE_BEGIN);
+                SetEndOfFile(handle);
+#else
+                if (lseek(fd, 0, SEEK_SET) == -1) return contents;
+                ssize_t read = 0;
+                while ((read = ::read(fd, buffer, sizeof(buffer))) > 0)
+                {
+                    contents.append(buffer, static_cast<size_t>(read));
+                }
+                if (ftruncate(fd, 0) != 0) contents.clear();
+#endif
+                return contents;
+            }
+
+        private:
+#if defined(_WIN32)
+            HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+            int fd = -1;
+#endif
+        };
+    }
+
+    /// <summary>
+    /// Spools the event of this run, and returns the spooled events to upload now, if any. Only the run that empties
+    /// the spool uploads them, so concurrent runs never send an event twice or start several uploads for one batch.
+    /// </summary>
+    static Optional<std::string> spool_event(Files::Filesystem& fs,
+                                             const fs::path& spool_dir,
+                                             const std::string& payload)
+    {
+        std::error_code ec;
+        fs.create_directories(spool_dir, ec);
+        if (ec) return nullopt;
+
+        // The payload is an array of one event. Its line breaks are only layout, as to_json_string escapes those in
+        // values, so each event is spooled as one line.
+        if (payload.size() < 2 || payload.front() != '[' || payload.back() != ']') return nullopt;
+        std::string line = payload.substr(1, payload.size() - 2);
+        Util::erase_remove_if(line, [](char c) { return c == '\n' || c == '\r'; });
+        line.push_back('\n');
+
+        LockedSpool spool(spool_dir / "events");
+        if (!spool.is_locked()) return nullopt;
+        const auto maybe_size = spool.append(line);
+        const auto size = maybe_size.get();
+        if (!size) return nullopt;
+
+        // Written at each upload, and at the first run, so that the interval starts there
+        const fs::path drained_marker = spool_dir / "drained";
+        const auto drained_time = fs::stdfs::last_write_time(drained_marker, ec);
+        const bool is_due = !ec && fs::stdfs::file_time_type::clock::now() - drained_time >= DRAIN_INTERVAL;
+        if (!ec && *size < SPOOL_SIZE_LIMIT && !is_due) return nullopt;
+
+        fs.write_contents(drained_marker, "", ec);
+        if (ec) return nullopt;
+        if (*size < SPOOL_SIZE_LIMIT && !is_due) return nullopt;
+
+        // A run that died while appending leaves a partial line, which would spoil the whole batch
+        auto events = Strings::split(spool.take_contents(), "\n");
+        Util::erase_remove_if(events, [](const std::string& event) {
+            return event.size() < 2 || event.front() != '{' || event.back() != '}';
+        });
+        if (events.empty()) return nullopt;
+        return "[" + Strings::join(",", events) + "]";
+    }
+
     void Metrics::flush()
     {
+        if (!g_should_print_metrics && !g_should_send_metrics) return;
+
+        if (const auto lookup = g_user_mac_lookup.get())
+        {
+            std::unique_lock<std::mutex> lock(lookup->mutex);
+            if (lookup->ready.wait_for(lock, USER_MAC_BUDGET, [&]() { return lookup->mac.has_value(); }))
+            {
+                const std::string& mac = lookup->mac.value_or_exit(VCPKG_LINE_INFO);
+                g_metricmessage.track_property("user_mac", mac);
+                lookup->on_ready(mac);
+            }
+        }
+
         const std::string payload = g_metricmessage.format_event_data_template();
         if (g_should_print_metrics) std::cerr << payload << "\n";
         if (!g_should_send_metrics) return;
@@ -407,7 +622,17 @@ namespace vcpkg::Metrics
         auto& fs = Files::get_real_filesystem();
 
 #if defined(_WIN32)
+        std::error_code ec;
+#else
+        if (!fs.exists("/tmp")) return;
+        const fs::path temp_folder_path = "/tmp/vcpkg";
+        std::error_code ec;
+#endif
+        const auto maybe_batch = spool_event(fs, temp_folder_path / "metrics", payload);
+        const auto batch = maybe_batch.get();
+        if (!batch) return;
 
+#if defined(_WIN32)
         const fs::path exe_path = [&fs]() -> fs::path {
             auto vcpkgdir = System::get_exe_path_of_current_process().parent_path();
             auto path = vcpkgdir / "vcpkgmetricsuploader.exe";
@@ -419,21 +644,15 @@ namespace vcpkg::Metrics
             return "";
         }();
 
-        std::error_code ec;
-        fs.create_directories(temp_folder_path, ec);
-        if (ec) return;
         fs.copy_file(exe_path, temp_folder_path_exe, fs::copy_options::skip_existing, ec);
         if (ec) return;
-#else
-        if (!fs.exists("/tmp")) return;
-        const fs::path temp_folder_path = "/tmp/vcpkg";
-        std::error_code ec;
-        fs.create_directory(temp_folder_path, ec);
-        // ignore error
-        ec.clear();
 #endif
-        const fs::path vcpkg_metrics_txt_path = temp_folder_path / ("vcpkg" + generate_random_UUID() + ".txt");
-        fs.write_contents(vcpkg_metrics_txt_path, payload, ec);
+
+        // Named at random, as generate_random_UUID seeds from the time and repeats across runs in the same second
+        std::random_device random;
+        const fs::path vcpkg_metrics_txt_path =
+            temp_folder_path / Strings::format("vcpkg%08x%08x.txt", random(), random());
+        fs.write_contents(vcpkg_metrics_txt_path, *batch, ec);
         if (ec) return;
 
 #if defined(_WIN32)
@@ -0,0 +1,75 @@
+#include "pch.h"
+
+#include <vcpkg/base/files.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/util.h>
+#include <vcpkg/msbuildprops.h>
+
+namespace vcpkg::MSBuildProps
+{
+    // Characters that XML or MSBuild would read as anything but part of a file name
+    static std::string escape(const std::string& s)
+    {
+        std::string out;
+        for (const char c : s)
+        {
+            switch (c)
+            {
+                case '&': out.append("&amp;"); break;
+                case '<': out.append("&lt;"); break;
+                case '>': out.append("&gt;"); break;
+                case '%':
+                case '$':
+                case '@':
+                case ';':
+                case '\'': Strings::append_to(out, "%%%02X", static_cast<int>(static_cast<unsigned char>(c))); break;
+                default: out.push_back(c); break;
+            }
+        }
+        return out;
+    }
+
+    // The libraries the lib\*.lib wildcard would match, as paths relative to $(VcpkgRoot)
+    static std::string list_libraries(const Files::Filesystem& fs, const fs::path& dir, const std::string& relative_dir)
+    {
+        std::vector<std::string> libraries;
+        for (auto&& file : fs.get_files_non_recursive(dir))
+        {
+            if (!Strings::case_insensitive_ascii_equals(file.extension().u8string(), ".lib")) continue;
+            const std::string filename = escape(file.filename().u8string());
+            libraries.push_back(Strings::format("$(VcpkgRoot)%s\\%s", relative_dir, filename));
+        }
+        Util::sort(libraries);
+        return Strings::join(";", libraries);
+    }
+
+    void write_triplet_props(const VcpkgPaths& paths, const Triplet& triplet)
+    {
+        auto& fs = paths.get_filesystem();
+        const fs::path triplet_dir = paths.installed / triplet.canonical_name();
+        const fs::path props_dir = paths.vcpkg_dir / "msbuild";
+
+        const std::string contents = Strings::format(
+            R"(<?xml version="1.0" encoding="utf-8"?>
+<!-- Generated by vcpkg from the packages installed for %s -->
+<Project ToolsVersion="4.0" xmlns="http://schemas.microsoft.com/developer/msbuild/2003">
+  <PropertyGroup>
+    <VcpkgLibrariesListed>true</VcpkgLibrariesListed>
+    <VcpkgDebugLibraries>%s</VcpkgDebugLibraries>
+    <VcpkgReleaseLibraries>%s</VcpkgReleaseLibraries>
+  </PropertyGroup>
+</Project>
+)",
+            triplet.canonical_name(),
+            list_libraries(fs, triplet_dir / "debug" / "lib", "debug\\lib"),
+            list_libraries(fs, triplet_dir / "lib", "lib"));
+
+        // Written aside and renamed, so a build that evaluates its projects meanwhile reads either file whole
+        std::error_code ec;
+        fs.create_directories(props_dir, ec);
+        const fs::path props_path = props_dir / (triplet.canonical_name() + ".props");
+        const fs::path tmp_path = props_dir / (triplet.canonical_name() + ".props.tmp");
+        fs.write_contents(tmp_path, contents);
+        fs.rename(tmp_path, props_path);
+    }
+}
@@ -9,11 +9,85 @@ using vcpkg::Parse::parse_comma_list;
 
 namespace vcpkg
 {
+    struct InternedName
+    {
+        explicit InternedName(const std::string& s) : value(s), hash(std::hash<std::string>()(value)) {}
+
+        std::string value;
+        size_t hash;
+
+        bool operator==(const InternedName& o) const { return o.value == value; }
+    };
+}
+
+namespace std
+{
+    template<>
+    struct hash<vcpkg::InternedName>
+    {
+        size_t operator()(const vcpkg::InternedName& name) const { return name.hash; }
+    };
+}
+
+namespace vcpkg
+{
+    static const InternedName* intern(const std::string& s)
+    {
+        // Specs are created from several threads while ports and packages load, so the table is locked
+        static Util::LockGuarded<std::unordered_set<InternedName>> s_names;
+
+        InternedName name(s);
+        auto names = s_names.lock();
+        const auto it = names->find(name);
+        if (it != names->end()) return &*it;
+        return &*names->insert(std::move(name)).first;
+    }
+
+    static const InternedName* empty_name()
+    {
+        static const InternedName* const s_empty = intern("");
+        return s_empty;
+    }
+
+    FeatureList::FeatureList(std::initializer_list<std::string> names)
+    {
+        for (auto&& name : names)
+            insert(name);
+    }
+
+    std::vector<const std::string*>::const_iterator FeatureList::lower_bound(const std::string& name) const
+    {
+        return std::lower_bound(m_names.begin(),
+                                m_names.end(),
+                                name,
+                                [](const std::string* lhs, const std::string& rhs) { return *lhs < rhs; });
+    }
+
+    void FeatureList::insert(const std::string& name)
+    {
+        const auto it = lower_bound(name);
+        if (it != m_names.end() && **it == name) return;
+        m_names.insert(it, &intern(name)->value);
+    }
+
+    bool FeatureList::contains(const std::string& name) const
+    {
+        const auto it = lower_bound(name);
+        return it != m_names.end() && **it == name;
+    }
+
     static bool is_valid_package_spec_char(char c)
     {
         return (c == '-') || isdigit(c) || (isalpha(c) && islower(c)) || (c == '[') || (c == ']');
     }
 
+    FeatureSpec::FeatureSpec(const PackageSpec& spec, const std::string& feature)
+        : m_spec(spec), m_feature(intern(feature))
+    {
+    }
+
+    const std::string& FeatureSpec::feature() const { return m_feature->value; }
+
     std::string FeatureSpec::to_string() const
     {
         if (feature().empty()) return spec().to_string();
@@ -64,7 +138,7 @@ namespace vcpkg
         return ret;
     }
 
-    ExpectedT<FullPackageSpec, PackageSpecParseResult> FullPackageSpec::from_string(const std::string& spec_as_string,
+    ExpectedT<FullPackageSpec, PackageSpecParseResult> FullPackageSpec::from_string(std::string_view spec_as_string,
                                                                                     const Triplet& default_triplet)
     {
         auto res = ParsedSpecifier::from_string(spec_as_string);
@@ -88,7 +162,7 @@ namespace vcpkg
         }
 
         PackageSpec p;
-        p.m_name = name;
+        p.m_name = intern(name);
         p.m_triplet = triplet;
         return p;
     }
@@ -112,64 +186,66 @@ namespace vcpkg
         });
     }
 
-    const std::string& PackageSpec::name() const { return this->m_name; }
+    PackageSpec::PackageSpec() : m_name(empty_name()) {}
+
+    const std::string& PackageSpec::name() const { return this->m_name->value; }
 
     const Triplet& PackageSpec::triplet() const { return this->m_triplet; }
 
-    std::string PackageSpec::dir() const { return Strings::format("%s_%s", this->m_name, this->m_triplet); }
+    std::string PackageSpec::dir() const { return Strings::format("%s_%s", this->name(), this->m_triplet); }
 
     std::string PackageSpec::to_string() const { return Strings::format("%s:%s", this->name(), this->triplet()); }
 
-    bool operator==(const PackageSpec& left, const PackageSpec& right)
+    size_t PackageSpec::hash_code() const
     {
-        return left.name() == right.name() && left.triplet() == right.triplet();
+        size_t hash = 17;
+        hash = hash * 31 + m_name->hash;
+        hash = hash * 31 + m_triplet.hash_code();
+        return hash;
     }
 
     bool operator!=(const PackageSpec& left, const PackageSpec& right) { return !(left == right); }
 
-    ExpectedT<ParsedSpecifier, PackageSpecParseResult> ParsedSpecifier::from_string(const std::string& input)
+    ExpectedT<ParsedSpecifier, PackageSpecParseResult> ParsedSpecifier::from_string(std::string_view input)
     {
-        auto pos = input.find(':');
-        auto pos_l_bracket = input.find('[');
-        auto pos_r_bracket = input.find(']');
+        // Each part is sliced out of the input and copied once, straight into the result
+        const auto pos = input.find(':');
+        const auto pos_l_bracket = input.find('[');
+        const auto pos_r_bracket = input.find(']');
 
         ParsedSpecifier f;
-        if (pos == std::string::npos && pos_l_bracket == std::string::npos)
+        if (pos == std::string_view::npos && pos_l_bracket == std::string_view::npos)
         {
-            f.name = input;
+            f.name.assign(input);
             return f;
         }
-        else if (pos == std::string::npos)
+        else if (pos == std::string_view::npos)
         {
-            if (pos_r_bracket == std::string::npos || pos_l_bracket >= pos_r_bracket)
+            if (pos_r_bracket == std::string_view::npos || pos_l_bracket >= pos_r_bracket)
             {
                 return PackageSpecParseResult::INVALID_CHARACTERS;
             }
-            const std::string name = input.substr(0, pos_l_bracket);
-            f.name = name;
+            f.name.assign(input.substr(0, pos_l_bracket));
             f.features = parse_comma_list(input.substr(pos_l_bracket + 1, pos_r_bracket - pos_l_bracket - 1));
             return f;
         }
-        else if (pos_l_bracket == std::string::npos && pos_r_bracket == std::string::npos)
+        else if (pos_l_bracket == std::string_view::npos && pos_r_bracket == std::string_view::npos)
         {
-            const std::string name = input.substr(0, pos);
-            f.triplet = input.substr(pos + 1);
-            f.name = name;
+            f.name.assign(input.substr(0, pos));
+            f.triplet.assign(input.substr(pos + 1));
         }
         else
         {
-            if (pos_r_bracket == std::string::npos || pos_l_bracket >= pos_r_bracket)
+            if (pos_r_bracket == std::string_view::npos || pos_l_bracket >= pos_r_bracket)
             {
                 return PackageSpecParseResult::INVALID_CHARACTERS;
             }
-            const std::string name = input.substr(0, pos_l_bracket);
+            f.name.assign(input.substr(0, pos_l_bracket));
             f.features = parse_comma_list(input.substr(pos_l_bracket + 1, pos_r_bracket - pos_l_bracket - 1));
-            f.triplet = input.substr(pos + 1);
-            f.name = name;
+            f.triplet.assign(input.substr(pos + 1));
         }
 
-        auto pos2 = input.find(':', pos + 1);
-        if (pos2 != std::string::npos)
+        if (input.find(':', pos + 1) != std::string_view::npos)
         {
             return PackageSpecParseResult::TOO_MANY_COLONS;
         }
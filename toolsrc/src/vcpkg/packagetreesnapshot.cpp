@@ -0,0 +1,110 @@
+#include "pch.h"
+
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/util.h>
+#include <vcpkg/packagetreesnapshot.h>
+
+namespace vcpkg
+{
+    static bool same_path(const std::string& left, const std::string& right)
+    {
+#if defined(_WIN32)
+        return Strings::case_insensitive_ascii_equals(left, right);
+#else
+        return left == right;
+#endif
+    }
+
+    static bool is_below(const std::string& relative, const std::string& relative_dir)
+    {
+        if (relative_dir.empty()) return true;
+        return relative.size() > relative_dir.size() + 1 && relative[relative_dir.size()] == '/' &&
+               same_path(relative.substr(0, relative_dir.size()), relative_dir);
+    }
+
+    PackageTreeSnapshot PackageTreeSnapshot::create(const Files::Filesystem& fs, const fs::path& root)
+    {
+        PackageTreeSnapshot ret;
+        ret.root = root;
+
+        // The listing reports the type and size of each entry, so nothing is stat'ed separately
+        const size_t prefix_length = root.generic_u8string().size() + 1;
+        ret.entries = Util::fmap(fs.get_entries_recursive(root), [&](const Files::DirectoryEntry& entry) -> Entry {
+            return {entry.path, entry.path.generic_u8string().substr(prefix_length), entry.type, entry.size};
+        });
+
+        for (size_t i = 0; i < ret.entries.size(); ++i)
+        {
+            const Entry& entry = ret.entries[i];
+            if (!entry.is_directory()) ret.files_by_extension[entry.path.extension().u8string()].push_back(i);
+        }
+
+        return ret;
+    }
+
+    bool PackageTreeSnapshot::contains(const std::string& relative) const
+    {
+        return std::any_of(
+            entries.begin(), entries.end(), [&](const Entry& entry) { return same_path(entry.relative, relative); });
+    }
+
+    bool PackageTreeSnapshot::has_entries_below(const std::string& relative_dir) const
+    {
+        return std::any_of(entries.begin(), entries.end(), [&](const Entry& entry) {
+            return is_below(entry.relative, relative_dir);
+        });
+    }
+
+    std::vector<fs::path> PackageTreeSnapshot::files_below(const std::string& relative_dir) const
+    {
+        std::vector<fs::path> ret;
+        for (auto&& entry : entries)
+        {
+            if (!entry.is_directory() && is_below(entry.relative, relative_dir)) ret.push_back(entry.path);
+        }
+        return ret;
+    }
+
+    std::vector<fs::path> PackageTreeSnapshot::files_below(const std::string& relative_dir,
+                                                           const std::string& extension) const
+    {
+        std::vector<fs::path> ret;
+        const auto it = files_by_extension.find(extension);
+        if (it == files_by_extension.end()) return ret;
+
+        for (const size_t i : it->second)
+        {
+            if (is_below(entries[i].relative, relative_dir)) ret.push_back(entries[i].path);
+        }
+        return ret;
+    }
+
+    std::vector<fs::path> PackageTreeSnapshot::files_in(const std::string& relative_dir) const
+    {
+        const size_t name_start = relative_dir.empty() ? 0 : relative_dir.size() + 1;
+        std::vector<fs::path> ret;
+        for (auto&& entry : entries)
+        {
+            if (entry.is_directory() || !is_below(entry.relative, relative_dir)) continue;
+            if (entry.relative.find('/', name_start) == std::string::npos) ret.push_back(entry.path);
+        }
+        return ret;
+    }
+
+    std::vector<fs::path> PackageTreeSnapshot::empty_directories() const
+    {
+        std::unordered_set<std::string> parents;
+        for (auto&& entry : entries)
+        {
+            const auto slash = entry.relative.rfind('/');
+            if (slash != std::string::npos) parents.insert(entry.relative.substr(0, slash));
+        }
+
+        std::vector<fs::path> ret;
+        for (auto&& entry : entries)
+        {
+            if (entry.is_directory() && parents.find(entry.relative) == parents.end()) ret.push_back(entry.path);
+        }
+        return ret;
+    }
+}
@@ -1,22 +1,29 @@
 #include "pch.h"
 
 #include <vcpkg/base/files.h>
+#include <vcpkg/base/threadpool.h>
 #include <vcpkg/base/util.h>
 #include <vcpkg/globalstate.h>
 #include <vcpkg/paragraphparseresult.h>
 #include <vcpkg/paragraphs.h>
 
+#include <list>
+
 using namespace vcpkg::Parse;
 
 namespace vcpkg::Paragraphs
 {
     struct Parser
     {
-        Parser(const char* c, const char* e) : cur(c), end(e) {}
+        Parser(const char* c, const char* e, std::list<std::string>& continuations)
+            : cur(c), end(e), continuations(continuations)
+        {
+        }
 
     private:
         const char* cur;
         const char* const end;
+        std::list<std::string>& continuations;
 
         void peek(char& ch) const
         {
@@ -60,9 +67,11 @@ namespace vcpkg::Paragraphs
 
         static bool is_lineend(char ch) { return ch == '\r' || ch == '\n' || ch == 0; }
 
-        void get_fieldvalue(char& ch, std::string& fieldvalue)
+        std::string_view get_fieldvalue(char& ch)
         {
-            fieldvalue.clear();
+            std::string_view fieldvalue;
+            // Only values that span several lines are copied, to join the lines
+            std::string* continued = nullptr;
 
             auto beginning_of_line = cur;
             do
@@ -71,7 +80,11 @@ namespace vcpkg::Paragraphs
                 while (!is_lineend(ch))
                     next(ch);
 
-                fieldvalue.append(beginning_of_line, cur);
+                const std::string_view line(beginning_of_line, cur - beginning_of_line);
+                if (continued)
+                    continued->append(line.data(), line.size());
+                else
+                    fieldvalue = line;
 
                 if (ch == '\r') next(ch);
                 if (ch == '\n') next(ch);
@@ -79,7 +92,7 @@ namespace vcpkg::Paragraphs
                 if (is_alphanum(ch) || is_comment(ch))
                 {
                     // Line begins a new field.
-                    return;
+                    break;
                 }
 
                 beginning_of_line = cur;
@@ -93,33 +106,37 @@ namespace vcpkg::Paragraphs
                     // Line was whitespace or empty.
                     // This terminates the field and the paragraph.
                     // We leave the blank line's whitespace consumed, because it doesn't matter.
-                    return;
+                    break;
                 }
 
                 // First nonspace is not a newline. This continues the current field value.
                 // We forcibly convert all newlines into single '\n' for ease of text handling later on.
-                fieldvalue.push_back('\n');
+                if (!continued) continued = &continuations.emplace_back(fieldvalue);
+                continued->push_back('\n');
             } while (true);
+
+            if (continued) return *continued;
+            return fieldvalue;
         }
 
-        void get_fieldname(char& ch, std::string& fieldname)
+        std::string_view get_fieldname(char& ch)
         {
             auto begin_fieldname = cur;
             while (is_alphanum(ch) || ch == '-')
                 next(ch);
             Checks::check_exit(VCPKG_LINE_INFO, ch == ':', "Expected ':'");
-            fieldname = std::string(begin_fieldname, cur);
+            const std::string_view fieldname(begin_fieldname, cur - begin_fieldname);
 
             // skip ': '
             next(ch);
             skip_spaces(ch);
+            return fieldname;
         }
 
-        void get_paragraph(char& ch, std::unordered_map<std::string, std::string>& fields)
+        void get_paragraph(char& ch, RawParagraphView& paragraph)
         {
-            fields.clear();
-            std::string fieldname;
-            std::string fieldvalue;
+            // Enough for the fields of nearly every CONTROL and status paragraph, so the vector is allocated once
+            paragraph.fields.reserve(8);
             do
             {
                 if (is_comment(ch))
@@ -128,21 +145,17 @@ namespace vcpkg::Paragraphs
                     continue;
                 }
 
-                get_fieldname(ch, fieldname);
-
-                auto it = fields.find(fieldname);
-                Checks::check_exit(VCPKG_LINE_INFO, it == fields.end(), "Duplicate field");
+                const auto fieldname = get_fieldname(ch);
+                Checks::check_exit(VCPKG_LINE_INFO, paragraph.find(fieldname) == nullptr, "Duplicate field");
 
-                get_fieldvalue(ch, fieldvalue);
-
-                fields.emplace(fieldname, fieldvalue);
+                paragraph.fields.emplace_back(fieldname, get_fieldvalue(ch));
             } while (!is_lineend(ch));
         }
 
     public:
-        std::vector<std::unordered_map<std::string, std::string>> get_paragraphs()
+        std::vector<RawParagraphView> get_paragraphs()
         {
-            std::vector<std::unordered_map<std::string, std::string>> paragraphs;
+            std::vector<RawParagraphView> paragraphs;
 
             char ch;
             peek(ch);
@@ -163,6 +176,32 @@ namespace vcpkg::Paragraphs
         }
     };
 
+    static ParagraphViews parse_paragraph_views(std::unique_ptr<const Files::MappedFile>&& text)
+    {
+        ParagraphViews views;
+        views.text = std::move(text);
+        const std::string_view contents = views.text->contents();
+        views.paragraphs =
+            Parser(contents.data(), contents.data() + contents.size(), views.continuations).get_paragraphs();
+        return views;
+    }
+
+    ParagraphViews parse_paragraph_views(std::string&& str)
+    {
+        return parse_paragraph_views(Files::make_mapped_string(std::move(str)));
+    }
+
+    Expected<ParagraphViews> get_paragraph_views(const Files::Filesystem& fs, const fs::path& control_path)
+    {
+        auto contents = fs.map_contents(control_path);
+        if (auto file = contents.get())
+        {
+            return parse_paragraph_views(std::move(*file));
+        }
+
+        return contents.error();
+    }
+
     Expected<std::unordered_map<std::string, std::string>> get_single_paragraph(const Files::Filesystem& fs,
                                                                                 const fs::path& control_path)
     {
@@ -189,12 +228,13 @@ namespace vcpkg::Paragraphs
 
     Expected<std::unordered_map<std::string, std::string>> parse_single_paragraph(const std::string& str)
     {
-        const std::vector<std::unordered_map<std::string, std::string>> p =
-            Parser(str.c_str(), str.c_str() + str.size()).get_paragraphs();
+        std::list<std::string> continuations;
+        const std::vector<RawParagraphView> p =
+            Parser(str.c_str(), str.c_str() + str.size(), continuations).get_paragraphs();
 
         if (p.size() == 1)
         {
-            return p.at(0);
+            return p.at(0).to_raw_paragraph();
         }
 
         return std::error_code(ParagraphParseResult::EXPECTED_ONE_PARAGRAPH);
@@ -202,45 +242,63 @@ namespace vcpkg::Paragraphs
 
     Expected<std::vector<std::unordered_map<std::string, std::string>>> parse_paragraphs(const std::string& str)
     {
-        return Parser(str.c_str(), str.c_str() + str.size()).get_paragraphs();
+        std::list<std::string> continuations;
+        return Util::fmap(Parser(str.c_str(), str.c_str() + str.size(), continuations).get_paragraphs(),
+                          [](const RawParagraphView& paragraph) { return paragraph.to_raw_paragraph(); });
     }
 
-    ParseExpected<SourceControlFile> try_load_port(const Files::Filesystem& fs, const fs::path& path)
+    ParseExpected<SourceControlFile> parse_port(const std::string_view control_text)
     {
-        Expected<std::vector<std::unordered_map<std::string, std::string>>> pghs = get_paragraphs(fs, path / "CONTROL");
-        if (auto vector_pghs = pghs.get())
+        std::list<std::string> continuations;
+        const auto paragraphs =
+            Parser(control_text.data(), control_text.data() + control_text.size(), continuations).get_paragraphs();
+        auto csf = SourceControlFile::parse_control_file(paragraphs);
+        if (!GlobalState::feature_packages)
         {
-            auto csf = SourceControlFile::parse_control_file(std::move(*vector_pghs));
-            if (!GlobalState::feature_packages)
+            if (auto ptr = csf.get())
             {
-                if (auto ptr = csf.get())
-                {
-                    Checks::check_exit(VCPKG_LINE_INFO, ptr->get() != nullptr);
-                    ptr->get()->core_paragraph->default_features.clear();
-                    ptr->get()->feature_paragraphs.clear();
-                }
+                Checks::check_exit(VCPKG_LINE_INFO, ptr->get() != nullptr);
+                ptr->get()->core_paragraph->default_features.clear();
+                ptr->get()->feature_paragraphs.clear();
             }
-            return csf;
         }
+        return csf;
+    }
+
+    static std::unique_ptr<ParseControlErrorInfo> make_load_error(const fs::path& path, const std::error_code& error)
+    {
         auto error_info = std::make_unique<ParseControlErrorInfo>();
         error_info->name = path.filename().generic_u8string();
-        error_info->error = pghs.error();
+        error_info->error = error;
         return error_info;
     }
 
+    ParseExpected<SourceControlFile> try_load_port(const Files::Filesystem& fs, const fs::path& path)
+    {
+        const auto contents = fs.map_contents(path / "CONTROL");
+        if (auto file = contents.get())
+        {
+            return parse_port((*file)->contents());
+        }
+        return make_load_error(path, contents.error());
+    }
+
     Expected<BinaryControlFile> try_load_cached_package(const VcpkgPaths& paths, const PackageSpec& spec)
     {
-        Expected<std::vector<std::unordered_map<std::string, std::string>>> pghs =
-            get_paragraphs(paths.get_filesystem(), paths.package_dir(spec) / "CONTROL");
+        const Expected<ParagraphViews> pghs =
+            get_paragraph_views(paths.get_filesystem(), paths.package_dir(spec) / "CONTROL");
 
-        if (auto p = pghs.get())
+        if (auto views = pghs.get())
         {
-            BinaryControlFile bcf;
-            bcf.core_paragraph = BinaryParagraph(p->front());
-            p->erase(p->begin());
+            const auto& p = views->paragraphs;
+            Checks::check_exit(VCPKG_LINE_INFO, !p.empty(), "Expected a paragraph in the CONTROL file of %s", spec);
 
-            bcf.features =
-                Util::fmap(*p, [&](auto&& raw_feature) -> BinaryParagraph { return BinaryParagraph(raw_feature); });
+            BinaryControlFile bcf;
+            bcf.core_paragraph = BinaryParagraph(p.front());
+            for (auto it = std::next(p.begin()); it != p.end(); ++it)
+            {
+                bcf.features.emplace_back(*it);
+            }
 
             return bcf;
         }
@@ -248,8 +306,111 @@ namespace vcpkg::Paragraphs
         return pghs.error();
     }
 
-    LoadResults try_load_all_ports(const Files::Filesystem& fs, const fs::path& ports_dir)
+    namespace
     {
+        struct PortIndexEntry
+        {
+            uintmax_t size;
+            long long write_time;
+            std::string_view control_text;
+        };
+
+        struct PortIndex
+        {
+            fs::path ports_dir;
+            fs::path index_file;
+        };
+
+        PortIndex g_port_index;
+
+        struct PreloadedPorts
+        {
+            fs::path ports_dir;
+            bool feature_packages;
+            std::unique_ptr<LoadResults> results;
+        };
+
+        PreloadedPorts g_preloaded_ports;
+    }
+
+    void enable_port_index(const fs::path& ports_dir, const fs::path& index_file)
+    {
+        g_port_index.ports_dir = ports_dir;
+        g_port_index.index_file = index_file;
+    }
+
+    static constexpr StringLiteral PORT_INDEX_HEADER = "vcpkg-port-index 1\n";
+
+    /// <summary>
+    /// The index starts with PORT_INDEX_HEADER, followed by one record per port:
+    ///   <port directory name>\t<CONTROL size>\t<CONTROL write time>\n<CONTROL contents>\n
+    /// A malformed record ends the index; everything after it is loaded from the port directories again.
+    /// </summary>
+    static std::unordered_map<std::string, PortIndexEntry> parse_port_index(const std::string_view text)
+    {
+        std::unordered_map<std::string, PortIndexEntry> entries;
+        if (text.compare(0, PORT_INDEX_HEADER.size(), PORT_INDEX_HEADER.c_str()) != 0) return entries;
+
+        for (size_t pos = PORT_INDEX_HEADER.size(); pos < text.size();)
+        {
+            const auto header_end = text.find('\n', pos);
+            if (header_end == std::string_view::npos) break;
+            const auto fields = Strings::split_view(text.substr(pos, header_end - pos), "\t").to_vector();
+            if (fields.size() != 3) break;
+
+            // The numbers end at the tab or newline after them, where strtoull stops
+            PortIndexEntry entry;
+            entry.size = std::strtoull(fields[1].data(), nullptr, 10);
+            entry.write_time = std::strtoll(fields[2].data(), nullptr, 10);
+
+            const size_t contents_begin = header_end + 1;
+            if (entry.size > text.size() - contents_begin || text.size() - contents_begin - entry.size < 1 ||
+                text[contents_begin + entry.size] != '\n')
+                break;
+
+            entry.control_text = text.substr(contents_begin, static_cast<size_t>(entry.size));
+            entries.emplace(std::string(fields[0]), entry);
+            pos = contents_begin + static_cast<size_t>(entry.size) + 1;
+        }
+
+        return entries;
+    }
+
+    static void write_port_index(Files::Filesystem& fs,
+                                 const std::vector<fs::path>& port_dirs,
+                                 const std::vector<Optional<PortIndexEntry>>& entries)
+    {
+        std::string text = PORT_INDEX_HEADER.c_str();
+        for (size_t i = 0; i < port_dirs.size(); ++i)
+        {
+            const auto entry = entries[i].get();
+            if (!entry) continue;
+            Strings::append_to(text,
+                               "%s\t%llu\t%lld\n",
+                               port_dirs[i].filename().u8string(),
+                               static_cast<unsigned long long>(entry->size),
+                               entry->write_time);
+            text.append(entry->control_text.data(), entry->control_text.size());
+            text.push_back('\n');
+        }
+
+        const fs::path tmp_file = fs::path(g_port_index.index_file).concat(".tmp");
+        std::error_code ec;
+        fs.write_contents(tmp_file, text, ec);
+        if (!ec) fs.rename(tmp_file, g_port_index.index_file, ec);
+    }
+
+    LoadResults try_load_all_ports(Files::Filesystem& fs, const fs::path& ports_dir)
+    {
+        // Parsing drops the features when feature packages are off, so the preloaded ports only fit the same setting
+        if (g_preloaded_ports.results && g_preloaded_ports.ports_dir == ports_dir &&
+            g_preloaded_ports.feature_packages == GlobalState::feature_packages)
+        {
+            LoadResults preloaded = std::move(*g_preloaded_ports.results);
+            g_preloaded_ports.results.reset();
+            return preloaded;
+        }
+
         LoadResults ret;
         auto port_dirs = fs.get_files_non_recursive(ports_dir);
         Util::sort(port_dirs);
@@ -257,9 +418,74 @@ namespace vcpkg::Paragraphs
             return fs.is_regular_file(port_dir_entry) && port_dir_entry.filename() == ".DS_Store";
         });
 
-        for (auto&& path : port_dirs)
+        // Unchanged ports are parsed straight out of the index, which is mapped as a whole instead of opening every
+        // CONTROL file. Only the ports whose CONTROL file has a different size or write time are read again.
+        const bool use_index = !g_port_index.index_file.empty() && ports_dir == g_port_index.ports_dir;
+        std::unique_ptr<Files::MappedFile> index_file;
+        std::unordered_map<std::string, PortIndexEntry> index;
+        if (use_index)
         {
-            auto maybe_spgh = try_load_port(fs, path);
+            auto maybe_index_file = fs.map_contents(g_port_index.index_file);
+            if (auto file = maybe_index_file.get())
+            {
+                index_file = std::move(*file);
+                index = parse_port_index(index_file->contents());
+            }
+        }
+
+        std::vector<Optional<PortIndexEntry>> entries(port_dirs.size());
+        std::vector<std::unique_ptr<Files::MappedFile>> reloaded(port_dirs.size());
+        std::atomic<bool> index_is_stale{false};
+
+        std::vector<Optional<ParseExpected<SourceControlFile>>> loaded(port_dirs.size());
+        ThreadPool::parallel_for(port_dirs.size(), [&](size_t i) {
+            if (!use_index)
+            {
+                loaded[i] = try_load_port(fs, port_dirs[i]);
+                return;
+            }
+
+            const fs::path control_path = port_dirs[i] / "CONTROL";
+            std::error_code ec;
+            PortIndexEntry current;
+            current.size = fs::stdfs::file_size(control_path, ec);
+            if (!ec) current.write_time = fs::stdfs::last_write_time(control_path, ec).time_since_epoch().count();
+            if (!ec)
+            {
+                const auto it = index.find(port_dirs[i].filename().u8string());
+                if (it != index.end() && it->second.size == current.size && it->second.write_time == current.write_time)
+                {
+                    entries[i] = it->second;
+                    loaded[i] = parse_port(it->second.control_text);
+                    return;
+                }
+
+                auto maybe_file = fs.map_contents(control_path);
+                if (auto file = maybe_file.get())
+                {
+                    reloaded[i] = std::move(*file);
+                    current.control_text = reloaded[i]->contents();
+                    // A file that changed while it was read is left out so that the next run reads it again
+                    if (current.control_text.size() == current.size) entries[i] = current;
+                    index_is_stale = true;
+                    loaded[i] = parse_port(current.control_text);
+                    return;
+                }
+                ec = maybe_file.error();
+            }
+
+            index_is_stale = true;
+            loaded[i] = make_load_error(port_dirs[i], ec);
+        });
+
+        if (use_index && (index_is_stale || index.size() != port_dirs.size()))
+        {
+            write_port_index(fs, port_dirs, entries);
+        }
+
+        for (auto&& maybe_loaded : loaded)
+        {
+            auto& maybe_spgh = maybe_loaded.value_or_exit(VCPKG_LINE_INFO);
             if (const auto spgh = maybe_spgh.get())
             {
                 ret.paragraphs.emplace_back(std::move(*spgh));
@@ -272,8 +498,117 @@ namespace vcpkg::Paragraphs
         return ret;
     }
 
-    std::vector<std::unique_ptr<SourceControlFile>> load_all_ports(const Files::Filesystem& fs,
-                                                                   const fs::path& ports_dir)
+    std::vector<std::string> get_all_port_names(const Files::Filesystem& fs, const fs::path& ports_dir)
+    {
+        // The ports in the index are known to have a CONTROL file, so only the others are checked
+        std::unordered_map<std::string, PortIndexEntry> index;
+        std::unique_ptr<Files::MappedFile> index_file;
+        if (!g_port_index.index_file.empty() && ports_dir == g_port_index.ports_dir)
+        {
+            auto maybe_index_file = fs.map_contents(g_port_index.index_file);
+            if (auto file = maybe_index_file.get())
+            {
+                index_file = std::move(*file);
+                index = parse_port_index(index_file->contents());
+            }
+        }
+
+        std::vector<std::string> names;
+        for (auto&& port_dir : fs.get_files_non_recursive(ports_dir))
+        {
+            auto name = port_dir.filename().u8string();
+            if (Util::Sets::contains(index, name) || fs.exists(port_dir / "CONTROL")) names.push_back(std::move(name));
+        }
+        Util::sort(names);
+        return names;
+    }
+
+    /// <summary>
+    /// The Version field of the first paragraph of a CONTROL file, found by scanning its lines rather than parsing it.
+    /// </summary>
+    static Optional<std::string> find_core_version(std::string_view control_text)
+    {
+        static constexpr std::string_view VERSION_FIELD = "Version:";
+
+        bool in_paragraph = false;
+        for (size_t pos = 0; pos < control_text.size();)
+        {
+            size_t eol = control_text.find('\n', pos);
+            if (eol == std::string_view::npos) eol = control_text.size();
+            std::string_view line = control_text.substr(pos, eol - pos);
+            pos = eol + 1;
+
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if (!line.empty() && line.front() == '#') continue;
+            if (line.find_first_not_of(" \t") == std::string_view::npos)
+            {
+                if (in_paragraph) break;
+                continue;
+            }
+
+            in_paragraph = true;
+            if (line.compare(0, VERSION_FIELD.size(), VERSION_FIELD) == 0)
+            {
+                return Strings::trim(std::string(line.substr(VERSION_FIELD.size())));
+            }
+        }
+
+        return nullopt;
+    }
+
+    std::unordered_map<std::string, std::string> get_port_versions(const Files::Filesystem& fs,
+                                                                   const fs::path& ports_dir,
+                                                                   const std::vector<std::string>& names)
+    {
+        std::unordered_map<std::string, PortIndexEntry> index;
+        std::unique_ptr<Files::MappedFile> index_file;
+        if (!g_port_index.index_file.empty() && ports_dir == g_port_index.ports_dir)
+        {
+            auto maybe_index_file = fs.map_contents(g_port_index.index_file);
+            if (auto file = maybe_index_file.get())
+            {
+                index_file = std::move(*file);
+                index = parse_port_index(index_file->contents());
+            }
+        }
+
+        // Costs one stat per port when the index is current; the CONTROL file is only read when it changed
+        std::vector<Optional<std::string>> versions(names.size());
+        ThreadPool::parallel_for(names.size(), [&](size_t i) {
+            const fs::path control_path = ports_dir / names[i] / "CONTROL";
+            std::error_code ec;
+            const auto size = fs::stdfs::file_size(control_path, ec);
+            if (ec) return;
+            const auto write_time = fs::stdfs::last_write_time(control_path, ec).time_since_epoch().count();
+            if (ec) return;
+
+            const auto it = index.find(names[i]);
+            if (it != index.end() && it->second.size == size && it->second.write_time == write_time)
+            {
+                versions[i] = find_core_version(it->second.control_text);
+                return;
+            }
+
+            const auto maybe_file = fs.map_contents(control_path);
+            if (auto file = maybe_file.get()) versions[i] = find_core_version((*file)->contents());
+        });
+
+        std::unordered_map<std::string, std::string> result;
+        for (size_t i = 0; i < names.size(); ++i)
+        {
+            if (auto version = versions[i].get()) result.emplace(names[i], std::move(*version));
+        }
+        return result;
+    }
+
+    void preload_all_ports(Files::Filesystem& fs, const fs::path& ports_dir)
+    {
+        g_preloaded_ports.results.reset();
+        auto results = std::make_unique<LoadResults>(try_load_all_ports(fs, ports_dir));
+        g_preloaded_ports = {ports_dir, GlobalState::feature_packages, std::move(results)};
+    }
+
+    std::vector<std::unique_ptr<SourceControlFile>> load_all_ports(Files::Filesystem& fs, const fs::path& ports_dir)
     {
         auto results = try_load_all_ports(fs, ports_dir);
         if (!results.errors.empty())
@@ -6,59 +6,107 @@
 
 namespace vcpkg::Parse
 {
-    static Optional<std::string> remove_field(std::unordered_map<std::string, std::string>* fields,
-                                              const std::string& fieldname)
+    RawParagraphView RawParagraphView::from_raw_paragraph(const RawParagraph& paragraph)
     {
-        auto it = fields->find(fieldname);
-        if (it == fields->end())
+        RawParagraphView view;
+        view.fields.reserve(paragraph.size());
+        for (auto&& field : paragraph)
         {
-            return nullopt;
+            view.fields.emplace_back(field.first, field.second);
         }
+        return view;
+    }
 
-        const std::string value = std::move(it->second);
-        fields->erase(it);
-        return value;
+    const std::string_view* RawParagraphView::find(std::string_view fieldname) const
+    {
+        for (auto&& field : fields)
+        {
+            if (field.first == fieldname) return &field.second;
+        }
+        return nullptr;
     }
 
-    void ParagraphParser::required_field(const std::string& fieldname, std::string& out)
+    RawParagraph RawParagraphView::to_raw_paragraph() const
     {
-        auto maybe_field = remove_field(&fields, fieldname);
-        if (const auto field = maybe_field.get())
-            out = std::move(*field);
+        RawParagraph paragraph;
+        for (auto&& field : fields)
+        {
+            paragraph.emplace(field.first, field.second);
+        }
+        return paragraph;
+    }
+
+    ParagraphParser::ParagraphParser(const RawParagraphView& paragraph, const FieldTable& table) : table(table)
+    {
+        for (auto&& field : paragraph.fields)
+        {
+            const size_t index = table.index_of(field.first);
+            if (index == FieldTable::npos || (present & (uint32_t(1) << index)))
+            {
+                extra_fields.emplace_back(field.first);
+                continue;
+            }
+            values[index] = field.second;
+            present |= uint32_t(1) << index;
+        }
+    }
+
+    void ParagraphParser::required_field(size_t field, std::string& out)
+    {
+        taken |= uint32_t(1) << field;
+        if (present & (uint32_t(1) << field))
+            out.assign(values[field].data(), values[field].size());
         else
-            missing_fields.push_back(fieldname);
+            missing_fields.emplace_back(table.name(field));
+    }
+    std::string ParagraphParser::optional_field(size_t field) const
+    {
+        return std::string(optional_field_view(field));
     }
-    std::string ParagraphParser::optional_field(const std::string& fieldname) const
+    std::string_view ParagraphParser::optional_field_view(size_t field) const
     {
-        return remove_field(&fields, fieldname).value_or("");
+        taken |= uint32_t(1) << field;
+        return values[field];
     }
     std::unique_ptr<ParseControlErrorInfo> ParagraphParser::error_info(const std::string& name) const
     {
-        if (!fields.empty() || !missing_fields.empty())
+        // Fields the table knows but nothing asked for, like Default-Features on a feature's paragraph, are extra too
+        std::vector<std::string> extra = extra_fields;
+        for (size_t field = 0; field < table.size(); ++field)
+        {
+            if ((present & ~taken) & (uint32_t(1) << field)) extra.emplace_back(table.name(field));
+        }
+
+        if (!extra.empty() || !missing_fields.empty())
         {
             auto err = std::make_unique<ParseControlErrorInfo>();
             err->name = name;
-            err->extra_fields = Util::extract_keys(fields);
-            err->missing_fields = std::move(missing_fields);
+            err->extra_fields = std::move(extra);
+            err->missing_fields = missing_fields;
             return err;
         }
         return nullptr;
     }
 
-    std::vector<std::string> parse_comma_list(const std::string& str)
+    std::vector<std::string> parse_comma_list(std::string_view str)
+    {
+        return Util::fmap(split_comma_list(str), [](std::string_view element) { return std::string(element); });
+    }
+
+    std::vector<std::string_view> split_comma_list(std::string_view str)
     {
         if (str.empty())
         {
             return {};
         }
 
-        std::vector<std::string> out;
+        std::vector<std::string_view> out;
 
         size_t cur = 0;
         do
         {
             auto pos = str.find(',', cur);
-            if (pos == std::string::npos)
+            if (pos == std::string_view::npos)
             {
                 out.push_back(str.substr(cur));
                 break;
@@ -67,13 +115,13 @@ namespace vcpkg::Parse
 
             // skip comma and space
             ++pos;
-            if (str[pos] == ' ')
+            if (pos < str.size() && str[pos] == ' ')
             {
                 ++pos;
             }
 
             cur = pos;
-        } while (cur != std::string::npos);
+        } while (cur != std::string_view::npos);
 
         return out;
     }
@@ -0,0 +1,331 @@
+#include "pch.h"
+
+#include <vcpkg/base/checks.h>
+#include <vcpkg/base/hash.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/util.h>
+#include <vcpkg/build.h>
+#include <vcpkg/commands.h>
+#include <vcpkg/paragraphs.h>
+#include <vcpkg/parse.h>
+#include <vcpkg/planfile.h>
+#include <vcpkg/sourceparagraph.h>
+
+namespace vcpkg::PlanFile
+{
+    using Dependencies::AnyAction;
+    using Dependencies::InstallPlanAction;
+    using Dependencies::InstallPlanType;
+    using Dependencies::RemovePlanAction;
+    using Dependencies::RemovePlanType;
+    using Dependencies::RequestType;
+
+    static constexpr StringLiteral PLAN_VERSION = "1";
+
+    namespace HeaderFields
+    {
+        static constexpr std::string_view NAMES[] = {
+            "Plan-Version",
+            "Vcpkg-Version",
+            "Ports-Hash",
+            "Status-Hash",
+        };
+        static constexpr Parse::FieldTable TABLE = NAMES;
+
+        static constexpr size_t PLAN_VERSION = TABLE.id("Plan-Version");
+        static constexpr size_t VCPKG_VERSION = TABLE.id("Vcpkg-Version");
+        static constexpr size_t PORTS_HASH = TABLE.id("Ports-Hash");
+        static constexpr size_t STATUS_HASH = TABLE.id("Status-Hash");
+    }
+
+    namespace ActionFields
+    {
+        static constexpr std::string_view NAMES[] = {
+            "Package",
+            "Triplet",
+            "Type",
+            "Request",
+            "Features",
+            "Depends",
+            "Abi",
+            "Abi-Info",
+        };
+        static constexpr Parse::FieldTable TABLE = NAMES;
+
+        static constexpr size_t PACKAGE = TABLE.id("Package");
+        static constexpr size_t TRIPLET = TABLE.id("Triplet");
+        static constexpr size_t TYPE = TABLE.id("Type");
+        static constexpr size_t REQUEST = TABLE.id("Request");
+        static constexpr size_t FEATURES = TABLE.id("Features");
+        static constexpr size_t DEPENDS = TABLE.id("Depends");
+        static constexpr size_t ABI = TABLE.id("Abi");
+        static constexpr size_t ABI_INFO = TABLE.id("Abi-Info");
+    }
+
+    static constexpr StringLiteral TYPE_BUILD = "build";
+    static constexpr StringLiteral TYPE_ALREADY_INSTALLED = "already-installed";
+    static constexpr StringLiteral TYPE_REMOVE = "remove";
+
+    static constexpr StringLiteral REQUEST_USER = "user";
+    static constexpr StringLiteral REQUEST_AUTO = "auto";
+
+    static const char* to_string(const RequestType request_type)
+    {
+        return request_type == RequestType::USER_REQUESTED ? REQUEST_USER.c_str() : REQUEST_AUTO.c_str();
+    }
+
+    /// <summary>
+    /// The hash of the installed packages. The paragraphs of removed packages are left out, and the rest are sorted,
+    /// so that installed trees with the same packages match however they came about.
+    /// </summary>
+    static std::string hash_status_db(const StatusParagraphs& status_db)
+    {
+        std::vector<std::string> installed;
+        for (auto&& pgh : status_db)
+        {
+            if (!pgh->is_installed()) continue;
+            installed.emplace_back();
+            serialize(*pgh, installed.back());
+        }
+        Util::sort(installed);
+        return vcpkg::Hash::get_string_hash(Strings::join("\n", installed), "SHA1");
+    }
+
+    /// <summary>
+    /// The hash of what the ABI tags in the plan were computed from and the build actions were planned with: the files
+    /// of the ports it builds and of the triplets it builds them for.
+    /// </summary>
+    static std::string hash_ports(const VcpkgPaths& paths, const std::vector<AnyAction>& action_plan)
+    {
+        auto& fs = paths.get_filesystem();
+
+        std::set<std::string> ports;
+        std::set<std::string> triplets;
+        for (auto&& action : action_plan)
+        {
+            const auto p_install = action.install_action.get();
+            if (!p_install || p_install->plan_type != InstallPlanType::BUILD_AND_INSTALL) continue;
+            ports.insert(p_install->spec.name());
+            triplets.insert(p_install->spec.triplet().canonical_name());
+        }
+
+        std::string text;
+        for (auto&& port : ports)
+        {
+            Strings::append_to(text, "port %s %s\n", port, Build::hash_port_files(fs, paths.port_dir(port)));
+        }
+        for (auto&& triplet : triplets)
+        {
+            const fs::path triplet_file = paths.triplets / (triplet + ".cmake");
+            Strings::append_to(text, "triplet %s %s\n", triplet, vcpkg::Hash::get_file_hash(fs, triplet_file, "SHA1"));
+        }
+        return vcpkg::Hash::get_string_hash(text, "SHA1");
+    }
+
+    void write(const VcpkgPaths& paths,
+               const StatusParagraphs& status_db,
+               const std::vector<AnyAction>& action_plan,
+               const fs::path& path)
+    {
+        std::string out = Strings::format("Plan-Version: %s\nVcpkg-Version: %s\nPorts-Hash: %s\nStatus-Hash: %s\n",
+                                          PLAN_VERSION,
+                                          Commands::Version::version(),
+                                          hash_ports(paths, action_plan),
+                                          hash_status_db(status_db));
+
+        for (auto&& action : action_plan)
+        {
+            const PackageSpec& spec = action.spec();
+            Strings::append_to(out, "\nPackage: %s\nTriplet: %s\n", spec.name(), spec.triplet());
+
+            if (auto p_remove = action.remove_action.get())
+            {
+                Strings::append_to(out, "Type: %s\nRequest: %s\n", TYPE_REMOVE, to_string(p_remove->request_type));
+                continue;
+            }
+
+            const InstallPlanAction& install = action.install_action.value_or_exit(VCPKG_LINE_INFO);
+            const bool is_build = install.plan_type == InstallPlanType::BUILD_AND_INSTALL;
+            Checks::check_exit(VCPKG_LINE_INFO, is_build || install.plan_type == InstallPlanType::ALREADY_INSTALLED);
+            Strings::append_to(out,
+                               "Type: %s\nRequest: %s\n",
+                               is_build ? TYPE_BUILD : TYPE_ALREADY_INSTALLED,
+                               to_string(install.request_type));
+            if (!install.feature_list.empty())
+            {
+                Strings::append_to(out, "Features: %s\n", Strings::join(", ", install.feature_list));
+            }
+            if (!is_build) continue;
+
+            if (!install.computed_dependencies.empty())
+            {
+                const auto depends = Strings::join(", ", install.computed_dependencies, [](const PackageSpec& dep) {
+                    return dep.to_string();
+                });
+                Strings::append_to(out, "Depends: %s\n", depends);
+            }
+
+            // The abi info continues on indented lines, one entry to a line
+            if (auto p_abi = install.planned_abi.get())
+            {
+                Strings::append_to(out, "Abi: %s\nAbi-Info:", p_abi->tag);
+                for (std::string_view line : Strings::split_view(p_abi->abi_info, "\n"))
+                {
+                    if (!line.empty()) out.append("\n    ").append(line);
+                }
+                out.push_back('\n');
+            }
+        }
+
+        auto& fs = paths.get_filesystem();
+        const fs::path tmp_path = path.u8string() + ".tmp";
+        fs.write_contents(tmp_path, out);
+        fs.rename(tmp_path, path);
+    }
+
+    static void check_fields(const Parse::ParagraphParser& parser, const fs::path& path)
+    {
+        if (const auto err = parser.error_info(path.u8string()))
+        {
+            print_error_message(err);
+            Checks::exit_fail(VCPKG_LINE_INFO);
+        }
+    }
+
+    static RequestType to_request_type(const std::string& request, const fs::path& path)
+    {
+        if (request == REQUEST_USER) return RequestType::USER_REQUESTED;
+        if (request == REQUEST_AUTO) return RequestType::AUTO_SELECTED;
+        Checks::exit_with_message(VCPKG_LINE_INFO, "Error: unknown request %s in %s", request, path.u8string());
+    }
+
+    static Build::AbiTagAndFile read_abi(std::string&& tag, std::string_view abi_info_field, const fs::path& path)
+    {
+        std::string abi_info;
+        for (std::string_view line : Strings::split_view(abi_info_field, "\n"))
+        {
+            const size_t start = line.find_first_not_of(' ');
+            if (start == std::string_view::npos) continue;
+            abi_info.append(line.substr(start)).push_back('\n');
+        }
+
+        // The tag is the hash of the abi info, which tells whether the two were kept together
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           vcpkg::Hash::get_string_hash(abi_info, "SHA1") == tag,
+                           "Error: the abi info of %s in %s does not match its tag",
+                           tag,
+                           path.u8string());
+        return Build::AbiTagAndFile{std::move(tag), std::move(abi_info)};
+    }
+
+    std::vector<AnyAction> read(const VcpkgPaths& paths,
+                                const StatusParagraphs& status_db,
+                                const Dependencies::PortFileProvider& provider,
+                                const fs::path& path)
+    {
+        const auto maybe_contents = paths.get_filesystem().read_contents(path);
+        const auto p_contents = maybe_contents.get();
+        Checks::check_exit(VCPKG_LINE_INFO, p_contents != nullptr, "Error: failed to read %s", path.u8string());
+
+        const auto maybe_paragraphs = Paragraphs::parse_paragraphs(*p_contents);
+        const auto p_paragraphs = maybe_paragraphs.get();
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           p_paragraphs != nullptr && !p_paragraphs->empty(),
+                           "Error: %s is not a plan file",
+                           path.u8string());
+
+        std::string plan_version;
+        std::string vcpkg_version;
+        std::string ports_hash;
+        std::string status_hash;
+        {
+            Parse::ParagraphParser parser(Parse::RawParagraphView::from_raw_paragraph(p_paragraphs->front()),
+                                          HeaderFields::TABLE);
+            parser.required_field(HeaderFields::PLAN_VERSION, plan_version);
+            parser.required_field(HeaderFields::VCPKG_VERSION, vcpkg_version);
+            parser.required_field(HeaderFields::PORTS_HASH, ports_hash);
+            parser.required_field(HeaderFields::STATUS_HASH, status_hash);
+            check_fields(parser, path);
+        }
+
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           plan_version == PLAN_VERSION,
+                           "Error: %s is a plan of version %s; this vcpkg reads version %s",
+                           path.u8string(),
+                           plan_version,
+                           PLAN_VERSION);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           vcpkg_version == Commands::Version::version(),
+                           "Error: the plan in %s was made by vcpkg %s. Make it again with this vcpkg.",
+                           path.u8string(),
+                           vcpkg_version);
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           status_hash == hash_status_db(status_db),
+                           "Error: the installed packages changed since the plan in %s was made. Make the plan again.",
+                           path.u8string());
+
+        std::vector<AnyAction> action_plan;
+        for (size_t i = 1; i < p_paragraphs->size(); ++i)
+        {
+            Parse::ParagraphParser parser(Parse::RawParagraphView::from_raw_paragraph((*p_paragraphs)[i]),
+                                          ActionFields::TABLE);
+            std::string name;
+            std::string triplet;
+            std::string type;
+            std::string request;
+            parser.required_field(ActionFields::PACKAGE, name);
+            parser.required_field(ActionFields::TRIPLET, triplet);
+            parser.required_field(ActionFields::TYPE, type);
+            parser.required_field(ActionFields::REQUEST, request);
+            const auto features_list = Parse::parse_comma_list(parser.optional_field_view(ActionFields::FEATURES));
+            const auto depends_list = Parse::parse_comma_list(parser.optional_field_view(ActionFields::DEPENDS));
+            std::string abi = parser.optional_field(ActionFields::ABI);
+            const std::string_view abi_info = parser.optional_field_view(ActionFields::ABI_INFO);
+            check_fields(parser, path);
+
+            const PackageSpec spec = PackageSpec::from_name_and_triplet(name, Triplet::from_canonical_name(triplet))
+                                         .value_or_exit(VCPKG_LINE_INFO);
+            const RequestType request_type = to_request_type(request, path);
+            FeatureList features;
+            for (auto&& feature : features_list)
+                features.insert(feature);
+
+            if (type == TYPE_REMOVE)
+            {
+                action_plan.emplace_back(RemovePlanAction(spec, RemovePlanType::REMOVE, request_type));
+            }
+            else if (type == TYPE_ALREADY_INSTALLED)
+            {
+                auto maybe_ipv = status_db.find_all_installed(spec);
+                auto p_ipv = maybe_ipv.get();
+                Checks::check_exit(VCPKG_LINE_INFO, p_ipv != nullptr, "Error: %s is not installed", spec);
+                action_plan.emplace_back(InstallPlanAction(std::move(*p_ipv), std::move(features), request_type));
+            }
+            else if (type == TYPE_BUILD)
+            {
+                const auto maybe_scf = provider.get_control_file(name);
+                const auto p_scf = maybe_scf.get();
+                Checks::check_exit(VCPKG_LINE_INFO, p_scf != nullptr, "Error: the port %s was not found", name);
+
+                auto dependencies = Util::fmap(depends_list, [&](const std::string& dependency) {
+                    return FullPackageSpec::from_string(dependency, spec.triplet())
+                        .value_or_exit(VCPKG_LINE_INFO)
+                        .package_spec;
+                });
+                InstallPlanAction install(spec, *p_scf, std::move(features), request_type, std::move(dependencies));
+                if (!abi.empty()) install.planned_abi = read_abi(std::move(abi), abi_info, path);
+                action_plan.emplace_back(std::move(install));
+            }
+            else
+            {
+                Checks::exit_with_message(VCPKG_LINE_INFO, "Error: unknown action %s in %s", type, path.u8string());
+            }
+        }
+
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           ports_hash == hash_ports(paths, action_plan),
+                           "Error: the ports changed since the plan in %s was made. Make the plan again.",
+                           path.u8string());
+        return action_plan;
+    }
+}
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include <vcpkg/base/checks.h>
+#include <vcpkg/base/strings.h>
 #include <vcpkg/postbuildlint.buildtype.h>
 
 using vcpkg::Build::ConfigurationType;
@@ -36,19 +37,20 @@ namespace vcpkg::PostBuildLint
 
     const Build::LinkageType& BuildType::linkage() const { return this->m_linkage; }
 
-    const std::regex& BuildType::crt_regex() const
+    bool BuildType::is_crt_directive(const std::string& directive) const
     {
-        static const std::regex REGEX_DEBUG_STATIC(R"(/DEFAULTLIB:LIBCMTD)", std::regex_constants::icase);
-        static const std::regex REGEX_DEBUG_DYNAMIC(R"(/DEFAULTLIB:MSVCRTD)", std::regex_constants::icase);
-        static const std::regex REGEX_RELEASE_STATIC(R"(/DEFAULTLIB:LIBCMT[^D])", std::regex_constants::icase);
-        static const std::regex REGEX_RELEASE_DYNAMIC(R"(/DEFAULTLIB:MSVCRT[^D])", std::regex_constants::icase);
+        static const std::string DEFAULTLIB = "/DEFAULTLIB:";
+        if (!Strings::case_insensitive_ascii_starts_with(directive, DEFAULTLIB)) return false;
+
+        std::string library = Strings::ascii_to_lowercase(directive.substr(DEFAULTLIB.size()));
+        if (Strings::ends_with(library, ".lib")) library.resize(library.size() - 4);
 
         switch (backing_enum)
         {
-            case BuildTypeC::DEBUG_STATIC: return REGEX_DEBUG_STATIC;
-            case BuildTypeC::DEBUG_DYNAMIC: return REGEX_DEBUG_DYNAMIC;
-            case BuildTypeC::RELEASE_STATIC: return REGEX_RELEASE_STATIC;
-            case BuildTypeC::RELEASE_DYNAMIC: return REGEX_RELEASE_DYNAMIC;
+            case BuildTypeC::DEBUG_STATIC: return library == "libcmtd";
+            case BuildTypeC::DEBUG_DYNAMIC: return library == "msvcrtd";
+            case BuildTypeC::RELEASE_STATIC: return library == "libcmt";
+            case BuildTypeC::RELEASE_DYNAMIC: return library == "msvcrt";
             default: Checks::unreachable(VCPKG_LINE_INFO);
         }
     }
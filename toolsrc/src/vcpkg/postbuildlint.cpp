@@ -3,9 +3,13 @@
 #include <vcpkg/base/cofffilereader.h>
 #include <vcpkg/base/files.h>
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/threadpool.h>
+#include <vcpkg/base/trace.h>
 #include <vcpkg/base/util.h>
 #include <vcpkg/build.h>
+#include <vcpkg/coffinfocache.h>
 #include <vcpkg/packagespec.h>
+#include <vcpkg/packagetreesnapshot.h>
 #include <vcpkg/postbuildlint.buildtype.h>
 #include <vcpkg/postbuildlint.h>
 #include <vcpkg/vcpkgpaths.h>
@@ -16,11 +20,6 @@ using vcpkg::Build::PreBuildInfo;
 
 namespace vcpkg::PostBuildLint
 {
-    static auto not_extension_pred(const Files::Filesystem& fs, const std::string& ext)
-    {
-        return [&fs, ext](const fs::path& path) { return fs.is_directory(path) || path.extension() != ext; };
-    }
-
     enum class LintStatus
     {
         SUCCESS = 0,
@@ -30,39 +29,33 @@ namespace vcpkg::PostBuildLint
     struct OutdatedDynamicCrt
     {
         std::string name;
-        std::regex regex;
-
-        OutdatedDynamicCrt(const std::string& name, const std::string& regex_as_string)
-            : name(name), regex(std::regex(regex_as_string, std::regex_constants::icase))
-        {
-        }
     };
 
     Span<const OutdatedDynamicCrt> get_outdated_dynamic_crts(const Optional<std::string>& toolset_version)
     {
         static const std::vector<OutdatedDynamicCrt> V_NO_120 = {
-            {"msvcp100.dll", R"(msvcp100\.dll)"},
-            {"msvcp100d.dll", R"(msvcp100d\.dll)"},
-            {"msvcp110.dll", R"(msvcp110\.dll)"},
-            {"msvcp110_win.dll", R"(msvcp110_win\.dll)"},
-            {"msvcp60.dll", R"(msvcp60\.dll)"},
-            {"msvcp60.dll", R"(msvcp60\.dll)"},
-
-            {"msvcrt.dll", R"(msvcrt\.dll)"},
-            {"msvcr100.dll", R"(msvcr100\.dll)"},
-            {"msvcr100d.dll", R"(msvcr100d\.dll)"},
-            {"msvcr100_clr0400.dll", R"(msvcr100_clr0400\.dll)"},
-            {"msvcr110.dll", R"(msvcr110\.dll)"},
-            {"msvcrt20.dll", R"(msvcrt20\.dll)"},
-            {"msvcrt40.dll", R"(msvcrt40\.dll)"},
+            {"msvcp100.dll"},
+            {"msvcp100d.dll"},
+            {"msvcp110.dll"},
+            {"msvcp110_win.dll"},
+            {"msvcp60.dll"},
+            {"msvcp60.dll"},
+
+            {"msvcrt.dll"},
+            {"msvcr100.dll"},
+            {"msvcr100d.dll"},
+            {"msvcr100_clr0400.dll"},
+            {"msvcr110.dll"},
+            {"msvcrt20.dll"},
+            {"msvcrt40.dll"},
         };
 
         static const std::vector<OutdatedDynamicCrt> V_NO_MSVCRT = [&]() {
             auto ret = V_NO_120;
-            ret.push_back({"msvcp120.dll", R"(msvcp120\.dll)"});
-            ret.push_back({"msvcp120_clr0400.dll", R"(msvcp120_clr0400\.dll)"});
-            ret.push_back({"msvcr120.dll", R"(msvcr120\.dll)"});
-            ret.push_back({"msvcr120_clr0400.dll", R"(msvcr120_clr0400\.dll)"});
+            ret.push_back({"msvcp120.dll"});
+            ret.push_back({"msvcp120_clr0400.dll"});
+            ret.push_back({"msvcr120.dll"});
+            ret.push_back({"msvcr120_clr0400.dll"});
             return ret;
         }();
 
@@ -76,17 +69,15 @@ namespace vcpkg::PostBuildLint
         return V_NO_MSVCRT;
     }
 
-    static LintStatus check_for_files_in_include_directory(const Files::Filesystem& fs,
-                                                           const Build::BuildPolicies& policies,
-                                                           const fs::path& package_dir)
+    static LintStatus check_for_files_in_include_directory(const PackageTreeSnapshot& tree,
+                                                           const Build::BuildPolicies& policies)
     {
         if (policies.is_enabled(BuildPolicy::EMPTY_INCLUDE_FOLDER))
         {
             return LintStatus::SUCCESS;
         }
 
-        const fs::path include_dir = package_dir / "include";
-        if (!fs.exists(include_dir) || fs.is_empty(include_dir))
+        if (!tree.has_entries_below("include"))
         {
             System::println(
                 System::Color::warning,
@@ -97,15 +88,11 @@ namespace vcpkg::PostBuildLint
         return LintStatus::SUCCESS;
     }
 
-    static LintStatus check_for_files_in_debug_include_directory(const Files::Filesystem& fs,
-                                                                 const fs::path& package_dir)
+    static LintStatus check_for_files_in_debug_include_directory(const PackageTreeSnapshot& tree)
     {
-        const fs::path debug_include_dir = package_dir / "debug" / "include";
-
-        std::vector<fs::path> files_found = fs.get_files_recursive(debug_include_dir);
+        std::vector<fs::path> files_found = tree.files_below("debug/include");
 
-        Util::erase_remove_if(
-            files_found, [&fs](const fs::path& path) { return fs.is_directory(path) || path.extension() == ".ifc"; });
+        Util::erase_remove_if(files_found, [](const fs::path& path) { return path.extension() == ".ifc"; });
 
         if (!files_found.empty())
         {
@@ -119,11 +106,9 @@ namespace vcpkg::PostBuildLint
         return LintStatus::SUCCESS;
     }
 
-    static LintStatus check_for_files_in_debug_share_directory(const Files::Filesystem& fs, const fs::path& package_dir)
+    static LintStatus check_for_files_in_debug_share_directory(const PackageTreeSnapshot& tree)
     {
-        const fs::path debug_share = package_dir / "debug" / "share";
-
-        if (fs.exists(debug_share))
+        if (tree.contains("debug/share"))
         {
             System::println(System::Color::warning,
                             "/debug/share should not exist. Please reorganize any important files, then use\n"
@@ -134,12 +119,9 @@ namespace vcpkg::PostBuildLint
         return LintStatus::SUCCESS;
     }
 
-    static LintStatus check_folder_lib_cmake(const Files::Filesystem& fs,
-                                             const fs::path& package_dir,
-                                             const PackageSpec& spec)
+    static LintStatus check_folder_lib_cmake(const PackageTreeSnapshot& tree, const PackageSpec& spec)
     {
-        const fs::path lib_cmake = package_dir / "lib" / "cmake";
-        if (fs.exists(lib_cmake))
+        if (tree.contains("lib/cmake"))
         {
             System::println(
                 System::Color::warning,
@@ -151,26 +133,15 @@ namespace vcpkg::PostBuildLint
         return LintStatus::SUCCESS;
     }
 
-    static LintStatus check_for_misplaced_cmake_files(const Files::Filesystem& fs,
-                                                      const fs::path& package_dir,
-                                                      const PackageSpec& spec)
+    static LintStatus check_for_misplaced_cmake_files(const PackageTreeSnapshot& tree, const PackageSpec& spec)
     {
-        std::vector<fs::path> dirs = {
-            package_dir / "cmake",
-            package_dir / "debug" / "cmake",
-            package_dir / "lib" / "cmake",
-            package_dir / "debug" / "lib" / "cmake",
-        };
+        static const std::array<std::string, 4> DIRS = {"cmake", "debug/cmake", "lib/cmake", "debug/lib/cmake"};
 
         std::vector<fs::path> misplaced_cmake_files;
-        for (auto&& dir : dirs)
+        for (auto&& dir : DIRS)
         {
-            auto files = fs.get_files_recursive(dir);
-            for (auto&& file : files)
-            {
-                if (!fs.is_directory(file) && file.extension() == ".cmake")
-                    misplaced_cmake_files.push_back(std::move(file));
-            }
+            auto files = tree.files_below(dir, ".cmake");
+            misplaced_cmake_files.insert(misplaced_cmake_files.end(), files.begin(), files.end());
         }
 
         if (!misplaced_cmake_files.empty())
@@ -187,12 +158,9 @@ namespace vcpkg::PostBuildLint
         return LintStatus::SUCCESS;
     }
 
-    static LintStatus check_folder_debug_lib_cmake(const Files::Filesystem& fs,
-                                                   const fs::path& package_dir,
-                                                   const PackageSpec& spec)
+    static LintStatus check_folder_debug_lib_cmake(const PackageTreeSnapshot& tree, const PackageSpec& spec)
     {
-        const fs::path lib_cmake_debug = package_dir / "debug" / "lib" / "cmake";
-        if (fs.exists(lib_cmake_debug))
+        if (tree.contains("debug/lib/cmake"))
         {
             System::println(System::Color::warning,
                             "The /debug/lib/cmake folder should be merged with /lib/cmake into /share/%s",
@@ -203,10 +171,9 @@ namespace vcpkg::PostBuildLint
         return LintStatus::SUCCESS;
     }
 
-    static LintStatus check_for_dlls_in_lib_dir(const Files::Filesystem& fs, const fs::path& package_dir)
+    static LintStatus check_for_dlls_in_lib_dir(const PackageTreeSnapshot& tree, const std::string& lib_dir)
     {
-        std::vector<fs::path> dlls = fs.get_files_recursive(package_dir / "lib");
-        Util::erase_remove_if(dlls, not_extension_pred(fs, ".dll"));
+        std::vector<fs::path> dlls = tree.files_below(lib_dir, ".dll");
 
         if (!dlls.empty())
         {
@@ -221,12 +188,11 @@ namespace vcpkg::PostBuildLint
     }
 
     static LintStatus check_for_copyright_file(const Files::Filesystem& fs,
+                                               const PackageTreeSnapshot& tree,
                                                const PackageSpec& spec,
                                                const VcpkgPaths& paths)
     {
-        const fs::path packages_dir = paths.packages / spec.dir();
-        const fs::path copyright_file = packages_dir / "share" / spec.name() / "copyright";
-        if (fs.exists(copyright_file))
+        if (tree.contains(Strings::format("share/%s/copyright", spec.name())))
         {
             return LintStatus::SUCCESS;
         }
@@ -277,10 +243,9 @@ namespace vcpkg::PostBuildLint
         return LintStatus::ERROR_DETECTED;
     }
 
-    static LintStatus check_for_exes(const Files::Filesystem& fs, const fs::path& package_dir)
+    static LintStatus check_for_exes(const PackageTreeSnapshot& tree, const std::string& bin_dir)
     {
-        std::vector<fs::path> exes = fs.get_files_recursive(package_dir / "bin");
-        Util::erase_remove_if(exes, not_extension_pred(fs, ".exe"));
+        std::vector<fs::path> exes = tree.files_below(bin_dir, ".exe");
 
         if (!exes.empty())
         {
@@ -294,19 +259,59 @@ namespace vcpkg::PostBuildLint
         return LintStatus::SUCCESS;
     }
 
-    static LintStatus check_exports_of_dlls(const std::vector<fs::path>& dlls, const fs::path& dumpbin_exe)
+#if defined(_WIN32)
+    struct FileAndDllInfo
+    {
+        fs::path file;
+        CoffFileReader::DllInfo info;
+    };
+
+    struct FileAndLibInfo
+    {
+        fs::path file;
+        CoffFileReader::LibInfo info;
+    };
+
+    /// <summary>
+    /// Every DLL and LIB is read once and all checks work on the result, instead of running dumpbin once per check.
+    /// The files are independent, so they are read on several threads; the results keep the order of the input, which
+    /// keeps the output of the checks the same from run to run. Binaries read before, in any package, are not read
+    /// again.
+    /// </summary>
+    static std::vector<FileAndDllInfo> read_dll_infos(const VcpkgPaths& paths, const std::vector<fs::path>& dlls)
+    {
+        std::vector<FileAndDllInfo> ret(dlls.size());
+        ThreadPool::parallel_for(dlls.size(), [&](size_t i) {
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               dlls[i].extension() == ".dll",
+                               "The file extension was not .dll: %s",
+                               dlls[i].generic_string());
+            ret[i] = {dlls[i], CoffInfoCache::read_dll(paths, dlls[i])};
+        });
+        return ret;
+    }
+
+    static std::vector<FileAndLibInfo> read_lib_infos(const VcpkgPaths& paths, const std::vector<fs::path>& libs)
+    {
+        std::vector<FileAndLibInfo> ret(libs.size());
+        ThreadPool::parallel_for(libs.size(), [&](size_t i) {
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               libs[i].extension() == ".lib",
+                               "The file extension was not .lib: %s",
+                               libs[i].generic_string());
+            ret[i] = {libs[i], CoffInfoCache::read_lib(paths, libs[i])};
+        });
+        return ret;
+    }
+
+    static LintStatus check_exports_of_dlls(const std::vector<FileAndDllInfo>& dlls)
     {
         std::vector<fs::path> dlls_with_no_exports;
-        for (const fs::path& dll : dlls)
+        for (const FileAndDllInfo& dll : dlls)
         {
-            const std::string cmd_line =
-                Strings::format(R"("%s" /exports "%s")", dumpbin_exe.u8string(), dll.u8string());
-            System::ExitCodeAndOutput ec_data = System::cmd_execute_and_capture_output(cmd_line);
-            Checks::check_exit(VCPKG_LINE_INFO, ec_data.exit_code == 0, "Running command:\n   %s\n failed", cmd_line);
-
-            if (ec_data.output.find("ordinal hint RVA      name") == std::string::npos)
+            if (dll.info.export_count == 0)
             {
-                dlls_with_no_exports.push_back(dll);
+                dlls_with_no_exports.push_back(dll.file);
             }
         }
 
@@ -322,8 +327,7 @@ namespace vcpkg::PostBuildLint
     }
 
     static LintStatus check_uwp_bit_of_dlls(const std::string& expected_system_name,
-                                            const std::vector<fs::path>& dlls,
-                                            const fs::path dumpbin_exe)
+                                            const std::vector<FileAndDllInfo>& dlls)
     {
         if (expected_system_name != "WindowsStore")
         {
@@ -331,16 +335,11 @@ namespace vcpkg::PostBuildLint
         }
 
         std::vector<fs::path> dlls_with_improper_uwp_bit;
-        for (const fs::path& dll : dlls)
+        for (const FileAndDllInfo& dll : dlls)
         {
-            const std::string cmd_line =
-                Strings::format(R"("%s" /headers "%s")", dumpbin_exe.u8string(), dll.u8string());
-            System::ExitCodeAndOutput ec_data = System::cmd_execute_and_capture_output(cmd_line);
-            Checks::check_exit(VCPKG_LINE_INFO, ec_data.exit_code == 0, "Running command:\n   %s\n failed", cmd_line);
-
-            if (ec_data.output.find("App Container") == std::string::npos)
+            if (!dll.info.is_app_container)
             {
-                dlls_with_improper_uwp_bit.push_back(dll);
+                dlls_with_improper_uwp_bit.push_back(dll.file);
             }
         }
 
@@ -354,6 +353,7 @@ namespace vcpkg::PostBuildLint
 
         return LintStatus::SUCCESS;
     }
+#endif
 
     struct FileAndArch
     {
@@ -392,22 +392,17 @@ namespace vcpkg::PostBuildLint
     }
 
     static LintStatus check_dll_architecture(const std::string& expected_architecture,
-                                             const std::vector<fs::path>& files)
+                                             const std::vector<FileAndDllInfo>& files)
     {
         std::vector<FileAndArch> binaries_with_invalid_architecture;
 
-        for (const fs::path& file : files)
+        for (const FileAndDllInfo& file : files)
         {
-            Checks::check_exit(VCPKG_LINE_INFO,
-                               file.extension() == ".dll",
-                               "The file extension was not .dll: %s",
-                               file.generic_string());
-            const CoffFileReader::DllInfo info = CoffFileReader::read_dll(file);
-            const std::string actual_architecture = get_actual_architecture(info.machine_type);
+            const std::string actual_architecture = get_actual_architecture(file.info.machine_type);
 
             if (expected_architecture != actual_architecture)
             {
-                binaries_with_invalid_architecture.push_back({file, actual_architecture});
+                binaries_with_invalid_architecture.push_back({file.file, actual_architecture});
             }
         }
 
@@ -419,21 +414,15 @@ namespace vcpkg::PostBuildLint
 
         return LintStatus::SUCCESS;
     }
-#endif
 
     static LintStatus check_lib_architecture(const std::string& expected_architecture,
-                                             const std::vector<fs::path>& files)
+                                             const std::vector<FileAndLibInfo>& files)
     {
-#if defined(_WIN32)
         std::vector<FileAndArch> binaries_with_invalid_architecture;
 
-        for (const fs::path& file : files)
+        for (const FileAndLibInfo& file : files)
         {
-            Checks::check_exit(VCPKG_LINE_INFO,
-                               file.extension() == ".lib",
-                               "The file extension was not .lib: %s",
-                               file.generic_string());
-            CoffFileReader::LibInfo info = CoffFileReader::read_lib(file);
+            const CoffFileReader::LibInfo& info = file.info;
 
             // This is zero for folly's debug library
             // TODO: Why?
@@ -442,12 +431,12 @@ namespace vcpkg::PostBuildLint
             Checks::check_exit(VCPKG_LINE_INFO,
                                info.machine_types.size() == 1,
                                "Found more than 1 architecture in file %s",
-                               file.generic_string());
+                               file.file.generic_string());
 
             const std::string actual_architecture = get_actual_architecture(info.machine_types.at(0));
             if (expected_architecture != actual_architecture)
             {
-                binaries_with_invalid_architecture.push_back({file, actual_architecture});
+                binaries_with_invalid_architecture.push_back({file.file, actual_architecture});
             }
         }
 
@@ -456,10 +445,10 @@ namespace vcpkg::PostBuildLint
             print_invalid_architecture_files(expected_architecture, binaries_with_invalid_architecture);
             return LintStatus::ERROR_DETECTED;
         }
-#endif
 
         return LintStatus::SUCCESS;
     }
+#endif
 
     static LintStatus check_no_dlls_present(const std::vector<fs::path>& dlls)
     {
@@ -528,25 +517,27 @@ namespace vcpkg::PostBuildLint
         return LintStatus::SUCCESS;
     }
 
-    static LintStatus check_bin_folders_are_not_present_in_static_build(const Files::Filesystem& fs,
+    static LintStatus check_bin_folders_are_not_present_in_static_build(const PackageTreeSnapshot& tree,
                                                                         const fs::path& package_dir)
     {
         const fs::path bin = package_dir / "bin";
         const fs::path debug_bin = package_dir / "debug" / "bin";
+        const bool has_bin = tree.contains("bin");
+        const bool has_debug_bin = tree.contains("debug/bin");
 
-        if (!fs.exists(bin) && !fs.exists(debug_bin))
+        if (!has_bin && !has_debug_bin)
         {
             return LintStatus::SUCCESS;
         }
 
-        if (fs.exists(bin))
+        if (has_bin)
         {
             System::println(System::Color::warning,
                             R"(There should be no bin\ directory in a static build, but %s is present.)",
                             bin.u8string());
         }
 
-        if (fs.exists(debug_bin))
+        if (has_debug_bin)
         {
             System::println(System::Color::warning,
                             R"(There should be no debug\bin\ directory in a static build, but %s is present.)",
@@ -568,13 +559,9 @@ namespace vcpkg::PostBuildLint
         return LintStatus::ERROR_DETECTED;
     }
 
-    static LintStatus check_no_empty_folders(const Files::Filesystem& fs, const fs::path& dir)
+    static LintStatus check_no_empty_folders(const PackageTreeSnapshot& tree, const fs::path& dir)
     {
-        std::vector<fs::path> empty_directories = fs.get_files_recursive(dir);
-
-        Util::erase_remove_if(empty_directories, [&fs](const fs::path& current) {
-            return !fs.is_directory(current) || !fs.is_empty(current);
-        });
+        const std::vector<fs::path> empty_directories = tree.empty_directories();
 
         if (!empty_directories.empty())
         {
@@ -602,9 +589,9 @@ namespace vcpkg::PostBuildLint
         BuildType build_type;
     };
 
+#if defined(_WIN32)
     static LintStatus check_crt_linkage_of_libs(const BuildType& expected_build_type,
-                                                const std::vector<fs::path>& libs,
-                                                const fs::path dumpbin_exe)
+                                                const std::vector<FileAndLibInfo>& libs)
     {
         std::vector<BuildType> bad_build_types(BuildTypeC::VALUES.cbegin(), BuildTypeC::VALUES.cend());
         bad_build_types.erase(std::remove(bad_build_types.begin(), bad_build_types.end(), expected_build_type),
@@ -612,22 +599,15 @@ namespace vcpkg::PostBuildLint
 
         std::vector<BuildTypeAndFile> libs_with_invalid_crt;
 
-        for (const fs::path& lib : libs)
+        for (const FileAndLibInfo& lib : libs)
         {
-            const std::string cmd_line =
-                Strings::format(R"("%s" /directives "%s")", dumpbin_exe.u8string(), lib.u8string());
-            System::ExitCodeAndOutput ec_data = System::cmd_execute_and_capture_output(cmd_line);
-            Checks::check_exit(VCPKG_LINE_INFO,
-                               ec_data.exit_code == 0,
-                               "Running command:\n   %s\n failed with message:\n%s",
-                               cmd_line,
-                               ec_data.output);
-
             for (const BuildType& bad_build_type : bad_build_types)
             {
-                if (std::regex_search(ec_data.output.cbegin(), ec_data.output.cend(), bad_build_type.crt_regex()))
+                if (std::any_of(lib.info.linker_directives.begin(),
+                                lib.info.linker_directives.end(),
+                                [&](const std::string& directive) { return bad_build_type.is_crt_directive(directive); }))
                 {
-                    libs_with_invalid_crt.push_back({lib, bad_build_type});
+                    libs_with_invalid_crt.push_back({lib.file, bad_build_type});
                     break;
                 }
             }
@@ -659,28 +639,28 @@ namespace vcpkg::PostBuildLint
         OutdatedDynamicCrt outdated_crt;
     };
 
-    static LintStatus check_outdated_crt_linkage_of_dlls(const std::vector<fs::path>& dlls,
-                                                         const fs::path dumpbin_exe,
+    static LintStatus check_outdated_crt_linkage_of_dlls(const std::vector<FileAndDllInfo>& dlls,
                                                          const BuildInfo& build_info,
                                                          const PreBuildInfo& pre_build_info)
     {
         if (build_info.policies.is_enabled(BuildPolicy::ALLOW_OBSOLETE_MSVCRT)) return LintStatus::SUCCESS;
 
         std::vector<OutdatedDynamicCrtAndFile> dlls_with_outdated_crt;
-
-        for (const fs::path& dll : dlls)
-        {
-            const auto cmd_line = Strings::format(R"("%s" /dependents "%s")", dumpbin_exe.u8string(), dll.u8string());
-            System::ExitCodeAndOutput ec_data = System::cmd_execute_and_capture_output(cmd_line);
-            Checks::check_exit(VCPKG_LINE_INFO, ec_data.exit_code == 0, "Running command:\n   %s\n failed", cmd_line);
-
-            for (const OutdatedDynamicCrt& outdated_crt : get_outdated_dynamic_crts(pre_build_info.platform_toolset))
+        const auto outdated_crts = get_outdated_dynamic_crts(pre_build_info.platform_toolset);
+
+        for (const FileAndDllInfo& dll : dlls)
+        {
+            const auto matches = [](const OutdatedDynamicCrt& outdated_crt, const std::string& dependency) {
+                return Strings::case_insensitive_ascii_equals(dependency, outdated_crt.name);
+            };
+            const auto it = std::find_first_of(outdated_crts.begin(),
+                                               outdated_crts.end(),
+                                               dll.info.dependencies.begin(),
+                                               dll.info.dependencies.end(),
+                                               matches);
+            if (it != outdated_crts.end())
             {
-                if (std::regex_search(ec_data.output.cbegin(), ec_data.output.cend(), outdated_crt.regex))
-                {
-                    dlls_with_outdated_crt.push_back({dll, outdated_crt});
-                    break;
-                }
+                dlls_with_outdated_crt.push_back({dll.file, *it});
             }
         }
 
@@ -701,19 +681,17 @@ namespace vcpkg::PostBuildLint
 
         return LintStatus::SUCCESS;
     }
+#endif
 
-    static LintStatus check_no_files_in_dir(const Files::Filesystem& fs, const fs::path& dir)
+    static LintStatus check_no_files_in_dir(const PackageTreeSnapshot& tree,
+                                            const fs::path& dir,
+                                            const std::string& relative_dir)
     {
-        std::vector<fs::path> misplaced_files = fs.get_files_non_recursive(dir);
-        Util::erase_remove_if(misplaced_files, [&fs](const fs::path& path) {
+        std::vector<fs::path> misplaced_files = tree.files_in(relative_dir);
+        Util::erase_remove_if(misplaced_files, [](const fs::path& path) {
             const std::string filename = path.filename().generic_string();
-            if (Strings::case_insensitive_ascii_equals(filename.c_str(), "CONTROL") ||
-                Strings::case_insensitive_ascii_equals(filename.c_str(), "BUILD_INFO"))
-            {
-                return true;
-            }
-
-            return fs.is_directory(path);
+            return Strings::case_insensitive_ascii_equals(filename.c_str(), "CONTROL") ||
+                   Strings::case_insensitive_ascii_equals(filename.c_str(), "BUILD_INFO");
         });
 
         if (!misplaced_files.empty())
@@ -736,8 +714,6 @@ namespace vcpkg::PostBuildLint
     {
         const auto& fs = paths.get_filesystem();
 
-        // for dumpbin
-        const Toolset& toolset = paths.get_toolset(pre_build_info);
         const fs::path package_dir = paths.package_dir(spec);
 
         size_t error_count = 0;
@@ -747,43 +723,49 @@ namespace vcpkg::PostBuildLint
             return error_count;
         }
 
-        error_count += check_for_files_in_include_directory(fs, build_info.policies, package_dir);
-        error_count += check_for_files_in_debug_include_directory(fs, package_dir);
-        error_count += check_for_files_in_debug_share_directory(fs, package_dir);
-        error_count += check_folder_lib_cmake(fs, package_dir, spec);
-        error_count += check_for_misplaced_cmake_files(fs, package_dir, spec);
-        error_count += check_folder_debug_lib_cmake(fs, package_dir, spec);
-        error_count += check_for_dlls_in_lib_dir(fs, package_dir);
-        error_count += check_for_dlls_in_lib_dir(fs, package_dir / "debug");
-        error_count += check_for_copyright_file(fs, spec, paths);
-        error_count += check_for_exes(fs, package_dir);
-        error_count += check_for_exes(fs, package_dir / "debug");
+        const PackageTreeSnapshot tree = PackageTreeSnapshot::create(fs, package_dir);
+
+        // Release-only builds never configure Debug, so nothing under debug/ is checked for them
+        const auto p_build_type = pre_build_info.build_type.get();
+        const bool builds_debug = !p_build_type || *p_build_type == Build::ConfigurationType::DEBUG;
+
+        error_count += check_for_files_in_include_directory(tree, build_info.policies);
+        if (builds_debug) error_count += check_for_files_in_debug_include_directory(tree);
+        if (builds_debug) error_count += check_for_files_in_debug_share_directory(tree);
+        error_count += check_folder_lib_cmake(tree, spec);
+        error_count += check_for_misplaced_cmake_files(tree, spec);
+        if (builds_debug) error_count += check_folder_debug_lib_cmake(tree, spec);
+        error_count += check_for_dlls_in_lib_dir(tree, "lib");
+        if (builds_debug) error_count += check_for_dlls_in_lib_dir(tree, "debug/lib");
+        error_count += check_for_copyright_file(fs, tree, spec, paths);
+        error_count += check_for_exes(tree, "bin");
+        if (builds_debug) error_count += check_for_exes(tree, "debug/bin");
 
         const fs::path debug_lib_dir = package_dir / "debug" / "lib";
         const fs::path release_lib_dir = package_dir / "lib";
-        const fs::path debug_bin_dir = package_dir / "debug" / "bin";
-        const fs::path release_bin_dir = package_dir / "bin";
 
-        std::vector<fs::path> debug_libs = fs.get_files_recursive(debug_lib_dir);
-        Util::erase_remove_if(debug_libs, not_extension_pred(fs, ".lib"));
-        std::vector<fs::path> release_libs = fs.get_files_recursive(release_lib_dir);
-        Util::erase_remove_if(release_libs, not_extension_pred(fs, ".lib"));
+        std::vector<fs::path> debug_libs;
+        if (builds_debug) debug_libs = tree.files_below("debug/lib", ".lib");
+        std::vector<fs::path> release_libs = tree.files_below("lib", ".lib");
 
         if (!pre_build_info.build_type)
             error_count += check_matching_debug_and_release_binaries(debug_libs, release_libs);
 
+#if defined(_WIN32)
+        const std::vector<FileAndLibInfo> debug_lib_infos = read_lib_infos(paths, debug_libs);
+        const std::vector<FileAndLibInfo> release_lib_infos = read_lib_infos(paths, release_libs);
         {
-            std::vector<fs::path> libs;
-            libs.insert(libs.cend(), debug_libs.cbegin(), debug_libs.cend());
-            libs.insert(libs.cend(), release_libs.cbegin(), release_libs.cend());
+            std::vector<FileAndLibInfo> libs;
+            libs.insert(libs.cend(), debug_lib_infos.cbegin(), debug_lib_infos.cend());
+            libs.insert(libs.cend(), release_lib_infos.cbegin(), release_lib_infos.cend());
 
             error_count += check_lib_architecture(pre_build_info.target_architecture, libs);
         }
+#endif
 
-        std::vector<fs::path> debug_dlls = fs.get_files_recursive(debug_bin_dir);
-        Util::erase_remove_if(debug_dlls, not_extension_pred(fs, ".dll"));
-        std::vector<fs::path> release_dlls = fs.get_files_recursive(release_bin_dir);
-        Util::erase_remove_if(release_dlls, not_extension_pred(fs, ".dll"));
+        std::vector<fs::path> debug_dlls;
+        if (builds_debug) debug_dlls = tree.files_below("debug/bin", ".dll");
+        std::vector<fs::path> release_dlls = tree.files_below("bin", ".dll");
 
         switch (build_info.library_linkage)
         {
@@ -792,25 +774,24 @@ namespace vcpkg::PostBuildLint
                 if (!pre_build_info.build_type)
                     error_count += check_matching_debug_and_release_binaries(debug_dlls, release_dlls);
 
-                error_count += check_lib_files_are_available_if_dlls_are_available(
-                    build_info.policies, debug_libs.size(), debug_dlls.size(), debug_lib_dir);
+                if (builds_debug)
+                {
+                    error_count += check_lib_files_are_available_if_dlls_are_available(
+                        build_info.policies, debug_libs.size(), debug_dlls.size(), debug_lib_dir);
+                }
                 error_count += check_lib_files_are_available_if_dlls_are_available(
                     build_info.policies, release_libs.size(), release_dlls.size(), release_lib_dir);
 
+#if defined(_WIN32)
                 std::vector<fs::path> dlls;
                 dlls.insert(dlls.cend(), debug_dlls.cbegin(), debug_dlls.cend());
                 dlls.insert(dlls.cend(), release_dlls.cbegin(), release_dlls.cend());
+                const std::vector<FileAndDllInfo> dll_infos = read_dll_infos(paths, dlls);
 
-                if (!toolset.dumpbin.empty())
-                {
-                    error_count += check_exports_of_dlls(dlls, toolset.dumpbin);
-                    error_count += check_uwp_bit_of_dlls(pre_build_info.cmake_system_name, dlls, toolset.dumpbin);
-                    error_count +=
-                        check_outdated_crt_linkage_of_dlls(dlls, toolset.dumpbin, build_info, pre_build_info);
-                }
-
-#if defined(_WIN32)
-                error_count += check_dll_architecture(pre_build_info.target_architecture, dlls);
+                error_count += check_exports_of_dlls(dll_infos);
+                error_count += check_uwp_bit_of_dlls(pre_build_info.cmake_system_name, dll_infos);
+                error_count += check_outdated_crt_linkage_of_dlls(dll_infos, build_info, pre_build_info);
+                error_count += check_dll_architecture(pre_build_info.target_architecture, dll_infos);
 #endif
                 break;
             }
@@ -820,30 +801,26 @@ namespace vcpkg::PostBuildLint
                 dlls.insert(dlls.end(), debug_dlls.begin(), debug_dlls.end());
                 error_count += check_no_dlls_present(dlls);
 
-                error_count += check_bin_folders_are_not_present_in_static_build(fs, package_dir);
+                error_count += check_bin_folders_are_not_present_in_static_build(tree, package_dir);
 
-                if (!toolset.dumpbin.empty())
+#if defined(_WIN32)
+                if (builds_debug && !build_info.policies.is_enabled(BuildPolicy::ONLY_RELEASE_CRT))
                 {
-                    if (!build_info.policies.is_enabled(BuildPolicy::ONLY_RELEASE_CRT))
-                    {
-                        error_count += check_crt_linkage_of_libs(
-                            BuildType::value_of(Build::ConfigurationType::DEBUG, build_info.crt_linkage),
-                            debug_libs,
-                            toolset.dumpbin);
-                    }
                     error_count += check_crt_linkage_of_libs(
-                        BuildType::value_of(Build::ConfigurationType::RELEASE, build_info.crt_linkage),
-                        release_libs,
-                        toolset.dumpbin);
+                        BuildType::value_of(Build::ConfigurationType::DEBUG, build_info.crt_linkage),
+                        debug_lib_infos);
                 }
+                error_count += check_crt_linkage_of_libs(
+                    BuildType::value_of(Build::ConfigurationType::RELEASE, build_info.crt_linkage), release_lib_infos);
+#endif
                 break;
             }
             default: Checks::unreachable(VCPKG_LINE_INFO);
         }
 
-        error_count += check_no_empty_folders(fs, package_dir);
-        error_count += check_no_files_in_dir(fs, package_dir);
-        error_count += check_no_files_in_dir(fs, package_dir / "debug");
+        error_count += check_no_empty_folders(tree, package_dir);
+        error_count += check_no_files_in_dir(tree, package_dir, "");
+        if (builds_debug) error_count += check_no_files_in_dir(tree, package_dir / "debug", "debug");
 
         return error_count;
     }
@@ -853,6 +830,8 @@ namespace vcpkg::PostBuildLint
                               const PreBuildInfo& pre_build_info,
                               const BuildInfo& build_info)
     {
+        Trace::Scope trace("lint", spec.to_string());
+
         System::println("-- Performing post-build validation");
         const size_t error_count = perform_all_checks_and_return_error_count(spec, paths, pre_build_info, build_info);
 
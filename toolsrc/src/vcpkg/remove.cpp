@@ -1,11 +1,14 @@
 #include "pch.h"
 
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/threadpool.h>
 #include <vcpkg/base/util.h>
+#include <vcpkg/cmakeindex.h>
 #include <vcpkg/commands.h>
 #include <vcpkg/dependencies.h>
 #include <vcpkg/help.h>
 #include <vcpkg/input.h>
+#include <vcpkg/msbuildprops.h>
 #include <vcpkg/paragraphs.h>
 #include <vcpkg/remove.h>
 #include <vcpkg/update.h>
@@ -18,7 +21,15 @@ namespace vcpkg::Remove
     using Dependencies::RequestType;
     using Update::OutdatedPackage;
 
-    void remove_package(const VcpkgPaths& paths, const PackageSpec& spec, StatusParagraphs* status_db)
+    fs::path replaced_files_dir(const VcpkgPaths& paths, const PackageSpec& spec)
+    {
+        return paths.vcpkg_dir / "replaced" / spec.dir();
+    }
+
+    void remove_package(const VcpkgPaths& paths,
+                        const PackageSpec& spec,
+                        StatusParagraphs* status_db,
+                        const KeepFiles keep_files)
     {
         auto& fs = paths.get_filesystem();
         auto maybe_ipv = status_db->find_all_installed(spec);
@@ -39,16 +50,31 @@ namespace vcpkg::Remove
         {
             spgh.want = Want::PURGE;
             spgh.state = InstallState::HALF_INSTALLED;
-            write_update(paths, spgh);
         }
+        write_update(paths, spghs);
 
         auto maybe_lines = fs.read_lines(paths.listfile_path(ipv.core->package));
 
         if (const auto lines = maybe_lines.get())
         {
-            std::vector<fs::path> dirs_touched;
-            for (auto&& suffix : *lines)
+            // The kept files mirror the layout of the listfile, so their directories are created up front
+            const fs::path replaced_dir = replaced_files_dir(paths, spec);
+            if (keep_files == KeepFiles::YES)
             {
+                std::error_code ec;
+                fs.remove_all(replaced_dir, ec);
+                fs.create_directories(replaced_dir, ec);
+                for (auto&& suffix : *lines)
+                {
+                    if (!suffix.empty() && suffix.back() == '/') fs.create_directories(replaced_dir / suffix, ec);
+                }
+            }
+
+            // Deleting is one round trip to the file system per file, so the files are removed on several threads
+            // and only the directories, which must be empty first, are handled afterwards
+            std::vector<char> is_directory(lines->size(), 0);
+            ThreadPool::parallel_for(lines->size(), lines->size() / 8 + 1, [&](size_t i) {
+                auto& suffix = (*lines)[i];
                 if (!suffix.empty() && suffix.back() == '\r') suffix.pop_back();
 
                 std::error_code ec;
@@ -59,15 +85,21 @@ namespace vcpkg::Remove
                 if (ec)
                 {
                     System::println(System::Color::error, "failed: status(%s): %s", target.u8string(), ec.message());
-                    continue;
+                    return;
                 }
 
                 if (fs::is_directory(status))
                 {
-                    dirs_touched.push_back(target);
+                    is_directory[i] = 1;
                 }
                 else if (fs::is_regular_file(status) || fs::is_symlink(status))
                 {
+                    if (keep_files == KeepFiles::YES)
+                    {
+                        fs.rename(target, replaced_dir / suffix, ec);
+                        if (!ec) return;
+                    }
+
                     fs.remove(target, ec);
                     if (ec)
                     {
@@ -93,6 +125,12 @@ namespace vcpkg::Remove
                 {
                     System::println(System::Color::warning, "Warning: %s: cannot handle file type", target.u8string());
                 }
+            });
+
+            std::vector<fs::path> dirs_touched;
+            for (size_t i = 0; i < lines->size(); ++i)
+            {
+                if (is_directory[i]) dirs_touched.push_back(paths.installed / (*lines)[i]);
             }
 
             auto b = dirs_touched.rbegin();
@@ -112,12 +150,17 @@ namespace vcpkg::Remove
 
             fs.remove(paths.listfile_path(ipv.core->package));
         }
+        CMakeIndex::forget(paths, spec);
+        MSBuildProps::write_triplet_props(paths, spec.triplet());
 
         for (auto&& spgh : spghs)
         {
             spgh.state = InstallState::NOT_INSTALLED;
-            write_update(paths, spgh);
+        }
+        write_update(paths, spghs);
 
+        for (auto&& spgh : spghs)
+        {
             status_db->insert(std::make_unique<StatusParagraph>(std::move(spgh)));
         }
     }
@@ -156,7 +199,8 @@ namespace vcpkg::Remove
     void perform_remove_plan_action(const VcpkgPaths& paths,
                                     const RemovePlanAction& action,
                                     const Purge purge,
-                                    StatusParagraphs* status_db)
+                                    StatusParagraphs* status_db,
+                                    const KeepFiles keep_files)
     {
         const std::string display_name = action.spec.to_string();
 
@@ -167,7 +211,7 @@ namespace vcpkg::Remove
                 break;
             case RemovePlanType::REMOVE:
                 System::println("Removing package %s... ", display_name);
-                remove_package(paths, action.spec, status_db);
+                remove_package(paths, action.spec, status_db, keep_files);
                 System::println(System::Color::success, "Removing package %s... done", display_name);
                 break;
             case RemovePlanType::UNKNOWN:
@@ -178,8 +222,7 @@ namespace vcpkg::Remove
         {
             System::println("Purging package %s... ", display_name);
             Files::Filesystem& fs = paths.get_filesystem();
-            std::error_code ec;
-            fs.remove_all(paths.packages / action.spec.dir(), ec);
+            Files::remove_all_in_background(fs, paths.packages / action.spec.dir(), paths.packages);
             System::println(System::Color::success, "Purging package %s... done", display_name);
         }
     }
@@ -217,8 +260,10 @@ namespace vcpkg::Remove
     void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths, const Triplet& default_triplet)
     {
         const ParsedArguments options = args.parse_arguments(COMMAND_STRUCTURE);
+        const bool dry_run = Util::Sets::contains(options.switches, OPTION_DRY_RUN);
 
-        StatusParagraphs status_db = database_load_check(paths);
+        StatusParagraphs status_db =
+            database_load_check(paths, dry_run ? InstalledBase::MERGE : InstalledBase::IMPORT);
         std::vector<PackageSpec> specs;
         if (Util::Sets::contains(options.switches, OPTION_OUTDATED))
         {
@@ -228,9 +273,7 @@ namespace vcpkg::Remove
                 Checks::exit_fail(VCPKG_LINE_INFO);
             }
 
-            Dependencies::PathsPortFileProvider provider(paths);
-
-            specs = Util::fmap(Update::find_outdated_packages(provider, status_db),
+            specs = Util::fmap(Update::find_outdated_packages(paths, status_db),
                                [](auto&& outdated) { return outdated.spec; });
 
             if (specs.empty())
@@ -246,12 +289,8 @@ namespace vcpkg::Remove
                 System::println(System::Color::error, "Error: 'remove' accepts either libraries or '--outdated'");
                 Checks::exit_fail(VCPKG_LINE_INFO);
             }
-            specs = Util::fmap(args.command_arguments, [&](auto&& arg) {
-                return Input::check_and_get_package_spec(arg, default_triplet, COMMAND_STRUCTURE.example_text);
-            });
-
-            for (auto&& spec : specs)
-                Input::check_triplet(spec.triplet(), paths);
+            specs = Input::check_and_get_package_specs(
+                args.command_arguments, default_triplet, COMMAND_STRUCTURE.example_text, paths);
         }
 
         const bool no_purge_was_passed = Util::Sets::contains(options.switches, OPTION_NO_PURGE);
@@ -264,7 +303,6 @@ namespace vcpkg::Remove
         }
         const Purge purge = to_purge(purge_was_passed || !no_purge_was_passed);
         const bool is_recursive = Util::Sets::contains(options.switches, OPTION_RECURSE);
-        const bool dry_run = Util::Sets::contains(options.switches, OPTION_DRY_RUN);
 
         const std::vector<RemovePlanAction> remove_plan = Dependencies::create_remove_plan(specs, status_db);
         Checks::check_exit(VCPKG_LINE_INFO, !remove_plan.empty(), "Remove plan cannot be empty");
@@ -298,7 +336,7 @@ namespace vcpkg::Remove
 
         for (const RemovePlanAction& action : remove_plan)
         {
-            perform_remove_plan_action(paths, action, purge, &status_db);
+            perform_remove_plan_action(paths, action, purge, &status_db, KeepFiles::NO);
         }
 
         Checks::exit_success(VCPKG_LINE_INFO);
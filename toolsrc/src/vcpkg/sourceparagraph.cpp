@@ -15,24 +15,48 @@ namespace vcpkg
 
     namespace SourceParagraphFields
     {
-        static const std::string BUILD_DEPENDS = "Build-Depends";
-        static const std::string DEFAULTFEATURES = "Default-Features";
-        static const std::string DESCRIPTION = "Description";
-        static const std::string FEATURE = "Feature";
-        static const std::string MAINTAINER = "Maintainer";
-        static const std::string SOURCE = "Source";
-        static const std::string SUPPORTS = "Supports";
-        static const std::string VERSION = "Version";
+        static constexpr std::string_view NAMES[] = {
+            "Source",
+            "Version",
+            "Description",
+            "Maintainer",
+            "Build-Depends",
+            "Supports",
+            "Default-Features",
+        };
+        static constexpr FieldTable TABLE = NAMES;
+
+        static constexpr size_t BUILD_DEPENDS = TABLE.id("Build-Depends");
+        static constexpr size_t DEFAULTFEATURES = TABLE.id("Default-Features");
+        static constexpr size_t DESCRIPTION = TABLE.id("Description");
+        static constexpr size_t MAINTAINER = TABLE.id("Maintainer");
+        static constexpr size_t SOURCE = TABLE.id("Source");
+        static constexpr size_t SUPPORTS = TABLE.id("Supports");
+        static constexpr size_t VERSION = TABLE.id("Version");
+    }
+
+    namespace FeatureParagraphFields
+    {
+        static constexpr std::string_view NAMES[] = {
+            "Feature",
+            "Description",
+            "Build-Depends",
+        };
+        static constexpr FieldTable TABLE = NAMES;
+
+        static constexpr size_t BUILD_DEPENDS = TABLE.id("Build-Depends");
+        static constexpr size_t DESCRIPTION = TABLE.id("Description");
+        static constexpr size_t FEATURE = TABLE.id("Feature");
     }
 
     static Span<const std::string> get_list_of_valid_fields()
     {
         static const std::string valid_fields[] = {
-            SourceParagraphFields::SOURCE,
-            SourceParagraphFields::VERSION,
-            SourceParagraphFields::DESCRIPTION,
-            SourceParagraphFields::MAINTAINER,
-            SourceParagraphFields::BUILD_DEPENDS,
+            "Source",
+            "Version",
+            "Description",
+            "Maintainer",
+            "Build-Depends",
         };
 
         return valid_fields;
@@ -86,9 +110,45 @@ namespace vcpkg
         }
     }
 
-    static ParseExpected<SourceParagraph> parse_source_paragraph(RawParagraph&& fields)
+    static std::vector<std::string> to_strings(const std::vector<std::string_view>& views)
+    {
+        return Util::fmap(views, [](std::string_view view) { return std::string(view); });
+    }
+
+    static Dependency parse_qualified_dependency(std::string_view depend_string)
+    {
+        // expect of the form "\w+ \(\w+\)"; otherwise, for now, just slurp the entire string
+        std::string_view name = depend_string;
+        std::string_view qualifier;
+        const auto pos = depend_string.find(' ');
+        if (pos != std::string_view::npos && pos + 1 < depend_string.size() && depend_string[pos + 1] == '(' &&
+            depend_string.back() == ')')
+        {
+            name = depend_string.substr(0, pos);
+            qualifier = depend_string.substr(pos + 2, depend_string.size() - pos - 3);
+        }
+
+        // Most dependencies are a bare port name, which needs none of the specifier parsing
+        if (name.find_first_of("[:") == std::string_view::npos)
+        {
+            Dependency dep;
+            dep.depend.name.assign(name.data(), name.size());
+            dep.qualifier.assign(qualifier.data(), qualifier.size());
+            dep.parsed_qualifier = DependencyQualifier::parse(qualifier);
+            return dep;
+        }
+
+        return Dependency::parse_dependency(std::string(name), std::string(qualifier));
+    }
+
+    static std::vector<Dependency> parse_dependencies(std::string_view depends)
+    {
+        return Util::fmap(split_comma_list(depends), &parse_qualified_dependency);
+    }
+
+    static ParseExpected<SourceParagraph> parse_source_paragraph(const RawParagraphView& fields)
     {
-        ParagraphParser parser(std::move(fields));
+        ParagraphParser parser(fields, SourceParagraphFields::TABLE);
 
         auto spgh = std::make_unique<SourceParagraph>();
 
@@ -97,10 +157,11 @@ namespace vcpkg
 
         spgh->description = parser.optional_field(SourceParagraphFields::DESCRIPTION);
         spgh->maintainer = parser.optional_field(SourceParagraphFields::MAINTAINER);
-        spgh->depends = expand_qualified_dependencies(
-            parse_comma_list(parser.optional_field(SourceParagraphFields::BUILD_DEPENDS)));
-        spgh->supports = parse_comma_list(parser.optional_field(SourceParagraphFields::SUPPORTS));
-        spgh->default_features = parse_comma_list(parser.optional_field(SourceParagraphFields::DEFAULTFEATURES));
+        spgh->depends = parse_dependencies(parser.optional_field_view(SourceParagraphFields::BUILD_DEPENDS));
+        spgh->supports = to_strings(split_comma_list(parser.optional_field_view(SourceParagraphFields::SUPPORTS)));
+        if (auto p_supports = Supports::parse(spgh->supports).get()) spgh->parsed_supports = *p_supports;
+        spgh->default_features =
+            to_strings(split_comma_list(parser.optional_field_view(SourceParagraphFields::DEFAULTFEATURES)));
 
         auto err = parser.error_info(spgh->name);
         if (err)
@@ -109,17 +170,16 @@ namespace vcpkg
             return std::move(spgh);
     }
 
-    static ParseExpected<FeatureParagraph> parse_feature_paragraph(RawParagraph&& fields)
+    static ParseExpected<FeatureParagraph> parse_feature_paragraph(const RawParagraphView& fields)
     {
-        ParagraphParser parser(std::move(fields));
+        ParagraphParser parser(fields, FeatureParagraphFields::TABLE);
 
         auto fpgh = std::make_unique<FeatureParagraph>();
 
-        parser.required_field(SourceParagraphFields::FEATURE, fpgh->name);
-        parser.required_field(SourceParagraphFields::DESCRIPTION, fpgh->description);
+        parser.required_field(FeatureParagraphFields::FEATURE, fpgh->name);
+        parser.required_field(FeatureParagraphFields::DESCRIPTION, fpgh->description);
 
-        fpgh->depends = expand_qualified_dependencies(
-            parse_comma_list(parser.optional_field(SourceParagraphFields::BUILD_DEPENDS)));
+        fpgh->depends = parse_dependencies(parser.optional_field_view(FeatureParagraphFields::BUILD_DEPENDS));
 
         auto err = parser.error_info(fpgh->name);
         if (err)
@@ -130,6 +190,12 @@ namespace vcpkg
 
     ParseExpected<SourceControlFile> SourceControlFile::parse_control_file(
         std::vector<std::unordered_map<std::string, std::string>>&& control_paragraphs)
+    {
+        return parse_control_file(Util::fmap(control_paragraphs, &RawParagraphView::from_raw_paragraph));
+    }
+
+    ParseExpected<SourceControlFile> SourceControlFile::parse_control_file(
+        const std::vector<RawParagraphView>& control_paragraphs)
     {
         if (control_paragraphs.size() == 0)
         {
@@ -138,17 +204,15 @@ namespace vcpkg
 
         auto control_file = std::make_unique<SourceControlFile>();
 
-        auto maybe_source = parse_source_paragraph(std::move(control_paragraphs.front()));
+        auto maybe_source = parse_source_paragraph(control_paragraphs.front());
         if (const auto source = maybe_source.get())
             control_file->core_paragraph = std::move(*source);
         else
             return std::move(maybe_source).error();
 
-        control_paragraphs.erase(control_paragraphs.begin());
-
-        for (auto&& feature_pgh : control_paragraphs)
+        for (auto it = std::next(control_paragraphs.begin()); it != control_paragraphs.end(); ++it)
         {
-            auto maybe_feature = parse_feature_paragraph(std::move(feature_pgh));
+            auto maybe_feature = parse_feature_paragraph(*it);
             if (const auto feature = maybe_feature.get())
                 control_file->feature_paragraphs.emplace_back(std::move(*feature));
             else
@@ -171,7 +235,8 @@ namespace vcpkg
     Dependency Dependency::parse_dependency(std::string name, std::string qualifier)
     {
         Dependency dep;
-        dep.qualifier = qualifier;
+        dep.qualifier = std::move(qualifier);
+        dep.parsed_qualifier = DependencyQualifier::parse(dep.qualifier);
         if (auto maybe_features = Features::from_string(name))
             dep.depend = *maybe_features.get();
         else
@@ -180,6 +245,31 @@ namespace vcpkg
         return dep;
     }
 
+    DependencyQualifier DependencyQualifier::parse(std::string_view qualifier)
+    {
+        DependencyQualifier ret;
+        while (!qualifier.empty())
+        {
+            const auto amp = qualifier.find('&');
+            std::string_view term = qualifier.substr(0, amp);
+            qualifier = amp == std::string_view::npos ? std::string_view() : qualifier.substr(amp + 1);
+
+            if (term.empty()) continue;
+            const bool negated = term[0] == '!';
+            if (negated) term.remove_prefix(1);
+            ret.terms.push_back({std::string(term), negated});
+        }
+        return ret;
+    }
+
+    bool DependencyQualifier::matches(const Triplet& t) const
+    {
+        const std::string& triplet_name = t.canonical_name();
+        return std::all_of(terms.begin(), terms.end(), [&](const Term& term) {
+            return (triplet_name.find(term.text) == std::string::npos) == term.negated;
+        });
+    }
+
     std::string Dependency::name() const
     {
         if (this->depend.features.empty()) return this->depend.name;
@@ -190,20 +280,8 @@ namespace vcpkg
 
     std::vector<Dependency> expand_qualified_dependencies(const std::vector<std::string>& depends)
     {
-        return Util::fmap(depends, [&](const std::string& depend_string) -> Dependency {
-            auto pos = depend_string.find(' ');
-            if (pos == std::string::npos) return Dependency::parse_dependency(depend_string, "");
-            // expect of the form "\w+ \[\w+\]"
-            Dependency dep;
-
-            dep.depend.name = depend_string.substr(0, pos);
-            if (depend_string.c_str()[pos + 1] != '(' || depend_string[depend_string.size() - 1] != ')')
-            {
-                // Error, but for now just slurp the entire string.
-                return Dependency::parse_dependency(depend_string, "");
-            }
-            dep.qualifier = depend_string.substr(pos + 2, depend_string.size() - pos - 3);
-            return dep;
+        return Util::fmap(depends, [](const std::string& depend_string) {
+            return parse_qualified_dependency(depend_string);
         });
     }
 
@@ -212,25 +290,25 @@ namespace vcpkg
         std::vector<std::string> ret;
         for (auto&& dep : deps)
         {
-            auto qualifiers = Strings::split(dep.qualifier, "&");
-            if (std::all_of(qualifiers.begin(), qualifiers.end(), [&](const std::string& qualifier) {
-                    if (qualifier.empty()) return true;
-                    if (qualifier[0] == '!')
-                    {
-                        return t.canonical_name().find(qualifier.substr(1)) == std::string::npos;
-                    }
-                    return t.canonical_name().find(qualifier) != std::string::npos;
-                }))
-            {
-                ret.emplace_back(dep.name());
-            }
+            if (dep.applies_to(t)) ret.emplace_back(dep.name());
         }
         return ret;
     }
 
     std::vector<FeatureSpec> filter_dependencies_to_specs(const std::vector<Dependency>& deps, const Triplet& t)
     {
-        return FeatureSpec::from_strings_and_triplet(filter_dependencies(deps, t), t);
+        std::vector<FeatureSpec> f_specs;
+        for (auto&& dep : deps)
+        {
+            if (!dep.applies_to(t)) continue;
+
+            const PackageSpec pspec =
+                PackageSpec::from_name_and_triplet(dep.depend.name, t).value_or_exit(VCPKG_LINE_INFO);
+            for (auto&& feature : dep.depend.features)
+                f_specs.push_back(FeatureSpec{pspec, feature});
+            if (dep.depend.features.empty()) f_specs.push_back(FeatureSpec{pspec, ""});
+        }
+        return f_specs;
     }
 
     std::string to_string(const Dependency& dep) { return dep.name(); }
@@ -238,45 +316,42 @@ namespace vcpkg
     ExpectedT<Supports, std::vector<std::string>> Supports::parse(const std::vector<std::string>& strs)
     {
         Supports ret;
+        ret.architectures = ret.platforms = ret.crt_linkages = ret.toolsets = 0;
         std::vector<std::string> unrecognized;
 
         for (auto&& str : strs)
         {
             if (str == "x64")
-                ret.architectures.push_back(Architecture::X64);
+                ret.architectures |= bit(Architecture::X64);
             else if (str == "x86")
-                ret.architectures.push_back(Architecture::X86);
+                ret.architectures |= bit(Architecture::X86);
             else if (str == "arm")
-                ret.architectures.push_back(Architecture::ARM);
+                ret.architectures |= bit(Architecture::ARM);
             else if (str == "windows")
-                ret.platforms.push_back(Platform::WINDOWS);
+                ret.platforms |= bit(Platform::WINDOWS);
             else if (str == "uwp")
-                ret.platforms.push_back(Platform::UWP);
+                ret.platforms |= bit(Platform::UWP);
             else if (str == "v140")
-                ret.toolsets.push_back(ToolsetVersion::V140);
+                ret.toolsets |= bit(ToolsetVersion::V140);
             else if (str == "v141")
-                ret.toolsets.push_back(ToolsetVersion::V141);
+                ret.toolsets |= bit(ToolsetVersion::V141);
             else if (str == "crt-static")
-                ret.crt_linkages.push_back(Linkage::STATIC);
+                ret.crt_linkages |= bit(Linkage::STATIC);
             else if (str == "crt-dynamic")
-                ret.crt_linkages.push_back(Linkage::DYNAMIC);
+                ret.crt_linkages |= bit(Linkage::DYNAMIC);
             else
                 unrecognized.push_back(str);
         }
 
+        // A property without clauses is not restricted
+        for (uint8_t* mask : {&ret.architectures, &ret.platforms, &ret.crt_linkages, &ret.toolsets})
+        {
+            if (*mask == 0) *mask = ANY;
+        }
+
         if (unrecognized.empty())
             return std::move(ret);
         else
             return std::move(unrecognized);
     }
-
-    bool Supports::is_supported(Architecture arch, Platform plat, Linkage crt, ToolsetVersion tools)
-    {
-        const auto is_in_or_empty = [](auto v, auto&& c) -> bool { return c.empty() || c.end() != Util::find(c, v); };
-        if (!is_in_or_empty(arch, architectures)) return false;
-        if (!is_in_or_empty(plat, platforms)) return false;
-        if (!is_in_or_empty(crt, crt_linkages)) return false;
-        if (!is_in_or_empty(tools, toolsets)) return false;
-        return true;
-    }
 }
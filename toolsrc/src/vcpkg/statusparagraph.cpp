@@ -25,14 +25,24 @@ namespace vcpkg
     }
 
     StatusParagraph::StatusParagraph(std::unordered_map<std::string, std::string>&& fields)
+        : StatusParagraph(RawParagraphView::from_raw_paragraph(fields))
+    {
+    }
+
+    StatusParagraph::StatusParagraph(const RawParagraphView& fields)
         : want(Want::ERROR_STATE), state(InstallState::ERROR_STATE)
     {
-        auto status_it = fields.find(BinaryParagraphRequiredField::STATUS);
-        Checks::check_exit(VCPKG_LINE_INFO, status_it != fields.end(), "Expected 'Status' field in status paragraph");
-        std::string status_field = std::move(status_it->second);
-        fields.erase(status_it);
+        const auto status_value = fields.find(BinaryParagraphRequiredField::STATUS);
+        Checks::check_exit(VCPKG_LINE_INFO, status_value != nullptr, "Expected 'Status' field in status paragraph");
+        const std::string status_field(*status_value);
 
-        this->package = BinaryParagraph(std::move(fields));
+        RawParagraphView package_fields;
+        package_fields.fields.reserve(fields.fields.size() - 1);
+        for (auto&& field : fields.fields)
+        {
+            if (&field.second != status_value) package_fields.fields.push_back(field);
+        }
+        this->package = BinaryParagraph(package_fields);
 
         auto b = status_field.begin();
         const auto mark = b;
@@ -7,33 +7,52 @@ namespace vcpkg
 {
     StatusParagraphs::StatusParagraphs() = default;
 
-    StatusParagraphs::StatusParagraphs(std::vector<std::unique_ptr<StatusParagraph>>&& ps)
-        : paragraphs(std::move(ps)){};
+    StatusParagraphs::StatusParagraphs(std::vector<std::unique_ptr<StatusParagraph>>&& ps) : paragraphs(std::move(ps))
+    {
+        for (size_t i = 0; i < paragraphs.size(); ++i)
+        {
+            by_name[paragraphs[i]->package.spec.name()].push_back(i);
+        }
+    }
+
+    /// <summary>
+    /// Calls f with the position of each paragraph of name, newest first, until f returns true.
+    /// </summary>
+    template<class This, class F>
+    void StatusParagraphs::for_each_named(This& self, const std::string& name, F f)
+    {
+        const auto it = self.by_name.find(name);
+        if (it == self.by_name.end()) return;
+        for (auto pos = it->second.rbegin(); pos != it->second.rend(); ++pos)
+        {
+            if (f(*pos)) return;
+        }
+    }
 
     std::vector<std::unique_ptr<StatusParagraph>*> StatusParagraphs::find_all(const std::string& name,
                                                                               const Triplet& triplet)
     {
         std::vector<std::unique_ptr<StatusParagraph>*> spghs;
-        for (auto&& p : *this)
-        {
-            if (p->package.spec.name() == name && p->package.spec.triplet() == triplet)
+        for_each_named(*this, name, [&](size_t i) {
+            auto& p = paragraphs[i];
+            if (p->package.spec.triplet() == triplet)
             {
                 if (p->package.feature.empty())
                     spghs.emplace(spghs.begin(), &p);
                 else
                     spghs.emplace_back(&p);
             }
-        }
+            return false;
+        });
         return spghs;
     }
 
     Optional<InstalledPackageView> StatusParagraphs::find_all_installed(const PackageSpec& spec) const
     {
         InstalledPackageView ipv;
-        for (auto&& p : *this)
-        {
-            if (p->package.spec.name() == spec.name() && p->package.spec.triplet() == spec.triplet() &&
-                p->is_installed())
+        for_each_named(*this, spec.name(), [&](size_t i) {
+            auto& p = paragraphs[i];
+            if (p->package.spec.triplet() == spec.triplet() && p->is_installed())
             {
                 if (p->package.feature.empty())
                 {
@@ -43,7 +62,8 @@ namespace vcpkg
                 else
                     ipv.features.emplace_back(p.get());
             }
-        }
+            return false;
+        });
         if (ipv.core != nullptr)
             return std::move(ipv);
         else
@@ -59,10 +79,14 @@ namespace vcpkg
             // The core feature maps to .feature == ""
             return find(name, triplet, "");
         }
-        return std::find_if(begin(), end(), [&](const std::unique_ptr<StatusParagraph>& pgh) {
-            const PackageSpec& spec = pgh->package.spec;
-            return spec.name() == name && spec.triplet() == triplet && pgh->package.feature == feature;
+        auto found = end();
+        for_each_named(*this, name, [&](size_t i) {
+            const auto& pgh = paragraphs[i];
+            if (pgh->package.spec.triplet() != triplet || pgh->package.feature != feature) return false;
+            found = iterator(paragraphs.begin() + i + 1);
+            return true;
         });
+        return found;
     }
 
     StatusParagraphs::const_iterator StatusParagraphs::find(const std::string& name,
@@ -74,10 +98,14 @@ namespace vcpkg
             // The core feature maps to .feature == ""
             return find(name, triplet, "");
         }
-        return std::find_if(begin(), end(), [&](const std::unique_ptr<StatusParagraph>& pgh) {
-            const PackageSpec& spec = pgh->package.spec;
-            return spec.name() == name && spec.triplet() == triplet && pgh->package.feature == feature;
+        auto found = end();
+        for_each_named(*this, name, [&](size_t i) {
+            const auto& pgh = paragraphs[i];
+            if (pgh->package.spec.triplet() != triplet || pgh->package.feature != feature) return false;
+            found = const_iterator(paragraphs.begin() + i + 1);
+            return true;
         });
+        return found;
     }
 
     StatusParagraphs::const_iterator StatusParagraphs::find_installed(const PackageSpec& spec) const
@@ -125,6 +153,7 @@ namespace vcpkg
         const auto ptr = find(spec.name(), spec.triplet(), pgh->package.feature);
         if (ptr == end())
         {
+            by_name[spec.name()].push_back(paragraphs.size());
             paragraphs.push_back(std::move(pgh));
             return paragraphs.rbegin();
         }
@@ -142,4 +171,16 @@ namespace vcpkg
             out_str.push_back('\n');
         }
     }
+
+    void serialize(const StatusParagraphs& pghs, Files::OutputFile& out)
+    {
+        std::string buffer;
+        for (auto& pgh : pghs.paragraphs)
+        {
+            buffer.clear();
+            serialize(*pgh, buffer);
+            buffer.push_back('\n');
+            out.write(buffer);
+        }
+    }
 }
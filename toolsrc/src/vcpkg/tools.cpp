@@ -44,77 +44,110 @@ namespace vcpkg
         return result;
     }
 
-    static ExpectedT<ToolData, std::string> parse_tool_data_from_xml(const VcpkgPaths& paths, const std::string& tool)
-    {
 #if defined(_WIN32)
-        static constexpr StringLiteral OS_STRING = "windows";
+    static constexpr StringLiteral OS_STRING = "windows";
 #elif defined(__APPLE__)
-        static constexpr StringLiteral OS_STRING = "osx";
+    static constexpr StringLiteral OS_STRING = "osx";
 #elif defined(__linux__)
-        static constexpr StringLiteral OS_STRING = "linux";
+    static constexpr StringLiteral OS_STRING = "linux";
 #elif defined(__FreeBSD__)
-        static constexpr StringLiteral OS_STRING = "freebsd";
-#else
-        return std::string("operating system is unknown");
+    static constexpr StringLiteral OS_STRING = "freebsd";
 #endif
 
 #if defined(_WIN32) || defined(__APPLE__) || defined(__linux__) || defined(__FreeBSD__)
-        static const std::string XML_VERSION = "2";
-        static const fs::path XML_PATH = paths.scripts / "vcpkgTools.xml";
-        static const std::regex XML_VERSION_REGEX {R"###(<tools[\s]+version="([^"]+)">)###"};
-        static const std::string XML = paths.get_filesystem().read_contents(XML_PATH).value_or_exit(VCPKG_LINE_INFO);
-        std::smatch match_xml_version;
-        const bool has_xml_version = std::regex_search(XML.cbegin(), XML.cend(), match_xml_version, XML_VERSION_REGEX);
-        Checks::check_exit(VCPKG_LINE_INFO,
-                           has_xml_version,
-                           R"(Could not find <tools version="%s"> in %s)",
-                           XML_VERSION,
-                           XML_PATH.u8string());
-        Checks::check_exit(VCPKG_LINE_INFO,
-                           XML_VERSION == match_xml_version[1],
-                           "Expected %s version: [%s], but was [%s]. Please re-run bootstrap-vcpkg.",
-                           XML_PATH.u8string(),
-                           XML_VERSION,
-                           match_xml_version[1]);
-
-        const std::regex tool_regex {Strings::format(R"###(<tool[\s]+name="%s"[\s]+os="%s">)###", tool, OS_STRING)};
-        std::smatch match_tool_entry;
-        const bool has_tool_entry = std::regex_search(XML.cbegin(), XML.cend(), match_tool_entry, tool_regex);
-        if (!has_tool_entry)
+    /// <summary>
+    /// The tools that vcpkgTools.xml lists for this operating system, by name. The file is read and scanned once, on
+    /// the first lookup of any tool.
+    /// </summary>
+    static const std::unordered_map<std::string, ToolData>& load_tool_table(const VcpkgPaths& paths,
+                                                                           const fs::path& xml_path)
+    {
+        static const std::unordered_map<std::string, ToolData> TABLE = [&]() {
+            static const std::string XML_VERSION = "2";
+            static const std::regex XML_VERSION_REGEX{R"###(<tools[\s]+version="([^"]+)">)###"};
+            const std::string xml = paths.get_filesystem().read_contents(xml_path).value_or_exit(VCPKG_LINE_INFO);
+            std::smatch match_xml_version;
+            const bool has_xml_version =
+                std::regex_search(xml.cbegin(), xml.cend(), match_xml_version, XML_VERSION_REGEX);
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               has_xml_version,
+                               R"(Could not find <tools version="%s"> in %s)",
+                               XML_VERSION,
+                               xml_path.u8string());
+            Checks::check_exit(VCPKG_LINE_INFO,
+                               XML_VERSION == match_xml_version[1],
+                               "Expected %s version: [%s], but was [%s]. Please re-run bootstrap-vcpkg.",
+                               xml_path.u8string(),
+                               XML_VERSION,
+                               match_xml_version[1]);
+
+            std::unordered_map<std::string, ToolData> table;
+            static const std::regex TOOL_REGEX{R"###(<tool[\s]+name="([^"]+)"[\s]+os="([^"]+)">)###"};
+            const std::sregex_iterator end;
+            for (auto it = std::sregex_iterator(xml.cbegin(), xml.cend(), TOOL_REGEX); it != end; ++it)
+            {
+                const std::smatch& match_tool_entry = *it;
+                if (match_tool_entry[2] != OS_STRING.c_str()) continue;
+
+                const std::string tool = match_tool_entry[1];
+                const size_t data_begin = match_tool_entry.position() + match_tool_entry.length();
+                const size_t data_end = xml.find("</tool>", data_begin);
+                Checks::check_exit(
+                    VCPKG_LINE_INFO, data_end != std::string::npos, "Unterminated entry for tool %s", tool);
+
+                const std::string tool_data = xml.substr(data_begin, data_end - data_begin);
+                const std::string version_as_string =
+                    StringRange::find_exactly_one_enclosed(tool_data, "<version>", "</version>").to_string();
+                const std::string exe_relative_path =
+                    StringRange::find_exactly_one_enclosed(tool_data, "<exeRelativePath>", "</exeRelativePath>")
+                        .to_string();
+                const std::string url =
+                    StringRange::find_exactly_one_enclosed(tool_data, "<url>", "</url>").to_string();
+                const std::string sha512 =
+                    StringRange::find_exactly_one_enclosed(tool_data, "<sha512>", "</sha512>").to_string();
+                auto archive_name =
+                    StringRange::find_at_most_one_enclosed(tool_data, "<archiveName>", "</archiveName>");
+
+                const Optional<std::array<int, 3>> version = parse_version_string(version_as_string);
+                Checks::check_exit(VCPKG_LINE_INFO,
+                                   version.has_value(),
+                                   "Could not parse version for tool %s. Version string was: %s",
+                                   tool,
+                                   version_as_string);
+
+                const std::string tool_dir_name = Strings::format("%s-%s-%s", tool, version_as_string, OS_STRING);
+                const fs::path tool_dir_path = paths.tools / tool_dir_name;
+                const fs::path exe_path = tool_dir_path / exe_relative_path;
+
+                table.emplace(tool,
+                              ToolData{*version.get(),
+                                       exe_path,
+                                       url,
+                                       paths.downloads / archive_name.value_or(exe_relative_path).to_string(),
+                                       archive_name.has_value(),
+                                       tool_dir_path,
+                                       sha512});
+            }
+            return table;
+        }();
+        return TABLE;
+    }
+#endif
+
+    static ExpectedT<ToolData, std::string> parse_tool_data_from_xml(const VcpkgPaths& paths, const std::string& tool)
+    {
+#if defined(_WIN32) || defined(__APPLE__) || defined(__linux__) || defined(__FreeBSD__)
+        const fs::path xml_path = paths.scripts / "vcpkgTools.xml";
+        const auto& table = load_tool_table(paths, xml_path);
+        const auto it = table.find(tool);
+        if (it == table.end())
         {
             return Strings::format(
-                "Could not find entry for tool %s in %s for os=%s", tool, XML_PATH.u8string(), OS_STRING);
+                "Could not find entry for tool %s in %s for os=%s", tool, xml_path.u8string(), OS_STRING);
         }
-
-        const std::string tool_data =
-            StringRange::find_exactly_one_enclosed(XML, match_tool_entry[0], "</tool>").to_string();
-        const std::string version_as_string =
-            StringRange::find_exactly_one_enclosed(tool_data, "<version>", "</version>").to_string();
-        const std::string exe_relative_path =
-            StringRange::find_exactly_one_enclosed(tool_data, "<exeRelativePath>", "</exeRelativePath>").to_string();
-        const std::string url = StringRange::find_exactly_one_enclosed(tool_data, "<url>", "</url>").to_string();
-        const std::string sha512 =
-            StringRange::find_exactly_one_enclosed(tool_data, "<sha512>", "</sha512>").to_string();
-        auto archive_name = StringRange::find_at_most_one_enclosed(tool_data, "<archiveName>", "</archiveName>");
-
-        const Optional<std::array<int, 3>> version = parse_version_string(version_as_string);
-        Checks::check_exit(VCPKG_LINE_INFO,
-                           version.has_value(),
-                           "Could not parse version for tool %s. Version string was: %s",
-                           tool,
-                           version_as_string);
-
-        const std::string tool_dir_name = Strings::format("%s-%s-%s", tool, version_as_string, OS_STRING);
-        const fs::path tool_dir_path = paths.tools / tool_dir_name;
-        const fs::path exe_path = tool_dir_path / exe_relative_path;
-
-        return ToolData {*version.get(),
-                         exe_path,
-                         url,
-                         paths.downloads / archive_name.value_or(exe_relative_path).to_string(),
-                         archive_name.has_value(),
-                         tool_dir_path,
-                         sha512};
+        return it->second;
+#else
+        return std::string("operating system is unknown");
 #endif
     }
 
@@ -218,6 +251,131 @@ namespace vcpkg
         return {downloaded_path, downloaded_version};
     }
 
+    /// <summary>
+    /// get_path results of earlier runs are kept in installed/vcpkg/toolcache, so later runs do not have to start every
+    /// candidate executable to learn its version. Each line records one tool as
+    ///   <tool>|<minimum version>|<version found>|<write time>|<candidate>|...
+    /// listing every candidate up to and including the chosen one. A record holds while the same candidates come first
+    /// and none of them has been modified, created or removed.
+    /// </summary>
+    static fs::path get_tool_cache_path(const VcpkgPaths& paths) { return paths.vcpkg_dir / "toolcache"; }
+
+    static long long get_write_time(const fs::path& path)
+    {
+        std::error_code ec;
+        const auto write_time = fs::stdfs::last_write_time(path, ec);
+        return ec ? -1 : static_cast<long long>(write_time.time_since_epoch().count());
+    }
+
+    static std::string escape_tool_cache_field(const std::string& s)
+    {
+        std::string escaped;
+        for (const char c : s)
+        {
+            if (c == '\\')
+                escaped += "\\\\";
+            else if (c == '\n')
+                escaped += "\\n";
+            else if (c == '\r')
+                escaped += "\\r";
+            else if (c == '|')
+                escaped += "\\p";
+            else
+                escaped.push_back(c);
+        }
+        return escaped;
+    }
+
+    static std::string unescape_tool_cache_field(const std::string& s)
+    {
+        std::string unescaped;
+        for (size_t i = 0; i < s.size(); ++i)
+        {
+            if (s[i] != '\\' || i + 1 == s.size())
+            {
+                unescaped.push_back(s[i]);
+                continue;
+            }
+
+            switch (s[++i])
+            {
+                case 'n': unescaped.push_back('\n'); break;
+                case 'r': unescaped.push_back('\r'); break;
+                case 'p': unescaped.push_back('|'); break;
+                default: unescaped.push_back(s[i]); break;
+            }
+        }
+        return unescaped;
+    }
+
+    static std::string make_tool_cache_key(const ToolProvider& tool, const std::array<int, 3>& min_version)
+    {
+        return Strings::format("%s|%d.%d.%d|", tool.tool_data_name(), min_version[0], min_version[1], min_version[2]);
+    }
+
+    static Optional<PathAndVersion> load_cached_tool(const VcpkgPaths& paths,
+                                                     const ToolProvider& tool,
+                                                     const std::array<int, 3>& min_version,
+                                                     const std::vector<fs::path>& candidates)
+    {
+        const auto maybe_lines = paths.get_filesystem().read_lines(get_tool_cache_path(paths));
+        const auto lines = maybe_lines.get();
+        if (!lines) return nullopt;
+
+        const std::string key = make_tool_cache_key(tool, min_version);
+        for (auto&& line : *lines)
+        {
+            if (line.compare(0, key.size(), key) != 0) continue;
+
+            const std::vector<std::string> fields = Strings::split(line.substr(key.size()), "|");
+            if (fields.size() < 3 || fields.size() % 2 != 1 || (fields.size() - 1) / 2 > candidates.size())
+                return nullopt;
+
+            for (size_t i = 1, candidate = 0; i < fields.size(); i += 2, ++candidate)
+            {
+                const auto& path = candidates[candidate];
+                if (path.u8string() != unescape_tool_cache_field(fields[i + 1])) return nullopt;
+                if (std::to_string(get_write_time(path)) != fields[i]) return nullopt;
+            }
+
+            return PathAndVersion{candidates[(fields.size() - 1) / 2 - 1], unescape_tool_cache_field(fields[0])};
+        }
+
+        return nullopt;
+    }
+
+    static void store_cached_tool(const VcpkgPaths& paths,
+                                  const ToolProvider& tool,
+                                  const std::array<int, 3>& min_version,
+                                  const std::vector<fs::path>& candidates,
+                                  const PathAndVersion& result)
+    {
+        const auto chosen = std::find(candidates.begin(), candidates.end(), result.path);
+        if (chosen == candidates.end()) return;
+
+        const std::string key = make_tool_cache_key(tool, min_version);
+        std::string record = key + escape_tool_cache_field(result.version);
+        for (auto it = candidates.begin(); it != std::next(chosen); ++it)
+        {
+            record += Strings::format("|%lld|%s", get_write_time(*it), escape_tool_cache_field(it->u8string()));
+        }
+
+        auto& fs = paths.get_filesystem();
+        const fs::path cache_path = get_tool_cache_path(paths);
+        auto maybe_lines = fs.read_lines(cache_path);
+        std::vector<std::string> lines;
+        if (const auto existing = maybe_lines.get()) lines = std::move(*existing);
+        Util::erase_remove_if(lines, [&](const std::string& line) {
+            return line.empty() || line.compare(0, key.size(), key) == 0;
+        });
+        lines.push_back(std::move(record));
+
+        const fs::path tmp_path = fs::path(cache_path).concat(".tmp");
+        std::error_code ec;
+        fs.write_contents(tmp_path, Strings::join("\n", lines) + '\n', ec);
+        if (!ec) fs.rename(tmp_path, cache_path, ec);
+    }
+
     static PathAndVersion get_path(const VcpkgPaths& paths, const ToolProvider& tool)
     {
         auto& fs = paths.get_filesystem();
@@ -241,14 +399,23 @@ namespace vcpkg
 
         tool.add_special_paths(candidate_paths);
 
+        const auto maybe_cached = load_cached_tool(paths, tool, min_version, candidate_paths);
+        if (const auto cached = maybe_cached.get())
+        {
+            return *cached;
+        }
+
         const auto maybe_path = find_first_with_sufficient_version(fs, tool, candidate_paths, min_version);
         if (const auto p = maybe_path.get())
         {
+            store_cached_tool(paths, tool, min_version, candidate_paths, *p);
             return *p;
         }
         if (auto tool_data = maybe_tool_data.get())
         {
-            return fetch_tool(paths, tool, *tool_data);
+            const auto fetched = fetch_tool(paths, tool, *tool_data);
+            store_cached_tool(paths, tool, min_version, candidate_paths, fetched);
+            return fetched;
         }
 
         Checks::exit_with_message(VCPKG_LINE_INFO, maybe_tool_data.error());
@@ -274,8 +441,7 @@ namespace vcpkg
         }
         virtual Optional<std::string> get_version(const fs::path& path_to_exe) const override
         {
-            const std::string cmd = Strings::format(R"("%s" --version)", path_to_exe.u8string());
-            const auto rc = System::cmd_execute_and_capture_output(cmd);
+            const auto rc = System::process_execute_and_capture_output(path_to_exe, {"--version"});
             if (rc.exit_code != 0)
             {
                 return nullopt;
@@ -314,8 +480,7 @@ CMake suite maintained and supported by Kitware (kitware.com/cmake).
 
         virtual Optional<std::string> get_version(const fs::path& path_to_exe) const override
         {
-            const std::string cmd = Strings::format(R"("%s" --version)", path_to_exe.u8string());
-            const auto rc = System::cmd_execute_and_capture_output(cmd);
+            const auto rc = System::process_execute_and_capture_output(path_to_exe, {"--version"});
             if (rc.exit_code != 0)
             {
                 return nullopt;
@@ -338,8 +503,7 @@ CMake suite maintained and supported by Kitware (kitware.com/cmake).
 
         virtual Optional<std::string> get_version(const fs::path& path_to_exe) const override
         {
-            const std::string cmd = Strings::format(R"("%s")", path_to_exe.u8string());
-            const auto rc = System::cmd_execute_and_capture_output(cmd);
+            const auto rc = System::process_execute_and_capture_output(path_to_exe, {});
             if (rc.exit_code != 0)
             {
                 return nullopt;
@@ -377,8 +541,7 @@ Type 'NuGet help <command>' for help on a specific command.
 
         virtual Optional<std::string> get_version(const fs::path& path_to_exe) const override
         {
-            const std::string cmd = Strings::format(R"("%s" --version)", path_to_exe.u8string());
-            const auto rc = System::cmd_execute_and_capture_output(cmd);
+            const auto rc = System::process_execute_and_capture_output(path_to_exe, {"--version"});
             if (rc.exit_code != 0)
             {
                 return nullopt;
@@ -394,6 +557,32 @@ git version 2.17.1.windows.2
         }
     };
 
+    struct ZstdProvider : ToolProvider
+    {
+        std::string m_exe = "zstd";
+
+        virtual const std::string& tool_data_name() const override { return m_exe; }
+        virtual const std::string& exe_stem() const override { return m_exe; }
+        virtual std::array<int, 3> default_min_version() const override { return {1, 3, 0}; }
+
+        virtual Optional<std::string> get_version(const fs::path& path_to_exe) const override
+        {
+            const auto rc = System::process_execute_and_capture_output(path_to_exe, {"-V"});
+            if (rc.exit_code != 0)
+            {
+                return nullopt;
+            }
+
+            /* Sample output:
+*** zstd command line interface 64-bits v1.4.4, by Yann Collet ***
+                */
+            const auto idx = rc.output.find(" v");
+            if (idx == std::string::npos) return nullopt;
+            const auto end = rc.output.find(',', idx);
+            return rc.output.substr(idx + 2, end == std::string::npos ? std::string::npos : end - idx - 2);
+        }
+    };
+
     struct IfwInstallerBaseProvider : ToolProvider
     {
         std::string m_exe = "";
@@ -416,8 +605,7 @@ git version 2.17.1.windows.2
 
         virtual Optional<std::string> get_version(const fs::path& path_to_exe) const override
         {
-            const std::string cmd = Strings::format(R"("%s" --framework-version)", path_to_exe.u8string());
-            const auto rc = System::cmd_execute_and_capture_output(cmd);
+            const auto rc = System::process_execute_and_capture_output(path_to_exe, {"--framework-version"});
             if (rc.exit_code != 0)
             {
                 return nullopt;
@@ -443,7 +631,7 @@ git version 2.17.1.windows.2
                 // location.
                 if (tool == Tools::SEVEN_ZIP) return get_7za_path(paths);
                 if (tool == Tools::CMAKE || tool == Tools::GIT || tool == Tools::NINJA || tool == Tools::NUGET ||
-                    tool == Tools::IFW_INSTALLER_BASE)
+                    tool == Tools::ZSTD || tool == Tools::IFW_INSTALLER_BASE)
                     return get_tool_pathversion(paths, tool).path;
                 if (tool == Tools::IFW_BINARYCREATOR)
                     return get_tool_path(paths, Tools::IFW_INSTALLER_BASE).parent_path() / "binarycreator.exe";
@@ -488,6 +676,7 @@ git version 2.17.1.windows.2
                     return get_path(paths, NinjaProvider());
                 }
                 if (tool == Tools::NUGET) return get_path(paths, NuGetProvider());
+                if (tool == Tools::ZSTD) return get_path(paths, ZstdProvider());
                 if (tool == Tools::IFW_INSTALLER_BASE) return get_path(paths, IfwInstallerBaseProvider());
 
                 Checks::exit_with_message(VCPKG_LINE_INFO, "Finding version for %s is not implemented yet.", tool);
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include <vcpkg/base/strings.h>
+#include <vcpkg/base/util.h>
 #include <vcpkg/triplet.h>
 
 namespace vcpkg
@@ -28,7 +29,8 @@ namespace std
 
 namespace vcpkg
 {
-    static std::unordered_set<TripletInstance> g_triplet_instances;
+    // Locked like the port names in packagespec.cpp, since package paragraphs are parsed on several threads
+    static Util::LockGuarded<std::unordered_set<TripletInstance>> g_triplet_instances;
 
     const Triplet Triplet::X86_WINDOWS = from_canonical_name("x86-windows");
     const Triplet Triplet::X64_WINDOWS = from_canonical_name("x64-windows");
@@ -46,7 +48,7 @@ namespace vcpkg
     Triplet Triplet::from_canonical_name(const std::string& triplet_as_string)
     {
         std::string s(Strings::ascii_to_lowercase(triplet_as_string));
-        const auto p = g_triplet_instances.emplace(std::move(s));
+        const auto p = g_triplet_instances.lock()->emplace(std::move(s));
         return &*p.first;
     }
 
@@ -0,0 +1,452 @@
+#include "pch.h"
+
+#include <vcpkg/base/strings.h>
+#include <vcpkg/tripletenvironment.h>
+
+#include <regex>
+
+namespace vcpkg::TripletEnvironment
+{
+    namespace
+    {
+        struct RawArgument
+        {
+            /// <summary>As written, with its escapes and variable references, and without the quotes</summary>
+            std::string text;
+            bool quoted;
+        };
+
+        struct Command
+        {
+            /// <summary>In lowercase, since command names are case-insensitive</summary>
+            std::string name;
+            std::vector<RawArgument> arguments;
+        };
+
+        struct Argument
+        {
+            std::string value;
+            bool quoted;
+        };
+
+        struct Branch
+        {
+            bool parent_active;
+            /// <summary>Whether one of the branches of this if() so far was taken</summary>
+            bool taken;
+            bool active;
+        };
+
+        struct State
+        {
+            std::map<std::string, std::string> variables;
+            std::vector<std::string> output;
+            fs::path triplet_file;
+            const std::string* triplet;
+            bool in_triplet = false;
+        };
+    }
+
+    static bool is_space(const char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    static bool is_identifier_char(const char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+    }
+
+    /// <summary>Whether a bracket argument or comment, such as [[ or [==[, starts at `pos`</summary>
+    static bool is_bracket_open(const std::string& text, size_t pos)
+    {
+        if (pos >= text.size() || text[pos] != '[') return false;
+        ++pos;
+        while (pos < text.size() && text[pos] == '=')
+            ++pos;
+        return pos < text.size() && text[pos] == '[';
+    }
+
+    static void skip_line_comment(const std::string& text, size_t& pos)
+    {
+        while (pos < text.size() && text[pos] != '\n')
+            ++pos;
+    }
+
+    /// <summary>Splits `text` into commands; false for syntax that is not handled here</summary>
+    static bool parse_commands(const std::string& text, std::vector<Command>& commands)
+    {
+        size_t pos = 0;
+        while (true)
+        {
+            while (pos < text.size() && is_space(text[pos]))
+                ++pos;
+            if (pos == text.size()) return true;
+
+            if (text[pos] == '#')
+            {
+                if (is_bracket_open(text, pos + 1)) return false;
+                skip_line_comment(text, pos);
+                continue;
+            }
+
+            Command command;
+            while (pos < text.size() && is_identifier_char(text[pos]))
+                command.name.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(text[pos++]))));
+            if (command.name.empty()) return false;
+            while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t'))
+                ++pos;
+            if (pos == text.size() || text[pos] != '(') return false;
+            ++pos;
+
+            while (true)
+            {
+                while (pos < text.size() && is_space(text[pos]))
+                    ++pos;
+                if (pos == text.size()) return false;
+
+                const char c = text[pos];
+                if (c == ')')
+                {
+                    ++pos;
+                    break;
+                }
+                if (c == '(' || is_bracket_open(text, pos)) return false;
+                if (c == '#')
+                {
+                    if (is_bracket_open(text, pos + 1)) return false;
+                    skip_line_comment(text, pos);
+                    continue;
+                }
+
+                RawArgument argument{"", c == '"'};
+                if (argument.quoted)
+                {
+                    ++pos;
+                    while (pos < text.size() && text[pos] != '"')
+                    {
+                        if (text[pos] == '\\' && pos + 1 < text.size()) argument.text.push_back(text[pos++]);
+                        argument.text.push_back(text[pos++]);
+                    }
+                    if (pos == text.size()) return false;
+                    ++pos;
+                }
+                else
+                {
+                    while (pos < text.size() && !is_space(text[pos]) && text[pos] != '(' && text[pos] != ')' &&
+                           text[pos] != '#')
+                    {
+                        // A quote inside an unquoted argument is legacy syntax
+                        if (text[pos] == '"') return false;
+                        if (text[pos] == '\\' && pos + 1 < text.size()) argument.text.push_back(text[pos++]);
+                        argument.text.push_back(text[pos++]);
+                    }
+                }
+                command.arguments.push_back(std::move(argument));
+            }
+
+            commands.push_back(std::move(command));
+        }
+    }
+
+    /// <summary>
+    /// Whether an unquoted `name` that was not set here is certainly not set by CMake either, so that if() takes it
+    /// as a string: PORT, which only builds set, vcpkg's own variables, and anything that is not in uppercase.
+    /// </summary>
+    static bool is_known_unset(const std::string& name)
+    {
+        if (name == "PORT" || name.compare(0, 6, "VCPKG_") == 0) return true;
+        return std::any_of(name.begin(), name.end(), [](char c) {
+            return !(c >= 'A' && c <= 'Z') && !(c >= '0' && c <= '9') && c != '_';
+        });
+    }
+
+    /// <summary>
+    /// Resolves the escapes and variable references of `argument`. Other variables that were not set here are not
+    /// expanded, since CMake defines some of its own.
+    /// </summary>
+    static Optional<std::string> expand(const RawArgument& argument, const State& state)
+    {
+        const std::string& text = argument.text;
+        std::string value;
+        for (size_t i = 0; i < text.size(); ++i)
+        {
+            const char c = text[i];
+            if (c == '\\')
+            {
+                if (++i == text.size()) return nullopt;
+                const char escaped = text[i];
+                switch (escaped)
+                {
+                    case 'n': value.push_back('\n'); break;
+                    case 't': value.push_back('\t'); break;
+                    case 'r': value.push_back('\r'); break;
+                    case '\n':
+                        // A line continuation in a quoted argument
+                        if (!argument.quoted) return nullopt;
+                        break;
+                    case ';': return nullopt;
+                    default:
+                        if (is_identifier_char(escaped)) return nullopt;
+                        value.push_back(escaped);
+                }
+            }
+            else if (c == '$' && i + 1 < text.size() && text[i + 1] == '{')
+            {
+                const size_t end = text.find('}', i + 2);
+                if (end == std::string::npos) return nullopt;
+                const std::string name = text.substr(i + 2, end - i - 2);
+                if (name.find_first_of("${") != std::string::npos) return nullopt;
+                const auto it = state.variables.find(name);
+                if (it != state.variables.end())
+                    value.append(it->second);
+                else if (!is_known_unset(name))
+                    return nullopt;
+                i = end;
+            }
+            else if (c == '$' && text.compare(i, 5, "$ENV{") == 0)
+            {
+                return nullopt;
+            }
+            else
+            {
+                value.push_back(c);
+            }
+        }
+
+        // Unquoted arguments are split into lists at semicolons, which is not done here
+        if (!argument.quoted && value.find(';') != std::string::npos) return nullopt;
+        return value;
+    }
+
+    static bool expand_arguments(const Command& command, const State& state, std::vector<Argument>& arguments)
+    {
+        for (auto&& raw : command.arguments)
+        {
+            auto maybe_value = expand(raw, state);
+            auto p_value = maybe_value.get();
+            if (!p_value) return false;
+            // Unquoted arguments that expand to nothing are dropped
+            if (!raw.quoted && p_value->empty()) continue;
+            arguments.push_back({std::move(*p_value), raw.quoted});
+        }
+        return true;
+    }
+
+    /// <summary>The string an operand of STREQUAL or MATCHES stands for</summary>
+    static Optional<std::string> operand_value(const Argument& argument, const State& state)
+    {
+        const auto it = state.variables.find(argument.value);
+        if (argument.quoted)
+        {
+            // Whether CMake dereferences a quoted variable name depends on policy CMP0054
+            if (it != state.variables.end()) return nullopt;
+            return argument.value;
+        }
+
+        if (it != state.variables.end()) return it->second;
+        if (!is_known_unset(argument.value)) return nullopt;
+        return argument.value;
+    }
+
+    /// <summary>Whether if() takes a variable holding `value` as false</summary>
+    static bool is_false_value(const std::string& value)
+    {
+        static constexpr const char* FALSE_CONSTANTS[] = {"0", "OFF", "NO", "FALSE", "N", "IGNORE", "NOTFOUND", ""};
+        for (const char* constant : FALSE_CONSTANTS)
+        {
+            if (Strings::case_insensitive_ascii_equals(value, constant)) return true;
+        }
+        return Strings::ends_with(value, "-NOTFOUND");
+    }
+
+    static Optional<bool> evaluate_condition(const std::vector<Argument>& arguments, const State& state)
+    {
+        size_t first = 0;
+        bool negate = false;
+        if (!arguments.empty() && !arguments[0].quoted && arguments[0].value == "NOT")
+        {
+            negate = true;
+            first = 1;
+        }
+
+        Optional<bool> result;
+        const size_t count = arguments.size() - first;
+        if (count == 1)
+        {
+            const Argument& argument = arguments[first];
+            if (argument.quoted) return nullopt;
+
+            // The script sets no policies, so under the old behavior of CMP0012 only 0 and 1 are constants; ON, TRUE
+            // and any other word are variable names
+            if (argument.value == "0" || argument.value == "1")
+            {
+                result = argument.value == "1";
+            }
+            else
+            {
+                const auto it = state.variables.find(argument.value);
+                if (it != state.variables.end())
+                    result = !is_false_value(it->second);
+                else if (is_known_unset(argument.value))
+                    result = false;
+            }
+        }
+        else if (count == 3 && !arguments[first + 1].quoted)
+        {
+            const std::string& op = arguments[first + 1].value;
+            const auto maybe_left = operand_value(arguments[first], state);
+            const auto p_left = maybe_left.get();
+            if (!p_left) return nullopt;
+
+            if (op == "STREQUAL")
+            {
+                const auto maybe_right = operand_value(arguments[first + 2], state);
+                const auto p_right = maybe_right.get();
+                if (!p_right) return nullopt;
+                result = *p_left == *p_right;
+            }
+            else if (op == "MATCHES")
+            {
+                // The expression itself is never a variable name; CMake's syntax is a subset of ECMAScript's
+                try
+                {
+                    result = std::regex_search(*p_left, std::regex(arguments[first + 2].value));
+                }
+                catch (const std::regex_error&)
+                {
+                    return nullopt;
+                }
+            }
+        }
+
+        const auto p_result = result.get();
+        if (!p_result) return nullopt;
+        return negate != *p_result;
+    }
+
+    static bool evaluate(const std::string& text, const fs::path& file, State& state)
+    {
+        std::vector<Command> commands;
+        if (!parse_commands(text, commands)) return false;
+
+        state.variables["CMAKE_CURRENT_LIST_FILE"] = file.generic_u8string();
+        state.variables["CMAKE_CURRENT_LIST_DIR"] = file.parent_path().generic_u8string();
+
+        std::vector<Branch> branches;
+        const auto is_active = [&]() { return branches.empty() || branches.back().active; };
+        for (auto&& command : commands)
+        {
+            const bool active = is_active();
+            std::vector<Argument> arguments;
+            if (active || command.name == "elseif")
+            {
+                if (!expand_arguments(command, state, arguments)) return false;
+            }
+
+            if (command.name == "if")
+            {
+                Branch branch{active, false, false};
+                if (active)
+                {
+                    const auto maybe_condition = evaluate_condition(arguments, state);
+                    const auto p_condition = maybe_condition.get();
+                    if (!p_condition) return false;
+                    branch.active = branch.taken = *p_condition;
+                }
+                branches.push_back(branch);
+            }
+            else if (command.name == "elseif")
+            {
+                if (branches.empty()) return false;
+                Branch& branch = branches.back();
+                branch.active = false;
+                if (branch.parent_active && !branch.taken)
+                {
+                    const auto maybe_condition = evaluate_condition(arguments, state);
+                    const auto p_condition = maybe_condition.get();
+                    if (!p_condition) return false;
+                    branch.active = branch.taken = *p_condition;
+                }
+            }
+            else if (command.name == "else")
+            {
+                if (branches.empty()) return false;
+                Branch& branch = branches.back();
+                branch.active = branch.parent_active && !branch.taken;
+                branch.taken = true;
+            }
+            else if (command.name == "endif")
+            {
+                if (branches.empty()) return false;
+                branches.pop_back();
+            }
+            else if (!active)
+            {
+                continue;
+            }
+            else if (command.name == "set")
+            {
+                if (arguments.empty()) return false;
+                for (size_t i = 1; i < arguments.size(); ++i)
+                {
+                    if (!arguments[i].quoted && (arguments[i].value == "PARENT_SCOPE" || arguments[i].value == "CACHE"))
+                        return false;
+                }
+
+                if (arguments.size() == 1)
+                {
+                    state.variables.erase(arguments[0].value);
+                    continue;
+                }
+
+                std::string value = arguments[1].value;
+                for (size_t i = 2; i < arguments.size(); ++i)
+                {
+                    value.push_back(';');
+                    value.append(arguments[i].value);
+                }
+                state.variables[arguments[0].value] = std::move(value);
+            }
+            else if (command.name == "message")
+            {
+                // The modes print other prefixes or to other streams, if at all
+                if (!arguments.empty() && !arguments[0].quoted && !is_known_unset(arguments[0].value)) return false;
+
+                std::string message;
+                for (auto&& argument : arguments)
+                    message.append(argument.value);
+                for (auto&& line : Strings::split(message, "\n"))
+                    state.output.push_back(std::move(line));
+            }
+            else if (command.name == "include")
+            {
+                if (state.in_triplet || arguments.size() != 1 ||
+                    arguments[0].value != state.variables["CMAKE_TRIPLET_FILE"])
+                    return false;
+
+                state.in_triplet = true;
+                if (!evaluate(*state.triplet, state.triplet_file, state)) return false;
+                state.in_triplet = false;
+                state.variables["CMAKE_CURRENT_LIST_FILE"] = file.generic_u8string();
+                state.variables["CMAKE_CURRENT_LIST_DIR"] = file.parent_path().generic_u8string();
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        return branches.empty();
+    }
+
+    Optional<std::vector<std::string>> try_evaluate(const fs::path& script_file,
+                                                    const std::string& script,
+                                                    const fs::path& triplet_file,
+                                                    const std::string& triplet)
+    {
+        State state;
+        state.triplet_file = triplet_file;
+        state.triplet = &triplet;
+        state.variables["CMAKE_TRIPLET_FILE"] = triplet_file.u8string();
+        if (!evaluate(script, script_file, state)) return nullopt;
+        return std::move(state.output);
+    }
+}
@@ -1,6 +1,8 @@
 #include "pch.h"
 
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/threadpool.h>
+#include <vcpkg/build.h>
 #include <vcpkg/commands.h>
 #include <vcpkg/help.h>
 #include <vcpkg/paragraphs.h>
@@ -42,36 +44,144 @@ namespace vcpkg::Update
         return output;
     }
 
+    std::vector<OutdatedPackage> find_outdated_packages(const VcpkgPaths& paths, const StatusParagraphs& status_db)
+    {
+        auto installed_packages = get_installed_ports(status_db);
+
+        auto names = Util::fmap(installed_packages, [](const InstalledPackageView& ipv) { return ipv.spec().name(); });
+        Util::sort_unique_erase(names);
+        const auto port_versions = Paragraphs::get_port_versions(paths.get_filesystem(), paths.ports, names);
+
+        std::vector<OutdatedPackage> output;
+        for (auto&& ipv : installed_packages)
+        {
+            const auto& pgh = ipv.core;
+            const auto it = port_versions.find(pgh->package.spec.name());
+            if (it == port_versions.end()) continue; // No portfile available
+
+            auto&& installed_version = pgh->package.version;
+            if (installed_version != it->second)
+            {
+                output.push_back({pgh->package.spec, VersionDiff(installed_version, it->second)});
+            }
+        }
+
+        return output;
+    }
+
+    /// <summary>The "port_files" entry of the abi info installed with the package, if it was built with one</summary>
+    static Optional<std::string> get_installed_port_files_hash(const VcpkgPaths& paths, const PackageSpec& spec)
+    {
+        static constexpr std::string_view PORT_FILES_KEY = "port_files ";
+
+        const auto abi_info_file =
+            paths.installed / spec.triplet().canonical_name() / "share" / spec.name() / "vcpkg_abi_info.txt";
+        const auto maybe_lines = paths.get_filesystem().read_lines(abi_info_file);
+        if (const auto lines = maybe_lines.get())
+        {
+            for (auto&& line : *lines)
+            {
+                if (line.compare(0, PORT_FILES_KEY.size(), PORT_FILES_KEY) == 0)
+                {
+                    return Strings::trim(line.substr(PORT_FILES_KEY.size()));
+                }
+            }
+        }
+
+        return nullopt;
+    }
+
+    std::vector<OutdatedPackage> find_packages_with_changed_port_files(const VcpkgPaths& paths,
+                                                                       const StatusParagraphs& status_db)
+    {
+        auto& fs = paths.get_filesystem();
+        const auto installed_packages = get_installed_ports(status_db);
+
+        // Each port is hashed once, whatever the number of triplets it is installed for
+        auto names = Util::fmap(installed_packages, [](const InstalledPackageView& ipv) { return ipv.spec().name(); });
+        Util::sort_unique_erase(names);
+        const auto port_hashes = ThreadPool::parallel_transform(names, [&](const std::string& name) {
+            const auto port_dir = paths.port_dir(name);
+            return fs.exists(port_dir / "CONTROL") ? Build::hash_port_files(fs, port_dir) : std::string();
+        });
+
+        std::vector<OutdatedPackage> output;
+        for (auto&& ipv : installed_packages)
+        {
+            const auto& pgh = ipv.core;
+            const auto& spec = pgh->package.spec;
+            const auto name_index = std::lower_bound(names.begin(), names.end(), spec.name()) - names.begin();
+            const std::string& port_hash = port_hashes[name_index];
+            if (port_hash.empty()) continue; // No portfile available
+
+            const auto maybe_installed_hash = get_installed_port_files_hash(paths, spec);
+            const auto installed_hash = maybe_installed_hash.get();
+            if (installed_hash && *installed_hash != port_hash)
+            {
+                output.push_back({spec, VersionDiff(pgh->package.version, pgh->package.version)});
+            }
+        }
+
+        return output;
+    }
+
+    static constexpr StringLiteral OPTION_PORT_FILES = "--x-port-files";
+
+    static constexpr std::array<CommandSwitch, 1> UPDATE_SWITCHES = {{
+        {OPTION_PORT_FILES, "Also report packages whose port files changed since they were built (experimental)"},
+    }};
+
     const CommandStructure COMMAND_STRUCTURE = {
         Help::create_example_string("update"),
         0,
         0,
-        {},
+        {UPDATE_SWITCHES, {}},
         nullptr,
     };
 
     void perform_and_exit(const VcpkgCmdArguments& args, const VcpkgPaths& paths)
     {
-        args.parse_arguments(COMMAND_STRUCTURE);
+        const ParsedArguments options = args.parse_arguments(COMMAND_STRUCTURE);
         System::println("Using local portfile versions. To update the local portfiles, use `git pull`.");
 
         const StatusParagraphs status_db = database_load_check(paths);
 
-        Dependencies::PathsPortFileProvider provider(paths);
-
-        const auto outdated_packages = SortedVector<OutdatedPackage>(find_outdated_packages(provider, status_db),
+        const auto outdated_packages = SortedVector<OutdatedPackage>(find_outdated_packages(paths, status_db),
                                                                      &OutdatedPackage::compare_by_name);
 
-        if (outdated_packages.empty())
+        std::vector<OutdatedPackage> changed_packages;
+        if (Util::Sets::contains(options.switches, OPTION_PORT_FILES))
+        {
+            changed_packages = find_packages_with_changed_port_files(paths, status_db);
+            Util::erase_remove_if(changed_packages, [&](const OutdatedPackage& changed) {
+                return std::any_of(outdated_packages.begin(),
+                                   outdated_packages.end(),
+                                   [&](const OutdatedPackage& outdated) { return outdated.spec == changed.spec; });
+            });
+            std::sort(changed_packages.begin(), changed_packages.end(), &OutdatedPackage::compare_by_name);
+        }
+
+        if (outdated_packages.empty() && changed_packages.empty())
         {
             System::println("No packages need updating.");
         }
         else
         {
-            System::println("The following packages differ from their port versions:");
-            for (auto&& package : outdated_packages)
+            if (!outdated_packages.empty())
             {
-                System::println("    %-32s %s", package.spec, package.version_diff.to_string());
+                System::println("The following packages differ from their port versions:");
+                for (auto&& package : outdated_packages)
+                {
+                    System::println("    %-32s %s", package.spec, package.version_diff.to_string());
+                }
+            }
+            if (!changed_packages.empty())
+            {
+                System::println("The following packages were built from port files that changed since:");
+                for (auto&& package : changed_packages)
+                {
+                    System::println("    %-32s %s", package.spec, package.version_diff.left.to_string());
+                }
             }
             System::println("\n"
                             "To update these packages and all dependencies, run\n"
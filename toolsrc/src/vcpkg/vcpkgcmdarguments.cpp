@@ -101,9 +101,10 @@ namespace vcpkg
 
             if (arg[0] == '-' && arg[1] == '-')
             {
-                // make argument case insensitive
+                // make argument case insensitive, but keep the case of values such as paths and git revisions
                 auto& f = std::use_facet<std::ctype<char>>(std::locale());
-                f.tolower(&arg[0], &arg[0] + arg.size());
+                const auto name_end = std::min(arg.find('='), arg.size());
+                f.tolower(&arg[0], &arg[0] + name_end);
                 // command switch
                 if (arg == "--vcpkg-root")
                 {
@@ -162,8 +163,65 @@ namespace vcpkg
                     parse_switch(false, "binarycaching", args.binarycaching);
                     continue;
                 }
+                if (arg == "--x-fs-stats")
+                {
+                    parse_switch(true, "x-fs-stats", args.fs_stats);
+                    continue;
+                }
+                if (arg == "--x-alloc-stats")
+                {
+                    parse_switch(true, "x-alloc-stats", args.alloc_stats);
+                    continue;
+                }
 
                 const auto eq_pos = arg.find('=');
+                if (eq_pos != std::string::npos && arg.compare(0, eq_pos, "--x-trace-file") == 0)
+                {
+                    if (args.trace_file != nullptr)
+                    {
+                        System::println(System::Color::error, "Error: --x-trace-file specified multiple times");
+                        Help::print_usage();
+                        Checks::exit_fail(VCPKG_LINE_INFO);
+                    }
+                    args.trace_file = std::make_unique<std::string>(arg.substr(eq_pos + 1));
+                    continue;
+                }
+                if (eq_pos != std::string::npos && arg.compare(0, eq_pos, "--x-openmetrics-file") == 0)
+                {
+                    if (args.openmetrics_file != nullptr)
+                    {
+                        System::println(System::Color::error, "Error: --x-openmetrics-file specified multiple times");
+                        Help::print_usage();
+                        Checks::exit_fail(VCPKG_LINE_INFO);
+                    }
+                    args.openmetrics_file = std::make_unique<std::string>(arg.substr(eq_pos + 1));
+                    continue;
+                }
+                if (eq_pos != std::string::npos && arg.compare(0, eq_pos, "--x-process-log") == 0)
+                {
+                    if (args.process_log_file != nullptr)
+                    {
+                        System::println(System::Color::error, "Error: --x-process-log specified multiple times");
+                        Help::print_usage();
+                        Checks::exit_fail(VCPKG_LINE_INFO);
+                    }
+                    args.process_log_file = std::make_unique<std::string>(arg.substr(eq_pos + 1));
+                    continue;
+                }
+                if (eq_pos != std::string::npos && arg.compare(0, eq_pos, "--x-max-threads") == 0)
+                {
+                    const std::string value = arg.substr(eq_pos + 1);
+                    char* end;
+                    const unsigned long long max_threads = std::strtoull(value.c_str(), &end, 10);
+                    if (value.empty() || *end != '\0' || max_threads == 0)
+                    {
+                        System::println(System::Color::error, "Error: --x-max-threads must be a positive number");
+                        Help::print_usage();
+                        Checks::exit_fail(VCPKG_LINE_INFO);
+                    }
+                    args.max_threads = static_cast<size_t>(max_threads);
+                    continue;
+                }
                 if (eq_pos != std::string::npos)
                 {
                     args.optional_command_arguments.emplace(arg.substr(0, eq_pos), arg.substr(eq_pos + 1));
@@ -2,7 +2,10 @@
 
 #include <vcpkg/base/files.h>
 #include <vcpkg/base/strings.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/base/trace.h>
 #include <vcpkg/base/util.h>
+#include <vcpkg/install.h>
 #include <vcpkg/metrics.h>
 #include <vcpkg/paragraphs.h>
 #include <vcpkg/vcpkglib.h>
@@ -24,18 +27,218 @@ namespace vcpkg
             fs.rename(vcpkg_dir_status_file_old, vcpkg_dir_status_file);
         }
 
-        auto pghs = Paragraphs::get_paragraphs(fs, vcpkg_dir_status_file).value_or_exit(VCPKG_LINE_INFO);
+        const auto pghs = Paragraphs::get_paragraph_views(fs, vcpkg_dir_status_file).value_or_exit(VCPKG_LINE_INFO);
 
         std::vector<std::unique_ptr<StatusParagraph>> status_pghs;
-        for (auto&& p : pghs)
+        status_pghs.reserve(pghs.paragraphs.size());
+        for (auto&& p : pghs.paragraphs)
         {
-            status_pghs.push_back(std::make_unique<StatusParagraph>(std::move(p)));
+            status_pghs.push_back(std::make_unique<StatusParagraph>(p));
         }
 
         return StatusParagraphs(std::move(status_pghs));
     }
 
-    StatusParagraphs database_load_check(const VcpkgPaths& paths)
+    /// <summary>
+    /// The update files are a journal on top of the status file. The status file is only rewritten once this many
+    /// of them have accumulated, or when x-compact asks for it.
+    /// </summary>
+    static constexpr size_t STATUS_COMPACTION_THRESHOLD = 100;
+
+    static bool is_update_file(const fs::path& file)
+    {
+        const auto name = file.filename().u8string();
+        return !name.empty() && std::all_of(name.begin(), name.end(), [](char c) { return c >= '0' && c <= '9'; });
+    }
+
+    static std::unique_ptr<Files::FileLock> lock_vcpkg_dir(const VcpkgPaths& paths,
+                                                           const std::string& name,
+                                                           const bool wait)
+    {
+        auto& fs = paths.get_filesystem();
+        const fs::path locks_dir = paths.vcpkg_dir / "locks";
+        const fs::path lock_path = locks_dir / (name + ".lock");
+
+        std::error_code ec;
+        fs.create_directories(locks_dir, ec);
+
+        auto lock = fs.lock_file(lock_path, false, ec);
+        if (!lock && !ec && wait)
+        {
+            System::println("Waiting for another vcpkg process to release %s...", lock_path.u8string());
+            lock = fs.lock_file(lock_path, true, ec);
+        }
+        Checks::check_exit(VCPKG_LINE_INFO, !ec, "Failed to lock %s: %s", lock_path.u8string(), ec.message());
+        return lock;
+    }
+
+    std::unique_ptr<Files::FileLock> lock_vcpkg_dir(const VcpkgPaths& paths, const std::string& name)
+    {
+        return lock_vcpkg_dir(paths, name, true);
+    }
+
+    std::unique_ptr<Files::FileLock> try_lock_vcpkg_dir(const VcpkgPaths& paths, const std::string& name)
+    {
+        return lock_vcpkg_dir(paths, name, false);
+    }
+
+    static fs::path installed_summary_path(const VcpkgPaths& paths) { return paths.vcpkg_dir / "summary"; }
+
+    static constexpr StringLiteral INSTALLED_SUMMARY_HEADER = "vcpkg installed summary v1";
+
+    /// <summary>
+    /// Identifies the current contents of the status database: the size and write time of the status file and the
+    /// names of the pending update files. Every install, remove and compaction changes it.
+    /// </summary>
+    static std::string status_fingerprint(const VcpkgPaths& paths)
+    {
+        auto& fs = paths.get_filesystem();
+
+        std::string fingerprint = "none";
+        for (auto&& entry : fs.get_entries_non_recursive(paths.vcpkg_dir))
+        {
+            if (entry.path.filename() != paths.vcpkg_dir_status_file.filename()) continue;
+            fingerprint = Strings::format(
+                "%llu %lld",
+                static_cast<unsigned long long>(entry.size),
+                static_cast<long long>(entry.last_write_time.time_since_epoch().count()));
+        }
+
+        auto update_files = fs.get_files_non_recursive(paths.vcpkg_dir_updates);
+        Util::erase_remove_if(update_files, [](const fs::path& file) { return !is_update_file(file); });
+        Util::sort(update_files);
+        for (auto&& file : update_files)
+        {
+            fingerprint.push_back(' ');
+            fingerprint += file.filename().u8string();
+        }
+
+        return fingerprint;
+    }
+
+    static std::string escape_summary_field(const std::string& field)
+    {
+        std::string escaped;
+        escaped.reserve(field.size());
+        for (char c : field)
+        {
+            switch (c)
+            {
+                case '\\': escaped += "\\\\"; break;
+                case '\t': escaped += "\\t"; break;
+                case '\n': escaped += "\\n"; break;
+                case '\r': escaped += "\\r"; break;
+                default: escaped.push_back(c); break;
+            }
+        }
+        return escaped;
+    }
+
+    static std::string unescape_summary_field(std::string_view field)
+    {
+        std::string unescaped;
+        unescaped.reserve(field.size());
+        for (size_t i = 0; i < field.size(); ++i)
+        {
+            if (field[i] != '\\' || i + 1 == field.size())
+            {
+                unescaped.push_back(field[i]);
+                continue;
+            }
+
+            switch (field[++i])
+            {
+                case 't': unescaped.push_back('\t'); break;
+                case 'n': unescaped.push_back('\n'); break;
+                case 'r': unescaped.push_back('\r'); break;
+                default: unescaped.push_back(field[i]); break;
+            }
+        }
+        return unescaped;
+    }
+
+    /// <summary>
+    /// The lines of the summary after the header, keyed by display name. Nullopt when the file is missing, malformed,
+    /// or was written for another state of the status database than `fingerprint`.
+    /// </summary>
+    static Optional<std::map<std::string, std::string>> read_installed_summary_lines(const VcpkgPaths& paths,
+                                                                                    const std::string& fingerprint)
+    {
+        auto maybe_contents = paths.get_filesystem().read_contents(installed_summary_path(paths));
+        const auto contents = maybe_contents.get();
+        if (!contents) return nullopt;
+
+        const std::string header = Strings::format("%s\t%s\n", INSTALLED_SUMMARY_HEADER, fingerprint);
+        if (contents->compare(0, header.size(), header) != 0) return nullopt;
+
+        std::map<std::string, std::string> lines;
+        std::string_view rest = std::string_view(*contents).substr(header.size());
+        while (!rest.empty())
+        {
+            const size_t eol = rest.find('\n');
+            if (eol == std::string_view::npos) return nullopt;
+
+            const std::string_view line = rest.substr(0, eol);
+            const size_t tab = line.find('\t');
+            if (tab == std::string_view::npos) return nullopt;
+
+            lines.emplace(std::string(line.substr(0, tab)), std::string(line));
+            rest.remove_prefix(eol + 1);
+        }
+
+        return lines;
+    }
+
+    static std::string make_installed_summary_line(const StatusParagraph& pgh)
+    {
+        return Strings::format("%s\t%s\t%s",
+                               escape_summary_field(pgh.package.displayname()),
+                               escape_summary_field(pgh.package.version),
+                               escape_summary_field(pgh.package.description));
+    }
+
+    /// <summary>Replaces the summary with a temporary file and a rename, so readers never see half of it</summary>
+    static void write_installed_summary(const VcpkgPaths& paths,
+                                        const std::string& fingerprint,
+                                        const std::map<std::string, std::string>& lines)
+    {
+        auto& fs = paths.get_filesystem();
+        const fs::path summary_file = installed_summary_path(paths);
+        const fs::path summary_file_new = paths.vcpkg_dir / "summary-new";
+
+        std::string contents = Strings::format("%s\t%s\n", INSTALLED_SUMMARY_HEADER, fingerprint);
+        for (auto&& line : lines)
+        {
+            contents += line.second;
+            contents.push_back('\n');
+        }
+
+        std::error_code ec;
+        fs.write_contents(summary_file_new, contents, ec);
+        if (!ec) fs.rename(summary_file_new, summary_file, ec);
+        if (ec)
+        {
+            // `list` falls back to the status database without the summary
+            Debug::println("Failed to write %s: %s", summary_file.u8string(), ec.message());
+            fs.remove(summary_file, ec);
+        }
+    }
+
+    /// <summary>Rewrites the summary from `status_db` unless it is already current. Needs the status lock.</summary>
+    static void refresh_installed_summary(const VcpkgPaths& paths, const StatusParagraphs& status_db)
+    {
+        const std::string fingerprint = status_fingerprint(paths);
+        if (read_installed_summary_lines(paths, fingerprint)) return;
+
+        std::map<std::string, std::string> lines;
+        for (auto&& pgh : status_db)
+        {
+            if (pgh->is_installed()) lines.emplace(pgh->package.displayname(), make_installed_summary_line(*pgh));
+        }
+        write_installed_summary(paths, fingerprint, lines);
+    }
+
+    static StatusParagraphs load_database(const VcpkgPaths& paths, const bool force_compaction)
     {
         auto& fs = paths.get_filesystem();
 
@@ -47,6 +250,9 @@ namespace vcpkg
         fs.create_directory(paths.vcpkg_dir_info, ec);
         fs.create_directory(updates_dir, ec);
 
+        // Another process may be appending to the journal or compacting it
+        const auto status_lock = lock_vcpkg_dir(paths, "status");
+
         const fs::path& status_file = paths.vcpkg_dir_status_file;
         const fs::path status_file_old = status_file.parent_path() / "status-old";
         const fs::path status_file_new = status_file.parent_path() / "status-new";
@@ -54,49 +260,187 @@ namespace vcpkg
         StatusParagraphs current_status_db = load_current_database(fs, status_file, status_file_old);
 
         auto update_files = fs.get_files_non_recursive(updates_dir);
+        Util::erase_remove_if(update_files, [&](const fs::path& file) {
+            return !is_update_file(file) || !fs.is_regular_file(file);
+        });
         Util::sort(update_files);
-        if (update_files.empty())
-        {
-            // updates directory is empty, control file is up-to-date.
-            return current_status_db;
-        }
         for (auto&& file : update_files)
         {
-            if (!fs.is_regular_file(file)) continue;
-            if (file.filename() == "incomplete") continue;
-
-            auto pghs = Paragraphs::get_paragraphs(fs, file).value_or_exit(VCPKG_LINE_INFO);
-            for (auto&& p : pghs)
+            const auto pghs = Paragraphs::get_paragraph_views(fs, file).value_or_exit(VCPKG_LINE_INFO);
+            for (auto&& p : pghs.paragraphs)
             {
-                current_status_db.insert(std::make_unique<StatusParagraph>(std::move(p)));
+                current_status_db.insert(std::make_unique<StatusParagraph>(p));
             }
         }
 
-        fs.write_contents(status_file_new, Strings::serialize(current_status_db));
+        if (update_files.empty() || (!force_compaction && update_files.size() < STATUS_COMPACTION_THRESHOLD))
+        {
+            refresh_installed_summary(paths, current_status_db);
+            return current_status_db;
+        }
+
+        // Streamed out rather than built in memory; the rename keeps the old status file until the new one is complete
+        auto status_out = fs.open_for_write(status_file_new, ec);
+        if (status_out)
+        {
+            serialize(current_status_db, *status_out);
+            status_out->close(ec);
+        }
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           !ec,
+                           "error while writing file: %s: %s",
+                           status_file_new.u8string(),
+                           ec.message());
 
         fs.rename(status_file_new, status_file);
 
         for (auto&& file : update_files)
         {
-            if (!fs.is_regular_file(file)) continue;
-
             fs.remove(file);
         }
 
+        refresh_installed_summary(paths, current_status_db);
         return current_status_db;
     }
 
-    void write_update(const VcpkgPaths& paths, const StatusParagraph& p)
+    StatusParagraphs database_load_read_only(const Files::Filesystem& fs, const fs::path& installed)
     {
-        static int update_id = 0;
+        const fs::path vcpkg_dir = installed / "vcpkg";
+
+        std::vector<std::unique_ptr<StatusParagraph>> status_pghs;
+        const fs::path status_file = vcpkg_dir / "status";
+        if (fs.exists(status_file))
+        {
+            const auto pghs = Paragraphs::get_paragraph_views(fs, status_file).value_or_exit(VCPKG_LINE_INFO);
+            for (auto&& p : pghs.paragraphs)
+            {
+                status_pghs.push_back(std::make_unique<StatusParagraph>(p));
+            }
+        }
+        StatusParagraphs status_db(std::move(status_pghs));
+
+        auto update_files = fs.get_files_non_recursive(vcpkg_dir / "updates");
+        Util::erase_remove_if(update_files, [&](const fs::path& file) {
+            return !is_update_file(file) || !fs.is_regular_file(file);
+        });
+        Util::sort(update_files);
+        for (auto&& file : update_files)
+        {
+            const auto pghs = Paragraphs::get_paragraph_views(fs, file).value_or_exit(VCPKG_LINE_INFO);
+            for (auto&& p : pghs.paragraphs)
+            {
+                status_db.insert(std::make_unique<StatusParagraph>(p));
+            }
+        }
+
+        return status_db;
+    }
+
+    struct PreloadedDatabase
+    {
+        fs::path status_file;
+        std::unique_ptr<StatusParagraphs> status_db;
+    };
+
+    static PreloadedDatabase g_preloaded_database;
+
+    StatusParagraphs database_load_check(const VcpkgPaths& paths, InstalledBase installed_base)
+    {
+        if (installed_base == InstalledBase::MERGE && g_preloaded_database.status_db &&
+            g_preloaded_database.status_file == paths.vcpkg_dir_status_file)
+        {
+            StatusParagraphs preloaded = std::move(*g_preloaded_database.status_db);
+            g_preloaded_database.status_db.reset();
+            return preloaded;
+        }
+
+        StatusParagraphs status_db = load_database(paths, false);
+        if (installed_base == InstalledBase::IMPORT)
+            Install::import_installed_base(paths, status_db);
+        else
+            Install::merge_installed_base(paths, status_db);
+        return status_db;
+    }
+
+    void database_preload(const VcpkgPaths& paths)
+    {
+        g_preloaded_database.status_db.reset();
+        auto status_db = std::make_unique<StatusParagraphs>(load_database(paths, false));
+        Install::merge_installed_base(paths, *status_db);
+        g_preloaded_database = {paths.vcpkg_dir_status_file, std::move(status_db)};
+    }
+
+    void database_compact(const VcpkgPaths& paths) { load_database(paths, true); }
+
+    void write_update(const VcpkgPaths& paths, Span<const StatusParagraph> pghs)
+    {
+        Trace::Scope trace("status", "write update");
+
         auto& fs = paths.get_filesystem();
+        const auto status_lock = lock_vcpkg_dir(paths, "status");
+
+        // Update files that were not compacted yet are still pending, so continue after the newest of them. Other
+        // processes may have added some since the last update, so the directory is read again every time.
+        int my_update_id = 0;
+        for (auto&& file : fs.get_files_non_recursive(paths.vcpkg_dir_updates))
+        {
+            if (is_update_file(file)) my_update_id = std::max(my_update_id, std::stoi(file.filename().u8string()) + 1);
+        }
 
-        const auto my_update_id = update_id++;
         const auto tmp_update_filename = paths.vcpkg_dir_updates / "incomplete";
         const auto update_filename = paths.vcpkg_dir_updates / Strings::format("%010d", my_update_id);
 
-        fs.write_contents(tmp_update_filename, Strings::serialize(p));
+        std::string contents;
+        for (auto&& pgh : pghs)
+        {
+            serialize(pgh, contents);
+            contents.push_back('\n');
+        }
+
+        // The summary is patched only if it is current; otherwise the next load of the database rebuilds it
+        auto summary_lines = read_installed_summary_lines(paths, status_fingerprint(paths));
+
+        fs.write_contents(tmp_update_filename, contents);
         fs.rename(tmp_update_filename, update_filename);
+
+        auto lines = summary_lines.get();
+        if (!lines)
+        {
+            std::error_code ec;
+            fs.remove(installed_summary_path(paths), ec);
+            return;
+        }
+
+        for (auto&& pgh : pghs)
+        {
+            if (pgh.is_installed())
+                lines->insert_or_assign(pgh.package.displayname(), make_installed_summary_line(pgh));
+            else
+                lines->erase(pgh.package.displayname());
+        }
+        write_installed_summary(paths, status_fingerprint(paths), *lines);
+    }
+
+    Optional<std::vector<InstalledSummaryEntry>> try_load_installed_summary(const VcpkgPaths& paths)
+    {
+        const auto maybe_lines = read_installed_summary_lines(paths, status_fingerprint(paths));
+        const auto lines = maybe_lines.get();
+        if (!lines) return nullopt;
+
+        std::vector<InstalledSummaryEntry> entries;
+        entries.reserve(lines->size());
+        for (auto&& line : *lines)
+        {
+            const std::string_view text = line.second;
+            const size_t first_tab = text.find('\t');
+            const size_t second_tab = text.find('\t', first_tab + 1);
+            if (second_tab == std::string_view::npos) return nullopt;
+
+            entries.push_back({unescape_summary_field(text.substr(0, first_tab)),
+                               unescape_summary_field(text.substr(first_tab + 1, second_tab - first_tab - 1)),
+                               unescape_summary_field(text.substr(second_tab + 1))});
+        }
+        return entries;
     }
 
     static void upgrade_to_slash_terminated_sorted_format(Files::Filesystem& fs,
@@ -197,11 +541,62 @@ namespace vcpkg
         return Util::fmap(ipv_map, [](auto&& p) -> InstalledPackageView { return std::move(p.second); });
     }
 
-    std::vector<StatusParagraphAndAssociatedFiles> get_installed_files(const VcpkgPaths& paths,
-                                                                       const StatusParagraphs& status_db)
+    std::unordered_map<PackageSpec, std::vector<PackageSpec>> get_installed_dependents(
+        const std::vector<InstalledPackageView>& installed_ports)
+    {
+        std::unordered_map<PackageSpec, std::vector<PackageSpec>> dependents;
+        for (auto&& ipv : installed_ports)
+        {
+            for (auto&& dependency : ipv.dependencies())
+            {
+                dependents[dependency].push_back(ipv.spec());
+            }
+        }
+        return dependents;
+    }
+
+    SortedVector<std::string> get_installed_files(const VcpkgPaths& paths, const StatusParagraph& pgh)
     {
         auto& fs = paths.get_filesystem();
 
+        fs::path listfile_path = paths.listfile_path(pgh.package);
+        // The packages merged from VCPKG_INSTALLED_BASE keep their listfiles there
+        const bool is_in_base = !paths.installed_base.empty() && !fs.exists(listfile_path);
+        if (is_in_base) listfile_path = paths.installed_base / "vcpkg" / "info" / listfile_path.filename();
+        const auto file = fs.map_contents(listfile_path).value_or_exit(VCPKG_LINE_INFO);
+        const std::string_view contents = file->contents();
+
+        // The first line tells the format: in the current one, which install writes, it is the directory of the
+        // triplet. Such listfiles are sorted and hold no blank lines, so only the directories are left out.
+        const size_t first_end = contents.find('\n');
+        if (first_end != std::string_view::npos && first_end != 0 && contents[first_end - 1] == '/')
+        {
+            std::vector<std::string> files;
+            for (size_t begin = first_end + 1; begin < contents.size();)
+            {
+                const auto end = std::min(contents.find('\n', begin), contents.size());
+                if (end != begin && contents[end - 1] != '/') files.emplace_back(contents.substr(begin, end - begin));
+                begin = end + 1;
+            }
+            return SortedVector<std::string>(std::move(files));
+        }
+
+        std::vector<std::string> installed_files_of_current_pgh =
+            fs.read_lines(listfile_path).value_or_exit(VCPKG_LINE_INFO);
+        Strings::trim_all_and_remove_whitespace_strings(&installed_files_of_current_pgh);
+        // The shared tree is never written to
+        if (!is_in_base) upgrade_to_slash_terminated_sorted_format(fs, &installed_files_of_current_pgh, listfile_path);
+
+        // Remove the directories
+        Util::erase_remove_if(installed_files_of_current_pgh,
+                              [](const std::string& file) { return file.back() == '/'; });
+
+        return SortedVector<std::string>(std::move(installed_files_of_current_pgh));
+    }
+
+    std::vector<StatusParagraphAndAssociatedFiles> get_installed_files(const VcpkgPaths& paths,
+                                                                       const StatusParagraphs& status_db)
+    {
         std::vector<StatusParagraphAndAssociatedFiles> installed_files;
 
         for (const std::unique_ptr<StatusParagraph>& pgh : status_db)
@@ -211,18 +606,7 @@ namespace vcpkg
                 continue;
             }
 
-            const fs::path listfile_path = paths.listfile_path(pgh->package);
-            std::vector<std::string> installed_files_of_current_pgh =
-                fs.read_lines(listfile_path).value_or_exit(VCPKG_LINE_INFO);
-            Strings::trim_all_and_remove_whitespace_strings(&installed_files_of_current_pgh);
-            upgrade_to_slash_terminated_sorted_format(fs, &installed_files_of_current_pgh, listfile_path);
-
-            // Remove the directories
-            Util::erase_remove_if(installed_files_of_current_pgh,
-                                  [](const std::string& file) { return file.back() == '/'; });
-
-            StatusParagraphAndAssociatedFiles pgh_and_files = {
-                *pgh, SortedVector<std::string>(std::move(installed_files_of_current_pgh))};
+            StatusParagraphAndAssociatedFiles pgh_and_files = {*pgh, get_installed_files(paths, *pgh)};
             installed_files.push_back(std::move(pgh_and_files));
         }
 
@@ -232,7 +616,19 @@ namespace vcpkg
     std::string shorten_text(const std::string& desc, const size_t length)
     {
         Checks::check_exit(VCPKG_LINE_INFO, length >= 3);
-        auto simple_desc = std::regex_replace(desc, std::regex("\\s+"), " ");
+        // Collapse every run of whitespace into a single space; this is called for each line of list and search
+        std::string simple_desc;
+        simple_desc.reserve(desc.size());
+        bool in_whitespace = false;
+        for (const char c : desc)
+        {
+            const bool is_whitespace = c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+            if (!is_whitespace)
+                simple_desc.push_back(c);
+            else if (!in_whitespace)
+                simple_desc.push_back(' ');
+            in_whitespace = is_whitespace;
+        }
         return simple_desc.size() <= length ? simple_desc : simple_desc.substr(0, length - 3) + "...";
     }
 }
@@ -1,18 +1,51 @@
 #include "pch.h"
 
+#include <vcpkg/base/downloads.h>
 #include <vcpkg/base/expected.h>
 #include <vcpkg/base/files.h>
+#include <vcpkg/base/hash.h>
 #include <vcpkg/base/system.h>
+#include <vcpkg/base/threadpool.h>
 #include <vcpkg/base/util.h>
 #include <vcpkg/build.h>
 #include <vcpkg/commands.h>
 #include <vcpkg/metrics.h>
 #include <vcpkg/packagespec.h>
+#include <vcpkg/paragraphs.h>
 #include <vcpkg/vcpkgpaths.h>
 #include <vcpkg/visualstudio.h>
 
 namespace vcpkg
 {
+    /// <summary>The existing directory named by the environment variable `varname`, or else `default_path`.</summary>
+    static Expected<fs::path> get_directory_override(const CStringView varname,
+                                                     const std::string& description,
+                                                     const fs::path& default_path)
+    {
+        const auto maybe_override = System::get_environment_variable(varname);
+        const auto p_override = maybe_override.get();
+        if (!p_override) return default_path;
+
+        auto as_path = fs::u8path(*p_override);
+        if (!fs::stdfs::is_directory(as_path))
+        {
+            const std::string error = Strings::format("Invalid %s override directory.", varname.c_str());
+            Metrics::g_metrics.lock()->track_property("error", error);
+            Checks::exit_with_message(VCPKG_LINE_INFO,
+                                      "Invalid %s override directory: %s; "
+                                      "create that directory or unset %s to use the default %s location.",
+                                      description,
+                                      as_path.u8string(),
+                                      varname.c_str(),
+                                      description);
+        }
+
+        std::error_code ec;
+        auto canonical = fs::stdfs::canonical(std::move(as_path), ec);
+        if (ec) return ec;
+        return canonical;
+    }
+
     Expected<VcpkgPaths> VcpkgPaths::create(const fs::path& vcpkg_root_dir, const std::string& default_vs_path)
     {
         std::error_code ec;
@@ -32,36 +65,30 @@ namespace vcpkg
             Checks::exit_with_message(VCPKG_LINE_INFO, "Invalid vcpkg root directory: %s", paths.root.string());
         }
 
-        paths.packages = paths.root / "packages";
-        paths.buildtrees = paths.root / "buildtrees";
+        auto maybe_downloads = get_directory_override("VCPKG_DOWNLOADS", "downloads", paths.root / "downloads");
+        if (!maybe_downloads.has_value()) return maybe_downloads.error();
+        paths.downloads = std::move(*maybe_downloads.get());
 
-        const auto overriddenDownloadsPath = System::get_environment_variable("VCPKG_DOWNLOADS");
-        if (auto odp = overriddenDownloadsPath.get())
-        {
-            auto asPath = fs::u8path(*odp);
-            if (!fs::stdfs::is_directory(asPath))
-            {
-                Metrics::g_metrics.lock()->track_property("error", "Invalid VCPKG_DOWNLOADS override directory.");
-                Checks::exit_with_message(
-                    VCPKG_LINE_INFO,
-                    "Invalid downloads override directory: %s; "
-                    "create that directory or unset VCPKG_DOWNLOADS to use the default downloads location.",
-                    asPath.u8string());
-            }
+        // Build scratch space may live on a faster volume than the root, such as a RAM disk
+        auto maybe_packages = get_directory_override("VCPKG_PACKAGES", "packages", paths.root / "packages");
+        if (!maybe_packages.has_value()) return maybe_packages.error();
+        paths.packages = std::move(*maybe_packages.get());
 
-            paths.downloads = fs::stdfs::canonical(std::move(asPath), ec);
-            if (ec)
-            {
-                return ec;
-            }
-        }
-        else
-        {
-            paths.downloads = paths.root / "downloads";
-        }
+        auto maybe_buildtrees = get_directory_override("VCPKG_BUILDTREES", "buildtrees", paths.root / "buildtrees");
+        if (!maybe_buildtrees.has_value()) return maybe_buildtrees.error();
+        paths.buildtrees = std::move(*maybe_buildtrees.get());
 
         paths.ports = paths.root / "ports";
         paths.installed = paths.root / "installed";
+
+        // Packages built once for many checkouts, which each take them into their own installed tree
+        auto maybe_installed_base = get_directory_override("VCPKG_INSTALLED_BASE", "installed base", fs::path());
+        if (!maybe_installed_base.has_value()) return maybe_installed_base.error();
+        paths.installed_base = std::move(*maybe_installed_base.get());
+        Checks::check_exit(VCPKG_LINE_INFO,
+                           paths.installed_base.empty() ||
+                               fs::stdfs::canonical(paths.installed, ec) != paths.installed_base,
+                           "VCPKG_INSTALLED_BASE must not be the installed directory of this vcpkg root");
         paths.triplets = paths.root / "triplets";
         paths.scripts = paths.root / "scripts";
 
@@ -76,6 +103,11 @@ namespace vcpkg
 
         paths.ports_cmake = paths.scripts / "ports.cmake";
 
+        Hash::enable_file_hash_cache(paths.vcpkg_dir / "hashcache");
+        Hash::enable_git_blob_ids(paths.root, {"ports", "scripts"});
+        Downloads::enable_download_index(paths.downloads / "sha512");
+        Paragraphs::enable_port_index(paths.ports, paths.vcpkg_dir / "portindex");
+
         return paths;
     }
 
@@ -110,21 +142,34 @@ namespace vcpkg
 
     bool VcpkgPaths::is_valid_triplet(const Triplet& t) const
     {
-        const auto it = Util::find_if(this->get_available_triplets(), [&](auto&& available_triplet) {
-            return t.canonical_name() == available_triplet;
-        });
-        return it != this->get_available_triplets().cend();
+        // get_available_triplets() is sorted
+        const std::vector<std::string>& available_triplets = this->get_available_triplets();
+        return std::binary_search(available_triplets.cbegin(), available_triplets.cend(), t.canonical_name());
     }
 
     const fs::path& VcpkgPaths::get_tool_exe(const std::string& tool) const
     {
-        if (!m_tool_cache) m_tool_cache = get_tool_cache();
-        return m_tool_cache->get_tool_path(*this, tool);
+        return m_tool_cache.get_lazy(get_tool_cache)->get_tool_path(*this, tool);
     }
     const std::string& VcpkgPaths::get_tool_version(const std::string& tool) const
     {
-        if (!m_tool_cache) m_tool_cache = get_tool_cache();
-        return m_tool_cache->get_tool_version(*this, tool);
+        return m_tool_cache.get_lazy(get_tool_cache)->get_tool_version(*this, tool);
+    }
+
+    void VcpkgPaths::prefetch_tools(std::vector<std::string> tools) const
+    {
+        // The paths outlive every command, which exits the process when it is done
+        std::thread([this, tools = std::move(tools)]() {
+            ThreadPool::parallel_for(tools.size(), tools.size(), [&](size_t i) { get_tool_exe(tools[i]); });
+        }).detach();
+    }
+
+    const BinaryCache& VcpkgPaths::get_binary_cache() const
+    {
+        return *m_binary_cache.get_lazy([this]() {
+            return std::make_unique<BinaryCache>(
+                BinaryCache::from_environment(this->get_filesystem(), this->root / "archives"));
+        });
     }
 
     const Toolset& VcpkgPaths::get_toolset(const Build::PreBuildInfo& prebuildinfo) const
@@ -198,5 +243,15 @@ namespace vcpkg
 #endif
     }
 
-    Files::Filesystem& VcpkgPaths::get_filesystem() const { return Files::get_real_filesystem(); }
+    Files::Filesystem& VcpkgPaths::get_filesystem() const
+    {
+        if (m_stat_caching_filesystem) return *m_stat_caching_filesystem;
+        return Files::get_real_filesystem();
+    }
+
+    void VcpkgPaths::cache_file_statuses() const
+    {
+        if (!m_stat_caching_filesystem)
+            m_stat_caching_filesystem = Files::make_stat_caching_filesystem(Files::get_real_filesystem());
+    }
 }
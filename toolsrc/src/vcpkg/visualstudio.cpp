@@ -141,9 +141,212 @@ namespace vcpkg::VisualStudio
         return instances;
     }
 
+    /// <summary>
+    /// Files and directories whose modification marks a change in the installed instances or their toolsets.
+    /// </summary>
+    static std::vector<fs::path> get_discovery_stamp_paths(const std::vector<VisualStudioInstance>& instances)
+    {
+        const auto& program_files_32_bit = System::get_program_files_32_bit().value_or_exit(VCPKG_LINE_INFO);
+
+        std::vector<fs::path> stamp_paths;
+        stamp_paths.push_back(program_files_32_bit / "Microsoft Visual Studio" / "Installer" / "vswhere.exe");
+        stamp_paths.push_back(program_files_32_bit / "Microsoft Visual Studio 14.0" / "VC");
+
+        // The installer records every instance in a state.json below this directory
+        const auto maybe_program_data = System::get_environment_variable("ProgramData");
+        if (const auto program_data = maybe_program_data.get())
+        {
+            const fs::path instances_dir =
+                fs::path(*program_data) / "Microsoft" / "VisualStudio" / "Packages" / "_Instances";
+            stamp_paths.push_back(instances_dir);
+
+            std::error_code ec;
+            for (fs::stdfs::directory_iterator it(instances_dir, ec), end; !ec && it != end; it.increment(ec))
+            {
+                stamp_paths.push_back(it->path() / "state.json");
+            }
+        }
+
+        for (auto&& instance : instances)
+        {
+            stamp_paths.push_back(instance.root_path / "VC" / "Auxiliary" / "Build");
+            stamp_paths.push_back(instance.root_path / "VC" / "Tools" / "MSVC");
+        }
+
+        return stamp_paths;
+    }
+
+    static long long get_write_time(const fs::path& path)
+    {
+        std::error_code ec;
+        const auto write_time = fs::stdfs::last_write_time(path, ec);
+        return ec ? -1 : static_cast<long long>(write_time.time_since_epoch().count());
+    }
+
+    static const ToolsetArchOption* find_arch_option(const std::string& name)
+    {
+        using CPU = System::CPUArchitecture;
+
+        static const ToolsetArchOption KNOWN_ARCH_OPTIONS[] = {
+            {"x86", CPU::X86, CPU::X86},
+            {"x64", CPU::X64, CPU::X64},
+            {"amd64", CPU::X64, CPU::X64},
+            {"x86_amd64", CPU::X86, CPU::X64},
+            {"x86_arm", CPU::X86, CPU::ARM},
+            {"x86_arm64", CPU::X86, CPU::ARM64},
+            {"amd64_x86", CPU::X64, CPU::X86},
+            {"amd64_arm", CPU::X64, CPU::ARM},
+            {"amd64_arm64", CPU::X64, CPU::ARM64},
+        };
+
+        for (auto&& option : KNOWN_ARCH_OPTIONS)
+        {
+            if (option.name == name) return &option;
+        }
+        return nullptr;
+    }
+
+    static Optional<CStringView> find_toolset_version(const std::string& version)
+    {
+        for (auto&& known : {V_120, V_140, V_141})
+        {
+            if (known == version) return known;
+        }
+        return nullopt;
+    }
+
+    /// <summary>
+    /// The discovered instances and toolsets, kept in installed/vcpkg/vstoolsets. Each line is a '|' separated record:
+    ///   stamp|<write time>|<path>
+    ///   env|<value of vs140comntools>|vs140comntools
+    ///   instance|<release type>|<version>|<root>
+    ///   toolset|<version>|<architectures>|<vcvarsall options>|<vcvarsall>|<dumpbin>|<root>
+    /// </summary>
+    struct DiscoveryCache
+    {
+        std::vector<VisualStudioInstance> instances;
+        std::vector<Toolset> toolsets;
+    };
+
+    static constexpr CStringView DISCOVERY_CACHE_HEADER = "vstoolsets 1";
+
+    static fs::path get_discovery_cache_path(const VcpkgPaths& paths) { return paths.vcpkg_dir / "vstoolsets"; }
+
+    static Optional<DiscoveryCache> load_discovery_cache(const VcpkgPaths& paths)
+    {
+        const auto maybe_lines = paths.get_filesystem().read_lines(get_discovery_cache_path(paths));
+        const auto lines = maybe_lines.get();
+        if (!lines || lines->empty() || lines->front() != DISCOVERY_CACHE_HEADER.c_str()) return nullopt;
+
+        DiscoveryCache cache;
+        for (auto it = std::next(lines->begin()); it != lines->end(); ++it)
+        {
+            const std::vector<std::string> fields = Strings::split(*it, "|");
+            if (fields.empty()) return nullopt;
+
+            const std::string& kind = fields[0];
+            if (kind == "stamp" && fields.size() == 3)
+            {
+                const long long write_time = std::strtoll(fields[1].c_str(), nullptr, 10);
+                if (get_write_time(fs::u8path(fields[2])) != write_time) return nullopt;
+            }
+            else if (kind == "env" && fields.size() == 3)
+            {
+                if (System::get_environment_variable(fields[2]).value_or("") != fields[1]) return nullopt;
+            }
+            else if (kind == "instance" && fields.size() == 4)
+            {
+                VisualStudioInstance::ReleaseType release_type;
+                if (fields[1] == "STABLE")
+                    release_type = VisualStudioInstance::ReleaseType::STABLE;
+                else if (fields[1] == "PRERELEASE")
+                    release_type = VisualStudioInstance::ReleaseType::PRERELEASE;
+                else if (fields[1] == "LEGACY")
+                    release_type = VisualStudioInstance::ReleaseType::LEGACY;
+                else
+                    return nullopt;
+
+                cache.instances.emplace_back(fs::u8path(fields[3]), std::string(fields[2]), release_type);
+            }
+            else if (kind == "toolset" && fields.size() == 7)
+            {
+                const auto maybe_version = find_toolset_version(fields[1]);
+                const auto version = maybe_version.get();
+                if (!version) return nullopt;
+
+                std::vector<ToolsetArchOption> supported_architectures;
+                for (auto&& name : Strings::split(fields[2], ";"))
+                {
+                    const auto option = find_arch_option(name);
+                    if (!option) return nullopt;
+                    supported_architectures.push_back(*option);
+                }
+
+                cache.toolsets.push_back(Toolset{fs::u8path(fields[6]),
+                                                 fs::u8path(fields[5]),
+                                                 fs::u8path(fields[4]),
+                                                 Strings::split(fields[3], ";"),
+                                                 *version,
+                                                 std::move(supported_architectures)});
+            }
+            else
+            {
+                return nullopt;
+            }
+        }
+
+        if (cache.toolsets.empty()) return nullopt;
+        return cache;
+    }
+
+    static void store_discovery_cache(const VcpkgPaths& paths,
+                                      const std::vector<VisualStudioInstance>& instances,
+                                      const std::vector<Toolset>& toolsets)
+    {
+        std::vector<std::string> lines;
+        lines.push_back(DISCOVERY_CACHE_HEADER.c_str());
+        for (auto&& path : get_discovery_stamp_paths(instances))
+        {
+            lines.push_back(Strings::format("stamp|%lld|%s", get_write_time(path), path.u8string()));
+        }
+        lines.push_back(Strings::format(
+            "env|%s|vs140comntools", System::get_environment_variable("vs140comntools").value_or("")));
+        for (auto&& instance : instances)
+        {
+            lines.push_back(Strings::format("instance|%s|%s|%s",
+                                            VisualStudioInstance::release_type_to_string(instance.release_type),
+                                            instance.version,
+                                            instance.root_path.u8string()));
+        }
+        for (auto&& toolset : toolsets)
+        {
+            lines.push_back(Strings::format(
+                "toolset|%s|%s|%s|%s|%s|%s",
+                toolset.version.c_str(),
+                Strings::join(";", toolset.supported_architectures, [](const ToolsetArchOption& option) {
+                    return std::string(option.name.c_str());
+                }),
+                Strings::join(";", toolset.vcvarsall_options),
+                toolset.vcvarsall.u8string(),
+                toolset.dumpbin.u8string(),
+                toolset.visual_studio_root_path.u8string()));
+        }
+
+        auto& fs = paths.get_filesystem();
+        const fs::path cache_path = get_discovery_cache_path(paths);
+        const fs::path tmp_path = fs::path(cache_path).concat(".tmp");
+        std::error_code ec;
+        fs.write_contents(tmp_path, Strings::join("\n", lines) + '\n', ec);
+        if (!ec) fs.rename(tmp_path, cache_path, ec);
+    }
+
     std::vector<std::string> get_visual_studio_instances(const VcpkgPaths& paths)
     {
-        std::vector<VisualStudioInstance> sorted{get_visual_studio_instances_internal(paths)};
+        auto maybe_cache = load_discovery_cache(paths);
+        std::vector<VisualStudioInstance> sorted = [&]() {
+            if (const auto cache = maybe_cache.get()) return std::move(cache->instances);
+            return get_visual_studio_instances_internal(paths);
+        }();
         std::sort(sorted.begin(), sorted.end(), VisualStudioInstance::preferred_first_comparator);
         return Util::fmap(sorted, [](const VisualStudioInstance& instance) { return instance.to_string(); });
     }
@@ -152,6 +355,9 @@ namespace vcpkg::VisualStudio
     {
         using CPU = System::CPUArchitecture;
 
+        auto maybe_cache = load_discovery_cache(paths);
+        if (const auto cache = maybe_cache.get()) return std::move(cache->toolsets);
+
         const auto& fs = paths.get_filesystem();
 
         // Note: this will contain a mix of vcvarsall.bat locations and dumpbin.exe locations.
@@ -319,6 +525,12 @@ namespace vcpkg::VisualStudio
             Checks::exit_fail(VCPKG_LINE_INFO);
         }
 
+        // Keep the warning about excluded instances visible on every run
+        if (excluded_toolsets.empty())
+        {
+            store_discovery_cache(paths, std::vector<VisualStudioInstance>(sorted.begin(), sorted.end()), found_toolsets);
+        }
+
         return found_toolsets;
     }
 }
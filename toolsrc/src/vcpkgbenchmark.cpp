@@ -0,0 +1,786 @@
+#include <vcpkg/base/allocations.h>
+#include <vcpkg/base/chrono.h>
+#include <vcpkg/base/files.h>
+#include <vcpkg/base/hash.h>
+#include <vcpkg/base/strings.h>
+#include <vcpkg/base/system.h>
+#include <vcpkg/dependencies.h>
+#include <vcpkg/install.h>
+#include <vcpkg/paragraphs.h>
+#include <vcpkg/statusparagraphs.h>
+#include <vcpkg/vcpkgpaths.h>
+
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <random>
+#include <regex>
+
+using namespace vcpkg;
+
+// Timings of the hot paths of vcpkglib, printed as a table and optionally written as JSON to compare releases, with
+// the allocations of one iteration so that memory regressions show up as well.
+// With --end-to-end, also the overhead a vcpkg executable adds to each package, measured on ports that build nothing.
+//
+//     vcpkgbenchmark [--vcpkg-root=<dir>] [--filter=<substring>] [--min-time=<seconds>] [--json=<file>]
+//                    [--synthetic-ports=<count>,...] [--end-to-end=<vcpkg executable>] [--end-to-end-ports=<count>]
+
+namespace
+{
+    struct Result
+    {
+        std::string name;
+        size_t iterations;
+        double mean_us;
+        double min_us;
+        /// <summary>Work done by one iteration, for per-item and throughput figures; zero if meaningless.</summary>
+        size_t items;
+        size_t bytes;
+        /// <summary>Calls one iteration made to the in-memory file system; zero if it used none.</summary>
+        uint64_t fs_calls;
+        /// <summary>Allocations one iteration made through operator new, and their bytes.</summary>
+        uint64_t allocations;
+        uint64_t allocated_bytes;
+        /// <summary>Peak resident memory of a vcpkg command run by --end-to-end; zero otherwise.</summary>
+        uint64_t peak_memory_kib;
+    };
+
+    struct Runner
+    {
+        std::string filter;
+        double min_time_us = 1000000.0;
+        std::vector<Result> results;
+        /// <summary>The file system whose calls the warm-up run counts, if the body uses one.</summary>
+        Files::MemoryFilesystem* counted_fs = nullptr;
+
+        /// <summary>
+        /// Runs `body` once to warm up, then until `min_time_us` has passed and at least three times. `reset` runs
+        /// before every iteration and is not timed.
+        /// </summary>
+        void run(const std::string& name,
+                 size_t items,
+                 size_t bytes,
+                 const std::function<void()>& body,
+                 const std::function<void()>& reset = nullptr)
+        {
+            if (!filter.empty() && name.find(filter) == std::string::npos) return;
+
+            // Only the warm-up run counts allocations, so that counting does not slow down the timed ones
+            if (reset) reset();
+            if (counted_fs) counted_fs->reset_call_count();
+            const Allocations::Totals allocated_before = Allocations::get_totals();
+            Allocations::set_enabled(true);
+            body();
+            Allocations::set_enabled(false);
+            const Allocations::Totals allocated_after = Allocations::get_totals();
+            const uint64_t fs_calls = counted_fs ? counted_fs->call_count() : 0;
+            const uint64_t allocations = allocated_after.count - allocated_before.count;
+            const uint64_t allocated_bytes = allocated_after.bytes - allocated_before.bytes;
+
+            size_t iterations = 0;
+            double total_us = 0.0;
+            double min_us = 0.0;
+            while (iterations < 3 || total_us < min_time_us)
+            {
+                if (reset) reset();
+                const auto timer = Chrono::ElapsedTimer::create_started();
+                body();
+                const double elapsed_us = timer.microseconds();
+                total_us += elapsed_us;
+                min_us = iterations == 0 ? elapsed_us : std::min(min_us, elapsed_us);
+                ++iterations;
+            }
+
+            results.push_back({name,
+                               iterations,
+                               total_us / iterations,
+                               min_us,
+                               items,
+                               bytes,
+                               fs_calls,
+                               allocations,
+                               allocated_bytes,
+                               0});
+            const Result& result = results.back();
+            System::println("%-72s %10.1f us %10.1f us min %8zd runs", name, result.mean_us, result.min_us, iterations);
+            if (fs_calls != 0) System::println("%-72s %10s calls", "", std::to_string(fs_calls));
+            if (allocations != 0)
+            {
+                System::println(
+                    "%-72s %10s allocs %10.1f KiB", "", std::to_string(allocations), allocated_bytes / 1024.0);
+            }
+        }
+
+        /// <summary>Records something timed once, outside of run(), such as a whole vcpkg command.</summary>
+        void record(const std::string& name, double elapsed_us, size_t items, uint64_t peak_memory_kib = 0)
+        {
+            if (!filter.empty() && name.find(filter) == std::string::npos) return;
+
+            results.push_back({name, 1, elapsed_us, elapsed_us, items, 0, 0, 0, 0, peak_memory_kib});
+            const double per_item_us = elapsed_us / std::max<size_t>(items, 1);
+            System::println("%-72s %10.1f us %10.1f us per item", name, elapsed_us, per_item_us);
+            if (peak_memory_kib != 0) System::println("%-72s %10s KiB peak", "", std::to_string(peak_memory_kib));
+        }
+    };
+
+    // Keeps the compiler from discarding the work whose result is otherwise unused
+    volatile size_t g_sink = 0;
+
+    std::string to_json(const std::vector<Result>& results)
+    {
+        std::vector<std::string> entries = Util::fmap(results, [](const Result& result) {
+            return Strings::format(
+                R"(    {"name": "%s", "iterations": %zu, "mean_us": %.3f, "min_us": %.3f, "items": %zu, "bytes": %zu, )"
+                R"("fs_calls": %s, "allocations": %s, "allocated_bytes": %s, "peak_memory_kib": %s})",
+                result.name,
+                result.iterations,
+                result.mean_us,
+                result.min_us,
+                result.items,
+                result.bytes,
+                std::to_string(result.fs_calls),
+                std::to_string(result.allocations),
+                std::to_string(result.allocated_bytes),
+                std::to_string(result.peak_memory_kib));
+        });
+        return "{\"benchmarks\": [\n" + Strings::join(",\n", entries) + "\n]}\n";
+    }
+
+    void benchmark_parse_paragraphs(Runner& runner, const VcpkgPaths& paths)
+    {
+        auto& fs = paths.get_filesystem();
+
+        std::vector<std::string> control_files;
+        size_t control_bytes = 0;
+        for (auto&& port_dir : fs.get_files_non_recursive(paths.ports))
+        {
+            auto maybe_contents = fs.read_contents(port_dir / "CONTROL");
+            if (auto p_contents = maybe_contents.get())
+            {
+                control_bytes += p_contents->size();
+                control_files.push_back(std::move(*p_contents));
+            }
+        }
+
+        runner.run("Paragraphs::parse_paragraphs(ports/*/CONTROL)", control_files.size(), control_bytes, [&]() {
+            for (auto&& contents : control_files)
+            {
+                g_sink += Paragraphs::parse_paragraphs(contents).value_or_exit(VCPKG_LINE_INFO).size();
+            }
+        });
+
+        runner.run("Paragraphs::try_load_all_ports(ports)", control_files.size(), control_bytes, [&]() {
+            g_sink += Paragraphs::try_load_all_ports(fs, paths.ports).paragraphs.size();
+        });
+
+        auto maybe_status = fs.read_contents(paths.vcpkg_dir_status_file);
+        if (auto p_status = maybe_status.get())
+        {
+            runner.run("Paragraphs::parse_paragraphs(status)", 1, p_status->size(), [&]() {
+                g_sink += Paragraphs::parse_paragraphs(*p_status).value_or_exit(VCPKG_LINE_INFO).size();
+            });
+        }
+    }
+
+    void benchmark_install_plan(Runner& runner, const VcpkgPaths& paths)
+    {
+        const Dependencies::PreloadedPortFileProvider provider(paths);
+        const StatusParagraphs status_db;
+
+        for (const Triplet& triplet : {Triplet::X64_WINDOWS, Triplet::from_canonical_name("x64-linux")})
+        {
+            const auto specs = PackageSpec::to_package_specs(provider.port_names(), triplet);
+            const auto fspecs = Util::fmap(specs, [](auto& spec) { return FeatureSpec(spec, ""); });
+
+            runner.run("create_feature_install_plan(all ports, " + triplet.canonical_name() + ")",
+                       fspecs.size(),
+                       0,
+                       [&]() {
+                           g_sink += Dependencies::create_feature_install_plan(provider, fspecs, status_db).size();
+                       });
+        }
+    }
+
+    /// <summary>
+    /// The shape of a generated port universe. Port i depends on `fan_out` ports among the `window` ports before it,
+    /// so the graph has no cycles. Each port has `feature_depth` features, where feature j depends on feature j - 1 of
+    /// one of the port's dependencies; the first feature is the default. Every `qualified_every`th dependency only
+    /// applies to windows or to everything else, alternately.
+    /// </summary>
+    struct UniverseShape
+    {
+        size_t port_count;
+        size_t fan_out = 4;
+        size_t window = 200;
+        size_t feature_depth = 2;
+        size_t qualified_every = 5;
+    };
+
+    struct Universe
+    {
+        std::unordered_map<std::string, SourceControlFile> ports;
+        std::vector<std::string> names;
+        /// <summary>Core dependencies of each port on x64-windows, by index.</summary>
+        std::vector<std::vector<size_t>> windows_dependencies;
+    };
+
+    Universe make_universe(const UniverseShape& shape)
+    {
+        // A fixed seed keeps the universe, and so the timings, comparable between runs
+        std::mt19937 random(12345);
+
+        Universe universe;
+        universe.windows_dependencies.resize(shape.port_count);
+        size_t dependency_count = 0;
+        for (size_t i = 0; i < shape.port_count; ++i)
+        {
+            universe.names.push_back(Strings::format("port%zu", i));
+        }
+
+        for (size_t i = 0; i < shape.port_count; ++i)
+        {
+            std::vector<size_t> dependencies;
+            const size_t first = i > shape.window ? i - shape.window : 0;
+            for (size_t k = 0; i > 0 && k < shape.fan_out; ++k)
+            {
+                dependencies.push_back(first + random() % (i - first));
+            }
+            Util::sort_unique_erase(dependencies);
+
+            std::vector<std::string> build_depends;
+            for (const size_t dependency : dependencies)
+            {
+                std::string depend = universe.names[dependency];
+                const bool is_qualified = shape.qualified_every != 0 && ++dependency_count % shape.qualified_every == 0;
+                const bool is_windows_only = dependency_count / shape.qualified_every % 2 == 0;
+                if (is_qualified) depend += is_windows_only ? " (windows)" : " (!windows)";
+                if (!is_qualified || is_windows_only) universe.windows_dependencies[i].push_back(dependency);
+                build_depends.push_back(std::move(depend));
+            }
+
+            std::vector<Parse::RawParagraph> paragraphs;
+            paragraphs.push_back({{"Source", universe.names[i]},
+                                  {"Version", "1.0"},
+                                  {"Build-Depends", Strings::join(", ", build_depends)},
+                                  {"Default-Features", shape.feature_depth > 0 ? "f0" : ""}});
+            for (size_t j = 0; j < shape.feature_depth; ++j)
+            {
+                std::string depends;
+                if (!dependencies.empty())
+                {
+                    const std::string& other = universe.names[dependencies[j % dependencies.size()]];
+                    depends = j == 0 ? other : Strings::format("%s[f%zu]", other, j - 1);
+                }
+                paragraphs.push_back({{"Feature", Strings::format("f%zu", j)},
+                                      {"Description", "feature"},
+                                      {"Build-Depends", depends}});
+            }
+
+            auto maybe_scf = SourceControlFile::parse_control_file(std::move(paragraphs));
+            auto p_scf = maybe_scf.get();
+            Checks::check_exit(VCPKG_LINE_INFO, p_scf != nullptr, "Generated an invalid port %s", universe.names[i]);
+            universe.ports.emplace(universe.names[i], std::move(**p_scf));
+        }
+
+        return universe;
+    }
+
+    /// <summary>A status database holding, on x64-windows, the ports for which `is_installed` holds.</summary>
+    template<class Pred>
+    StatusParagraphs make_status_db(const Universe& universe, Pred is_installed)
+    {
+        std::vector<std::unique_ptr<StatusParagraph>> paragraphs;
+        for (size_t i = 0; i < universe.names.size(); ++i)
+        {
+            if (!is_installed(i)) continue;
+            const auto depends = Util::fmap(universe.windows_dependencies[i],
+                                            [&](const size_t dependency) { return universe.names[dependency]; });
+            paragraphs.push_back(std::make_unique<StatusParagraph>(std::unordered_map<std::string, std::string>{
+                {"Package", universe.names[i]},
+                {"Version", "1.0"},
+                {"Architecture", "x64-windows"},
+                {"Multi-Arch", "same"},
+                {"Depends", Strings::join(", ", depends)},
+                {"Status", "install ok installed"},
+            }));
+        }
+        return StatusParagraphs(std::move(paragraphs));
+    }
+
+    void benchmark_synthetic_plans(Runner& runner, const std::vector<size_t>& port_counts)
+    {
+        for (const size_t port_count : port_counts)
+        {
+            const auto universe = make_universe(UniverseShape{port_count});
+            const Dependencies::MapPortFileProvider provider(universe.ports);
+            const auto specs = PackageSpec::to_package_specs(universe.names, Triplet::X64_WINDOWS);
+            const auto fspecs = Util::fmap(specs, [](auto& spec) { return FeatureSpec(spec, ""); });
+
+            const StatusParagraphs nothing_installed;
+            runner.run(Strings::format("create_feature_install_plan(%zu synthetic ports)", port_count),
+                       fspecs.size(),
+                       0,
+                       [&]() {
+                           g_sink +=
+                               Dependencies::create_feature_install_plan(provider, fspecs, nothing_installed).size();
+                       });
+
+            // Dependencies come first, so the first half is installed with its dependencies. It is installed without
+            // features, so every installed package is rebuilt to add them.
+            const auto half_installed = make_status_db(universe, [&](size_t i) { return i < port_count / 2; });
+            runner.run(Strings::format("create_feature_install_plan(%zu synthetic ports, half installed)", port_count),
+                       fspecs.size(),
+                       0,
+                       [&]() {
+                           g_sink += Dependencies::create_feature_install_plan(provider, fspecs, half_installed).size();
+                       });
+
+            // The newest ports have few dependents, so this mostly measures looking them up among everything installed
+            const auto all_installed = make_status_db(universe, [](size_t) { return true; });
+            const std::vector<PackageSpec> removed(specs.end() - port_count / 100, specs.end());
+            runner.run(Strings::format("create_remove_plan(%zu synthetic ports)", port_count),
+                       removed.size(),
+                       0,
+                       [&]() { g_sink += Dependencies::create_remove_plan(removed, all_installed).size(); });
+        }
+    }
+
+    void benchmark_status_find(Runner& runner)
+    {
+        static constexpr size_t PACKAGE_COUNT = 10000;
+
+        std::vector<std::unique_ptr<StatusParagraph>> paragraphs;
+        std::vector<PackageSpec> specs;
+        for (size_t i = 0; i < PACKAGE_COUNT; ++i)
+        {
+            const std::string name = Strings::format("port%zu", i);
+            paragraphs.push_back(std::make_unique<StatusParagraph>(std::unordered_map<std::string, std::string>{
+                {"Package", name},
+                {"Version", "1.0"},
+                {"Architecture", "x64-windows"},
+                {"Multi-Arch", "same"},
+                {"Status", "install ok installed"},
+            }));
+            specs.push_back(
+                PackageSpec::from_name_and_triplet(name, Triplet::X64_WINDOWS).value_or_exit(VCPKG_LINE_INFO));
+        }
+        const StatusParagraphs status_db(std::move(paragraphs));
+
+        runner.run(Strings::format("StatusParagraphs::find(%zu packages)", PACKAGE_COUNT), specs.size(), 0, [&]() {
+            for (auto&& spec : specs)
+            {
+                g_sink += status_db.find(spec) != status_db.end();
+            }
+        });
+    }
+
+    void benchmark_file_hash(Runner& runner, Files::Filesystem& fs, const fs::path& work_dir)
+    {
+        static constexpr size_t FILE_SIZE = 64 * 1024 * 1024;
+
+        const fs::path file = work_dir / "hash-input";
+        std::string contents(FILE_SIZE, '\0');
+        for (size_t i = 0; i < contents.size(); ++i)
+        {
+            contents[i] = static_cast<char>(i * 2654435761u >> 24);
+        }
+        std::error_code ec;
+        fs.write_contents(file, contents, ec);
+        Checks::check_exit(VCPKG_LINE_INFO, !ec, "Could not write %s: %s", file.u8string(), ec.message());
+
+        for (const char* hash_type : {"SHA1", "SHA512"})
+        {
+            runner.run(Strings::format("Hash::get_file_hash(%s, 64 MiB)", hash_type), 1, FILE_SIZE, [&]() {
+                g_sink += Hash::get_file_hash(fs, file, hash_type).size();
+            });
+        }
+    }
+
+    void benchmark_strings(Runner& runner)
+    {
+        static constexpr size_t COUNT = 10000;
+
+        runner.run(Strings::format("Strings::format(x%zu)", COUNT), COUNT, 0, [&]() {
+            for (size_t i = 0; i < COUNT; ++i)
+            {
+                g_sink += Strings::format("%s:%s [%d] %s", "zlib", "x64-windows", static_cast<int>(i), "core").size();
+            }
+        });
+
+        std::vector<std::string> fields;
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            fields.push_back(Strings::format("field%zu", i));
+        }
+        const std::string joined = Strings::join(", ", fields);
+        runner.run(Strings::format("Strings::split(%zu fields)", COUNT), COUNT, joined.size(), [&]() {
+            g_sink += Strings::split(joined, ", ").size();
+        });
+        runner.run(Strings::format("Strings::split_view(%zu fields)", COUNT), COUNT, joined.size(), [&]() {
+            for (std::string_view field : Strings::split_view(joined, ", "))
+            {
+                g_sink += field.size();
+            }
+        });
+    }
+
+    /// <summary>The scans of search and depend-info: a pattern found nowhere, so every byte is compared.</summary>
+    void benchmark_case_insensitive(Runner& runner, const VcpkgPaths& paths)
+    {
+        auto& fs = paths.get_filesystem();
+
+        std::vector<std::string> names;
+        std::vector<std::string> control_files;
+        size_t control_bytes = 0;
+        for (auto&& port_dir : fs.get_files_non_recursive(paths.ports))
+        {
+            auto maybe_contents = fs.read_contents(port_dir / "CONTROL");
+            if (auto p_contents = maybe_contents.get())
+            {
+                names.push_back(port_dir.filename().u8string());
+                control_bytes += p_contents->size();
+                control_files.push_back(std::move(*p_contents));
+            }
+        }
+
+        runner.run("Strings::case_insensitive_ascii_contains(ports/*/CONTROL)",
+                   control_files.size(),
+                   control_bytes,
+                   [&]() {
+                       for (auto&& contents : control_files)
+                       {
+                           g_sink += Strings::case_insensitive_ascii_contains(contents, "No-Such-Library");
+                       }
+                   });
+
+        runner.run("Strings::case_insensitive_ascii_equals(port names)", names.size(), 0, [&]() {
+            for (auto&& name : names)
+            {
+                g_sink += Strings::case_insensitive_ascii_equals(name, "No-Such-Library");
+            }
+        });
+    }
+
+    void benchmark_install_files(Runner& runner, Files::Filesystem& fs, const fs::path& work_dir)
+    {
+        static constexpr size_t DIRECTORY_COUNT = 20;
+        static constexpr size_t FILES_PER_DIRECTORY = 50;
+
+        const fs::path source_dir = work_dir / "package";
+        const fs::path installed_dir = work_dir / "installed";
+        const fs::path listfile = work_dir / "listfile";
+
+        std::error_code ec;
+        const std::string contents(1024, 'x');
+        for (size_t d = 0; d < DIRECTORY_COUNT; ++d)
+        {
+            const fs::path dir = source_dir / "include" / Strings::format("dir%zu", d);
+            fs.create_directories(dir, ec);
+            for (size_t f = 0; f < FILES_PER_DIRECTORY; ++f)
+            {
+                fs.write_contents(dir / Strings::format("file%zu.h", f), contents, ec);
+            }
+        }
+        Checks::check_exit(VCPKG_LINE_INFO, !ec, "Could not create %s: %s", source_dir.u8string(), ec.message());
+
+        const auto dirs = Install::InstallDir::from_destination_root(installed_dir, "x64-windows", listfile);
+        const size_t file_count = DIRECTORY_COUNT * FILES_PER_DIRECTORY;
+        runner.run(Strings::format("Install::install_files_and_write_listfile(%zu files)", file_count),
+                   file_count,
+                   file_count * contents.size(),
+                   [&]() { Install::install_files_and_write_listfile(fs, source_dir, dirs); },
+                   [&]() {
+                       std::error_code remove_ec;
+                       fs.remove_all(installed_dir, remove_ec);
+                       fs.remove(listfile, remove_ec);
+                   });
+    }
+
+    /// <summary>
+    /// Installs packages of many files into an in-memory file system, once without latency and once with that of a
+    /// network share. The number of calls is exact, so a change that adds round trips per file shows up in the JSON
+    /// even where the timings are too noisy to tell.
+    /// </summary>
+    void benchmark_install_files_in_memory(Runner& runner)
+    {
+        struct Case
+        {
+            size_t directory_count;
+            size_t files_per_directory;
+            std::chrono::microseconds latency;
+        };
+
+        static constexpr Case CASES[] = {
+            {100, 1000, std::chrono::microseconds(0)},
+            {20, 500, std::chrono::microseconds(200)},
+        };
+
+        for (const Case& c : CASES)
+        {
+            const auto fs = Files::make_memory_filesystem();
+            const fs::path source_dir = fs::u8path("/packages/port_x64-windows");
+            const fs::path installed_dir = fs::u8path("/installed");
+            const fs::path listfile = installed_dir / "vcpkg" / "info" / "port_1.0_x64-windows.list";
+
+            std::error_code ec;
+            const std::string contents(256, 'x');
+            for (size_t d = 0; d < c.directory_count; ++d)
+            {
+                const fs::path dir = source_dir / "include" / Strings::format("dir%zu", d);
+                fs->create_directories(dir, ec);
+                for (size_t f = 0; f < c.files_per_directory; ++f)
+                {
+                    fs->write_contents(dir / Strings::format("file%zu.h", f), contents, ec);
+                }
+            }
+            Checks::check_exit(VCPKG_LINE_INFO, !ec, "Could not create %s: %s", source_dir.u8string(), ec.message());
+            fs->set_latency(c.latency);
+
+            const auto dirs = Install::InstallDir::from_destination_root(installed_dir, "x64-windows", listfile);
+            const size_t file_count = c.directory_count * c.files_per_directory;
+            runner.counted_fs = fs.get();
+            runner.run(Strings::format("Install::install_files_and_write_listfile(%zu files in memory, %s us latency)",
+                                       file_count,
+                                       std::to_string(c.latency.count())),
+                       file_count,
+                       file_count * contents.size(),
+                       [&]() { Install::install_files_and_write_listfile(*fs, source_dir, dirs); },
+                       [&]() {
+                           std::error_code remove_ec;
+                           fs->remove_all(installed_dir, remove_ec);
+                       });
+            runner.counted_fs = nullptr;
+        }
+    }
+
+    /// <summary>
+    /// The time spent in each trace category of a --x-trace-file, not counting the spans nested in it, so that the
+    /// categories add up to the time recorded. The outermost span is called "vcpkg" and gets what no phase covers.
+    /// </summary>
+    std::map<std::string, double> exclusive_time_by_category(const std::string& trace)
+    {
+        struct Span
+        {
+            std::string category;
+            double start_us;
+            double duration_us;
+        };
+
+        static const std::regex SPAN_REGEX(
+            R"re("cat":"([^"]*)","ph":"X","ts":([0-9.]+),"dur":([0-9.]+),"pid":1,"tid":([0-9]+))re");
+
+        std::map<int, std::vector<Span>> spans_by_thread;
+        for (auto it = std::sregex_iterator(trace.begin(), trace.end(), SPAN_REGEX); it != std::sregex_iterator(); ++it)
+        {
+            const std::smatch& match = *it;
+            spans_by_thread[std::atoi(match[4].str().c_str())].push_back(
+                {match[1].str(), std::atof(match[2].str().c_str()), std::atof(match[3].str().c_str())});
+        }
+
+        std::map<std::string, double> ret;
+        for (auto&& thread : spans_by_thread)
+        {
+            // Outer spans start no later and last longer than the spans they hold
+            auto& spans = thread.second;
+            std::sort(spans.begin(), spans.end(), [](const Span& lhs, const Span& rhs) {
+                return lhs.start_us != rhs.start_us ? lhs.start_us < rhs.start_us : lhs.duration_us > rhs.duration_us;
+            });
+
+            std::vector<const Span*> open;
+            for (const Span& span : spans)
+            {
+                while (!open.empty() && open.back()->start_us + open.back()->duration_us <= span.start_us)
+                {
+                    open.pop_back();
+                }
+                if (!open.empty()) ret[open.back()->category] -= span.duration_us;
+                ret[span.category] += span.duration_us;
+                open.push_back(&span);
+            }
+        }
+        return ret;
+    }
+
+    /// <summary>The peak resident memory that --x-alloc-stats added to a trace, or zero if it is missing.</summary>
+    uint64_t peak_memory_kib_of(const std::string& trace)
+    {
+        static const std::regex PEAK_REGEX(R"re("peak_rss_kib":([0-9]+))re");
+
+        std::smatch match;
+        if (!std::regex_search(trace, match, PEAK_REGEX)) return 0;
+        return std::strtoull(match[1].str().c_str(), nullptr, 10);
+    }
+
+    /// <summary>
+    /// Times install, export, remove and ci in a scratch vcpkg root whose ports only write a header and a copyright
+    /// file, so what is measured is the overhead of vcpkg itself: evaluating the triplet, hashing the ABI, running
+    /// the portfile, the post-build checks, the binary cache and the status database. Each command is broken down by
+    /// the categories of its trace, and its peak memory is recorded.
+    /// </summary>
+    void benchmark_end_to_end(Runner& runner,
+                              Files::Filesystem& fs,
+                              const VcpkgPaths& paths,
+                              const fs::path& vcpkg_exe,
+                              const size_t port_count)
+    {
+#if defined(_WIN32)
+        const std::string triplet = "x64-windows";
+#elif defined(__APPLE__)
+        const std::string triplet = "x64-osx";
+#else
+        const std::string triplet = "x64-linux";
+#endif
+
+        const fs::path root = paths.buildtrees / "vcpkgbenchmark-end-to-end";
+        std::error_code ec;
+        fs.remove_all(root, ec);
+        fs.create_directories(root / "ports", ec);
+        fs.copy(paths.root / "scripts", root / "scripts", fs::copy_options::recursive);
+        fs.copy(paths.root / "triplets", root / "triplets", fs::copy_options::recursive);
+        fs.write_contents(root / ".vcpkg-root", "", ec);
+
+        std::vector<std::string> ports;
+        for (size_t i = 0; i < port_count; ++i)
+        {
+            ports.push_back(Strings::format("noop%zu", i));
+            const fs::path port_dir = root / "ports" / ports.back();
+            fs.create_directory(port_dir, ec);
+            fs.write_contents(port_dir / "CONTROL",
+                              Strings::format("Source: %s\nVersion: 1.0\nDescription: No-op port\n", ports.back()),
+                              ec);
+            fs.write_contents(port_dir / "portfile.cmake",
+                              "file(WRITE ${CURRENT_PACKAGES_DIR}/include/${PORT}.h \"#pragma once\\n\")\n"
+                              "file(WRITE ${CURRENT_PACKAGES_DIR}/share/${PORT}/copyright \"No-op port\\n\")\n",
+                              ec);
+        }
+        Checks::check_exit(VCPKG_LINE_INFO, !ec, "Could not create %s: %s", root.u8string(), ec.message());
+
+        // The tools are shared with the real root instead of being downloaded again
+#if defined(_WIN32)
+        _putenv_s("VCPKG_DOWNLOADS", paths.downloads.u8string().c_str());
+#else
+        setenv("VCPKG_DOWNLOADS", paths.downloads.u8string().c_str(), 1);
+#endif
+
+        const std::vector<std::string> qualified_ports =
+            Util::fmap(ports, [&](const std::string& port) { return port + ":" + triplet; });
+        const auto run_vcpkg = [&](const std::string& name, std::vector<std::string> arguments) {
+            const fs::path trace_file = root / "trace.json";
+            arguments.insert(
+                arguments.end(),
+                {"--vcpkg-root",
+                 root.u8string(),
+                 "--binarycaching",
+                 "--x-alloc-stats",
+                 "--x-trace-file=" + trace_file.u8string()});
+
+            const auto timer = Chrono::ElapsedTimer::create_started();
+            const auto result = System::process_execute_and_capture_output(vcpkg_exe, arguments);
+            const double elapsed_us = timer.microseconds();
+            if (result.exit_code != 0)
+            {
+                System::println(result.output);
+                Checks::exit_with_message(VCPKG_LINE_INFO, "vcpkg %s failed", Strings::join(" ", arguments));
+            }
+
+            const std::string label = Strings::format("vcpkg %s (%zu no-op ports)", name, port_count);
+            const auto maybe_trace = fs.read_contents(trace_file);
+            const auto trace = maybe_trace.get();
+            runner.record(label, elapsed_us, port_count, trace ? peak_memory_kib_of(*trace) : 0);
+            if (trace)
+            {
+                for (auto&& category : exclusive_time_by_category(*trace))
+                {
+                    runner.record(label + " " + category.first, category.second, port_count);
+                }
+            }
+        };
+
+        const auto with = [](std::vector<std::string> arguments, const std::vector<std::string>& more) {
+            arguments.insert(arguments.end(), more.begin(), more.end());
+            return arguments;
+        };
+
+        run_vcpkg("install, built", with({"install"}, qualified_ports));
+        run_vcpkg("export --raw", with({"export", "--raw", "--output=export"}, qualified_ports));
+        run_vcpkg("remove", with({"remove"}, qualified_ports));
+        run_vcpkg("install, from the binary cache", with({"install"}, qualified_ports));
+        run_vcpkg("remove", with({"remove"}, qualified_ports));
+        run_vcpkg("ci, all in the binary cache", {"ci", triplet});
+
+        fs.remove_all(root, ec);
+    }
+}
+
+int main(const int argc, const char* const* const argv)
+{
+    Runner runner;
+    std::string json_file;
+    fs::path vcpkg_root_dir;
+    std::vector<size_t> synthetic_port_counts = {1000, 10000, 50000};
+    fs::path end_to_end_vcpkg;
+    size_t end_to_end_port_count = 20;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const auto eq_pos = arg.find('=');
+        const std::string name = arg.substr(0, eq_pos);
+        const std::string value = eq_pos == std::string::npos ? std::string() : arg.substr(eq_pos + 1);
+        if (name == "--vcpkg-root")
+            vcpkg_root_dir = fs::u8path(value);
+        else if (name == "--filter")
+            runner.filter = value;
+        else if (name == "--min-time")
+            runner.min_time_us = std::atof(value.c_str()) * 1000000.0;
+        else if (name == "--json")
+            json_file = value;
+        else if (name == "--synthetic-ports")
+            synthetic_port_counts = Util::fmap(Strings::split(value, ","), [](const std::string& count) {
+                return static_cast<size_t>(std::strtoull(count.c_str(), nullptr, 10));
+            });
+        else if (name == "--end-to-end")
+            end_to_end_vcpkg = fs::u8path(value);
+        else if (name == "--end-to-end-ports")
+            end_to_end_port_count = static_cast<size_t>(std::strtoull(value.c_str(), nullptr, 10));
+        else
+            Checks::exit_with_message(VCPKG_LINE_INFO,
+                                      "Usage: vcpkgbenchmark [--vcpkg-root=<dir>] [--filter=<substring>] "
+                                      "[--min-time=<seconds>] [--json=<file>] [--synthetic-ports=<count>,...] "
+                                      "[--end-to-end=<vcpkg executable>] [--end-to-end-ports=<count>]");
+    }
+
+    auto& fs = Files::get_real_filesystem();
+    if (vcpkg_root_dir.empty())
+        vcpkg_root_dir = fs.find_file_recursively_up(fs::stdfs::current_path(), ".vcpkg-root");
+    Checks::check_exit(VCPKG_LINE_INFO, !vcpkg_root_dir.empty(), "Error: Could not detect vcpkg-root.");
+
+    const auto paths = VcpkgPaths::create(fs::stdfs::absolute(vcpkg_root_dir), "").value_or_exit(VCPKG_LINE_INFO);
+
+    const fs::path work_dir = paths.buildtrees / "vcpkgbenchmark";
+    std::error_code ec;
+    fs.remove_all(work_dir, ec);
+    fs.create_directories(work_dir, ec);
+    Checks::check_exit(VCPKG_LINE_INFO, !ec, "Could not create %s: %s", work_dir.u8string(), ec.message());
+
+    benchmark_parse_paragraphs(runner, paths);
+    benchmark_install_plan(runner, paths);
+    benchmark_synthetic_plans(runner, synthetic_port_counts);
+    benchmark_status_find(runner);
+    benchmark_file_hash(runner, fs, work_dir);
+    benchmark_strings(runner);
+    benchmark_case_insensitive(runner, paths);
+    benchmark_install_files(runner, fs, work_dir);
+    benchmark_install_files_in_memory(runner);
+    if (!end_to_end_vcpkg.empty())
+        benchmark_end_to_end(runner, fs, paths, fs::stdfs::absolute(end_to_end_vcpkg), end_to_end_port_count);
+
+    fs.remove_all(work_dir, ec);
+
+    if (!json_file.empty())
+    {
+        fs.write_contents(fs::u8path(json_file), to_json(runner.results), ec);
+        Checks::check_exit(VCPKG_LINE_INFO, !ec, "Could not write %s: %s", json_file, ec.message());
+    }
+
+    return 0;
+}
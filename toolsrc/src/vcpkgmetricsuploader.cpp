@@ -13,8 +13,12 @@ int WINAPI WinMain(_In_ HINSTANCE, _In_opt_ HINSTANCE, _In_ LPSTR, _In_ int)
     LPWSTR* szArgList = CommandLineToArgvW(GetCommandLineW(), &argCount);
 
     Checks::check_exit(VCPKG_LINE_INFO, argCount == 2, "Requires exactly one argument, the path to the payload file");
-    auto v = Files::get_real_filesystem().read_contents(szArgList[1]).value_or_exit(VCPKG_LINE_INFO);
+    auto& fs = Files::get_real_filesystem();
+    auto v = fs.read_contents(szArgList[1]).value_or_exit(VCPKG_LINE_INFO);
     Metrics::g_metrics.lock()->upload(v);
+    // The payload is a batch of spooled events, which must not be sent twice
+    std::error_code ec;
+    fs.remove(szArgList[1], ec);
     LocalFree(szArgList);
     return 0;
 }